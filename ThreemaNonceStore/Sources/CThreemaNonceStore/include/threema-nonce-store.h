@@ -0,0 +1,210 @@
+//  _____ _
+// |_   _| |_  _ _ ___ ___ _ __  __ _
+//   | | | ' \| '_/ -_) -_) '  \/ _` |_
+//   |_| |_||_|_| \___\___|_|_|_\__,_(_)
+//
+// Threema iOS Client
+// Copyright (c) 2025 Threema GmbH
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Length of a hashed nonce (HMAC-SHA256) in bytes
+#define NONCE_HASH_LENGTH 32
+
+/// Number of nonces hashed in parallel by `nonce_hasher_hash_batch`
+#define NONCE_HASHER_LANES 8
+
+// MARK: - Nonce hasher
+
+/// SHA-256 state after a whole number of compressed blocks
+typedef struct {
+    uint32_t h[8];
+} nonce_sha256_midstate;
+
+/// HMAC-SHA256 with the inner and outer key pads already compressed
+///
+/// Hashing a nonce with a precomputed hasher needs two compressions instead of four (as long as the nonce is at most
+/// 55 bytes long).
+typedef struct {
+    nonce_sha256_midstate inner;
+    nonce_sha256_midstate outer;
+} nonce_hasher;
+
+/// Initialize a nonce hasher for the provided key (i.e. our identity)
+///
+/// - Parameters:
+///   - hasher: Hasher to initialize. Must be provided
+///   - key: Must be `NULL` or contain exactly `key_length` bytes
+///   - key_length: Length of `key`. Keys longer than 64 bytes are hashed first
+/// - Returns: 0 on success, -1 on invalid parameters
+int nonce_hasher_init(nonce_hasher* const hasher, uint8_t const* const key, size_t const key_length);
+
+/// Compute HMAC-SHA256(key, nonce) using the precomputed midstates
+///
+/// - Parameters:
+///   - hasher: Initialized hasher
+///   - nonce: Must contain exactly `nonce_length` bytes
+///   - nonce_length: Length of `nonce`
+///   - hash: Receives `NONCE_HASH_LENGTH` bytes
+void nonce_hasher_hash(
+    nonce_hasher const* const hasher,
+    uint8_t const* const nonce,
+    size_t const nonce_length,
+    uint8_t* const hash
+);
+
+/// Compute HMAC-SHA256(key, nonce) for `count` nonces of equal length
+///
+/// Nonces of at most 55 bytes are hashed `NONCE_HASHER_LANES` at a time with a multi-buffer SHA-256 kernel. Longer
+/// nonces and the remainder of the batch are hashed one by one.
+///
+/// - Parameters:
+///   - hasher: Initialized hasher
+///   - nonces: `count` consecutive nonces of `nonce_length` bytes each
+///   - nonce_length: Length of each nonce
+///   - count: Number of nonces
+///   - hashes: Receives `count` consecutive hashes of `NONCE_HASH_LENGTH` bytes each
+void nonce_hasher_hash_batch(
+    nonce_hasher const* const hasher,
+    uint8_t const* const nonces,
+    size_t const nonce_length,
+    size_t const count,
+    uint8_t* const hashes
+);
+
+/// Wipe the key material of a hasher
+void nonce_hasher_clear(nonce_hasher* const hasher);
+
+// MARK: - Nonce store
+
+/// Append-only, memory-mapped store of hashed nonces
+///
+/// A store consists of two files:
+/// - `<path>`: Header followed by the 32 byte hashes in insertion order. This is the source of truth and is only
+///   ever appended to.
+/// - `<path>-index`: Header, the prefilter (blocked bloom filter) and the open-addressing index over the records. It
+///   is rebuilt from the records file whenever it is missing, corrupt or out of date.
+///
+/// A store must only be used by one thread at a time, but several processes (e.g. the app and the notification
+/// extension) can have the same store open. Each call that accesses the files waits for an exclusive advisory lock on
+/// the records file and releases it before returning, thus no lock is held while a process is suspended. After
+/// locking, the call follows the changes made by other processes (grown records file, rebuilt index).
+typedef struct nonce_store nonce_store;
+
+typedef enum {
+    NONCE_STORE_OK = 0,
+    NONCE_STORE_ERROR_INVALID_ARGUMENT = -1,
+    NONCE_STORE_ERROR_IO = -2,
+    NONCE_STORE_ERROR_CORRUPT = -4,
+    NONCE_STORE_ERROR_OUT_OF_MEMORY = -5,
+    NONCE_STORE_ERROR_FULL = -6,
+} nonce_store_result;
+
+/// Result of a batch check for a single hash
+typedef enum {
+    /// Not stored and first occurrence in the batch
+    NONCE_STATUS_NEW = 0,
+    /// Already stored
+    NONCE_STATUS_STORED = 1,
+    /// Not stored but an earlier entry of the same batch has the same hash
+    NONCE_STATUS_REPEATED = 2,
+} nonce_status;
+
+/// Counters and sizes of a store
+typedef struct {
+    /// Number of stored hashes
+    uint64_t count;
+    /// Number of records the records file currently has room for
+    uint64_t record_capacity;
+    /// Number of index slots
+    uint64_t index_slots;
+    /// Size of the prefilter in bytes
+    uint64_t prefilter_bytes;
+    /// Total number of mapped bytes (records file and index file)
+    uint64_t mapped_bytes;
+    /// Number of lookups answered by the prefilter alone
+    uint64_t prefilter_rejections;
+    /// Number of lookups that had to probe the index
+    uint64_t index_lookups;
+    /// Number of record reads needed to confirm a fingerprint match
+    uint64_t record_reads;
+} nonce_store_stats;
+
+/// Open (or create) the store at `path`
+///
+/// - Parameters:
+///   - path: Path of the records file. The index file is placed next to it
+///   - store: Receives the opened store on success
+/// - Returns: `NONCE_STORE_OK` or an error
+nonce_store_result nonce_store_open(char const* const path, nonce_store** const store);
+
+/// Flush and unmap the store. `store` may be `NULL`.
+void nonce_store_close(nonce_store* const store);
+
+/// Check whether a hashed nonce is stored
+///
+/// - Returns: 1 if stored, 0 if not, < 0 on error
+int nonce_store_contains(nonce_store* const store, uint8_t const* const hash);
+
+/// Store a hashed nonce
+///
+/// - Returns: 1 if it was added, 0 if it was already stored, < 0 on error
+int nonce_store_insert(nonce_store* const store, uint8_t const* const hash);
+
+/// Check many hashed nonces at once, e.g. the messages of the offline queue after reconnecting
+///
+/// The hashes are sorted by their index position. This groups repeated hashes (which are marked as
+/// `NONCE_STATUS_REPEATED` except for their first occurrence) and lets all lookups walk the index in a single
+/// ascending pass.
+///
+/// - Parameters:
+///   - hashes: `count` consecutive hashes of `NONCE_HASH_LENGTH` bytes each
+///   - count: Number of hashes
+///   - statuses: Receives a `nonce_status` for each hash, in the order of `hashes`
+/// - Returns: `NONCE_STORE_OK` or an error
+nonce_store_result nonce_store_check_batch(
+    nonce_store* const store,
+    uint8_t const* const hashes,
+    size_t const count,
+    uint8_t* const statuses
+);
+
+/// Store many hashed nonces at once, e.g. when migrating an existing nonce table
+///
+/// The files are grown once up front. Hashes that are already stored (or repeated within `hashes`) are skipped.
+///
+/// - Parameters:
+///   - hashes: `count` consecutive hashes of `NONCE_HASH_LENGTH` bytes each
+///   - count: Number of hashes
+///   - imported: Optional, receives the number of hashes that were actually added
+/// - Returns: `NONCE_STORE_OK` or an error. On error all hashes added so far remain stored.
+nonce_store_result nonce_store_import(
+    nonce_store* const store,
+    uint8_t const* const hashes,
+    size_t const count,
+    size_t* const imported
+);
+
+/// Write all changes to disk
+nonce_store_result nonce_store_sync(nonce_store* const store);
+
+/// Number of stored hashes
+uint64_t nonce_store_count(nonce_store const* const store);
+
+/// Current sizes and counters of the store
+void nonce_store_get_stats(nonce_store const* const store, nonce_store_stats* const stats);
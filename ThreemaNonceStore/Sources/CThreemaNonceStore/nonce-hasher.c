@@ -0,0 +1,296 @@
+//  _____ _
+// |_   _| |_  _ _ ___ ___ _ __  __ _
+//   | | | ' \| '_/ -_) -_) '  \/ _` |_
+//   |_| |_||_|_| \___\___|_|_|_\__,_(_)
+//
+// Threema iOS Client
+// Copyright (c) 2025 Threema GmbH
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#include "threema-nonce-store.h"
+#include "nonce-store-impl.h"
+#include <string.h>
+
+#define SHA256_BLOCK_LENGTH 64
+
+static uint32_t const sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+uint32_t const nonce_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void sha256_compress(uint32_t* const state, uint8_t const* const block) {
+    uint32_t w[64];
+    for (size_t i = 0; i < 16; i++) {
+        w[i] = nonce_load32_be(block + i * 4);
+    }
+    for (size_t i = 16; i < 64; i++) {
+        w[i] = NONCE_SHA256_SSIG1(w[i - 2]) + w[i - 7] + NONCE_SHA256_SSIG0(w[i - 15]) + w[i - 16];
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (size_t i = 0; i < 64; i++) {
+        uint32_t const t1 = h + NONCE_SHA256_BSIG1(e) + NONCE_SHA256_CH(e, f, g) + nonce_sha256_k[i] + w[i];
+        uint32_t const t2 = NONCE_SHA256_BSIG0(a) + NONCE_SHA256_MAJ(a, b, c);
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+// Hash the remaining `data` on top of `state` which has already absorbed `prefix_length` bytes (a multiple of the
+// block length) and write the digest.
+static void sha256_finish(
+    uint32_t* const state,
+    uint8_t const* data,
+    size_t length,
+    uint64_t const prefix_length,
+    uint8_t* const digest
+) {
+    uint64_t const bit_length = (prefix_length + length) * 8;
+
+    while (length >= SHA256_BLOCK_LENGTH) {
+        sha256_compress(state, data);
+        data += SHA256_BLOCK_LENGTH;
+        length -= SHA256_BLOCK_LENGTH;
+    }
+
+    uint8_t block[SHA256_BLOCK_LENGTH * 2];
+    memset(block, 0, sizeof(block));
+    memcpy(block, data, length);
+    block[length] = 0x80;
+    size_t const padded_length = length + 9 <= SHA256_BLOCK_LENGTH ? SHA256_BLOCK_LENGTH : SHA256_BLOCK_LENGTH * 2;
+    nonce_store64_be(block + padded_length - 8, bit_length);
+    sha256_compress(state, block);
+    if (padded_length > SHA256_BLOCK_LENGTH) {
+        sha256_compress(state, block + SHA256_BLOCK_LENGTH);
+    }
+
+    for (size_t i = 0; i < 8; i++) {
+        nonce_store32_be(digest + i * 4, state[i]);
+    }
+    nonce_secure_zero(block, sizeof(block));
+}
+
+int nonce_hasher_init(nonce_hasher* const hasher, uint8_t const* const key, size_t const key_length) {
+    if (!hasher || (!key && key_length != 0)) {
+        return -1;
+    }
+
+    // Keys longer than a block are replaced by their hash (RFC 2104)
+    uint8_t padded_key[SHA256_BLOCK_LENGTH];
+    memset(padded_key, 0, sizeof(padded_key));
+    if (key_length > SHA256_BLOCK_LENGTH) {
+        uint32_t state[8];
+        memcpy(state, sha256_iv, sizeof(state));
+        sha256_finish(state, key, key_length, 0, padded_key);
+    } else if (key_length > 0) {
+        memcpy(padded_key, key, key_length);
+    }
+
+    uint8_t pad[SHA256_BLOCK_LENGTH];
+    for (size_t i = 0; i < SHA256_BLOCK_LENGTH; i++) {
+        pad[i] = padded_key[i] ^ 0x36;
+    }
+    memcpy(hasher->inner.h, sha256_iv, sizeof(hasher->inner.h));
+    sha256_compress(hasher->inner.h, pad);
+
+    for (size_t i = 0; i < SHA256_BLOCK_LENGTH; i++) {
+        pad[i] = padded_key[i] ^ 0x5c;
+    }
+    memcpy(hasher->outer.h, sha256_iv, sizeof(hasher->outer.h));
+    sha256_compress(hasher->outer.h, pad);
+
+    // Burn the key from stack
+    nonce_secure_zero(padded_key, sizeof(padded_key));
+    nonce_secure_zero(pad, sizeof(pad));
+    return 0;
+}
+
+void nonce_hasher_hash(
+    nonce_hasher const* const hasher,
+    uint8_t const* const nonce,
+    size_t const nonce_length,
+    uint8_t* const hash
+) {
+    uint32_t state[8];
+    uint8_t inner_digest[NONCE_HASH_LENGTH];
+
+    memcpy(state, hasher->inner.h, sizeof(state));
+    sha256_finish(state, nonce, nonce_length, SHA256_BLOCK_LENGTH, inner_digest);
+
+    memcpy(state, hasher->outer.h, sizeof(state));
+    sha256_finish(state, inner_digest, sizeof(inner_digest), SHA256_BLOCK_LENGTH, hash);
+
+    nonce_secure_zero(state, sizeof(state));
+}
+
+void nonce_hasher_clear(nonce_hasher* const hasher) {
+    if (hasher) {
+        nonce_secure_zero(hasher, sizeof(*hasher));
+    }
+}
+
+// MARK: - Multi-buffer hashing
+
+// Compress one block for each of `NONCE_HASHER_LANES` independent states. The lane loops are innermost so that the
+// compiler can map them onto vector registers (NEON, SSE/AVX), computing several hashes per instruction.
+//
+// `blocks` points to `NONCE_HASHER_LANES` consecutive blocks. It is not declared as a 2D array since ISO C (before
+// C23) does not implicitly convert `uint8_t (*)[N]` to `uint8_t const (*)[N]`.
+static void sha256_compress_lanes(uint32_t state[8][NONCE_HASHER_LANES], uint8_t const* const blocks) {
+    uint32_t w[64][NONCE_HASHER_LANES];
+    for (size_t i = 0; i < 16; i++) {
+        for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+            w[i][lane] = nonce_load32_be(blocks + lane * SHA256_BLOCK_LENGTH + i * 4);
+        }
+    }
+    for (size_t i = 16; i < 64; i++) {
+        for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+            w[i][lane] = NONCE_SHA256_SSIG1(w[i - 2][lane]) + w[i - 7][lane] + NONCE_SHA256_SSIG0(w[i - 15][lane]) +
+                w[i - 16][lane];
+        }
+    }
+
+    uint32_t a[NONCE_HASHER_LANES], b[NONCE_HASHER_LANES], c[NONCE_HASHER_LANES], d[NONCE_HASHER_LANES];
+    uint32_t e[NONCE_HASHER_LANES], f[NONCE_HASHER_LANES], g[NONCE_HASHER_LANES], h[NONCE_HASHER_LANES];
+    for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+        a[lane] = state[0][lane];
+        b[lane] = state[1][lane];
+        c[lane] = state[2][lane];
+        d[lane] = state[3][lane];
+        e[lane] = state[4][lane];
+        f[lane] = state[5][lane];
+        g[lane] = state[6][lane];
+        h[lane] = state[7][lane];
+    }
+
+    for (size_t i = 0; i < 64; i++) {
+        for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+            uint32_t const t1 = h[lane] + NONCE_SHA256_BSIG1(e[lane]) + NONCE_SHA256_CH(e[lane], f[lane], g[lane]) +
+                nonce_sha256_k[i] + w[i][lane];
+            uint32_t const t2 = NONCE_SHA256_BSIG0(a[lane]) + NONCE_SHA256_MAJ(a[lane], b[lane], c[lane]);
+            h[lane] = g[lane];
+            g[lane] = f[lane];
+            f[lane] = e[lane];
+            e[lane] = d[lane] + t1;
+            d[lane] = c[lane];
+            c[lane] = b[lane];
+            b[lane] = a[lane];
+            a[lane] = t1 + t2;
+        }
+    }
+
+    for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+        state[0][lane] += a[lane];
+        state[1][lane] += b[lane];
+        state[2][lane] += c[lane];
+        state[3][lane] += d[lane];
+        state[4][lane] += e[lane];
+        state[5][lane] += f[lane];
+        state[6][lane] += g[lane];
+        state[7][lane] += h[lane];
+    }
+}
+
+// Load a midstate into all lanes
+static void sha256_broadcast(uint32_t state[8][NONCE_HASHER_LANES], nonce_sha256_midstate const* const midstate) {
+    for (size_t i = 0; i < 8; i++) {
+        for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+            state[i][lane] = midstate->h[i];
+        }
+    }
+}
+
+// Set the padding of a final block that holds `length` message bytes after a single block prefix (the key pad)
+static void sha256_pad_after_key(uint8_t* const block, size_t const length) {
+    memset(block + length, 0, SHA256_BLOCK_LENGTH - length);
+    block[length] = 0x80;
+    nonce_store64_be(block + SHA256_BLOCK_LENGTH - 8, (uint64_t) (SHA256_BLOCK_LENGTH + length) * 8);
+}
+
+void nonce_hasher_hash_batch(
+    nonce_hasher const* const hasher,
+    uint8_t const* const nonces,
+    size_t const nonce_length,
+    size_t const count,
+    uint8_t* const hashes
+) {
+    size_t index = 0;
+
+    // Nonces that fit into a single padded block are hashed `NONCE_HASHER_LANES` at a time
+    if (nonce_length + 9 <= SHA256_BLOCK_LENGTH) {
+        uint32_t state[8][NONCE_HASHER_LANES];
+        uint8_t blocks[NONCE_HASHER_LANES][SHA256_BLOCK_LENGTH];
+
+        for (; index + NONCE_HASHER_LANES <= count; index += NONCE_HASHER_LANES) {
+            // Inner hash: H((key ^ ipad) || nonce)
+            for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+                memcpy(blocks[lane], nonces + (index + lane) * nonce_length, nonce_length);
+                sha256_pad_after_key(blocks[lane], nonce_length);
+            }
+            sha256_broadcast(state, &hasher->inner);
+            sha256_compress_lanes(state, &blocks[0][0]);
+
+            // Outer hash: H((key ^ opad) || inner)
+            for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+                for (size_t i = 0; i < 8; i++) {
+                    nonce_store32_be(blocks[lane] + i * 4, state[i][lane]);
+                }
+                sha256_pad_after_key(blocks[lane], NONCE_HASH_LENGTH);
+            }
+            sha256_broadcast(state, &hasher->outer);
+            sha256_compress_lanes(state, &blocks[0][0]);
+
+            for (size_t lane = 0; lane < NONCE_HASHER_LANES; lane++) {
+                uint8_t* const hash = hashes + (index + lane) * NONCE_HASH_LENGTH;
+                for (size_t i = 0; i < 8; i++) {
+                    nonce_store32_be(hash + i * 4, state[i][lane]);
+                }
+            }
+        }
+
+        nonce_secure_zero(state, sizeof(state));
+        nonce_secure_zero(blocks, sizeof(blocks));
+    }
+
+    // Remainder (and long nonces)
+    for (; index < count; index++) {
+        nonce_hasher_hash(hasher, nonces + index * nonce_length, nonce_length, hashes + index * NONCE_HASH_LENGTH);
+    }
+}
@@ -0,0 +1,71 @@
+//  _____ _
+// |_   _| |_  _ _ ___ ___ _ __  __ _
+//   | | | ' \| '_/ -_) -_) '  \/ _` |_
+//   |_| |_||_|_| \___\___|_|_|_\__,_(_)
+//
+// Threema iOS Client
+// Copyright (c) 2025 Threema GmbH
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+// Helpers shared between the translation units of this target. Not part of the public interface.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// MARK: - SHA-256 primitives (FIPS 180-4)
+
+extern uint32_t const nonce_sha256_k[64];
+
+#define NONCE_ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define NONCE_SHA256_CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define NONCE_SHA256_MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define NONCE_SHA256_BSIG0(x) (NONCE_ROTR32(x, 2) ^ NONCE_ROTR32(x, 13) ^ NONCE_ROTR32(x, 22))
+#define NONCE_SHA256_BSIG1(x) (NONCE_ROTR32(x, 6) ^ NONCE_ROTR32(x, 11) ^ NONCE_ROTR32(x, 25))
+#define NONCE_SHA256_SSIG0(x) (NONCE_ROTR32(x, 7) ^ NONCE_ROTR32(x, 18) ^ ((x) >> 3))
+#define NONCE_SHA256_SSIG1(x) (NONCE_ROTR32(x, 17) ^ NONCE_ROTR32(x, 19) ^ ((x) >> 10))
+
+// MARK: - Byte order helpers
+
+static inline uint32_t nonce_load32_be(uint8_t const* const src) {
+    return ((uint32_t) src[0] << 24) | ((uint32_t) src[1] << 16) | ((uint32_t) src[2] << 8) | (uint32_t) src[3];
+}
+
+static inline uint32_t nonce_load32_le(uint8_t const* const src) {
+    return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+static inline uint64_t nonce_load64_le(uint8_t const* const src) {
+    return (uint64_t) nonce_load32_le(src) | ((uint64_t) nonce_load32_le(src + 4) << 32);
+}
+
+static inline void nonce_store32_be(uint8_t* const dst, uint32_t const value) {
+    dst[0] = (uint8_t) (value >> 24);
+    dst[1] = (uint8_t) (value >> 16);
+    dst[2] = (uint8_t) (value >> 8);
+    dst[3] = (uint8_t) value;
+}
+
+static inline void nonce_store64_be(uint8_t* const dst, uint64_t const value) {
+    nonce_store32_be(dst, (uint32_t) (value >> 32));
+    nonce_store32_be(dst + 4, (uint32_t) value);
+}
+
+// Same approach as `secure_zero_memory` of the BLAKE2 reference implementation
+static inline void nonce_secure_zero(void* const buffer, size_t const length) {
+    static void* (*const volatile memset_v)(void*, int, size_t) = &memset;
+    memset_v(buffer, 0, length);
+}
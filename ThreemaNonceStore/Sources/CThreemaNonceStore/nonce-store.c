@@ -0,0 +1,808 @@
+//  _____ _
+// |_   _| |_  _ _ ___ ___ _ __  __ _
+//   | | | ' \| '_/ -_) -_) '  \/ _` |_
+//   |_| |_||_|_| \___\___|_|_|_\__,_(_)
+//
+// Threema iOS Client
+// Copyright (c) 2025 Threema GmbH
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#include "threema-nonce-store.h"
+#include "nonce-store-impl.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Files are only ever read on the device that wrote them, so all header fields use the host byte order. Hashes are
+// HMAC outputs and therefore uniformly distributed, which is why they are used for slot and prefilter positions
+// without any further hashing.
+
+#define RECORDS_MAGIC "3MANONCE"
+#define INDEX_MAGIC "3MANIDX1"
+#define STORE_VERSION 1
+#define HEADER_LENGTH 64
+#define INITIAL_RECORD_CAPACITY 4096
+#define INITIAL_INDEX_SLOTS 8192
+#define PREFILTER_BLOCK_LENGTH 64
+#define PREFILTER_HASH_COUNT 6
+// One prefilter byte per index slot, i.e. 10.7–21.3 bits per stored hash at 3/4 maximum load
+#define PREFILTER_SLOTS_PER_BLOCK PREFILTER_BLOCK_LENGTH
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_length;
+    uint64_t count;
+    // Incremented whenever the index file is replaced, so that other processes reopen it
+    uint64_t index_generation;
+    uint8_t reserved[32];
+} records_header;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved0;
+    uint64_t slot_count;
+    uint64_t prefilter_blocks;
+    uint64_t record_count;
+    uint8_t reserved1[24];
+} index_header;
+
+// An empty slot has `record` 0, otherwise `record` is the record number + 1
+typedef struct {
+    uint32_t fingerprint;
+    uint32_t record;
+} index_slot;
+
+typedef struct {
+    int fd;
+    uint8_t* map;
+    size_t map_length;
+} mapped_file;
+
+struct nonce_store {
+    char* records_path;
+    char* index_path;
+    mapped_file records;
+    mapped_file index;
+    // `index_generation` of the records header when the index was opened
+    uint64_t index_generation;
+    nonce_store_stats counters;
+};
+
+_Static_assert(sizeof(records_header) == HEADER_LENGTH, "records header must be 64 bytes");
+_Static_assert(sizeof(index_header) == HEADER_LENGTH, "index header must be 64 bytes");
+_Static_assert(sizeof(index_slot) == 8, "index slot must be 8 bytes");
+
+// MARK: - Layout accessors
+
+static inline records_header* records_header_of(nonce_store const* const store) {
+    return (records_header*) store->records.map;
+}
+
+static inline uint8_t* record_at(nonce_store const* const store, uint64_t const record) {
+    return store->records.map + HEADER_LENGTH + record * NONCE_HASH_LENGTH;
+}
+
+static inline uint64_t record_capacity_of(nonce_store const* const store) {
+    return (store->records.map_length - HEADER_LENGTH) / NONCE_HASH_LENGTH;
+}
+
+static inline index_header* index_header_of(nonce_store const* const store) {
+    return (index_header*) store->index.map;
+}
+
+static inline uint8_t* prefilter_of(uint8_t* const index_map) {
+    return index_map + HEADER_LENGTH;
+}
+
+static inline index_slot* slots_of(uint8_t* const index_map) {
+    index_header const* const header = (index_header const*) index_map;
+    return (index_slot*) (index_map + HEADER_LENGTH + header->prefilter_blocks * PREFILTER_BLOCK_LENGTH);
+}
+
+static inline size_t index_file_length(uint64_t const slot_count) {
+    uint64_t const prefilter_blocks = slot_count / PREFILTER_SLOTS_PER_BLOCK;
+    return HEADER_LENGTH + prefilter_blocks * PREFILTER_BLOCK_LENGTH + slot_count * sizeof(index_slot);
+}
+
+// MARK: - Prefilter (blocked bloom filter, one cache line per hash)
+
+static inline void prefilter_positions(
+    uint8_t const* const hash,
+    uint64_t const prefilter_blocks,
+    uint64_t* const block,
+    uint16_t* const bits
+) {
+    // Bytes 0..3 are the index fingerprint, bytes 12..15 pick the block and bytes 16..22 the bits within it
+    *block = ((nonce_load64_le(hash + 8) >> 32) * prefilter_blocks) >> 32;
+    uint64_t const bit_source = nonce_load64_le(hash + 16);
+    for (size_t i = 0; i < PREFILTER_HASH_COUNT; i++) {
+        bits[i] = (uint16_t) ((bit_source >> (i * 9)) & 0x1ff);
+    }
+}
+
+static inline void prefilter_add(uint8_t* const prefilter, uint64_t const prefilter_blocks, uint8_t const* const hash) {
+    uint64_t block;
+    uint16_t bits[PREFILTER_HASH_COUNT];
+    prefilter_positions(hash, prefilter_blocks, &block, bits);
+    uint8_t* const line = prefilter + block * PREFILTER_BLOCK_LENGTH;
+    for (size_t i = 0; i < PREFILTER_HASH_COUNT; i++) {
+        line[bits[i] >> 3] |= (uint8_t) (1u << (bits[i] & 7));
+    }
+}
+
+static inline int prefilter_may_contain(
+    uint8_t const* const prefilter,
+    uint64_t const prefilter_blocks,
+    uint8_t const* const hash
+) {
+    uint64_t block;
+    uint16_t bits[PREFILTER_HASH_COUNT];
+    prefilter_positions(hash, prefilter_blocks, &block, bits);
+    uint8_t const* const line = prefilter + block * PREFILTER_BLOCK_LENGTH;
+    for (size_t i = 0; i < PREFILTER_HASH_COUNT; i++) {
+        if (!(line[bits[i] >> 3] & (1u << (bits[i] & 7)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// MARK: - Index (open addressing, linear probing)
+
+// Insert without a duplicate check. The caller guarantees that there is a free slot.
+static inline void index_put(uint8_t* const index_map, uint32_t const fingerprint, uint32_t const record) {
+    index_header const* const header = (index_header const*) index_map;
+    index_slot* const slots = slots_of(index_map);
+    uint64_t const mask = header->slot_count - 1;
+    uint64_t position = fingerprint & mask;
+    while (slots[position].record != 0) {
+        position = (position + 1) & mask;
+    }
+    slots[position].fingerprint = fingerprint;
+    slots[position].record = record + 1;
+}
+
+static int index_find(nonce_store* const store, uint8_t const* const hash) {
+    index_header const* const header = index_header_of(store);
+    index_slot const* const slots = slots_of(store->index.map);
+    uint64_t const mask = header->slot_count - 1;
+    uint32_t const fingerprint = nonce_load32_le(hash);
+    uint64_t position = fingerprint & mask;
+
+    store->counters.index_lookups++;
+    while (slots[position].record != 0) {
+        // Another process may be appending a record beyond the mapping right now, see `refresh`
+        uint32_t const record = slots[position].record;
+        if (slots[position].fingerprint == fingerprint && record <= record_capacity_of(store)) {
+            store->counters.record_reads++;
+            if (memcmp(record_at(store, record - 1), hash, NONCE_HASH_LENGTH) == 0) {
+                return 1;
+            }
+        }
+        position = (position + 1) & mask;
+    }
+    return 0;
+}
+
+// MARK: - File helpers
+
+static void unmap_file(mapped_file* const file) {
+    if (file->map) {
+        munmap(file->map, file->map_length);
+        file->map = NULL;
+        file->map_length = 0;
+    }
+}
+
+static void close_file(mapped_file* const file) {
+    unmap_file(file);
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+}
+
+// Resize the file to `length` and map all of it. The previous mapping stays valid if this fails.
+static nonce_store_result map_file(mapped_file* const file, size_t const length) {
+    if (length != file->map_length && ftruncate(file->fd, (off_t) length) != 0) {
+        return NONCE_STORE_ERROR_IO;
+    }
+    void* const map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (map == MAP_FAILED) {
+        return NONCE_STORE_ERROR_OUT_OF_MEMORY;
+    }
+    unmap_file(file);
+    file->map = map;
+    file->map_length = length;
+    return NONCE_STORE_OK;
+}
+
+static char* path_with_suffix(char const* const path, char const* const suffix) {
+    size_t const path_length = strlen(path);
+    size_t const suffix_length = strlen(suffix);
+    char* const result = malloc(path_length + suffix_length + 1);
+    if (result) {
+        memcpy(result, path, path_length);
+        memcpy(result + path_length, suffix, suffix_length + 1);
+    }
+    return result;
+}
+
+// Wait for the exclusive lock on the records file, which guards both files against other processes
+static nonce_store_result lock_records(nonce_store* const store) {
+    while (flock(store->records.fd, LOCK_EX) != 0) {
+        if (errno != EINTR) {
+            return NONCE_STORE_ERROR_IO;
+        }
+    }
+    return NONCE_STORE_OK;
+}
+
+static void unlock_records(nonce_store* const store) {
+    flock(store->records.fd, LOCK_UN);
+}
+
+// MARK: - Records file
+
+static int is_valid_records_length(off_t const length) {
+    return (size_t) length >= HEADER_LENGTH && ((size_t) length - HEADER_LENGTH) % NONCE_HASH_LENGTH == 0;
+}
+
+static nonce_store_result open_records(nonce_store* const store) {
+    store->records.fd = open(store->records_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (store->records.fd < 0) {
+        return NONCE_STORE_ERROR_IO;
+    }
+    nonce_store_result const lock_result = lock_records(store);
+    if (lock_result != NONCE_STORE_OK) {
+        return lock_result;
+    }
+
+    struct stat status;
+    if (fstat(store->records.fd, &status) != 0) {
+        return NONCE_STORE_ERROR_IO;
+    }
+
+    // New store
+    if (status.st_size == 0) {
+        nonce_store_result const result =
+            map_file(&store->records, HEADER_LENGTH + (size_t) INITIAL_RECORD_CAPACITY * NONCE_HASH_LENGTH);
+        if (result != NONCE_STORE_OK) {
+            return result;
+        }
+        records_header* const header = records_header_of(store);
+        memcpy(header->magic, RECORDS_MAGIC, sizeof(header->magic));
+        header->version = STORE_VERSION;
+        header->record_length = NONCE_HASH_LENGTH;
+        header->count = 0;
+        header->index_generation = 0;
+        return NONCE_STORE_OK;
+    }
+
+    // Existing store
+    if (!is_valid_records_length(status.st_size)) {
+        return NONCE_STORE_ERROR_CORRUPT;
+    }
+    nonce_store_result const result = map_file(&store->records, (size_t) status.st_size);
+    if (result != NONCE_STORE_OK) {
+        return result;
+    }
+    records_header const* const header = records_header_of(store);
+    if (memcmp(header->magic, RECORDS_MAGIC, sizeof(header->magic)) != 0 || header->version != STORE_VERSION ||
+        header->record_length != NONCE_HASH_LENGTH || header->count > record_capacity_of(store)) {
+        return NONCE_STORE_ERROR_CORRUPT;
+    }
+    return NONCE_STORE_OK;
+}
+
+// Map all of the records file, which may have been grown by another process
+static nonce_store_result remap_records(nonce_store* const store) {
+    struct stat status;
+    if (fstat(store->records.fd, &status) != 0) {
+        return NONCE_STORE_ERROR_IO;
+    }
+    if (!is_valid_records_length(status.st_size) || (size_t) status.st_size < store->records.map_length) {
+        return NONCE_STORE_ERROR_CORRUPT;
+    }
+    if ((size_t) status.st_size == store->records.map_length) {
+        return NONCE_STORE_OK;
+    }
+    return map_file(&store->records, (size_t) status.st_size);
+}
+
+static nonce_store_result reserve_records(nonce_store* const store, uint64_t const additional) {
+    uint64_t const count = records_header_of(store)->count;
+    if (count + additional > UINT32_MAX - 1) {
+        return NONCE_STORE_ERROR_FULL;
+    }
+    if (count + additional <= record_capacity_of(store)) {
+        return NONCE_STORE_OK;
+    }
+
+    // Never shrink the file below the size another process may have grown (and mapped) it to
+    nonce_store_result const result = remap_records(store);
+    if (result != NONCE_STORE_OK) {
+        return result;
+    }
+    uint64_t capacity = record_capacity_of(store);
+    if (count + additional <= capacity) {
+        return NONCE_STORE_OK;
+    }
+
+    // Grow by 1.5× (or more if needed)
+    if (capacity < INITIAL_RECORD_CAPACITY) {
+        capacity = INITIAL_RECORD_CAPACITY;
+    }
+    while (capacity < count + additional) {
+        capacity += capacity / 2;
+    }
+    return map_file(&store->records, HEADER_LENGTH + (size_t) capacity * NONCE_HASH_LENGTH);
+}
+
+// MARK: - Index file
+
+// Create a fresh index file with `slot_count` slots at `path` and map it into `file`
+static nonce_store_result create_index(mapped_file* const file, char const* const path, uint64_t const slot_count) {
+    file->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (file->fd < 0) {
+        return NONCE_STORE_ERROR_IO;
+    }
+    nonce_store_result const result = map_file(file, index_file_length(slot_count));
+    if (result != NONCE_STORE_OK) {
+        return result;
+    }
+
+    index_header* const header = (index_header*) file->map;
+    memcpy(header->magic, INDEX_MAGIC, sizeof(header->magic));
+    header->version = STORE_VERSION;
+    header->slot_count = slot_count;
+    header->prefilter_blocks = slot_count / PREFILTER_SLOTS_PER_BLOCK;
+    header->record_count = 0;
+    return NONCE_STORE_OK;
+}
+
+static uint64_t slot_count_for(uint64_t const count) {
+    uint64_t slot_count = INITIAL_INDEX_SLOTS;
+    // Keep the load at or below 3/4
+    while (count > slot_count / 4 * 3) {
+        slot_count *= 2;
+    }
+    return slot_count;
+}
+
+// Add records `[from, to)` of the records file to the index
+static void index_records(nonce_store* const store, uint8_t* const index_map, uint64_t const from, uint64_t const to) {
+    index_header* const header = (index_header*) index_map;
+    uint8_t* const prefilter = prefilter_of(index_map);
+    for (uint64_t record = from; record < to; record++) {
+        uint8_t const* const hash = record_at(store, record);
+        index_put(index_map, nonce_load32_le(hash), (uint32_t) record);
+        prefilter_add(prefilter, header->prefilter_blocks, hash);
+    }
+    header->record_count = to;
+}
+
+// Build a new index sized for `count` records (plus `additional` that are about to be inserted) and atomically
+// replace the current one.
+static nonce_store_result rebuild_index(nonce_store* const store, uint64_t const additional) {
+    uint64_t const count = records_header_of(store)->count;
+    char* const temporary_path = path_with_suffix(store->index_path, ".tmp");
+    if (!temporary_path) {
+        return NONCE_STORE_ERROR_OUT_OF_MEMORY;
+    }
+
+    mapped_file rebuilt = {.fd = -1, .map = NULL, .map_length = 0};
+    nonce_store_result result = create_index(&rebuilt, temporary_path, slot_count_for(count + additional));
+    if (result == NONCE_STORE_OK) {
+        index_records(store, rebuilt.map, 0, count);
+        if (msync(rebuilt.map, rebuilt.map_length, MS_SYNC) != 0 || rename(temporary_path, store->index_path) != 0) {
+            result = NONCE_STORE_ERROR_IO;
+        }
+    }
+    free(temporary_path);
+
+    if (result != NONCE_STORE_OK) {
+        close_file(&rebuilt);
+        return result;
+    }
+    close_file(&store->index);
+    store->index = rebuilt;
+    store->index_generation = ++records_header_of(store)->index_generation;
+    return NONCE_STORE_OK;
+}
+
+static nonce_store_result open_index(nonce_store* const store) {
+    store->index.fd = open(store->index_path, O_RDWR | O_CLOEXEC);
+    if (store->index.fd < 0) {
+        return rebuild_index(store, 0);
+    }
+
+    struct stat status;
+    if (fstat(store->index.fd, &status) != 0 || (size_t) status.st_size < HEADER_LENGTH ||
+        map_file(&store->index, (size_t) status.st_size) != NONCE_STORE_OK) {
+        close_file(&store->index);
+        return rebuild_index(store, 0);
+    }
+
+    // Validate the geometry, fall back to a rebuild if anything looks off
+    index_header const* const header = index_header_of(store);
+    uint64_t const count = records_header_of(store)->count;
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != STORE_VERSION ||
+        header->slot_count < INITIAL_INDEX_SLOTS || (header->slot_count & (header->slot_count - 1)) != 0 ||
+        header->prefilter_blocks != header->slot_count / PREFILTER_SLOTS_PER_BLOCK ||
+        index_file_length(header->slot_count) != (size_t) status.st_size || header->record_count > count ||
+        count > header->slot_count / 4 * 3) {
+        close_file(&store->index);
+        return rebuild_index(store, 0);
+    }
+
+    // Catch up on records that were appended but not indexed (i.e. the writing process was interrupted)
+    if (header->record_count < count) {
+        index_records(store, store->index.map, header->record_count, count);
+    }
+    store->index_generation = records_header_of(store)->index_generation;
+    return NONCE_STORE_OK;
+}
+
+static nonce_store_result reserve_index(nonce_store* const store, uint64_t const additional) {
+    uint64_t const count = records_header_of(store)->count;
+    if (count + additional <= index_header_of(store)->slot_count / 4 * 3) {
+        return NONCE_STORE_OK;
+    }
+    return rebuild_index(store, additional);
+}
+
+// MARK: - Locking
+
+// Whether the mappings reflect all changes other processes made to the files
+static int is_current(nonce_store const* const store) {
+    records_header const* const header = records_header_of(store);
+    return store->index.map && header->index_generation == store->index_generation &&
+           header->count <= record_capacity_of(store) && index_header_of(store)->record_count == header->count;
+}
+
+// Lock the store and follow the changes other processes made since it was last locked: Remap the records file if it
+// has grown beyond the mapping and reopen the index if it has been replaced or is missing records.
+static nonce_store_result lock_store(nonce_store* const store) {
+    nonce_store_result result = lock_records(store);
+    if (result != NONCE_STORE_OK) {
+        return result;
+    }
+
+    uint64_t const count = records_header_of(store)->count;
+    if (count > record_capacity_of(store)) {
+        result = remap_records(store);
+        if (result == NONCE_STORE_OK && count > record_capacity_of(store)) {
+            result = NONCE_STORE_ERROR_CORRUPT;
+        }
+    }
+    // The index is missing if reopening it failed before
+    if (result == NONCE_STORE_OK &&
+        (!store->index.map || records_header_of(store)->index_generation != store->index_generation ||
+         index_header_of(store)->record_count != count)) {
+        close_file(&store->index);
+        result = open_index(store);
+    }
+
+    if (result != NONCE_STORE_OK) {
+        unlock_records(store);
+    }
+    return result;
+}
+
+// Lookups don't hold the lock: The records file is only ever appended to and the index file is only replaced
+// atomically, so the mappings remain valid. A lookup racing with an insert of another process may miss that hash,
+// just as if it had run before the insert. The lock is only taken to follow changes of other processes.
+static nonce_store_result refresh(nonce_store* const store) {
+    if (is_current(store)) {
+        return NONCE_STORE_OK;
+    }
+    nonce_store_result const result = lock_store(store);
+    if (result == NONCE_STORE_OK) {
+        unlock_records(store);
+    }
+    return result;
+}
+
+// MARK: - Public interface
+
+nonce_store_result nonce_store_open(char const* const path, nonce_store** const store) {
+    if (!path || !store) {
+        return NONCE_STORE_ERROR_INVALID_ARGUMENT;
+    }
+    *store = NULL;
+
+    nonce_store* const opened = calloc(1, sizeof(nonce_store));
+    if (!opened) {
+        return NONCE_STORE_ERROR_OUT_OF_MEMORY;
+    }
+    opened->records.fd = -1;
+    opened->index.fd = -1;
+    opened->records_path = path_with_suffix(path, "");
+    opened->index_path = path_with_suffix(path, "-index");
+    if (!opened->records_path || !opened->index_path) {
+        nonce_store_close(opened);
+        return NONCE_STORE_ERROR_OUT_OF_MEMORY;
+    }
+
+    // Closing the store releases the lock on failure
+    nonce_store_result result = open_records(opened);
+    if (result == NONCE_STORE_OK) {
+        result = open_index(opened);
+    }
+    if (result != NONCE_STORE_OK) {
+        nonce_store_close(opened);
+        return result;
+    }
+    unlock_records(opened);
+
+    *store = opened;
+    return NONCE_STORE_OK;
+}
+
+void nonce_store_close(nonce_store* const store) {
+    if (!store) {
+        return;
+    }
+    if (store->records.map && store->index.map) {
+        nonce_store_sync(store);
+    }
+    close_file(&store->index);
+    close_file(&store->records);
+    free(store->records_path);
+    free(store->index_path);
+    free(store);
+}
+
+// The store must be locked or refreshed
+static int lookup(nonce_store* const store, uint8_t const* const hash) {
+    if (!prefilter_may_contain(prefilter_of(store->index.map), index_header_of(store)->prefilter_blocks, hash)) {
+        store->counters.prefilter_rejections++;
+        return 0;
+    }
+    return index_find(store, hash);
+}
+
+int nonce_store_contains(nonce_store* const store, uint8_t const* const hash) {
+    if (!store || !hash) {
+        return NONCE_STORE_ERROR_INVALID_ARGUMENT;
+    }
+    nonce_store_result const result = refresh(store);
+    if (result != NONCE_STORE_OK) {
+        return result;
+    }
+    return lookup(store, hash);
+}
+
+// MARK: - Batch check
+
+typedef struct {
+    // Index position in the upper half, more hash bits in the lower half. Equal hashes have equal keys.
+    uint64_t key;
+    uint32_t index;
+} batch_entry;
+
+// Stable LSD radix sort by key, 8 bits per pass. Passes where all keys share the same digit are skipped (e.g. the
+// upper bits of the position in a small index).
+static void sort_batch_entries(batch_entry* entries, batch_entry* scratch, size_t const count) {
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {0};
+        for (size_t i = 0; i < count; i++) {
+            offsets[(entries[i].key >> shift) & 0xff]++;
+        }
+        if (offsets[(entries[0].key >> shift) & 0xff] == count) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; digit++) {
+            size_t const digit_count = offsets[digit];
+            offsets[digit] = offset;
+            offset += digit_count;
+        }
+        for (size_t i = 0; i < count; i++) {
+            scratch[offsets[(entries[i].key >> shift) & 0xff]++] = entries[i];
+        }
+
+        batch_entry* const sorted = scratch;
+        scratch = entries;
+        entries = sorted;
+    }
+
+    // An odd number of executed passes leaves the result in the scratch buffer
+    if (scratch < entries) {
+        memcpy(scratch, entries, count * sizeof(batch_entry));
+    }
+}
+
+nonce_store_result nonce_store_check_batch(
+    nonce_store* const store,
+    uint8_t const* const hashes,
+    size_t const count,
+    uint8_t* const statuses
+) {
+    if (!store || ((!hashes || !statuses) && count != 0) || count > UINT32_MAX) {
+        return NONCE_STORE_ERROR_INVALID_ARGUMENT;
+    }
+    if (count == 0) {
+        return NONCE_STORE_OK;
+    }
+
+    // The first half holds the entries, the second one is scratch space for sorting
+    batch_entry* const entries = malloc(count * 2 * sizeof(batch_entry));
+    if (!entries) {
+        return NONCE_STORE_ERROR_OUT_OF_MEMORY;
+    }
+    nonce_store_result const result = refresh(store);
+    if (result != NONCE_STORE_OK) {
+        free(entries);
+        return result;
+    }
+
+    uint64_t const mask = index_header_of(store)->slot_count - 1;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t const* const hash = hashes + i * NONCE_HASH_LENGTH;
+        entries[i].key = ((nonce_load32_le(hash) & mask) << 32) | nonce_load32_le(hash + 4);
+        entries[i].index = (uint32_t) i;
+    }
+    sort_batch_entries(entries, entries + count, count);
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t const index = entries[i].index;
+        uint8_t const* const hash = hashes + (size_t) index * NONCE_HASH_LENGTH;
+
+        // Earlier occurrences of the same hash precede this entry within its run of equal keys, as the sort is stable
+        size_t earlier = i;
+        for (size_t j = i; j > 0 && entries[j - 1].key == entries[i].key; j--) {
+            if (memcmp(hashes + (size_t) entries[j - 1].index * NONCE_HASH_LENGTH, hash, NONCE_HASH_LENGTH) == 0) {
+                earlier = j - 1;
+                break;
+            }
+        }
+        if (earlier != i) {
+            uint8_t const first_status = statuses[entries[earlier].index];
+            statuses[index] = first_status == NONCE_STATUS_STORED ? NONCE_STATUS_STORED : NONCE_STATUS_REPEATED;
+            continue;
+        }
+
+        statuses[index] = lookup(store, hash) == 1 ? NONCE_STATUS_STORED : NONCE_STATUS_NEW;
+    }
+
+    free(entries);
+    return NONCE_STORE_OK;
+}
+
+// MARK: - Insertion
+
+// Append a hash that is known not to be stored. Capacity must have been reserved.
+static void append(nonce_store* const store, uint8_t const* const hash) {
+    records_header* const header = records_header_of(store);
+    uint64_t const record = header->count;
+    memcpy(record_at(store, record), hash, NONCE_HASH_LENGTH);
+    header->count = record + 1;
+    index_records(store, store->index.map, record, record + 1);
+}
+
+int nonce_store_insert(nonce_store* const store, uint8_t const* const hash) {
+    if (!store || !hash) {
+        return NONCE_STORE_ERROR_INVALID_ARGUMENT;
+    }
+    nonce_store_result result = lock_store(store);
+    if (result != NONCE_STORE_OK) {
+        return result;
+    }
+    if (lookup(store, hash) != 0) {
+        unlock_records(store);
+        return 0;
+    }
+
+    result = reserve_records(store, 1);
+    if (result == NONCE_STORE_OK) {
+        result = reserve_index(store, 1);
+    }
+    if (result == NONCE_STORE_OK) {
+        append(store, hash);
+    }
+    unlock_records(store);
+    return result == NONCE_STORE_OK ? 1 : result;
+}
+
+nonce_store_result nonce_store_import(
+    nonce_store* const store,
+    uint8_t const* const hashes,
+    size_t const count,
+    size_t* const imported
+) {
+    if (imported) {
+        *imported = 0;
+    }
+    if (!store || (!hashes && count != 0)) {
+        return NONCE_STORE_ERROR_INVALID_ARGUMENT;
+    }
+
+    nonce_store_result result = lock_store(store);
+    if (result != NONCE_STORE_OK) {
+        return result;
+    }
+
+    // Grow both files once for all hashes that aren't stored yet. This is cheap as almost all of these lookups are
+    // answered by the prefilter.
+    size_t missing = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (lookup(store, hashes + i * NONCE_HASH_LENGTH) == 0) {
+            missing++;
+        }
+    }
+    result = reserve_records(store, missing);
+    if (result == NONCE_STORE_OK) {
+        result = reserve_index(store, missing);
+    }
+    if (result != NONCE_STORE_OK) {
+        unlock_records(store);
+        return result;
+    }
+
+    // Duplicates within `hashes` are caught because every appended hash is indexed immediately
+    size_t added = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t const* const hash = hashes + i * NONCE_HASH_LENGTH;
+        if (lookup(store, hash) == 0) {
+            append(store, hash);
+            added++;
+        }
+    }
+    unlock_records(store);
+
+    if (imported) {
+        *imported = added;
+    }
+    return NONCE_STORE_OK;
+}
+
+nonce_store_result nonce_store_sync(nonce_store* const store) {
+    if (!store) {
+        return NONCE_STORE_ERROR_INVALID_ARGUMENT;
+    }
+
+    // Records first: An index that is ahead of the records is detected and rebuilt on open
+    if (msync(store->records.map, store->records.map_length, MS_SYNC) != 0 ||
+        msync(store->index.map, store->index.map_length, MS_SYNC) != 0) {
+        return NONCE_STORE_ERROR_IO;
+    }
+    return NONCE_STORE_OK;
+}
+
+uint64_t nonce_store_count(nonce_store const* const store) {
+    return store ? records_header_of(store)->count : 0;
+}
+
+void nonce_store_get_stats(nonce_store const* const store, nonce_store_stats* const stats) {
+    if (!store || !stats) {
+        return;
+    }
+    *stats = store->counters;
+    stats->count = records_header_of(store)->count;
+    stats->record_capacity = record_capacity_of(store);
+    stats->index_slots = index_header_of(store)->slot_count;
+    stats->prefilter_bytes = index_header_of(store)->prefilter_blocks * PREFILTER_BLOCK_LENGTH;
+    stats->mapped_bytes = store->records.map_length + store->index.map_length;
+}
@@ -0,0 +1,356 @@
+//  _____ _
+// |_   _| |_  _ _ ___ ___ _ __  __ _
+//   | | | ' \| '_/ -_) -_) '  \/ _` |_
+//   |_| |_||_|_| \___\___|_|_|_\__,_(_)
+//
+// Threema iOS Client
+// Copyright (c) 2025 Threema GmbH
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+// swiftformat:disable:next blankLineAfterImports
+@_implementationOnly import CThreemaNonceStore
+// @_implementationOnly is needed such that we don't need to expose `CThreemaNonceStore` to module clients
+// https://forums.swift.org/t/issue-with-third-party-dependencies-inside-a-xcframework-through-spm/41977/3
+import Foundation
+
+/// Compact on-disk store of hashed nonces
+///
+/// Nonces are hashed with HMAC-SHA256 using our identity as key (same as `NonceHasher`). The key pads are compressed
+/// once when the store is opened, thus hashing a nonce costs two SHA-256 compressions.
+///
+/// Lookups are answered by an in-memory prefilter for almost all nonces that are not stored. Only (probable) hits
+/// touch the memory-mapped index and records files. See `threema-nonce-store.h` for the file layout.
+///
+/// A store is not thread safe, but the same files can be open in several processes at once (e.g. the app and the
+/// notification extension). Inserts lock the files only while they run, and all calls pick up the nonces stored by
+/// other processes.
+public final class ThreemaNonceStore {
+
+    public enum Error: Swift.Error {
+        case invalidArgument
+        case io
+        case corrupt
+        case outOfMemory
+        case full
+        case invalidHashLength
+        case failedToInitializeHasher
+    }
+
+    /// Sizes and counters of a store
+    public struct Statistics: Sendable {
+        /// Number of stored hashed nonces
+        public let count: UInt64
+        /// Number of hashed nonces the records file currently has room for
+        public let recordCapacity: UInt64
+        /// Number of index slots
+        public let indexSlots: UInt64
+        /// Size of the in-memory prefilter in bytes
+        public let prefilterBytes: UInt64
+        /// Total number of mapped bytes
+        public let mappedBytes: UInt64
+        /// Number of lookups answered by the prefilter alone
+        public let prefilterRejections: UInt64
+        /// Number of lookups that needed to probe the index
+        public let indexLookups: UInt64
+        /// Number of records read to confirm a fingerprint match
+        public let recordReads: UInt64
+    }
+
+    /// Status of a nonce in a batch check
+    public enum NonceStatus: Sendable {
+        /// Not processed yet
+        case new
+        /// Already processed
+        case processed
+        /// Not processed yet, but an earlier nonce of the same batch is identical
+        case repeatedInBatch
+    }
+
+    /// Length of a hashed nonce in bytes
+    public static let hashLength = Int(NONCE_HASH_LENGTH)
+
+    // MARK: Private properties
+
+    private let store: OpaquePointer
+    private var hasher: nonce_hasher
+
+    // MARK: - Lifecycle
+
+    /// Open or create the store at `fileURL`
+    ///
+    /// - Parameters:
+    ///   - fileURL: URL of the records file. The index file is placed next to it (`<name>-index`)
+    ///   - identity: Our Threema ID, used as HMAC key for hashing nonces
+    /// - Throws: `ThreemaNonceStore.Error`
+    public init(fileURL: URL, identity: String) throws {
+        var hasher = nonce_hasher()
+        let key = Data(identity.utf8)
+        let hasherResult = key.withUnsafeBytes { keyBytes in
+            nonce_hasher_init(&hasher, keyBytes.baseAddress?.assumingMemoryBound(to: UInt8.self), keyBytes.count)
+        }
+        guard hasherResult == 0 else {
+            throw Error.failedToInitializeHasher
+        }
+
+        var store: OpaquePointer?
+        let result = fileURL.withUnsafeFileSystemRepresentation { path in
+            nonce_store_open(path, &store)
+        }
+        try ThreemaNonceStore.check(result)
+        guard let store else {
+            throw Error.io
+        }
+        self.store = store
+        self.hasher = hasher
+    }
+
+    deinit {
+        nonce_store_close(store)
+        nonce_hasher_clear(&hasher)
+    }
+
+    // MARK: - Nonces
+
+    /// Hash nonce with our identity as key
+    ///
+    /// - Parameter nonce: Nonce to hash
+    /// - Returns: HMAC-SHA256 of `nonce`
+    public func hashedNonce(_ nonce: Data) -> Data {
+        var hash = Data(count: ThreemaNonceStore.hashLength)
+        hash.withUnsafeMutableBytes { hashBytes in
+            nonce.withUnsafeBytes { nonceBytes in
+                nonce_hasher_hash(
+                    &hasher,
+                    nonceBytes.baseAddress?.assumingMemoryBound(to: UInt8.self),
+                    nonceBytes.count,
+                    hashBytes.baseAddress?.assumingMemoryBound(to: UInt8.self)
+                )
+            }
+        }
+        return hash
+    }
+
+    /// Check if the nonce was already processed
+    ///
+    /// - Parameter nonce: Nonce to check
+    /// - Returns: `true` if the hashed nonce is stored
+    /// - Throws: `ThreemaNonceStore.Error`
+    public func isProcessed(nonce: Data) throws -> Bool {
+        try contains(hashedNonce: hashedNonce(nonce))
+    }
+
+    /// Mark nonce as processed
+    ///
+    /// - Parameter nonce: Nonce to store
+    /// - Returns: `true` if the nonce was added, `false` if it was already stored
+    /// - Throws: `ThreemaNonceStore.Error`
+    @discardableResult
+    public func processed(nonce: Data) throws -> Bool {
+        try insert(hashedNonce: hashedNonce(nonce))
+    }
+
+    /// Hash and check many nonces at once, e.g. all messages of the offline queue after reconnecting
+    ///
+    /// Nonces of equal length are hashed with a multi-buffer kernel and all lookups are done in one pass over the
+    /// index. Mark the new nonces as processed afterwards with `importHashedNonces(_:)`, which avoids hashing them
+    /// again.
+    ///
+    /// - Parameter nonces: Nonces to check
+    /// - Returns: Hashed nonce and status for each nonce, in the order of `nonces`
+    /// - Throws: `ThreemaNonceStore.Error`
+    public func check(nonces: [Data]) throws -> [(hashedNonce: Data, status: NonceStatus)] {
+        guard !nonces.isEmpty else {
+            return []
+        }
+
+        let hashLength = ThreemaNonceStore.hashLength
+        var hashes = Data(count: nonces.count * hashLength)
+        hashes.withUnsafeMutableBytes { hashesBytes in
+            guard let hashesBaseAddress = hashesBytes.baseAddress?.assumingMemoryBound(to: UInt8.self) else {
+                return
+            }
+
+            if let nonceLength = nonces.first?.count, nonces.allSatisfy({ $0.count == nonceLength }) {
+                var concatenatedNonces = Data(capacity: nonces.count * nonceLength)
+                for nonce in nonces {
+                    concatenatedNonces.append(nonce)
+                }
+                concatenatedNonces.withUnsafeBytes { noncesBytes in
+                    nonce_hasher_hash_batch(
+                        &hasher,
+                        noncesBytes.baseAddress?.assumingMemoryBound(to: UInt8.self),
+                        nonceLength,
+                        nonces.count,
+                        hashesBaseAddress
+                    )
+                }
+            }
+            else {
+                for (index, nonce) in nonces.enumerated() {
+                    nonce.withUnsafeBytes { nonceBytes in
+                        nonce_hasher_hash(
+                            &hasher,
+                            nonceBytes.baseAddress?.assumingMemoryBound(to: UInt8.self),
+                            nonceBytes.count,
+                            hashesBaseAddress + index * hashLength
+                        )
+                    }
+                }
+            }
+        }
+
+        var statuses = [UInt8](repeating: 0, count: nonces.count)
+        let result = hashes.withUnsafeBytes { hashesBytes in
+            nonce_store_check_batch(
+                store,
+                hashesBytes.baseAddress?.assumingMemoryBound(to: UInt8.self),
+                nonces.count,
+                &statuses
+            )
+        }
+        try ThreemaNonceStore.check(result)
+
+        return statuses.enumerated().map { index, status in
+            let hashedNonce = hashes.subdata(in: (index * hashLength)..<((index + 1) * hashLength))
+            switch UInt32(status) {
+            case NONCE_STATUS_STORED.rawValue:
+                return (hashedNonce, .processed)
+            case NONCE_STATUS_REPEATED.rawValue:
+                return (hashedNonce, .repeatedInBatch)
+            default:
+                return (hashedNonce, .new)
+            }
+        }
+    }
+
+    // MARK: - Hashed nonces
+
+    /// Check if the hashed nonce is stored
+    ///
+    /// - Parameter hashedNonce: Hashed nonce of `hashLength` bytes
+    /// - Returns: `true` if it is stored
+    /// - Throws: `ThreemaNonceStore.Error`
+    public func contains(hashedNonce: Data) throws -> Bool {
+        guard hashedNonce.count == ThreemaNonceStore.hashLength else {
+            throw Error.invalidHashLength
+        }
+
+        let result = hashedNonce.withUnsafeBytes { hashBytes in
+            nonce_store_contains(store, hashBytes.baseAddress?.assumingMemoryBound(to: UInt8.self))
+        }
+        try ThreemaNonceStore.check(result)
+        return result == 1
+    }
+
+    /// Store the hashed nonce
+    ///
+    /// - Parameter hashedNonce: Hashed nonce of `hashLength` bytes
+    /// - Returns: `true` if it was added, `false` if it was already stored
+    /// - Throws: `ThreemaNonceStore.Error`
+    @discardableResult
+    public func insert(hashedNonce: Data) throws -> Bool {
+        guard hashedNonce.count == ThreemaNonceStore.hashLength else {
+            throw Error.invalidHashLength
+        }
+
+        let result = hashedNonce.withUnsafeBytes { hashBytes in
+            nonce_store_insert(store, hashBytes.baseAddress?.assumingMemoryBound(to: UInt8.self))
+        }
+        try ThreemaNonceStore.check(result)
+        return result == 1
+    }
+
+    /// Bulk import of already hashed nonces (e.g. from the existing nonce table)
+    ///
+    /// - Parameter hashedNonces: Hashed nonces of `hashLength` bytes each
+    /// - Returns: Number of hashed nonces that were added. Already stored ones are skipped.
+    /// - Throws: `ThreemaNonceStore.Error`
+    @discardableResult
+    public func importHashedNonces(_ hashedNonces: [Data]) throws -> Int {
+        guard hashedNonces.allSatisfy({ $0.count == ThreemaNonceStore.hashLength }) else {
+            throw Error.invalidHashLength
+        }
+
+        // Concatenate all hashes such that they can be handed over in one call
+        var hashes = Data(capacity: hashedNonces.count * ThreemaNonceStore.hashLength)
+        for hashedNonce in hashedNonces {
+            hashes.append(hashedNonce)
+        }
+
+        var imported = 0
+        let result = hashes.withUnsafeBytes { hashesBytes in
+            nonce_store_import(
+                store,
+                hashesBytes.baseAddress?.assumingMemoryBound(to: UInt8.self),
+                hashedNonces.count,
+                &imported
+            )
+        }
+        try ThreemaNonceStore.check(result.rawValue)
+        return imported
+    }
+
+    // MARK: - Maintenance
+
+    /// Write all changes to disk
+    ///
+    /// - Throws: `ThreemaNonceStore.Error`
+    public func sync() throws {
+        try ThreemaNonceStore.check(nonce_store_sync(store).rawValue)
+    }
+
+    /// Number of stored hashed nonces
+    public var count: Int {
+        Int(nonce_store_count(store))
+    }
+
+    /// Current sizes and counters
+    public var statistics: Statistics {
+        var stats = nonce_store_stats()
+        nonce_store_get_stats(store, &stats)
+        return Statistics(
+            count: stats.count,
+            recordCapacity: stats.record_capacity,
+            indexSlots: stats.index_slots,
+            prefilterBytes: stats.prefilter_bytes,
+            mappedBytes: stats.mapped_bytes,
+            prefilterRejections: stats.prefilter_rejections,
+            indexLookups: stats.index_lookups,
+            recordReads: stats.record_reads
+        )
+    }
+
+    // MARK: - Helper
+
+    private static func check(_ result: nonce_store_result) throws {
+        try check(result.rawValue)
+    }
+
+    private static func check(_ result: Int32) throws {
+        switch result {
+        case _ where result >= 0:
+            return
+        case NONCE_STORE_ERROR_INVALID_ARGUMENT.rawValue:
+            throw Error.invalidArgument
+        case NONCE_STORE_ERROR_CORRUPT.rawValue:
+            throw Error.corrupt
+        case NONCE_STORE_ERROR_OUT_OF_MEMORY.rawValue:
+            throw Error.outOfMemory
+        case NONCE_STORE_ERROR_FULL.rawValue:
+            throw Error.full
+        default:
+            throw Error.io
+        }
+    }
+}
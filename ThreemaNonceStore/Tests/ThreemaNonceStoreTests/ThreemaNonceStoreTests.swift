@@ -0,0 +1,258 @@
+//  _____ _
+// |_   _| |_  _ _ ___ ___ _ __  __ _
+//   | | | ' \| '_/ -_) -_) '  \/ _` |_
+//   |_| |_||_|_| \___\___|_|_|_\__,_(_)
+//
+// Threema iOS Client
+// Copyright (c) 2025 Threema GmbH
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+import CryptoKit
+import XCTest
+@testable import ThreemaNonceStore
+
+final class ThreemaNonceStoreTests: XCTestCase {
+
+    private let identity = "ECHOECHO"
+
+    private var directoryURL: URL!
+    private var storeURL: URL!
+
+    override func setUpWithError() throws {
+        directoryURL = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        try FileManager.default.createDirectory(at: directoryURL, withIntermediateDirectories: true)
+        storeURL = directoryURL.appendingPathComponent("nonces")
+    }
+
+    override func tearDownWithError() throws {
+        try FileManager.default.removeItem(at: directoryURL)
+    }
+
+    // MARK: - Hashing
+
+    func testHashedNonceMatchesHMAC() throws {
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+
+        // Cover the one and two block paddings of the inner hash
+        for length in [0, 24, 55, 56, 64, 100] {
+            let nonce = randomData(count: length)
+            let expected = Data(HMAC<SHA256>.authenticationCode(
+                for: nonce,
+                using: SymmetricKey(data: Data(identity.utf8))
+            ))
+
+            XCTAssertEqual(store.hashedNonce(nonce), expected, "Nonce length \(length)")
+        }
+    }
+
+    // MARK: - Store
+
+    func testProcessed() throws {
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        let nonce = randomData(count: 24)
+
+        XCTAssertFalse(try store.isProcessed(nonce: nonce))
+        XCTAssertTrue(try store.processed(nonce: nonce))
+        XCTAssertTrue(try store.isProcessed(nonce: nonce))
+        XCTAssertFalse(try store.processed(nonce: nonce))
+        XCTAssertEqual(1, store.count)
+    }
+
+    func testReopen() throws {
+        let nonces = (0..<10000).map { _ in randomData(count: 24) }
+
+        do {
+            let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+            for nonce in nonces {
+                try store.processed(nonce: nonce)
+            }
+        }
+
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        XCTAssertEqual(nonces.count, store.count)
+        for nonce in nonces {
+            XCTAssertTrue(try store.isProcessed(nonce: nonce))
+        }
+        XCTAssertFalse(try store.isProcessed(nonce: randomData(count: 24)))
+    }
+
+    func testRebuildMissingIndex() throws {
+        let nonces = (0..<1000).map { _ in randomData(count: 24) }
+
+        do {
+            let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+            for nonce in nonces {
+                try store.processed(nonce: nonce)
+            }
+        }
+
+        try FileManager.default.removeItem(at: directoryURL.appendingPathComponent("nonces-index"))
+
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        for nonce in nonces {
+            XCTAssertTrue(try store.isProcessed(nonce: nonce))
+        }
+    }
+
+    func testMultipleOpenStores() throws {
+        // E.g. the app and the notification extension
+        let appStore = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        let extensionStore = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        let nonce = randomData(count: 24)
+
+        XCTAssertTrue(try extensionStore.processed(nonce: nonce))
+        XCTAssertTrue(try appStore.isProcessed(nonce: nonce))
+        XCTAssertFalse(try appStore.processed(nonce: nonce))
+
+        // Enough nonces to grow the records file and rebuild the index, which the other store must follow
+        let nonces = (0..<10000).map { _ in randomData(count: 24) }
+        for nonce in nonces {
+            try appStore.processed(nonce: nonce)
+        }
+        XCTAssertEqual(nonces.count + 1, extensionStore.count)
+        XCTAssertTrue(try extensionStore.check(nonces: nonces).allSatisfy { $0.status == .processed })
+
+        let lastNonce = randomData(count: 24)
+        XCTAssertTrue(try extensionStore.processed(nonce: lastNonce))
+        XCTAssertTrue(try appStore.isProcessed(nonce: lastNonce))
+        XCTAssertEqual(nonces.count + 2, appStore.count)
+    }
+
+    func testImportHashedNonces() throws {
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        let hashedNonces = (0..<5000).map { _ in randomData(count: ThreemaNonceStore.hashLength) }
+        try store.insert(hashedNonce: hashedNonces[0])
+
+        // Already stored and repeated hashes are skipped
+        let imported = try store.importHashedNonces(hashedNonces + hashedNonces[0..<100])
+
+        XCTAssertEqual(hashedNonces.count - 1, imported)
+        XCTAssertEqual(hashedNonces.count, store.count)
+        for hashedNonce in hashedNonces {
+            XCTAssertTrue(try store.contains(hashedNonce: hashedNonce))
+        }
+    }
+
+    func testCheckNonces() throws {
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        var nonces = (0..<100).map { _ in randomData(count: 24) }
+        try store.processed(nonce: nonces[1])
+        nonces.append(nonces[0])
+        nonces.append(nonces[1])
+
+        let result = try store.check(nonces: nonces)
+
+        XCTAssertEqual(nonces.count, result.count)
+        XCTAssertEqual(.new, result[0].status)
+        XCTAssertEqual(.processed, result[1].status)
+        XCTAssertTrue(result[2..<100].allSatisfy { $0.status == .new })
+        XCTAssertEqual(.repeatedInBatch, result[100].status)
+        XCTAssertEqual(.processed, result[101].status)
+        for (nonce, checked) in zip(nonces, result) {
+            XCTAssertEqual(store.hashedNonce(nonce), checked.hashedNonce)
+        }
+    }
+
+    func testCheckNoncesOfDifferentLength() throws {
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        let nonces = [randomData(count: 24), randomData(count: 16), randomData(count: 80)]
+        try store.processed(nonce: nonces[2])
+
+        let result = try store.check(nonces: nonces)
+
+        XCTAssertEqual([.new, .new, .processed], result.map(\.status))
+        for (nonce, checked) in zip(nonces, result) {
+            XCTAssertEqual(store.hashedNonce(nonce), checked.hashedNonce)
+        }
+    }
+
+    func testInvalidHashLength() throws {
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+
+        XCTAssertThrowsError(try store.insert(hashedNonce: randomData(count: 24))) { error in
+            XCTAssertEqual(error as? ThreemaNonceStore.Error, .invalidHashLength)
+        }
+    }
+
+    // MARK: - Performance
+
+    func testLookupPerformance1M() throws {
+        try lookupPerformance(storedCount: 1_000_000)
+    }
+
+    func testLookupPerformance10M() throws {
+        try lookupPerformance(storedCount: 10_000_000)
+    }
+
+    func testQueuePerformanceSingle() throws {
+        let (store, queue) = try prepareQueue()
+
+        measure {
+            for nonce in queue {
+                _ = try? store.isProcessed(nonce: nonce)
+            }
+        }
+    }
+
+    func testQueuePerformanceBatch() throws {
+        let (store, queue) = try prepareQueue()
+
+        measure {
+            _ = try? store.check(nonces: queue)
+        }
+    }
+
+    /// 1000 message offline queue against a store with 1M nonces
+    private func prepareQueue() throws -> (ThreemaNonceStore, [Data]) {
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+        for _ in 0..<10 {
+            try store.importHashedNonces((0..<100_000).map { _ in randomData(count: ThreemaNonceStore.hashLength) })
+        }
+        return (store, (0..<1000).map { _ in randomData(count: 24) })
+    }
+
+    /// Lookup latency of new (i.e. not stored) nonces, which is the common case for incoming messages
+    private func lookupPerformance(storedCount: Int) throws {
+        let store = try ThreemaNonceStore(fileURL: storeURL, identity: identity)
+
+        // Fill in chunks to keep the memory of the test itself low
+        let chunkSize = 100_000
+        for _ in 0..<(storedCount / chunkSize) {
+            try store.importHashedNonces((0..<chunkSize).map { _ in randomData(count: ThreemaNonceStore.hashLength) })
+        }
+        XCTAssertEqual(storedCount, store.count)
+
+        let nonces = (0..<100_000).map { _ in randomData(count: 24) }
+        measure(metrics: [XCTClockMetric(), XCTMemoryMetric()]) {
+            for nonce in nonces {
+                XCTAssertFalse(try store.isProcessed(nonce: nonce))
+            }
+        }
+
+        let statistics = store.statistics
+        print(
+            "\(storedCount) nonces: prefilter \(statistics.prefilterBytes) bytes, mapped \(statistics.mappedBytes) bytes, \(statistics.prefilterRejections)/\(statistics.prefilterRejections + statistics.indexLookups) lookups answered by prefilter"
+        )
+    }
+
+    // MARK: - Helper
+
+    private func randomData(count: Int) -> Data {
+        var data = Data(count: count)
+        data.withUnsafeMutableBytes { bytes in
+            arc4random_buf(bytes.baseAddress, bytes.count)
+        }
+        return data
+    }
+}
@@ -0,0 +1,491 @@
+/**
+ * C load test: Many CSP connections on a single epoll event loop.
+ *
+ * Connects to the chat server stand-in (see `lib/examples/csp_standin_server.rs`), runs the CSP
+ * handshake for every connection and exchanges echo requests/responses. Socket reads are fed to
+ * libthreema directly from the read buffer and outgoing frames are copied straight into the write
+ * buffer of the connection.
+ *
+ * Build with `tools/build-c.sh`, then run:
+ *
+ *     cargo run -F cli --release --example csp_standin_server
+ *     ./build/c/csp-load-test -k <permanent server public key logged by the stand-in>
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libthreema.h"
+
+/**
+ * Size of the shared read buffer.
+ */
+#define READ_BUFFER_LENGTH 65536
+
+/**
+ * Maximum number of echo requests in flight per connection.
+ */
+#define ECHO_WINDOW 8
+
+/**
+ * Maximum number of events handled per `epoll_wait` call.
+ */
+#define MAX_EVENTS 256
+
+/**
+ * Test parameters.
+ */
+static const char *host = "127.0.0.1";
+static uint16_t port = 5222;
+static size_t connection_count = 1000;
+static size_t echo_count = 100;
+static size_t echo_length = 64;
+
+/**
+ * A CSP connection.
+ */
+struct connection {
+    int fd;
+    LibthreemaCspHandle *csp;
+
+    // Pending bytes to be written to the socket
+    uint8_t *out;
+    size_t out_length;
+    size_t out_offset;
+    size_t out_capacity;
+    bool want_write;
+
+    bool connected;
+    bool handshake_done;
+    bool done;
+    size_t echo_sent;
+    size_t echo_received;
+};
+
+/**
+ * Test state.
+ */
+struct load_test {
+    int epoll_fd;
+    struct connection *connections;
+    size_t handshakes;
+    size_t finished;
+    size_t failed;
+    uint8_t *echo_data;
+    struct timespec start;
+    struct timespec handshakes_end;
+};
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Make sure that enough file descriptors are available for `count` connections.
+ */
+static bool raise_fd_limit(rlim_t count) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return false;
+    }
+    rlim_t required = count + 64;
+    if (limit.rlim_cur >= required) {
+        return true;
+    }
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < required) {
+        return false;
+    }
+    limit.rlim_cur = required;
+    return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+/**
+ * Decode a 32 byte hex encoded key.
+ */
+static bool decode_key(const char *hex, uint8_t key[32]) {
+    if (strlen(hex) != 64) {
+        return false;
+    }
+    for (size_t i = 0; i < 32; i++) {
+        unsigned int byte;
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1) {
+            return false;
+        }
+        key[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
+/**
+ * Tear down a connection and count it as finished or failed.
+ */
+static void close_connection(struct load_test *test, struct connection *c, bool failed) {
+    if (c->done) {
+        return;
+    }
+    c->done = true;
+    epoll_ctl(test->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    libthreema_csp_free(c->csp);
+    c->csp = NULL;
+    free(c->out);
+    c->out = NULL;
+    if (failed) {
+        test->failed++;
+    } else {
+        test->finished++;
+    }
+}
+
+/**
+ * Copy the pending outgoing frame into the write buffer of the connection.
+ */
+static bool take_outgoing_frame(struct connection *c, size_t frame_length) {
+    // Compact or grow the write buffer to fit the frame
+    if (c->out_offset > 0) {
+        memmove(c->out, c->out + c->out_offset, c->out_length - c->out_offset);
+        c->out_length -= c->out_offset;
+        c->out_offset = 0;
+    }
+    if (c->out_capacity - c->out_length < frame_length) {
+        size_t capacity = c->out_length + frame_length;
+        uint8_t *out = realloc(c->out, capacity);
+        if (out == NULL) {
+            return false;
+        }
+        c->out = out;
+        c->out_capacity = capacity;
+    }
+
+    size_t written = 0;
+    LibthreemaCspStatus status = libthreema_csp_take_outgoing_frame(
+        c->csp, c->out + c->out_length, c->out_capacity - c->out_length, &written);
+    if (status != LIBTHREEMA_CSP_STATUS_OK) {
+        printf("    ERROR: Could not take outgoing frame: %d\n", status);
+        return false;
+    }
+    c->out_length += written;
+    return true;
+}
+
+/**
+ * Write as much of the write buffer as possible and watch for writability if anything is left.
+ */
+static bool flush(struct load_test *test, struct connection *c) {
+    while (c->out_offset < c->out_length) {
+        ssize_t length = write(c->fd, c->out + c->out_offset, c->out_length - c->out_offset);
+        if (length < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            printf("    ERROR: Write failed: %s\n", strerror(errno));
+            return false;
+        }
+        c->out_offset += (size_t)length;
+    }
+    bool want_write = c->out_offset < c->out_length;
+    if (want_write != c->want_write) {
+        struct epoll_event event = {
+            .events = EPOLLIN | (want_write ? (uint32_t)EPOLLOUT : 0),
+            .data.ptr = c,
+        };
+        if (epoll_ctl(test->epoll_fd, EPOLL_CTL_MOD, c->fd, &event) != 0) {
+            return false;
+        }
+        c->want_write = want_write;
+    }
+    return true;
+}
+
+/**
+ * Send echo requests until the window is full or all have been sent.
+ */
+static bool send_echo_requests(const struct load_test *test, struct connection *c) {
+    while (c->echo_sent < echo_count && c->echo_sent - c->echo_received < ECHO_WINDOW) {
+        size_t frame_length = 0;
+        LibthreemaCspStatus status = libthreema_csp_create_payload(
+            c->csp, LIBTHREEMA_CSP_OUTGOING_PAYLOAD_TYPE_ECHO_REQUEST, test->echo_data, echo_length,
+            &frame_length);
+        if (status != LIBTHREEMA_CSP_STATUS_OK) {
+            printf("    ERROR: Could not create echo request: %d\n", status);
+            return false;
+        }
+        if (!take_outgoing_frame(c, frame_length)) {
+            return false;
+        }
+        c->echo_sent++;
+    }
+    return true;
+}
+
+/**
+ * Poll the protocol and handle all instructions.
+ */
+static bool handle_instructions(struct load_test *test, struct connection *c) {
+    while (true) {
+        LibthreemaCspInstruction instruction;
+        LibthreemaCspStatus status = libthreema_csp_poll(c->csp, &instruction);
+        if (status == LIBTHREEMA_CSP_STATUS_NO_INSTRUCTION) {
+            return true;
+        }
+        if (status != LIBTHREEMA_CSP_STATUS_OK) {
+            printf("    ERROR: Poll failed: %d\n", status);
+            return false;
+        }
+
+        // Send any outgoing frame
+        if (instruction.outgoing_frame_length > 0
+                && !take_outgoing_frame(c, instruction.outgoing_frame_length)) {
+            return false;
+        }
+
+        // Start exchanging echoes once the handshake is done
+        if (instruction.state_update == LIBTHREEMA_CSP_STATE_UPDATE_KIND_POST_HANDSHAKE) {
+            c->handshake_done = true;
+            if (++test->handshakes == connection_count) {
+                clock_gettime(CLOCK_MONOTONIC, &test->handshakes_end);
+            }
+            if (!send_echo_requests(test, c)) {
+                return false;
+            }
+        }
+
+        // Count echo responses, ignore anything else
+        if (instruction.incoming_payload_type == LIBTHREEMA_CSP_INCOMING_PAYLOAD_TYPE_ECHO_RESPONSE) {
+            if (instruction.incoming_payload_length != echo_length) {
+                printf("    ERROR: Unexpected echo response length: %zu\n",
+                       instruction.incoming_payload_length);
+                return false;
+            }
+            c->echo_received++;
+            if (c->echo_received == echo_count) {
+                return true;
+            }
+            if (!send_echo_requests(test, c)) {
+                return false;
+            }
+        }
+    }
+}
+
+/**
+ * Handle readiness of a connection.
+ */
+static void handle_event(struct load_test *test, struct connection *c, uint32_t events, uint8_t *read_buffer) {
+    // Check the result of the non-blocking connect
+    if (!c->connected) {
+        int error = 0;
+        socklen_t error_length = sizeof(error);
+        if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &error, &error_length) != 0 || error != 0) {
+            printf("    ERROR: Connect failed: %s\n", strerror(error));
+            close_connection(test, c, true);
+            return;
+        }
+        c->connected = true;
+    }
+
+    // Feed everything that has been received
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        while (true) {
+            ssize_t length = read(c->fd, read_buffer, READ_BUFFER_LENGTH);
+            if (length < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                printf("    ERROR: Read failed: %s\n", strerror(errno));
+                close_connection(test, c, true);
+                return;
+            }
+            if (length == 0) {
+                printf("    ERROR: Connection closed by server\n");
+                close_connection(test, c, true);
+                return;
+            }
+            LibthreemaCspStatus status = libthreema_csp_add_chunk(c->csp, read_buffer, (size_t)length);
+            if (status != LIBTHREEMA_CSP_STATUS_OK) {
+                printf("    ERROR: Could not add chunk: %d\n", status);
+                close_connection(test, c, true);
+                return;
+            }
+        }
+        if (!handle_instructions(test, c)) {
+            close_connection(test, c, true);
+            return;
+        }
+    }
+
+    if (!flush(test, c)) {
+        close_connection(test, c, true);
+        return;
+    }
+    if (c->handshake_done && c->echo_received == echo_count && c->out_offset == c->out_length) {
+        close_connection(test, c, false);
+    }
+}
+
+/**
+ * Create a connection, start connecting and queue the client hello.
+ */
+static bool open_connection(struct load_test *test, struct connection *c, const struct sockaddr_in *address,
+                            const uint8_t server_key[32], const uint8_t client_key[32]) {
+    memset(c, 0, sizeof(*c));
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0) {
+        printf("    ERROR: Could not create socket: %s\n", strerror(errno));
+        return false;
+    }
+    int nodelay = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(c->fd, (const struct sockaddr *)address, sizeof(*address)) != 0 && errno != EINPROGRESS) {
+        printf("    ERROR: Could not connect: %s\n", strerror(errno));
+        return false;
+    }
+
+    LibthreemaCspStatus status = libthreema_csp_new(
+        server_key, 1, "ECHOECHO", client_key, "libthreema;csp-load-test;;", NULL, NULL, &c->csp);
+    if (status != LIBTHREEMA_CSP_STATUS_OK) {
+        printf("    ERROR: Could not create CSP protocol: %d\n", status);
+        return false;
+    }
+
+    // The client hello is pending as the first outgoing frame
+    size_t frame_length = 0;
+    if (libthreema_csp_take_outgoing_frame(c->csp, NULL, 0, &frame_length) != LIBTHREEMA_CSP_STATUS_BUFFER_TOO_SMALL
+            || !take_outgoing_frame(c, frame_length)) {
+        printf("    ERROR: Could not take client hello\n");
+        return false;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN | EPOLLOUT, .data.ptr = c };
+    c->want_write = true;
+    return epoll_ctl(test->epoll_fd, EPOLL_CTL_ADD, c->fd, &event) == 0;
+}
+
+/**
+ * Main program.
+ */
+int main(int argc, char *argv[]) {
+    // Parse arguments
+    int opt;
+    const char *server_key_hex = NULL;
+    while ((opt = getopt(argc, argv, "h:p:k:n:m:s:")) != -1) {
+        switch (opt) {
+            case 'h':
+                host = optarg;
+                break;
+            case 'p':
+                port = (uint16_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'k':
+                server_key_hex = optarg;
+                break;
+            case 'n':
+                connection_count = strtoul(optarg, NULL, 10);
+                break;
+            case 'm':
+                echo_count = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                echo_length = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                server_key_hex = NULL;
+                break;
+        }
+    }
+    uint8_t server_key[32];
+    if (server_key_hex == NULL || !decode_key(server_key_hex, server_key)) {
+        fprintf(stderr, "Usage: %s -k SERVER_PUBLIC_KEY [-h IPV4_HOST] [-p PORT] [-n CONNECTIONS] "
+                "[-m ECHOS] [-s ECHO_LENGTH]\n\n", argv[0]);
+        fprintf(stderr, "Note: By default, 1000 connections to 127.0.0.1:5222 exchange 100 echos\n");
+        fprintf(stderr, "      of 64 bytes each.\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("START C CSP LOAD TEST\n");
+
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_port = htons(port) };
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1) {
+        printf("  ERROR: Invalid IPv4 address `%s`\n", host);
+        return EXIT_FAILURE;
+    }
+    if (!raise_fd_limit(connection_count)) {
+        printf("  ERROR: Could not raise the file descriptor limit\n");
+        return EXIT_FAILURE;
+    }
+
+    // The stand-in does not verify the client key
+    uint8_t client_key[32];
+    memset(client_key, 0x42, sizeof(client_key));
+
+    struct load_test test = { .epoll_fd = epoll_create1(0) };
+    test.connections = calloc(connection_count, sizeof(struct connection));
+    test.echo_data = malloc(echo_length > 0 ? echo_length : 1);
+    uint8_t *read_buffer = malloc(READ_BUFFER_LENGTH);
+    if (test.epoll_fd < 0 || test.connections == NULL || test.echo_data == NULL || read_buffer == NULL) {
+        printf("  ERROR: Could not set up the event loop\n");
+        return EXIT_FAILURE;
+    }
+    memset(test.echo_data, 0x23, echo_length);
+
+    // Connect all clients
+    printf("  Connecting %zu clients\n", connection_count);
+    clock_gettime(CLOCK_MONOTONIC, &test.start);
+    for (size_t i = 0; i < connection_count; i++) {
+        if (!open_connection(&test, &test.connections[i], &address, server_key, client_key)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Run the event loop until all connections are done
+    struct epoll_event events[MAX_EVENTS];
+    while (test.finished + test.failed < connection_count) {
+        int count = epoll_wait(test.epoll_fd, events, MAX_EVENTS, 10000);
+        if (count < 0 && errno != EINTR) {
+            printf("  ERROR: epoll_wait failed: %s\n", strerror(errno));
+            return EXIT_FAILURE;
+        }
+        if (count == 0) {
+            printf("  ERROR: Timeout, %zu connections are stuck\n",
+                   connection_count - test.finished - test.failed);
+            return EXIT_FAILURE;
+        }
+        for (int i = 0; i < count; i++) {
+            handle_event(&test, events[i].data.ptr, events[i].events, read_buffer);
+        }
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (test.failed > 0) {
+        printf("  ERROR: %zu of %zu connections failed\n", test.failed, connection_count);
+        return EXIT_FAILURE;
+    }
+    printf("  BENCH: %zu connections: %.0f handshakes/s, %.0f echos/s\n",
+           connection_count,
+           (double)connection_count / elapsed_seconds(&test.start, &test.handshakes_end),
+           (double)(connection_count * echo_count) / elapsed_seconds(&test.start, &end));
+
+    close(test.epoll_fd);
+    free(test.connections);
+    free(test.echo_data);
+    free(read_buffer);
+
+    printf("END C CSP LOAD TEST\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+//! Benchmark Argon2id at the memory and time cost of the identity backup (128 MiB, 8 iterations).
+//!
+//! Compares the `argon2` crate with the single lane used by the identity backup (with and without
+//! reusing the memory) and with four lanes computed on 1, 2 and 4 threads.
+//!
+//! Run with `cargo bench -F bench --bench argon2id_parallel`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::num::NonZeroUsize;
+
+use argon2::{Algorithm, Argon2, Params, Version};
+use criterion::{Criterion, criterion_group, criterion_main};
+use libthreema::id_backup::argon2_bench::{BACKUP_MEMORY_COST, BACKUP_TIME_COST, BackupKdf};
+
+const PASSWORD: &[u8] = b"ThisIsABadPassword";
+const SALT: &[u8] = b"somesalt";
+
+fn argon2id(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("argon2id_backup");
+    let _ = group.sample_size(10);
+
+    // Baseline: The `argon2` crate, allocating the memory for each derivation
+    let argon2 = Argon2::new(
+        Algorithm::Argon2id,
+        Version::V0x13,
+        Params::new(BACKUP_MEMORY_COST, BACKUP_TIME_COST, 1, Some(32)).expect("Parameters must be valid"),
+    );
+    let _ = group.bench_function("argon2_crate_lanes_1", |bencher| {
+        bencher.iter(|| {
+            let mut key = [0; 32];
+            argon2
+                .hash_password_into(PASSWORD, SALT, &mut key)
+                .expect("Argon2id must succeed");
+            key
+        });
+    });
+
+    // Parameters of the identity backup
+    for reuse_memory in [false, true] {
+        let mut kdf = BackupKdf::new(1, NonZeroUsize::MIN, reuse_memory);
+        let name = if reuse_memory {
+            "lanes_1_reused_memory"
+        } else {
+            "lanes_1"
+        };
+        let _ = group.bench_function(name, |bencher| {
+            bencher.iter(|| kdf.derive(PASSWORD, SALT));
+        });
+    }
+
+    // Four lanes, spread across threads
+    for threads in [1, 2, 4] {
+        let mut kdf = BackupKdf::new(
+            4,
+            NonZeroUsize::new(threads).expect("Amount of threads must not be zero"),
+            true,
+        );
+        let _ = group.bench_function(format!("lanes_4_threads_{threads}"), |bencher| {
+            bencher.iter(|| kdf.derive(PASSWORD, SALT));
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, argon2id);
+criterion_main!(benches);
@@ -0,0 +1,88 @@
+//! Benchmark the contact lookup cache under a burst of 100k identities (e.g. incoming messages
+//! from many unknown senders), with and without a small set of frequently looked up identities.
+//!
+//! Also reports the hit, miss and eviction counters of each scenario.
+//!
+//! Run with `cargo bench -F bench --bench contact_lookup_cache`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::hint::black_box;
+
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::{common::ThreemaId, utils::cache_bench::IdentityCache};
+
+const IDENTITY_COUNT: usize = 100_000;
+const HOT_IDENTITY_COUNT: usize = 1000;
+
+fn identities(prefix: char, count: usize) -> Vec<ThreemaId> {
+    (0..count)
+        .map(|index| {
+            ThreemaId::try_from(format!("{prefix}{index:07}").as_str()).expect("Threema ID must be valid")
+        })
+        .collect()
+}
+
+/// Look up and insert each identity once.
+fn burst(identities: &[ThreemaId]) -> IdentityCache {
+    let mut cache = IdentityCache::default();
+    for (value, identity) in (0_u64..).zip(identities) {
+        if black_box(cache.get(*identity)).is_none() {
+            let _ = cache.insert(*identity, value);
+        }
+    }
+    cache
+}
+
+/// Look up and insert each identity once while also looking up one of the hot identities after
+/// each cold identity.
+fn burst_with_hot_set(identities: &[ThreemaId], hot_identities: &[ThreemaId]) -> IdentityCache {
+    let mut cache = IdentityCache::default();
+    for (value, (identity, hot_identity)) in
+        (0_u64..).zip(identities.iter().zip(hot_identities.iter().cycle()))
+    {
+        for identity in [identity, hot_identity] {
+            if black_box(cache.get(*identity)).is_none() {
+                let _ = cache.insert(*identity, value);
+            }
+        }
+    }
+    cache
+}
+
+#[expect(clippy::print_stdout, reason = "Benchmark output")]
+fn report(name: &str, cache: &IdentityCache) {
+    println!(
+        "{name}: {} of at most {} entries, {}",
+        cache.len(),
+        IdentityCache::CAPACITY,
+        cache.stats()
+    );
+}
+
+fn contact_lookup_cache(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("contact_lookup_cache");
+    let _ = group.throughput(Throughput::Elements(IDENTITY_COUNT as u64));
+    let cold_identities = identities('C', IDENTITY_COUNT);
+    let hot_identities = identities('H', HOT_IDENTITY_COUNT);
+
+    report("burst", &burst(&cold_identities));
+    let _ = group.bench_function("burst", |bencher| {
+        bencher.iter(|| burst(&cold_identities));
+    });
+
+    report("burst_with_hot_set", &burst_with_hot_set(&cold_identities, &hot_identities));
+    let _ = group.bench_function("burst_with_hot_set", |bencher| {
+        bencher.iter(|| burst_with_hot_set(&cold_identities, &hot_identities));
+    });
+
+    // Refreshing a full cache without any expired entries
+    let mut cache = burst(&cold_identities);
+    let _ = group.throughput(Throughput::Elements(1));
+    let _ = group.bench_function("refresh_full", |bencher| {
+        bencher.iter(|| cache.refresh());
+    });
+    group.finish();
+}
+
+criterion_group!(benches, contact_lookup_cache);
+criterion_main!(benches);
@@ -0,0 +1,202 @@
+//! Benchmark XChaCha20Poly1305 encryption and SHA-256 hashing of payloads between 1 KiB and 64 MiB
+//! through the one-shot and the streaming UniFFI bindings as well as through the in-place C
+//! bindings.
+//!
+//! The copies at the UniFFI boundary are emulated by copying each byte buffer into and out of a
+//! `Vec`, like UniFFI lowers and lifts them. Also reports the amount of bytes copied (i.e.
+//! allocated) and the peak heap usage of each variant, which stays bounded by the chunk size when
+//! streaming.
+//!
+//! Run with `cargo bench -F bench,c-ffi,uniffi --bench crypto_bindings`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::{
+    alloc::{GlobalAlloc, Layout},
+    ptr,
+    sync::atomic::{AtomicUsize, Ordering},
+};
+use std::alloc::System;
+
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::bindings::{
+    c_ffi::crypto::{CryptoStatus, libthreema_xchacha20_poly1305_encrypt_in_place},
+    uniffi::crypto::{Sha256Hasher, XChaCha20Poly1305StreamEncryptor, sha256, xchacha20_poly1305_encrypt},
+};
+
+/// Global allocator tracking the total, the current and the peak amount of allocated bytes.
+struct CountingAllocator;
+
+static TOTAL_BYTES: AtomicUsize = AtomicUsize::new(0);
+static CURRENT_BYTES: AtomicUsize = AtomicUsize::new(0);
+static PEAK_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+fn allocated(length: usize) {
+    let _ = TOTAL_BYTES.fetch_add(length, Ordering::Relaxed);
+    let current = CURRENT_BYTES
+        .fetch_add(length, Ordering::Relaxed)
+        .saturating_add(length);
+    let _ = PEAK_BYTES.fetch_max(current, Ordering::Relaxed);
+}
+
+fn deallocated(length: usize) {
+    let _ = CURRENT_BYTES.fetch_sub(length, Ordering::Relaxed);
+}
+
+// SAFETY: Forwards to the system allocator, only tracking the amount of allocated bytes.
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        allocated(layout.size());
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::alloc`.
+        unsafe { System.alloc(layout) }
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        deallocated(layout.size());
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::dealloc`.
+        unsafe { System.dealloc(ptr, layout) };
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        allocated(new_size);
+        deallocated(layout.size());
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::realloc`.
+        unsafe { System.realloc(ptr, layout, new_size) }
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+const KEY: [u8; 32] = [0x42; 32];
+const NONCE: [u8; 24] = [0x01; 24];
+const PAYLOAD_LENGTHS: [usize; 4] = [1_024, 65_536, 1_048_576, 67_108_864];
+const CHUNK_LENGTH: usize = 65_536;
+
+/// Emulate UniFFI lowering a byte buffer of the foreign side.
+fn lower(data: &[u8]) -> Vec<u8> {
+    data.to_vec()
+}
+
+/// Emulate UniFFI lifting a byte buffer to the foreign side.
+fn lift(data: &[u8]) -> Vec<u8> {
+    data.to_vec()
+}
+
+/// Encrypt via [`xchacha20_poly1305_encrypt`], lowering the whole payload and lifting the whole
+/// ciphertext.
+fn encrypt_one_shot(payload: &[u8]) -> usize {
+    let ciphertext =
+        xchacha20_poly1305_encrypt(&KEY, &NONCE, lower(payload), &[]).expect("Encryption must succeed");
+    lift(&ciphertext).len()
+}
+
+/// Encrypt via [`XChaCha20Poly1305StreamEncryptor`], lowering and lifting one chunk at a time.
+fn encrypt_streaming(payload: &[u8]) -> usize {
+    let nonce = NONCE.get(..19).expect("Nonce must be at least 19 bytes");
+    let encryptor = XChaCha20Poly1305StreamEncryptor::new(&KEY, nonce).expect("Encryptor must be valid");
+    let mut chunks = payload.chunks(CHUNK_LENGTH).peekable();
+    let mut length: usize = 0;
+    while let Some(chunk) = chunks.next() {
+        let ciphertext = if chunks.peek().is_some() {
+            encryptor.encrypt_chunk(lower(chunk), &[])
+        } else {
+            encryptor.encrypt_last_chunk(lower(chunk), &[])
+        }
+        .expect("Encryption must succeed");
+        length = length.saturating_add(lift(&ciphertext).len());
+    }
+    length
+}
+
+/// Encrypt via [`libthreema_xchacha20_poly1305_encrypt_in_place`] without any copies.
+fn encrypt_in_place(buffer: &mut [u8]) -> usize {
+    let mut tag = [0; 16];
+    // SAFETY: All pointers are valid for the documented amount of bytes.
+    let status = unsafe {
+        libthreema_xchacha20_poly1305_encrypt_in_place(
+            KEY.as_ptr(),
+            NONCE.as_ptr(),
+            buffer.as_mut_ptr(),
+            buffer.len(),
+            ptr::null(),
+            0,
+            tag.as_mut_ptr(),
+        )
+    };
+    assert_eq!(status, CryptoStatus::Ok, "Encryption must succeed");
+    buffer.len().saturating_add(tag.len())
+}
+
+/// Hash via [`sha256`], lowering the whole payload.
+fn hash_one_shot(payload: &[u8]) -> usize {
+    lift(&sha256(&lower(payload))).len()
+}
+
+/// Hash via [`Sha256Hasher`], lowering one chunk at a time.
+fn hash_streaming(payload: &[u8]) -> usize {
+    let hasher = Sha256Hasher::new();
+    for chunk in payload.chunks(CHUNK_LENGTH) {
+        hasher
+            .update(&lower(chunk))
+            .expect("Hasher must not be finalized");
+    }
+    lift(&hasher.finalize().expect("Hasher must not be finalized")).len()
+}
+
+#[expect(clippy::print_stdout, reason = "Benchmark output")]
+fn report_copies<TOperation: FnOnce() -> usize>(name: &str, payload_length: usize, operation: TOperation) {
+    let baseline = CURRENT_BYTES.load(Ordering::Relaxed);
+    PEAK_BYTES.store(baseline, Ordering::Relaxed);
+    let total = TOTAL_BYTES.load(Ordering::Relaxed);
+    let _ = operation();
+    let copied = TOTAL_BYTES.load(Ordering::Relaxed).saturating_sub(total);
+    let peak = PEAK_BYTES.load(Ordering::Relaxed).saturating_sub(baseline);
+    println!("{name}/{payload_length}: Copied {copied} bytes with a peak heap usage of {peak} bytes");
+}
+
+fn xchacha20_poly1305_encrypt_bindings(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("xchacha20_poly1305_encrypt");
+    let _ = group.sample_size(10);
+    for payload_length in PAYLOAD_LENGTHS {
+        let mut payload = vec![0xaa_u8; payload_length];
+        let _ = group.throughput(Throughput::Bytes(payload_length as u64));
+        for (name, variant) in [
+            ("one_shot", encrypt_one_shot as fn(&[u8]) -> usize),
+            ("streaming", encrypt_streaming),
+        ] {
+            report_copies(name, payload_length, || variant(&payload));
+            let _ = group.bench_function(BenchmarkId::new(name, payload_length), |bencher| {
+                bencher.iter(|| variant(&payload));
+            });
+        }
+
+        // Encrypts the (previous) ciphertext, which does not make a difference for the throughput
+        report_copies("in_place", payload_length, || encrypt_in_place(&mut payload));
+        let _ = group.bench_function(BenchmarkId::new("in_place", payload_length), |bencher| {
+            bencher.iter(|| encrypt_in_place(&mut payload));
+        });
+    }
+    group.finish();
+}
+
+fn sha256_bindings(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("sha256");
+    let _ = group.sample_size(10);
+    for payload_length in PAYLOAD_LENGTHS {
+        let payload = vec![0xaa_u8; payload_length];
+        let _ = group.throughput(Throughput::Bytes(payload_length as u64));
+        for (name, variant) in [
+            ("one_shot", hash_one_shot as fn(&[u8]) -> usize),
+            ("streaming", hash_streaming),
+        ] {
+            report_copies(name, payload_length, || variant(&payload));
+            let _ = group.bench_function(BenchmarkId::new(name, payload_length), |bencher| {
+                bencher.iter(|| variant(&payload));
+            });
+        }
+    }
+    group.finish();
+}
+
+criterion_group!(benches, xchacha20_poly1305_encrypt_bindings, sha256_bindings);
+criterion_main!(benches);
@@ -0,0 +1,36 @@
+//! Benchmark draining a backlog of queued incoming messages: Decoding and decrypting 1000 messages
+//! from 20 senders as a batch across all cores, as a batch on a single core and one after another
+//! (deriving the shared secret for each message).
+//!
+//! Run with `cargo bench -F bench --bench csp_e2e_batch`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::{hint::black_box, num::NonZeroUsize};
+use std::thread;
+
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::csp_e2e::incoming_message::batch_bench::QueuedMessages;
+
+const MESSAGE_COUNT: usize = 1000;
+const SENDER_COUNT: usize = 20;
+
+fn csp_e2e_batch(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("csp_e2e_batch");
+    let _ = group.throughput(Throughput::Elements(MESSAGE_COUNT as u64));
+    let messages = QueuedMessages::new(MESSAGE_COUNT, SENDER_COUNT);
+    let workers = thread::available_parallelism().map_or(1, NonZeroUsize::get);
+
+    let _ = group.bench_function("sequential", |bencher| {
+        bencher.iter(|| assert_eq!(black_box(messages.decode_sequentially()), MESSAGE_COUNT));
+    });
+    let _ = group.bench_function("batch_single_worker", |bencher| {
+        bencher.iter(|| assert_eq!(black_box(messages.decode_batch(1)), MESSAGE_COUNT));
+    });
+    let _ = group.bench_function(format!("batch_{workers}_workers"), |bencher| {
+        bencher.iter(|| assert_eq!(black_box(messages.decode_batch(workers)), MESSAGE_COUNT));
+    });
+    group.finish();
+}
+
+criterion_group!(benches, csp_e2e_batch);
+criterion_main!(benches);
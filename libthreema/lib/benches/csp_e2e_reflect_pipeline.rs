@@ -0,0 +1,107 @@
+//! Benchmark reflecting 1000 incoming messages (e.g. after reconnecting in a multi-device setup)
+//! through a mock mediator with a round trip time of 1 ms: Once one by one (i.e. each message
+//! awaiting its `reflect-ack` before the next one is reflected) and once through the
+//! [`ReflectPipeline`] with different batch sizes and windows.
+//!
+//! The throughput is measured until the last CSP `message-ack` could be sent, i.e. until the
+//! reflection of the last message has been acknowledged.
+//!
+//! Run with `cargo bench -F bench --bench csp_e2e_reflect_pipeline`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::time::Duration;
+use std::{sync::mpsc, thread, time::Instant};
+
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::csp_e2e::{
+    ReflectId,
+    reflect::{
+        ReflectFlags, ReflectPayload,
+        pipeline::{ReflectPipeline, ReflectPipelineConfig},
+    },
+};
+
+const MESSAGE_COUNT: u32 = 1000;
+const ENVELOPE_LENGTH: usize = 256;
+const ROUND_TRIP_TIME: Duration = Duration::from_millis(1);
+
+/// Acknowledge each reflected message one round trip time after its batch has been sent.
+fn mock_mediator(batches: &mpsc::Receiver<(Instant, Vec<ReflectId>)>, acks: &mpsc::Sender<ReflectId>) {
+    for (sent_at, reflect_ids) in batches {
+        let acknowledge_at = sent_at.checked_add(ROUND_TRIP_TIME).unwrap_or(sent_at);
+        thread::sleep(acknowledge_at.saturating_duration_since(Instant::now()));
+        for reflect_id in reflect_ids {
+            if acks.send(reflect_id).is_err() {
+                return;
+            }
+        }
+    }
+}
+
+/// Reflect the incoming messages through a pipeline with `config`. Returns the amount of messages
+/// that could be acknowledged towards the chat server.
+fn reflect_incoming_messages(config: ReflectPipelineConfig) -> u32 {
+    let (batches_tx, batches_rx) = mpsc::channel();
+    let (acks_tx, acks_rx) = mpsc::channel();
+    thread::scope(|scope| {
+        let _ = scope.spawn(move || mock_mediator(&batches_rx, &acks_tx));
+
+        // Each incoming message task reflects one `IncomingMessage`
+        let mut pipeline = ReflectPipeline::new(config);
+        for id in 0..MESSAGE_COUNT {
+            let _ = pipeline.submit(vec![ReflectPayload {
+                flags: ReflectFlags::default(),
+                id: ReflectId(id),
+                envelope: vec![0xaa; ENVELOPE_LENGTH],
+            }]);
+        }
+
+        let mut acknowledged: u32 = 0;
+        loop {
+            while let Some(batch) = pipeline.next_batch() {
+                let reflect_ids = batch.reflect_messages.iter().map(|payload| payload.id).collect();
+                batches_tx
+                    .send((Instant::now(), reflect_ids))
+                    .expect("Mediator must be running");
+            }
+            while pipeline.next_completion().is_some() {
+                acknowledged = acknowledged.saturating_add(1);
+            }
+            if acknowledged >= MESSAGE_COUNT {
+                break;
+            }
+
+            // Wait for the next `reflect-ack`, then process all that arrived in the meantime
+            pipeline.reflect_ack(acks_rx.recv().expect("Mediator must be running"));
+            while let Ok(reflect_id) = acks_rx.try_recv() {
+                pipeline.reflect_ack(reflect_id);
+            }
+        }
+        drop(batches_tx);
+        acknowledged
+    })
+}
+
+fn csp_e2e_reflect_pipeline(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("csp_e2e_reflect_pipeline");
+    let _ = group.throughput(Throughput::Elements(u64::from(MESSAGE_COUNT)));
+    let _ = group.sample_size(10);
+
+    for (name, max_batch_size, window) in [
+        ("one_by_one", 1, 1),
+        ("batch_16_window_64", 16, 64),
+        ("batch_64_window_256", 64, 256),
+    ] {
+        let config = ReflectPipelineConfig {
+            max_batch_size,
+            window,
+        };
+        let _ = group.bench_function(name, |bencher| {
+            bencher.iter(|| reflect_incoming_messages(config));
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, csp_e2e_reflect_pipeline);
+criterion_main!(benches);
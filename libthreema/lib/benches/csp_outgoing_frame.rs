@@ -0,0 +1,118 @@
+//! Benchmark encoding and encrypting outgoing payloads into frames via
+//! [`CspProtocol::create_payload`], with and without returning sent frames to the protocol's pool.
+//!
+//! Also reports the number of heap allocations per outgoing frame.
+//!
+//! Run with `cargo bench -F bench --bench csp_outgoing_frame`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::{
+    alloc::{GlobalAlloc, Layout},
+    hint::black_box,
+    sync::atomic::{AtomicUsize, Ordering},
+};
+use std::alloc::System;
+
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::{
+    common::{ClientKey, PublicKey, ThreemaId},
+    csp::{
+        Context, CspProtocol,
+        bench::post_handshake_protocol,
+        payload::{EchoPayload, OutgoingPayload},
+    },
+};
+
+/// Global allocator counting the number of allocations.
+struct CountingAllocator;
+
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+
+// SAFETY: Forwards to the system allocator, only counting allocations.
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let _ = ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::alloc`.
+        unsafe { System.alloc(layout) }
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::dealloc`.
+        unsafe { System.dealloc(ptr, layout) };
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let _ = ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::realloc`.
+        unsafe { System.realloc(ptr, layout, new_size) }
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+const PAYLOAD_LENGTHS: [usize; 3] = [64, 1024, 8192];
+const ALLOCATION_SAMPLE_FRAMES: usize = 1000;
+
+fn protocol() -> CspProtocol {
+    let context = Context::new(
+        vec![PublicKey::from([0x01; PublicKey::LENGTH])],
+        ThreemaId::try_from("ECHOECHO").expect("Threema ID must be valid"),
+        ClientKey::from([0x02; ClientKey::LENGTH]),
+        "bench".to_owned(),
+        None,
+        None,
+    )
+    .expect("Context must be valid");
+    post_handshake_protocol(context)
+}
+
+/// Create an outgoing frame for `payload` and return it to the protocol if `recycle` is set.
+fn create_frame(protocol: &mut CspProtocol, payload: &OutgoingPayload, recycle: bool) {
+    let outgoing_frame = protocol
+        .create_payload(payload)
+        .expect("Creating the payload must succeed")
+        .outgoing_frame
+        .expect("Instruction must contain an outgoing frame");
+    let outgoing_frame = black_box(outgoing_frame);
+    if recycle {
+        protocol.recycle_outgoing_frame(outgoing_frame);
+    }
+}
+
+#[expect(clippy::print_stdout, reason = "Benchmark output")]
+fn report_allocations(name: &str, payload: &OutgoingPayload, recycle: bool) {
+    let mut protocol = protocol();
+
+    // Warm up the pool
+    create_frame(&mut protocol, payload, recycle);
+
+    let before = ALLOCATIONS.load(Ordering::Relaxed);
+    for _ in 0..ALLOCATION_SAMPLE_FRAMES {
+        create_frame(&mut protocol, payload, recycle);
+    }
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed).saturating_sub(before);
+    println!("{name}: {allocations} allocations for {ALLOCATION_SAMPLE_FRAMES} frames");
+}
+
+fn csp_outgoing_frame(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("csp_outgoing_frame");
+    let _ = group.throughput(Throughput::Elements(1));
+
+    for payload_length in PAYLOAD_LENGTHS {
+        let payload = OutgoingPayload::EchoRequest(EchoPayload(vec![0xaa; payload_length]));
+        for (variant, recycle) in [("pooled", true), ("unpooled", false)] {
+            let name = format!("{variant}_{payload_length}");
+            report_allocations(&name, &payload, recycle);
+
+            let mut protocol = protocol();
+            let _ = group.bench_function(&name, |bencher| {
+                bencher.iter(|| create_frame(&mut protocol, &payload, recycle));
+            });
+        }
+    }
+    group.finish();
+}
+
+criterion_group!(benches, csp_outgoing_frame);
+criterion_main!(benches);
@@ -0,0 +1,87 @@
+//! Benchmark the per-frame overhead of tracing on the CSP hot path: Creating an outgoing payload
+//! and polling/feeding the protocol, with no subscriber, a debug level subscriber and a trace
+//! level subscriber.
+//!
+//! Compare a run with the default features against a run with trace level spans and events
+//! compiled out:
+//!
+//! ```sh
+//! cargo bench -F bench --bench csp_tracing
+//! cargo bench -F bench,tracing-max-level-debug --bench csp_tracing
+//! ```
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::hint::black_box;
+use std::io;
+
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::{
+    common::{ClientKey, PublicKey, ThreemaId},
+    csp::{
+        Context, CspProtocol,
+        bench::post_handshake_protocol,
+        payload::{EchoPayload, OutgoingPayload},
+    },
+};
+use tracing::{Level, subscriber};
+use tracing_subscriber::FmtSubscriber;
+
+fn protocol() -> CspProtocol {
+    let context = Context::new(
+        vec![PublicKey::from([0x01; PublicKey::LENGTH])],
+        ThreemaId::try_from("ECHOECHO").expect("Threema ID must be valid"),
+        ClientKey::from([0x02; ClientKey::LENGTH]),
+        "bench".to_owned(),
+        None,
+        None,
+    )
+    .expect("Context must be valid");
+    post_handshake_protocol(context)
+}
+
+/// Run the API calls a client makes per frame.
+fn process_frame(protocol: &mut CspProtocol, payload: &OutgoingPayload) {
+    let outgoing_frame = protocol
+        .create_payload(payload)
+        .expect("Creating the payload must succeed")
+        .outgoing_frame
+        .expect("Instruction must contain an outgoing frame");
+    protocol.recycle_outgoing_frame(black_box(outgoing_frame));
+    protocol.add_chunks(&[]).expect("Adding chunks must succeed");
+    let _ = black_box(protocol.poll().expect("Polling must succeed"));
+    let _ = black_box(
+        protocol
+            .next_required_length()
+            .expect("Querying the next required length must succeed"),
+    );
+}
+
+fn csp_tracing(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("csp_tracing");
+    let _ = group.throughput(Throughput::Elements(1));
+    let payload = OutgoingPayload::EchoRequest(EchoPayload(vec![0xaa; 64]));
+
+    // Without any subscriber
+    let mut protocol = protocol();
+    let _ = group.bench_function("no_subscriber", |bencher| {
+        bencher.iter(|| process_frame(&mut protocol, &payload));
+    });
+
+    // With a subscriber formatting to a sink at the respective level
+    for (name, level) in [("debug_subscriber", Level::DEBUG), ("trace_subscriber", Level::TRACE)] {
+        let subscriber = FmtSubscriber::builder()
+            .with_max_level(level)
+            .with_writer(io::sink)
+            .finish();
+        let mut protocol = protocol();
+        subscriber::with_default(subscriber, || {
+            let _ = group.bench_function(name, |bencher| {
+                bencher.iter(|| process_frame(&mut protocol, &payload));
+            });
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, csp_tracing);
+criterion_main!(benches);
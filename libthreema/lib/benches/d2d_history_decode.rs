@@ -0,0 +1,108 @@
+//! Benchmark decoding `SdToDd` messages received by DD: A `Data` message with 100 incoming
+//! messages and a `common.BlobData` message with a 64 KiB blob.
+//!
+//! Each payload is decoded once by copying every bytes field out of the decrypted payload (i.e.
+//! like decoding into owned `Vec<u8>` fields) and once like the import pipeline does by slicing
+//! them out of a refcounted `Bytes`. Also reports the amount of allocations and allocated bytes per
+//! decoded message (or blob) of each variant.
+//!
+//! Run with `cargo bench -F bench --bench d2d_history_decode`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::{
+    alloc::{GlobalAlloc, Layout},
+    sync::atomic::{AtomicUsize, Ordering},
+};
+use std::alloc::System;
+
+use criterion::{BatchSize, BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::d2d_history::pipeline::bench::{
+    blob_data_payload, data_payload, decode_copying, decode_zero_copy,
+};
+
+/// Global allocator counting the amount of allocations and allocated bytes.
+struct CountingAllocator;
+
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+static ALLOCATED_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+fn allocated(length: usize) {
+    let _ = ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+    let _ = ALLOCATED_BYTES.fetch_add(length, Ordering::Relaxed);
+}
+
+// SAFETY: Forwards to the system allocator, only counting the allocations.
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        allocated(layout.size());
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::alloc`.
+        unsafe { System.alloc(layout) }
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::dealloc`.
+        unsafe { System.dealloc(ptr, layout) };
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        allocated(new_size);
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::realloc`.
+        unsafe { System.realloc(ptr, layout, new_size) }
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+const MESSAGES_PER_DATA: u64 = 100;
+const BODY_LENGTH: usize = 1_024;
+const BLOB_LENGTH: usize = 65_536;
+
+#[expect(clippy::print_stdout, reason = "Benchmark output")]
+#[expect(clippy::integer_division, reason = "Precision is sufficient for the report")]
+fn report_allocations(name: &str, payload: &[u8], decode: fn(Vec<u8>) -> usize) {
+    // The payload is handed over by the receiving stage, so its allocation does not count
+    let payload = payload.to_vec();
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed);
+    let allocated_bytes = ALLOCATED_BYTES.load(Ordering::Relaxed);
+    let decoded = decode(payload).max(1);
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed).saturating_sub(allocations);
+    let allocated_bytes = ALLOCATED_BYTES
+        .load(Ordering::Relaxed)
+        .saturating_sub(allocated_bytes);
+    println!(
+        "{name}: {} allocations ({} bytes) per decoded message",
+        allocations / decoded,
+        allocated_bytes / decoded,
+    );
+}
+
+fn d2d_history_decode(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("d2d_history_decode");
+    for (name, payload, elements) in [
+        (
+            "data",
+            data_payload(MESSAGES_PER_DATA, BODY_LENGTH),
+            MESSAGES_PER_DATA,
+        ),
+        ("blob_data", blob_data_payload(BLOB_LENGTH), 1),
+    ] {
+        let _ = group.throughput(Throughput::Elements(elements));
+        for (variant, decode) in [
+            (
+                "copying",
+                (|payload: Vec<u8>| decode_copying(&payload)) as fn(Vec<u8>) -> usize,
+            ),
+            ("zero_copy", decode_zero_copy),
+        ] {
+            report_allocations(&format!("{name}/{variant}"), &payload, decode);
+            let _ = group.bench_function(BenchmarkId::new(name, variant), |bencher| {
+                bencher.iter_batched(|| payload.clone(), decode, BatchSize::SmallInput);
+            });
+        }
+    }
+    group.finish();
+}
+
+criterion_group!(benches, d2d_history_decode);
+criterion_main!(benches);
@@ -0,0 +1,225 @@
+//! Benchmark a loopback transfer of the conversation history from SD to DD through the export and
+//! import pipelines, backed by in-memory stores on both ends.
+//!
+//! Also reports the achieved messages/s and bytes/s of a single transfer.
+//!
+//! Run with `cargo bench -F bench --bench d2d_history_transfer`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use std::{collections::HashMap, sync::mpsc, thread, time::Instant};
+
+use bytes::Bytes;
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::{
+    common::{BlobId, Conversation, MessageId, ThreemaId},
+    d2d_history::{
+        BlobStore, HistoryError, HistoryMessage, HistoryMessageDirection, HistoryRow, HistorySink,
+        HistoryStore, HistorySummary, HistoryTransferRequest, Timespan,
+        pipeline::{self, PipelineConfig, TransferStats},
+    },
+    d2d_rendezvous::{AuthenticationKey, OutgoingFrame, RendezvousProtocol},
+};
+
+const MESSAGE_COUNT: u64 = 10_000;
+const BODY_LENGTH: usize = 200;
+
+/// Every n-th message refers to a blob.
+const BLOB_INTERVAL: u64 = 10;
+const BLOB_LENGTH: usize = 65_536;
+
+/// Conversation history of SD, held in memory.
+struct MemoryStore {
+    rows: Vec<(HistoryMessage, Vec<BlobId>)>,
+    blobs: HashMap<BlobId, Vec<u8>>,
+}
+impl MemoryStore {
+    fn new() -> Self {
+        let identity = ThreemaId::try_from("ECHOECHO").expect("Threema ID must be valid");
+        let mut blobs = HashMap::new();
+        let rows = (0..MESSAGE_COUNT)
+            .map(|index| {
+                let direction = if index & 1 == 0 {
+                    HistoryMessageDirection::Incoming {
+                        sender_identity: identity,
+                        received_at: index,
+                    }
+                } else {
+                    HistoryMessageDirection::Outgoing {
+                        conversation: Conversation::Contact(identity),
+                        sent_at: index,
+                    }
+                };
+                let mut blob_ids = vec![];
+                if index.checked_rem(BLOB_INTERVAL) == Some(0) {
+                    let mut blob_id = [0; BlobId::LENGTH];
+                    blob_id
+                        .get_mut(..8)
+                        .expect("Blob ID must be at least 8 bytes")
+                        .copy_from_slice(&index.to_le_bytes());
+                    let _ = blobs.insert(BlobId(blob_id), vec![0xaa; BLOB_LENGTH]);
+                    blob_ids.push(BlobId(blob_id));
+                }
+                let message = HistoryMessage {
+                    id: MessageId(index),
+                    direction,
+                    created_at: index,
+                    message_type: 0x01,
+                    body: Bytes::from(vec![0x42; BODY_LENGTH]),
+                    read_at: Some(index),
+                };
+                (message, blob_ids)
+            })
+            .collect();
+        Self { rows, blobs }
+    }
+}
+impl HistoryStore for &MemoryStore {
+    fn summary(&mut self, _timespan: Timespan, _include_media: bool) -> Result<HistorySummary, HistoryError> {
+        Ok(HistorySummary {
+            messages: u32::try_from(self.rows.len()).expect("Message count must fit into a u32"),
+            size: 0,
+        })
+    }
+
+    fn messages(
+        &mut self,
+        _timespan: Timespan,
+    ) -> Result<Box<dyn Iterator<Item = Result<HistoryRow, HistoryError>> + Send + '_>, HistoryError> {
+        Ok(Box::new(self.rows.iter().map(|(message, blob_ids)| {
+            Ok(HistoryRow {
+                message: message.clone(),
+                blob_ids: blob_ids.clone(),
+            })
+        })))
+    }
+}
+impl BlobStore for &MemoryStore {
+    fn blob(&mut self, blob_id: &BlobId) -> Result<Option<Vec<u8>>, HistoryError> {
+        Ok(self.blobs.get(blob_id).cloned())
+    }
+}
+
+/// Conversation history of DD, held in memory.
+#[derive(Default)]
+struct MemorySink {
+    messages: HashMap<MessageId, HistoryMessage>,
+    blobs: HashMap<BlobId, Bytes>,
+}
+impl HistorySink for MemorySink {
+    fn store_message(&mut self, message: HistoryMessage) -> Result<(), HistoryError> {
+        let _ = self.messages.insert(message.id, message);
+        Ok(())
+    }
+
+    fn store_blob(&mut self, blob_id: BlobId, data: Bytes) -> Result<(), HistoryError> {
+        let _ = self.blobs.insert(blob_id, data);
+        Ok(())
+    }
+}
+
+fn process(protocol: &mut RendezvousProtocol, frame: OutgoingFrame) -> Option<OutgoingFrame> {
+    let frame = Vec::<u8>::from(frame);
+    protocol
+        .add_chunks(1, &[frame.as_slice()])
+        .expect("Adding chunks must succeed");
+    protocol
+        .process_frame(1)
+        .expect("Processing the frame must succeed")
+        .expect("Frame must be complete")
+        .outgoing_frame
+}
+
+/// Create SD (as RID) and DD (as RRD, nominator) with a nominated path.
+fn connect() -> (RendezvousProtocol, RendezvousProtocol) {
+    let mut sd = RendezvousProtocol::new_as_rid(false, AuthenticationKey([0x42; 32]), &[1]);
+    let (mut dd, initial_outgoing_frames) =
+        RendezvousProtocol::new_as_rrd(true, AuthenticationKey([0x42; 32]), &[1]);
+    for (_, hello) in initial_outgoing_frames {
+        let auth_hello = process(&mut sd, hello).expect("AuthHello must be sent");
+        let auth = process(&mut dd, auth_hello).expect("Auth must be sent");
+        let _ = process(&mut sd, auth);
+    }
+    let nominate = dd
+        .nominate_path(1)
+        .expect("Nomination must succeed")
+        .outgoing_frame
+        .expect("Nominate must be sent");
+    let _ = process(&mut sd, nominate);
+    (sd, dd)
+}
+
+/// Export the conversation history on SD and import it on DD concurrently.
+fn transfer(store: &MemoryStore, config: PipelineConfig) -> TransferStats {
+    let (mut sd, mut dd) = connect();
+    let request = HistoryTransferRequest {
+        timespan: Timespan {
+            from: 0,
+            to: MESSAGE_COUNT,
+        },
+        include_media: true,
+        messages: u32::try_from(MESSAGE_COUNT).expect("Message count must fit into a u32"),
+    };
+    let (frames_tx, frames_rx) = mpsc::sync_channel(config.queue_capacity);
+    let mut sink = MemorySink::default();
+
+    let (exported, imported) = thread::scope(|scope| {
+        let exporting = scope.spawn(move || {
+            let (mut rows, mut blobs) = (store, store);
+            pipeline::export(config, &request, &mut rows, &mut blobs, &mut sd, |pid, frame, _flushed| {
+                frames_tx
+                    .send((pid, Vec::<u8>::from(frame)))
+                    .map_err(|_| HistoryError::TransportFailed("Closed".to_owned()))
+            })
+        });
+        let imported = pipeline::import(
+            config,
+            request.timespan,
+            &mut dd,
+            || Ok(frames_rx.recv().ok()),
+            &mut sink,
+        );
+        (exporting.join().expect("Export must not panic"), imported)
+    });
+    let exported = exported.expect("Export must succeed");
+    let imported = imported.expect("Import must succeed");
+    assert_eq!(exported, imported, "All messages and blobs must be transferred");
+    assert_eq!(sink.messages.len(), store.rows.len());
+    imported
+}
+
+#[expect(clippy::print_stdout, reason = "Benchmark output")]
+fn report_transfer_rate(name: &str, store: &MemoryStore, config: PipelineConfig) {
+    let started_at = Instant::now();
+    let stats = transfer(store, config);
+    let elapsed = started_at.elapsed().as_secs_f64();
+    #[expect(clippy::cast_precision_loss, reason = "Only used for reporting")]
+    let (messages, bytes) = (stats.messages as f64, stats.bytes as f64);
+    println!(
+        "{name}: Transferred {} messages, {} blobs and {} bytes at {:.0} messages/s and {:.0} bytes/s",
+        stats.messages,
+        stats.blobs,
+        stats.bytes,
+        messages / elapsed,
+        bytes / elapsed,
+    );
+}
+
+fn d2d_history_transfer(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("d2d_history_transfer");
+    let _ = group.throughput(Throughput::Elements(MESSAGE_COUNT));
+    let _ = group.sample_size(10);
+    let store = MemoryStore::new();
+
+    for queue_capacity in [1, 64] {
+        let name = format!("queue_capacity_{queue_capacity}");
+        let config = PipelineConfig { queue_capacity };
+        report_transfer_rate(&name, &store, config);
+        let _ = group.bench_function(name, |bencher| {
+            bencher.iter(|| transfer(&store, config));
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, d2d_history_transfer);
+criterion_main!(benches);
@@ -0,0 +1,167 @@
+//! Benchmark a loopback transfer of 1 GiB of ULP data from RID to RRD: Once streamed in records of
+//! 64 KiB via [`RendezvousProtocol::write_ulp_stream`] and once as ULP payloads of 64 MiB via
+//! [`RendezvousProtocol::create_ulp_frame`].
+//!
+//! Also reports the peak heap usage of each variant (as a proxy for the peak RSS), which must stay
+//! bounded by a few records when streaming, regardless of the amount of data transferred.
+//!
+//! Run with `cargo bench -F bench --bench d2d_rendezvous_streaming`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::{
+    alloc::{GlobalAlloc, Layout},
+    sync::atomic::{AtomicUsize, Ordering},
+};
+use std::alloc::System;
+
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::d2d_rendezvous::{AuthenticationKey, OutgoingFrame, PathProcessResult, RendezvousProtocol};
+
+/// Global allocator tracking the current and the peak amount of allocated bytes.
+struct PeakAllocator;
+
+static CURRENT_BYTES: AtomicUsize = AtomicUsize::new(0);
+static PEAK_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+fn allocated(length: usize) {
+    let current = CURRENT_BYTES.fetch_add(length, Ordering::Relaxed).saturating_add(length);
+    let _ = PEAK_BYTES.fetch_max(current, Ordering::Relaxed);
+}
+
+fn deallocated(length: usize) {
+    let _ = CURRENT_BYTES.fetch_sub(length, Ordering::Relaxed);
+}
+
+// SAFETY: Forwards to the system allocator, only tracking the amount of allocated bytes.
+unsafe impl GlobalAlloc for PeakAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        allocated(layout.size());
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::alloc`.
+        unsafe { System.alloc(layout) }
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        deallocated(layout.size());
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::dealloc`.
+        unsafe { System.dealloc(ptr, layout) };
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        allocated(new_size);
+        deallocated(layout.size());
+        // SAFETY: The caller upholds the contract of `GlobalAlloc::realloc`.
+        unsafe { System.realloc(ptr, layout, new_size) }
+    }
+}
+
+#[global_allocator]
+static GLOBAL: PeakAllocator = PeakAllocator;
+
+const PID: u32 = 1;
+const TRANSFER_LENGTH: usize = 1_073_741_824;
+const WRITE_LENGTH: usize = 65_536;
+const PAYLOAD_LENGTH: usize = 67_108_864;
+
+/// Run the handshake and nominate the path, with ULP streaming enabled if `streaming`.
+fn connect(streaming: bool) -> (RendezvousProtocol, RendezvousProtocol) {
+    let mut rid = RendezvousProtocol::new_as_rid(true, AuthenticationKey([0x42; 32]), &[PID]);
+    let (mut rrd, initial_outgoing_frames) =
+        RendezvousProtocol::new_as_rrd(false, AuthenticationKey([0x42; 32]), &[PID]);
+    if streaming {
+        rid.enable_ulp_streaming()
+            .expect("Enabling ULP streaming must succeed");
+        rrd.enable_ulp_streaming()
+            .expect("Enabling ULP streaming must succeed");
+    }
+
+    for (_, hello) in initial_outgoing_frames {
+        let auth_hello = deliver(&mut rid, hello)
+            .outgoing_frame
+            .expect("AuthHello must be sent");
+        let auth = deliver(&mut rrd, auth_hello)
+            .outgoing_frame
+            .expect("Auth must be sent");
+        let _ = deliver(&mut rid, auth);
+    }
+    let nominate = rid
+        .nominate_path(PID)
+        .expect("Nomination must succeed")
+        .outgoing_frame
+        .expect("Nominate must be sent");
+    let _ = deliver(&mut rrd, nominate);
+    (rid, rrd)
+}
+
+fn deliver(protocol: &mut RendezvousProtocol, frame: OutgoingFrame) -> PathProcessResult {
+    let (header, payload) = frame.encode();
+    protocol
+        .add_chunks(PID, &[header.as_slice(), payload])
+        .expect("Adding chunks must succeed");
+    protocol
+        .process_frame(PID)
+        .expect("Processing the frame must succeed")
+        .expect("Frame must be complete")
+}
+
+/// Transfer `TRANSFER_LENGTH` bytes from RID to RRD. Returns the amount of bytes received.
+fn transfer(streaming: bool) -> usize {
+    let (mut rid, mut rrd) = connect(streaming);
+    let mut received: usize = 0;
+    if streaming {
+        // Write from a reused buffer and deliver each record immediately
+        let buffer = vec![0xaa_u8; WRITE_LENGTH];
+        for offset in (0..TRANSFER_LENGTH).step_by(WRITE_LENGTH) {
+            let end_of_payload = offset.saturating_add(WRITE_LENGTH) >= TRANSFER_LENGTH;
+            for (_, result) in rid
+                .write_ulp_stream(&buffer, end_of_payload)
+                .expect("Writing to the ULP stream must succeed")
+            {
+                let frame = result.outgoing_frame.expect("ULP frame must be sent");
+                let ulp_data = deliver(&mut rrd, frame)
+                    .incoming_ulp_data
+                    .expect("ULP data must be received");
+                received = received.saturating_add(ulp_data.len());
+            }
+        }
+    } else {
+        for _ in (0..TRANSFER_LENGTH).step_by(PAYLOAD_LENGTH) {
+            let frame = rid
+                .create_ulp_frame(vec![0xaa; PAYLOAD_LENGTH])
+                .expect("Creating a ULP frame must succeed")
+                .outgoing_frame
+                .expect("ULP frame must be sent");
+            let ulp_data = deliver(&mut rrd, frame)
+                .incoming_ulp_data
+                .expect("ULP data must be received");
+            received = received.saturating_add(ulp_data.len());
+        }
+    }
+    assert_eq!(received, TRANSFER_LENGTH, "All ULP data must be received");
+    received
+}
+
+#[expect(clippy::print_stdout, reason = "Benchmark output")]
+fn report_peak_heap_usage(name: &str, streaming: bool) {
+    let baseline = CURRENT_BYTES.load(Ordering::Relaxed);
+    PEAK_BYTES.store(baseline, Ordering::Relaxed);
+    let _ = transfer(streaming);
+    let peak = PEAK_BYTES.load(Ordering::Relaxed).saturating_sub(baseline);
+    println!("{name}: Peak heap usage of {peak} bytes while transferring {TRANSFER_LENGTH} bytes");
+}
+
+fn d2d_rendezvous_streaming(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("d2d_rendezvous_streaming");
+    let _ = group.throughput(Throughput::Bytes(TRANSFER_LENGTH as u64));
+    let _ = group.sample_size(10);
+
+    for (name, streaming) in [("payloads", false), ("streaming", true)] {
+        report_peak_heap_usage(name, streaming);
+        let _ = group.bench_function(name, |bencher| {
+            bencher.iter(|| transfer(streaming));
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, d2d_rendezvous_streaming);
+criterion_main!(benches);
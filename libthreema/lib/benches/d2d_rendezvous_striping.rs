@@ -0,0 +1,193 @@
+//! Benchmark a loopback transfer of ULP data (e.g. a device join history transfer) between RID and
+//! RRD over throttled paths: Once over the fastest path only and once striped across all paths.
+//!
+//! The paths are simulated in virtual time (one tick per millisecond) with a fixed bandwidth and
+//! latency each, so the reported transfer durations are deterministic. Criterion measures the CPU
+//! time of running the protocol for the whole transfer.
+//!
+//! Run with `cargo bench -F bench --bench d2d_rendezvous_striping`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use std::collections::VecDeque;
+
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::d2d_rendezvous::{
+    AuthenticationKey, OutgoingFrame, PathProcessResult, RendezvousProtocol, StripingPolicy,
+};
+
+const FRAME_LENGTH: usize = 65_536;
+const FRAME_COUNT: usize = 128;
+
+/// Simulated paths as `(pid, bytes per tick, latency in ticks)`: A direct LAN path and a relayed
+/// path with half the bandwidth and a much higher latency.
+const PATHS: [(u32, usize, u64); 2] = [(1, 4096, 2), (2, 2048, 30)];
+
+const STRIPING_POLICY: StripingPolicy = StripingPolicy {
+    max_paths: 2,
+    max_in_flight_bytes: 262_144,
+    max_reorder_frames: 1024,
+};
+
+/// A path with a fixed bandwidth and latency.
+struct ThrottledPath {
+    pid: u32,
+    bytes_per_tick: usize,
+    latency_ticks: u64,
+
+    /// Frames being transmitted with the amount of bytes left to transmit.
+    transmitting: VecDeque<(Vec<u8>, usize)>,
+
+    /// Transmitted frames with the tick they arrive at.
+    in_transit: VecDeque<(u64, Vec<u8>)>,
+}
+
+fn process(protocol: &mut RendezvousProtocol, pid: u32, frame: OutgoingFrame) -> PathProcessResult {
+    let frame = Vec::<u8>::from(frame);
+    protocol
+        .add_chunks(pid, &[frame.as_slice()])
+        .expect("Adding chunks must succeed");
+    protocol
+        .process_frame(pid)
+        .expect("Processing the frame must succeed")
+        .expect("Frame must be complete")
+}
+
+/// Run the handshakes on all paths and nominate the first path or, if `striped`, all paths.
+fn connect(striped: bool) -> (RendezvousProtocol, RendezvousProtocol) {
+    let pids: Vec<u32> = PATHS.iter().map(|(pid, _, _)| *pid).collect();
+    let mut rid = RendezvousProtocol::new_as_rid(true, AuthenticationKey([0x42; 32]), &pids);
+    let (mut rrd, initial_outgoing_frames) =
+        RendezvousProtocol::new_as_rrd(false, AuthenticationKey([0x42; 32]), &pids);
+    if striped {
+        rid.enable_striping(STRIPING_POLICY)
+            .expect("Enabling striping must succeed");
+        rrd.enable_striping(STRIPING_POLICY)
+            .expect("Enabling striping must succeed");
+    }
+
+    for (pid, hello) in initial_outgoing_frames {
+        let auth_hello = process(&mut rid, pid, hello)
+            .outgoing_frame
+            .expect("AuthHello must be sent");
+        let auth = process(&mut rrd, pid, auth_hello)
+            .outgoing_frame
+            .expect("Auth must be sent");
+        let _ = process(&mut rid, pid, auth);
+    }
+
+    let nominated_pids = if striped {
+        pids.as_slice()
+    } else {
+        pids.get(..1).expect("At least one path must exist")
+    };
+    for pid in nominated_pids {
+        let nominate = rid
+            .nominate_path(*pid)
+            .expect("Nomination must succeed")
+            .outgoing_frame
+            .expect("Nominate must be sent");
+        let _ = process(&mut rrd, *pid, nominate);
+    }
+    (rid, rrd)
+}
+
+/// Transfer `FRAME_COUNT` frames from RID to RRD. Returns the amount of ticks it took.
+fn transfer(striped: bool) -> u64 {
+    let (mut rid, mut rrd) = connect(striped);
+    let mut paths: Vec<ThrottledPath> = PATHS
+        .iter()
+        .map(|(pid, bytes_per_tick, latency_ticks)| ThrottledPath {
+            pid: *pid,
+            bytes_per_tick: *bytes_per_tick,
+            latency_ticks: *latency_ticks,
+            transmitting: VecDeque::new(),
+            in_transit: VecDeque::new(),
+        })
+        .collect();
+
+    let mut tick: u64 = 0;
+    let mut n_sent: usize = 0;
+    let mut n_received: usize = 0;
+    while n_received < FRAME_COUNT {
+        // Create frames until all paths are congested
+        while n_sent < FRAME_COUNT && !rid.is_congested() {
+            let (pid, result) = rid
+                .create_striped_ulp_frame(vec![0xaa; FRAME_LENGTH])
+                .expect("Creating a ULP frame must succeed");
+            let frame = Vec::<u8>::from(result.outgoing_frame.expect("ULP frame must be sent"));
+            let path = paths
+                .iter_mut()
+                .find(|path| path.pid == pid)
+                .expect("Path must exist");
+            let length = frame.len();
+            path.transmitting.push_back((frame, length));
+            n_sent = n_sent.saturating_add(1);
+        }
+
+        for path in &mut paths {
+            // Transmit as many bytes as the bandwidth allows
+            let mut budget = path.bytes_per_tick;
+            while budget > 0 {
+                let Some((_, remaining)) = path.transmitting.front_mut() else {
+                    break;
+                };
+                let transmitted = budget.min(*remaining);
+                *remaining = remaining.saturating_sub(transmitted);
+                budget = budget.saturating_sub(transmitted);
+                if *remaining == 0 {
+                    let (frame, _) = path.transmitting.pop_front().expect("Frame must exist");
+                    rid.ulp_frame_flushed(path.pid)
+                        .expect("Flushing the frame must succeed");
+                    path.in_transit
+                        .push_back((tick.saturating_add(path.latency_ticks), frame));
+                }
+            }
+
+            // Deliver frames that arrived
+            while path
+                .in_transit
+                .front()
+                .is_some_and(|(arrives_at, _)| *arrives_at <= tick)
+            {
+                let (_, frame) = path.in_transit.pop_front().expect("Frame must exist");
+                rrd.add_chunks(path.pid, &[frame.as_slice()])
+                    .expect("Adding chunks must succeed");
+                while let Some(result) = rrd
+                    .process_frame(path.pid)
+                    .expect("Processing the frame must succeed")
+                {
+                    if result.incoming_ulp_data.is_some() {
+                        n_received = n_received.saturating_add(1);
+                    }
+                }
+            }
+        }
+        tick = tick.saturating_add(1);
+    }
+    tick
+}
+
+#[expect(clippy::print_stdout, reason = "Benchmark output")]
+fn report_transfer_duration(name: &str, striped: bool) {
+    let ticks = transfer(striped);
+    println!(
+        "{name}: Transferred {FRAME_COUNT} frames of {FRAME_LENGTH} bytes in {ticks}ms (simulated)"
+    );
+}
+
+fn d2d_rendezvous_striping(criterion: &mut Criterion) {
+    let mut group = criterion.benchmark_group("d2d_rendezvous_striping");
+    let _ = group.throughput(Throughput::Bytes((FRAME_LENGTH as u64).saturating_mul(FRAME_COUNT as u64)));
+    let _ = group.sample_size(10);
+
+    for (name, striped) in [("single_path", false), ("striped", true)] {
+        report_transfer_duration(name, striped);
+        let _ = group.bench_function(name, |bencher| {
+            bencher.iter(|| transfer(striped));
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, d2d_rendezvous_striping);
+criterion_main!(benches);
@@ -0,0 +1,75 @@
+//! Benchmark decoding a burst of variable length frames arriving in random chunk sizes, e.g. a CSP
+//! connection delivering many small messages at once.
+//!
+//! Run with `cargo bench -F bench --bench frame_decoder`.
+#![expect(unused_crate_dependencies, reason = "Benchmark triggered false positive")]
+
+use core::hint::black_box;
+
+use criterion::{Criterion, Throughput, criterion_group, criterion_main};
+use libthreema::utils::frame_bench::U16FrameDecoder;
+use rand::{Rng as _, SeedableRng as _, rngs::StdRng};
+
+const FRAME_COUNT: usize = 10_000;
+
+/// Encode `FRAME_COUNT` frames with random lengths in `frame_lengths` and split the resulting
+/// stream into chunks with random lengths of up to `max_chunk_length` bytes.
+fn random_chunks(rng: &mut StdRng, frame_lengths: (usize, usize), max_chunk_length: usize) -> Vec<Vec<u8>> {
+    let mut data = vec![];
+    for _ in 0..FRAME_COUNT {
+        let length = rng.gen_range(frame_lengths.0..=frame_lengths.1);
+        data.extend_from_slice(
+            &u16::try_from(length)
+                .expect("Frame length must fit into a u16")
+                .to_le_bytes(),
+        );
+        data.extend((0..length).map(|_| rng.gen_range(0..=u8::MAX)));
+    }
+
+    let mut chunks = vec![];
+    let mut remaining = data.as_slice();
+    while !remaining.is_empty() {
+        let (chunk, rest) = remaining.split_at(rng.gen_range(1..=remaining.len().min(max_chunk_length)));
+        chunks.push(chunk.to_vec());
+        remaining = rest;
+    }
+    chunks
+}
+
+/// Add all chunks to the decoder, decoding all available frames after each chunk.
+fn decode(chunks: &[Vec<u8>]) -> usize {
+    let mut decoder = U16FrameDecoder::new(usize::from(u16::MAX));
+    let mut frames: usize = 0;
+    for chunk in chunks {
+        let _ = decoder.add_chunks(&[chunk]);
+        while let Some(length) = decoder
+            .next_frame_and_then(|frame| black_box(frame).len())
+            .expect("Frame must not exceed the maximum length")
+        {
+            let _ = black_box(length);
+            frames = frames.saturating_add(1);
+        }
+    }
+    frames
+}
+
+fn frame_decoder(criterion: &mut Criterion) {
+    let mut rng = StdRng::seed_from_u64(0x00c0_ffee);
+    let mut group = criterion.benchmark_group("variable_length_frame_decoder");
+    let _ = group.throughput(Throughput::Elements(FRAME_COUNT as u64));
+
+    for (name, frame_lengths, max_chunk_length) in [
+        ("small_frames_small_chunks", (16, 256), 512),
+        ("small_frames_large_chunks", (16, 256), 65_536),
+        ("large_frames_small_chunks", (4096, 8192), 1500),
+    ] {
+        let chunks = random_chunks(&mut rng, frame_lengths, max_chunk_length);
+        let _ = group.bench_function(name, |bencher| {
+            bencher.iter(|| assert_eq!(decode(&chunks), FRAME_COUNT));
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, frame_decoder);
+criterion_main!(benches);
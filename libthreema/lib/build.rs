@@ -8,17 +8,24 @@ use uniffi as _;
 fn main() -> Result<()> {
     // Compile protobuf
     println!("cargo:rerun-if-changed=../threema-protocols/src/");
-    prost_build::Config::new().enable_type_names().compile_protos(
-        &[
-            "../threema-protocols/src/common.proto",
-            "../threema-protocols/src/csp-e2e.proto",
-            "../threema-protocols/src/md-d2d.proto",
-            "../threema-protocols/src/md-d2d-sync.proto",
-            "../threema-protocols/src/md-d2d-rendezvous.proto",
-            "../threema-protocols/src/md-d2m.proto",
-        ],
-        &["../threema-protocols/src/"],
-    )?;
+    //
+    // Note: Bytes fields of messages on the hot path are decoded as `Bytes`, slicing the
+    // (refcounted) decrypted payload instead of copying message bodies, nonces and blobs out of it.
+    prost_build::Config::new()
+        .enable_type_names()
+        .bytes([".common.BlobData", ".d2d.IncomingMessage", ".d2d.OutgoingMessage"])
+        .compile_protos(
+            &[
+                "../threema-protocols/src/common.proto",
+                "../threema-protocols/src/csp-e2e.proto",
+                "../threema-protocols/src/md-d2d.proto",
+                "../threema-protocols/src/md-d2d-sync.proto",
+                "../threema-protocols/src/md-d2d-history.proto",
+                "../threema-protocols/src/md-d2d-rendezvous.proto",
+                "../threema-protocols/src/md-d2m.proto",
+            ],
+            &["../threema-protocols/src/"],
+        )?;
 
     // Done
     Ok(())
@@ -0,0 +1,272 @@
+//! Minimal stand-in for the chat server, e.g. to load test clients of the Chat Server Protocol
+//! without a real chat server.
+//!
+//! It runs the server side of the handshake, answers echo requests and drops any other payload.
+//! The vouch of the client is not verified, so any identity and client key will be accepted.
+#![expect(unused_crate_dependencies, reason = "Example triggered false positive")]
+
+use core::{net::SocketAddr, ops::Range};
+use std::io;
+
+use anyhow::{Context as _, Result, anyhow, bail};
+use cipher::{consts::U10, generic_array::GenericArray};
+use clap::Parser;
+use crypto_secretbox::{
+    XSalsa20Poly1305,
+    aead::{AeadInPlace as _, KeyInit as _},
+};
+use data_encoding::HEXLOWER;
+use libthreema::utils::logging::init_stderr_logging;
+use rand::RngCore as _;
+use salsa20::hsalsa;
+use tokio::{
+    io::{AsyncReadExt as _, AsyncWriteExt as _, BufReader},
+    net::{
+        TcpListener, TcpStream,
+        tcp::{OwnedReadHalf, OwnedWriteHalf},
+    },
+    task,
+};
+use tracing::{Level, debug, info, warn};
+use x25519_dalek::{PublicKey, StaticSecret};
+
+const COOKIE_LENGTH: usize = 16;
+const KEY_LENGTH: usize = 32;
+const TAG_LENGTH: usize = 16;
+const CLIENT_HELLO_LENGTH: usize = KEY_LENGTH + COOKIE_LENGTH;
+const LOGIN_DATA_BOX_LENGTH: usize = 128 + TAG_LENGTH;
+const LOGIN_DATA_EXTENSIONS_LENGTH_RANGE: Range<usize> = 38..40;
+const LOGIN_DATA_REPEATED_SERVER_COOKIE_RANGE: Range<usize> = 40..40 + COOKIE_LENGTH;
+const PAYLOAD_HEADER_LENGTH: usize = 4;
+const PAYLOAD_TYPE_ECHO_REQUEST: u8 = 0x00;
+const PAYLOAD_TYPE_ECHO_RESPONSE: u8 = 0x80;
+
+/// Run a chat server stand-in
+#[derive(Parser)]
+#[command()]
+struct Main {
+    /// Address to listen on
+    #[arg(long, default_value = "127.0.0.1:5222")]
+    listen_address: SocketAddr,
+
+    /// The server's permanent secret key (32 bytes hex encoded). A random key is generated if not
+    /// provided.
+    #[arg(long)]
+    permanent_server_secret_key: Option<String>,
+}
+
+/// Create a NaCl compatible box cipher from a secret and a public key (X25519 and HSalsa20).
+fn box_cipher(secret_key: &StaticSecret, public_key: &PublicKey) -> XSalsa20Poly1305 {
+    let shared_secret = secret_key.diffie_hellman(public_key);
+    let key = hsalsa::<U10>(
+        GenericArray::from_slice(shared_secret.as_bytes()),
+        &GenericArray::default(),
+    );
+    XSalsa20Poly1305::new(&key)
+}
+
+/// Concatenate a cookie and a u64-le sequence number to a nonce.
+fn nonce(cookie: &[u8; COOKIE_LENGTH], sequence_number: u64) -> Vec<u8> {
+    [cookie.as_slice(), &sequence_number.to_le_bytes()].concat()
+}
+
+fn random_cookie() -> [u8; COOKIE_LENGTH] {
+    let mut cookie = [0_u8; COOKIE_LENGTH];
+    rand::thread_rng().fill_bytes(&mut cookie);
+    cookie
+}
+
+/// Transport encryption of an established connection.
+struct Session {
+    cipher: XSalsa20Poly1305,
+    client_cookie: [u8; COOKIE_LENGTH],
+    client_sequence_number: u64,
+    server_cookie: [u8; COOKIE_LENGTH],
+    server_sequence_number: u64,
+}
+
+impl Session {
+    fn encrypt(&mut self, mut data: Vec<u8>) -> Result<Vec<u8>> {
+        let nonce = nonce(&self.server_cookie, self.server_sequence_number);
+        self.server_sequence_number = self
+            .server_sequence_number
+            .checked_add(1)
+            .context("Server sequence number overflow")?;
+        self.cipher
+            .encrypt_in_place(GenericArray::from_slice(&nonce), &[], &mut data)
+            .map_err(|_| anyhow!("Encryption failed"))?;
+        Ok(data)
+    }
+
+    fn decrypt(&mut self, mut data: Vec<u8>) -> Result<Vec<u8>> {
+        let nonce = nonce(&self.client_cookie, self.client_sequence_number);
+        self.client_sequence_number = self
+            .client_sequence_number
+            .checked_add(1)
+            .context("Client sequence number overflow")?;
+        self.cipher
+            .decrypt_in_place(GenericArray::from_slice(&nonce), &[], &mut data)
+            .map_err(|_| anyhow!("Decryption failed"))?;
+        Ok(data)
+    }
+}
+
+async fn read_exact(reader: &mut BufReader<OwnedReadHalf>, length: usize) -> Result<Vec<u8>> {
+    let mut buffer = vec![0_u8; length];
+    let _ = reader.read_exact(&mut buffer).await?;
+    Ok(buffer)
+}
+
+/// Run the server side of the handshake:
+///
+/// ```txt
+/// C -- client-hello -> S
+/// C <- server-hello -- S
+/// C ---- login ---- -> S
+/// C <-- login-ack ---- S
+/// ```
+async fn run_handshake(
+    permanent_server_key: &StaticSecret,
+    reader: &mut BufReader<OwnedReadHalf>,
+    writer: &mut OwnedWriteHalf,
+) -> Result<Session> {
+    // Receive the client hello
+    let client_hello = read_exact(reader, CLIENT_HELLO_LENGTH).await?;
+    let (temporary_client_key, client_cookie) = client_hello.split_at(KEY_LENGTH);
+    let temporary_client_key = PublicKey::from(<[u8; KEY_LENGTH]>::try_from(temporary_client_key)?);
+    let client_cookie = <[u8; COOKIE_LENGTH]>::try_from(client_cookie)?;
+
+    // Send the server hello, containing the encrypted server challenge response
+    let temporary_server_key = StaticSecret::random_from_rng(rand::thread_rng());
+    let server_cookie = random_cookie();
+    let mut server_challenge_response = [
+        PublicKey::from(&temporary_server_key).as_bytes().as_slice(),
+        &client_cookie,
+    ]
+    .concat();
+    box_cipher(permanent_server_key, &temporary_client_key)
+        .encrypt_in_place(
+            GenericArray::from_slice(&nonce(&server_cookie, 1)),
+            &[],
+            &mut server_challenge_response,
+        )
+        .map_err(|_| anyhow!("Encrypting the server challenge response failed"))?;
+    writer
+        .write_all(&[server_cookie.as_slice(), &server_challenge_response].concat())
+        .await?;
+
+    // Receive the login
+    let mut session = Session {
+        cipher: box_cipher(&temporary_server_key, &temporary_client_key),
+        client_cookie,
+        client_sequence_number: 1,
+        server_cookie,
+        server_sequence_number: 2,
+    };
+    let login_data = session.decrypt(read_exact(reader, LOGIN_DATA_BOX_LENGTH).await?)?;
+    let identity = login_data.get(..8).context("Login data too short")?;
+    let extensions_length = login_data
+        .get(LOGIN_DATA_EXTENSIONS_LENGTH_RANGE)
+        .context("Login data too short")?;
+    let extensions_length = u16::from_le_bytes(extensions_length.try_into()?);
+    let repeated_server_cookie = login_data
+        .get(LOGIN_DATA_REPEATED_SERVER_COOKIE_RANGE)
+        .context("Login data too short")?;
+    if repeated_server_cookie != server_cookie {
+        bail!("Repeated server cookie does not match");
+    }
+    let _extensions = session.decrypt(read_exact(reader, usize::from(extensions_length)).await?)?;
+    debug!(identity = %String::from_utf8_lossy(identity), "Client logged in");
+
+    // Send the login ack (reserved, current time, no queued messages)
+    let login_ack_data = [[0_u8; 4].as_slice(), &0_u64.to_le_bytes(), &0_u32.to_le_bytes()].concat();
+    writer.write_all(&session.encrypt(login_ack_data)?).await?;
+    Ok(session)
+}
+
+/// Answer echo requests until the client disconnects.
+async fn run_payload_flow(
+    mut session: Session,
+    reader: &mut BufReader<OwnedReadHalf>,
+    writer: &mut OwnedWriteHalf,
+) -> Result<()> {
+    loop {
+        let length = match reader.read_u16_le().await {
+            Ok(length) => length,
+            Err(error) if error.kind() == io::ErrorKind::UnexpectedEof => return Ok(()),
+            Err(error) => return Err(error.into()),
+        };
+        let payload = session.decrypt(read_exact(reader, usize::from(length)).await?)?;
+        let Some((&payload_type, _)) = payload.split_first() else {
+            bail!("Empty payload");
+        };
+        if payload_type != PAYLOAD_TYPE_ECHO_REQUEST {
+            debug!(payload_type, "Dropping payload");
+            continue;
+        }
+
+        // Respond with an echo response carrying the same data
+        let data = payload.get(PAYLOAD_HEADER_LENGTH..).context("Payload too short")?;
+        let response = session.encrypt(
+            [
+                [PAYLOAD_TYPE_ECHO_RESPONSE, 0, 0, 0].as_slice(),
+                data,
+            ]
+            .concat(),
+        )?;
+        let response_length = u16::try_from(response.len())?;
+        writer
+            .write_all(&[response_length.to_le_bytes().as_slice(), &response].concat())
+            .await?;
+    }
+}
+
+async fn run_connection(permanent_server_key: &StaticSecret, stream: TcpStream) -> Result<()> {
+    stream.set_nodelay(true)?;
+    let (reader, mut writer) = stream.into_split();
+    let mut reader = BufReader::new(reader);
+    let session = run_handshake(permanent_server_key, &mut reader, &mut writer).await?;
+    run_payload_flow(session, &mut reader, &mut writer).await
+}
+
+#[tokio::main]
+async fn main() -> Result<()> {
+    // Configure logging
+    init_stderr_logging(Level::INFO);
+
+    // Parse arguments
+    let main = Main::parse();
+    let permanent_server_key = match main.permanent_server_secret_key {
+        Some(key) => {
+            let key: [u8; KEY_LENGTH] = HEXLOWER
+                .decode(key.as_bytes())?
+                .try_into()
+                .map_err(|_| anyhow!("Permanent server secret key must be {KEY_LENGTH} bytes"))?;
+            StaticSecret::from(key)
+        },
+        None => StaticSecret::random_from_rng(rand::thread_rng()),
+    };
+
+    // Accept connections
+    let listener = TcpListener::bind(main.listen_address).await?;
+    info!(
+        listen_address = %main.listen_address,
+        permanent_server_key = HEXLOWER.encode(PublicKey::from(&permanent_server_key).as_bytes()),
+        "Chat server stand-in running",
+    );
+    loop {
+        let (stream, address) = listener.accept().await?;
+        let permanent_server_key = permanent_server_key.clone();
+        let _ = task::spawn(async move {
+            if let Err(error) = run_connection(&permanent_server_key, stream).await {
+                warn!(%address, %error, "Connection failed");
+            }
+        });
+    }
+}
+
+#[test]
+fn verify_cli() {
+    use clap::CommandFactory;
+    Main::command().debug_assert();
+}
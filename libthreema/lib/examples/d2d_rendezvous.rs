@@ -13,7 +13,8 @@ use anyhow::Context as _;
 use data_encoding::HEXLOWER;
 use libthreema::{
     d2d_rendezvous::{
-        AuthenticationKey, OutgoingFrame, PathProcessResult, PathStateUpdate, RendezvousProtocol,
+        AuthenticationKey, NominationPolicy, OutgoingFrame, PathProcessResult, PathStateUpdate,
+        RendezvousProtocol,
     },
     utils::logging::init_stderr_logging,
 };
@@ -64,13 +65,38 @@ fn run_protocol(
         tx.send(outgoing_frame)?;
     }
 
+    // Let the protocol nominate the path with the lowest RTT, if we're the nominator
+    if protocol.is_nominator() {
+        protocol
+            .enable_automatic_nomination(NominationPolicy::default())
+            .context("Failed to enable automatic nomination")?;
+    }
+
     // Nomination loop where we run the handshakes simultaneously over all available paths until we
     // have nominated one path.
     info!("Entering nomination loop");
     let (nominated_pid, rph) = 'nomination: loop {
-        // Receive and process incoming frame
-        let (pid, incoming_frame) = rx.recv().context("Failed to receive incoming frame")?;
-        let mut maybe_result = process_incoming_frame(&mut protocol, pid, &incoming_frame)?;
+        let (pid, mut maybe_result) =
+            if let Some((pid, result)) = protocol.poll_nomination().context("Failed to nominate")? {
+                // Automatic nomination is due
+                (pid, Some(result))
+            } else {
+                // Receive incoming frame (or wake up when automatic nomination is due)
+                let (pid, incoming_frame) = match protocol.nomination_timeout() {
+                    Some(timeout) => match rx.recv_timeout(timeout) {
+                        Ok(incoming) => incoming,
+                        Err(RecvTimeoutError::Timeout) => continue,
+                        Err(RecvTimeoutError::Disconnected) => {
+                            return Err(RecvTimeoutError::Disconnected)
+                                .context("Failed to receive incoming frame")?;
+                        },
+                    },
+                    None => rx.recv().context("Failed to receive incoming frame")?,
+                };
+
+                // Process incoming frame
+                (pid, process_incoming_frame(&mut protocol, pid, &incoming_frame)?)
+            };
 
         // Handle results
         while let Some(result) = maybe_result {
@@ -86,19 +112,14 @@ fn run_protocol(
             // Handle any state update
             maybe_result = match result.state_update {
                 Some(PathStateUpdate::AwaitingNominate { measured_rtt }) => {
-                    // Check if we should nominate the path
-                    //
-                    // Note: A real implementation should wait a bit and then choose the _best_ path
-                    // based on the measured RTT.
+                    // The path will be nominated by `poll_nomination` once all paths completed
+                    // their handshake or the deadline passed.
                     trace!(?measured_rtt, "Path ready to nominate");
-                    if protocol.is_nominator() {
-                        Some(protocol.nominate_path(pid).context("Failed to nominate")?)
-                    } else {
-                        None
-                    }
+                    None
                 },
-                Some(PathStateUpdate::Nominated { rph }) => {
+                Some(PathStateUpdate::Nominated { rph, measured_rtt }) => {
                     // The path was nominated
+                    info!(pid, ?measured_rtt, "Path nominated");
                     break 'nomination (pid, rph);
                 },
                 None => None,
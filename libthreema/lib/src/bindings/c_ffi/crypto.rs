@@ -0,0 +1,418 @@
+//! C bindings for the AEAD ciphers that encrypt and decrypt buffers of the caller in-place.
+//!
+//! The Poly1305 MAC (aka _tag_) is detached from the data: It is written to a separate 16 byte
+//! buffer when encrypting and read from it when decrypting. To produce and consume the combined
+//! format of the UniFFI and WASM bindings without copying, place the data and the tag in one
+//! buffer of the caller and pass both parts of it.
+use core::{ptr, slice};
+
+use tracing::error;
+
+use crate::crypto::{
+    aead::AeadInPlace,
+    chacha20,
+    cipher::KeyInit,
+    consts::{U16, U24},
+    salsa20,
+};
+
+/// Length of the key in bytes.
+const KEY_LENGTH: usize = 32;
+
+/// Length of the nonce in bytes.
+const NONCE_LENGTH: usize = 24;
+
+/// Length of the Poly1305 tag in bytes.
+const TAG_LENGTH: usize = 16;
+
+/// Result status of a crypto binding function.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum CryptoStatus {
+    /// The call succeeded.
+    Ok = 0,
+
+    /// A required pointer argument is null.
+    NullArgument = 1,
+
+    /// Unable to encrypt/decrypt.
+    CipherFailed = 2,
+}
+
+/// Borrow `length` bytes at `data` mutably. A null pointer is accepted for an empty slice.
+///
+/// # Safety
+///
+/// Unless `length` is `0`, `data` must be valid for reads and writes of `length` bytes for the
+/// returned lifetime and not be accessed by anything else.
+unsafe fn borrow_slice_mut<'data>(data: *mut u8, length: usize) -> Result<&'data mut [u8], CryptoStatus> {
+    if length == 0 {
+        return Ok(&mut []);
+    }
+    if data.is_null() {
+        error!("Data argument is null");
+        return Err(CryptoStatus::NullArgument);
+    }
+    // SAFETY: The caller guarantees that `data` is valid for reads and writes of `length` bytes.
+    Ok(unsafe { slice::from_raw_parts_mut(data, length) })
+}
+
+/// Borrow `length` bytes at `data`. A null pointer is accepted for an empty slice.
+///
+/// # Safety
+///
+/// Unless `length` is `0`, `data` must be valid for reads of `length` bytes for the returned
+/// lifetime.
+unsafe fn borrow_slice<'data>(data: *const u8, length: usize) -> Result<&'data [u8], CryptoStatus> {
+    if length == 0 {
+        return Ok(&[]);
+    }
+    if data.is_null() {
+        error!("Data argument is null");
+        return Err(CryptoStatus::NullArgument);
+    }
+    // SAFETY: The caller guarantees that `data` is valid for reads of `length` bytes.
+    Ok(unsafe { slice::from_raw_parts(data, length) })
+}
+
+/// Borrow exactly `N` bytes at `data`.
+///
+/// # Safety
+///
+/// `data` must be null or valid for reads of `N` bytes.
+unsafe fn borrow_array<const N: usize>(data: *const u8) -> Result<[u8; N], CryptoStatus> {
+    if data.is_null() {
+        error!("Array argument is null");
+        return Err(CryptoStatus::NullArgument);
+    }
+    // SAFETY: The caller guarantees that `data` is valid for reads of `N` bytes and `[u8; N]` has
+    // an alignment of 1.
+    Ok(unsafe { data.cast::<[u8; N]>().read() })
+}
+
+/// Unwrap the status of a `Result` returning from a binding function.
+macro_rules! try_status {
+    ($result:expr) => {
+        match $result {
+            Ok(value) => value,
+            Err(status) => return status,
+        }
+    };
+}
+
+/// Encrypt `data` in-place and write the tag to `tag`.
+///
+/// # Safety
+///
+/// See [`libthreema_xchacha20_poly1305_encrypt_in_place`].
+unsafe fn encrypt_in_place<TCipher>(
+    key: *const u8,
+    nonce: *const u8,
+    data: *mut u8,
+    data_length: usize,
+    associated_data: &[u8],
+    tag: *mut u8,
+) -> CryptoStatus
+where
+    TCipher: AeadInPlace<NonceSize = U24, TagSize = U16> + KeyInit,
+{
+    // SAFETY: The caller guarantees that `key` is valid for reads of 32 bytes.
+    let key = try_status!(unsafe { borrow_array::<KEY_LENGTH>(key) });
+    // SAFETY: The caller guarantees that `nonce` is valid for reads of 24 bytes.
+    let nonce = try_status!(unsafe { borrow_array::<NONCE_LENGTH>(nonce) });
+    // SAFETY: The caller guarantees that `data` is valid for reads and writes of `data_length`
+    // bytes.
+    let data = try_status!(unsafe { borrow_slice_mut(data, data_length) });
+    if tag.is_null() {
+        error!("Tag argument is null");
+        return CryptoStatus::NullArgument;
+    }
+
+    let Ok(cipher) = TCipher::new_from_slice(&key) else {
+        return CryptoStatus::CipherFailed;
+    };
+    let Ok(computed_tag) = cipher.encrypt_in_place_detached((&nonce).into(), associated_data, data) else {
+        return CryptoStatus::CipherFailed;
+    };
+
+    // SAFETY: `tag` is not null and the caller guarantees that it is valid for writes of 16 bytes.
+    unsafe { ptr::copy_nonoverlapping(computed_tag.as_ptr(), tag, TAG_LENGTH) };
+    CryptoStatus::Ok
+}
+
+/// Decrypt `data` in-place after verifying it against `tag`.
+///
+/// # Safety
+///
+/// See [`libthreema_xchacha20_poly1305_decrypt_in_place`].
+unsafe fn decrypt_in_place<TCipher>(
+    key: *const u8,
+    nonce: *const u8,
+    data: *mut u8,
+    data_length: usize,
+    associated_data: &[u8],
+    tag: *const u8,
+) -> CryptoStatus
+where
+    TCipher: AeadInPlace<NonceSize = U24, TagSize = U16> + KeyInit,
+{
+    // SAFETY: The caller guarantees that `key` is valid for reads of 32 bytes.
+    let key = try_status!(unsafe { borrow_array::<KEY_LENGTH>(key) });
+    // SAFETY: The caller guarantees that `nonce` is valid for reads of 24 bytes.
+    let nonce = try_status!(unsafe { borrow_array::<NONCE_LENGTH>(nonce) });
+    // SAFETY: The caller guarantees that `tag` is valid for reads of 16 bytes.
+    let tag = try_status!(unsafe { borrow_array::<TAG_LENGTH>(tag) });
+    // SAFETY: The caller guarantees that `data` is valid for reads and writes of `data_length`
+    // bytes.
+    let data = try_status!(unsafe { borrow_slice_mut(data, data_length) });
+
+    let Ok(cipher) = TCipher::new_from_slice(&key) else {
+        return CryptoStatus::CipherFailed;
+    };
+    match cipher.decrypt_in_place_detached((&nonce).into(), associated_data, data, (&tag).into()) {
+        Ok(()) => CryptoStatus::Ok,
+        Err(_) => CryptoStatus::CipherFailed,
+    }
+}
+
+/// Encrypt `data` in-place using XChaCha20 and write the Poly1305 MAC to `tag`.
+///
+/// Parameters:
+///
+/// - `key`: The 32 byte key.
+/// - `nonce`: The 24 byte nonce.
+/// - `data`: The plaintext of `data_length` bytes, replaced by the ciphertext of the same length.
+/// - `associated_data`: Associated data of `associated_data_length` bytes, or null if empty.
+/// - `tag`: Receives the 16 byte Poly1305 MAC.
+///
+/// # Safety
+///
+/// All pointers must be null or valid for reads (`data` also for writes, `tag` only for writes) of
+/// the documented amount of bytes. `data` must not overlap with any other argument.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_xchacha20_poly1305_encrypt_in_place(
+    key: *const u8,
+    nonce: *const u8,
+    data: *mut u8,
+    data_length: usize,
+    associated_data: *const u8,
+    associated_data_length: usize,
+    tag: *mut u8,
+) -> CryptoStatus {
+    // SAFETY: The caller guarantees that `associated_data` is valid for reads of
+    // `associated_data_length` bytes.
+    let associated_data = try_status!(unsafe { borrow_slice(associated_data, associated_data_length) });
+    // SAFETY: The caller upholds the contract of this function.
+    unsafe {
+        encrypt_in_place::<chacha20::XChaCha20Poly1305>(key, nonce, data, data_length, associated_data, tag)
+    }
+}
+
+/// Verify `data` against the Poly1305 MAC in `tag` and decrypt it in-place using XChaCha20.
+///
+/// Parameters:
+///
+/// - `key`: The 32 byte key.
+/// - `nonce`: The 24 byte nonce.
+/// - `data`: The ciphertext of `data_length` bytes, replaced by the plaintext of the same length.
+/// - `associated_data`: Associated data of `associated_data_length` bytes, or null if empty.
+/// - `tag`: The 16 byte Poly1305 MAC.
+///
+/// Returns [`CryptoStatus::CipherFailed`] if the MAC does not match.
+///
+/// # Safety
+///
+/// All pointers must be null or valid for reads (`data` also for writes) of the documented amount
+/// of bytes. `data` must not overlap with any other argument.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_xchacha20_poly1305_decrypt_in_place(
+    key: *const u8,
+    nonce: *const u8,
+    data: *mut u8,
+    data_length: usize,
+    associated_data: *const u8,
+    associated_data_length: usize,
+    tag: *const u8,
+) -> CryptoStatus {
+    // SAFETY: The caller guarantees that `associated_data` is valid for reads of
+    // `associated_data_length` bytes.
+    let associated_data = try_status!(unsafe { borrow_slice(associated_data, associated_data_length) });
+    // SAFETY: The caller upholds the contract of this function.
+    unsafe {
+        decrypt_in_place::<chacha20::XChaCha20Poly1305>(key, nonce, data, data_length, associated_data, tag)
+    }
+}
+
+/// Encrypt `data` in-place using XSalsa20 and write the Poly1305 MAC to `tag`.
+///
+/// Parameters:
+///
+/// - `key`: The 32 byte key.
+/// - `nonce`: The 24 byte nonce.
+/// - `data`: The plaintext of `data_length` bytes, replaced by the ciphertext of the same length.
+/// - `tag`: Receives the 16 byte Poly1305 MAC.
+///
+/// # Safety
+///
+/// All pointers must be null or valid for reads (`data` also for writes, `tag` only for writes) of
+/// the documented amount of bytes. `data` must not overlap with any other argument.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_xsalsa20_poly1305_encrypt_in_place(
+    key: *const u8,
+    nonce: *const u8,
+    data: *mut u8,
+    data_length: usize,
+    tag: *mut u8,
+) -> CryptoStatus {
+    // SAFETY: The caller upholds the contract of this function.
+    unsafe { encrypt_in_place::<salsa20::XSalsa20Poly1305>(key, nonce, data, data_length, &[], tag) }
+}
+
+/// Verify `data` against the Poly1305 MAC in `tag` and decrypt it in-place using XSalsa20.
+///
+/// Parameters:
+///
+/// - `key`: The 32 byte key.
+/// - `nonce`: The 24 byte nonce.
+/// - `data`: The ciphertext of `data_length` bytes, replaced by the plaintext of the same length.
+/// - `tag`: The 16 byte Poly1305 MAC.
+///
+/// Returns [`CryptoStatus::CipherFailed`] if the MAC does not match.
+///
+/// # Safety
+///
+/// All pointers must be null or valid for reads (`data` also for writes) of the documented amount
+/// of bytes. `data` must not overlap with any other argument.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_xsalsa20_poly1305_decrypt_in_place(
+    key: *const u8,
+    nonce: *const u8,
+    data: *mut u8,
+    data_length: usize,
+    tag: *const u8,
+) -> CryptoStatus {
+    // SAFETY: The caller upholds the contract of this function.
+    unsafe { decrypt_in_place::<salsa20::XSalsa20Poly1305>(key, nonce, data, data_length, &[], tag) }
+}
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const KEY: [u8; KEY_LENGTH] = [0x42; KEY_LENGTH];
+    const NONCE: [u8; NONCE_LENGTH] = [0x01; NONCE_LENGTH];
+
+    #[test]
+    fn xchacha20_poly1305_round_trip() {
+        let plaintext = b"All your base are belong to us".to_vec();
+        let mut data = plaintext.clone();
+        let mut tag = [0; TAG_LENGTH];
+
+        // SAFETY: All pointers are valid for the documented amount of bytes.
+        let status = unsafe {
+            libthreema_xchacha20_poly1305_encrypt_in_place(
+                KEY.as_ptr(),
+                NONCE.as_ptr(),
+                data.as_mut_ptr(),
+                data.len(),
+                b"ad".as_ptr(),
+                2,
+                tag.as_mut_ptr(),
+            )
+        };
+        assert_eq!(status, CryptoStatus::Ok);
+
+        // Must match the attached tag variant
+        let mut combined = plaintext.clone();
+        chacha20::XChaCha20Poly1305::new((&KEY).into())
+            .encrypt_in_place((&NONCE).into(), b"ad", &mut combined)
+            .unwrap();
+        assert_eq!(combined, [data.as_slice(), tag.as_slice()].concat());
+
+        // SAFETY: All pointers are valid for the documented amount of bytes.
+        let status = unsafe {
+            libthreema_xchacha20_poly1305_decrypt_in_place(
+                KEY.as_ptr(),
+                NONCE.as_ptr(),
+                data.as_mut_ptr(),
+                data.len(),
+                b"ad".as_ptr(),
+                2,
+                tag.as_ptr(),
+            )
+        };
+        assert_eq!(status, CryptoStatus::Ok);
+        assert_eq!(data, plaintext);
+    }
+
+    #[test]
+    fn xsalsa20_poly1305_round_trip() {
+        let plaintext = b"All your base are belong to us".to_vec();
+        let mut data = plaintext.clone();
+        let mut tag = [0; TAG_LENGTH];
+
+        // SAFETY: All pointers are valid for the documented amount of bytes.
+        let status = unsafe {
+            libthreema_xsalsa20_poly1305_encrypt_in_place(
+                KEY.as_ptr(),
+                NONCE.as_ptr(),
+                data.as_mut_ptr(),
+                data.len(),
+                tag.as_mut_ptr(),
+            )
+        };
+        assert_eq!(status, CryptoStatus::Ok);
+        assert_ne!(data, plaintext);
+
+        // SAFETY: All pointers are valid for the documented amount of bytes.
+        let status = unsafe {
+            libthreema_xsalsa20_poly1305_decrypt_in_place(
+                KEY.as_ptr(),
+                NONCE.as_ptr(),
+                data.as_mut_ptr(),
+                data.len(),
+                tag.as_ptr(),
+            )
+        };
+        assert_eq!(status, CryptoStatus::Ok);
+        assert_eq!(data, plaintext);
+    }
+
+    #[test]
+    fn reject_invalid_tag() {
+        let mut data = b"All your base are belong to us".to_vec();
+        let tag = [0; TAG_LENGTH];
+
+        // SAFETY: All pointers are valid for the documented amount of bytes.
+        let status = unsafe {
+            libthreema_xchacha20_poly1305_decrypt_in_place(
+                KEY.as_ptr(),
+                NONCE.as_ptr(),
+                data.as_mut_ptr(),
+                data.len(),
+                ptr::null(),
+                0,
+                tag.as_ptr(),
+            )
+        };
+        assert_eq!(status, CryptoStatus::CipherFailed);
+    }
+
+    #[test]
+    fn reject_null_arguments() {
+        let mut data = [0; 4];
+
+        // SAFETY: Null pointers must be rejected.
+        let status = unsafe {
+            libthreema_xsalsa20_poly1305_encrypt_in_place(
+                KEY.as_ptr(),
+                ptr::null(),
+                data.as_mut_ptr(),
+                data.len(),
+                ptr::null_mut(),
+            )
+        };
+        assert_eq!(status, CryptoStatus::NullArgument);
+    }
+}
@@ -0,0 +1,687 @@
+//! C bindings for the _Chat Server Protocol_.
+//!
+//! The flow is the same as described in [`csp::CspProtocol`] with the following differences:
+//!
+//! - The client hello is not returned from [`libthreema_csp_new`] but pending as an outgoing frame
+//!   that must be taken via [`libthreema_csp_take_outgoing_frame`].
+//! - [`libthreema_csp_poll`] and [`libthreema_csp_create_payload`] only describe the instruction.
+//!   An outgoing frame and the data of an incoming payload are kept by the handle until they have
+//!   been copied into a buffer of the caller.
+use core::{
+    ffi::{CStr, c_char},
+    ptr, slice,
+};
+
+use tracing::error;
+
+use crate::{
+    common::{ClientKey, CspDeviceId, MessageId, PublicKey, ThreemaId},
+    csp::{
+        self, Context, CspProtocolError,
+        frame::OutgoingFrame,
+        payload::{EchoPayload, IncomingPayload, MessageAck, MessageWithMetadataBox, OutgoingPayload},
+    },
+};
+
+/// Result status of a CSP binding function.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum CspStatus {
+    /// The call succeeded.
+    Ok = 0,
+
+    /// The protocol will not produce any more instructions until further input has been provided.
+    NoInstruction = 1,
+
+    /// A required pointer argument is null.
+    NullArgument = 2,
+
+    /// An argument is invalid.
+    InvalidParameter = 3,
+
+    /// The provided buffer is too small. The required length has been written and the data is kept
+    /// until it has been taken.
+    BufferTooSmall = 4,
+
+    /// The call is not allowed in the current state, e.g. because an outgoing frame has not been
+    /// taken yet or because the handshake has not completed yet.
+    InvalidState = 5,
+
+    /// The protocol failed unrecoverably. Close the connection and free the handle.
+    ProtocolError = 6,
+}
+
+impl From<CspProtocolError> for CspStatus {
+    fn from(error: CspProtocolError) -> Self {
+        match error {
+            CspProtocolError::InvalidParameter(_) => CspStatus::InvalidParameter,
+            CspProtocolError::InvalidState(_) => CspStatus::InvalidState,
+            _ => CspStatus::ProtocolError,
+        }
+    }
+}
+
+/// C-friendly version of [`csp::CspStateUpdate`].
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum CspStateUpdateKind {
+    /// The state did not change.
+    None = 0,
+
+    /// See [`csp::CspStateUpdate::AwaitingLoginAck`].
+    AwaitingLoginAck = 1,
+
+    /// See [`csp::CspStateUpdate::PostHandshake`].
+    PostHandshake = 2,
+}
+
+/// C-friendly version of the [`IncomingPayload`] variants.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum CspIncomingPayloadType {
+    /// There is no incoming payload.
+    None = 0,
+
+    /// See [`IncomingPayload::EchoRequest`]. The data is the echo payload.
+    EchoRequest = 1,
+
+    /// See [`IncomingPayload::EchoResponse`]. The data is the echo payload.
+    EchoResponse = 2,
+
+    /// See [`IncomingPayload::MessageWithMetadataBox`]. The data are the message bytes.
+    MessageWithMetadataBox = 3,
+
+    /// See [`IncomingPayload::MessageAck`]. The data is the 8 byte identity.
+    MessageAck = 4,
+
+    /// See [`IncomingPayload::QueueSendComplete`]. There is no data.
+    QueueSendComplete = 5,
+
+    /// See [`IncomingPayload::DeviceCookieChangeIndication`]. There is no data.
+    DeviceCookieChangeIndication = 6,
+
+    /// See [`IncomingPayload::CloseError`]. The data is the UTF-8 encoded message.
+    CloseError = 7,
+
+    /// See [`IncomingPayload::ServerAlert`]. The data is the UTF-8 encoded message.
+    ServerAlert = 8,
+
+    /// See [`IncomingPayload::UnknownPayload`]. There is no data.
+    UnknownPayload = 9,
+}
+
+/// C-friendly version of the [`OutgoingPayload`] variants that can be created.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum CspOutgoingPayloadType {
+    /// See [`OutgoingPayload::EchoRequest`]. The data is the echo payload.
+    EchoRequest = 1,
+
+    /// See [`OutgoingPayload::EchoResponse`]. The data is the echo payload.
+    EchoResponse = 2,
+
+    /// See [`OutgoingPayload::MessageWithMetadataBox`]. The data are the message bytes.
+    MessageWithMetadataBox = 3,
+
+    /// See [`OutgoingPayload::MessageAck`]. The data is the 8 byte identity followed by the
+    /// message ID (u64-le).
+    MessageAck = 4,
+
+    /// See [`OutgoingPayload::UnblockIncomingMessages`]. The data must be empty.
+    UnblockIncomingMessages = 5,
+
+    /// See [`OutgoingPayload::ClearDeviceCookieChangeIndiciation`]. The data must be empty.
+    ClearDeviceCookieChangeIndication = 6,
+}
+
+/// C-friendly version of [`csp::CspProtocolInstruction`].
+#[repr(C)]
+#[derive(Clone, Copy, Debug)]
+pub struct CspInstruction {
+    /// The state to which the protocol was advanced to.
+    pub state_update: CspStateUpdateKind,
+
+    /// Amount of queued messages on the server for the client. Only set for
+    /// [`CspStateUpdateKind::PostHandshake`].
+    pub queued_messages: usize,
+
+    /// Byte length of the outgoing frame that must be taken via
+    /// [`libthreema_csp_take_outgoing_frame`] and sent to the server, or `0` if there is none.
+    pub outgoing_frame_length: usize,
+
+    /// Type of the incoming payload that should be processed by the client.
+    pub incoming_payload_type: CspIncomingPayloadType,
+
+    /// Byte length of the incoming payload data that can be taken via
+    /// [`libthreema_csp_take_incoming_payload`].
+    pub incoming_payload_length: usize,
+
+    /// Message ID of an incoming [`CspIncomingPayloadType::MessageWithMetadataBox`] or
+    /// [`CspIncomingPayloadType::MessageAck`].
+    pub message_id: u64,
+
+    /// Whether the client may reconnect automatically after an incoming
+    /// [`CspIncomingPayloadType::CloseError`], or the unknown type of an incoming
+    /// [`CspIncomingPayloadType::UnknownPayload`].
+    pub detail: u8,
+}
+
+impl CspInstruction {
+    const EMPTY: Self = Self {
+        state_update: CspStateUpdateKind::None,
+        queued_messages: 0,
+        outgoing_frame_length: 0,
+        incoming_payload_type: CspIncomingPayloadType::None,
+        incoming_payload_length: 0,
+        message_id: 0,
+        detail: 0,
+    };
+}
+
+/// A [`csp::CspProtocol`] with its pending outgoing frame and incoming payload data.
+///
+/// On the C side, this is an opaque handle.
+pub struct CspHandle {
+    protocol: csp::CspProtocol,
+    outgoing_frame: Option<OutgoingFrame>,
+    incoming_payload_data: Option<Vec<u8>>,
+}
+
+impl CspHandle {
+    /// Store the outgoing frame (if any) and return its length.
+    fn set_outgoing_frame(&mut self, outgoing_frame: Option<OutgoingFrame>) -> usize {
+        let length = outgoing_frame.as_ref().map_or(0, |frame| frame.0.len());
+        self.outgoing_frame = outgoing_frame;
+        length
+    }
+
+    /// Store the incoming payload data (if any) and describe it in `instruction`.
+    fn set_incoming_payload(&mut self, payload: Option<IncomingPayload>, instruction: &mut CspInstruction) {
+        let (r#type, data) = match payload {
+            None => (CspIncomingPayloadType::None, None),
+            Some(IncomingPayload::EchoRequest(payload)) => {
+                (CspIncomingPayloadType::EchoRequest, Some(payload.0))
+            },
+            Some(IncomingPayload::EchoResponse(payload)) => {
+                (CspIncomingPayloadType::EchoResponse, Some(payload.0))
+            },
+            Some(IncomingPayload::MessageWithMetadataBox(payload)) => {
+                instruction.message_id = payload.message_id.0;
+                (
+                    CspIncomingPayloadType::MessageWithMetadataBox,
+                    Some(payload.message_bytes),
+                )
+            },
+            Some(IncomingPayload::MessageAck(payload)) => {
+                instruction.message_id = payload.message_id.0;
+                (
+                    CspIncomingPayloadType::MessageAck,
+                    Some(payload.identity.to_bytes().to_vec()),
+                )
+            },
+            Some(IncomingPayload::QueueSendComplete) => (CspIncomingPayloadType::QueueSendComplete, None),
+            Some(IncomingPayload::DeviceCookieChangeIndication) => {
+                (CspIncomingPayloadType::DeviceCookieChangeIndication, None)
+            },
+            Some(IncomingPayload::CloseError(payload)) => {
+                instruction.detail = u8::from(payload.can_reconnect);
+                (CspIncomingPayloadType::CloseError, Some(payload.message.into_bytes()))
+            },
+            Some(IncomingPayload::ServerAlert(payload)) => {
+                (CspIncomingPayloadType::ServerAlert, Some(payload.0.into_bytes()))
+            },
+            Some(IncomingPayload::UnknownPayload { unknown_type, .. }) => {
+                instruction.detail = unknown_type;
+                (CspIncomingPayloadType::UnknownPayload, None)
+            },
+        };
+        instruction.incoming_payload_type = r#type;
+        instruction.incoming_payload_length = data.as_ref().map_or(0, Vec::len);
+        self.incoming_payload_data = data;
+    }
+
+    /// Ensure that the previous outgoing frame has been taken so that the order of outgoing frames
+    /// is retained.
+    fn ensure_no_outgoing_frame(&self) -> Result<(), CspStatus> {
+        if self.outgoing_frame.is_some() {
+            error!("Previous outgoing frame has not been taken");
+            return Err(CspStatus::InvalidState);
+        }
+        Ok(())
+    }
+}
+
+/// Borrow `length` bytes at `data`. A null pointer is accepted for an empty slice.
+///
+/// # Safety
+///
+/// Unless `length` is `0`, `data` must be valid for reads of `length` bytes for the returned
+/// lifetime.
+unsafe fn borrow_slice<'data>(data: *const u8, length: usize) -> Result<&'data [u8], CspStatus> {
+    if length == 0 {
+        return Ok(&[]);
+    }
+    if data.is_null() {
+        error!("Data argument is null");
+        return Err(CspStatus::NullArgument);
+    }
+    // SAFETY: The caller guarantees that `data` is valid for reads of `length` bytes.
+    Ok(unsafe { slice::from_raw_parts(data, length) })
+}
+
+/// Borrow exactly `N` bytes at `data`.
+///
+/// # Safety
+///
+/// `data` must be null or valid for reads of `N` bytes.
+unsafe fn borrow_array<const N: usize>(data: *const u8) -> Result<[u8; N], CspStatus> {
+    if data.is_null() {
+        error!("Array argument is null");
+        return Err(CspStatus::NullArgument);
+    }
+    // SAFETY: The caller guarantees that `data` is valid for reads of `N` bytes and `[u8; N]` has
+    // an alignment of 1.
+    Ok(unsafe { data.cast::<[u8; N]>().read() })
+}
+
+/// Copy `data` into the buffer of the caller and write the length of `data` to `written`, even if
+/// the buffer is too small.
+///
+/// # Safety
+///
+/// `buffer` must be valid for writes of `buffer_length` bytes (or null if `buffer_length` is `0`)
+/// and `written` must be valid for a write of a `usize`.
+unsafe fn copy_out(data: &[u8], buffer: *mut u8, buffer_length: usize, written: *mut usize) -> CspStatus {
+    if written.is_null() {
+        error!("Written argument is null");
+        return CspStatus::NullArgument;
+    }
+    // SAFETY: The caller guarantees that `written` is valid for writes.
+    unsafe { written.write(data.len()) };
+    if data.len() > buffer_length {
+        return CspStatus::BufferTooSmall;
+    }
+    if data.is_empty() {
+        return CspStatus::Ok;
+    }
+    if buffer.is_null() {
+        error!("Buffer argument is null");
+        return CspStatus::NullArgument;
+    }
+    // SAFETY: The caller guarantees that `buffer` is valid for writes of `buffer_length` bytes and
+    // `buffer_length` has been checked to be at least `data.len()`.
+    unsafe { ptr::copy_nonoverlapping(data.as_ptr(), buffer, data.len()) };
+    CspStatus::Ok
+}
+
+/// Borrow the handle behind `csp`.
+///
+/// # Safety
+///
+/// `csp` must be null or a handle created by [`libthreema_csp_new`] that has not been freed and is
+/// not used concurrently.
+unsafe fn borrow_handle<'csp>(csp: *mut CspHandle) -> Result<&'csp mut CspHandle, CspStatus> {
+    // SAFETY: The caller guarantees that `csp` is null or a valid and exclusive handle.
+    unsafe { csp.as_mut() }.ok_or_else(|| {
+        error!("CSP handle is null");
+        CspStatus::NullArgument
+    })
+}
+
+/// Unwrap the status of a `Result` returning from a binding function.
+macro_rules! try_status {
+    ($result:expr) => {
+        match $result {
+            Ok(value) => value,
+            Err(status) => return status,
+        }
+    };
+}
+
+/// Create a new CSP protocol handle and set the client hello as the pending outgoing frame.
+///
+/// Parameters:
+///
+/// - `permanent_server_keys`: `permanent_server_keys_count` concatenated 32 byte public keys of
+///   the server. The first key is the primary key (copied).
+/// - `identity`: The client's Threema ID as a NUL terminated string (copied).
+/// - `client_key`: The client's 32 byte permanent secret key (copied).
+/// - `client_info`: The NUL terminated client info string (copied).
+/// - `device_cookie`: Pointer to the device cookie, or null (copied).
+/// - `csp_device_id`: Pointer to the CSP device ID, or null (copied).
+/// - `csp`: Receives the handle that must be freed via [`libthreema_csp_free`].
+///
+/// # Safety
+///
+/// All pointers must be null or valid for reads (`csp` for writes) of the documented amount of
+/// bytes.
+#[expect(clippy::missing_panics_doc, reason = "Panic will never happen")]
+#[expect(clippy::too_many_arguments, reason = "C-friendly version of the context")]
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_csp_new(
+    permanent_server_keys: *const u8,
+    permanent_server_keys_count: usize,
+    identity: *const c_char,
+    client_key: *const u8,
+    client_info: *const c_char,
+    device_cookie: *const u16,
+    csp_device_id: *const u64,
+    csp: *mut *mut CspHandle,
+) -> CspStatus {
+    if csp.is_null() || identity.is_null() || client_info.is_null() {
+        error!("CSP, identity or client info argument is null");
+        return CspStatus::NullArgument;
+    }
+    let Some(permanent_server_keys_length) = permanent_server_keys_count.checked_mul(PublicKey::LENGTH)
+    else {
+        return CspStatus::InvalidParameter;
+    };
+
+    // SAFETY: The caller guarantees that `permanent_server_keys` is valid for reads of
+    // `permanent_server_keys_count` public keys.
+    let permanent_server_keys =
+        try_status!(unsafe { borrow_slice(permanent_server_keys, permanent_server_keys_length) });
+    let permanent_server_keys = permanent_server_keys
+        .chunks_exact(PublicKey::LENGTH)
+        .map(|key| PublicKey::try_from(key).expect("chunk must be PublicKey::LENGTH"))
+        .collect();
+
+    // SAFETY: `identity` is not null and the caller guarantees that it is NUL terminated.
+    let identity = unsafe { CStr::from_ptr(identity) };
+    let Ok(identity) = ThreemaId::try_from(identity.to_bytes()) else {
+        error!("Invalid identity");
+        return CspStatus::InvalidParameter;
+    };
+
+    // SAFETY: The caller guarantees that `client_key` is valid for reads of 32 bytes.
+    let client_key = ClientKey::from(try_status!(unsafe {
+        borrow_array::<{ ClientKey::LENGTH }>(client_key)
+    }));
+
+    // SAFETY: `client_info` is not null and the caller guarantees that it is NUL terminated.
+    let client_info = unsafe { CStr::from_ptr(client_info) };
+    let Ok(client_info) = client_info.to_str() else {
+        error!("Client info is not valid UTF-8");
+        return CspStatus::InvalidParameter;
+    };
+
+    // SAFETY: The caller guarantees that `device_cookie` is null or valid for reads.
+    let device_cookie = unsafe { device_cookie.as_ref() }.copied();
+    // SAFETY: The caller guarantees that `csp_device_id` is null or valid for reads.
+    let csp_device_id = unsafe { csp_device_id.as_ref() }.copied().map(CspDeviceId);
+
+    // Create the protocol
+    let context = try_status!(
+        Context::new(
+            permanent_server_keys,
+            identity,
+            client_key,
+            client_info.to_owned(),
+            device_cookie,
+            csp_device_id,
+        )
+        .map_err(CspStatus::from)
+    );
+    let (protocol, client_hello) = csp::CspProtocol::new(context);
+    let handle = Box::new(CspHandle {
+        protocol,
+        outgoing_frame: Some(client_hello),
+        incoming_payload_data: None,
+    });
+
+    // SAFETY: `csp` is not null and the caller guarantees that it is valid for writes.
+    unsafe { csp.write(Box::into_raw(handle)) };
+    CspStatus::Ok
+}
+
+/// Free a CSP protocol handle. Passing null is a no-op.
+///
+/// # Safety
+///
+/// `csp` must be null or a handle created by [`libthreema_csp_new`] that has not been freed yet.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_csp_free(csp: *mut CspHandle) {
+    if csp.is_null() {
+        return;
+    }
+    // SAFETY: The caller guarantees that `csp` was created by `Box::into_raw` and not freed yet.
+    drop(unsafe { Box::from_raw(csp) });
+}
+
+/// Write the number of bytes required to advance the protocol to `length`.
+///
+/// See [`csp::CspProtocol::next_required_length`].
+///
+/// # Safety
+///
+/// `csp` must be a valid handle and `length` must be valid for a write of a `usize`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_csp_next_required_length(
+    csp: *mut CspHandle,
+    length: *mut usize,
+) -> CspStatus {
+    // SAFETY: The caller guarantees that `csp` is valid.
+    let handle = try_status!(unsafe { borrow_handle(csp) });
+    if length.is_null() {
+        error!("Length argument is null");
+        return CspStatus::NullArgument;
+    }
+    let required_length = try_status!(handle.protocol.next_required_length().map_err(CspStatus::from));
+    // SAFETY: `length` is not null and the caller guarantees that it is valid for writes.
+    unsafe { length.write(required_length) };
+    CspStatus::Ok
+}
+
+/// Add a chunk received from the server.
+///
+/// The chunk is borrowed for the duration of the call only, so it may point directly into the
+/// read buffer of the caller. It may contain partial, one or multiple frames.
+///
+/// See [`csp::CspProtocol::add_chunks`].
+///
+/// # Safety
+///
+/// `csp` must be a valid handle and `chunk` must be valid for reads of `chunk_length` bytes.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_csp_add_chunk(
+    csp: *mut CspHandle,
+    chunk: *const u8,
+    chunk_length: usize,
+) -> CspStatus {
+    // SAFETY: The caller guarantees that `csp` is valid.
+    let handle = try_status!(unsafe { borrow_handle(csp) });
+    // SAFETY: The caller guarantees that `chunk` is valid for reads of `chunk_length` bytes.
+    let chunk = try_status!(unsafe { borrow_slice(chunk, chunk_length) });
+    try_status!(handle.protocol.add_chunks(&[chunk]).map_err(CspStatus::from));
+    CspStatus::Ok
+}
+
+/// Poll to advance the state and describe the resulting instruction in `instruction`.
+///
+/// Returns [`CspStatus::NoInstruction`] if there is nothing to do until more chunks have been
+/// added. The data of a previous incoming payload that has not been taken is discarded. A previous
+/// outgoing frame must have been taken.
+///
+/// See [`csp::CspProtocol::poll`].
+///
+/// # Safety
+///
+/// `csp` must be a valid handle and `instruction` must be valid for writes.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_csp_poll(
+    csp: *mut CspHandle,
+    instruction: *mut CspInstruction,
+) -> CspStatus {
+    // SAFETY: The caller guarantees that `csp` is valid.
+    let handle = try_status!(unsafe { borrow_handle(csp) });
+    if instruction.is_null() {
+        error!("Instruction argument is null");
+        return CspStatus::NullArgument;
+    }
+    try_status!(handle.ensure_no_outgoing_frame());
+    handle.incoming_payload_data = None;
+
+    // Poll and describe the instruction
+    let Some(polled) = try_status!(handle.protocol.poll().map_err(CspStatus::from)) else {
+        return CspStatus::NoInstruction;
+    };
+    let mut described = CspInstruction::EMPTY;
+    match polled.state_update {
+        None => {},
+        Some(csp::CspStateUpdate::AwaitingLoginAck) => {
+            described.state_update = CspStateUpdateKind::AwaitingLoginAck;
+        },
+        Some(csp::CspStateUpdate::PostHandshake { queued_messages }) => {
+            described.state_update = CspStateUpdateKind::PostHandshake;
+            described.queued_messages = queued_messages;
+        },
+    }
+    described.outgoing_frame_length = handle.set_outgoing_frame(polled.outgoing_frame);
+    handle.set_incoming_payload(polled.incoming_payload, &mut described);
+
+    // SAFETY: `instruction` is not null and the caller guarantees that it is valid for writes.
+    unsafe { instruction.write(described) };
+    CspStatus::Ok
+}
+
+/// Encode and encrypt an outgoing payload and set it as the pending outgoing frame. The length of
+/// the frame is written to `frame_length`.
+///
+/// A previous outgoing frame must have been taken.
+///
+/// See [`csp::CspProtocol::create_payload`].
+///
+/// # Safety
+///
+/// `csp` must be a valid handle, `data` must be valid for reads of `data_length` bytes and
+/// `frame_length` must be valid for a write of a `usize`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_csp_create_payload(
+    csp: *mut CspHandle,
+    payload_type: CspOutgoingPayloadType,
+    data: *const u8,
+    data_length: usize,
+    frame_length: *mut usize,
+) -> CspStatus {
+    // SAFETY: The caller guarantees that `csp` is valid.
+    let handle = try_status!(unsafe { borrow_handle(csp) });
+    // SAFETY: The caller guarantees that `data` is valid for reads of `data_length` bytes.
+    let data = try_status!(unsafe { borrow_slice(data, data_length) });
+    if frame_length.is_null() {
+        error!("Frame length argument is null");
+        return CspStatus::NullArgument;
+    }
+    try_status!(handle.ensure_no_outgoing_frame());
+
+    // Map the payload
+    let payload = match payload_type {
+        CspOutgoingPayloadType::EchoRequest => OutgoingPayload::EchoRequest(EchoPayload(data.to_vec())),
+        CspOutgoingPayloadType::EchoResponse => OutgoingPayload::EchoResponse(EchoPayload(data.to_vec())),
+        CspOutgoingPayloadType::MessageWithMetadataBox => {
+            // The message ID is only needed for incoming messages, the bytes are encoded as is
+            OutgoingPayload::MessageWithMetadataBox(MessageWithMetadataBox {
+                message_id: MessageId(0),
+                message_bytes: data.to_vec(),
+            })
+        },
+        CspOutgoingPayloadType::MessageAck => {
+            let (Some(identity), Some(message_id)) = (
+                data.get(..ThreemaId::LENGTH)
+                    .and_then(|identity| ThreemaId::try_from(identity).ok()),
+                data.get(ThreemaId::LENGTH..)
+                    .and_then(|message_id| <[u8; MessageId::LENGTH]>::try_from(message_id).ok()),
+            ) else {
+                error!("Invalid message ack data");
+                return CspStatus::InvalidParameter;
+            };
+            OutgoingPayload::MessageAck(MessageAck {
+                identity,
+                message_id: MessageId(u64::from_le_bytes(message_id)),
+            })
+        },
+        CspOutgoingPayloadType::UnblockIncomingMessages
+        | CspOutgoingPayloadType::ClearDeviceCookieChangeIndication => {
+            if !data.is_empty() {
+                error!(?payload_type, "Payload type does not carry any data");
+                return CspStatus::InvalidParameter;
+            }
+            if payload_type == CspOutgoingPayloadType::UnblockIncomingMessages {
+                OutgoingPayload::UnblockIncomingMessages
+            } else {
+                OutgoingPayload::ClearDeviceCookieChangeIndiciation
+            }
+        },
+    };
+
+    // Create the frame
+    let instruction = try_status!(handle.protocol.create_payload(&payload).map_err(CspStatus::from));
+    let length = handle.set_outgoing_frame(instruction.outgoing_frame);
+    // SAFETY: `frame_length` is not null and the caller guarantees that it is valid for writes.
+    unsafe { frame_length.write(length) };
+    CspStatus::Ok
+}
+
+/// Copy the pending outgoing frame into `buffer` and write its length to `written`.
+///
+/// If `buffer_length` is too small, [`CspStatus::BufferTooSmall`] is returned and the frame is kept.
+/// Returns [`CspStatus::InvalidState`] if there is no pending outgoing frame.
+///
+/// Note: A frame never exceeds 65537 bytes.
+///
+/// # Safety
+///
+/// `csp` must be a valid handle, `buffer` must be valid for writes of `buffer_length` bytes and
+/// `written` must be valid for a write of a `usize`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_csp_take_outgoing_frame(
+    csp: *mut CspHandle,
+    buffer: *mut u8,
+    buffer_length: usize,
+    written: *mut usize,
+) -> CspStatus {
+    // SAFETY: The caller guarantees that `csp` is valid.
+    let handle = try_status!(unsafe { borrow_handle(csp) });
+    let Some(frame) = &handle.outgoing_frame else {
+        error!("No pending outgoing frame");
+        return CspStatus::InvalidState;
+    };
+    // SAFETY: The caller guarantees that `buffer` and `written` are valid for writes.
+    let status = unsafe { copy_out(&frame.0, buffer, buffer_length, written) };
+    if status == CspStatus::Ok {
+        if let Some(frame) = handle.outgoing_frame.take() {
+            handle.protocol.recycle_outgoing_frame(frame);
+        }
+    }
+    status
+}
+
+/// Copy the data of the incoming payload of the last instruction into `buffer` and write its
+/// length to `written`.
+///
+/// If `buffer_length` is too small, [`CspStatus::BufferTooSmall`] is returned and the data is
+/// kept. Returns [`CspStatus::InvalidState`] if there is no incoming payload data.
+///
+/// # Safety
+///
+/// `csp` must be a valid handle, `buffer` must be valid for writes of `buffer_length` bytes and
+/// `written` must be valid for a write of a `usize`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn libthreema_csp_take_incoming_payload(
+    csp: *mut CspHandle,
+    buffer: *mut u8,
+    buffer_length: usize,
+    written: *mut usize,
+) -> CspStatus {
+    // SAFETY: The caller guarantees that `csp` is valid.
+    let handle = try_status!(unsafe { borrow_handle(csp) });
+    let Some(data) = &handle.incoming_payload_data else {
+        error!("No incoming payload data");
+        return CspStatus::InvalidState;
+    };
+    // SAFETY: The caller guarantees that `buffer` and `written` are valid for writes.
+    let status = unsafe { copy_out(data, buffer, buffer_length, written) };
+    if status == CspStatus::Ok {
+        handle.incoming_payload_data = None;
+    }
+    status
+}
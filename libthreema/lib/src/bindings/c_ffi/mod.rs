@@ -0,0 +1,12 @@
+//! C (FFI) bindings.
+//!
+//! Unlike the UniFFI and WASM bindings, these bindings do not copy buffers at the boundary: Input
+//! is borrowed by pointer and output is written into buffers owned by the caller. This allows a C
+//! client to drive many protocol instances from a single (e.g. epoll based) event loop.
+//!
+//! The C header is generated by cbindgen, see `tools/build-c.sh`.
+//!
+//! Note: None of the handles are thread-safe. A handle may be moved between threads but must not
+//! be used by more than one thread at a time.
+pub mod crypto;
+pub mod csp;
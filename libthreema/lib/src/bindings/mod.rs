@@ -1,4 +1,6 @@
 //! FFI bindings of this library.
+#[cfg(feature = "c-ffi")]
+pub mod c_ffi;
 #[cfg(feature = "uniffi")]
 pub mod uniffi;
 #[cfg(feature = "wasm")]
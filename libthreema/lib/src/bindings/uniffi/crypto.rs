@@ -1,7 +1,10 @@
 //! High-level crypto bindings.
+use std::sync::{Arc, Mutex};
+
 use crate::{
     common::Nonce,
-    crypto::{argon2, blake2b, chacha20, deprecated::scrypt, salsa20, sha2, x25519},
+    crypto::{aead, argon2, blake2b, chacha20, deprecated::scrypt, salsa20, sha2, x25519},
+    utils::sync::MutexIgnorePoison as _,
 };
 
 /// A general crypto-related error.
@@ -16,6 +19,10 @@ pub enum CryptoError {
     /// Unable to encrypt/decrypt.
     #[error("Unable to encrypt/decrypt")]
     CipherFailed,
+
+    /// The hasher, MAC or stream has already been finalized (or failed).
+    #[error("Already finalized")]
+    Finalized,
 }
 
 /// Compute the SHA-256 hash of the provided data.
@@ -63,6 +70,153 @@ pub fn blake2b_mac_256(key: &Option<Vec<u8>>, personal: &[u8], salt: &[u8]) -> R
     Ok(mac.to_vec())
 }
 
+/// Incrementally compute the SHA-256 hash of data that is provided in chunks, so that it does not
+/// need to be buffered in its entirety.
+#[derive(uniffi::Object)]
+pub struct Sha256Hasher(Mutex<Option<sha2::Sha256>>);
+
+#[uniffi::export]
+impl Sha256Hasher {
+    /// Create a new SHA-256 hasher.
+    #[uniffi::constructor]
+    #[must_use]
+    pub fn new() -> Arc<Self> {
+        use crate::crypto::digest::Digest as _;
+
+        Arc::new(Self(Mutex::new(Some(sha2::Sha256::new()))))
+    }
+
+    /// Add the next chunk of data.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the hasher has already been finalized.
+    pub fn update(&self, data: &[u8]) -> Result<(), CryptoError> {
+        use crate::crypto::digest::Digest as _;
+
+        self.0
+            .lock_ignore_poison()
+            .as_mut()
+            .ok_or(CryptoError::Finalized)?
+            .update(data);
+        Ok(())
+    }
+
+    /// Compute the SHA-256 hash of all added data.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the hasher has already been finalized.
+    pub fn finalize(&self) -> Result<Vec<u8>, CryptoError> {
+        use crate::crypto::digest::FixedOutput as _;
+
+        let hasher = self.0.lock_ignore_poison().take().ok_or(CryptoError::Finalized)?;
+        Ok(hasher.finalize_fixed().to_vec())
+    }
+}
+
+/// Incrementally compute the HMAC-SHA256 of data that is provided in chunks, so that it does not
+/// need to be buffered in its entirety.
+#[derive(uniffi::Object)]
+pub struct HmacSha256Hasher(Mutex<Option<sha2::HmacSha256>>);
+
+#[uniffi::export]
+impl HmacSha256Hasher {
+    /// Create a new HMAC-SHA256 hasher from the provided key.
+    #[expect(clippy::missing_panics_doc, reason = "Panic will never happen")]
+    #[uniffi::constructor]
+    #[must_use]
+    pub fn new(key: &[u8]) -> Arc<Self> {
+        use crate::crypto::digest::Mac as _;
+
+        let mac = sha2::HmacSha256::new_from_slice(key).expect("HMAC can take key of any size");
+        Arc::new(Self(Mutex::new(Some(mac))))
+    }
+
+    /// Add the next chunk of data.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the hasher has already been finalized.
+    pub fn update(&self, data: &[u8]) -> Result<(), CryptoError> {
+        use crate::crypto::digest::Mac as _;
+
+        self.0
+            .lock_ignore_poison()
+            .as_mut()
+            .ok_or(CryptoError::Finalized)?
+            .update(data);
+        Ok(())
+    }
+
+    /// Compute the HMAC-SHA256 of all added data.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the hasher has already been finalized.
+    pub fn finalize(&self) -> Result<Vec<u8>, CryptoError> {
+        use crate::crypto::digest::FixedOutput as _;
+
+        let mac = self.0.lock_ignore_poison().take().ok_or(CryptoError::Finalized)?;
+        Ok(mac.finalize_fixed().to_vec())
+    }
+}
+
+/// Incrementally compute a Blake2b MAC (like [`blake2b_mac_256`]) of data that is provided in
+/// chunks.
+#[derive(uniffi::Object)]
+pub struct Blake2bMac256Hasher(Mutex<Option<blake2b::Blake2bMac256>>);
+
+#[uniffi::export]
+impl Blake2bMac256Hasher {
+    /// Create a new Blake2b MAC hasher from the provided key, personal and salt.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::InvalidParameter`] if `key` is present and less than 1 or more than
+    /// 64 bytes and when `personal` or `salt` is more than 8 bytes.
+    #[uniffi::constructor]
+    pub fn new(key: &Option<Vec<u8>>, personal: &[u8], salt: &[u8]) -> Result<Arc<Self>, CryptoError> {
+        let mac = blake2b::Blake2bMac256::new_with_salt_and_personal(key.as_deref(), salt, personal)
+            .map_err(|_| {
+                CryptoError::InvalidParameter(
+                    "'key' if provided must be between 1 and 64 bytes, 'personal' and 'salt' must be up \
+                     to 8 bytes"
+                        .to_owned(),
+                )
+            })?;
+        Ok(Arc::new(Self(Mutex::new(Some(mac)))))
+    }
+
+    /// Add the next chunk of data.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the hasher has already been finalized.
+    pub fn update(&self, data: &[u8]) -> Result<(), CryptoError> {
+        use crate::crypto::digest::Mac as _;
+
+        self.0
+            .lock_ignore_poison()
+            .as_mut()
+            .ok_or(CryptoError::Finalized)?
+            .update(data);
+        Ok(())
+    }
+
+    /// Compute the Blake2b MAC of all added data.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the hasher has already been finalized.
+    pub fn finalize(&self) -> Result<Vec<u8>, CryptoError> {
+        use crate::crypto::digest::FixedOutput as _;
+
+        let mac = self.0.lock_ignore_poison().take().ok_or(CryptoError::Finalized)?;
+        Ok(mac.finalize_fixed().to_vec())
+    }
+}
+
 /// Parameters for [`argon2id`]
 #[derive(Clone, Copy, uniffi::Record)]
 pub struct Argon2idParameters {
@@ -95,8 +249,26 @@ impl TryFrom<Argon2idParameters> for argon2::Params {
     }
 }
 
+fn derive_argon2id(
+    arena: &mut argon2::Argon2idArena,
+    password: &[u8],
+    salt: &[u8],
+    parameters: Argon2idParameters,
+) -> Result<Vec<u8>, CryptoError> {
+    let context = argon2::ParallelArgon2id::with_available_parallelism(parameters.try_into()?);
+    let mut output = vec![0; parameters.output_length as usize];
+    context
+        .hash_password_into(arena, password, salt, &mut output)
+        .map_err(|error| CryptoError::InvalidParameter(error.to_string()))?;
+
+    Ok(output)
+}
+
 /// Derive a key from the provided password and salt using Argon2id.
 ///
+/// The lanes (see [`Argon2idParameters::parallelism`]) are computed on as many threads as
+/// available.
+///
 /// # Errors
 ///
 /// Returns [`CryptoError::InvalidParameter`] if the passed parameters are invalid (see
@@ -107,13 +279,44 @@ pub fn argon2id(
     salt: &[u8],
     parameters: Argon2idParameters,
 ) -> Result<Vec<u8>, CryptoError> {
-    let context = argon2::Argon2::new(argon2::Argon2id, argon2::Version::V0x13, parameters.try_into()?);
-    let mut output = vec![0; parameters.output_length as usize];
-    context
-        .hash_password_into(password, salt, &mut output)
-        .map_err(|error| CryptoError::InvalidParameter(error.to_string()))?;
+    derive_argon2id(&mut argon2::Argon2idArena::default(), password, salt, parameters)
+}
 
-    Ok(output)
+/// Memory for repeated Argon2id derivations, so that it does not need to be allocated for each
+/// derivation.
+///
+/// The memory is wiped when released or when the arena is destroyed.
+#[derive(uniffi::Object)]
+pub struct Argon2idArena(Mutex<argon2::Argon2idArena>);
+
+#[uniffi::export]
+impl Argon2idArena {
+    /// Create an arena without any memory.
+    #[uniffi::constructor]
+    #[must_use]
+    pub fn new() -> Arc<Self> {
+        Arc::new(Self(Mutex::new(argon2::Argon2idArena::default())))
+    }
+
+    /// Derive a key like [`argon2id`], using (and growing) the memory of the arena.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::InvalidParameter`] if the passed parameters are invalid (see
+    /// [`Argon2idParameters`] for the requirements).
+    pub fn argon2id(
+        &self,
+        password: &[u8],
+        salt: &[u8],
+        parameters: Argon2idParameters,
+    ) -> Result<Vec<u8>, CryptoError> {
+        derive_argon2id(&mut self.0.lock_ignore_poison(), password, salt, parameters)
+    }
+
+    /// Wipe and release the memory.
+    pub fn release(&self) {
+        self.0.lock_ignore_poison().release();
+    }
 }
 
 /// Parameters for [`scrypt`]
@@ -256,6 +459,157 @@ pub fn xchacha20_poly1305_decrypt(
     Ok(data)
 }
 
+/// Length of the nonce of [`XChaCha20Poly1305StreamEncryptor`] and
+/// [`XChaCha20Poly1305StreamDecryptor`]. The remaining 5 bytes of the XChaCha20Poly1305 nonce are
+/// the chunk counter (u32-be) and the last chunk flag.
+const STREAM_NONCE_LENGTH: usize = 19;
+
+fn xchacha20_poly1305_stream_cipher(
+    key: &[u8],
+    nonce: &[u8],
+) -> Result<(chacha20::XChaCha20Poly1305, [u8; STREAM_NONCE_LENGTH]), CryptoError> {
+    use crate::crypto::cipher::KeyInit as _;
+
+    let cipher = chacha20::XChaCha20Poly1305::new_from_slice(key)
+        .map_err(|_| CryptoError::InvalidParameter("'key' must be 32 bytes".to_owned()))?;
+    let nonce = nonce
+        .try_into()
+        .map_err(|_| CryptoError::InvalidParameter("'nonce' must be 19 bytes".to_owned()))?;
+    Ok((cipher, nonce))
+}
+
+/// Encrypt data of arbitrary length in chunks using XChaCha20Poly1305 in the STREAM construction,
+/// so that it does not need to be buffered in its entirety.
+///
+/// Each chunk is encrypted in-place and a Poly1305 MAC is appended. The decryptor (see
+/// [`XChaCha20Poly1305StreamDecryptor`]) detects reordered, dropped and truncated chunks. The chunks
+/// must be decrypted with the same chunking.
+#[derive(uniffi::Object)]
+pub struct XChaCha20Poly1305StreamEncryptor(Mutex<Option<aead::EncryptorBE32<chacha20::XChaCha20Poly1305>>>);
+
+#[uniffi::export]
+impl XChaCha20Poly1305StreamEncryptor {
+    /// Create a new stream encryptor.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::InvalidParameter`] if `key` is not exactly 32 bytes or `nonce` is not
+    /// exactly 19 bytes.
+    #[uniffi::constructor]
+    pub fn new(key: &[u8], nonce: &[u8]) -> Result<Arc<Self>, CryptoError> {
+        let (cipher, nonce) = xchacha20_poly1305_stream_cipher(key, nonce)?;
+        let encryptor = aead::EncryptorBE32::from_aead(cipher, (&nonce).into());
+        Ok(Arc::new(Self(Mutex::new(Some(encryptor)))))
+    }
+
+    /// Encrypt the next chunk of data.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the last chunk has already been encrypted.
+    ///
+    /// Returns [`CryptoError::CipherFailed`] if encryption failed (e.g. because the maximum amount
+    /// of chunks has been exceeded).
+    pub fn encrypt_chunk(&self, mut data: Vec<u8>, associated_data: &[u8]) -> Result<Vec<u8>, CryptoError> {
+        self.0
+            .lock_ignore_poison()
+            .as_mut()
+            .ok_or(CryptoError::Finalized)?
+            .encrypt_next_in_place(associated_data, &mut data)
+            .map_err(|_| CryptoError::CipherFailed)?;
+        Ok(data)
+    }
+
+    /// Encrypt the last chunk of data and finalize the stream.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the last chunk has already been encrypted.
+    ///
+    /// Returns [`CryptoError::CipherFailed`] if encryption failed.
+    pub fn encrypt_last_chunk(
+        &self,
+        mut data: Vec<u8>,
+        associated_data: &[u8],
+    ) -> Result<Vec<u8>, CryptoError> {
+        self.0
+            .lock_ignore_poison()
+            .take()
+            .ok_or(CryptoError::Finalized)?
+            .encrypt_last_in_place(associated_data, &mut data)
+            .map_err(|_| CryptoError::CipherFailed)?;
+        Ok(data)
+    }
+}
+
+/// Decrypt data encrypted by [`XChaCha20Poly1305StreamEncryptor`] in chunks.
+///
+/// Each chunk is authenticated before it is returned. Once a chunk failed to decrypt, the stream
+/// is considered corrupt and all further calls fail.
+#[derive(uniffi::Object)]
+pub struct XChaCha20Poly1305StreamDecryptor(Mutex<Option<aead::DecryptorBE32<chacha20::XChaCha20Poly1305>>>);
+
+#[uniffi::export]
+impl XChaCha20Poly1305StreamDecryptor {
+    /// Create a new stream decryptor.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::InvalidParameter`] if `key` is not exactly 32 bytes or `nonce` is not
+    /// exactly 19 bytes.
+    #[uniffi::constructor]
+    pub fn new(key: &[u8], nonce: &[u8]) -> Result<Arc<Self>, CryptoError> {
+        let (cipher, nonce) = xchacha20_poly1305_stream_cipher(key, nonce)?;
+        let decryptor = aead::DecryptorBE32::from_aead(cipher, (&nonce).into());
+        Ok(Arc::new(Self(Mutex::new(Some(decryptor)))))
+    }
+
+    /// Decrypt the next chunk of data.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the last chunk has already been decrypted or a
+    /// previous chunk failed to decrypt.
+    ///
+    /// Returns [`CryptoError::CipherFailed`] if decryption failed.
+    pub fn decrypt_chunk(&self, mut data: Vec<u8>, associated_data: &[u8]) -> Result<Vec<u8>, CryptoError> {
+        let mut decryptor = self.0.lock_ignore_poison();
+        if decryptor
+            .as_mut()
+            .ok_or(CryptoError::Finalized)?
+            .decrypt_next_in_place(associated_data, &mut data)
+            .is_err()
+        {
+            *decryptor = None;
+            return Err(CryptoError::CipherFailed);
+        }
+        Ok(data)
+    }
+
+    /// Decrypt the last chunk of data and finalize the stream.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`CryptoError::Finalized`] if the last chunk has already been decrypted or a
+    /// previous chunk failed to decrypt.
+    ///
+    /// Returns [`CryptoError::CipherFailed`] if decryption failed (e.g. because the chunk is not
+    /// the last chunk).
+    pub fn decrypt_last_chunk(
+        &self,
+        mut data: Vec<u8>,
+        associated_data: &[u8],
+    ) -> Result<Vec<u8>, CryptoError> {
+        self.0
+            .lock_ignore_poison()
+            .take()
+            .ok_or(CryptoError::Finalized)?
+            .decrypt_last_in_place(associated_data, &mut data)
+            .map_err(|_| CryptoError::CipherFailed)?;
+        Ok(data)
+    }
+}
+
 /// Encrypt the provided data using XSalsa20 and append a Poly1305 MAC.
 ///
 /// # Errors
@@ -309,3 +663,196 @@ pub fn xsalsa20_poly1305_decrypt(
         .map_err(|_| CryptoError::CipherFailed)?;
     Ok(data)
 }
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const KEY: [u8; 32] = [0x42; 32];
+    const STREAM_NONCE: [u8; STREAM_NONCE_LENGTH] = [0x01; STREAM_NONCE_LENGTH];
+
+    fn data() -> Vec<u8> {
+        (0..=u8::MAX).cycle().take(1000).collect()
+    }
+
+    fn encrypt_stream(chunks: &[&[u8]]) -> Vec<Vec<u8>> {
+        let encryptor = XChaCha20Poly1305StreamEncryptor::new(&KEY, &STREAM_NONCE).unwrap();
+        let (last, chunks) = chunks.split_last().unwrap();
+        let mut encrypted: Vec<Vec<u8>> = chunks
+            .iter()
+            .map(|chunk| encryptor.encrypt_chunk(chunk.to_vec(), b"ad").unwrap())
+            .collect();
+        encrypted.push(encryptor.encrypt_last_chunk(last.to_vec(), b"ad").unwrap());
+        encrypted
+    }
+
+    fn decrypt_stream(chunks: Vec<Vec<u8>>) -> Result<Vec<u8>, CryptoError> {
+        let decryptor = XChaCha20Poly1305StreamDecryptor::new(&KEY, &STREAM_NONCE).unwrap();
+        let mut chunks = chunks;
+        let last = chunks.pop().unwrap();
+        let mut plaintext = Vec::new();
+        for chunk in chunks {
+            plaintext.extend(decryptor.decrypt_chunk(chunk, b"ad")?);
+        }
+        plaintext.extend(decryptor.decrypt_last_chunk(last, b"ad")?);
+        Ok(plaintext)
+    }
+
+    #[test]
+    fn sha256_chunked() {
+        let data = data();
+        let hasher = Sha256Hasher::new();
+        hasher.update(&[]).unwrap();
+        for chunk in data.chunks(7) {
+            hasher.update(chunk).unwrap();
+        }
+        assert_eq!(hasher.finalize().unwrap(), sha256(&data));
+
+        assert!(matches!(hasher.update(&data), Err(CryptoError::Finalized)));
+        assert!(matches!(hasher.finalize(), Err(CryptoError::Finalized)));
+    }
+
+    #[test]
+    fn hmac_sha256_chunked() {
+        let data = data();
+        let hasher = HmacSha256Hasher::new(&KEY);
+        for chunk in data.chunks(64) {
+            hasher.update(chunk).unwrap();
+        }
+        assert_eq!(hasher.finalize().unwrap(), hmac_sha256(&KEY, &data));
+
+        assert!(matches!(hasher.update(&data), Err(CryptoError::Finalized)));
+        assert!(matches!(hasher.finalize(), Err(CryptoError::Finalized)));
+    }
+
+    #[test]
+    fn blake2b_mac_256_chunked() {
+        use crate::crypto::digest::{FixedOutput as _, Mac as _};
+
+        let data = data();
+        let key = Some(KEY.to_vec());
+        let hasher = Blake2bMac256Hasher::new(&key, b"personal", b"salt").unwrap();
+        for chunk in data.chunks(129) {
+            hasher.update(chunk).unwrap();
+        }
+        let expected =
+            blake2b::Blake2bMac256::new_with_salt_and_personal(Some(KEY.as_slice()), b"salt", b"personal")
+                .unwrap()
+                .chain_update(&data)
+                .finalize_fixed();
+        assert_eq!(hasher.finalize().unwrap(), expected.as_slice());
+
+        // Without any data, the MAC must match the one-shot variant
+        let hasher = Blake2bMac256Hasher::new(&key, b"personal", b"salt").unwrap();
+        assert_eq!(
+            hasher.finalize().unwrap(),
+            blake2b_mac_256(&key, b"personal", b"salt").unwrap(),
+        );
+
+        assert!(matches!(hasher.update(&data), Err(CryptoError::Finalized)));
+        assert!(matches!(hasher.finalize(), Err(CryptoError::Finalized)));
+    }
+
+    #[test]
+    fn argon2id_multiple_lanes() {
+        use ::argon2::{Algorithm::Argon2id, Argon2, Version};
+
+        let parameters = Argon2idParameters {
+            memory_cost: 1024,
+            time_cost: 2,
+            parallelism: 4,
+            output_length: 32,
+        };
+        let mut expected = vec![0; 32];
+        Argon2::new(Argon2id, Version::V0x13, parameters.try_into().unwrap())
+            .hash_password_into(b"password", b"somesalt", &mut expected)
+            .unwrap();
+        assert_eq!(argon2id(b"password", b"somesalt", parameters).unwrap(), expected);
+
+        // Reusing the memory of an arena must not change the output
+        let arena = Argon2idArena::new();
+        for _ in 0_u8..2 {
+            assert_eq!(
+                arena.argon2id(b"password", b"somesalt", parameters).unwrap(),
+                expected
+            );
+        }
+        arena.release();
+    }
+
+    #[test]
+    fn stream_round_trip() {
+        let data = data();
+        let encrypted = encrypt_stream(&data.chunks(300).collect::<Vec<_>>());
+        assert_eq!(encrypted.len(), 4);
+        assert_eq!(decrypt_stream(encrypted).unwrap(), data);
+
+        // A single (empty) last chunk
+        let encrypted = encrypt_stream(&[b"".as_slice()]);
+        assert_eq!(decrypt_stream(encrypted).unwrap(), Vec::<u8>::new());
+    }
+
+    #[test]
+    fn stream_reject_reordered_chunks() {
+        let data = data();
+        let mut encrypted = encrypt_stream(&data.chunks(300).collect::<Vec<_>>());
+        encrypted.swap(0, 1);
+        assert!(matches!(decrypt_stream(encrypted), Err(CryptoError::CipherFailed)));
+    }
+
+    #[test]
+    fn stream_reject_dropped_chunk() {
+        let data = data();
+        let mut encrypted = encrypt_stream(&data.chunks(300).collect::<Vec<_>>());
+        let _ = encrypted.remove(1);
+        assert!(matches!(decrypt_stream(encrypted), Err(CryptoError::CipherFailed)));
+    }
+
+    #[test]
+    fn stream_reject_truncated_chunk() {
+        let data = data();
+        let mut encrypted = encrypt_stream(&data.chunks(300).collect::<Vec<_>>());
+        let _ = encrypted.get_mut(1).unwrap().pop();
+        assert!(matches!(decrypt_stream(encrypted), Err(CryptoError::CipherFailed)));
+    }
+
+    #[test]
+    fn stream_reject_missing_last_chunk() {
+        let data = data();
+        let mut encrypted = encrypt_stream(&data.chunks(300).collect::<Vec<_>>());
+        let _ = encrypted.pop();
+        assert!(matches!(decrypt_stream(encrypted), Err(CryptoError::CipherFailed)));
+    }
+
+    #[test]
+    fn stream_fail_after_failed_chunk() {
+        let data = data();
+        let encrypted = encrypt_stream(&data.chunks(300).collect::<Vec<_>>());
+        let decryptor = XChaCha20Poly1305StreamDecryptor::new(&KEY, &STREAM_NONCE).unwrap();
+        assert!(matches!(
+            decryptor.decrypt_chunk(encrypted.get(1).unwrap().clone(), b"ad"),
+            Err(CryptoError::CipherFailed)
+        ));
+        assert!(matches!(
+            decryptor.decrypt_chunk(encrypted.first().unwrap().clone(), b"ad"),
+            Err(CryptoError::Finalized)
+        ));
+    }
+
+    #[test]
+    fn stream_fail_after_finalize() {
+        let encryptor = XChaCha20Poly1305StreamEncryptor::new(&KEY, &STREAM_NONCE).unwrap();
+        let encrypted = encryptor.encrypt_last_chunk(data(), b"ad").unwrap();
+        assert!(matches!(encryptor.encrypt_chunk(data(), b"ad"), Err(CryptoError::Finalized)));
+        assert!(matches!(encryptor.encrypt_last_chunk(data(), b"ad"), Err(CryptoError::Finalized)));
+
+        let decryptor = XChaCha20Poly1305StreamDecryptor::new(&KEY, &STREAM_NONCE).unwrap();
+        assert_eq!(decryptor.decrypt_last_chunk(encrypted.clone(), b"ad").unwrap(), data());
+        assert!(matches!(
+            decryptor.decrypt_chunk(encrypted.clone(), b"ad"),
+            Err(CryptoError::Finalized)
+        ));
+        assert!(matches!(decryptor.decrypt_last_chunk(encrypted, b"ad"), Err(CryptoError::Finalized)));
+    }
+}
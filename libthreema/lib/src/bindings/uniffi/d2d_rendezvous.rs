@@ -3,7 +3,7 @@ use std::sync::{Arc, Mutex};
 
 use crate::{
     d2d_rendezvous::{self, RendezvousProtocolError},
-    utils::sync::MutexIgnorePoison as _,
+    utils::{sync::MutexIgnorePoison as _, time::Duration},
 };
 
 /// Binding-friendly version of [`d2d_rendezvous::PathStateUpdate`].
@@ -13,7 +13,7 @@ pub enum PathStateUpdate {
     AwaitingNominate { measured_rtt_ms: u32 },
 
     #[expect(missing_docs, reason = "Binding-friendly version")]
-    Nominated { rph: Vec<u8> },
+    Nominated { rph: Vec<u8>, measured_rtt_ms: u32 },
 }
 
 impl From<d2d_rendezvous::PathStateUpdate> for PathStateUpdate {
@@ -25,7 +25,13 @@ impl From<d2d_rendezvous::PathStateUpdate> for PathStateUpdate {
                     .try_into()
                     .expect("measured_rtt should not exceed a u32"),
             },
-            d2d_rendezvous::PathStateUpdate::Nominated { rph } => Self::Nominated { rph: rph.0.to_vec() },
+            d2d_rendezvous::PathStateUpdate::Nominated { rph, measured_rtt } => Self::Nominated {
+                rph: rph.0.to_vec(),
+                measured_rtt_ms: measured_rtt
+                    .as_millis()
+                    .try_into()
+                    .expect("measured_rtt should not exceed a u32"),
+            },
         }
     }
 }
@@ -41,6 +47,9 @@ pub struct PathProcessResult {
 
     #[expect(missing_docs, reason = "Binding-friendly version")]
     pub incoming_ulp_data: Option<Vec<u8>>,
+
+    #[expect(missing_docs, reason = "Binding-friendly version")]
+    pub more_incoming_ulp_data: bool,
 }
 
 impl From<d2d_rendezvous::PathProcessResult> for PathProcessResult {
@@ -49,6 +58,51 @@ impl From<d2d_rendezvous::PathProcessResult> for PathProcessResult {
             state_update: result.state_update.map(PathStateUpdate::from),
             outgoing_frame: result.outgoing_frame.map(Into::into),
             incoming_ulp_data: result.incoming_ulp_data,
+            more_incoming_ulp_data: result.more_incoming_ulp_data,
+        }
+    }
+}
+
+/// Result of [`RendezvousProtocol::poll_nomination`], associated to the automatically nominated
+/// path.
+#[derive(uniffi::Record)]
+pub struct AutomaticNominationResult {
+    /// The nominated path's PID.
+    pub pid: u32,
+
+    /// The result to be handled for the nominated path.
+    pub result: PathProcessResult,
+}
+
+/// Result of [`RendezvousProtocol::create_striped_ulp_frame`], associated to the selected path.
+#[derive(uniffi::Record)]
+pub struct StripedUlpFrameResult {
+    /// The PID of the path the outgoing frame must be sent on.
+    pub pid: u32,
+
+    /// The result to be handled for the path.
+    pub result: PathProcessResult,
+}
+
+/// Binding-friendly version of [`d2d_rendezvous::StripingPolicy`].
+#[derive(uniffi::Record)]
+pub struct StripingPolicy {
+    #[expect(missing_docs, reason = "Binding-friendly version")]
+    pub max_paths: u32,
+
+    #[expect(missing_docs, reason = "Binding-friendly version")]
+    pub max_in_flight_bytes: u32,
+
+    #[expect(missing_docs, reason = "Binding-friendly version")]
+    pub max_reorder_frames: u32,
+}
+
+impl From<StripingPolicy> for d2d_rendezvous::StripingPolicy {
+    fn from(policy: StripingPolicy) -> Self {
+        Self {
+            max_paths: policy.max_paths as usize,
+            max_in_flight_bytes: policy.max_in_flight_bytes as usize,
+            max_reorder_frames: policy.max_reorder_frames as usize,
         }
     }
 }
@@ -189,6 +243,105 @@ impl RendezvousProtocol {
             .map(PathProcessResult::from)
     }
 
+    /// Binding-friendly version of
+    /// [`d2d_rendezvous::RendezvousProtocol::enable_automatic_nomination`].
+    #[expect(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    pub fn enable_automatic_nomination(&self, deadline_ms: u32) -> Result<(), RendezvousProtocolError> {
+        self.inner
+            .lock_ignore_poison()
+            .enable_automatic_nomination(d2d_rendezvous::NominationPolicy {
+                deadline: Duration::from_millis(deadline_ms.into()),
+            })
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::nomination_timeout`].
+    #[must_use]
+    pub fn nomination_timeout_ms(&self) -> Option<u32> {
+        self.inner
+            .lock_ignore_poison()
+            .nomination_timeout()
+            .map(|timeout| timeout.as_millis().try_into().unwrap_or(u32::MAX))
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::poll_nomination`].
+    #[expect(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    pub fn poll_nomination(&self) -> Result<Option<AutomaticNominationResult>, RendezvousProtocolError> {
+        self.inner
+            .lock_ignore_poison()
+            .poll_nomination()
+            .map(|nomination| {
+                nomination.map(|(pid, result)| AutomaticNominationResult {
+                    pid,
+                    result: PathProcessResult::from(result),
+                })
+            })
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::enable_striping`].
+    #[expect(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    pub fn enable_striping(&self, policy: StripingPolicy) -> Result<(), RendezvousProtocolError> {
+        self.inner.lock_ignore_poison().enable_striping(policy.into())
+    }
+
+    /// See [`d2d_rendezvous::RendezvousProtocol::nominated_paths`].
+    #[must_use]
+    pub fn nominated_paths(&self) -> Vec<u32> {
+        self.inner.lock_ignore_poison().nominated_paths()
+    }
+
+    /// See [`d2d_rendezvous::RendezvousProtocol::is_congested`].
+    #[must_use]
+    pub fn is_congested(&self) -> bool {
+        self.inner.lock_ignore_poison().is_congested()
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::create_striped_ulp_frame`].
+    #[expect(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    pub fn create_striped_ulp_frame(
+        &self,
+        outgoing_data: Vec<u8>,
+    ) -> Result<StripedUlpFrameResult, RendezvousProtocolError> {
+        self.inner
+            .lock_ignore_poison()
+            .create_striped_ulp_frame(outgoing_data)
+            .map(|(pid, result)| StripedUlpFrameResult {
+                pid,
+                result: PathProcessResult::from(result),
+            })
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::ulp_frame_flushed`].
+    #[expect(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    pub fn ulp_frame_flushed(&self, pid: u32) -> Result<(), RendezvousProtocolError> {
+        self.inner.lock_ignore_poison().ulp_frame_flushed(pid)
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::enable_ulp_streaming`].
+    #[expect(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    pub fn enable_ulp_streaming(&self) -> Result<(), RendezvousProtocolError> {
+        self.inner.lock_ignore_poison().enable_ulp_streaming()
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::write_ulp_stream`].
+    #[expect(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    pub fn write_ulp_stream(
+        &self,
+        outgoing_data: Vec<u8>,
+        end_of_payload: bool,
+    ) -> Result<Vec<StripedUlpFrameResult>, RendezvousProtocolError> {
+        let results = self
+            .inner
+            .lock_ignore_poison()
+            .write_ulp_stream(&outgoing_data, end_of_payload)?;
+        Ok(results
+            .into_iter()
+            .map(|(pid, result)| StripedUlpFrameResult {
+                pid,
+                result: PathProcessResult::from(result),
+            })
+            .collect())
+    }
+
     /// Binding-friendly version of [`RendezvousProtocol::create_ulp_frame`].
     #[expect(clippy::missing_errors_doc, reason = "Binding-friendly version")]
     pub fn create_ulp_frame(
@@ -90,6 +90,21 @@ impl TryFrom<Argon2idParameters> for argon2::Params {
     }
 }
 
+fn derive_argon2id(
+    arena: &mut argon2::Argon2idArena,
+    password: &[u8],
+    salt: &[u8],
+    parameters: Argon2idParameters,
+) -> Result<Vec<u8>, Error> {
+    let context = argon2::ParallelArgon2id::with_available_parallelism(parameters.try_into()?);
+    let mut output = vec![0; parameters.output_length as usize];
+    context
+        .hash_password_into(arena, password, salt, &mut output)
+        .map_err(|error| Error::new(format!("Invalid Argon2id parameters: {error}").as_ref()))?;
+
+    Ok(output)
+}
+
 /// Derive a key from the provided password and salt using Argon2id.
 ///
 /// # Errors
@@ -102,13 +117,51 @@ impl TryFrom<Argon2idParameters> for argon2::Params {
 )]
 #[wasm_bindgen(js_name = argon2id)]
 pub fn argon2id(password: &[u8], salt: &[u8], parameters: Argon2idParameters) -> Result<Vec<u8>, Error> {
-    let context = argon2::Argon2::new(argon2::Argon2id, argon2::Version::V0x13, parameters.try_into()?);
-    let mut output = vec![0; parameters.output_length as usize];
-    context
-        .hash_password_into(password, salt, &mut output)
-        .map_err(|error| Error::new(format!("Invalid Argon2id parameters: {error}").as_ref()))?;
+    derive_argon2id(&mut argon2::Argon2idArena::default(), password, salt, parameters)
+}
 
-    Ok(output)
+/// Memory for repeated Argon2id derivations, so that it does not need to be allocated for each
+/// derivation.
+///
+/// The memory is wiped when released or when the arena is freed.
+#[wasm_bindgen]
+#[derive(Default)]
+pub struct Argon2idArena(argon2::Argon2idArena);
+
+#[wasm_bindgen]
+impl Argon2idArena {
+    /// Create an arena without any memory.
+    #[wasm_bindgen(constructor)]
+    #[must_use]
+    pub fn new() -> Argon2idArena {
+        Self::default()
+    }
+
+    /// Derive a key like [`argon2id`], using (and growing) the memory of the arena.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if the passed parameters are invalid (see
+    /// [`Argon2idParameters`] for the requirements).
+    #[allow(
+        clippy::needless_pass_by_value,
+        reason = "&Argon2idParameters is not supported by wasm-bindgen"
+    )]
+    #[wasm_bindgen(js_name = argon2id)]
+    pub fn argon2id(
+        &mut self,
+        password: &[u8],
+        salt: &[u8],
+        parameters: Argon2idParameters,
+    ) -> Result<Vec<u8>, Error> {
+        derive_argon2id(&mut self.0, password, salt, parameters)
+    }
+
+    /// Wipe and release the memory.
+    #[wasm_bindgen(js_name = release)]
+    pub fn release(&mut self) {
+        self.0.release();
+    }
 }
 
 /// Parameters for [`scrypt`]
@@ -1,11 +1,14 @@
 //! Bindings for the _Connection Rendezvous Protocol_.
 use js_sys::Error;
-use serde::Serialize;
+use serde::{Deserialize, Serialize};
 use serde_bytes::ByteBuf;
 use tsify_next::Tsify;
 use wasm_bindgen::prelude::*;
 
-use crate::d2d_rendezvous::{self, AuthenticationKey};
+use crate::{
+    d2d_rendezvous::{self, AuthenticationKey},
+    utils::time::Duration,
+};
 
 /// Binding-friendly version of [`d2d_rendezvous::PathStateUpdate`].
 #[derive(Tsify, Serialize)]
@@ -18,7 +21,7 @@ pub enum PathStateUpdate {
 
     #[expect(missing_docs, reason = "Binding-friendly version")]
     #[serde(rename_all = "camelCase")]
-    Nominated { rph: ByteBuf },
+    Nominated { rph: ByteBuf, measured_rtt_ms: u32 },
 }
 
 impl From<d2d_rendezvous::PathStateUpdate> for PathStateUpdate {
@@ -30,8 +33,12 @@ impl From<d2d_rendezvous::PathStateUpdate> for PathStateUpdate {
                     .try_into()
                     .expect("measured_rtt should not exceed a u32"),
             },
-            d2d_rendezvous::PathStateUpdate::Nominated { rph } => Self::Nominated {
+            d2d_rendezvous::PathStateUpdate::Nominated { rph, measured_rtt } => Self::Nominated {
                 rph: ByteBuf::from(rph.0.to_vec()),
+                measured_rtt_ms: measured_rtt
+                    .as_millis()
+                    .try_into()
+                    .expect("measured_rtt should not exceed a u32"),
             },
         }
     }
@@ -50,6 +57,9 @@ pub struct PathProcessResult {
 
     #[expect(missing_docs, reason = "Binding-friendly version")]
     pub incoming_ulp_data: Option<ByteBuf>,
+
+    #[expect(missing_docs, reason = "Binding-friendly version")]
+    pub more_incoming_ulp_data: bool,
 }
 
 impl From<d2d_rendezvous::PathProcessResult> for PathProcessResult {
@@ -60,6 +70,66 @@ impl From<d2d_rendezvous::PathProcessResult> for PathProcessResult {
                 .outgoing_frame
                 .map(|outgoing_frame| Vec::<u8>::from(outgoing_frame).into()),
             incoming_ulp_data: result.incoming_ulp_data.map(Into::into),
+            more_incoming_ulp_data: result.more_incoming_ulp_data,
+        }
+    }
+}
+
+/// Result of [`RendezvousProtocol::poll_nomination`], associated to the automatically nominated
+/// path.
+#[derive(Tsify, Serialize)]
+#[serde(rename_all = "camelCase")]
+#[tsify(into_wasm_abi)]
+pub struct AutomaticNominationResult {
+    /// The nominated path's PID.
+    pub pid: u32,
+
+    /// The result to be handled for the nominated path.
+    pub result: PathProcessResult,
+}
+
+/// Result of [`RendezvousProtocol::create_striped_ulp_frame`], associated to the selected path.
+#[derive(Tsify, Serialize)]
+#[serde(rename_all = "camelCase")]
+#[tsify(into_wasm_abi)]
+pub struct StripedUlpFrameResult {
+    /// The PID of the path the outgoing frame must be sent on.
+    pub pid: u32,
+
+    /// The result to be handled for the path.
+    pub result: PathProcessResult,
+}
+
+/// Result of [`RendezvousProtocol::write_ulp_stream`].
+#[derive(Tsify, Serialize)]
+#[serde(rename_all = "camelCase")]
+#[tsify(into_wasm_abi)]
+pub struct UlpStreamResult {
+    /// The outgoing frames of all complete records, associated to the path they must be sent on.
+    pub frames: Vec<StripedUlpFrameResult>,
+}
+
+/// Binding-friendly version of [`d2d_rendezvous::StripingPolicy`].
+#[derive(Clone, Copy, Tsify, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+#[tsify(from_wasm_abi, into_wasm_abi)]
+pub struct StripingPolicy {
+    #[expect(missing_docs, reason = "Binding-friendly version")]
+    pub max_paths: u32,
+
+    #[expect(missing_docs, reason = "Binding-friendly version")]
+    pub max_in_flight_bytes: u32,
+
+    #[expect(missing_docs, reason = "Binding-friendly version")]
+    pub max_reorder_frames: u32,
+}
+
+impl From<StripingPolicy> for d2d_rendezvous::StripingPolicy {
+    fn from(policy: StripingPolicy) -> Self {
+        Self {
+            max_paths: policy.max_paths as usize,
+            max_in_flight_bytes: policy.max_in_flight_bytes as usize,
+            max_reorder_frames: policy.max_reorder_frames as usize,
         }
     }
 }
@@ -192,6 +262,114 @@ impl RendezvousProtocol {
             .map_err(|error| Error::new(format!("Could not nominate path: {error}").as_ref()))
     }
 
+    /// Binding-friendly version of
+    /// [`d2d_rendezvous::RendezvousProtocol::enable_automatic_nomination`].
+    #[allow(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    #[wasm_bindgen(js_name = enableAutomaticNomination)]
+    pub fn enable_automatic_nomination(&mut self, deadline_ms: u32) -> Result<(), Error> {
+        self.inner
+            .enable_automatic_nomination(d2d_rendezvous::NominationPolicy {
+                deadline: Duration::from_millis(deadline_ms.into()),
+            })
+            .map_err(|error| Error::new(format!("Could not enable automatic nomination: {error}").as_ref()))
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::nomination_timeout`].
+    #[wasm_bindgen(js_name = nominationTimeoutMs)]
+    #[must_use]
+    pub fn nomination_timeout_ms(&self) -> Option<u32> {
+        self.inner
+            .nomination_timeout()
+            .map(|timeout| timeout.as_millis().try_into().unwrap_or(u32::MAX))
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::poll_nomination`].
+    #[allow(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    #[wasm_bindgen(js_name = pollNomination)]
+    pub fn poll_nomination(&mut self) -> Result<Option<AutomaticNominationResult>, Error> {
+        self.inner
+            .poll_nomination()
+            .map(|nomination| {
+                nomination.map(|(pid, result)| AutomaticNominationResult {
+                    pid,
+                    result: PathProcessResult::from(result),
+                })
+            })
+            .map_err(|error| Error::new(format!("Could not nominate path: {error}").as_ref()))
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::enable_striping`].
+    #[allow(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    #[wasm_bindgen(js_name = enableStriping)]
+    pub fn enable_striping(&mut self, policy: StripingPolicy) -> Result<(), Error> {
+        self.inner
+            .enable_striping(policy.into())
+            .map_err(|error| Error::new(format!("Could not enable striping: {error}").as_ref()))
+    }
+
+    /// See [`d2d_rendezvous::RendezvousProtocol::nominated_paths`].
+    #[wasm_bindgen(js_name = nominatedPaths)]
+    #[must_use]
+    pub fn nominated_paths(&self) -> Vec<u32> {
+        self.inner.nominated_paths()
+    }
+
+    /// See [`d2d_rendezvous::RendezvousProtocol::is_congested`].
+    #[wasm_bindgen(js_name = isCongested)]
+    #[must_use]
+    pub fn is_congested(&self) -> bool {
+        self.inner.is_congested()
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::create_striped_ulp_frame`].
+    #[allow(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    #[wasm_bindgen(js_name = createStripedUlpFrame)]
+    pub fn create_striped_ulp_frame(&mut self, outgoing_data: Vec<u8>) -> Result<StripedUlpFrameResult, Error> {
+        self.inner
+            .create_striped_ulp_frame(outgoing_data)
+            .map(|(pid, result)| StripedUlpFrameResult {
+                pid,
+                result: PathProcessResult::from(result),
+            })
+            .map_err(|error| Error::new(format!("Could not create striped ULP frame: {error}").as_ref()))
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::ulp_frame_flushed`].
+    #[allow(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    #[wasm_bindgen(js_name = ulpFrameFlushed)]
+    pub fn ulp_frame_flushed(&mut self, pid: u32) -> Result<(), Error> {
+        self.inner
+            .ulp_frame_flushed(pid)
+            .map_err(|error| Error::new(format!("Could not report flushed ULP frame: {error}").as_ref()))
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::enable_ulp_streaming`].
+    #[allow(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    #[wasm_bindgen(js_name = enableUlpStreaming)]
+    pub fn enable_ulp_streaming(&mut self) -> Result<(), Error> {
+        self.inner
+            .enable_ulp_streaming()
+            .map_err(|error| Error::new(format!("Could not enable ULP streaming: {error}").as_ref()))
+    }
+
+    /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::write_ulp_stream`].
+    #[allow(clippy::missing_errors_doc, reason = "Binding-friendly version")]
+    #[wasm_bindgen(js_name = writeUlpStream)]
+    pub fn write_ulp_stream(&mut self, outgoing_data: &[u8], end_of_payload: bool) -> Result<UlpStreamResult, Error> {
+        self.inner
+            .write_ulp_stream(outgoing_data, end_of_payload)
+            .map(|results| UlpStreamResult {
+                frames: results
+                    .into_iter()
+                    .map(|(pid, result)| StripedUlpFrameResult {
+                        pid,
+                        result: PathProcessResult::from(result),
+                    })
+                    .collect(),
+            })
+            .map_err(|error| Error::new(format!("Could not write to the ULP stream: {error}").as_ref()))
+    }
+
     /// Binding-friendly version of [`d2d_rendezvous::RendezvousProtocol::create_ulp_frame`].
     #[allow(clippy::missing_errors_doc, reason = "Binding-friendly version")]
     #[wasm_bindgen(js_name = createUlpFrame)]
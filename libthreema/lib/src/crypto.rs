@@ -9,7 +9,7 @@ pub(crate) mod generic_array {
 
 /// Type aliases for all constants used by Threema protocols.
 pub(crate) mod consts {
-    pub(crate) use cipher::consts::{U24, U32};
+    pub(crate) use cipher::consts::{U16, U24, U32};
 }
 
 /// Minimal abstract interface for general ciphers.
@@ -26,7 +26,10 @@ pub(crate) mod digest {
 
 /// Minimal abstract interface for AEAD ciphers.
 pub(crate) mod aead {
-    pub(crate) use aead::{AeadInPlace, Buffer, Error};
+    pub(crate) use aead::{
+        AeadInPlace, Buffer, Error,
+        stream::{DecryptorBE32, EncryptorBE32},
+    };
     use aead::{Nonce, Result};
 
     use super::cipher::Unsigned as _;
@@ -85,10 +88,7 @@ pub(crate) mod aead {
     }
 }
 
-/// Argon2id for password-based key derivations as used by Threema protocols.
-pub(crate) mod argon2 {
-    pub(crate) use argon2::{Algorithm::Argon2id, Argon2, Params, Version};
-}
+pub(crate) mod argon2;
 
 /// BLAKE2b for hashing and key derivations as used by Threema protocols.
 pub(crate) mod blake2b {
@@ -0,0 +1,752 @@
+//! Argon2id for password-based key derivations as used by Threema protocols.
+//!
+//! The [`argon2`] crate computes all lanes on the calling thread and allocates the whole memory matrix
+//! for each derivation. [`ParallelArgon2id`] produces identical output but
+//!
+//! - computes the segments of all lanes of a slice on worker threads (lanes only depend on each
+//!   other at the end of a slice), and
+//! - takes its memory from an [`Argon2idArena`] that can be reused across derivations.
+//!
+//! The BlaMka permutation is laid out to compute four independent `GB` functions at a time, so that
+//! the compiler can vectorise it on targets with SIMD support (e.g. AVX2 or NEON).
+//!
+//! Note: Only version 0x13 without secret and associated data is supported.
+use core::num::NonZeroUsize;
+use std::thread;
+
+pub(crate) use argon2::{Error, Params};
+use blake2::Blake2bVar;
+use digest::{Update as _, VariableOutput as _};
+use zeroize::{DefaultIsZeroes, Zeroize as _, Zeroizing};
+
+/// Amount of 64-bit words in a block.
+const BLOCK_WORDS: usize = 128;
+
+/// Length of a block in bytes.
+const BLOCK_LENGTH: usize = 1024;
+
+/// Amount of slices per pass. Lanes are synchronised at the end of each slice.
+const SYNC_POINTS: usize = 4;
+
+/// Amount of slices in the first pass using data-independent addressing.
+const DATA_INDEPENDENT_SLICES: usize = 2;
+
+/// Argon2 type (Argon2id) and version (0x13) as encoded into the initial hash.
+const TYPE: u32 = 2;
+const VERSION: u32 = 0x13;
+
+/// Minimum output and salt length, as required by the `argon2` crate.
+const MIN_OUTPUT_LENGTH: usize = 4;
+const MIN_SALT_LENGTH: usize = 8;
+
+/// Maximum output length of a single BLAKE2b invocation (and half of it).
+const BLAKE2B_LENGTH: usize = 64;
+const HALF_BLAKE2B_LENGTH: usize = 32;
+
+const LOWER_32_BITS: u64 = 0xffff_ffff;
+
+/// A block of the memory matrix.
+#[derive(Clone, Copy)]
+#[repr(align(64))]
+struct Block([u64; BLOCK_WORDS]);
+impl Default for Block {
+    fn default() -> Self {
+        Self::ZERO
+    }
+}
+impl DefaultIsZeroes for Block {}
+impl Block {
+    const ZERO: Self = Self([0; BLOCK_WORDS]);
+
+    fn from_bytes(bytes: &[u8; BLOCK_LENGTH]) -> Self {
+        let mut block = Self::ZERO;
+        for (word, chunk) in block.0.iter_mut().zip(bytes.chunks_exact(8)) {
+            *word = u64::from_le_bytes(chunk.try_into().expect("Chunk must be 8 bytes"));
+        }
+        block
+    }
+
+    fn to_bytes(&self) -> [u8; BLOCK_LENGTH] {
+        let mut bytes = [0; BLOCK_LENGTH];
+        for (chunk, word) in bytes.chunks_exact_mut(8).zip(self.0) {
+            chunk.copy_from_slice(&word.to_le_bytes());
+        }
+        bytes
+    }
+
+    fn xor_assign(&mut self, other: &Self) {
+        for (word, other) in self.0.iter_mut().zip(other.0) {
+            *word ^= other;
+        }
+    }
+
+    /// The compression function `G(X, Y)`.
+    ///
+    /// Note: The blocks derive from the password, so the working copies are wiped.
+    fn compress(x: &Self, y: &Self) -> Self {
+        let mut r = Zeroizing::new(*x);
+        r.xor_assign(y);
+
+        // Apply the permutation to each row (16 consecutive words)...
+        let mut q = *r;
+        for row in q.0.chunks_exact_mut(16) {
+            permute(row.try_into().expect("Row must be 16 words"));
+        }
+
+        // ...and then to each column (two adjacent words of each row)
+        for column in 0..8_usize {
+            let offset = column.saturating_mul(2);
+            let mut words = Zeroizing::new([0; 16]);
+            for (pair, row) in words.chunks_exact_mut(2).zip(q.0.chunks_exact(16)) {
+                pair.copy_from_slice(
+                    row.get(offset..offset.saturating_add(2))
+                        .expect("Column must be within row"),
+                );
+            }
+            permute(&mut *words);
+            for (pair, row) in words.chunks_exact(2).zip(q.0.chunks_exact_mut(16)) {
+                row.get_mut(offset..offset.saturating_add(2))
+                    .expect("Column must be within row")
+                    .copy_from_slice(pair);
+            }
+        }
+
+        q.xor_assign(&r);
+        q
+    }
+}
+
+/// The permutation `P` on 16 words.
+///
+/// The words are arranged as a 4x4 matrix. The four `GB` functions applied to the columns (and then
+/// to the diagonals) are independent of each other, so they are computed on four words at once.
+#[rustfmt::skip]
+fn permute(words: &mut [u64; 16]) {
+    // Columns
+    let [w0, w1, w2, w3, w4, w5, w6, w7, w8, w9, w10, w11, w12, w13, w14, w15] = *words;
+    let (mut va, mut vb, mut vc, mut vd) =
+        ([w0, w1, w2, w3], [w4, w5, w6, w7], [w8, w9, w10, w11], [w12, w13, w14, w15]);
+    mix(&mut va, &mut vb, &mut vc, &mut vd);
+
+    // Diagonals
+    let ([w0, w1, w2, w3], [w4, w5, w6, w7], [w8, w9, w10, w11], [w12, w13, w14, w15]) = (va, vb, vc, vd);
+    let (mut va, mut vb, mut vc, mut vd) =
+        ([w0, w1, w2, w3], [w5, w6, w7, w4], [w10, w11, w8, w9], [w15, w12, w13, w14]);
+    mix(&mut va, &mut vb, &mut vc, &mut vd);
+
+    let ([w0, w1, w2, w3], [w5, w6, w7, w4], [w10, w11, w8, w9], [w15, w12, w13, w14]) = (va, vb, vc, vd);
+    *words = [w0, w1, w2, w3, w4, w5, w6, w7, w8, w9, w10, w11, w12, w13, w14, w15];
+}
+
+/// Four `GB` functions at once.
+fn mix(va: &mut [u64; 4], vb: &mut [u64; 4], vc: &mut [u64; 4], vd: &mut [u64; 4]) {
+    blamka(va, vb);
+    xor_rotate(vd, va, 32);
+    blamka(vc, vd);
+    xor_rotate(vb, vc, 24);
+    blamka(va, vb);
+    xor_rotate(vd, va, 16);
+    blamka(vc, vd);
+    xor_rotate(vb, vc, 63);
+}
+
+/// `x = x + y + 2 * lsw(x) * lsw(y)` for each word.
+fn blamka(x: &mut [u64; 4], y: &[u64; 4]) {
+    for (x, y) in x.iter_mut().zip(y) {
+        let product = (*x & LOWER_32_BITS).wrapping_mul(*y & LOWER_32_BITS);
+        *x = x.wrapping_add(*y).wrapping_add(product.wrapping_mul(2));
+    }
+}
+
+/// `x = (x ^ y) >>> n` for each word.
+fn xor_rotate(x: &mut [u64; 4], y: &[u64; 4], n: u32) {
+    for (x, y) in x.iter_mut().zip(y) {
+        *x = (*x ^ *y).rotate_right(n);
+    }
+}
+
+/// BLAKE2b with an output length of `output.len()` (at most 64 bytes) over the concatenated
+/// `inputs`.
+fn blake2b(inputs: &[&[u8]], output: &mut [u8]) {
+    let mut hasher = Blake2bVar::new(output.len()).expect("Output length must be valid for BLAKE2b");
+    for input in inputs {
+        hasher.update(input);
+    }
+    hasher
+        .finalize_variable(output)
+        .expect("Output length must match BLAKE2b output length");
+}
+
+/// The variable-length hash function `H'` over the concatenated `inputs`.
+fn variable_length_hash(inputs: &[&[u8]], mut output: &mut [u8]) {
+    let length = u32::try_from(output.len())
+        .expect("Output length must fit into a u32")
+        .to_le_bytes();
+    let mut prefixed_inputs: Vec<&[u8]> = Vec::with_capacity(inputs.len().saturating_add(1));
+    prefixed_inputs.push(&length);
+    prefixed_inputs.extend_from_slice(inputs);
+    if output.len() <= BLAKE2B_LENGTH {
+        blake2b(&prefixed_inputs, output);
+        return;
+    }
+
+    // Output the first half of each chained hash, followed by a final hash of the remaining length
+    let mut hash = Zeroizing::new([0; BLAKE2B_LENGTH]);
+    blake2b(&prefixed_inputs, &mut *hash);
+    loop {
+        let (chunk, remaining) = core::mem::take(&mut output).split_at_mut(HALF_BLAKE2B_LENGTH);
+        chunk.copy_from_slice(
+            hash.get(..HALF_BLAKE2B_LENGTH)
+                .expect("Hash must be at least half its length"),
+        );
+        output = remaining;
+        if output.len() <= BLAKE2B_LENGTH {
+            blake2b(&[&*hash], output);
+            return;
+        }
+        let previous_hash = hash.clone();
+        blake2b(&[&*previous_hash], &mut *hash);
+    }
+}
+
+/// Memory for [`ParallelArgon2id`] that can be reused across derivations.
+///
+/// Allocating (and faulting in) the memory matrix is a notable part of a derivation at the memory
+/// costs used by Threema protocols (e.g. 128 MiB for the identity backup). The arena keeps the
+/// largest memory matrix used so far around. The blocks used by a derivation are wiped once it
+/// finished, and all of the memory is wiped when released or dropped.
+#[derive(Default)]
+pub(crate) struct Argon2idArena(Vec<Block>);
+impl Argon2idArena {
+    /// Wipe and release the memory.
+    pub(crate) fn release(&mut self) {
+        self.0.zeroize();
+        self.0 = vec![];
+    }
+
+    /// Get `count` blocks, growing the memory if necessary.
+    fn blocks(&mut self, count: usize) -> &mut [Block] {
+        if self.0.len() < count {
+            self.release();
+            self.0 = vec![Block::ZERO; count];
+        }
+        self.0.get_mut(..count).expect("Arena must hold enough blocks")
+    }
+}
+impl Drop for Argon2idArena {
+    fn drop(&mut self) {
+        self.0.zeroize();
+    }
+}
+
+/// Dimensions of the memory matrix.
+#[derive(Clone, Copy)]
+struct Geometry {
+    lanes: usize,
+    lane_length: usize,
+    segment_length: usize,
+    passes: usize,
+}
+impl Geometry {
+    fn new(params: &Params) -> Self {
+        let lanes = params.p_cost() as usize;
+        let segment_length = (params.m_cost() as usize)
+            .checked_div(lanes.saturating_mul(SYNC_POINTS))
+            .expect("Amount of lanes must not be zero");
+        Self {
+            lanes,
+            lane_length: segment_length.saturating_mul(SYNC_POINTS),
+            segment_length,
+            passes: params.t_cost() as usize,
+        }
+    }
+
+    fn block_count(&self) -> usize {
+        self.lanes.saturating_mul(self.lane_length)
+    }
+
+    /// Map the pseudo-random value `j1` for the block at `index` within the segment at `position`
+    /// to a block index within the reference lane.
+    fn reference_index(&self, position: Position, index: usize, j1: u64, same_lane: bool) -> usize {
+        let (lane_length, segment_length) = (self.lane_length as u64, self.segment_length as u64);
+        let (slice, index) = (position.slice as u64, index as u64);
+
+        // Determine the amount of blocks that may be referenced. Blocks of another lane may only
+        // be referenced from finished segments.
+        let finished_blocks = if position.pass == 0 {
+            slice.saturating_mul(segment_length)
+        } else {
+            lane_length.saturating_sub(segment_length)
+        };
+        let area_size = if same_lane {
+            finished_blocks.saturating_add(index).saturating_sub(1)
+        } else if index == 0 {
+            finished_blocks.saturating_sub(1)
+        } else {
+            finished_blocks
+        };
+
+        // Map `j1` non-uniformly onto the area, favouring recent blocks
+        let relative_position = j1.wrapping_mul(j1).wrapping_shr(32);
+        let relative_position = area_size
+            .saturating_sub(1)
+            .saturating_sub(area_size.wrapping_mul(relative_position).wrapping_shr(32));
+
+        // The area starts after the current segment (except in the first pass)
+        let start_position = if position.pass == 0 || position.slice == SYNC_POINTS.saturating_sub(1) {
+            0
+        } else {
+            slice.saturating_add(1).saturating_mul(segment_length)
+        };
+        let reference_index = start_position
+            .saturating_add(relative_position)
+            .checked_rem(lane_length)
+            .expect("Lane length must not be zero");
+        usize::try_from(reference_index).expect("Reference index must fit into a usize")
+    }
+}
+
+/// Position of the segment being computed.
+#[derive(Clone, Copy)]
+struct Position {
+    pass: usize,
+    lane: usize,
+    slice: usize,
+}
+
+/// The finished segments of a lane that may be referenced while computing a slice.
+struct LaneView<'memory> {
+    /// Segments before the current slice.
+    before: &'memory [Block],
+
+    /// Segments after the current slice.
+    after: &'memory [Block],
+}
+
+/// Read access to all blocks that may be referenced while computing the block at
+/// `slice_start + written.len()` of `lane`.
+struct ReferenceMemory<'view, 'memory> {
+    lanes: &'view [LaneView<'memory>],
+    lane: usize,
+    slice_start: usize,
+    segment_length: usize,
+    written: &'view [Block],
+}
+impl ReferenceMemory<'_, '_> {
+    fn get(&self, lane: usize, index: usize) -> &Block {
+        let block = if index < self.slice_start {
+            self.lanes.get(lane).and_then(|view| view.before.get(index))
+        } else {
+            let index = index.saturating_sub(self.slice_start);
+            if index < self.segment_length {
+                // Only the blocks of the own lane that have already been computed may be referenced
+                (lane == self.lane).then(|| self.written.get(index)).flatten()
+            } else {
+                self.lanes
+                    .get(lane)
+                    .and_then(|view| view.after.get(index.saturating_sub(self.segment_length)))
+            }
+        };
+        block.expect("Referenced block must be finished")
+    }
+}
+
+/// Generator of pseudo-random values for data-independent addressing.
+struct AddressGenerator {
+    input: Block,
+    addresses: Block,
+}
+impl AddressGenerator {
+    fn new(geometry: &Geometry, position: Position) -> Self {
+        let mut input = Block::ZERO;
+        input.0[0] = position.pass as u64;
+        input.0[1] = position.lane as u64;
+        input.0[2] = position.slice as u64;
+        input.0[3] = geometry.block_count() as u64;
+        input.0[4] = geometry.passes as u64;
+        input.0[5] = u64::from(TYPE);
+        Self {
+            input,
+            addresses: Block::ZERO,
+        }
+    }
+
+    /// Get the pseudo-random value for the block at `index` within the segment. `first` must be
+    /// set for the first block computed in the segment.
+    fn get(&mut self, index: usize, first: bool) -> u64 {
+        let offset = index
+            .checked_rem(BLOCK_WORDS)
+            .expect("Block words must not be zero");
+        if first || offset == 0 {
+            self.input.0[6] = self.input.0[6].wrapping_add(1);
+            self.addresses = Block::compress(&Block::ZERO, &Block::compress(&Block::ZERO, &self.input));
+        }
+        *self.addresses.0.get(offset).expect("Offset must be within block")
+    }
+}
+
+/// Argon2id (version 0x13) computing the lanes of each slice on up to `threads` threads.
+///
+/// Produces the same output as [`argon2::Argon2`] with Argon2id and version 0x13.
+pub(crate) struct ParallelArgon2id {
+    params: Params,
+    threads: usize,
+}
+impl ParallelArgon2id {
+    /// Create an Argon2id instance using up to `threads` threads. No more threads than lanes (i.e.
+    /// the degree of parallelism of `params`) are used.
+    pub(crate) fn new(params: Params, threads: NonZeroUsize) -> Self {
+        let threads = threads.get().min(params.p_cost() as usize).max(1);
+        Self { params, threads }
+    }
+
+    /// Create an Argon2id instance using as many threads as available.
+    ///
+    /// Note: Falls back to the calling thread on platforms without threads.
+    pub(crate) fn with_available_parallelism(params: Params) -> Self {
+        Self::new(
+            params,
+            thread::available_parallelism().unwrap_or(NonZeroUsize::MIN),
+        )
+    }
+
+    /// Derive `output` from `password` and `salt`, using (and growing) the memory of `arena`.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`Error`] if the length of `password`, `salt` or `output` is invalid.
+    pub(crate) fn hash_password_into(
+        &self,
+        arena: &mut Argon2idArena,
+        password: &[u8],
+        salt: &[u8],
+        output: &mut [u8],
+    ) -> Result<(), Error> {
+        // Validate the inputs like the `argon2` crate does
+        let output_length = u32::try_from(output.len()).map_err(|_| Error::OutputTooLong)?;
+        if output.len() < MIN_OUTPUT_LENGTH
+            || self
+                .params
+                .output_len()
+                .is_some_and(|length| output.len() < length)
+        {
+            return Err(Error::OutputTooShort);
+        }
+        if self
+            .params
+            .output_len()
+            .is_some_and(|length| output.len() > length)
+        {
+            return Err(Error::OutputTooLong);
+        }
+        let password_length = u32::try_from(password.len()).map_err(|_| Error::PwdTooLong)?;
+        let salt_length = u32::try_from(salt.len()).map_err(|_| Error::SaltTooLong)?;
+        if salt.len() < MIN_SALT_LENGTH {
+            return Err(Error::SaltTooShort);
+        }
+
+        // Compute the initial hash
+        let mut initial_hash = Zeroizing::new([0; BLAKE2B_LENGTH]);
+        blake2b(
+            &[
+                &self.params.p_cost().to_le_bytes(),
+                &output_length.to_le_bytes(),
+                &self.params.m_cost().to_le_bytes(),
+                &self.params.t_cost().to_le_bytes(),
+                &VERSION.to_le_bytes(),
+                &TYPE.to_le_bytes(),
+                &password_length.to_le_bytes(),
+                password,
+                &salt_length.to_le_bytes(),
+                salt,
+                &0_u32.to_le_bytes(),
+                &0_u32.to_le_bytes(),
+            ],
+            &mut *initial_hash,
+        );
+
+        // Derive the first two blocks of each lane from it
+        let geometry = Geometry::new(&self.params);
+        let memory = arena.blocks(geometry.block_count());
+        for (lane_index, lane) in memory.chunks_exact_mut(geometry.lane_length).enumerate() {
+            let lane_index = u32::try_from(lane_index).expect("Lane index must fit into a u32");
+            for (block_index, block) in (0_u32..2).zip(lane.iter_mut()) {
+                let mut bytes = Zeroizing::new([0; BLOCK_LENGTH]);
+                variable_length_hash(
+                    &[
+                        &*initial_hash,
+                        &block_index.to_le_bytes(),
+                        &lane_index.to_le_bytes(),
+                    ],
+                    &mut *bytes,
+                );
+                *block = Block::from_bytes(&bytes);
+            }
+        }
+
+        // Fill the memory
+        for pass in 0..geometry.passes {
+            for slice in 0..SYNC_POINTS {
+                self.fill_slice(&geometry, memory, pass, slice);
+            }
+        }
+
+        // Hash the XOR of the last block of each lane into the output
+        let mut final_block = Zeroizing::new(Block::ZERO);
+        for lane in memory.chunks_exact(geometry.lane_length) {
+            final_block.xor_assign(lane.last().expect("Lane must not be empty"));
+        }
+        variable_length_hash(&[&*Zeroizing::new(final_block.to_bytes())], output);
+
+        // Wipe the memory, so that it does not linger in the arena until it is reused
+        memory.zeroize();
+        Ok(())
+    }
+
+    /// Compute the segments of all lanes of a slice, spread across the worker threads.
+    fn fill_slice(&self, geometry: &Geometry, memory: &mut [Block], pass: usize, slice: usize) {
+        // Split each lane into the segment being computed and the finished segments
+        let slice_start = slice.saturating_mul(geometry.segment_length);
+        let mut views = Vec::with_capacity(geometry.lanes);
+        let mut segments = Vec::with_capacity(geometry.lanes);
+        for (lane, blocks) in memory.chunks_exact_mut(geometry.lane_length).enumerate() {
+            let (before, remaining) = blocks.split_at_mut(slice_start);
+            let (segment, after) = remaining.split_at_mut(geometry.segment_length);
+            views.push(LaneView { before, after });
+            segments.push((Position { pass, lane, slice }, segment));
+        }
+
+        let fill = |(position, segment): &mut (Position, &mut [Block])| {
+            fill_segment(geometry, &views, *position, segment);
+        };
+        if self.threads <= 1 {
+            segments.iter_mut().for_each(fill);
+            return;
+        }
+        let chunk_size = segments.len().div_ceil(self.threads);
+        thread::scope(|scope| {
+            for chunk in segments.chunks_mut(chunk_size) {
+                let fill = &fill;
+                let _ = scope.spawn(move || chunk.iter_mut().for_each(fill));
+            }
+        });
+    }
+}
+
+/// Compute the blocks of the segment at `position`.
+fn fill_segment(geometry: &Geometry, lanes: &[LaneView<'_>], position: Position, segment: &mut [Block]) {
+    let slice_start = position.slice.saturating_mul(geometry.segment_length);
+    let last_index = geometry.lane_length.saturating_sub(1);
+    let mut addresses = (position.pass == 0 && position.slice < DATA_INDEPENDENT_SLICES)
+        .then(|| AddressGenerator::new(geometry, position));
+
+    // The first two blocks of each lane have been derived from the initial hash
+    let start = if position.pass == 0 && position.slice == 0 {
+        2
+    } else {
+        0
+    };
+    for index in start..segment.len() {
+        let (written, remaining) = segment.split_at_mut(index);
+        let block = remaining.first_mut().expect("Index must be within segment");
+        let memory = ReferenceMemory {
+            lanes,
+            lane: position.lane,
+            slice_start,
+            segment_length: geometry.segment_length,
+            written,
+        };
+
+        // Determine the previous and the reference block
+        let previous_index = slice_start
+            .saturating_add(index)
+            .checked_sub(1)
+            .unwrap_or(last_index);
+        let previous = memory.get(position.lane, previous_index);
+        let pseudo_random = match &mut addresses {
+            Some(addresses) => addresses.get(index, index == start),
+            None => previous.0[0],
+        };
+        let reference_lane = if position.pass == 0 && position.slice == 0 {
+            position.lane
+        } else {
+            let reference_lane = pseudo_random
+                .wrapping_shr(32)
+                .checked_rem(geometry.lanes as u64)
+                .expect("Amount of lanes must not be zero");
+            usize::try_from(reference_lane).expect("Reference lane must fit into a usize")
+        };
+        let reference_index = geometry.reference_index(
+            position,
+            index,
+            pseudo_random & LOWER_32_BITS,
+            reference_lane == position.lane,
+        );
+        let reference = memory.get(reference_lane, reference_index);
+
+        // Compute the block (and combine it with the block of the previous pass)
+        let new_block = Zeroizing::new(Block::compress(previous, reference));
+        if position.pass == 0 {
+            *block = *new_block;
+        } else {
+            block.xor_assign(&new_block);
+        }
+    }
+}
+
+/// Access to [`ParallelArgon2id`] for benchmarks (see `benches/`). Not part of the public API.
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub mod bench {
+    use core::num::NonZeroUsize;
+
+    use super::{Argon2idArena, ParallelArgon2id, Params};
+
+    /// Memory cost (in KiB) used by the identity backup.
+    pub const BACKUP_MEMORY_COST: u32 = 128 * 1024;
+
+    /// Amount of iterations used by the identity backup.
+    pub const BACKUP_TIME_COST: u32 = 8;
+
+    /// Argon2id at the memory and time cost of the identity backup.
+    pub struct BackupKdf {
+        argon2: ParallelArgon2id,
+        arena: Option<Argon2idArena>,
+    }
+
+    impl BackupKdf {
+        /// Compute `lanes` lanes on up to `threads` threads. If `reuse_memory` is not set, the
+        /// memory is allocated for each derivation.
+        #[must_use]
+        pub fn new(lanes: u32, threads: NonZeroUsize, reuse_memory: bool) -> Self {
+            let params = Params::new(BACKUP_MEMORY_COST, BACKUP_TIME_COST, lanes, Some(32))
+                .expect("Argon2id parameters must be valid");
+            Self {
+                argon2: ParallelArgon2id::new(params, threads),
+                arena: reuse_memory.then(Argon2idArena::default),
+            }
+        }
+
+        /// Derive a 32 byte key.
+        #[must_use]
+        pub fn derive(&mut self, password: &[u8], salt: &[u8]) -> [u8; 32] {
+            let mut key = [0; 32];
+            let mut fresh_arena = Argon2idArena::default();
+            self.argon2
+                .hash_password_into(
+                    self.arena.as_mut().unwrap_or(&mut fresh_arena),
+                    password,
+                    salt,
+                    &mut key,
+                )
+                .expect("Argon2id must succeed");
+            key
+        }
+    }
+}
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use argon2::{Algorithm::Argon2id, Argon2, Version};
+    use data_encoding::HEXLOWER;
+
+    use super::*;
+
+    /// Derive with the `argon2` crate and [`ParallelArgon2id`] (with 1, 2 and 4 threads) and ensure
+    /// the outputs match.
+    fn assert_matches_argon2_crate(memory_cost: u32, time_cost: u32, lanes: u32, output_length: usize) {
+        let params = Params::new(memory_cost, time_cost, lanes, Some(output_length)).unwrap();
+        let mut expected = vec![0; output_length];
+        Argon2::new(Argon2id, Version::V0x13, params.clone())
+            .hash_password_into(b"password", b"somesalt", &mut expected)
+            .unwrap();
+
+        let mut arena = Argon2idArena::default();
+        for threads in [1, 2, 4] {
+            let mut output = vec![0; output_length];
+            ParallelArgon2id::new(params.clone(), NonZeroUsize::new(threads).unwrap())
+                .hash_password_into(&mut arena, b"password", b"somesalt", &mut output)
+                .unwrap();
+            assert_eq!(output, expected);
+        }
+    }
+
+    #[test]
+    fn reference_test_vectors() {
+        for (lanes, expected) in [
+            (
+                1,
+                "9dfeb910e80bad0311fee20f9c0e2b12c17987b4cac90c2ef54d5b3021c68bfe",
+            ),
+            (
+                2,
+                "6d093c501fd5999645e0ea3bf620d7b8be7fd2db59c20d9fff9539da2bf57037",
+            ),
+        ] {
+            let mut output = [0; 32];
+            ParallelArgon2id::new(Params::new(256, 2, lanes, Some(32)).unwrap(), NonZeroUsize::MIN)
+                .hash_password_into(
+                    &mut Argon2idArena::default(),
+                    b"password",
+                    b"somesalt",
+                    &mut output,
+                )
+                .unwrap();
+            assert_eq!(output.to_vec(), HEXLOWER.decode(expected.as_bytes()).unwrap());
+        }
+    }
+
+    #[test]
+    fn matches_argon2_crate_with_single_lane() {
+        assert_matches_argon2_crate(8, 1, 1, 32);
+        assert_matches_argon2_crate(256, 3, 1, 32);
+        assert_matches_argon2_crate(1024, 8, 1, 64);
+    }
+
+    #[test]
+    fn matches_argon2_crate_with_multiple_lanes() {
+        assert_matches_argon2_crate(32, 3, 4, 32);
+        assert_matches_argon2_crate(1000, 2, 3, 16);
+        assert_matches_argon2_crate(2048, 3, 4, 100);
+    }
+
+    #[test]
+    fn reuse_arena() {
+        let mut arena = Argon2idArena::default();
+        let small = ParallelArgon2id::new(Params::new(64, 1, 2, Some(32)).unwrap(), NonZeroUsize::MIN);
+        let large = ParallelArgon2id::new(Params::new(512, 1, 2, Some(32)).unwrap(), NonZeroUsize::MIN);
+        let mut outputs = [[0; 32]; 4];
+        for (argon2, output) in [&small, &large, &small, &large].into_iter().zip(&mut outputs) {
+            argon2
+                .hash_password_into(&mut arena, b"password", b"somesalt", output)
+                .unwrap();
+        }
+        assert_eq!(outputs[0], outputs[2]);
+        assert_eq!(outputs[1], outputs[3]);
+        assert_eq!(arena.0.len(), 512);
+
+        // The memory must have been wiped after each derivation and released on request
+        assert!(arena.0.iter().all(|block| block.0 == [0; BLOCK_WORDS]));
+        arena.release();
+        assert!(arena.0.is_empty());
+    }
+
+    #[test]
+    fn reject_invalid_lengths() {
+        let argon2 = ParallelArgon2id::new(Params::new(8, 1, 1, Some(32)).unwrap(), NonZeroUsize::MIN);
+        let mut arena = Argon2idArena::default();
+        assert!(matches!(
+            argon2.hash_password_into(&mut arena, b"password", b"short", &mut [0; 32]),
+            Err(Error::SaltTooShort)
+        ));
+        assert!(matches!(
+            argon2.hash_password_into(&mut arena, b"password", b"somesalt", &mut [0; 16]),
+            Err(Error::OutputTooShort)
+        ));
+        assert!(matches!(
+            argon2.hash_password_into(&mut arena, b"password", b"somesalt", &mut [0; 64]),
+            Err(Error::OutputTooLong)
+        ));
+    }
+}
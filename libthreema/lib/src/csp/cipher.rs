@@ -13,7 +13,7 @@ use crate::{
         blake2b::Blake2bMac256,
         cipher::KeyInit as _,
         digest::{MAC_256_LENGTH, Mac as _},
-        salsa20::XSalsa20Poly1305,
+        salsa20::{TAG_LENGTH, XSalsa20Poly1305},
         x25519,
     },
 };
@@ -124,6 +124,26 @@ impl SessionCipher {
         Ok(data)
     }
 
+    /// Encrypt outgoing data in-place, where `data` consists of space for the authentication tag
+    /// followed by the plaintext.
+    fn encrypt_tag_ahead(&mut self, name: &'static str, data: &mut [u8]) -> Result<(), CspProtocolError> {
+        let nonce = Nonce::from_cookie_and_sequence_number(
+            self.client_cookie.0,
+            self.client_sequence_number.0.get_and_increment()?,
+        );
+        let Some((tag, plaintext)) = data.split_at_mut_checked(TAG_LENGTH) else {
+            return Err(CspProtocolError::InternalError(
+                "Data must contain space for the authentication tag",
+            ));
+        };
+        let computed_tag = self
+            .cipher
+            .encrypt_in_place_detached((&nonce).into(), &[], plaintext)
+            .map_err(|_| CspProtocolError::EncryptionFailed { name })?;
+        tag.copy_from_slice(&computed_tag);
+        Ok(())
+    }
+
     /// Decrypt incoming data in-place
     fn decrypt(&mut self, name: &'static str, mut data: Vec<u8>) -> Result<Vec<u8>, CspProtocolError> {
         let nonce = Nonce::from_cookie_and_sequence_number(
@@ -240,10 +260,11 @@ impl PayloadCipher {
         Self(session_cipher)
     }
 
-    /// Encrypt an outgoing payload in-place
+    /// Encrypt an outgoing payload in-place. `payload` must start with [`TAG_LENGTH`] bytes of
+    /// space for the authentication tag, followed by the encoded payload.
     #[inline]
-    pub(super) fn encrypt_payload(&mut self, payload: Vec<u8>) -> Result<Vec<u8>, CspProtocolError> {
-        self.0.encrypt(OutgoingPayload::NAME, payload)
+    pub(super) fn encrypt_payload_in_place(&mut self, payload: &mut [u8]) -> Result<(), CspProtocolError> {
+        self.0.encrypt_tag_ahead(OutgoingPayload::NAME, payload)
     }
 
     /// Decrypt an incoming payload in-place
@@ -252,3 +273,30 @@ impl PayloadCipher {
         self.0.decrypt(IncomingPayload::NAME, payload)
     }
 }
+
+#[cfg(test)]
+impl PayloadCipher {
+    /// Create a payload cipher with a fixed session key that encrypts outgoing payloads with
+    /// `outgoing_cookie` and decrypts incoming payloads with `incoming_cookie`. Swapping the
+    /// cookies yields the cipher of the other side.
+    pub(super) fn for_testing(
+        outgoing_cookie: crate::common::Cookie,
+        incoming_cookie: crate::common::Cookie,
+    ) -> Self {
+        use crate::utils::sequence_numbers::SequenceNumberU64;
+
+        Self(SessionCipher {
+            client_cookie: ClientCookie(outgoing_cookie),
+            client_sequence_number: ClientSequenceNumber(SequenceNumberU64::new(1)),
+            server_cookie: ServerCookie(incoming_cookie),
+            server_sequence_number: ServerSequenceNumber(SequenceNumberU64::new(1)),
+            cipher: XSalsa20Poly1305::new(&[0x42; 32].into()),
+        })
+    }
+
+    /// Encrypt an encoded outgoing payload the way it has been done before encrypting in-place,
+    /// i.e. returning the authentication tag followed by the ciphertext.
+    pub(super) fn encrypt_payload(&mut self, payload: Vec<u8>) -> Result<Vec<u8>, CspProtocolError> {
+        self.0.encrypt(OutgoingPayload::NAME, payload)
+    }
+}
@@ -14,3 +14,25 @@ pub(super) trait FrameEncoder {
     /// Encode the message into a frame with the appropriate header.
     fn encode_to_frame(&self) -> Result<OutgoingFrame, CspProtocolError>;
 }
+
+/// Buffers of outgoing frames that have been sent by the client, kept to encode further outgoing
+/// frames without allocating.
+#[derive(Default)]
+pub(super) struct OutgoingFramePool(Vec<Vec<u8>>);
+impl OutgoingFramePool {
+    /// Maximum amount of buffers retained. Any further buffer will be dropped.
+    const MAX_BUFFERS: usize = 8;
+
+    /// Take a buffer from the pool or create an empty one if the pool is empty.
+    pub(super) fn take(&mut self) -> Vec<u8> {
+        self.0.pop().unwrap_or_default()
+    }
+
+    /// Return a buffer to the pool.
+    pub(super) fn put(&mut self, mut buffer: Vec<u8>) {
+        if self.0.len() < Self::MAX_BUFFERS && buffer.capacity() > 0 {
+            buffer.clear();
+            self.0.push(buffer);
+        }
+    }
+}
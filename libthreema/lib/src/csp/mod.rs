@@ -3,12 +3,12 @@ use core::mem;
 
 use cipher::{LoginAckCipher, LoginBoxes, LoginCipher, decrypt_server_challenge_response};
 use const_format::formatcp;
-use frame::OutgoingFrame;
+use frame::{OutgoingFrame, OutgoingFramePool};
 use handshake_messages::{
     ClientHello, Login, LoginAck, LoginAckData, LoginAckDecoder, LoginData, ServerHelloDecoder,
 };
 use libthreema_macros::{DebugVariantNames, Name, VariantNames};
-use payload::{EncryptedOutgoingPayload, PayloadDecoder};
+use payload::PayloadDecoder;
 use tracing::{debug, error, trace, warn};
 
 use self::{
@@ -400,7 +400,7 @@ impl State {
 
         // Set and return the next state and instruction
         let state = State::PostHandshake(PostHandshakeState {
-            decoder: PayloadDecoder::new(state.decoder.dissolve()),
+            decoder: PayloadDecoder::new(state.decoder.dissolve(), PayloadDecoder::MAX_LENGTH),
             cipher: PayloadCipher::new(state.cipher.dissolve()),
         });
         let instruction = CspProtocolInstruction {
@@ -425,13 +425,21 @@ impl State {
     /// - [`CspProtocolError::IncomingMessagePayloadError`] if the incoming message could not have been
     ///   properly decoded or if the outgoing message could not have been encrypted.
     /// - [`CspProtocolError::CryptoError`] if the incoming payload could not have been decrypted.
-    #[tracing::instrument(skip_all)]
+    /// - [`CspProtocolError::InvalidMessage`] if the incoming frame exceeds the maximum frame length.
+    #[tracing::instrument(level = "trace", skip_all)]
     fn poll_post_handshake(
         mut state: PostHandshakeState,
     ) -> Result<(Self, Option<CspProtocolInstruction>), CspProtocolError> {
         // Poll for a payload
         trace!(decoder = ?state.decoder, "Poll");
-        let Some(payload) = state.decoder.next_frame_and_then(<[u8]>::to_vec) else {
+        let payload = state
+            .decoder
+            .next_frame_and_then(<[u8]>::to_vec)
+            .map_err(|error| CspProtocolError::InvalidMessage {
+                name: "payload frame",
+                cause: error.to_string(),
+            })?;
+        let Some(payload) = payload else {
             return Ok((Self::PostHandshake(state), None));
         };
 
@@ -523,13 +531,16 @@ pub struct CspProtocolInstruction {
 ///    2. Wait for further input from either the chat server or a payload being created by the application.
 ///       1. If data has been received from the chat server, add it via [`CspProtocol::add_chunks`].
 ///       2. If a payload is being created, run [`CspProtocol::create_payload`] and handle the resulting
-///          instruction.
+///          instruction. Once the outgoing frame has been sent, it may be returned via
+///          [`CspProtocol::recycle_outgoing_frame`].
 #[derive(Name, educe::Educe)]
 #[educe(Debug)]
 pub struct CspProtocol {
     #[educe(Debug(ignore))]
     context: Context,
     state: State,
+    #[educe(Debug(ignore))]
+    outgoing_frame_pool: OutgoingFramePool,
 }
 
 impl CspProtocol {
@@ -561,7 +572,14 @@ impl CspProtocol {
             decoder: ServerHelloDecoder::new(),
         });
         debug!(?state, "Starting with initial state");
-        (Self { context, state }, outgoing_frame)
+        (
+            Self {
+                context,
+                state,
+                outgoing_frame_pool: OutgoingFramePool::default(),
+            },
+            outgoing_frame,
+        )
     }
 
     /// Poll to advance the state.
@@ -572,7 +590,7 @@ impl CspProtocol {
     /// # Errors
     ///
     /// Returns [`CspProtocolError`] for all possible reasons.
-    #[tracing::instrument]
+    #[tracing::instrument(level = "trace", skip_all)]
     pub fn poll(&mut self) -> Result<Option<CspProtocolInstruction>, CspProtocolError> {
         let poll_result = match mem::replace(
             &mut self.state,
@@ -604,12 +622,13 @@ impl CspProtocol {
     /// # Errors
     ///
     /// Returns [`CspProtocolError::InvalidState`] if the protocol is in the error state.
-    #[tracing::instrument(skip_all, fields(
-        n_chunks = chunks.len(),
-        chunks_byte_length = chunks.iter().map(|chunk| chunk.len()).sum::<usize>(),
-    ))]
+    #[tracing::instrument(level = "trace", skip_all)]
     pub fn add_chunks(&mut self, chunks: &[&[u8]]) -> Result<(), CspProtocolError> {
-        trace!("Adding chunks");
+        trace!(
+            n_chunks = chunks.len(),
+            chunks_byte_length = chunks.iter().map(|chunk| chunk.len()).sum::<usize>(),
+            "Adding chunks"
+        );
         match &mut self.state {
             State::AwaitingServerHello(state) => {
                 state.decoder.add_chunks(chunks);
@@ -640,7 +659,7 @@ impl CspProtocol {
     /// # Errors
     ///
     /// Returns [`CspProtocolError::InvalidState`] if the protocol is in the error state.
-    #[tracing::instrument]
+    #[tracing::instrument(level = "trace", skip_all)]
     pub fn next_required_length(&self) -> Result<usize, CspProtocolError> {
         let required_length = match &self.state {
             State::AwaitingServerHello(state) => state.decoder.required_length(),
@@ -658,11 +677,14 @@ impl CspProtocol {
 
     /// Create an outgoing payload.
     ///
+    /// The resulting outgoing frame is encoded into a buffer returned via
+    /// [`CspProtocol::recycle_outgoing_frame`] if one is available.
+    ///
     /// # Errors
     ///
     /// Returns [`CspProtocolError::InvalidState`] if the protocol is not in the post-handshake
     /// state.
-    #[tracing::instrument]
+    #[tracing::instrument(level = "trace", skip_all)]
     pub fn create_payload(
         &mut self,
         payload: &OutgoingPayload,
@@ -676,9 +698,7 @@ impl CspProtocol {
 
         // Encode and encrypt the payload into an outgoing frame
         debug!("Creating payload");
-        let payload = payload.encode()?;
-        let payload = state.cipher.encrypt_payload(payload)?;
-        let outgoing_frame = EncryptedOutgoingPayload(payload).encode_to_frame()?;
+        let outgoing_frame = payload.encode_to_frame(&mut state.cipher, self.outgoing_frame_pool.take())?;
 
         // Done
         Ok(CspProtocolInstruction {
@@ -687,4 +707,56 @@ impl CspProtocol {
             incoming_payload: None,
         })
     }
+
+    /// Return an [`OutgoingFrame`] after it has been sent, so that its buffer can be reused for
+    /// following outgoing frames created by [`CspProtocol::create_payload`].
+    ///
+    /// This is optional but avoids an allocation per outgoing frame.
+    pub fn recycle_outgoing_frame(&mut self, outgoing_frame: OutgoingFrame) {
+        self.outgoing_frame_pool.put(outgoing_frame.0);
+    }
+}
+
+/// Access to protocol internals for benchmarks (see `benches/`). Not part of the public API.
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub mod bench {
+    use super::{
+        ClientCookie, ClientSequenceNumber, Context, CspProtocol, LoginCipher, OutgoingFramePool,
+        PayloadCipher, PayloadDecoder, PostHandshakeState, ServerCookie, ServerSequenceNumber, State,
+        TemporaryClientKey, TemporaryServerKey,
+    };
+    use crate::{
+        common::{Cookie, PublicKey},
+        crypto::x25519,
+        utils::sequence_numbers::SequenceNumberU64,
+    };
+
+    /// Create a [`CspProtocol`] in the post-handshake state without running the handshake, using
+    /// random temporary keys.
+    #[must_use]
+    pub fn post_handshake_protocol(context: Context) -> CspProtocol {
+        let temporary_client_key =
+            TemporaryClientKey(x25519::StaticSecret::random_from_rng(rand::thread_rng()));
+        let temporary_server_key = TemporaryServerKey(PublicKey(x25519::PublicKey::from(
+            &x25519::StaticSecret::random_from_rng(rand::thread_rng()),
+        )));
+        let session_cipher = LoginCipher::new(
+            &temporary_client_key,
+            ClientCookie(Cookie::random()),
+            ClientSequenceNumber(SequenceNumberU64::new(1)),
+            ServerCookie(Cookie::random()),
+            ServerSequenceNumber(SequenceNumberU64::new(2)),
+            temporary_server_key,
+        )
+        .dissolve();
+        CspProtocol {
+            context,
+            state: State::PostHandshake(PostHandshakeState {
+                decoder: PayloadDecoder::new(vec![], PayloadDecoder::MAX_LENGTH),
+                cipher: PayloadCipher::new(session_cipher),
+            }),
+            outgoing_frame_pool: OutgoingFramePool::default(),
+        }
+    }
 }
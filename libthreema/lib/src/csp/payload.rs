@@ -2,12 +2,10 @@
 use libthreema_macros::{DebugVariantNames, Name, VariantNames};
 use tracing::error;
 
-use super::{
-    CspProtocolError,
-    frame::{FrameEncoder, OutgoingFrame},
-};
+use super::{CspProtocolError, cipher::PayloadCipher, frame::OutgoingFrame};
 use crate::{
     common::{CspDeviceId, MessageId, ThreemaId},
+    crypto::salsa20,
     utils::{
         bytes::{ByteReader, ByteWriter, OwnedVecByteReader, OwnedVecByteWriter},
         frame::{FrameDelimiter as _, U16LittleEndianDelimiter, VariableLengthFrameDecoder},
@@ -484,8 +482,20 @@ pub enum OutgoingPayload {
 impl OutgoingPayload {
     const HEADER_LENGTH: usize = 1 + PAYLOAD_HEADER_RESERVED.len();
 
-    /// Encode the payload.
-    pub(super) fn encode(&self) -> Result<Vec<u8>, CspProtocolError> {
+    /// Length of the frame header reserved ahead of the encoded payload: The frame's length prefix
+    /// followed by the authentication tag of the encrypted payload.
+    const FRAME_HEADER_LENGTH: usize = U16LittleEndianDelimiter::LENGTH + { salsa20::TAG_LENGTH };
+
+    /// Encode and encrypt the payload into an outgoing frame, reusing `buffer` (e.g. the buffer of
+    /// a previously sent frame).
+    ///
+    /// The frame header is reserved ahead of the payload, so that the payload is written exactly
+    /// once and then encrypted in-place.
+    pub(super) fn encode_to_frame(
+        &self,
+        cipher: &mut PayloadCipher,
+        mut buffer: Vec<u8>,
+    ) -> Result<OutgoingFrame, CspProtocolError> {
         // Determine the payload type and length
         let (r#type, length) = match self {
             OutgoingPayload::EchoRequest(payload) => (OutgoingPayloadType::EchoRequest, payload.length()),
@@ -511,9 +521,18 @@ impl OutgoingPayload {
         };
 
         // Encode the header
-        let mut writer = OwnedVecByteWriter::new_with_capacity(Self::HEADER_LENGTH.saturating_add(length));
+        buffer.clear();
+        buffer.reserve(
+            Self::FRAME_HEADER_LENGTH
+                .saturating_add(Self::HEADER_LENGTH)
+                .saturating_add(length),
+        );
+        let mut writer = OwnedVecByteWriter::new(buffer);
         writer
             .run(|writer| {
+                // Reserve the frame header
+                writer.skip(Self::FRAME_HEADER_LENGTH)?;
+
                 // Encode the payload type
                 writer.write_u8(r#type as u8)?;
 
@@ -538,47 +557,155 @@ impl OutgoingPayload {
             OutgoingPayload::UnblockIncomingMessages
             | OutgoingPayload::ClearDeviceCookieChangeIndiciation => Ok(()),
         }?;
+        let mut frame = writer.into_inner();
+
+        // Encrypt the payload in-place, prefixed by the space reserved for the authentication tag
+        let (length_prefix, payload_box) = frame
+            .split_at_mut_checked(U16LittleEndianDelimiter::LENGTH)
+            .expect("frame must contain the reserved frame header");
+        let frame_length = payload_box.len();
+        let frame_length = u16::try_from(frame_length).map_err(|_| {
+            error!(frame_length, "Encoded frame length exceeds a u16");
+            CspProtocolError::InternalError("Encoded frame too large, exceeds a u16")
+        })?;
+        cipher.encrypt_payload_in_place(payload_box)?;
 
-        // Done
-        Ok(writer.into_inner())
+        // Encode the length of the frame into the reserved space
+        length_prefix.copy_from_slice(&frame_length.to_le_bytes());
+        Ok(OutgoingFrame(frame))
     }
 }
 
 /// Encrypted [`IncomingPayload`] frame decoder.
 pub(super) type PayloadDecoder =
     VariableLengthFrameDecoder<{ U16LittleEndianDelimiter::LENGTH }, U16LittleEndianDelimiter>;
+impl PayloadDecoder {
+    // The delimiter already limits frames to 64 KiB, so this is merely an upper bound for the guard.
+    pub(super) const MAX_LENGTH: usize = u16::MAX as usize;
+}
 
-/// Contains an [`OutgoingPayload`] to encode it.
-#[derive(Name)]
-pub(super) struct EncryptedOutgoingPayload(pub(super) Vec<u8>);
-impl FrameEncoder for EncryptedOutgoingPayload {
-    fn encode_to_frame(&self) -> Result<OutgoingFrame, CspProtocolError> {
-        let mut writer = OwnedVecByteWriter::new_with_capacity(
-            U16LittleEndianDelimiter::LENGTH.saturating_add(self.0.len()),
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::Cookie;
+
+    const CLIENT_COOKIE: Cookie = Cookie([0x01; Cookie::LENGTH]);
+    const SERVER_COOKIE: Cookie = Cookie([0x02; Cookie::LENGTH]);
+
+    /// Encode `payload` into frames in-place (once into a new and once into a recycled buffer) and
+    /// ensure that each frame equals the length-prefixed result of encrypting `expected_payload`
+    /// (i.e. the previous encoding) and that it decodes and decrypts to `expected_payload`.
+    fn assert_encodes_to(payload: &OutgoingPayload, expected_payload: &[u8]) {
+        let mut cipher = PayloadCipher::for_testing(CLIENT_COOKIE, SERVER_COOKIE);
+        let mut reference_cipher = PayloadCipher::for_testing(CLIENT_COOKIE, SERVER_COOKIE);
+        let mut server_cipher = PayloadCipher::for_testing(SERVER_COOKIE, CLIENT_COOKIE);
+        let mut decoder = PayloadDecoder::new(vec![], PayloadDecoder::MAX_LENGTH);
+        let mut buffer = vec![0xff; 128];
+        for _ in 0..2 {
+            let frame = payload.encode_to_frame(&mut cipher, buffer).unwrap();
+
+            // Compare against encrypting the encoded payload and prepending the length
+            let payload_box = reference_cipher.encrypt_payload(expected_payload.to_vec()).unwrap();
+            let length = u16::try_from(payload_box.len()).unwrap().to_le_bytes();
+            assert_eq!(frame.0, [length.as_slice(), payload_box.as_slice()].concat());
+
+            // Decode and decrypt the frame like the server would
+            let _ = decoder.add_chunks(&[frame.0.as_slice()]);
+            let payload_box = decoder.next_frame_and_then(<[u8]>::to_vec).unwrap().unwrap();
+            assert_eq!(server_cipher.decrypt_payload(payload_box).unwrap(), expected_payload);
+            assert!(decoder.next_frame_and_then(<[u8]>::to_vec).unwrap().is_none());
+
+            // Recycle the frame's buffer for the next frame
+            buffer = frame.0;
+        }
+    }
+
+    #[test]
+    fn encode_echo_request() {
+        assert_encodes_to(
+            &OutgoingPayload::EchoRequest(EchoPayload(vec![0xaa; 100])),
+            &[[0x00_u8, 0x00, 0x00, 0x00].as_slice(), &[0xaa; 100]].concat(),
         );
+    }
 
-        // Prepare length
-        let length = self.0.len();
-        let length = u16::try_from(length).map_err(|_| {
-            error!(length, "Encoded frame length exceeds a u16");
-            CspProtocolError::InternalError("Encoded frame too large, exceeds a u16")
-        })?;
+    #[test]
+    fn encode_echo_response() {
+        assert_encodes_to(
+            &OutgoingPayload::EchoResponse(EchoPayload(vec![])),
+            &[0x80_u8, 0x00, 0x00, 0x00],
+        );
+    }
 
-        // Encode the header and the content
-        writer
-            .run(|writer| {
-                // Encode the length of the frame
-                writer.write_u16_le(length)?;
+    #[test]
+    fn encode_message_with_metadata_box() {
+        assert_encodes_to(
+            &OutgoingPayload::MessageWithMetadataBox(MessageWithMetadataBox {
+                message_id: MessageId(0x0102_0304_0506_0708),
+                message_bytes: vec![0xbb; 4096],
+            }),
+            &[[0x01_u8, 0x00, 0x00, 0x00].as_slice(), &[0xbb; 4096]].concat(),
+        );
+    }
 
-                // Encode the content
-                writer.write(&self.0)
-            })
-            .map_err(|error| CspProtocolError::EncodingFailed {
-                name: OutgoingFrame::NAME,
-                source: error,
-            })?;
+    #[test]
+    fn encode_message_ack() {
+        assert_encodes_to(
+            &OutgoingPayload::MessageAck(MessageAck {
+                identity: ThreemaId::try_from("ECHOECHO").unwrap(),
+                message_id: MessageId(0x0102_0304_0506_0708),
+            }),
+            &[
+                [0x81_u8, 0x00, 0x00, 0x00].as_slice(),
+                b"ECHOECHO",
+                &[0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01],
+            ]
+            .concat(),
+        );
+    }
 
-        // Done
-        Ok(OutgoingFrame(writer.into_inner()))
+    #[test]
+    fn encode_unblock_incoming_messages() {
+        assert_encodes_to(&OutgoingPayload::UnblockIncomingMessages, &[0x03_u8, 0x00, 0x00, 0x00]);
+    }
+
+    #[test]
+    fn encode_set_push_notification_token() {
+        assert_encodes_to(
+            &OutgoingPayload::SetPushNotificationToken(PushNotificationToken::FCM(vec![0xcc; 32])),
+            &[[0x20_u8, 0x00, 0x00, 0x00, 0x11].as_slice(), &[0xcc; 32]].concat(),
+        );
+    }
+
+    #[test]
+    fn encode_delete_push_notification_token() {
+        assert_encodes_to(
+            &OutgoingPayload::DeletePushNotificationToken(DeletePushNotificationToken::Devices(vec![
+                CspDeviceId(1),
+                CspDeviceId(2),
+            ])),
+            &[
+                [0x25_u8, 0x00, 0x00, 0x00].as_slice(),
+                &1_u64.to_le_bytes(),
+                &2_u64.to_le_bytes(),
+            ]
+            .concat(),
+        );
+    }
+
+    #[test]
+    fn encode_set_connection_idle_timeout() {
+        assert_encodes_to(
+            &OutgoingPayload::SetConnectionIdleTimeout(ConnectionIdleTimeout(0x0130)),
+            &[0x30_u8, 0x00, 0x00, 0x00, 0x30, 0x01],
+        );
+    }
+
+    #[test]
+    fn encode_clear_device_cookie_change_indication() {
+        assert_encodes_to(
+            &OutgoingPayload::ClearDeviceCookieChangeIndiciation,
+            &[0xd3_u8, 0x00, 0x00, 0x00],
+        );
     }
 }
@@ -1,6 +1,9 @@
 //! Task for looking up identities.
 use core::mem;
-use std::collections::{HashMap, HashSet, hash_map::Entry};
+use std::{
+    collections::{HashMap, HashSet, VecDeque, hash_map::Entry},
+    rc::{Rc, Weak},
+};
 
 use const_format::formatcp;
 use libthreema_macros::{DebugVariantNames, Name, VariantNames};
@@ -72,8 +75,13 @@ pub struct RequestIdentitiesResult {
 pub(crate) type ContactsLookupSubtaskLoop =
     TaskLoop<RequestIdentitiesInstruction, HashMap<ThreemaId, ContactResult>>;
 
-/// Cache for contact lookups at the directory. Entries expire after 10 minutes.
-pub(crate) type ContactLookupCache = TimedCache<ThreemaId, CachedContactResult, 600>;
+/// Maximum amount of entries in the [`ContactLookupCache`].
+pub(crate) const CONTACT_LOOKUP_CACHE_CAPACITY: usize = 4096;
+
+/// Cache for contact lookups at the directory. Entries expire after 10 minutes and entries that
+/// have not been used recently are evicted when exceeding [`CONTACT_LOOKUP_CACHE_CAPACITY`].
+pub(crate) type ContactLookupCache =
+    TimedCache<ThreemaId, CachedContactResult, 600, CONTACT_LOOKUP_CACHE_CAPACITY>;
 
 #[derive(PartialEq, Eq)]
 pub(crate) enum CacheLookupPolicy {
@@ -110,6 +118,79 @@ impl From<CachedContactResult> for ContactResult {
     }
 }
 
+/// Coalesces identity lookups at the directory across [`ContactsLookupSubtask`]s.
+///
+/// Identities that are expected to be looked up soon (e.g. the senders of a batch of incoming
+/// messages that are not yet contacts) can be announced upfront. The next subtask that has to
+/// request identities from the directory then piggybacks as many of them as fit into its request,
+/// so that the results are already cached by the time the other subtasks run.
+///
+/// Note: Since a subtask cannot wait for a request made by another subtask, the identities a
+/// subtask needs itself are always requested. Only piggybacked identities are deduplicated against
+/// in-flight requests.
+#[derive(Default)]
+pub(crate) struct ContactLookupCoordinator {
+    /// Identities announced for lookup, in order of announcement.
+    pending: VecDeque<ThreemaId>,
+    pending_set: HashSet<ThreemaId>,
+    /// Identities that are part of an outstanding request, referring to the request's handle (see
+    /// [`ContactLookupCoordinator::begin`]). Entries whose handle has been dropped are stale.
+    in_flight: HashMap<ThreemaId, Weak<()>>,
+}
+impl ContactLookupCoordinator {
+    /// Maximum amount of identities requested at once, unless a subtask needs more itself.
+    pub(crate) const MAX_IDENTITIES_PER_REQUEST: usize = 100;
+
+    /// Maximum amount of announced identities. Further announcements are discarded.
+    const MAX_PENDING: usize = CONTACT_LOOKUP_CACHE_CAPACITY;
+
+    /// Announce `identities` to be looked up soon.
+    pub(crate) fn announce<I: IntoIterator<Item = ThreemaId>>(&mut self, identities: I) {
+        for identity in identities {
+            if self.pending.len() >= Self::MAX_PENDING {
+                warn!("Discarding announced identities exceeding the maximum");
+                return;
+            }
+            if self.is_in_flight(&identity) || !self.pending_set.insert(identity) {
+                continue;
+            }
+            self.pending.push_back(identity);
+        }
+    }
+
+    /// Take the next announced identity that is not part of `requested` (and not in flight).
+    fn next_pending(&mut self, requested: &[ThreemaId]) -> Option<ThreemaId> {
+        while let Some(identity) = self.pending.pop_front() {
+            let _ = self.pending_set.remove(&identity);
+            if !requested.contains(&identity) && !self.is_in_flight(&identity) {
+                return Some(identity);
+            }
+        }
+        None
+    }
+
+    /// Whether `identity` is part of an outstanding request.
+    fn is_in_flight(&self, identity: &ThreemaId) -> bool {
+        self.in_flight
+            .get(identity)
+            .is_some_and(|request| request.strong_count() > 0)
+    }
+
+    /// Mark `identities` as part of an outstanding request.
+    ///
+    /// The identities remain in flight for as long as the returned handle is alive. Dropping it
+    /// when the request completed or failed, or along with a subtask that was aborted while the
+    /// request was outstanding, releases them.
+    fn begin<'identity, I: IntoIterator<Item = &'identity ThreemaId>>(&mut self, identities: I) -> Rc<()> {
+        self.in_flight.retain(|_, request| request.strong_count() > 0);
+        let request = Rc::new(());
+        for identity in identities {
+            let _ = self.in_flight.insert(*identity, Rc::downgrade(&request));
+        }
+        request
+    }
+}
+
 struct LookupResult {
     known: HashMap<ThreemaId, ContactResult>,
     unknown: Vec<ThreemaId>,
@@ -130,6 +211,11 @@ struct InitState {
 
 struct RequestIdentitiesState {
     contacts: LookupResult,
+    /// Announced identities of other subtasks added to the request (see
+    /// [`ContactLookupCoordinator`]). Their results are only cached.
+    piggybacked: Vec<ThreemaId>,
+    /// Keeps the requested identities in flight (see [`ContactLookupCoordinator::begin`]).
+    in_flight: Rc<()>,
     result: Option<RequestIdentitiesResult>,
 }
 
@@ -141,50 +227,53 @@ enum State {
     Done,
 }
 impl State {
-    fn poll_init(context: &mut CspE2eProtocolContext, state: InitState) -> (Self, ContactsLookupSubtaskLoop) {
-        let mut contacts = LookupResult::new(state.identities.len());
-        for identity in state.identities {
-            // Check if identity is the user itself
-            if identity == context.csp_e2e.user_identity {
-                let _ = contacts.known.insert(identity, ContactResult::User);
-                continue;
-            }
+    /// Look up `identity` without making a request.
+    fn lookup_locally(
+        context: &mut CspE2eProtocolContext,
+        identity: ThreemaId,
+        cache_policy: &CacheLookupPolicy,
+    ) -> Option<ContactResult> {
+        // Check if identity is the user itself
+        if identity == context.csp_e2e.user_identity {
+            return Some(ContactResult::User);
+        }
 
-            // Skip lookup if identity is a _Special Contact_
-            //
-            // Note: Unlike other _Predefined Contact_s, _Special Contact_s will not be added to the
-            // set of contacts and therefore would create a lookup on the directory server every
-            // time which we avoid this way.
-            if let Some(predefined_contact) = context.config.predefined_contacts.get(&identity) {
-                if predefined_contact.special {
-                    let _ = contacts.known.insert(
-                        identity,
-                        ContactResult::NewContact(ContactInit::from(predefined_contact)),
-                    );
-                    continue;
-                }
+        // Skip lookup if identity is a _Special Contact_
+        //
+        // Note: Unlike other _Predefined Contact_s, _Special Contact_s will not be added to the
+        // set of contacts and therefore would create a lookup on the directory server every
+        // time which we avoid this way.
+        if let Some(predefined_contact) = context.config.predefined_contacts.get(&identity) {
+            if predefined_contact.special {
+                return Some(ContactResult::NewContact(ContactInit::from(predefined_contact)));
             }
+        }
 
-            // Lookup existing contact
-            if let Some(existing_contact) = context.contacts.get(identity) {
-                let _ = contacts
-                    .known
-                    .insert(identity, ContactResult::ExistingContact(existing_contact));
-                continue;
-            }
+        // Lookup existing contact
+        if let Some(existing_contact) = context.contacts.get(identity) {
+            return Some(ContactResult::ExistingContact(existing_contact));
+        }
 
-            // Lookup from cache
-            if state.cache_policy == CacheLookupPolicy::Allow {
-                if let Some(cached_contact) = context.contact_lookup_cache.get_mut(identity) {
-                    let _ = contacts
-                        .known
-                        .insert(identity, ContactResult::from(cached_contact.clone()));
-                    continue;
-                }
+        // Lookup from cache
+        if *cache_policy == CacheLookupPolicy::Allow {
+            if let Some(cached_contact) = context.contact_lookup_cache.get_mut(identity) {
+                return Some(ContactResult::from(cached_contact.clone()));
             }
+        }
+
+        // Couldn't find the contact
+        None
+    }
 
-            // Couldn't find the contact
-            contacts.unknown.push(identity);
+    fn poll_init(context: &mut CspE2eProtocolContext, state: InitState) -> (Self, ContactsLookupSubtaskLoop) {
+        let mut contacts = LookupResult::new(state.identities.len());
+        for identity in state.identities {
+            match Self::lookup_locally(context, identity, &state.cache_policy) {
+                Some(contact) => {
+                    let _ = contacts.known.insert(identity, contact);
+                },
+                None => contacts.unknown.push(identity),
+            }
         }
 
         // Check if we have found all contacts already
@@ -192,26 +281,51 @@ impl State {
             return (Self::Done, ContactsLookupSubtaskLoop::Done(contacts.known));
         }
 
+        // Piggyback identities announced by other subtasks that are still unknown, as long as they
+        // fit into the request
+        let mut piggybacked = vec![];
+        while contacts.unknown.len().saturating_add(piggybacked.len())
+            < ContactLookupCoordinator::MAX_IDENTITIES_PER_REQUEST
+        {
+            let Some(identity) = context
+                .contact_lookup_coordinator
+                .next_pending(&contacts.unknown)
+            else {
+                break;
+            };
+            if Self::lookup_locally(context, identity, &CacheLookupPolicy::Allow).is_none() {
+                piggybacked.push(identity);
+            }
+        }
+        let identities = [contacts.unknown.as_slice(), piggybacked.as_slice()].concat();
+        let in_flight = context.contact_lookup_coordinator.begin(&identities);
+
         // Request the unknown identities from the directory (and the work directory, if needed).
-        info!(identities = ?contacts.unknown, "Fetching identities");
+        info!(
+            identities = ?contacts.unknown,
+            n_piggybacked = piggybacked.len(),
+            "Fetching identities"
+        );
         let instruction = RequestIdentitiesInstruction {
             directory_request: directory::request_identities(
                 &context.config,
                 &context.csp_e2e.flavor,
-                &contacts.unknown,
+                &identities,
             ),
             work_directory_request: match &context.csp_e2e.flavor {
                 Flavor::Consumer => None,
                 Flavor::Work(work_context) => Some(work_directory::request_contacts(
                     &context.config,
                     work_context,
-                    &contacts.unknown,
+                    &identities,
                 )),
             },
         };
         (
             Self::RequestIdentities(RequestIdentitiesState {
                 contacts,
+                piggybacked,
+                in_flight,
                 result: None,
             }),
             ContactsLookupSubtaskLoop::Instruction(instruction),
@@ -222,6 +336,9 @@ impl State {
         context: &mut CspE2eProtocolContext,
         mut state: RequestIdentitiesState,
     ) -> Result<(Self, ContactsLookupSubtaskLoop), CspE2eProtocolError> {
+        // The request is no longer outstanding
+        drop(state.in_flight);
+
         // Ensure the caller provided the result
         let Some(result) = state.result else {
             return Err(CspE2eProtocolError::InvalidState(formatcp!(
@@ -232,7 +349,12 @@ impl State {
         };
 
         {
-            let mut unknown: HashSet<ThreemaId> = state.contacts.unknown.into_iter().collect();
+            let mut unknown: HashSet<ThreemaId> = state
+                .contacts
+                .unknown
+                .into_iter()
+                .chain(state.piggybacked.iter().copied())
+                .collect();
 
             // Add all determined contact inits
             let directory_result = directory::handle_identities_result(result.directory_result)?;
@@ -321,6 +443,16 @@ impl State {
                 let _ = context.contact_lookup_cache.insert(identity, cached_contact);
             }
         }
+        debug!(
+            length = context.contact_lookup_cache.len(),
+            stats = ?context.contact_lookup_cache.stats(),
+            "Updated contact lookup cache"
+        );
+
+        // Piggybacked identities were not requested by this subtask, so only keep them cached
+        for identity in &state.piggybacked {
+            let _ = state.contacts.known.remove(identity);
+        }
 
         // Done
         Ok((Self::Done, ContactsLookupSubtaskLoop::Done(state.contacts.known)))
@@ -386,3 +518,255 @@ impl ContactsLookupSubtask {
         Ok(())
     }
 }
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{
+        common::{ClientKey, Conversation, MessageId, Nonce},
+        csp_e2e::{
+            CspE2eContext,
+            config::Config,
+            contact::ContactUpdate,
+            incoming_message::batch::CspE2eKeyCache,
+            message::{IncomingMessage, WebSessionResume},
+            provider::{
+                ContactProvider, MessageProvider, NonceStorage, ProfilePicture, SettingsProvider,
+                ShortcutProvider,
+            },
+        },
+        https::{HttpsResponse, HttpsResult},
+        utils::time::Duration,
+    };
+
+    /// Providers of a user without any contacts, messages or settings.
+    struct EmptyProvider;
+    impl ShortcutProvider for EmptyProvider {
+        fn handle_web_session_resume(&self, _message: WebSessionResume) {}
+    }
+    impl NonceStorage for EmptyProvider {
+        fn has(&self, _nonce: &Nonce) -> bool {
+            false
+        }
+
+        fn add_many(&self, _nonces: Vec<Nonce>) {}
+    }
+    impl SettingsProvider for EmptyProvider {
+        fn block_unknown_identities(&self) -> bool {
+            false
+        }
+    }
+    impl ContactProvider for EmptyProvider {
+        fn is_explicitly_blocked(&self, _identity: ThreemaId) -> bool {
+            false
+        }
+
+        fn is_member_of_active_group(&self, _identity: ThreemaId) -> bool {
+            false
+        }
+
+        fn has(&self, _identity: ThreemaId) -> bool {
+            false
+        }
+
+        fn has_many(&self, _identities: &[ThreemaId]) -> usize {
+            0
+        }
+
+        fn get(&self, _identity: ThreemaId) -> Option<Contact> {
+            None
+        }
+
+        fn add(&self, _contacts: &[Contact]) {}
+
+        fn update(&self, _contacts: &[ContactUpdate]) {}
+
+        fn get_contact_defined_profile_picture(&self, _identity: ThreemaId) -> Option<ProfilePicture> {
+            None
+        }
+
+        fn get_user_defined_profile_picture(&self, _identity: ThreemaId) -> Option<ProfilePicture> {
+            None
+        }
+    }
+    impl MessageProvider for EmptyProvider {
+        fn is_marked_used(&self, _sender_identity: ThreemaId, _id: MessageId) -> bool {
+            false
+        }
+
+        fn add(&self, _conversation: Conversation, _message: IncomingMessage) {}
+    }
+
+    fn context() -> CspE2eProtocolContext {
+        CspE2eProtocolContext {
+            shortcut_provider: Box::new(EmptyProvider),
+            config: Config::sandbox(),
+            csp_e2e: CspE2eContext {
+                user_identity: ThreemaId::try_from("USERUSER").unwrap(),
+                client_key: ClientKey::from([0x42; ClientKey::LENGTH]),
+                flavor: Flavor::Consumer,
+                nonce_storage: Rc::new(EmptyProvider),
+            },
+            d2x: None,
+            settings: Rc::new(EmptyProvider),
+            contacts: Rc::new(EmptyProvider),
+            messages: Rc::new(EmptyProvider),
+            contact_lookup_cache: ContactLookupCache::default(),
+            contact_lookup_coordinator: ContactLookupCoordinator::default(),
+            csp_e2e_key_cache: CspE2eKeyCache::default(),
+        }
+    }
+
+    /// Mock directory endpoint counting the requests made, each taking one round trip. It does not
+    /// know any identity, so all looked up identities turn out to be invalid.
+    #[derive(Default)]
+    struct MockDirectory {
+        requests: u32,
+        requested_identities: usize,
+    }
+    impl MockDirectory {
+        const ROUND_TRIP_TIME: Duration = Duration::from_millis(150);
+
+        fn request(&mut self, request: &HttpsRequest) -> HttpsResult {
+            let identities = requested_identities(request);
+            assert!(identities.len() <= ContactLookupCoordinator::MAX_IDENTITIES_PER_REQUEST);
+            self.requests = self.requests.checked_add(1).unwrap();
+            self.requested_identities = self.requested_identities.checked_add(identities.len()).unwrap();
+            Ok(HttpsResponse {
+                status: 200,
+                body: br#"{"identities":[]}"#.to_vec(),
+            })
+        }
+
+        fn latency(&self) -> Duration {
+            Self::ROUND_TRIP_TIME.checked_mul(self.requests).unwrap()
+        }
+    }
+
+    fn requested_identities(request: &HttpsRequest) -> Vec<ThreemaId> {
+        let body: serde_json::Value = serde_json::from_slice(&request.body).unwrap();
+        body.get("identities")
+            .and_then(serde_json::Value::as_array)
+            .unwrap()
+            .iter()
+            .map(|identity| ThreemaId::try_from(identity.as_str().unwrap()).unwrap())
+            .collect()
+    }
+
+    fn identity(index: usize) -> ThreemaId {
+        ThreemaId::try_from(format!("U{index:07}").as_str()).unwrap()
+    }
+
+    /// Run a [`ContactsLookupSubtask`] for `identities` to completion against `directory`.
+    fn look_up(
+        context: &mut CspE2eProtocolContext,
+        directory: &mut MockDirectory,
+        identities: Vec<ThreemaId>,
+    ) -> HashMap<ThreemaId, ContactResult> {
+        let mut subtask = ContactsLookupSubtask::new(identities, CacheLookupPolicy::Allow);
+        loop {
+            match subtask.poll(context).unwrap() {
+                ContactsLookupSubtaskLoop::Instruction(instruction) => {
+                    assert!(instruction.work_directory_request.is_none());
+                    subtask
+                        .request_identities_result(RequestIdentitiesResult {
+                            directory_result: directory.request(&instruction.directory_request),
+                            work_directory_result: None,
+                        })
+                        .unwrap();
+                },
+                ContactsLookupSubtaskLoop::Done(contacts) => return contacts,
+            }
+        }
+    }
+
+    /// Process one message per sender sequentially the way the incoming message tasks do: Look up
+    /// the sender with a subtask and, if `coordinated`, announce all senders upfront.
+    fn drain(senders: &[ThreemaId], coordinated: bool) -> MockDirectory {
+        let mut context = context();
+        if coordinated {
+            context
+                .contact_lookup_coordinator
+                .announce(senders.iter().copied());
+        }
+        let mut directory = MockDirectory::default();
+        for sender in senders {
+            let contacts = look_up(&mut context, &mut directory, vec![*sender]);
+            assert_eq!(contacts.len(), 1, "Piggybacked identities must not be handed out");
+            assert!(matches!(contacts.get(sender), Some(ContactResult::Invalid(_))));
+        }
+        directory
+    }
+
+    #[test]
+    fn coalesce_burst_of_unknown_senders() {
+        // 200 messages from 150 unknown senders
+        let senders: Vec<ThreemaId> = (0..200_usize).map(|index| identity(index % 150)).collect();
+
+        let uncoordinated = drain(&senders, false);
+        assert_eq!(uncoordinated.requests, 150);
+        assert_eq!(uncoordinated.requested_identities, 150);
+
+        let coordinated = drain(&senders, true);
+        assert_eq!(coordinated.requests, 2, "Should batch into requests of up to 100 identities");
+        assert_eq!(
+            coordinated.requested_identities, 150,
+            "Should request each identity exactly once"
+        );
+        assert!(coordinated.latency() < uncoordinated.latency());
+        assert_eq!(coordinated.latency(), Duration::from_millis(300));
+    }
+
+    #[test]
+    fn deduplicate_announced_identities() {
+        let mut coordinator = ContactLookupCoordinator::default();
+        coordinator.announce([identity(1), identity(1), identity(2), identity(3)]);
+        assert_eq!(coordinator.pending.len(), 3, "Should deduplicate announcements");
+
+        // Identities in flight must neither be announced nor piggybacked
+        let request = coordinator.begin(&[identity(2), identity(4)]);
+        coordinator.announce([identity(4)]);
+        assert_eq!(coordinator.pending.len(), 3);
+
+        // Identities requested by the subtask itself must not be piggybacked
+        assert_eq!(coordinator.next_pending(&[identity(1)]), Some(identity(3)));
+        assert_eq!(coordinator.next_pending(&[]), None);
+
+        // Completed identities may be announced again
+        drop(request);
+        coordinator.announce([identity(4)]);
+        assert_eq!(coordinator.next_pending(&[]), Some(identity(4)));
+    }
+
+    #[test]
+    fn release_identities_of_dropped_subtask() {
+        let mut context = context();
+        context
+            .contact_lookup_coordinator
+            .announce([identity(2), identity(3)]);
+
+        // Drop a subtask while its request (piggybacking the announced identities) is outstanding
+        let mut subtask = ContactsLookupSubtask::new(vec![identity(1)], CacheLookupPolicy::Allow);
+        let ContactsLookupSubtaskLoop::Instruction(instruction) = subtask.poll(&mut context).unwrap() else {
+            unreachable!("Expected a request instruction");
+        };
+        assert_eq!(
+            requested_identities(&instruction.directory_request),
+            vec![identity(1), identity(2), identity(3)]
+        );
+        assert!(context.contact_lookup_coordinator.is_in_flight(&identity(2)));
+        drop(subtask);
+
+        // The identities must be announced and piggybacked again rather than remaining excluded
+        context.contact_lookup_coordinator.announce([identity(2)]);
+        let mut subtask = ContactsLookupSubtask::new(vec![identity(4)], CacheLookupPolicy::Allow);
+        let ContactsLookupSubtaskLoop::Instruction(instruction) = subtask.poll(&mut context).unwrap() else {
+            unreachable!("Expected a request instruction");
+        };
+        assert_eq!(
+            requested_identities(&instruction.directory_request),
+            vec![identity(4), identity(2)]
+        );
+    }
+}
@@ -0,0 +1,363 @@
+//! Batch decoding of incoming messages.
+//!
+//! Decoding and decrypting a `message-with-metadata-box` is pure computation and does not depend on
+//! the state of the protocol (apart from the sender's public key). When many messages are pending
+//! (e.g. after reconnecting), this phase is therefore run for all of them upfront across worker
+//! threads, before the sequential [`IncomingMessageTask`]s take over in server order.
+use core::num::NonZeroUsize;
+use std::{collections::HashMap, sync::Arc, thread};
+
+use tracing::{debug, warn};
+
+use super::{
+    payload::{
+        DecodedMessageWithMetadataBox, DecryptedMessageWithMetadataBox, DecryptionDiscardReason,
+        IncomingMessagePayloadError,
+    },
+    task::IncomingMessageTask,
+};
+use crate::{
+    common::{ClientKey, CspE2eKey, MessageId, PublicKey, ThreemaId},
+    csp::payload::MessageWithMetadataBox,
+    csp_e2e::contact::lookup::ContactLookupCoordinator,
+};
+
+/// Cache of shared secrets between the user and other identities.
+///
+/// Deriving the shared secret (X25519 and HSalsa20) is by far the most expensive part of decrypting
+/// a message, and a batch of pending messages usually originates from a handful of senders.
+#[derive(Default)]
+pub(crate) struct CspE2eKeyCache(HashMap<PublicKey, Arc<CspE2eKey>>);
+impl CspE2eKeyCache {
+    /// Maximum amount of cached shared secrets. The cache is cleared when exceeding it.
+    const MAX_ENTRIES: usize = 256;
+
+    /// Get the shared secret for `public_key` or derive (and cache) it.
+    pub(crate) fn get_or_derive(&mut self, client_key: &ClientKey, public_key: &PublicKey) -> Arc<CspE2eKey> {
+        if let Some(shared_secret) = self.0.get(public_key) {
+            return Arc::clone(shared_secret);
+        }
+        let shared_secret = Arc::new(client_key.derive_csp_e2e_key(public_key));
+        self.insert(*public_key, Arc::clone(&shared_secret));
+        shared_secret
+    }
+
+    fn insert(&mut self, public_key: PublicKey, shared_secret: Arc<CspE2eKey>) {
+        if self.0.len() >= Self::MAX_ENTRIES {
+            self.0.clear();
+        }
+        let _ = self.0.insert(public_key, shared_secret);
+    }
+}
+
+/// Result of decrypting a message in advance with a specific public key of the sender.
+pub(super) struct PredecryptedMessage {
+    /// Public key of the sender used to derive the shared secret.
+    pub(super) public_key: PublicKey,
+
+    /// Result of the decryption.
+    pub(super) result: Result<DecryptedMessageWithMetadataBox, DecryptionDiscardReason>,
+}
+
+/// A `message-with-metadata-box` in the state it is handed to an [`IncomingMessageTask`].
+pub(super) enum IncomingMessagePayload {
+    /// Not yet decoded.
+    Encoded(MessageWithMetadataBox),
+
+    /// Decoding failed in advance.
+    Invalid {
+        message_id: MessageId,
+        length: usize,
+        error: IncomingMessagePayloadError,
+    },
+
+    /// Decoded in advance and, if the sender's public key was known at that time, decrypted.
+    Decoded {
+        payload: DecodedMessageWithMetadataBox,
+        predecrypted: Option<PredecryptedMessage>,
+    },
+}
+
+/// Determine the amount of worker threads to use for `n_items`.
+///
+/// Note: Falls back to a single worker (i.e. the calling thread) on platforms without threads.
+fn worker_count(n_items: usize) -> usize {
+    thread::available_parallelism()
+        .map_or(1, NonZeroUsize::get)
+        .min(n_items)
+        .max(1)
+}
+
+/// Run `op` on each item of `items`, spread across `workers` threads.
+fn run_on_workers<T: Send, F: Fn(&mut T) + Sync>(items: &mut [T], workers: usize, op: F) {
+    if workers <= 1 {
+        items.iter_mut().for_each(op);
+        return;
+    }
+    let chunk_size = items.len().div_ceil(workers);
+    thread::scope(|scope| {
+        for chunk in items.chunks_mut(chunk_size) {
+            let op = &op;
+            let _ = scope.spawn(move || chunk.iter_mut().for_each(op));
+        }
+    });
+}
+
+/// Decode a batch of `message-with-metadata-box`es and decrypt those whose sender's public key can
+/// be determined by `lookup_public_key`. The crypto-heavy work is spread across `workers` threads.
+///
+/// Shared secrets are taken from and added to `cache`. The payloads are returned in the same order.
+pub(super) fn decode_batch<F: Fn(ThreemaId) -> Option<PublicKey>>(
+    client_key: &ClientKey,
+    cache: &mut CspE2eKeyCache,
+    lookup_public_key: F,
+    payloads: Vec<MessageWithMetadataBox>,
+    workers: usize,
+) -> Vec<IncomingMessagePayload> {
+    // Decode all payloads and look up the public key of each sender
+    let mut public_keys: HashMap<ThreemaId, Option<PublicKey>> = HashMap::new();
+    let mut payloads: Vec<IncomingMessagePayload> = payloads
+        .into_iter()
+        .map(|payload| {
+            let message_id = payload.message_id;
+            let length = payload.message_bytes.len();
+            match DecodedMessageWithMetadataBox::try_from(payload) {
+                Ok(payload) => {
+                    let _ = public_keys
+                        .entry(payload.sender_identity)
+                        .or_insert_with(|| lookup_public_key(payload.sender_identity));
+                    IncomingMessagePayload::Decoded {
+                        payload,
+                        predecrypted: None,
+                    }
+                },
+                Err(error) => IncomingMessagePayload::Invalid {
+                    message_id,
+                    length,
+                    error,
+                },
+            }
+        })
+        .collect();
+
+    // Derive all missing shared secrets, once per sender
+    let mut shared_secrets: Vec<(PublicKey, Option<Arc<CspE2eKey>>)> = public_keys
+        .values()
+        .flatten()
+        .map(|public_key| (*public_key, cache.0.get(public_key).cloned()))
+        .collect();
+    let n_derived = shared_secrets
+        .iter()
+        .filter(|(_, shared_secret)| shared_secret.is_none())
+        .count();
+    run_on_workers(&mut shared_secrets, workers.min(n_derived), |(public_key, shared_secret)| {
+        if shared_secret.is_none() {
+            *shared_secret = Some(Arc::new(client_key.derive_csp_e2e_key(public_key)));
+        }
+    });
+    let shared_secrets: HashMap<PublicKey, Arc<CspE2eKey>> = shared_secrets
+        .into_iter()
+        .filter_map(|(public_key, shared_secret)| shared_secret.map(|shared_secret| (public_key, shared_secret)))
+        .collect();
+    debug!(
+        n_payloads = payloads.len(),
+        n_senders = shared_secrets.len(),
+        n_derived,
+        "Decoding batch of incoming messages"
+    );
+
+    // Decrypt all payloads of senders whose public key is known
+    run_on_workers(&mut payloads, workers, |item| {
+        let IncomingMessagePayload::Decoded { payload, predecrypted } = item else {
+            return;
+        };
+        let Some(Some(public_key)) = public_keys.get(&payload.sender_identity) else {
+            return;
+        };
+        let Some(shared_secret) = shared_secrets.get(public_key) else {
+            warn!("Shared secret missing for a known public key");
+            return;
+        };
+        *predecrypted = Some(PredecryptedMessage {
+            public_key: *public_key,
+            result: payload.decrypt(shared_secret),
+        });
+    });
+
+    // Add the shared secrets to the cache
+    for (public_key, shared_secret) in shared_secrets {
+        cache.insert(public_key, shared_secret);
+    }
+    payloads
+}
+
+/// Decode a batch of `message-with-metadata-box`es and create a task for each of them, using all
+/// available cores.
+///
+/// Senders whose public key could not be determined are announced to the `lookup_coordinator`.
+pub(crate) fn create_tasks<F: Fn(ThreemaId) -> Option<PublicKey>>(
+    client_key: &ClientKey,
+    cache: &mut CspE2eKeyCache,
+    lookup_coordinator: &mut ContactLookupCoordinator,
+    lookup_public_key: F,
+    payloads: Vec<MessageWithMetadataBox>,
+) -> Vec<IncomingMessageTask> {
+    let workers = worker_count(payloads.len());
+    let payloads = decode_batch(client_key, cache, lookup_public_key, payloads, workers);
+    lookup_coordinator.announce(payloads.iter().filter_map(|payload| match payload {
+        IncomingMessagePayload::Decoded {
+            payload,
+            predecrypted: None,
+        } => Some(payload.sender_identity),
+        IncomingMessagePayload::Encoded(_)
+        | IncomingMessagePayload::Invalid { .. }
+        | IncomingMessagePayload::Decoded { .. } => None,
+    }));
+    payloads
+        .into_iter()
+        .map(IncomingMessageTask::new_with_payload)
+        .collect()
+}
+
+/// Access to batch decoding for benchmarks (see `benches/`). Not part of the public API.
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub mod bench {
+    use std::collections::HashMap;
+
+    use rand::Rng as _;
+
+    use super::{CspE2eKeyCache, IncomingMessagePayload, decode_batch};
+    use crate::{
+        common::{ClientKey, MessageId, Nonce, PublicKey, ThreemaId},
+        crypto::aead::AeadInPlace as _,
+        csp::payload::MessageWithMetadataBox,
+        csp_e2e::incoming_message::payload::DecodedMessageWithMetadataBox,
+    };
+
+    /// Messages queued on the server for the user, encrypted by a set of senders.
+    pub struct QueuedMessages {
+        client_key: ClientKey,
+        public_keys: HashMap<ThreemaId, PublicKey>,
+        payloads: Vec<MessageWithMetadataBox>,
+    }
+
+    impl QueuedMessages {
+        /// Create `n_messages` text messages (without metadata) from `n_senders` random senders,
+        /// round robin.
+        #[must_use]
+        pub fn new(n_messages: usize, n_senders: usize) -> Self {
+            let mut rng = rand::thread_rng();
+            let client_key = ClientKey::from(rng.r#gen::<[u8; ClientKey::LENGTH]>());
+            let user_identity = ThreemaId::try_from("USERUSER").expect("Threema ID must be valid");
+            let senders: Vec<(ThreemaId, ClientKey)> = (0..n_senders)
+                .map(|index| {
+                    let identity = ThreemaId::try_from(format!("S{index:07}").as_str())
+                        .expect("Threema ID must be valid");
+                    (identity, ClientKey::from(rng.r#gen::<[u8; ClientKey::LENGTH]>()))
+                })
+                .collect();
+
+            let payloads = senders
+                .iter()
+                .cycle()
+                .take(n_messages)
+                .map(|(sender_identity, sender_key)| {
+                    let message_id = MessageId::random();
+                    let nonce = Nonce::from(rng.r#gen::<[u8; Nonce::LENGTH]>());
+
+                    // Outer type (text), text and PKCS#7 padding
+                    let mut message_container = vec![0x01];
+                    message_container.extend_from_slice(b"Hello from the other side!");
+                    message_container.extend_from_slice(&[0x08; 8]);
+                    let tag = sender_key
+                        .derive_csp_e2e_key(&client_key.public_key())
+                        .message_cipher()
+                        .0
+                        .encrypt_in_place_detached((&nonce).into(), b"", &mut message_container)
+                        .expect("Encrypting the message container must succeed");
+
+                    // Assemble the `message-with-metadata-box`
+                    let mut message_bytes = vec![];
+                    message_bytes.extend_from_slice(&sender_identity.to_bytes());
+                    message_bytes.extend_from_slice(&user_identity.to_bytes());
+                    message_bytes.extend_from_slice(&message_id.0.to_le_bytes());
+                    message_bytes.extend_from_slice(&0_u32.to_le_bytes());
+                    message_bytes.extend_from_slice(&[0x00, 0x00]);
+                    message_bytes.extend_from_slice(&0_u16.to_le_bytes());
+                    message_bytes.extend_from_slice(&[0x00; 32]);
+                    message_bytes.extend_from_slice(&nonce.0);
+                    message_bytes.extend_from_slice(&message_container);
+                    message_bytes.extend_from_slice(&tag);
+                    MessageWithMetadataBox {
+                        message_id,
+                        message_bytes,
+                    }
+                })
+                .collect();
+
+            Self {
+                client_key,
+                public_keys: senders
+                    .iter()
+                    .map(|(identity, key)| (*identity, key.public_key()))
+                    .collect(),
+                payloads,
+            }
+        }
+
+        fn payloads(&self) -> Vec<MessageWithMetadataBox> {
+            self.payloads
+                .iter()
+                .map(|payload| MessageWithMetadataBox {
+                    message_id: payload.message_id,
+                    message_bytes: payload.message_bytes.clone(),
+                })
+                .collect()
+        }
+
+        /// Decode and decrypt all messages as a batch across `workers` threads with an empty cache.
+        /// Returns the amount of successfully decrypted messages.
+        #[must_use]
+        pub fn decode_batch(&self, workers: usize) -> usize {
+            let mut cache = CspE2eKeyCache::default();
+            decode_batch(
+                &self.client_key,
+                &mut cache,
+                |identity| self.public_keys.get(&identity).copied(),
+                self.payloads(),
+                workers,
+            )
+            .into_iter()
+            .filter(|payload| {
+                matches!(
+                    payload,
+                    IncomingMessagePayload::Decoded {
+                        predecrypted: Some(predecrypted),
+                        ..
+                    } if predecrypted.result.is_ok()
+                )
+            })
+            .count()
+        }
+
+        /// Decode and decrypt all messages one after another, deriving the shared secret for each
+        /// message (i.e. the behaviour without batching). Returns the amount of successfully
+        /// decrypted messages.
+        #[must_use]
+        pub fn decode_sequentially(&self) -> usize {
+            self.payloads()
+                .into_iter()
+                .filter_map(|payload| DecodedMessageWithMetadataBox::try_from(payload).ok())
+                .map(|mut payload| {
+                    let Some(public_key) = self.public_keys.get(&payload.sender_identity) else {
+                        return false;
+                    };
+                    let shared_secret = self.client_key.derive_csp_e2e_key(public_key);
+                    payload.decrypt(&shared_secret).is_ok()
+                })
+                .filter(|decrypted| *decrypted)
+                .count()
+        }
+    }
+}
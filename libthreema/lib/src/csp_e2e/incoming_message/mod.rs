@@ -1,3 +1,7 @@
 //! Payloads and task to decode and process an incoming message.
+pub(crate) mod batch;
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub use batch::bench as batch_bench;
 mod payload;
 pub mod task;
@@ -1,9 +1,15 @@
-use core::str::{self, Utf8Error};
+use core::{
+    ops::Range,
+    str::{self, Utf8Error},
+};
+
+use prost::Message as _;
 
 use crate::{
-    common::{MessageId, Nonce, ThreemaId, ThreemaIdError},
-    crypto::salsa20,
+    common::{CspE2eKey, MessageId, MessageMetadata, Nonce, ThreemaId, ThreemaIdError},
+    crypto::{aead::AeadInPlace as _, salsa20},
     csp::payload::MessageWithMetadataBox,
+    protobuf,
     utils::bytes::{ByteReader as _, ByteReaderError, EncryptedDataRangeReader as _, OwnedVecByteReader},
 };
 
@@ -31,6 +37,34 @@ pub(super) enum IncomingMessagePayloadError {
     InvalidMessage,
 }
 
+/// Reason for discarding a message while decrypting it.
+#[derive(Debug, thiserror::Error)]
+pub(super) enum DecryptionDiscardReason {
+    /// Decrypting the metadata failed.
+    #[error("Metadata could not be decrypted")]
+    MetadataDecryptionFailed,
+
+    /// Decoding the decrypted metadata failed.
+    #[error("Metadata could not be decoded: {0}")]
+    MetadataDecodingFailed(prost::DecodeError),
+
+    /// Decrypting the message container failed.
+    #[error("Message data could not be decrypted")]
+    MessageDecryptionFailed,
+
+    /// The message container is empty.
+    #[error("Message without any data")]
+    EmptyMessage,
+
+    /// The PKCS#7 padding of the message container is invalid.
+    #[error("Message with invalid PKCS#7 padding")]
+    InvalidPadding,
+
+    /// The message container does not contain an outer type.
+    #[error("Message without an outer type")]
+    MissingOuterType,
+}
+
 /// Message flags which were/are transmitted to the server.
 #[expect(dead_code, reason = "Will use later")]
 pub(super) struct MessageFlags(pub(super) u8);
@@ -73,6 +107,8 @@ pub(super) struct DecodedMessageWithMetadataBox {
     pub(super) legacy_sender_nickname: Option<String>,
     pub(super) metadata: Option<salsa20::EncryptedDataRange>,
     pub(super) nonce: Nonce,
+    /// Range of the nonce within the message bytes.
+    pub(super) nonce_range: Range<usize>,
     pub(super) message_container: salsa20::EncryptedDataRange,
 }
 impl TryFrom<MessageWithMetadataBox> for DecodedMessageWithMetadataBox {
@@ -131,7 +167,7 @@ impl TryFrom<MessageWithMetadataBox> for DecodedMessageWithMetadataBox {
         };
 
         // Decode nonce
-        let nonce = Nonce::from(reader.read_fixed::<{ Nonce::LENGTH }>()?);
+        let nonce_range = reader.read_range(Nonce::LENGTH)?;
 
         // Decode message container
         let message_container = reader.read_encrypted_data_range(
@@ -143,6 +179,11 @@ impl TryFrom<MessageWithMetadataBox> for DecodedMessageWithMetadataBox {
 
         // Done
         let message_bytes = reader.expect_consumed()?;
+        let nonce = message_bytes
+            .get(nonce_range.clone())
+            .and_then(|nonce| <[u8; Nonce::LENGTH]>::try_from(nonce).ok())
+            .map(Nonce::from)
+            .expect("calculated nonce range must be in bounds");
         Ok(DecodedMessageWithMetadataBox {
             bytes: message_bytes,
             sender_identity,
@@ -153,7 +194,96 @@ impl TryFrom<MessageWithMetadataBox> for DecodedMessageWithMetadataBox {
             legacy_sender_nickname,
             metadata,
             nonce,
+            nonce_range,
             message_container,
         })
     }
 }
+
+/// The decrypted parts of a [`DecodedMessageWithMetadataBox`].
+pub(super) struct DecryptedMessageWithMetadataBox {
+    /// The decrypted and decoded metadata (if any).
+    pub(super) metadata: Option<MessageMetadata>,
+
+    /// The outer message type.
+    pub(super) outer_type: u8,
+
+    /// Range of the unpadded outer message data within the message bytes.
+    pub(super) message_data: Range<usize>,
+}
+
+impl DecodedMessageWithMetadataBox {
+    /// Decrypt the metadata (if any) and the message container in-place with the shared secret
+    /// between the sender and the user.
+    ///
+    /// Note: This is pure computation and does not depend on any other state, so it may be run in
+    /// advance (and in parallel) for a batch of messages.
+    pub(super) fn decrypt(
+        &mut self,
+        shared_secret: &CspE2eKey,
+    ) -> Result<DecryptedMessageWithMetadataBox, DecryptionDiscardReason> {
+        // Decrypt and decode metadata (if any)
+        let metadata = match self.metadata.as_ref() {
+            Some(metadata) => {
+                let metadata_bytes = self
+                    .bytes
+                    .get_mut(metadata.data.clone())
+                    .expect("calculated metadata data length must be in bounds");
+
+                // Decrypt
+                shared_secret
+                    .message_metadata_cipher()
+                    .0
+                    .decrypt_in_place_detached(&self.nonce.0.into(), b"", metadata_bytes, &metadata.tag.into())
+                    .map_err(|_| DecryptionDiscardReason::MetadataDecryptionFailed)?;
+
+                // Decode
+                let metadata = protobuf::csp_e2e::MessageMetadata::decode(&*metadata_bytes)
+                    .map_err(DecryptionDiscardReason::MetadataDecodingFailed)?;
+                Some(MessageMetadata::from(metadata))
+            },
+            None => None,
+        };
+
+        // Decrypt message container
+        let message_bytes = self
+            .bytes
+            .get_mut(self.message_container.data.clone())
+            .expect("calculated message container data length must be in bounds");
+        shared_secret
+            .message_cipher()
+            .0
+            .decrypt_in_place_detached(
+                &self.nonce.0.into(),
+                b"",
+                message_bytes,
+                &self.message_container.tag.into(),
+            )
+            .map_err(|_| DecryptionDiscardReason::MessageDecryptionFailed)?;
+
+        // Remove PKCS#7 padding
+        let padding_length = message_bytes
+            .last()
+            .ok_or(DecryptionDiscardReason::EmptyMessage)?;
+        let unpadded_length = message_bytes
+            .len()
+            .checked_sub(*padding_length as usize)
+            .ok_or(DecryptionDiscardReason::InvalidPadding)?;
+
+        // Decode message type, the remaining data is the message data
+        let outer_type = *message_bytes
+            .get(..unpadded_length)
+            .expect("calculated PKCS#7 padding length must be in bounds")
+            .first()
+            .ok_or(DecryptionDiscardReason::MissingOuterType)?;
+        let message_data_start = self.message_container.data.start.saturating_add(1);
+        let message_data_end = self.message_container.data.start.saturating_add(unpadded_length);
+
+        // Done decrypting
+        Ok(DecryptedMessageWithMetadataBox {
+            metadata,
+            outer_type,
+            message_data: message_data_start..message_data_end,
+        })
+    }
+}
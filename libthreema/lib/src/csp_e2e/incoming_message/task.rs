@@ -14,15 +14,17 @@
 use core::mem;
 use std::str;
 
+use bytes::Bytes;
 use const_format::formatcp;
 use libthreema_macros::{DebugVariantNames, Name, VariantNames};
-use prost::Message as _;
 use tracing::{debug, error, info, warn};
 
-use super::payload::DecodedMessageWithMetadataBox;
+use super::{
+    batch::{IncomingMessagePayload, PredecryptedMessage},
+    payload::DecodedMessageWithMetadataBox,
+};
 use crate::{
-    common::{Conversation, Delta, MessageId, MessageMetadata, Nonce},
-    crypto::aead::AeadInPlace as _,
+    common::{Conversation, Delta, MessageId},
     csp::payload::MessageWithMetadataBox,
     csp_e2e::{
         CspE2eProtocolContext, CspE2eProtocolError, D2mRole, ReflectId, TaskLoop,
@@ -68,18 +70,20 @@ pub struct IncomingMessageTaskResult {
 /// Result of polling a [`IncomingMessageTask`].
 pub type IncomingMessageTaskLoop = TaskLoop<IncomingMessageTaskInstruction, IncomingMessageTaskResult>;
 
+/// The outer message as received. Message data and nonce are slices of the decrypted payload.
 struct OuterIncomingMessage {
     message_type: CspE2eMessageType,
-    unpadded_message_data: Vec<u8>,
-    nonce: Nonce,
+    unpadded_message_data: Bytes,
+    nonce: Bytes,
 }
 
 struct InitState {
-    payload: MessageWithMetadataBox,
+    payload: IncomingMessagePayload,
 }
 
 struct FetchSenderState {
     payload: DecodedMessageWithMetadataBox,
+    predecrypted: Option<PredecryptedMessage>,
     fetch_sender_task: ContactsLookupSubtask,
 }
 
@@ -127,22 +131,37 @@ impl State {
         context: &mut CspE2eProtocolContext,
         state: InitState,
     ) -> Result<(Self, IncomingMessageTaskLoop), CspE2eProtocolError> {
-        let length = state.payload.message_bytes.len();
-
-        // Decode and validate `message-with-metadata-box` (to some degree)
-        let payload = {
-            let message_id = state.payload.message_id;
-            match DecodedMessageWithMetadataBox::try_from(state.payload) {
-                Ok(payload) => payload,
-                Err(error) => {
-                    warn!(
-                        ?length,
-                        ?error,
-                        "Discarding message whose payload could not be decoded"
-                    );
-                    return Ok(Self::acknowledge_message(message_id));
-                },
-            }
+        // Decode and validate `message-with-metadata-box` (to some degree), unless already done in
+        // advance
+        let (payload, predecrypted) = match state.payload {
+            IncomingMessagePayload::Encoded(payload) => {
+                let length = payload.message_bytes.len();
+                let message_id = payload.message_id;
+                match DecodedMessageWithMetadataBox::try_from(payload) {
+                    Ok(payload) => (payload, None),
+                    Err(error) => {
+                        warn!(
+                            ?length,
+                            ?error,
+                            "Discarding message whose payload could not be decoded"
+                        );
+                        return Ok(Self::acknowledge_message(message_id));
+                    },
+                }
+            },
+            IncomingMessagePayload::Invalid {
+                message_id,
+                length,
+                error,
+            } => {
+                warn!(
+                    ?length,
+                    ?error,
+                    "Discarding message whose payload could not be decoded"
+                );
+                return Ok(Self::acknowledge_message(message_id));
+            },
+            IncomingMessagePayload::Decoded { payload, predecrypted } => (payload, predecrypted),
         };
 
         // Add tracing span
@@ -183,6 +202,7 @@ impl State {
             context,
             FetchSenderState {
                 payload,
+                predecrypted,
                 fetch_sender_task,
             },
         )
@@ -236,101 +256,38 @@ impl State {
             ContactResult::NewContact(sender) => ContactOrInit::NewContact(sender),
         };
 
-        // Derive the shared secret
-        let shared_secret = context
-            .csp_e2e
-            .client_key
-            .derive_csp_e2e_key(&sender.inner().public_key);
-
-        // Decrypt and decode metadata (if any)
-        let outer_metadata = match payload.metadata.as_ref() {
-            Some(metadata) => {
-                let metadata_bytes = &mut payload
-                    .bytes
-                    .get_mut(metadata.data.clone())
-                    .expect("calculated metadata data length must be in bounds");
-
-                // Decrypt
-                let mmk = shared_secret.message_metadata_cipher();
-                if mmk
-                    .0
-                    .decrypt_in_place_detached(
-                        &payload.nonce.0.into(),
-                        b"",
-                        metadata_bytes,
-                        &metadata.tag.into(),
-                    )
-                    .is_err()
-                {
-                    warn!("Discarding message whose metadata could not be decrypted");
-                    return Ok(Self::acknowledge_message(payload.id));
-                }
-
-                // Decode
-                #[expect(clippy::useless_asref, reason = "False positive")]
-                match protobuf::csp_e2e::MessageMetadata::decode(metadata_bytes.as_ref()) {
-                    Ok(metadata) => Some(MessageMetadata::from(metadata)),
-                    Err(error) => {
-                        warn!(?error, "Discarding message whose metadata could not be decoded");
-                        return Ok(Self::acknowledge_message(payload.id));
-                    },
-                }
+        // Decrypt and decode metadata (if any) and the message container, unless already done in
+        // advance with the sender's current public key
+        let sender_public_key = sender.inner().public_key;
+        let decrypted = match state.predecrypted.take() {
+            Some(predecrypted) if predecrypted.public_key == sender_public_key => predecrypted.result,
+            Some(_) => {
+                warn!("Discarding message that was decrypted with a diverging public key");
+                return Ok(Self::acknowledge_message(payload.id));
+            },
+            None => {
+                let shared_secret = context
+                    .csp_e2e_key_cache
+                    .get_or_derive(&context.csp_e2e.client_key, &sender_public_key);
+                payload.decrypt(&shared_secret)
             },
-            None => None,
         };
-
-        // Decrypt message container and decode it to message type and message data
-        let (outer_type, outer_message_data) = {
-            let message_bytes = payload
-                .bytes
-                .get_mut(payload.message_container.data.clone())
-                .expect("calculated metadata data length must be in bounds");
-
-            // Decrypt
-            if shared_secret
-                .message_cipher()
-                .0
-                .decrypt_in_place_detached(
-                    &payload.nonce.0.into(),
-                    b"",
-                    message_bytes,
-                    &payload.message_container.tag.into(),
-                )
-                .is_err()
-            {
-                warn!("Discarding message whose data could not be decrypted");
-                return Ok(Self::acknowledge_message(payload.id));
-            }
-
-            // Remove PKCS#7 padding
-            let message_bytes = {
-                let Some(padding_length) = message_bytes.last() else {
-                    warn!("Discarding message without any data");
-                    return Ok(Self::acknowledge_message(payload.id));
-                };
-                let Some(unpadded_length) = message_bytes.len().checked_sub(*padding_length as usize) else {
-                    warn!("Discarding message with invalid PKCS#7 padding");
-                    return Ok(Self::acknowledge_message(payload.id));
-                };
-                message_bytes
-                    .get(..unpadded_length)
-                    .expect("calculated PKCS#7 padding length must be in bounds")
-            };
-
-            // Decode message type
-            let Some(outer_type) = message_bytes.first() else {
-                warn!("Discarding message without an outer type");
+        let decrypted = match decrypted {
+            Ok(decrypted) => decrypted,
+            Err(reason) => {
+                warn!(%reason, "Discarding message that could not be decrypted");
                 return Ok(Self::acknowledge_message(payload.id));
-            };
-
-            // The remaining data is the message data
-            let message_data = message_bytes
-                .get(1..)
-                .expect("message data after a successfully decoded message outer type must be in bounds");
-
-            // Done decoding
-            (*outer_type, message_data)
+            },
         };
+        let outer_metadata = decrypted.metadata;
+        let outer_type = decrypted.outer_type;
+
+        // The payload has been decrypted in-place, so the message data (and the nonce) can be
+        // handed out as slices of it from here on.
+        //
+        // Note: The calculated ranges are always in bounds of the payload.
+        let payload_bytes = Bytes::from(mem::take(&mut payload.bytes));
+        let outer_message_data = payload_bytes.slice(decrypted.message_data);
 
         // Legacy: Ensure it's not of type `0xff`.
         //
@@ -355,7 +312,7 @@ impl State {
         }
         let inner_metadata = outer_metadata;
         let inner_type = outer_type;
-        let inner_message_data = outer_message_data;
+        let inner_message_data = &outer_message_data;
 
         // Decode the incoming message
         //
@@ -475,9 +432,9 @@ impl State {
 
         // Update or create the contact, if necessary
         let outer_message = OuterIncomingMessage {
-            nonce: payload.nonce.clone(),
+            nonce: payload_bytes.slice(payload.nonce_range.clone()),
             message_type: outer_type,
-            unpadded_message_data: outer_message_data.to_vec(),
+            unpadded_message_data: outer_message_data,
         };
         let inner_message = IncomingMessage {
             sender_identity: sender.inner().identity,
@@ -646,7 +603,7 @@ impl State {
                         created_at: inner_message.created_at,
                         r#type: outer_message.message_type.into(),
                         body: outer_message.unpadded_message_data,
-                        nonce: outer_message.nonce.0.to_vec(),
+                        nonce: outer_message.nonce,
                     }),
                 )?;
                 d2x_context.nonce_storage.add_many(vec![nonce]);
@@ -773,6 +730,10 @@ pub struct IncomingMessageTask {
 }
 impl IncomingMessageTask {
     pub(crate) fn new(payload: MessageWithMetadataBox) -> Self {
+        Self::new_with_payload(IncomingMessagePayload::Encoded(payload))
+    }
+
+    pub(super) fn new_with_payload(payload: IncomingMessagePayload) -> Self {
         Self {
             state: State::Init(InitState { payload }),
         }
@@ -3,8 +3,8 @@ use core::fmt;
 use std::rc::Rc;
 
 use config::Config;
-use contact::lookup::ContactLookupCache;
-use incoming_message::task::IncomingMessageTask;
+use contact::lookup::{ContactLookupCache, ContactLookupCoordinator};
+use incoming_message::{batch::CspE2eKeyCache, task::IncomingMessageTask};
 use libthreema_macros::Name;
 use provider::{ContactProvider, MessageProvider, NonceStorage, SettingsProvider, ShortcutProvider};
 
@@ -244,6 +244,10 @@ pub struct CspE2eProtocolContext {
     messages: Rc<dyn MessageProvider>,
     /// See [`ContactLookupCache`].
     contact_lookup_cache: ContactLookupCache,
+    /// See [`ContactLookupCoordinator`].
+    contact_lookup_coordinator: ContactLookupCoordinator,
+    /// See [`CspE2eKeyCache`].
+    csp_e2e_key_cache: CspE2eKeyCache,
 }
 
 /// The Chat Server E2EE Protocol state machine.
@@ -284,4 +288,29 @@ impl CspE2eProtocol {
     pub fn handle_incoming_message(payload: MessageWithMetadataBox) -> IncomingMessageTask {
         IncomingMessageTask::new(payload)
     }
+
+    /// Create a task for each of the incoming `payloads`, e.g. when draining the messages that
+    /// queued up on the server while the client was offline.
+    ///
+    /// Decoding and decrypting the payloads of senders that are existing contacts is done upfront
+    /// for the whole batch, spread across all available cores and deriving the shared secret only
+    /// once per sender. Senders that are not yet contacts are announced to be looked up, so that
+    /// they can be requested from the directory in as few requests as possible. The resulting tasks
+    /// must still be polled sequentially in the order of the `payloads`, but a task may be left
+    /// awaiting its `reflect-ack` while the following tasks are polled. Submit the reflected
+    /// messages of all tasks to a [`reflect::pipeline::ReflectPipeline`] in that case, so that they
+    /// are reflected in batches and each task can acknowledge its message as soon as its reflection
+    /// has been acknowledged.
+    #[must_use]
+    pub fn handle_incoming_messages(&mut self, payloads: Vec<MessageWithMetadataBox>) -> Vec<IncomingMessageTask> {
+        let context = &mut self.context;
+        let contacts = &context.contacts;
+        incoming_message::batch::create_tasks(
+            &context.csp_e2e.client_key,
+            &mut context.csp_e2e_key_cache,
+            &mut context.contact_lookup_coordinator,
+            |identity| contacts.get(identity).map(|contact| contact.public_key),
+            payloads,
+        )
+    }
 }
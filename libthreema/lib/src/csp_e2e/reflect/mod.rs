@@ -12,11 +12,16 @@ use crate::{
     protobuf::{self},
 };
 
+pub mod pipeline;
+
 /// 1. Let `reflect-ids` be the list of all reflect IDs of `reflect_messages` that do not have the _ephemeral_
 ///    flag.
 /// 2. Reflect each message of `reflect_messages` with the provided flags and ID as a `reflect` message.
 /// 3. Wait until all `reflect-ids` have been acknowledged by a corresponding `reflect-ack` message, call the
 ///    associated task with the result (subtask: [`ReflectSubtask::reflect_ack`]) and poll again.
+///
+/// When many tasks reflect concurrently (e.g. when processing a batch of incoming messages), use a
+/// [`pipeline::ReflectPipeline`] for steps 2 and 3.
 pub struct ReflectInstruction {
     /// Messages that need to be reflected.
     pub reflect_messages: Vec<ReflectPayload>,
@@ -0,0 +1,350 @@
+//! Pipeline for reflecting the messages of many concurrently running tasks.
+//!
+//! Without it, each task reflects its messages on its own and awaits all of their `reflect-ack`s
+//! before it proceeds, i.e. every incoming message costs a full round trip to the mediator before
+//! the next one can be reflected. The pipeline instead queues the messages of all tasks that need
+//! to reflect, coalesces them into batches of D2M `reflect` messages and keeps up to a window of
+//! them unacknowledged. Each `reflect-ack` is matched to its task individually, so that a task (and
+//! e.g. the CSP `message-ack` of an incoming message) completes as soon as its own reflections have
+//! been acknowledged.
+//!
+//! The flow is as follows:
+//!
+//! 1. [`ReflectPipeline::submit`] the `reflect_messages` of a [`super::ReflectInstruction`] (or of
+//!    a [`crate::csp_e2e::transaction::commit::CommitTransactionInstruction`]) and remember the
+//!    returned [`ReflectTicket`] for the task.
+//! 2. Take all [`ReflectPipeline::next_batch`]es, encode each message as a D2M `reflect` and send
+//!    each batch in one go. Repeat this whenever messages have been submitted or acknowledged.
+//! 3. Provide each received `reflect-ack` to [`ReflectPipeline::reflect_ack`].
+//! 4. Take all [`ReflectPipeline::next_completion`]s, provide the acknowledged reflect IDs to the
+//!    task of the ticket and poll it again.
+use std::collections::{HashMap, VecDeque};
+
+use tracing::{debug, warn};
+
+use super::ReflectPayload;
+use crate::csp_e2e::ReflectId;
+
+/// Identifies the messages of one task submitted to a [`ReflectPipeline`].
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+pub struct ReflectTicket(pub u64);
+
+/// Configuration of the [`ReflectPipeline`].
+#[derive(Clone, Copy, Debug)]
+pub struct ReflectPipelineConfig {
+    /// Maximum amount of messages per batch (at least 1).
+    pub max_batch_size: usize,
+
+    /// Maximum amount of reflected messages awaiting a `reflect-ack` (at least 1). Ephemeral
+    /// messages are not acknowledged and therefore do not count towards the window.
+    pub window: usize,
+}
+impl Default for ReflectPipelineConfig {
+    fn default() -> Self {
+        Self {
+            max_batch_size: 64,
+            window: 256,
+        }
+    }
+}
+
+/// A batch of messages to be reflected.
+pub struct ReflectBatch {
+    /// Messages to be reflected, in order. Send each as a D2M `reflect` message, all at once.
+    pub reflect_messages: Vec<ReflectPayload>,
+
+    /// Tickets whose last message is part of this batch.
+    ///
+    /// For a transaction, the `CommitTransaction` message may be sent right after this batch,
+    /// without awaiting the `reflect-ack`s first.
+    pub flushed_tickets: Vec<ReflectTicket>,
+}
+
+/// All messages of a ticket have been reflected and, unless ephemeral, acknowledged.
+pub struct ReflectCompletion {
+    /// The ticket returned when the messages were submitted.
+    pub ticket: ReflectTicket,
+
+    /// The acknowledged reflect IDs of the ticket's messages, to be provided to the task.
+    pub acknowledged_reflect_ids: Vec<ReflectId>,
+}
+
+struct QueuedReflect {
+    ticket: ReflectTicket,
+    payload: ReflectPayload,
+}
+
+struct TicketState {
+    /// Amount of messages that are queued or awaiting a `reflect-ack`.
+    outstanding: usize,
+    acknowledged_reflect_ids: Vec<ReflectId>,
+}
+
+/// Coalesces the messages to be reflected of many tasks into batches and tracks their
+/// acknowledgement with a sliding window (see the [module documentation](self)).
+pub struct ReflectPipeline {
+    config: ReflectPipelineConfig,
+    next_ticket: u64,
+    queue: VecDeque<QueuedReflect>,
+    in_flight: HashMap<ReflectId, ReflectTicket>,
+    tickets: HashMap<ReflectTicket, TicketState>,
+    completions: VecDeque<ReflectCompletion>,
+}
+impl ReflectPipeline {
+    /// Create a new, empty pipeline.
+    #[must_use]
+    pub fn new(config: ReflectPipelineConfig) -> Self {
+        Self {
+            config: ReflectPipelineConfig {
+                max_batch_size: config.max_batch_size.max(1),
+                window: config.window.max(1),
+            },
+            next_ticket: 0,
+            queue: VecDeque::new(),
+            in_flight: HashMap::with_capacity(config.window),
+            tickets: HashMap::new(),
+            completions: VecDeque::new(),
+        }
+    }
+
+    /// Queue the `reflect_messages` of a task. The messages are reflected in order of submission.
+    ///
+    /// Returns the ticket that identifies the task's messages in [`ReflectBatch::flushed_tickets`]
+    /// and in its [`ReflectCompletion`].
+    pub fn submit(&mut self, reflect_messages: Vec<ReflectPayload>) -> ReflectTicket {
+        let ticket = ReflectTicket(self.next_ticket);
+        self.next_ticket = self.next_ticket.wrapping_add(1);
+
+        // Nothing to reflect, complete immediately
+        if reflect_messages.is_empty() {
+            self.completions.push_back(ReflectCompletion {
+                ticket,
+                acknowledged_reflect_ids: vec![],
+            });
+            return ticket;
+        }
+
+        let _ = self.tickets.insert(
+            ticket,
+            TicketState {
+                outstanding: reflect_messages.len(),
+                acknowledged_reflect_ids: Vec::with_capacity(reflect_messages.len()),
+            },
+        );
+        self.queue.extend(
+            reflect_messages
+                .into_iter()
+                .map(|payload| QueuedReflect { ticket, payload }),
+        );
+        ticket
+    }
+
+    /// Take the next batch of queued messages to be reflected.
+    ///
+    /// Returns `None` if no message is queued or if the window is exhausted until more
+    /// `reflect-ack`s have been provided.
+    pub fn next_batch(&mut self) -> Option<ReflectBatch> {
+        let mut batch = ReflectBatch {
+            reflect_messages: vec![],
+            flushed_tickets: vec![],
+        };
+        while batch.reflect_messages.len() < self.config.max_batch_size {
+            // Keep the order, so stop at the first message that does not fit into the window
+            let Some(next) = self.queue.front() else {
+                break;
+            };
+            let ephemeral = next.payload.flags.ephemeral;
+            if !ephemeral && self.in_flight.len() >= self.config.window {
+                break;
+            }
+            let Some(QueuedReflect { ticket, payload }) = self.queue.pop_front() else {
+                break;
+            };
+
+            // The messages of a ticket are queued contiguously
+            if !self.queue.front().is_some_and(|next| next.ticket == ticket) {
+                batch.flushed_tickets.push(ticket);
+            }
+
+            // Ephemeral messages are not acknowledged by the mediator
+            if ephemeral {
+                self.settle(ticket, None);
+            } else {
+                let _ = self.in_flight.insert(payload.id, ticket);
+            }
+            batch.reflect_messages.push(payload);
+        }
+
+        if batch.reflect_messages.is_empty() {
+            return None;
+        }
+        debug!(
+            n_messages = batch.reflect_messages.len(),
+            n_flushed_tickets = batch.flushed_tickets.len(),
+            n_in_flight = self.in_flight.len(),
+            n_queued = self.queue.len(),
+            "Reflecting batch"
+        );
+        Some(batch)
+    }
+
+    /// Provide a `reflect-ack` received from the mediator.
+    ///
+    /// Note: An acknowledgement without an associated reflected message is logged and discarded,
+    /// like it is by an individual task.
+    pub fn reflect_ack(&mut self, reflect_id: ReflectId) {
+        let Some(ticket) = self.in_flight.remove(&reflect_id) else {
+            warn!(
+                ?reflect_id,
+                "Acknowledged reflect ID has no associated reflected message"
+            );
+            return;
+        };
+        self.settle(ticket, Some(reflect_id));
+    }
+
+    /// Take the next ticket whose messages have all been reflected and acknowledged.
+    pub fn next_completion(&mut self) -> Option<ReflectCompletion> {
+        self.completions.pop_front()
+    }
+
+    /// Whether there are no messages queued or awaiting a `reflect-ack` and no completions left to
+    /// be taken.
+    #[must_use]
+    pub fn is_idle(&self) -> bool {
+        self.queue.is_empty() && self.in_flight.is_empty() && self.completions.is_empty()
+    }
+
+    /// Mark one message of `ticket` as done, completing the ticket with its last message.
+    fn settle(&mut self, ticket: ReflectTicket, acknowledged_reflect_id: Option<ReflectId>) {
+        let Some(state) = self.tickets.get_mut(&ticket) else {
+            warn!(?ticket, "Settled message has no associated ticket");
+            return;
+        };
+        if let Some(reflect_id) = acknowledged_reflect_id {
+            state.acknowledged_reflect_ids.push(reflect_id);
+        }
+        state.outstanding = state.outstanding.saturating_sub(1);
+        if state.outstanding > 0 {
+            return;
+        }
+        if let Some(state) = self.tickets.remove(&ticket) {
+            self.completions.push_back(ReflectCompletion {
+                ticket,
+                acknowledged_reflect_ids: state.acknowledged_reflect_ids,
+            });
+        }
+    }
+}
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::csp_e2e::reflect::ReflectFlags;
+
+    fn payloads(ids: &[u32], ephemeral: bool) -> Vec<ReflectPayload> {
+        ids.iter()
+            .map(|id| ReflectPayload {
+                flags: ReflectFlags { ephemeral },
+                id: ReflectId(*id),
+                envelope: vec![],
+            })
+            .collect()
+    }
+
+    fn ids(batch: &ReflectBatch) -> Vec<u32> {
+        batch
+            .reflect_messages
+            .iter()
+            .map(|payload| payload.id.0)
+            .collect()
+    }
+
+    #[test]
+    fn coalesce_tickets_into_batches() {
+        let mut pipeline = ReflectPipeline::new(ReflectPipelineConfig {
+            max_batch_size: 3,
+            window: 16,
+        });
+        let first = pipeline.submit(payloads(&[1, 2], false));
+        let second = pipeline.submit(payloads(&[3, 4], false));
+
+        let batch = pipeline.next_batch().unwrap();
+        assert_eq!(ids(&batch), [1, 2, 3]);
+        assert_eq!(batch.flushed_tickets, [first]);
+        let batch = pipeline.next_batch().unwrap();
+        assert_eq!(ids(&batch), [4]);
+        assert_eq!(batch.flushed_tickets, [second]);
+        assert!(pipeline.next_batch().is_none());
+    }
+
+    #[test]
+    fn complete_tickets_on_their_own_acks() {
+        let mut pipeline = ReflectPipeline::new(ReflectPipelineConfig::default());
+        let first = pipeline.submit(payloads(&[1, 2], false));
+        let second = pipeline.submit(payloads(&[3], false));
+        let _ = pipeline.next_batch().unwrap();
+
+        // The second ticket completes before the first one
+        pipeline.reflect_ack(ReflectId(3));
+        pipeline.reflect_ack(ReflectId(1));
+        let completion = pipeline.next_completion().unwrap();
+        assert_eq!(completion.ticket, second);
+        assert_eq!(completion.acknowledged_reflect_ids, [ReflectId(3)]);
+        assert!(pipeline.next_completion().is_none());
+
+        pipeline.reflect_ack(ReflectId(2));
+        let completion = pipeline.next_completion().unwrap();
+        assert_eq!(completion.ticket, first);
+        assert_eq!(completion.acknowledged_reflect_ids, [ReflectId(1), ReflectId(2)]);
+        assert!(pipeline.is_idle());
+    }
+
+    #[test]
+    fn stall_when_window_is_exhausted() {
+        let mut pipeline = ReflectPipeline::new(ReflectPipelineConfig {
+            max_batch_size: 16,
+            window: 2,
+        });
+        let _ = pipeline.submit(payloads(&[1, 2, 3], false));
+        assert_eq!(ids(&pipeline.next_batch().unwrap()), [1, 2]);
+        assert!(pipeline.next_batch().is_none());
+
+        pipeline.reflect_ack(ReflectId(1));
+        let batch = pipeline.next_batch().unwrap();
+        assert_eq!(ids(&batch), [3]);
+        assert_eq!(batch.flushed_tickets.len(), 1);
+    }
+
+    #[test]
+    fn complete_ephemeral_tickets_when_flushed() {
+        let mut pipeline = ReflectPipeline::new(ReflectPipelineConfig {
+            max_batch_size: 16,
+            window: 1,
+        });
+        let _ = pipeline.submit(payloads(&[1], false));
+        let ephemeral = pipeline.submit(payloads(&[2], true));
+        let empty = pipeline.submit(vec![]);
+
+        // Ephemeral messages pass the exhausted window
+        assert_eq!(ids(&pipeline.next_batch().unwrap()), [1, 2]);
+        assert_eq!(pipeline.next_completion().unwrap().ticket, empty);
+        let completion = pipeline.next_completion().unwrap();
+        assert_eq!(completion.ticket, ephemeral);
+        assert!(completion.acknowledged_reflect_ids.is_empty());
+        assert!(pipeline.next_completion().is_none());
+    }
+
+    #[test]
+    fn discard_unknown_acks() {
+        let mut pipeline = ReflectPipeline::new(ReflectPipelineConfig::default());
+        let _ = pipeline.submit(payloads(&[1], false));
+        let _ = pipeline.next_batch().unwrap();
+
+        pipeline.reflect_ack(ReflectId(42));
+        assert!(pipeline.next_completion().is_none());
+        pipeline.reflect_ack(ReflectId(1));
+        assert!(pipeline.next_completion().is_some());
+    }
+}
@@ -0,0 +1,619 @@
+//! Implementation of the _History Exchange Protocol_ (transferring the conversation history from the
+//! source device (SD) to the destination device (DD) over a nominated rendezvous path).
+//!
+//! The protocol is split into two parts:
+//!
+//! - The summary and transfer negotiation (`GetSummary`, `Summary`, `BeginTransfer`), handled by
+//!   the [`HistoryExportSession`] on SD and the [`HistoryImportSession`] on DD.
+//! - The transfer itself (`common.BlobData` and `Data`), run by the [`pipeline`] which overlaps
+//!   reading from the database, fetching blobs, encoding and encrypting (respectively the reverse on
+//!   DD).
+use bytes::Bytes;
+use prost::Message as _;
+use tracing::{debug, warn};
+
+use crate::{
+    common::{BlobId, Conversation, MessageId, ThreemaId},
+    d2d_rendezvous::RendezvousProtocolError,
+    protobuf::{self, d2d_history as protobuf_history},
+};
+
+pub mod pipeline;
+
+/// An error occurred while running the History Exchange Protocol.
+///
+/// When encountering an error, abort the protocol and close the connection.
+#[derive(Debug, thiserror::Error)]
+pub enum HistoryError {
+    /// Unable to decode a protobuf message.
+    #[error("Decoding failed: {0}")]
+    ProtobufDecodeFailed(#[from] prost::DecodeError),
+
+    /// An incoming message is invalid.
+    #[error("Invalid message: {0}")]
+    InvalidMessage(String),
+
+    /// An incoming message was not expected in the current state.
+    #[error("Unexpected message: {0}")]
+    UnexpectedMessage(&'static str),
+
+    /// The rendezvous protocol failed.
+    #[error("Rendezvous protocol failed: {0}")]
+    RendezvousFailed(#[from] RendezvousProtocolError),
+
+    /// Reading from or writing to the history or blob store failed.
+    #[error("Store failed: {0}")]
+    StoreFailed(String),
+
+    /// Sending or receiving on the transport failed.
+    #[error("Transport failed: {0}")]
+    TransportFailed(String),
+
+    /// The connection was closed before the transfer was complete.
+    #[error("Transfer incomplete")]
+    TransferIncomplete,
+}
+
+/// A timespan (Unix-ish timestamps in milliseconds, both inclusive).
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct Timespan {
+    /// Start of the timespan.
+    pub from: u64,
+
+    /// End of the timespan.
+    pub to: u64,
+}
+impl Timespan {
+    /// Whether `timestamp` lies within the timespan.
+    #[must_use]
+    pub const fn contains(&self, timestamp: u64) -> bool {
+        timestamp >= self.from && timestamp <= self.to
+    }
+}
+impl From<Timespan> for protobuf::common::Timespan {
+    fn from(timespan: Timespan) -> Self {
+        Self {
+            from: timespan.from,
+            to: timespan.to,
+        }
+    }
+}
+impl From<&protobuf::common::Timespan> for Timespan {
+    fn from(timespan: &protobuf::common::Timespan) -> Self {
+        Self {
+            from: timespan.from,
+            to: timespan.to,
+        }
+    }
+}
+
+/// Direction and direction specific properties of a [`HistoryMessage`].
+#[derive(Clone)]
+pub enum HistoryMessageDirection {
+    /// An incoming message.
+    Incoming {
+        /// Sender's Threema ID.
+        sender_identity: ThreemaId,
+
+        /// Unix-ish timestamp in milliseconds for when the message has been received.
+        received_at: u64,
+    },
+
+    /// An outgoing message.
+    Outgoing {
+        /// Conversation the message has been sent to.
+        conversation: Conversation,
+
+        /// Unix-ish timestamp in milliseconds for when the message has been sent.
+        sent_at: u64,
+    },
+}
+
+/// A past message of the conversation history.
+#[derive(Clone)]
+pub struct HistoryMessage {
+    /// Unique ID of the message.
+    pub id: MessageId,
+
+    /// Direction of the message.
+    pub direction: HistoryMessageDirection,
+
+    /// Unix-ish timestamp in milliseconds for when the message has been created.
+    pub created_at: u64,
+
+    /// CSP E2E message type.
+    pub message_type: u8,
+
+    /// The message's body, i.e. the unpadded `csp.e2e.container.padded-data`.
+    ///
+    /// Note: When imported, this is a slice of the decrypted payload it has been decoded from.
+    pub body: Bytes,
+
+    /// Unix-ish timestamp in milliseconds for when the message has been marked as read, if any.
+    pub read_at: Option<u64>,
+}
+impl HistoryMessage {
+    /// The timestamp the requested timespan refers to: When the message has been created for
+    /// outgoing messages and when it has been received for incoming messages.
+    #[must_use]
+    pub const fn timespan_timestamp(&self) -> u64 {
+        match &self.direction {
+            HistoryMessageDirection::Incoming { received_at, .. } => *received_at,
+            HistoryMessageDirection::Outgoing { .. } => self.created_at,
+        }
+    }
+}
+impl From<HistoryMessage> for protobuf_history::PastMessage {
+    fn from(message: HistoryMessage) -> Self {
+        let message_type = i32::from(message.message_type);
+        let content = match message.direction {
+            HistoryMessageDirection::Incoming {
+                sender_identity,
+                received_at,
+            } => protobuf_history::past_message::Message::Incoming(protobuf_history::PastIncomingMessage {
+                message: Some(protobuf::d2d::IncomingMessage {
+                    sender_identity: sender_identity.as_str().to_owned(),
+                    message_id: message.id.0,
+                    created_at: message.created_at,
+                    r#type: message_type,
+                    body: message.body,
+                    nonce: Bytes::new(),
+                }),
+                received_at,
+                read_at: message.read_at,
+                last_reaction_at: None,
+            }),
+            HistoryMessageDirection::Outgoing {
+                conversation,
+                sent_at,
+            } => protobuf_history::past_message::Message::Outgoing(protobuf_history::PastOutgoingMessage {
+                message: Some(protobuf::d2d::OutgoingMessage {
+                    conversation: Some(protobuf::d2d::ConversationId::from(&conversation)),
+                    message_id: message.id.0,
+                    thread_message_id: None,
+                    created_at: message.created_at,
+                    r#type: message_type,
+                    body: message.body,
+                    nonces: vec![],
+                }),
+                sent_at,
+                read_at: message.read_at,
+                last_reaction_at: None,
+            }),
+        };
+        Self {
+            message: Some(content),
+        }
+    }
+}
+impl TryFrom<protobuf_history::PastMessage> for HistoryMessage {
+    type Error = HistoryError;
+
+    fn try_from(message: protobuf_history::PastMessage) -> Result<Self, Self::Error> {
+        let message_type = |r#type: i32| {
+            u8::try_from(r#type)
+                .map_err(|_| HistoryError::InvalidMessage(format!("Unknown message type {}", r#type)))
+        };
+        match message.message {
+            Some(protobuf_history::past_message::Message::Incoming(past_message)) => {
+                let inner = past_message.message.ok_or(HistoryError::InvalidMessage(
+                    "Missing incoming message".to_owned(),
+                ))?;
+                let sender_identity = ThreemaId::try_from(inner.sender_identity.as_str())
+                    .map_err(|error| HistoryError::InvalidMessage(error.to_string()))?;
+                Ok(Self {
+                    id: MessageId(inner.message_id),
+                    direction: HistoryMessageDirection::Incoming {
+                        sender_identity,
+                        received_at: past_message.received_at,
+                    },
+                    created_at: inner.created_at,
+                    message_type: message_type(inner.r#type)?,
+                    body: inner.body,
+                    read_at: past_message.read_at,
+                })
+            },
+            Some(protobuf_history::past_message::Message::Outgoing(past_message)) => {
+                let inner = past_message.message.ok_or(HistoryError::InvalidMessage(
+                    "Missing outgoing message".to_owned(),
+                ))?;
+                let conversation = inner
+                    .conversation
+                    .as_ref()
+                    .and_then(|conversation| conversation.id.as_ref())
+                    .ok_or(HistoryError::InvalidMessage("Missing conversation".to_owned()))
+                    .and_then(|conversation| {
+                        Conversation::try_from(conversation)
+                            .map_err(|error| HistoryError::InvalidMessage(error.to_string()))
+                    })?;
+                Ok(Self {
+                    id: MessageId(inner.message_id),
+                    direction: HistoryMessageDirection::Outgoing {
+                        conversation,
+                        sent_at: past_message.sent_at,
+                    },
+                    created_at: inner.created_at,
+                    message_type: message_type(inner.r#type)?,
+                    body: inner.body,
+                    read_at: past_message.read_at,
+                })
+            },
+            None => Err(HistoryError::InvalidMessage(
+                "Unknown past message variant".to_owned(),
+            )),
+        }
+    }
+}
+
+/// Summary of the conversation history available for a timespan.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct HistorySummary {
+    /// Amount of messages that would be transferred.
+    pub messages: u32,
+
+    /// Estimated size in bytes of the messages, including media if requested.
+    pub size: u64,
+}
+
+/// The conversation history to be transferred, as requested by DD.
+#[derive(Clone, Copy, Debug)]
+pub struct HistoryTransferRequest {
+    /// Timespan of the requested messages.
+    pub timespan: Timespan,
+
+    /// Whether media (i.e. blobs) should be included.
+    pub include_media: bool,
+
+    /// Amount of messages to be transferred, according to the summary.
+    pub messages: u32,
+}
+
+/// Read access to the conversation history stored on SD.
+pub trait HistoryStore: Send {
+    /// Return the summary of the conversation history for `timespan`.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError::StoreFailed`] if the database could not be queried.
+    fn summary(&mut self, timespan: Timespan, include_media: bool) -> Result<HistorySummary, HistoryError>;
+
+    /// Stream the messages of `timespan`, each with the IDs of the blobs it refers to.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError::StoreFailed`] if the database could not be queried.
+    fn messages(
+        &mut self,
+        timespan: Timespan,
+    ) -> Result<Box<dyn Iterator<Item = Result<HistoryRow, HistoryError>> + Send + '_>, HistoryError>;
+}
+
+/// A message of the conversation history as read from the database on SD.
+pub struct HistoryRow {
+    /// The message.
+    pub message: HistoryMessage,
+
+    /// IDs of the blobs the message refers to.
+    pub blob_ids: Vec<BlobId>,
+}
+
+/// Read access to the blobs stored on SD.
+pub trait BlobStore: Send {
+    /// Return the data of the blob associated to `blob_id`, if it is (still) available.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError::StoreFailed`] if the blob could not be read.
+    fn blob(&mut self, blob_id: &BlobId) -> Result<Option<Vec<u8>>, HistoryError>;
+}
+
+/// Write access to the conversation history and blobs on DD.
+pub trait HistorySink: Send {
+    /// Store a message. If the message already exists, overwrite it.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError::StoreFailed`] if the message could not be stored.
+    fn store_message(&mut self, message: HistoryMessage) -> Result<(), HistoryError>;
+
+    /// Store a blob persistently.
+    ///
+    /// Note: Blob references are only known when parsing the message bodies, so all blobs received
+    /// ahead of a `Data` message are handed out after its messages have been stored.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError::StoreFailed`] if the blob could not be stored.
+    fn store_blob(&mut self, blob_id: BlobId, data: Bytes) -> Result<(), HistoryError>;
+}
+
+/// Properties cached from the most recent `GetSummary` message.
+struct SummaryRequest {
+    id: u32,
+    timespan: Timespan,
+    include_media: bool,
+    messages: u32,
+}
+
+/// Instruction returned by [`HistoryExportSession::handle_message`].
+pub enum HistoryExportInstruction {
+    /// Send the enclosed encoded `SdToDd` message to DD.
+    SendMessage(Vec<u8>),
+
+    /// Run the export [`pipeline`] for the enclosed request.
+    BeginTransfer(HistoryTransferRequest),
+}
+
+/// Handles the negotiation of the transfer on SD.
+#[derive(Default)]
+pub struct HistoryExportSession {
+    request: Option<SummaryRequest>,
+    transfer_started: bool,
+}
+impl HistoryExportSession {
+    /// Create a new session for SD.
+    #[must_use]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Handle an incoming `DdToSd` message from DD.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError`] if the message could not be decoded, was not expected (which
+    /// requires closing the connection), or the summary could not be retrieved from `store`.
+    pub fn handle_message(
+        &mut self,
+        store: &mut dyn HistoryStore,
+        ulp_data: &[u8],
+    ) -> Result<HistoryExportInstruction, HistoryError> {
+        let message = protobuf_history::DdToSd::decode(ulp_data)?;
+        match message.content {
+            Some(protobuf_history::dd_to_sd::Content::GetSummary(get_summary)) => {
+                if self.transfer_started {
+                    return Err(HistoryError::UnexpectedMessage("GetSummary after BeginTransfer"));
+                }
+
+                // Filter media, retrieve the summary and cache the requested properties
+                let include_media = get_summary
+                    .media
+                    .contains(&(protobuf_history::MediaType::All as i32));
+                let timespan = get_summary
+                    .timespan
+                    .as_ref()
+                    .map(Timespan::from)
+                    .ok_or(HistoryError::InvalidMessage("Missing timespan".to_owned()))?;
+                let summary = store.summary(timespan, include_media)?;
+                debug!(id = get_summary.id, ?summary, "Retrieved history summary");
+                self.request = Some(SummaryRequest {
+                    id: get_summary.id,
+                    timespan,
+                    include_media,
+                    messages: summary.messages,
+                });
+                Ok(HistoryExportInstruction::SendMessage(
+                    protobuf_history::SdToDd {
+                        content: Some(protobuf_history::sd_to_dd::Content::Summary(
+                            protobuf_history::Summary {
+                                id: get_summary.id,
+                                messages: summary.messages,
+                                size: summary.size,
+                            },
+                        )),
+                    }
+                    .encode_to_vec(),
+                ))
+            },
+            Some(protobuf_history::dd_to_sd::Content::BeginTransfer(begin_transfer)) => {
+                if self.transfer_started {
+                    return Err(HistoryError::UnexpectedMessage("Repeated BeginTransfer"));
+                }
+                let request = self
+                    .request
+                    .as_ref()
+                    .filter(|request| request.id == begin_transfer.id)
+                    .ok_or_else(|| {
+                        HistoryError::InvalidMessage(format!(
+                            "Unknown summary request ID {}",
+                            begin_transfer.id
+                        ))
+                    })?;
+                self.transfer_started = true;
+                Ok(HistoryExportInstruction::BeginTransfer(HistoryTransferRequest {
+                    timespan: request.timespan,
+                    include_media: request.include_media,
+                    messages: request.messages,
+                }))
+            },
+            None => Err(HistoryError::InvalidMessage("Unknown DdToSd variant".to_owned())),
+        }
+    }
+}
+
+/// Handles the negotiation of the transfer on DD.
+#[derive(Default)]
+pub struct HistoryImportSession {
+    next_id: u32,
+    request: Option<(u32, Timespan)>,
+    transfer_started: bool,
+}
+impl HistoryImportSession {
+    /// Create a new session for DD.
+    #[must_use]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Create an encoded `DdToSd` message requesting a summary of the conversation history for
+    /// `timespan`. Supersedes any previous summary request.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError::UnexpectedMessage`] if the transfer has already begun.
+    pub fn get_summary(&mut self, timespan: Timespan, include_media: bool) -> Result<Vec<u8>, HistoryError> {
+        if self.transfer_started {
+            return Err(HistoryError::UnexpectedMessage("GetSummary after BeginTransfer"));
+        }
+        let id = self.next_id;
+        self.next_id = self.next_id.wrapping_add(1);
+        self.request = Some((id, timespan));
+        let media = if include_media {
+            vec![protobuf_history::MediaType::All as i32]
+        } else {
+            vec![]
+        };
+        Ok(protobuf_history::DdToSd {
+            content: Some(protobuf_history::dd_to_sd::Content::GetSummary(
+                protobuf_history::GetSummary {
+                    id,
+                    timespan: Some(timespan.into()),
+                    media,
+                },
+            )),
+        }
+        .encode_to_vec())
+    }
+
+    /// Handle an incoming `SdToDd.Summary` message from SD.
+    ///
+    /// Returns the summary if it refers to the most recent summary request, or [`None`] if it is
+    /// stale and should be discarded.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError`] if the message could not be decoded or is not a `Summary`.
+    pub fn handle_summary(&mut self, ulp_data: &[u8]) -> Result<Option<HistorySummary>, HistoryError> {
+        let message = protobuf_history::SdToDd::decode(ulp_data)?;
+        let Some(protobuf_history::sd_to_dd::Content::Summary(summary)) = message.content else {
+            return Err(HistoryError::UnexpectedMessage("Expected Summary"));
+        };
+        if self.transfer_started || self.request.is_none_or(|(id, _)| id != summary.id) {
+            warn!(id = summary.id, "Discarding stale summary");
+            return Ok(None);
+        }
+        Ok(Some(HistorySummary {
+            messages: summary.messages,
+            size: summary.size,
+        }))
+    }
+
+    /// Create an encoded `DdToSd` message beginning the transfer of the conversation history for the
+    /// most recent summary request.
+    ///
+    /// Returns the message and the requested timespan, to be provided to the import [`pipeline`].
+    ///
+    /// # Errors
+    ///
+    /// Returns [`HistoryError::UnexpectedMessage`] if no summary has been requested or the
+    /// transfer has already begun.
+    pub fn begin_transfer(&mut self) -> Result<(Vec<u8>, Timespan), HistoryError> {
+        let (id, timespan) =
+            self.request
+                .filter(|_| !self.transfer_started)
+                .ok_or(HistoryError::UnexpectedMessage(
+                    "BeginTransfer without GetSummary",
+                ))?;
+        self.transfer_started = true;
+        Ok((
+            protobuf_history::DdToSd {
+                content: Some(protobuf_history::dd_to_sd::Content::BeginTransfer(
+                    protobuf_history::BeginTransfer { id },
+                )),
+            }
+            .encode_to_vec(),
+            timespan,
+        ))
+    }
+}
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    struct SummaryStore;
+    impl HistoryStore for SummaryStore {
+        fn summary(
+            &mut self,
+            timespan: Timespan,
+            include_media: bool,
+        ) -> Result<HistorySummary, HistoryError> {
+            Ok(HistorySummary {
+                messages: u32::try_from(timespan.to.saturating_sub(timespan.from)).unwrap(),
+                size: if include_media { 1000 } else { 10 },
+            })
+        }
+
+        fn messages(
+            &mut self,
+            _timespan: Timespan,
+        ) -> Result<Box<dyn Iterator<Item = Result<HistoryRow, HistoryError>> + Send + '_>, HistoryError>
+        {
+            Ok(Box::new(core::iter::empty()))
+        }
+    }
+
+    fn handle(
+        session: &mut HistoryExportSession,
+        ulp_data: &[u8],
+    ) -> Result<HistoryExportInstruction, HistoryError> {
+        session.handle_message(&mut SummaryStore, ulp_data)
+    }
+
+    #[test]
+    fn negotiate_transfer() {
+        let mut sd = HistoryExportSession::new();
+        let mut dd = HistoryImportSession::new();
+
+        // A summary superseded by another request is stale
+        let first_get_summary = dd.get_summary(Timespan { from: 0, to: 10 }, false).unwrap();
+        let second_get_summary = dd.get_summary(Timespan { from: 0, to: 20 }, true).unwrap();
+        let HistoryExportInstruction::SendMessage(first_summary) =
+            handle(&mut sd, &first_get_summary).unwrap()
+        else {
+            unreachable!("Expected Summary");
+        };
+        assert_eq!(dd.handle_summary(&first_summary).unwrap(), None);
+        let HistoryExportInstruction::SendMessage(second_summary) =
+            handle(&mut sd, &second_get_summary).unwrap()
+        else {
+            unreachable!("Expected Summary");
+        };
+        assert_eq!(
+            dd.handle_summary(&second_summary).unwrap(),
+            Some(HistorySummary {
+                messages: 20,
+                size: 1000
+            })
+        );
+
+        // Begin the transfer for the most recent summary request
+        let (begin_transfer, timespan) = dd.begin_transfer().unwrap();
+        assert_eq!(timespan, Timespan { from: 0, to: 20 });
+        let HistoryExportInstruction::BeginTransfer(request) = handle(&mut sd, &begin_transfer).unwrap()
+        else {
+            unreachable!("Expected BeginTransfer");
+        };
+        assert!(request.include_media);
+        assert_eq!(request.messages, 20);
+
+        // Neither side may restart the negotiation
+        assert!(dd.begin_transfer().is_err());
+        assert!(dd.get_summary(timespan, false).is_err());
+        assert!(handle(&mut sd, &begin_transfer).is_err());
+        assert!(handle(&mut sd, &second_get_summary).is_err());
+    }
+
+    #[test]
+    fn reject_transfer_of_unknown_summary() {
+        let mut sd = HistoryExportSession::new();
+        let mut dd = HistoryImportSession::new();
+        let _ = dd.get_summary(Timespan { from: 0, to: 10 }, false).unwrap();
+        let (begin_transfer, _) = dd.begin_transfer().unwrap();
+        assert!(matches!(
+            handle(&mut sd, &begin_transfer),
+            Err(HistoryError::InvalidMessage(_))
+        ));
+    }
+}
@@ -0,0 +1,1028 @@
+//! Pipelined transfer of the conversation history.
+//!
+//! A naive transfer would read a message, fetch its blobs, encode, encrypt and send it before
+//! reading the next one, leaving the CPU idle while waiting for I/O and vice versa. Instead, the
+//! transfer is split into stages running on their own threads, connected by bounded queues:
+//!
+//! ```text
+//! SD: rows -> blobs -> encoding -> sending (calling thread)
+//! DD: receiving (calling thread) -> decoding -> storing
+//! ```
+//!
+//! The bounded queues apply backpressure, so a slow stage (e.g. the transport) limits the amount of
+//! data buffered by the stages in front of it.
+//!
+//! Note: Requires threads. The sending and receiving stage run on the calling thread, so the
+//! [`RendezvousProtocol`] and the transport do not need to be [`Send`].
+use core::{
+    mem,
+    sync::atomic::{AtomicBool, Ordering},
+};
+use std::{
+    collections::HashMap,
+    panic,
+    sync::mpsc::{self, Receiver, Sender, SyncSender},
+    thread::{self, ScopedJoinHandle},
+};
+
+use bytes::Bytes;
+use prost::Message as _;
+use tracing::{debug, warn};
+
+use super::{
+    BlobStore, HistoryError, HistoryMessage, HistoryRow, HistorySink, HistoryStore, HistoryTransferRequest,
+    Timespan,
+};
+use crate::{
+    common::BlobId,
+    d2d_rendezvous::{OutgoingFrame, RendezvousProtocol},
+    protobuf::{self, d2d_history as protobuf_history},
+};
+
+/// Maximum amount of messages in a single `Data` message.
+const MAX_MESSAGES_PER_DATA: usize = 100;
+
+/// Size in bytes of the messages (and blobs sent ahead) after which a `Data` message is sent.
+const MAX_DATA_SIZE: usize = 100 * 1_048_576;
+
+/// Configuration of the transfer pipeline.
+#[derive(Clone, Copy, Debug)]
+pub struct PipelineConfig {
+    /// Capacity of each queue between two stages.
+    pub queue_capacity: usize,
+}
+impl Default for PipelineConfig {
+    fn default() -> Self {
+        Self { queue_capacity: 64 }
+    }
+}
+
+/// Statistics of a completed transfer.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct TransferStats {
+    /// Amount of messages transferred.
+    pub messages: u64,
+
+    /// Amount of blobs transferred.
+    pub blobs: u64,
+
+    /// Amount of encoded bytes transferred (before encryption).
+    pub bytes: u64,
+}
+
+/// Run a pipeline stage, flagging the pipeline as aborted if the stage fails. This prevents the
+/// following stages from mistaking the end of their input queue for the end of the transfer.
+///
+/// Note: A stage whose queue has been closed prematurely stops without an error, so that only the
+/// stage causing the abort reports one.
+fn run_stage<T, F: FnOnce() -> Result<T, HistoryError>>(
+    aborted: &AtomicBool,
+    stage: F,
+) -> Result<T, HistoryError> {
+    stage().inspect_err(|error| {
+        warn!(?error, "Transfer pipeline stage failed");
+        aborted.store(true, Ordering::Release);
+    })
+}
+
+/// Wait for a stage to finish, propagating any panic.
+fn join<T>(handle: ScopedJoinHandle<'_, Result<T, HistoryError>>) -> Result<T, HistoryError> {
+    handle.join().unwrap_or_else(panic::resume_unwind)
+}
+
+/// SD: Read the messages of the requested timespan from the database.
+fn read_rows(
+    store: &mut dyn HistoryStore,
+    timespan: Timespan,
+    rows: &SyncSender<HistoryRow>,
+) -> Result<(), HistoryError> {
+    for row in store.messages(timespan)? {
+        if rows.send(row?).is_err() {
+            // A following stage failed
+            break;
+        }
+    }
+    Ok(())
+}
+
+/// SD: Fetch the blobs referred to by each message, if media has been requested.
+fn fetch_blobs(
+    blob_store: &mut dyn BlobStore,
+    include_media: bool,
+    rows: Receiver<HistoryRow>,
+    messages: &SyncSender<(HistoryMessage, Vec<(BlobId, Vec<u8>)>)>,
+) -> Result<(), HistoryError> {
+    for row in rows {
+        let mut blobs = vec![];
+        if include_media {
+            for blob_id in row.blob_ids {
+                match blob_store.blob(&blob_id)? {
+                    Some(data) => blobs.push((blob_id, data)),
+                    None => warn!(?blob_id, "Blob not available, skipping"),
+                }
+            }
+        }
+        if messages.send((row.message, blobs)).is_err() {
+            break;
+        }
+    }
+    Ok(())
+}
+
+fn encode_blob_data(blob_id: BlobId, data: Vec<u8>) -> Vec<u8> {
+    protobuf_history::SdToDd {
+        content: Some(protobuf_history::sd_to_dd::Content::BlobData(
+            protobuf::common::BlobData {
+                id: Bytes::copy_from_slice(&blob_id.0),
+                data: Bytes::from(data),
+            },
+        )),
+    }
+    .encode_to_vec()
+}
+
+fn encode_data(messages: Vec<protobuf_history::PastMessage>, remaining: u64) -> Vec<u8> {
+    protobuf_history::SdToDd {
+        content: Some(protobuf_history::sd_to_dd::Content::Data(
+            protobuf_history::Data { messages, remaining },
+        )),
+    }
+    .encode_to_vec()
+}
+
+/// SD: Encode blobs into `common.BlobData` messages and batch messages into `Data` messages.
+///
+/// A full batch is only sent once the next message arrived, so that the last `Data` message
+/// always announces `0` remaining messages, even if the amount of messages deviates from the
+/// summary.
+fn encode_messages(
+    request: &HistoryTransferRequest,
+    messages: Receiver<(HistoryMessage, Vec<(BlobId, Vec<u8>)>)>,
+    payloads: &SyncSender<Vec<u8>>,
+    aborted: &AtomicBool,
+) -> Result<TransferStats, HistoryError> {
+    let mut stats = TransferStats::default();
+    let mut batch = Vec::with_capacity(MAX_MESSAGES_PER_DATA);
+    let mut batch_size: usize = 0;
+    for (message, blobs) in messages {
+        // Send the previous batch if it is full, now that more messages are known to follow
+        if batch.len() >= MAX_MESSAGES_PER_DATA || batch_size > MAX_DATA_SIZE {
+            let remaining = u64::from(request.messages).saturating_sub(stats.messages).max(1);
+            let batch = mem::replace(&mut batch, Vec::with_capacity(MAX_MESSAGES_PER_DATA));
+            batch_size = 0;
+            if payloads.send(encode_data(batch, remaining)).is_err() {
+                return Ok(stats);
+            }
+        }
+
+        // Send the blobs ahead of the message
+        for (blob_id, data) in blobs {
+            batch_size = batch_size.saturating_add(data.len());
+            stats.blobs = stats.blobs.saturating_add(1);
+            if payloads.send(encode_blob_data(blob_id, data)).is_err() {
+                return Ok(stats);
+            }
+        }
+
+        // Add the message to the batch
+        let message = protobuf_history::PastMessage::from(message);
+        batch_size = batch_size.saturating_add(message.encoded_len());
+        batch.push(message);
+        stats.messages = stats.messages.saturating_add(1);
+    }
+    if aborted.load(Ordering::Acquire) {
+        return Ok(stats);
+    }
+
+    // Send the last batch
+    let _ = payloads.send(encode_data(batch, 0));
+    Ok(stats)
+}
+
+/// Handed to `send_frame` of [`export`] along with each outgoing frame. Dropping it reports the
+/// frame as flushed (see [`RendezvousProtocol::ulp_frame_flushed`]), so the transport should keep
+/// it until the frame has been written (or cannot be written anymore).
+///
+/// Note: May be dropped on any thread.
+#[derive(Debug)]
+pub struct FrameFlushed {
+    pid: u32,
+    flushed: Sender<u32>,
+}
+impl Drop for FrameFlushed {
+    fn drop(&mut self) {
+        // The export may already be done, in which case nothing is in flight anymore
+        let _ = self.flushed.send(self.pid);
+    }
+}
+
+/// Sending side of [`export`], tracking the frames in flight until the transport reports them as
+/// flushed.
+struct FrameSender<'protocol, T> {
+    protocol: &'protocol mut RendezvousProtocol,
+    send_frame: T,
+    flushed_tx: Sender<u32>,
+    flushed_rx: Receiver<u32>,
+}
+impl<T: FnMut(u32, OutgoingFrame, FrameFlushed) -> Result<(), HistoryError>> FrameSender<'_, T> {
+    /// Apply all flushes reported so far.
+    fn apply_flushes(&mut self) -> Result<(), HistoryError> {
+        for pid in self.flushed_rx.try_iter() {
+            self.protocol.ulp_frame_flushed(pid)?;
+        }
+        Ok(())
+    }
+
+    /// Hand `outgoing_frame` to `send_frame`.
+    fn send_outgoing_frame(&mut self, pid: u32, outgoing_frame: OutgoingFrame) -> Result<(), HistoryError> {
+        let flushed = FrameFlushed {
+            pid,
+            flushed: self.flushed_tx.clone(),
+        };
+        (self.send_frame)(pid, outgoing_frame, flushed)
+    }
+
+    /// Encrypt `payload` and send the resulting frame(s) via `send_frame`.
+    fn send_payload(&mut self, payload: Vec<u8>) -> Result<(), HistoryError> {
+        self.apply_flushes()?;
+
+        // Pause while all paths are congested. Cannot disconnect since we hold a sender ourselves.
+        while self.protocol.is_congested() {
+            let Ok(pid) = self.flushed_rx.recv() else {
+                break;
+            };
+            self.protocol.ulp_frame_flushed(pid)?;
+        }
+        if self.protocol.is_ulp_streaming() {
+            for (pid, result) in self.protocol.write_ulp_stream(&payload, true)? {
+                if let Some(outgoing_frame) = result.outgoing_frame {
+                    self.send_outgoing_frame(pid, outgoing_frame)?;
+                }
+            }
+        } else {
+            let (pid, result) = self.protocol.create_striped_ulp_frame(payload)?;
+            if let Some(outgoing_frame) = result.outgoing_frame {
+                self.send_outgoing_frame(pid, outgoing_frame)?;
+            }
+        }
+        Ok(())
+    }
+}
+
+/// Export the conversation history for `request` on SD.
+///
+/// Messages are read from `store` and their blobs from `blob_store` (if media has been requested),
+/// encoded, encrypted by `protocol` and handed to `send_frame` along with the PID of the path each
+/// outgoing frame must be sent on and a [`FrameFlushed`] handle. `send_frame` should return as
+/// soon as the transport queued the frame and drop the handle once the frame has been written, so
+/// that striping spreads frames across paths according to their actual throughput. While all
+/// paths are congested, no further frames are created until a handle has been dropped.
+///
+/// Returns the transfer statistics once the last `Data` message has been handed to `send_frame`.
+/// The connection may then be closed once all buffered data has been written.
+///
+/// # Errors
+///
+/// Returns [`HistoryError`] if any stage failed, in which case the connection must be closed.
+pub fn export<T: FnMut(u32, OutgoingFrame, FrameFlushed) -> Result<(), HistoryError>>(
+    config: PipelineConfig,
+    request: &HistoryTransferRequest,
+    store: &mut dyn HistoryStore,
+    blob_store: &mut dyn BlobStore,
+    protocol: &mut RendezvousProtocol,
+    send_frame: T,
+) -> Result<TransferStats, HistoryError> {
+    debug!(?request, ?config, "Exporting conversation history");
+    let aborted = AtomicBool::new(false);
+    let aborted = &aborted;
+    let (rows_tx, rows_rx) = mpsc::sync_channel(config.queue_capacity);
+    let (messages_tx, messages_rx) = mpsc::sync_channel(config.queue_capacity);
+    let (payloads_tx, payloads_rx) = mpsc::sync_channel(config.queue_capacity);
+
+    thread::scope(|scope| {
+        let rows = scope.spawn(move || run_stage(aborted, || read_rows(store, request.timespan, &rows_tx)));
+        let blobs = scope.spawn(move || {
+            run_stage(aborted, || {
+                fetch_blobs(blob_store, request.include_media, rows_rx, &messages_tx)
+            })
+        });
+        let encoding = scope.spawn(move || {
+            run_stage(aborted, || {
+                encode_messages(request, messages_rx, &payloads_tx, aborted)
+            })
+        });
+
+        // Encrypt and send on the calling thread
+        let sending = run_stage(aborted, || {
+            let (flushed_tx, flushed_rx) = mpsc::channel();
+            let mut sender = FrameSender {
+                protocol,
+                send_frame,
+                flushed_tx,
+                flushed_rx,
+            };
+            let mut bytes: u64 = 0;
+            for payload in payloads_rx {
+                bytes = bytes.saturating_add(payload.len() as u64);
+                sender.send_payload(payload)?;
+            }
+
+            // Apply the flushes reported while sending the last payload
+            sender.apply_flushes()?;
+            Ok(bytes)
+        });
+
+        join(rows)?;
+        join(blobs)?;
+        let stats = join(encoding)?;
+        let bytes = sending?;
+        let stats = TransferStats { bytes, ..stats };
+        debug!(?stats, "Exported conversation history");
+        Ok(stats)
+    })
+}
+
+/// Just enough of an `SdToDd` message to tell whether it is the last `Data` message. All other
+/// fields are skipped without being decoded.
+#[allow(
+    clippy::all,
+    clippy::pedantic,
+    clippy::restriction,
+    reason = "Code generated by prost"
+)]
+mod last_data {
+    #[derive(Clone, PartialEq, prost::Message)]
+    pub(super) struct SdToDd {
+        #[prost(message, optional, tag = "3")]
+        pub(super) data: Option<Data>,
+    }
+
+    #[derive(Clone, PartialEq, prost::Message)]
+    pub(super) struct Data {
+        #[prost(uint64, tag = "2")]
+        pub(super) remaining: u64,
+    }
+}
+
+/// Whether `payload` contains the last `Data` message. Invalid payloads are left for the decoding
+/// stage to reject.
+fn is_last_payload(payload: &[u8]) -> bool {
+    last_data::SdToDd::decode(payload)
+        .is_ok_and(|message| message.data.is_some_and(|data| data.remaining == 0))
+}
+
+/// A `Data` message, decoded and ready to be stored, along with the blobs sent ahead of it.
+struct DecodedData {
+    messages: Vec<HistoryMessage>,
+    blobs: Vec<(BlobId, Bytes)>,
+}
+
+/// DD: Decode `SdToDd` messages and validate the enclosed messages.
+///
+/// Each payload is moved into a refcounted [`Bytes`] before decoding, so message bodies and blobs
+/// are slices of it rather than copies.
+fn decode_payloads(
+    timespan: Timespan,
+    payloads: Receiver<Vec<u8>>,
+    decoded: &SyncSender<DecodedData>,
+    complete: &AtomicBool,
+) -> Result<(), HistoryError> {
+    let mut blobs: HashMap<BlobId, Bytes> = HashMap::new();
+    for payload in payloads {
+        let message = protobuf_history::SdToDd::decode(Bytes::from(payload))?;
+        match message.content {
+            Some(protobuf_history::sd_to_dd::Content::BlobData(blob_data)) => {
+                let blob_id = <[u8; BlobId::LENGTH]>::try_from(blob_data.id.as_ref())
+                    .map(BlobId)
+                    .map_err(|_| HistoryError::InvalidMessage("Invalid blob ID".to_owned()))?;
+                let _ = blobs.insert(blob_id, blob_data.data);
+            },
+            Some(protobuf_history::sd_to_dd::Content::Data(data)) => {
+                let mut messages = Vec::with_capacity(data.messages.len());
+                for message in data.messages {
+                    let message = match HistoryMessage::try_from(message) {
+                        Ok(message) => message,
+                        Err(error) => {
+                            warn!(?error, "Discarding unparsable message");
+                            continue;
+                        },
+                    };
+                    if !timespan.contains(message.timespan_timestamp()) {
+                        return Err(HistoryError::InvalidMessage(format!(
+                            "Message {} outside of the requested timespan",
+                            message.id
+                        )));
+                    }
+                    messages.push(message);
+                }
+                let data_blobs = blobs.drain().collect();
+                if decoded
+                    .send(DecodedData {
+                        messages,
+                        blobs: data_blobs,
+                    })
+                    .is_err()
+                {
+                    return Ok(());
+                }
+                if data.remaining == 0 {
+                    complete.store(true, Ordering::Release);
+                    return Ok(());
+                }
+            },
+            Some(protobuf_history::sd_to_dd::Content::Summary(_)) => {
+                warn!("Discarding summary received after BeginTransfer");
+            },
+            None => return Err(HistoryError::InvalidMessage("Unknown SdToDd variant".to_owned())),
+        }
+    }
+    Ok(())
+}
+
+/// DD: Store the decoded messages and blobs.
+fn store_data(
+    sink: &mut dyn HistorySink,
+    decoded: Receiver<DecodedData>,
+) -> Result<TransferStats, HistoryError> {
+    let mut stats = TransferStats::default();
+    for data in decoded {
+        for message in data.messages {
+            sink.store_message(message)?;
+            stats.messages = stats.messages.saturating_add(1);
+        }
+        for (blob_id, data) in data.blobs {
+            sink.store_blob(blob_id, data)?;
+            stats.blobs = stats.blobs.saturating_add(1);
+        }
+    }
+    Ok(stats)
+}
+
+/// Import the conversation history for `timespan` on DD.
+///
+/// Chunks of incoming data (along with the PID of the path they were received on) are pulled from
+/// `receive_chunks` until the last `Data` message has been received, any stage failed or it returns
+/// [`None`] because the connection has been closed. They are decrypted by `protocol`, decoded and
+/// handed to `sink`.
+///
+/// Returns the transfer statistics once all messages and blobs have been stored. The connection
+/// may then be closed.
+///
+/// # Errors
+///
+/// Returns [`HistoryError`] if any stage failed or the connection has been closed before the
+/// transfer was complete, in which case the connection must be closed.
+pub fn import<R: FnMut() -> Result<Option<(u32, Vec<u8>)>, HistoryError>>(
+    config: PipelineConfig,
+    timespan: Timespan,
+    protocol: &mut RendezvousProtocol,
+    mut receive_chunks: R,
+    sink: &mut dyn HistorySink,
+) -> Result<TransferStats, HistoryError> {
+    debug!(?timespan, ?config, "Importing conversation history");
+    let aborted = AtomicBool::new(false);
+    let aborted = &aborted;
+    let complete = AtomicBool::new(false);
+    let complete = &complete;
+    let (payloads_tx, payloads_rx) = mpsc::sync_channel(config.queue_capacity);
+    let (decoded_tx, decoded_rx) = mpsc::sync_channel(config.queue_capacity);
+
+    thread::scope(|scope| {
+        let decoding = scope.spawn(move || {
+            run_stage(aborted, || {
+                decode_payloads(timespan, payloads_rx, &decoded_tx, complete)
+            })
+        });
+        let storing = scope.spawn(move || run_stage(aborted, || store_data(sink, decoded_rx)));
+
+        // Receive and decrypt on the calling thread
+        let receiving = run_stage(aborted, || {
+            let mut bytes: u64 = 0;
+            let mut payload = vec![];
+            while !complete.load(Ordering::Acquire) && !aborted.load(Ordering::Acquire) {
+                let Some((pid, chunk)) = receive_chunks()? else {
+                    break;
+                };
+                protocol.add_chunks(pid, &[chunk.as_slice()])?;
+                while let Some(result) = protocol.process_frame(pid)? {
+                    let Some(ulp_data) = result.incoming_ulp_data else {
+                        continue;
+                    };
+
+                    // Reassemble the payload if it has been streamed in multiple records
+                    if payload.is_empty() {
+                        payload = ulp_data;
+                    } else {
+                        payload.extend_from_slice(&ulp_data);
+                    }
+                    if result.more_incoming_ulp_data {
+                        continue;
+                    }
+                    bytes = bytes.saturating_add(payload.len() as u64);
+
+                    // Stop receiving after the last `Data` message rather than waiting for the
+                    // decoding stage to flag the transfer as complete
+                    let is_last = is_last_payload(&payload);
+                    if payloads_tx.send(mem::take(&mut payload)).is_err() || is_last {
+                        return Ok(bytes);
+                    }
+                }
+            }
+            Ok(bytes)
+        });
+        drop(payloads_tx);
+
+        let bytes = receiving?;
+        join(decoding)?;
+        let stats = join(storing)?;
+        if !complete.load(Ordering::Acquire) {
+            return Err(HistoryError::TransferIncomplete);
+        }
+        let stats = TransferStats { bytes, ..stats };
+        debug!(?stats, "Imported conversation history");
+        Ok(stats)
+    })
+}
+
+/// Access to `SdToDd` decoding for benchmarks (see `benches/`). Not part of the public API.
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub mod bench {
+    use bytes::Bytes;
+    use prost::Message as _;
+
+    use super::{encode_blob_data, encode_data};
+    use crate::{
+        common::BlobId,
+        d2d_history::HistoryMessage,
+        protobuf::{self, d2d_history as protobuf_history},
+    };
+
+    /// Encode a `Data` message with `n_messages` incoming messages, each with a body of
+    /// `body_length` bytes and a nonce.
+    #[must_use]
+    pub fn data_payload(n_messages: u64, body_length: usize) -> Vec<u8> {
+        let messages = (0..n_messages)
+            .map(|index| protobuf_history::PastMessage {
+                message: Some(protobuf_history::past_message::Message::Incoming(
+                    protobuf_history::PastIncomingMessage {
+                        message: Some(protobuf::d2d::IncomingMessage {
+                            sender_identity: "ECHOECHO".to_owned(),
+                            message_id: index,
+                            created_at: index,
+                            r#type: 0x01,
+                            body: Bytes::from(vec![0x42; body_length]),
+                            nonce: Bytes::from_static(&[0x01; 24]),
+                        }),
+                        received_at: index,
+                        read_at: None,
+                        last_reaction_at: None,
+                    },
+                )),
+            })
+            .collect();
+        encode_data(messages, 0)
+    }
+
+    /// Encode a `common.BlobData` message with a blob of `blob_length` bytes.
+    #[must_use]
+    pub fn blob_data_payload(blob_length: usize) -> Vec<u8> {
+        encode_blob_data(BlobId([0xaa; BlobId::LENGTH]), vec![0xbb; blob_length])
+    }
+
+    /// Decode `payload` from a borrowed slice, copying every bytes field out of it (i.e. like
+    /// decoding into owned `Vec<u8>` fields). Returns the amount of decoded messages and blobs.
+    #[must_use]
+    pub fn decode_copying(payload: &[u8]) -> usize {
+        decode(protobuf_history::SdToDd::decode(payload))
+    }
+
+    /// Decode `payload` like the import pipeline does, slicing every bytes field out of it.
+    /// Returns the amount of decoded messages and blobs.
+    #[must_use]
+    pub fn decode_zero_copy(payload: Vec<u8>) -> usize {
+        decode(protobuf_history::SdToDd::decode(Bytes::from(payload)))
+    }
+
+    fn decode(message: Result<protobuf_history::SdToDd, prost::DecodeError>) -> usize {
+        match message.expect("Decoding must succeed").content {
+            Some(protobuf_history::sd_to_dd::Content::Data(data)) => data
+                .messages
+                .into_iter()
+                .map(|message| HistoryMessage::try_from(message).expect("Message must be valid"))
+                .count(),
+            Some(protobuf_history::sd_to_dd::Content::BlobData(_)) => 1,
+            _ => 0,
+        }
+    }
+}
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{
+        common::{Conversation, MessageId, ThreemaId},
+        d2d_history::{HistoryMessageDirection, HistorySummary},
+        d2d_rendezvous::{AuthenticationKey, StripingPolicy},
+    };
+
+    /// Conversation history with every third message referring to a blob.
+    struct MemoryStore {
+        rows: Vec<(HistoryMessage, Vec<BlobId>)>,
+        blobs: HashMap<BlobId, Vec<u8>>,
+    }
+    impl MemoryStore {
+        fn new(n_messages: u64) -> Self {
+            let sender_identity = ThreemaId::try_from("ECHOECHO").unwrap();
+            let mut blobs = HashMap::new();
+            let rows = (0..n_messages)
+                .map(|index| {
+                    let direction = if index & 1 == 0 {
+                        HistoryMessageDirection::Incoming {
+                            sender_identity,
+                            received_at: index,
+                        }
+                    } else {
+                        HistoryMessageDirection::Outgoing {
+                            conversation: Conversation::Contact(sender_identity),
+                            sent_at: index,
+                        }
+                    };
+                    let mut blob_ids = vec![];
+                    if index.checked_rem(3) == Some(0) {
+                        let blob_id = BlobId([u8::try_from(index & 0xff).unwrap(); BlobId::LENGTH]);
+                        let _ = blobs.insert(blob_id, vec![0xaa; 1000]);
+                        blob_ids.push(blob_id);
+                    }
+                    let message = HistoryMessage {
+                        id: MessageId(index),
+                        direction,
+                        created_at: index,
+                        message_type: 0x01,
+                        body: Bytes::from(format!("Message {index}")),
+                        read_at: None,
+                    };
+                    (message, blob_ids)
+                })
+                .collect();
+            Self { rows, blobs }
+        }
+    }
+    impl HistoryStore for MemoryStore {
+        fn summary(
+            &mut self,
+            _timespan: Timespan,
+            _include_media: bool,
+        ) -> Result<HistorySummary, HistoryError> {
+            Ok(HistorySummary {
+                messages: u32::try_from(self.rows.len()).unwrap(),
+                size: 0,
+            })
+        }
+
+        fn messages(
+            &mut self,
+            timespan: Timespan,
+        ) -> Result<Box<dyn Iterator<Item = Result<HistoryRow, HistoryError>> + Send + '_>, HistoryError>
+        {
+            Ok(Box::new(
+                self.rows
+                    .iter()
+                    .filter(move |(message, _)| timespan.contains(message.timespan_timestamp()))
+                    .map(|(message, blob_ids)| {
+                        Ok(HistoryRow {
+                            message: message.clone(),
+                            blob_ids: blob_ids.clone(),
+                        })
+                    }),
+            ))
+        }
+    }
+    impl BlobStore for MemoryStore {
+        fn blob(&mut self, blob_id: &BlobId) -> Result<Option<Vec<u8>>, HistoryError> {
+            Ok(self.blobs.get(blob_id).cloned())
+        }
+    }
+
+    #[derive(Default)]
+    struct MemorySink {
+        message_ids: Vec<u64>,
+        blob_ids: Vec<BlobId>,
+        fail: bool,
+    }
+    impl HistorySink for MemorySink {
+        fn store_message(&mut self, message: HistoryMessage) -> Result<(), HistoryError> {
+            if self.fail {
+                return Err(HistoryError::StoreFailed("Full".to_owned()));
+            }
+            self.message_ids.push(message.id.0);
+            Ok(())
+        }
+
+        fn store_blob(&mut self, blob_id: BlobId, _data: Bytes) -> Result<(), HistoryError> {
+            self.blob_ids.push(blob_id);
+            Ok(())
+        }
+    }
+
+    /// Create SD (as RID) and DD (as RRD) with all of `pids` nominated, optionally with striping
+    /// enabled (required for more than one path).
+    fn connect(
+        ulp_streaming: bool,
+        striping: Option<StripingPolicy>,
+        pids: &[u32],
+    ) -> (RendezvousProtocol, RendezvousProtocol) {
+        fn process(
+            protocol: &mut RendezvousProtocol,
+            pid: u32,
+            frame: OutgoingFrame,
+        ) -> Option<OutgoingFrame> {
+            let frame = Vec::<u8>::from(frame);
+            protocol.add_chunks(pid, &[frame.as_slice()]).unwrap();
+            protocol.process_frame(pid).unwrap().unwrap().outgoing_frame
+        }
+
+        let mut sd = RendezvousProtocol::new_as_rid(false, AuthenticationKey([0x42; 32]), pids);
+        let (mut dd, initial_outgoing_frames) =
+            RendezvousProtocol::new_as_rrd(true, AuthenticationKey([0x42; 32]), pids);
+        if ulp_streaming {
+            sd.enable_ulp_streaming().unwrap();
+            dd.enable_ulp_streaming().unwrap();
+        }
+        if let Some(policy) = striping {
+            sd.enable_striping(policy).unwrap();
+            dd.enable_striping(policy).unwrap();
+        }
+        for (pid, hello) in initial_outgoing_frames {
+            let auth_hello = process(&mut sd, pid, hello).unwrap();
+            let auth = process(&mut dd, pid, auth_hello).unwrap();
+            let _ = process(&mut sd, pid, auth);
+        }
+        for pid in pids {
+            let nominate = dd.nominate_path(*pid).unwrap().outgoing_frame.unwrap();
+            let _ = process(&mut sd, *pid, nominate);
+        }
+        (sd, dd)
+    }
+
+    /// Export the history of `store` from SD into a queue of frames.
+    fn export_frames(
+        sd: &mut RendezvousProtocol,
+        store: &mut MemoryStore,
+        request: &HistoryTransferRequest,
+    ) -> (Result<TransferStats, HistoryError>, Vec<(u32, Vec<u8>)>) {
+        let mut frames = vec![];
+        let mut blob_store = MemoryStore {
+            rows: vec![],
+            blobs: mem::take(&mut store.blobs),
+        };
+        let export_result = export(
+            PipelineConfig::default(),
+            request,
+            store,
+            &mut blob_store,
+            sd,
+            |pid, frame, _flushed| {
+                frames.push((pid, Vec::<u8>::from(frame)));
+                Ok(())
+            },
+        );
+        (export_result, frames)
+    }
+
+    /// Deliver `frames` to `receive_chunks` of [`import`], concatenating up to `frames_per_chunk`
+    /// consecutive frames of the same path into a single chunk. Fails instead of reporting a closed
+    /// connection once all frames have been delivered.
+    fn deliver(
+        frames: Vec<(u32, Vec<u8>)>,
+        frames_per_chunk: usize,
+    ) -> impl FnMut() -> Result<Option<(u32, Vec<u8>)>, HistoryError> {
+        let mut frames = frames.into_iter().peekable();
+        move || {
+            let Some((pid, mut chunk)) = frames.next() else {
+                return Err(HistoryError::TransportFailed("No more frames".to_owned()));
+            };
+            for _ in 1..frames_per_chunk {
+                let Some((_, frame)) = frames.next_if(|(next_pid, _)| *next_pid == pid) else {
+                    break;
+                };
+                chunk.extend(frame);
+            }
+            Ok(Some((pid, chunk)))
+        }
+    }
+
+    /// Export the history of `store` from SD and import it on DD, delivering up to
+    /// `frames_per_chunk` frames per chunk.
+    fn transfer(
+        ulp_streaming: bool,
+        frames_per_chunk: usize,
+        store: &mut MemoryStore,
+        request: &HistoryTransferRequest,
+    ) -> (
+        Result<TransferStats, HistoryError>,
+        Result<TransferStats, HistoryError>,
+        MemorySink,
+    ) {
+        let (mut sd, mut dd) = connect(ulp_streaming, None, &[1]);
+        let (export_result, frames) = export_frames(&mut sd, store, request);
+        let mut sink = MemorySink::default();
+        let import_result = import(
+            PipelineConfig::default(),
+            request.timespan,
+            &mut dd,
+            deliver(frames, frames_per_chunk),
+            &mut sink,
+        );
+        (export_result, import_result, sink)
+    }
+
+    #[test]
+    fn transfer_history() {
+        for (ulp_streaming, frames_per_chunk) in [(false, 1), (false, 7), (true, 1), (true, 7)] {
+            let mut store = MemoryStore::new(250);
+            let request = HistoryTransferRequest {
+                timespan: Timespan { from: 0, to: 249 },
+                include_media: true,
+                messages: 250,
+            };
+            let (export_result, import_result, sink) =
+                transfer(ulp_streaming, frames_per_chunk, &mut store, &request);
+            let exported = export_result.unwrap();
+            let imported = import_result.unwrap();
+            assert_eq!(exported, imported);
+            assert_eq!(imported.messages, 250);
+            assert_eq!(imported.blobs, 84);
+            assert_eq!(sink.message_ids, (0..250).collect::<Vec<u64>>());
+            assert_eq!(sink.blob_ids.len(), 84);
+        }
+    }
+
+    #[test]
+    fn transfer_history_without_media() {
+        let mut store = MemoryStore::new(10);
+        let request = HistoryTransferRequest {
+            timespan: Timespan { from: 5, to: 9 },
+            include_media: false,
+            messages: 5,
+        };
+        let (_, import_result, sink) = transfer(false, 1, &mut store, &request);
+        assert_eq!(import_result.unwrap().blobs, 0);
+        assert_eq!(sink.message_ids, vec![5, 6, 7, 8, 9]);
+    }
+
+    #[test]
+    fn reject_messages_outside_of_timespan() {
+        let mut store = MemoryStore::new(10);
+        let request = HistoryTransferRequest {
+            timespan: Timespan { from: 0, to: 9 },
+            include_media: false,
+            messages: 10,
+        };
+        let (mut sd, mut dd) = connect(false, None, &[1]);
+        let (export_result, frames) = export_frames(&mut sd, &mut store, &request);
+        let _ = export_result.unwrap();
+        let mut frames = frames.into_iter();
+        let result = import(
+            PipelineConfig::default(),
+            Timespan { from: 0, to: 4 },
+            &mut dd,
+            || Ok(frames.next()),
+            &mut MemorySink::default(),
+        );
+        assert!(matches!(result, Err(HistoryError::InvalidMessage(_))));
+    }
+
+    #[test]
+    fn flush_striped_frames() {
+        let mut store = MemoryStore::new(50);
+        let request = HistoryTransferRequest {
+            timespan: Timespan { from: 0, to: 49 },
+            include_media: true,
+            messages: 50,
+        };
+        let (mut sd, _) = connect(
+            false,
+            Some(StripingPolicy {
+                max_in_flight_bytes: 1,
+                ..StripingPolicy::default()
+            }),
+            &[1],
+        );
+        let (export_result, _) = export_frames(&mut sd, &mut store, &request);
+        let _ = export_result.unwrap();
+
+        // All frames have been reported as flushed by dropping their handles
+        assert!(!sd.is_congested());
+        assert!(sd.ulp_frame_flushed(1).is_err());
+    }
+
+    #[test]
+    fn stripe_frames_across_paths() {
+        let mut store = MemoryStore::new(50);
+        let request = HistoryTransferRequest {
+            timespan: Timespan { from: 0, to: 49 },
+            include_media: true,
+            messages: 50,
+        };
+        let (mut sd, mut dd) = connect(
+            false,
+            Some(StripingPolicy {
+                max_in_flight_bytes: 1,
+                ..StripingPolicy::default()
+            }),
+            &[1, 2],
+        );
+        let mut blob_store = MemoryStore {
+            rows: vec![],
+            blobs: mem::take(&mut store.blobs),
+        };
+
+        // Only flush a frame once the next one has been sent, so that each frame congests its path
+        // until the following frame had to be sent on the other path
+        let mut frames = vec![];
+        let mut in_flight = None;
+        let exported = export(
+            PipelineConfig::default(),
+            &request,
+            &mut store,
+            &mut blob_store,
+            &mut sd,
+            |pid, frame, flushed| {
+                frames.push((pid, Vec::<u8>::from(frame)));
+                drop(in_flight.replace(flushed));
+                Ok(())
+            },
+        )
+        .unwrap();
+        drop(in_flight);
+        assert!(frames.len() > 2);
+        assert!(
+            frames
+                .iter()
+                .zip(frames.iter().skip(1))
+                .all(|((pid, _), (next_pid, _))| pid != next_pid)
+        );
+        assert!(frames.iter().any(|(pid, _)| *pid == 1));
+        assert!(frames.iter().any(|(pid, _)| *pid == 2));
+
+        // DD restores the original order across both paths
+        let mut sink = MemorySink::default();
+        let imported = import(
+            PipelineConfig::default(),
+            request.timespan,
+            &mut dd,
+            deliver(frames, 1),
+            &mut sink,
+        )
+        .unwrap();
+        assert_eq!(exported, imported);
+        assert_eq!(sink.message_ids, (0..50).collect::<Vec<u64>>());
+    }
+
+    #[test]
+    fn stop_receiving_when_aborted() {
+        let mut store = MemoryStore::new(250);
+        let request = HistoryTransferRequest {
+            timespan: Timespan { from: 0, to: 249 },
+            include_media: false,
+            messages: 250,
+        };
+        let (mut sd, mut dd) = connect(false, None, &[1]);
+        let (export_result, mut frames) = export_frames(&mut sd, &mut store, &request);
+        let _ = export_result.unwrap();
+
+        // Withhold the last frame and keep the connection open without delivering any more data,
+        // so that only the failing sink can end the transfer
+        let _ = frames.pop();
+        let mut frames = frames.into_iter();
+        let result = import(
+            PipelineConfig::default(),
+            request.timespan,
+            &mut dd,
+            || {
+                thread::yield_now();
+                Ok(Some(frames.next().unwrap_or((1, vec![]))))
+            },
+            &mut MemorySink {
+                fail: true,
+                ..MemorySink::default()
+            },
+        );
+        assert!(matches!(result, Err(HistoryError::StoreFailed(_))));
+    }
+
+    #[test]
+    fn fail_incomplete_transfer() {
+        let (_, mut dd) = connect(false, None, &[1]);
+        let result = import(
+            PipelineConfig::default(),
+            Timespan { from: 0, to: 9 },
+            &mut dd,
+            || Ok(None),
+            &mut MemorySink::default(),
+        );
+        assert!(matches!(result, Err(HistoryError::TransferIncomplete)));
+    }
+}
@@ -24,6 +24,10 @@ impl FrameDecoder {
     // than this, we need to add Blob chunking and stream the content.)
     pub(super) const MAX_LENGTH_AFTER_NOMINATION: usize = 100 * 1_048_576;
     pub(super) const MAX_LENGTH_BEFORE_NOMINATION: usize = 16_384;
+
+    // When streaming ULP data, frames contain a single record of at most 64 KiB, plus a small
+    // overhead for the record trailer, the stripe sequence number and the authentication tag.
+    pub(super) const MAX_LENGTH_WHEN_STREAMING: usize = 65_536 + 1024;
 }
 
 /// An outgoing frame.
@@ -1,15 +1,18 @@
 //! Implementation of the _Connection Rendezvous Protocol_.
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 
 use duplicate::duplicate_item;
 use libthreema_macros::{DebugVariantNames, VariantNames};
 use prost::Message as _;
 use rand::{self, Rng as _};
-use tracing::{debug, trace, warn};
+use tracing::{debug, info, trace, warn};
 use zeroize::{Zeroize, ZeroizeOnDrop};
 
-use self::frame::FrameDecoder;
-pub use self::frame::{IncomingFrame, OutgoingFrame};
+use self::{frame::FrameDecoder, striping::Striping, ulp_stream::RecordWriter};
+pub use self::{
+    frame::{IncomingFrame, OutgoingFrame},
+    striping::StripingPolicy,
+};
 use crate::{
     crypto::x25519,
     protobuf::d2d_rendezvous as protobuf,
@@ -20,6 +23,8 @@ mod frame;
 mod rxdak;
 mod rxdtk;
 mod rxdxk;
+mod striping;
+mod ulp_stream;
 
 /// An error occurred while running the Connection Rendezvous Protocol.
 ///
@@ -103,6 +108,18 @@ pub enum RendezvousProtocolError {
     /// Nomination is required before sending ULP data.
     #[error("Nomination is required before sending ULP data")]
     NominationRequired,
+
+    /// Incoming striped ULP data is invalid or could not be reordered.
+    #[error("Invalid striped ULP data: {0}")]
+    InvalidStripedUlpData(String),
+
+    /// ULP streaming has not been enabled or ULP frames were created outside of the stream.
+    #[error("Invalid usage of ULP streaming: {0}")]
+    InvalidUlpStreamingUsage(&'static str),
+
+    /// Incoming ULP record is invalid.
+    #[error("Invalid ULP record: {0}")]
+    InvalidUlpRecord(String),
 }
 
 /// Authentication Key (AK).
@@ -125,9 +142,78 @@ pub enum PathStateUpdate {
     Nominated {
         /// The Rendezvous Path Hash (RPH) of the nominated path.
         rph: RendezvousPathHash,
+
+        /// RTT measured during the handshake of the nominated path.
+        measured_rtt: Duration,
     },
 }
 
+/// Policy for automatically nominating the path with the lowest handshake RTT, see
+/// [`RendezvousProtocol::enable_automatic_nomination`].
+#[derive(Clone, Copy, Debug)]
+pub struct NominationPolicy {
+    /// Maximum time to wait for the handshakes of other paths to complete once the first path is
+    /// awaiting nomination.
+    pub deadline: Duration,
+}
+impl Default for NominationPolicy {
+    fn default() -> Self {
+        Self {
+            deadline: Duration::from_millis(500),
+        }
+    }
+}
+
+/// State of automatic nomination.
+struct AutomaticNomination {
+    policy: NominationPolicy,
+
+    /// When the first path started awaiting nomination.
+    first_ready_at: Option<Instant>,
+
+    /// Handshake RTT of each path awaiting nomination.
+    candidates: HashMap<u32, Duration>,
+
+    /// Paths that closed due to an error before nomination.
+    closed: HashSet<u32>,
+}
+impl AutomaticNomination {
+    /// Mark a path as closed. A closed path is no longer a candidate for nomination.
+    fn close(&mut self, pid: u32) {
+        let _ = self.candidates.remove(&pid);
+        let _ = self.closed.insert(pid);
+    }
+
+    /// Select the path to be nominated, if nomination is due.
+    fn select<'pid, I: IntoIterator<Item = &'pid u32>>(&self, racing_pids: I) -> Option<u32> {
+        let first_ready_at = self.first_ready_at?;
+
+        // Wait for all paths to complete the handshake (or close), unless the deadline passed
+        let all_completed = racing_pids
+            .into_iter()
+            .all(|pid| self.candidates.contains_key(pid) || self.closed.contains(pid));
+        if !all_completed && first_ready_at.elapsed() < self.policy.deadline {
+            return None;
+        }
+
+        // Select the path with the lowest RTT (or the lowest PID on a tie)
+        self.select_from(self.candidates.keys())
+    }
+
+    /// Select the path with the lowest RTT (or the lowest PID on a tie) of `pids` that is awaiting
+    /// nomination.
+    fn select_from<'pid, I: IntoIterator<Item = &'pid u32>>(&self, pids: I) -> Option<u32> {
+        pids.into_iter()
+            .filter_map(|pid| {
+                self.candidates
+                    .get(pid)
+                    .map(|measured_rtt| (*measured_rtt, *pid))
+            })
+            .min()
+            .map(|(_, pid)| pid)
+    }
+}
+
 /// Result returned when interacting with the protocol state machine. The result is associated to
 /// the path whose PID was used when calling a function that yielded this result.
 ///
@@ -150,10 +236,18 @@ pub enum PathStateUpdate {
 ///          [`RendezvousProtocol::create_ulp_frame`].
 ///    5. (Unreachable)
 /// 3. If the current phase is the _ULP phase_:
-///    1. If `path` is not marked as _nominated_, abort the protocol due to an error and abort these steps.
+///    1. If `path` is not marked as _nominated_:
+///       1. If striping is not enabled, abort the protocol due to an error and abort these steps.
+///       2. If `incoming_ulp_data` is present, abort the protocol due to an error and abort these steps.
+///       3. If `outgoing_frame` is present, enqueue it to be sent on `path`.
+///       4. If `state_update` is [`PathStateUpdate::AwaitingNominate`] and the protocol took the role of
+///          the nominator, run the _Automatic Nomination Steps_ if automatic nomination has been enabled.
+///       5. If `state_update` is [`PathStateUpdate::Nominated`], mark `path` as _nominated_.
+///       6. Abort these steps.
 ///    2. If `state_update` is present, abort the protocol due to an error and abort these steps.
 ///    3. If `outgoing_frame` is present, enqueue it to be sent on `path`.
-///    4. If `incoming_ulp_data` is present, hand it off to the ULP.
+///    4. If `incoming_ulp_data` is present, hand it off to the ULP. If ULP streaming has been enabled
+///       and `more_incoming_ulp_data` is set, the ULP payload continues in a subsequent result.
 /// 4. (Unreachable)
 ///
 /// [^close-race]: This prevents a race condition between RID nominating a path and path close
@@ -166,6 +260,9 @@ pub struct PathProcessResult {
     pub outgoing_frame: Option<OutgoingFrame>,
     /// An incoming frame has been reassembled and is ready to be handed off to the ULP.
     pub incoming_ulp_data: Option<Vec<u8>>,
+    /// Only when streaming ULP data: `incoming_ulp_data` is a part of a ULP payload and further
+    /// parts follow.
+    pub more_incoming_ulp_data: bool,
 }
 
 /// 16 byte random authentication challenge
@@ -185,10 +282,31 @@ struct EphemeralTransportKey(x25519::SharedSecretHSalsa20);
 struct Context {
     is_nominator: bool,
     ak: AuthenticationKey,
+    ulp_streaming: bool,
 }
 impl Context {
     fn new(is_nominator: bool, ak: AuthenticationKey) -> Self {
-        Self { is_nominator, ak }
+        Self {
+            is_nominator,
+            ak,
+            ulp_streaming: false,
+        }
+    }
+
+    /// Strip the record trailer from the incoming ULP data of `result` if ULP streaming is
+    /// enabled.
+    fn decode_ulp_record(
+        &self,
+        mut result: PathProcessResult,
+    ) -> Result<PathProcessResult, RendezvousProtocolError> {
+        if self.ulp_streaming {
+            if let Some(record) = result.incoming_ulp_data.take() {
+                let (ulp_data, more_ulp_data) = ulp_stream::decode_record(record)?;
+                result.incoming_ulp_data = Some(ulp_data);
+                result.more_incoming_ulp_data = more_ulp_data;
+            }
+        }
+        Ok(result)
     }
 }
 
@@ -213,6 +331,7 @@ enum RidPathState {
     AwaitingNominate {
         transport_keys: rxdtk::ForRid,
         rph: RendezvousPathHash,
+        measured_rtt: Duration,
     },
 
     /// The connection path was `Nominate`d and can now be used by the ULP.
@@ -232,7 +351,7 @@ impl RidPath {
     fn new(ak: &AuthenticationKey, pid: u32) -> Self {
         Self {
             pid,
-            decoder: FrameDecoder::new(vec![]),
+            decoder: FrameDecoder::new(vec![], FrameDecoder::MAX_LENGTH_BEFORE_NOMINATION),
             state: RidPathState::AwaitingHello {
                 authentication_keys: rxdak::ForRid::new(ak, pid),
             },
@@ -251,6 +370,7 @@ impl RidPath {
                 state_update: None,
                 outgoing_frame: None,
                 incoming_ulp_data: Some(incoming_ulp_data),
+                more_incoming_ulp_data: false,
             })
         } else {
             // Handle `Closed` state
@@ -279,6 +399,7 @@ impl RidPath {
                                     state_update: None,
                                     outgoing_frame: Some(outgoing_frame),
                                     incoming_ulp_data: None,
+                                    more_incoming_ulp_data: false,
                                 },
                             )
                         },
@@ -300,11 +421,16 @@ impl RidPath {
                             let (transport_keys, rph) =
                                 rxdtk::ForRid::new(&ctx.ak, authentication_keys, shared_etk);
                             (
-                                RidPathState::AwaitingNominate { transport_keys, rph },
+                                RidPathState::AwaitingNominate {
+                                    transport_keys,
+                                    rph,
+                                    measured_rtt,
+                                },
                                 PathProcessResult {
                                     state_update: Some(PathStateUpdate::AwaitingNominate { measured_rtt }),
                                     outgoing_frame: None,
                                     incoming_ulp_data: None,
+                                    more_incoming_ulp_data: false,
                                 },
                             )
                         },
@@ -314,6 +440,7 @@ impl RidPath {
                 RidPathState::AwaitingNominate {
                     mut transport_keys,
                     rph,
+                    measured_rtt,
                 } => {
                     // Check if the remote side is allowed to `Nominate`.
                     if ctx.is_nominator {
@@ -325,17 +452,19 @@ impl RidPath {
                         (
                             RidPathState::Nominated { transport_keys },
                             PathProcessResult {
-                                state_update: Some(PathStateUpdate::Nominated { rph }),
+                                state_update: Some(PathStateUpdate::Nominated { rph, measured_rtt }),
                                 outgoing_frame: None,
                                 incoming_ulp_data: None,
+                                more_incoming_ulp_data: false,
                             },
                         )
                     })
                 },
 
-                // States that must have been covered by code above
+                // States that must have been covered by code above. The path is closed if this is ever
+                // reached.
                 RidPathState::Invalid | RidPathState::Nominated { .. } | RidPathState::Closed => {
-                    unreachable!("State should have been handled")
+                    Err(RendezvousProtocolError::PathClosed(self.pid))
                 },
             }
             .map(|(state, result)| {
@@ -363,20 +492,24 @@ impl RidPath {
         if let RidPathState::AwaitingNominate {
             mut transport_keys,
             rph,
+            measured_rtt,
         } = core::mem::replace(&mut self.state, RidPathState::Invalid)
         {
             Self::create_nominate(&mut transport_keys).map(|outgoing_frame| {
                 (
                     RidPathState::Nominated { transport_keys },
                     PathProcessResult {
-                        state_update: Some(PathStateUpdate::Nominated { rph }),
+                        state_update: Some(PathStateUpdate::Nominated { rph, measured_rtt }),
                         outgoing_frame: Some(outgoing_frame),
                         incoming_ulp_data: None,
+                        more_incoming_ulp_data: false,
                     },
                 )
             })
         } else {
-            unreachable!("Expected AwaitingNominate state")
+            Err(RendezvousProtocolError::InvalidStateForNomination(
+                self.state.variant_name(),
+            ))
         }
         .map(|(state, result)| {
             self.state = state;
@@ -400,6 +533,7 @@ impl RidPath {
                     state_update: None,
                     outgoing_frame: Some(outgoing_frame),
                     incoming_ulp_data: None,
+                    more_incoming_ulp_data: false,
                 })
             },
             _ => Err(RendezvousProtocolError::NominationRequired),
@@ -535,6 +669,7 @@ enum RrdPathState {
     AwaitingNominate {
         transport_keys: rxdtk::ForRrd,
         rph: RendezvousPathHash,
+        measured_rtt: Duration,
     },
 
     /// The connection path was `Nominate`d and can now be used by the ULP.
@@ -559,7 +694,7 @@ impl RrdPath {
         // Create path
         let path = Self {
             pid,
-            decoder: FrameDecoder::new(vec![]),
+            decoder: FrameDecoder::new(vec![], FrameDecoder::MAX_LENGTH_BEFORE_NOMINATION),
             state: RrdPathState::AwaitingAuthHello {
                 authentication_keys,
                 sent_at: Instant::now(),
@@ -582,6 +717,7 @@ impl RrdPath {
                 state_update: None,
                 outgoing_frame: None,
                 incoming_ulp_data: Some(incoming_ulp_data),
+                more_incoming_ulp_data: false,
             })
         } else {
             // Handle `Closed` state
@@ -613,11 +749,16 @@ impl RrdPath {
                         let (transport_keys, rph) =
                             rxdtk::ForRrd::new(&ctx.ak, authentication_keys, shared_etk);
                         (
-                            RrdPathState::AwaitingNominate { transport_keys, rph },
+                            RrdPathState::AwaitingNominate {
+                                transport_keys,
+                                rph,
+                                measured_rtt,
+                            },
                             PathProcessResult {
                                 state_update: Some(PathStateUpdate::AwaitingNominate { measured_rtt }),
                                 outgoing_frame: Some(outgoing_frame),
                                 incoming_ulp_data: None,
+                                more_incoming_ulp_data: false,
                             },
                         )
                     })
@@ -626,6 +767,7 @@ impl RrdPath {
                 RrdPathState::AwaitingNominate {
                     mut transport_keys,
                     rph,
+                    measured_rtt,
                 } => {
                     // Check if the remote side is allowed to `Nominate`.
                     if ctx.is_nominator {
@@ -637,17 +779,19 @@ impl RrdPath {
                         (
                             RrdPathState::Nominated { transport_keys },
                             PathProcessResult {
-                                state_update: Some(PathStateUpdate::Nominated { rph }),
+                                state_update: Some(PathStateUpdate::Nominated { rph, measured_rtt }),
                                 outgoing_frame: None,
                                 incoming_ulp_data: None,
+                                more_incoming_ulp_data: false,
                             },
                         )
                     })
                 },
 
-                // States that must have been covered by code above
+                // States that must have been covered by code above. The path is closed if this is ever
+                // reached.
                 RrdPathState::Invalid | RrdPathState::Nominated { .. } | RrdPathState::Closed => {
-                    unreachable!("State should have been handled")
+                    Err(RendezvousProtocolError::PathClosed(self.pid))
                 },
             }
             .map(|(state, result)| {
@@ -675,20 +819,24 @@ impl RrdPath {
         if let RrdPathState::AwaitingNominate {
             mut transport_keys,
             rph,
+            measured_rtt,
         } = core::mem::replace(&mut self.state, RrdPathState::Invalid)
         {
             Self::create_nominate(&mut transport_keys).map(|outgoing_frame| {
                 (
                     RrdPathState::Nominated { transport_keys },
                     PathProcessResult {
-                        state_update: Some(PathStateUpdate::Nominated { rph }),
+                        state_update: Some(PathStateUpdate::Nominated { rph, measured_rtt }),
                         outgoing_frame: Some(outgoing_frame),
                         incoming_ulp_data: None,
+                        more_incoming_ulp_data: false,
                     },
                 )
             })
         } else {
-            unreachable!("Expected AwaitingNominate state")
+            Err(RendezvousProtocolError::InvalidStateForNomination(
+                self.state.variant_name(),
+            ))
         }
         .map(|(state, result)| {
             self.state = state;
@@ -712,6 +860,7 @@ impl RrdPath {
                     state_update: None,
                     outgoing_frame: Some(outgoing_frame),
                     incoming_ulp_data: None,
+                    more_incoming_ulp_data: false,
                 })
             },
             _ => Err(RendezvousProtocolError::NominationRequired),
@@ -852,23 +1001,28 @@ trait Path: Send {
 impl Path for path_type {
     #[inline]
     fn add_chunks(&mut self, chunks: &[&[u8]]) -> Result<(), RendezvousProtocolError> {
-        let length = self.decoder.add_chunks(chunks);
-
-        // Check if the frame exceeds the maximum supported length of this state
-        let max_length = if matches!(&self.state, path_state_type::Nominated { .. }) {
-            FrameDecoder::MAX_LENGTH_AFTER_NOMINATION
-        } else {
-            FrameDecoder::MAX_LENGTH_BEFORE_NOMINATION
-        };
-        if length > max_length {
-            return Err(RendezvousProtocolError::OversizedFrame(length));
-        }
+        // The decoder rejects any single frame exceeding the maximum frame length as soon as its
+        // length is known (see `process_frame`), so any number of frames may be buffered.
+        let _ = self.decoder.add_chunks(chunks);
         Ok(())
     }
 
     fn process_frame(&mut self, ctx: &Context) -> Result<Option<PathProcessResult>, RendezvousProtocolError> {
+        // Apply the maximum frame length of the current state. It is updated before every frame
+        // because the state may have changed since the data has been buffered, e.g. when a ULP
+        // frame arrived in the same chunk as `Nominate`.
+        let max_length = if !matches!(&self.state, path_state_type::Nominated { .. }) {
+            FrameDecoder::MAX_LENGTH_BEFORE_NOMINATION
+        } else if ctx.ulp_streaming {
+            FrameDecoder::MAX_LENGTH_WHEN_STREAMING
+        } else {
+            FrameDecoder::MAX_LENGTH_AFTER_NOMINATION
+        };
+        self.decoder.set_max_length(max_length);
+
         self.decoder
             .next_frame_and_then(|incoming_frame| IncomingFrame(incoming_frame.to_vec()))
+            .map_err(|error| RendezvousProtocolError::OversizedFrame(error.length))?
             .map(|incoming_frame| self.process_frame(ctx, incoming_frame))
             .transpose()
     }
@@ -892,11 +1046,20 @@ enum ProtocolState {
     /// The paths are currently racing, meaning we are in the _handshake and nomination phase_.
     RacingPaths(HashMap<u32, Box<dyn Path>>),
 
-    /// One path has been nominated, all other paths have been discarded, meaning we are in the
-    /// _ULP phase_.
+    /// One path has been nominated, all other paths have been discarded (unless striping is
+    /// enabled), meaning we are in the _ULP phase_.
     Nominated { pid: u32, path: Box<dyn Path> },
 }
 
+/// Extract the RTT from the result of nominating a path.
+fn nominated_rtt(result: &PathProcessResult) -> Duration {
+    if let Some(PathStateUpdate::Nominated { measured_rtt, .. }) = &result.state_update {
+        *measured_rtt
+    } else {
+        Duration::ZERO
+    }
+}
+
 /// Connection Rendezvous Protocol state machine.
 ///
 /// The protocol state machine can be constructed from a formerly exchanged a `RendezvousInit` and
@@ -912,13 +1075,27 @@ enum ProtocolState {
 ///   has been nominated by the nominator.
 /// - The _ULP phase_ where ULP frames can be exchanged on the nominated path.
 ///
+/// If both sides enabled striping (see [`RendezvousProtocol::enable_striping`]), the other paths are not
+/// dropped on nomination. The nominator may nominate them additionally during the _ULP phase_, after which
+/// ULP frames are spread across all nominated paths via [`RendezvousProtocol::create_striped_ulp_frame`] and
+/// handed to the ULP in their original order. Paths that have not been nominated additionally within the
+/// timeout for _disregarded_ paths should be closed. When any nominated path closes, abort the protocol.
+///
 /// The following steps are defined as the _Path Awaiting Nomination Steps_:
 ///
 /// 1. Let `path` be the associated path.
 /// 2. If the protocol did not take the role of the nominator, abort the protocol due to an error and abort
 ///    these steps.
-/// 3. If `path` is the only path, run [`RendezvousProtocol::nominate_path`] for `path` and abort these steps.
-/// 4. (Unreachable / TODO(LIB-10): As of today, only one path is expected to be used.)
+/// 3. If automatic nomination has been enabled, run the _Automatic Nomination Steps_ and abort these steps.
+/// 4. If `path` is the only path, run [`RendezvousProtocol::nominate_path`] for `path` and abort these steps.
+/// 5. (Unreachable / TODO(LIB-10): As of today, only one path is expected to be used.)
+///
+/// The following steps are defined as the _Automatic Nomination Steps_:
+///
+/// 1. Run [`RendezvousProtocol::poll_nomination`]. If it yielded a PID and a [`PathProcessResult`], handle
+///    the result for the path associated to the PID and run these steps again.
+/// 2. If [`RendezvousProtocol::nomination_timeout`] yields a timeout, (re)schedule a timer to run these steps
+///    again once it elapsed.
 ///
 /// When a path closed, run the following steps:
 ///
@@ -947,6 +1124,9 @@ enum ProtocolState {
 pub struct RendezvousProtocol {
     ctx: Context,
     state: ProtocolState,
+    nomination: Option<AutomaticNomination>,
+    striping: Option<Striping>,
+    ulp_record_writer: RecordWriter,
 }
 
 // TODO(LIB-11): Add construction of the `RendezvousInit` from the paths here.
@@ -976,6 +1156,9 @@ impl RendezvousProtocol {
         Self {
             ctx,
             state: ProtocolState::RacingPaths(racing_paths),
+            nomination: None,
+            striping: None,
+            ulp_record_writer: RecordWriter::default(),
         }
     }
 
@@ -1011,6 +1194,9 @@ impl RendezvousProtocol {
         let protocol = Self {
             ctx,
             state: ProtocolState::RacingPaths(racing_paths),
+            nomination: None,
+            striping: None,
+            ulp_record_writer: RecordWriter::default(),
         };
         (protocol, outgoing_frames)
     }
@@ -1021,6 +1207,76 @@ impl RendezvousProtocol {
         self.ctx.is_nominator
     }
 
+    /// Let the protocol select the path to be nominated by the handshake RTT measured on each path
+    /// according to `policy`, see the _Automatic Nomination Steps_.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`RendezvousProtocolError::NominateNotAllowed`] if the protocol did not take the role
+    /// of the nominator.
+    pub fn enable_automatic_nomination(&mut self, policy: NominationPolicy) -> Result<(), RendezvousProtocolError> {
+        if !self.ctx.is_nominator {
+            return Err(RendezvousProtocolError::NominateNotAllowed);
+        }
+        let _ = self.nomination.insert(AutomaticNomination {
+            policy,
+            first_ready_at: None,
+            candidates: HashMap::new(),
+            closed: HashSet::new(),
+        });
+        Ok(())
+    }
+
+    /// Time left until automatic nomination is due, if automatic nomination is enabled, at least one
+    /// path is awaiting nomination and no path has been nominated, yet.
+    #[must_use]
+    pub fn nomination_timeout(&self) -> Option<Duration> {
+        let ProtocolState::RacingPaths(..) = &self.state else {
+            return None;
+        };
+        let nomination = self.nomination.as_ref()?;
+        let first_ready_at = nomination.first_ready_at?;
+        Some(nomination.policy.deadline.saturating_sub(first_ready_at.elapsed()))
+    }
+
+    /// Nominate the path with the lowest handshake RTT once all paths completed the handshake (or
+    /// closed) or the deadline of the [`NominationPolicy`] passed since the first path started
+    /// awaiting nomination.
+    ///
+    /// If striping is enabled, the remaining paths awaiting nomination are nominated additionally
+    /// afterwards, one per call and lowest RTT first, until [`StripingPolicy::max_paths`] is
+    /// reached.
+    ///
+    /// Returns the PID of the nominated path and the associated result, if a path has been
+    /// nominated.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`RendezvousProtocolError`] if nominating the selected path failed, see
+    /// [`RendezvousProtocol::nominate_path`].
+    #[tracing::instrument(skip(self))]
+    pub fn poll_nomination(&mut self) -> Result<Option<(u32, PathProcessResult)>, RendezvousProtocolError> {
+        let Some(nomination) = &self.nomination else {
+            return Ok(None);
+        };
+        let pid = match (&self.state, &self.striping) {
+            (ProtocolState::RacingPaths(racing_paths), _) => nomination.select(racing_paths.keys()),
+            (ProtocolState::Nominated { .. }, Some(striping)) if striping.has_capacity() => {
+                nomination.select_from(striping.standby.keys())
+            },
+            (ProtocolState::Nominated { .. }, _) => None,
+        };
+        let Some(pid) = pid else {
+            return Ok(None);
+        };
+        info!(
+            pid,
+            candidates = ?nomination.candidates,
+            "Automatically nominating path with the lowest RTT"
+        );
+        self.nominate_path(pid).map(|result| Some((pid, result)))
+    }
+
     /// Return the nominated path's PID, if available.
     #[must_use]
     pub const fn nominated_path(&self) -> Option<u32> {
@@ -1038,9 +1294,9 @@ impl RendezvousProtocol {
     ///
     /// Returns [`RendezvousProtocolError::UnknownOrDroppedPath`] if the path associated to `pid`
     /// could not be found.
-    #[tracing::instrument(skip(self, chunks))]
+    #[tracing::instrument(level = "trace", skip(self, chunks))]
     pub fn add_chunks(&mut self, pid: u32, chunks: &[&[u8]]) -> Result<(), RendezvousProtocolError> {
-        let path = Self::lookup_path(&mut self.state, pid)?;
+        let path = Self::lookup_path(&mut self.state, self.striping.as_mut(), pid)?;
         path.add_chunks(chunks)
     }
 
@@ -1052,30 +1308,96 @@ impl RendezvousProtocol {
     /// to `pid` could not be found, an incoming frame could not be decoded or decrypted, or an
     /// unexpected message was received, or, as a response to it, another outgoing frame could not
     /// be encrypted.
-    #[tracing::instrument(skip(self))]
+    #[tracing::instrument(level = "trace", skip(self))]
     pub fn process_frame(&mut self, pid: u32) -> Result<Option<PathProcessResult>, RendezvousProtocolError> {
-        let path = Self::lookup_path(&mut self.state, pid)?;
+        // Hand out striped ULP data that is in order by now before decoding any further frame
+        if let (ProtocolState::Nominated { pid: nominated_pid, .. }, Some(striping)) =
+            (&self.state, self.striping.as_mut())
+        {
+            if pid == *nominated_pid || striping.paths.contains_key(&pid) {
+                if let Some(incoming_ulp_data) = striping.next_ulp_data()? {
+                    return self
+                        .ctx
+                        .decode_ulp_record(PathProcessResult {
+                            state_update: None,
+                            outgoing_frame: None,
+                            incoming_ulp_data: Some(incoming_ulp_data),
+                            more_incoming_ulp_data: false,
+                        })
+                        .map(Some);
+                }
+            }
+        }
+
+        let path = Self::lookup_path(&mut self.state, self.striping.as_mut(), pid)?;
 
         // Decode and process the next frame, if any can be decoded
-        let result = path.process_frame(&self.ctx)?;
+        let result = path.process_frame(&self.ctx).inspect_err(|_| {
+            if let Some(nomination) = self.nomination.as_mut() {
+                nomination.close(pid);
+            }
+        })?;
         trace!(?result, "Processed frame");
-        let Some(result) = result else {
+        let Some(mut result) = result else {
             return Ok(result);
         };
 
-        // Update state if the path was nominated and we are still racing paths
-        if let (ProtocolState::RacingPaths(racing_paths), Some(PathStateUpdate::Nominated { .. })) =
-            (&mut self.state, &result.state_update)
+        // Restore the original order of striped ULP data
+        if let Some(striping) = self.striping.as_mut() {
+            if let Some(striped_ulp_data) = result.incoming_ulp_data.take() {
+                striping.decode(striped_ulp_data)?;
+                result.incoming_ulp_data = striping.next_ulp_data()?;
+            }
+        }
+
+        // Strip the record trailer when streaming ULP data
+        let result = self.ctx.decode_ulp_record(result)?;
+
+        // Record the path as a candidate for automatic nomination
+        if let (Some(nomination), Some(PathStateUpdate::AwaitingNominate { measured_rtt })) =
+            (self.nomination.as_mut(), &result.state_update)
         {
-            // Nominate the path
-            let path = racing_paths
-                .remove(&pid)
-                .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?;
-            debug!(
-                dropped_pids = ?racing_paths.keys(),
-                "Remote nominated, dropping all other paths"
-            );
-            self.state = ProtocolState::Nominated { pid, path };
+            let _ = nomination.first_ready_at.get_or_insert_with(Instant::now);
+            let _ = nomination.candidates.insert(pid, *measured_rtt);
+        }
+
+        // Update state if the path was nominated
+        if let Some(PathStateUpdate::Nominated { measured_rtt, .. }) = &result.state_update {
+            match (&mut self.state, self.striping.as_mut()) {
+                (ProtocolState::RacingPaths(racing_paths), striping) => {
+                    // Nominate the path
+                    let path = racing_paths
+                        .remove(&pid)
+                        .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?;
+                    if let Some(striping) = striping {
+                        debug!(
+                            standby_pids = ?racing_paths.keys(),
+                            "Remote nominated, keeping all other paths for striping"
+                        );
+                        striping.standby.extend(racing_paths.drain());
+                        striping.add_nominated(pid, *measured_rtt);
+                    } else {
+                        debug!(
+                            dropped_pids = ?racing_paths.keys(),
+                            "Remote nominated, dropping all other paths"
+                        );
+                    }
+                    self.state = ProtocolState::Nominated { pid, path };
+                },
+
+                (ProtocolState::Nominated { .. }, Some(striping)) => {
+                    // Remote nominated an additional path for striping
+                    let path = striping
+                        .standby
+                        .remove(&pid)
+                        .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?;
+                    debug!("Remote nominated an additional path for striping");
+                    let _ = striping.paths.insert(pid, path);
+                    striping.add_nominated(pid, *measured_rtt);
+                },
+
+                (ProtocolState::Nominated { .. }, None) => {},
+            }
         }
 
         // Return the result
@@ -1104,41 +1426,259 @@ impl RendezvousProtocol {
                     .remove(&pid)
                     .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?;
                 let result = path.nominate()?;
-                debug!(
-                    dropped_pids = ?racing_paths.keys(),
-                    "Local nominated, dropping all other paths"
-                );
+                if let Some(striping) = self.striping.as_mut() {
+                    debug!(
+                        standby_pids = ?racing_paths.keys(),
+                        "Local nominated, keeping all other paths for striping"
+                    );
+                    striping.standby.extend(racing_paths.drain());
+                    striping.add_nominated(pid, nominated_rtt(&result));
+                } else {
+                    debug!(
+                        dropped_pids = ?racing_paths.keys(),
+                        "Local nominated, dropping all other paths"
+                    );
+                }
                 self.state = ProtocolState::Nominated { pid, path };
                 Ok(result)
             },
 
-            ProtocolState::Nominated { pid, .. } => {
-                // Nomination already happened
-                Err(RendezvousProtocolError::NominationAlreadyDone(*pid))
+            ProtocolState::Nominated { pid: nominated_pid, .. } => {
+                // Nomination already happened, unless an additional path can be nominated for
+                // striping
+                let Some(striping) = self.striping.as_mut().filter(|striping| striping.has_capacity())
+                else {
+                    return Err(RendezvousProtocolError::NominationAlreadyDone(*nominated_pid));
+                };
+
+                // Attempt to nominate the additional path
+                let mut path = striping
+                    .standby
+                    .remove(&pid)
+                    .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?;
+                let result = path.nominate()?;
+                debug!("Local nominated an additional path for striping");
+                let _ = striping.paths.insert(pid, path);
+                striping.add_nominated(pid, nominated_rtt(&result));
+                Ok(result)
             },
         }
     }
 
     /// Create a ULP frame to be encrypted and sent as an outgoing frame on the nominated path.
     ///
+    /// Note: If striping is enabled, the frame is always created for the first nominated path. Use
+    /// [`RendezvousProtocol::create_striped_ulp_frame`] to spread ULP frames across all nominated
+    /// paths.
+    ///
     /// # Errors
     ///
-    /// Returns [`RendezvousProtocolError`] if nomination of a path is still pending or the ULP
-    /// frame could not be encrypted or encoded.
+    /// Returns [`RendezvousProtocolError`] if nomination of a path is still pending, ULP streaming
+    /// has been enabled or the ULP frame could not be encrypted or encoded.
     pub fn create_ulp_frame(
         &mut self,
         outgoing_data: Vec<u8>,
     ) -> Result<PathProcessResult, RendezvousProtocolError> {
-        match &mut self.state {
-            ProtocolState::RacingPaths(..) => Err(RendezvousProtocolError::NominationRequired),
-            ProtocolState::Nominated { path, .. } => path.create_ulp_frame(outgoing_data),
+        if self.ctx.ulp_streaming {
+            return Err(RendezvousProtocolError::InvalidUlpStreamingUsage(
+                "ULP data must be written to the stream",
+            ));
+        }
+        match (&mut self.state, self.striping.as_mut()) {
+            (ProtocolState::RacingPaths(..), _) => Err(RendezvousProtocolError::NominationRequired),
+            (ProtocolState::Nominated { path, .. }, None) => path.create_ulp_frame(outgoing_data),
+            (ProtocolState::Nominated { pid, path }, Some(striping)) => {
+                let result = path.create_ulp_frame(striping.encode(&outgoing_data)?)?;
+                if let Some(outgoing_frame) = &result.outgoing_frame {
+                    striping.enqueue(*pid, outgoing_frame.0.len());
+                }
+                Ok(result)
+            },
+        }
+    }
+
+    /// Let the nominator nominate additional paths after the first nomination and spread ULP frames
+    /// across all nominated paths according to `policy`.
+    ///
+    /// IMPORTANT: Both sides must enable striping before nomination, since striping changes the
+    /// encoding of ULP frames. Agreeing on it is up to the caller.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`RendezvousProtocolError::NominationAlreadyDone`] if a path has already been
+    /// nominated.
+    pub fn enable_striping(&mut self, policy: StripingPolicy) -> Result<(), RendezvousProtocolError> {
+        if let ProtocolState::Nominated { pid, .. } = &self.state {
+            return Err(RendezvousProtocolError::NominationAlreadyDone(*pid));
+        }
+        let _ = self.striping.insert(Striping::new(policy));
+        Ok(())
+    }
+
+    /// Return the PIDs of all nominated paths (i.e. including paths nominated additionally for
+    /// striping).
+    #[must_use]
+    pub fn nominated_paths(&self) -> Vec<u32> {
+        let ProtocolState::Nominated { pid, .. } = &self.state else {
+            return vec![];
+        };
+        let mut pids = vec![*pid];
+        if let Some(striping) = &self.striping {
+            pids.extend(striping.paths.keys());
         }
+        pids
     }
 
-    fn lookup_path(
-        state: &mut ProtocolState,
+    /// Create a ULP frame to be encrypted and sent as an outgoing frame on the nominated path with
+    /// the lowest expected cost, considering its RTT and the amount of bytes in flight.
+    ///
+    /// Returns the PID of the path the outgoing frame must be sent on and the associated result.
+    /// Once the transport flushed the outgoing frame, [`RendezvousProtocol::ulp_frame_flushed`]
+    /// must be called for the path. If striping is not enabled, this is equivalent to
+    /// [`RendezvousProtocol::create_ulp_frame`].
+    ///
+    /// # Errors
+    ///
+    /// Returns [`RendezvousProtocolError`] if nomination of a path is still pending, ULP streaming
+    /// has been enabled or the ULP frame could not be encrypted or encoded.
+    pub fn create_striped_ulp_frame(
+        &mut self,
+        outgoing_data: Vec<u8>,
+    ) -> Result<(u32, PathProcessResult), RendezvousProtocolError> {
+        if self.ctx.ulp_streaming {
+            return Err(RendezvousProtocolError::InvalidUlpStreamingUsage(
+                "ULP data must be written to the stream",
+            ));
+        }
+        self.create_ulp_frame_on_selected_path(outgoing_data)
+    }
+
+    /// Split ULP payloads into records of at most 64 KiB and send each record as a separate ULP
+    /// frame, so that neither side needs to buffer more than a single record regardless of the
+    /// size of a ULP payload.
+    ///
+    /// Once enabled, ULP data must be sent via [`RendezvousProtocol::write_ulp_stream`] and
+    /// incoming ULP data is handed out record by record (see `more_incoming_ulp_data` of
+    /// [`PathProcessResult`]).
+    ///
+    /// IMPORTANT: Both sides must enable ULP streaming before nomination, since it changes the
+    /// encoding of ULP frames. Agreeing on it is up to the caller.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`RendezvousProtocolError::NominationAlreadyDone`] if a path has already been
+    /// nominated.
+    pub fn enable_ulp_streaming(&mut self) -> Result<(), RendezvousProtocolError> {
+        if let ProtocolState::Nominated { pid, .. } = &self.state {
+            return Err(RendezvousProtocolError::NominationAlreadyDone(*pid));
+        }
+        self.ctx.ulp_streaming = true;
+        Ok(())
+    }
+
+    /// Return whether ULP streaming has been enabled.
+    #[must_use]
+    pub const fn is_ulp_streaming(&self) -> bool {
+        self.ctx.ulp_streaming
+    }
+
+    /// Append `outgoing_data` to the current outgoing ULP payload. If `end_of_payload` is set,
+    /// the ULP payload is complete and the next call starts a new one.
+    ///
+    /// Returns the outgoing frames of all records that are complete, each with the PID of the path
+    /// it must be sent on (see [`RendezvousProtocol::create_striped_ulp_frame`]). Up to one record
+    /// is kept back until more data is written or the ULP payload ends.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`RendezvousProtocolError`] if ULP streaming has not been enabled, nomination of a
+    /// path is still pending or a ULP frame could not be encrypted or encoded.
+    pub fn write_ulp_stream(
+        &mut self,
+        outgoing_data: &[u8],
+        end_of_payload: bool,
+    ) -> Result<Vec<(u32, PathProcessResult)>, RendezvousProtocolError> {
+        if !self.ctx.ulp_streaming {
+            return Err(RendezvousProtocolError::InvalidUlpStreamingUsage(
+                "ULP streaming is not enabled",
+            ));
+        }
+        if let ProtocolState::RacingPaths(..) = &self.state {
+            return Err(RendezvousProtocolError::NominationRequired);
+        }
+        self.ulp_record_writer
+            .write(outgoing_data, end_of_payload)
+            .into_iter()
+            .map(|record| self.create_ulp_frame_on_selected_path(record))
+            .collect()
+    }
+
+    fn create_ulp_frame_on_selected_path(
+        &mut self,
+        outgoing_data: Vec<u8>,
+    ) -> Result<(u32, PathProcessResult), RendezvousProtocolError> {
+        let ProtocolState::Nominated {
+            pid: nominated_pid,
+            path: nominated_path,
+        } = &mut self.state
+        else {
+            return Err(RendezvousProtocolError::NominationRequired);
+        };
+        let Some(striping) = self.striping.as_mut() else {
+            return nominated_path
+                .create_ulp_frame(outgoing_data)
+                .map(|result| (*nominated_pid, result));
+        };
+
+        // Select the path and create the frame
+        let pid = striping.select(outgoing_data.len()).unwrap_or(*nominated_pid);
+        let striped_ulp_data = striping.encode(&outgoing_data)?;
+        let path = if pid == *nominated_pid {
+            nominated_path
+        } else {
+            striping
+                .paths
+                .get_mut(&pid)
+                .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?
+        };
+        let result = path.create_ulp_frame(striped_ulp_data)?;
+        if let Some(outgoing_frame) = &result.outgoing_frame {
+            striping.enqueue(pid, outgoing_frame.0.len());
+        }
+        Ok((pid, result))
+    }
+
+    /// Report that the transport of the path associated to `pid` flushed the oldest outgoing ULP
+    /// frame created for it. This is used to detect congested paths when striping.
+    ///
+    /// Does nothing if striping is not enabled.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`RendezvousProtocolError`] if the path associated to `pid` is not nominated or no
+    /// outgoing ULP frame is in flight on it.
+    pub fn ulp_frame_flushed(&mut self, pid: u32) -> Result<(), RendezvousProtocolError> {
+        match self.striping.as_mut() {
+            Some(striping) => striping.flushed(pid),
+            None => Ok(()),
+        }
+    }
+
+    /// Return whether all nominated paths are congested, i.e. whether the ULP should pause
+    /// creating striped ULP frames until [`RendezvousProtocol::ulp_frame_flushed`] has been called.
+    ///
+    /// Always `false` if striping is not enabled.
+    #[must_use]
+    pub fn is_congested(&self) -> bool {
+        matches!(&self.state, ProtocolState::Nominated { .. })
+            && self.striping.as_ref().is_some_and(Striping::is_congested)
+    }
+
+    fn lookup_path<'state>(
+        state: &'state mut ProtocolState,
+        striping: Option<&'state mut Striping>,
         pid: u32,
-    ) -> Result<&mut Box<dyn Path>, RendezvousProtocolError> {
+    ) -> Result<&'state mut Box<dyn Path>, RendezvousProtocolError> {
         // Lookup path based on the current state.
         let path = match state {
             // The nomination race is still ongoing. Lookup the path by its PID.
@@ -1146,17 +1686,407 @@ impl RendezvousProtocol {
                 .get_mut(&pid)
                 .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?,
 
-            // There's only one nominated path. Ensure it's the correct one.
+            // There's only one nominated path, unless striping is enabled. Ensure it's the correct one.
             ProtocolState::Nominated {
                 pid: nominated_pid,
                 path,
             } => {
-                if pid != *nominated_pid {
-                    return Err(RendezvousProtocolError::UnknownOrDroppedPath(pid));
+                if pid == *nominated_pid {
+                    path
+                } else {
+                    // Lookup an additionally nominated path or one that may still be nominated
+                    striping
+                        .and_then(|striping| {
+                            if striping.paths.contains_key(&pid) {
+                                striping.paths.get_mut(&pid)
+                            } else {
+                                striping.standby.get_mut(&pid)
+                            }
+                        })
+                        .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?
                 }
-                path
             },
         };
         Ok(path)
     }
 }
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use std::thread;
+
+    use super::*;
+
+    const AK: AuthenticationKey = AuthenticationKey([0x42; 32]);
+
+    fn process(protocol: &mut RendezvousProtocol, pid: u32, frame: OutgoingFrame) -> PathProcessResult {
+        let frame = Vec::<u8>::from(frame);
+        protocol.add_chunks(pid, &[frame.as_slice()]).unwrap();
+        protocol.process_frame(pid).unwrap().unwrap()
+    }
+
+    /// Run the handshake of path `pid` between RID and RRD, delaying the response to
+    /// `RidToRrd.AuthHello` by `latency`. Returns the RTT measured by RID.
+    fn handshake(
+        rid: &mut RendezvousProtocol,
+        rrd: &mut RendezvousProtocol,
+        pid: u32,
+        hello: OutgoingFrame,
+        latency: Duration,
+    ) -> Result<Duration, RendezvousProtocolError> {
+        let auth_hello = process(rid, pid, hello).outgoing_frame.unwrap();
+        thread::sleep(latency);
+        let auth = process(rrd, pid, auth_hello).outgoing_frame.unwrap();
+        match process(rid, pid, auth).state_update {
+            Some(PathStateUpdate::AwaitingNominate { measured_rtt }) => Ok(measured_rtt),
+            _ => Err(RendezvousProtocolError::UnexpectedFrame),
+        }
+    }
+
+    /// Create RID (nominator, with automatic nomination) and RRD. Returns both and RRD's initial
+    /// `RrdToRid.Hello` frames.
+    fn protocols(
+        pids: &[u32],
+        policy: NominationPolicy,
+    ) -> (RendezvousProtocol, RendezvousProtocol, Vec<OutgoingFrame>) {
+        let mut rid = RendezvousProtocol::new_as_rid(true, AK, pids);
+        rid.enable_automatic_nomination(policy).unwrap();
+        let (rrd, initial_outgoing_frames) = RendezvousProtocol::new_as_rrd(false, AK, pids);
+        let hellos = initial_outgoing_frames
+            .into_iter()
+            .map(|(_, frame)| frame)
+            .collect();
+        (rid, rrd, hellos)
+    }
+
+    #[test]
+    fn nominate_path_with_lowest_rtt() {
+        let (mut rid, mut rrd, hellos) = protocols(
+            &[1, 2, 3],
+            NominationPolicy {
+                deadline: Duration::from_secs(60),
+            },
+        );
+        assert!(rid.poll_nomination().unwrap().is_none());
+        assert!(rid.nomination_timeout().is_none());
+
+        // Complete the handshakes with simulated latencies, path 2 being the fastest
+        for ((pid, hello), latency_ms) in [1, 2, 3].into_iter().zip(hellos).zip([40, 5, 20]) {
+            let measured_rtt =
+                handshake(&mut rid, &mut rrd, pid, hello, Duration::from_millis(latency_ms)).unwrap();
+            assert!(measured_rtt >= Duration::from_millis(latency_ms));
+
+            // Nomination must wait for the remaining paths
+            if pid != 3 {
+                assert!(rid.poll_nomination().unwrap().is_none());
+                assert!(rid.nomination_timeout().is_some());
+            }
+        }
+
+        // All paths completed, so the fastest path must be nominated
+        let (pid, result) = rid.poll_nomination().unwrap().unwrap();
+        assert_eq!(pid, 2);
+        assert_eq!(rid.nominated_path(), Some(2));
+        assert!(rid.nomination_timeout().is_none());
+        assert!(matches!(
+            result.state_update,
+            Some(PathStateUpdate::Nominated { measured_rtt, .. }) if measured_rtt >= Duration::from_millis(5)
+        ));
+
+        // RRD must follow the nomination
+        let result = process(&mut rrd, 2, result.outgoing_frame.unwrap());
+        assert!(matches!(result.state_update, Some(PathStateUpdate::Nominated { .. })));
+        assert_eq!(rrd.nominated_path(), Some(2));
+    }
+
+    #[test]
+    fn nominate_after_deadline() {
+        let deadline = Duration::from_millis(20);
+        let (mut rid, mut rrd, mut hellos) = protocols(&[1, 2], NominationPolicy { deadline });
+        let _ = hellos.pop();
+
+        // Only path 1 completes the handshake, path 2 stalls
+        handshake(&mut rid, &mut rrd, 1, hellos.pop().unwrap(), Duration::ZERO).unwrap();
+        assert!(rid.poll_nomination().unwrap().is_none());
+        assert!(rid.nomination_timeout().unwrap() <= deadline);
+
+        // Once the deadline passed, the completed path must be nominated
+        thread::sleep(deadline);
+        assert_eq!(rid.nomination_timeout(), Some(Duration::ZERO));
+        let (pid, _) = rid.poll_nomination().unwrap().unwrap();
+        assert_eq!(pid, 1);
+    }
+
+    #[test]
+    fn nominate_without_waiting_for_closed_paths() {
+        let (mut rid, mut rrd, mut hellos) = protocols(
+            &[1, 2],
+            NominationPolicy {
+                deadline: Duration::from_secs(60),
+            },
+        );
+        let _ = hellos.pop();
+        handshake(&mut rid, &mut rrd, 1, hellos.pop().unwrap(), Duration::ZERO).unwrap();
+        assert!(rid.poll_nomination().unwrap().is_none());
+
+        // Path 2 closes due to an invalid frame, so path 1 can be nominated immediately
+        let invalid_frame = [0x04, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff];
+        rid.add_chunks(2, &[invalid_frame.as_slice()]).unwrap();
+        assert!(rid.process_frame(2).is_err());
+        let (pid, _) = rid.poll_nomination().unwrap().unwrap();
+        assert_eq!(pid, 1);
+    }
+
+    #[test]
+    fn never_nominate_failed_candidate() {
+        let (mut rid, mut rrd, mut hellos) = protocols(
+            &[1, 2],
+            NominationPolicy {
+                deadline: Duration::from_secs(60),
+            },
+        );
+        let hello_2 = hellos.pop().unwrap();
+        handshake(&mut rid, &mut rrd, 1, hellos.pop().unwrap(), Duration::ZERO).unwrap();
+        assert!(rid.poll_nomination().unwrap().is_none());
+
+        // Path 1 has the lowest RTT but closes due to an invalid frame while awaiting nomination
+        let invalid_frame = [0x04, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff];
+        rid.add_chunks(1, &[invalid_frame.as_slice()]).unwrap();
+        assert!(rid.process_frame(1).is_err());
+        assert!(rid.poll_nomination().unwrap().is_none());
+
+        // Path 2 completes the handshake with a higher RTT and must be nominated instead
+        handshake(&mut rid, &mut rrd, 2, hello_2, Duration::from_millis(20)).unwrap();
+        let (pid, _) = rid.poll_nomination().unwrap().unwrap();
+        assert_eq!(pid, 2);
+    }
+
+    #[test]
+    fn accept_large_ulp_frame_in_same_chunk_as_nominate() {
+        let mut rid = RendezvousProtocol::new_as_rid(true, AK, &[1]);
+        let (mut rrd, initial_outgoing_frames) = RendezvousProtocol::new_as_rrd(false, AK, &[1]);
+        for (pid, hello) in initial_outgoing_frames {
+            handshake(&mut rid, &mut rrd, pid, hello, Duration::ZERO).unwrap();
+        }
+
+        // `Nominate` directly followed by a ULP frame exceeding the maximum length before nomination
+        let payload = vec![0x42_u8; FrameDecoder::MAX_LENGTH_BEFORE_NOMINATION * 4];
+        let mut chunk = Vec::<u8>::from(rid.nominate_path(1).unwrap().outgoing_frame.unwrap());
+        chunk.extend(Vec::<u8>::from(
+            rid.create_ulp_frame(payload.clone()).unwrap().outgoing_frame.unwrap(),
+        ));
+        rrd.add_chunks(1, &[chunk.as_slice()]).unwrap();
+        let result = rrd.process_frame(1).unwrap().unwrap();
+        assert!(matches!(result.state_update, Some(PathStateUpdate::Nominated { .. })));
+        let result = rrd.process_frame(1).unwrap().unwrap();
+        assert_eq!(result.incoming_ulp_data, Some(payload));
+        assert!(rrd.process_frame(1).unwrap().is_none());
+    }
+
+    /// Create RID (nominator) and RRD with striping enabled and complete the handshakes of all
+    /// `pids`.
+    fn striping_protocols(pids: &[u32], policy: StripingPolicy) -> (RendezvousProtocol, RendezvousProtocol) {
+        let mut rid = RendezvousProtocol::new_as_rid(true, AK, pids);
+        rid.enable_striping(policy).unwrap();
+        let (mut rrd, initial_outgoing_frames) = RendezvousProtocol::new_as_rrd(false, AK, pids);
+        rrd.enable_striping(policy).unwrap();
+        for (pid, hello) in initial_outgoing_frames {
+            handshake(&mut rid, &mut rrd, pid, hello, Duration::ZERO).unwrap();
+        }
+        (rid, rrd)
+    }
+
+    /// Create RID (nominator) and RRD with striping enabled and nominate all of `pids`.
+    fn striped_protocols(pids: &[u32], policy: StripingPolicy) -> (RendezvousProtocol, RendezvousProtocol) {
+        let (mut rid, mut rrd) = striping_protocols(pids, policy);
+        for pid in pids {
+            let nominate = rid.nominate_path(*pid).unwrap().outgoing_frame.unwrap();
+            let result = process(&mut rrd, *pid, nominate);
+            assert!(matches!(result.state_update, Some(PathStateUpdate::Nominated { .. })));
+        }
+        (rid, rrd)
+    }
+
+    #[test]
+    fn stripe_ulp_frames_across_paths() {
+        let (mut rid, mut rrd) = striped_protocols(&[1, 2], StripingPolicy::default());
+        let mut nominated_pids = rrd.nominated_paths();
+        nominated_pids.sort_unstable();
+        assert_eq!(nominated_pids, vec![1, 2]);
+
+        // Deliver striped frames in reverse order, RRD must restore the original order
+        let frames: Vec<(u32, OutgoingFrame)> = (0_u8..8)
+            .map(|index| {
+                let (pid, result) = rid.create_striped_ulp_frame(vec![index; 100]).unwrap();
+                (pid, result.outgoing_frame.unwrap())
+            })
+            .collect();
+        let mut received = vec![];
+        for (pid, frame) in frames.into_iter().rev() {
+            let frame = Vec::<u8>::from(frame);
+            rrd.add_chunks(pid, &[frame.as_slice()]).unwrap();
+            while let Some(result) = rrd.process_frame(pid).unwrap() {
+                received.extend(result.incoming_ulp_data);
+            }
+        }
+        assert_eq!(received, (0_u8..8).map(|index| vec![index; 100]).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn stripe_around_congested_paths() {
+        let (mut rid, _) = striped_protocols(
+            &[1, 2],
+            StripingPolicy {
+                max_in_flight_bytes: 1,
+                ..StripingPolicy::default()
+            },
+        );
+
+        // Each frame congests its path
+        let (first_pid, _) = rid.create_striped_ulp_frame(vec![0; 10]).unwrap();
+        assert!(!rid.is_congested());
+        let (second_pid, _) = rid.create_striped_ulp_frame(vec![1; 10]).unwrap();
+        assert_ne!(first_pid, second_pid);
+        assert!(rid.is_congested());
+
+        // Flushing the frame relieves the path
+        rid.ulp_frame_flushed(second_pid).unwrap();
+        assert!(!rid.is_congested());
+        let (third_pid, _) = rid.create_striped_ulp_frame(vec![2; 10]).unwrap();
+        assert_eq!(third_pid, second_pid);
+        rid.ulp_frame_flushed(second_pid).unwrap();
+        assert!(rid.ulp_frame_flushed(second_pid).is_err());
+    }
+
+    #[test]
+    fn limit_striped_paths() {
+        let (mut rid, _) = striping_protocols(
+            &[1, 2],
+            StripingPolicy {
+                max_paths: 1,
+                ..StripingPolicy::default()
+            },
+        );
+        let _ = rid.nominate_path(1).unwrap();
+        assert!(matches!(
+            rid.nominate_path(2),
+            Err(RendezvousProtocolError::NominationAlreadyDone(1))
+        ));
+        assert_eq!(rid.nominated_paths(), vec![1]);
+    }
+
+    /// Create RID (nominator) and RRD, enable ULP streaming on RRD and, if `rid_streaming`, on RID
+    /// and nominate path `1`.
+    fn streaming_protocols(rid_streaming: bool) -> (RendezvousProtocol, RendezvousProtocol) {
+        let mut rid = RendezvousProtocol::new_as_rid(true, AK, &[1]);
+        if rid_streaming {
+            rid.enable_ulp_streaming().unwrap();
+        }
+        let (mut rrd, initial_outgoing_frames) = RendezvousProtocol::new_as_rrd(false, AK, &[1]);
+        rrd.enable_ulp_streaming().unwrap();
+        for (pid, hello) in initial_outgoing_frames {
+            handshake(&mut rid, &mut rrd, pid, hello, Duration::ZERO).unwrap();
+        }
+        let nominate = rid.nominate_path(1).unwrap().outgoing_frame.unwrap();
+        let _ = process(&mut rrd, 1, nominate);
+        (rid, rrd)
+    }
+
+    #[test]
+    fn stream_ulp_payloads_in_records() {
+        let (mut rid, mut rrd) = streaming_protocols(true);
+        assert!(matches!(
+            rid.create_ulp_frame(vec![0; 10]),
+            Err(RendezvousProtocolError::InvalidUlpStreamingUsage(_))
+        ));
+        assert!(matches!(
+            rid.enable_ulp_streaming(),
+            Err(RendezvousProtocolError::NominationAlreadyDone(1))
+        ));
+
+        // Write a ULP payload spanning 3 records in chunks
+        let payload: Vec<u8> = (0_u8..=u8::MAX).cycle().take(150_000).collect();
+        let mut frames = vec![];
+        for chunk in payload.chunks(50_000) {
+            frames.extend(rid.write_ulp_stream(chunk, false).unwrap());
+        }
+        frames.extend(rid.write_ulp_stream(&[], true).unwrap());
+        assert_eq!(frames.len(), 3);
+
+        // RRD hands out the ULP payload record by record
+        let mut received = vec![];
+        let mut more_flags = vec![];
+        for (pid, result) in frames {
+            let result = process(&mut rrd, pid, result.outgoing_frame.unwrap());
+            more_flags.push(result.more_incoming_ulp_data);
+            received.extend(result.incoming_ulp_data.unwrap());
+        }
+        assert_eq!(more_flags, vec![true, true, false]);
+        assert_eq!(received, payload);
+    }
+
+    #[test]
+    fn reject_oversized_frames_when_streaming() {
+        let (mut rid, mut rrd) = streaming_protocols(false);
+        assert!(matches!(
+            rid.write_ulp_stream(&[0; 10], true),
+            Err(RendezvousProtocolError::InvalidUlpStreamingUsage(_))
+        ));
+        let frame = Vec::<u8>::from(rid.create_ulp_frame(vec![0; 100_000]).unwrap().outgoing_frame.unwrap());
+        rrd.add_chunks(1, &[frame.as_slice()]).unwrap();
+        assert!(matches!(
+            rrd.process_frame(1),
+            Err(RendezvousProtocolError::OversizedFrame(_))
+        ));
+    }
+
+    /// Write a ULP payload of `length` bytes as a stream. Returns the payload and the concatenated
+    /// frames.
+    fn stream_frames(rid: &mut RendezvousProtocol, length: usize) -> (Vec<u8>, Vec<u8>) {
+        let payload: Vec<u8> = (0_u8..=u8::MAX).cycle().take(length).collect();
+        let frames = rid.write_ulp_stream(&payload, true).unwrap();
+        assert!(frames.len() >= 2);
+        let bytes = frames
+            .into_iter()
+            .flat_map(|(_, result)| Vec::<u8>::from(result.outgoing_frame.unwrap()))
+            .collect();
+        (payload, bytes)
+    }
+
+    /// Add `chunks` to path `1` of `rrd` one by one and collect the ULP data of all frames.
+    fn receive_stream(rrd: &mut RendezvousProtocol, chunks: &[&[u8]]) -> Vec<u8> {
+        let mut received = vec![];
+        for chunk in chunks {
+            rrd.add_chunks(1, &[*chunk]).unwrap();
+            while let Some(result) = rrd.process_frame(1).unwrap() {
+                received.extend(result.incoming_ulp_data.unwrap());
+            }
+        }
+        received
+    }
+
+    #[test]
+    fn buffer_multiple_frames_when_streaming() {
+        let (mut rid, mut rrd) = streaming_protocols(true);
+
+        // All frames in a single chunk, exceeding the maximum length of a single frame
+        let (payload, bytes) = stream_frames(&mut rid, 150_000);
+        assert!(bytes.len() > FrameDecoder::MAX_LENGTH_WHEN_STREAMING);
+        assert_eq!(receive_stream(&mut rrd, &[bytes.as_slice()]), payload);
+
+        // Frames split across chunks at arbitrary positions
+        let (payload, bytes) = stream_frames(&mut rid, 150_000);
+        let chunks: Vec<&[u8]> = bytes.chunks(7_777).collect();
+        assert_eq!(receive_stream(&mut rrd, &chunks), payload);
+    }
+
+    #[test]
+    fn automatic_nomination_requires_nominator() {
+        let mut rid = RendezvousProtocol::new_as_rid(false, AK, &[1]);
+        assert!(matches!(
+            rid.enable_automatic_nomination(NominationPolicy::default()),
+            Err(RendezvousProtocolError::NominateNotAllowed)
+        ));
+    }
+}
@@ -0,0 +1,329 @@
+//! Striping of ULP frames across multiple nominated paths.
+//!
+//! An optional extension of the protocol where the nominator nominates additional paths after the
+//! first one. ULP frames are then spread across all nominated paths and prefixed with a stripe
+//! sequence number, allowing the receiver to restore the original order:
+//!
+//! ```text
+//! striped-ulp-data = u64-le(stripe sequence number) || ulp-data
+//! ```
+//!
+//! The result is encrypted per path like any other ULP frame, i.e. with the path's transport keys
+//! and its own sequence number.
+use std::collections::{BTreeMap, HashMap, VecDeque};
+
+use super::{Path, RendezvousProtocolError};
+use crate::utils::time::Duration;
+
+/// Length of the stripe sequence number prefixed to each ULP frame.
+const STRIPE_SN_LENGTH: usize = 8;
+
+/// Policy for striping ULP frames across multiple nominated paths, see
+/// [`super::RendezvousProtocol::enable_striping`].
+#[derive(Clone, Copy, Debug)]
+pub struct StripingPolicy {
+    /// Maximum amount of paths to be nominated (including the first nominated path).
+    pub max_paths: usize,
+
+    /// Amount of bytes in flight on a path before it is considered congested.
+    pub max_in_flight_bytes: usize,
+
+    /// Maximum amount of frames received out of order that are buffered for reordering.
+    pub max_reorder_frames: usize,
+}
+impl Default for StripingPolicy {
+    fn default() -> Self {
+        Self {
+            max_paths: 4,
+            max_in_flight_bytes: 4 * 1_048_576,
+            max_reorder_frames: 1024,
+        }
+    }
+}
+
+/// Load of a nominated path.
+struct PathLoad {
+    /// Handshake RTT of the path.
+    rtt: Duration,
+
+    /// Lengths of the frames created for the path that have not been flushed, yet.
+    in_flight: VecDeque<usize>,
+
+    /// Sum of `in_flight`.
+    in_flight_bytes: usize,
+}
+
+/// Selects the path an outgoing frame is to be sent on.
+#[derive(Default)]
+struct Scheduler {
+    paths: HashMap<u32, PathLoad>,
+}
+impl Scheduler {
+    fn add_path(&mut self, pid: u32, rtt: Duration) {
+        let _ = self.paths.insert(
+            pid,
+            PathLoad {
+                rtt,
+                in_flight: VecDeque::new(),
+                in_flight_bytes: 0,
+            },
+        );
+    }
+
+    /// Select the path with the lowest expected cost of sending `length` more bytes, i.e. the
+    /// amount of queued bytes weighted by the path's RTT. Paths exceeding `max_in_flight_bytes`
+    /// are only selected if all paths do.
+    ///
+    /// Since frames only leave the queue once the transport flushed them, a path with less
+    /// throughput automatically receives fewer frames.
+    fn select(&self, length: usize, max_in_flight_bytes: usize) -> Option<u32> {
+        self.paths
+            .iter()
+            .min_by_key(|(pid, load)| {
+                let queued_bytes = load.in_flight_bytes.saturating_add(length);
+                let cost = u128::try_from(queued_bytes)
+                    .unwrap_or(u128::MAX)
+                    .saturating_mul(load.rtt.as_micros().max(1));
+                (load.in_flight_bytes >= max_in_flight_bytes, cost, **pid)
+            })
+            .map(|(pid, _)| *pid)
+    }
+
+    fn is_congested(&self, max_in_flight_bytes: usize) -> bool {
+        self.paths
+            .values()
+            .all(|load| load.in_flight_bytes >= max_in_flight_bytes)
+    }
+
+    fn enqueue(&mut self, pid: u32, length: usize) {
+        if let Some(load) = self.paths.get_mut(&pid) {
+            load.in_flight.push_back(length);
+            load.in_flight_bytes = load.in_flight_bytes.saturating_add(length);
+        }
+    }
+
+    fn flushed(&mut self, pid: u32) -> Result<(), RendezvousProtocolError> {
+        let load = self
+            .paths
+            .get_mut(&pid)
+            .ok_or(RendezvousProtocolError::UnknownOrDroppedPath(pid))?;
+        let length = load
+            .in_flight
+            .pop_front()
+            .ok_or(RendezvousProtocolError::InvalidStripedUlpData(format!(
+                "No frame in flight on path with PID {pid}"
+            )))?;
+        load.in_flight_bytes = load.in_flight_bytes.saturating_sub(length);
+        Ok(())
+    }
+}
+
+/// Restores the original order of striped ULP frames received across multiple paths.
+#[derive(Default)]
+struct Reassembler {
+    next_sn: u64,
+    pending: BTreeMap<u64, Vec<u8>>,
+}
+impl Reassembler {
+    fn push(
+        &mut self,
+        sequence_number: u64,
+        ulp_data: Vec<u8>,
+        max_pending: usize,
+    ) -> Result<(), RendezvousProtocolError> {
+        if sequence_number < self.next_sn || self.pending.contains_key(&sequence_number) {
+            return Err(RendezvousProtocolError::InvalidStripedUlpData(format!(
+                "Repeated stripe sequence number {sequence_number}"
+            )));
+        }
+        if self.pending.len() >= max_pending {
+            return Err(RendezvousProtocolError::InvalidStripedUlpData(format!(
+                "Exceeded {max_pending} frames received out of order"
+            )));
+        }
+        let _ = self.pending.insert(sequence_number, ulp_data);
+        Ok(())
+    }
+
+    fn pop(&mut self) -> Result<Option<Vec<u8>>, RendezvousProtocolError> {
+        let Some(entry) = self.pending.first_entry() else {
+            return Ok(None);
+        };
+        if *entry.key() != self.next_sn {
+            return Ok(None);
+        }
+        self.next_sn = self
+            .next_sn
+            .checked_add(1)
+            .ok_or(RendezvousProtocolError::SequenceNumberOverflow)?;
+        Ok(Some(entry.remove()))
+    }
+}
+
+/// State of striping ULP frames across multiple nominated paths.
+pub(super) struct Striping {
+    policy: StripingPolicy,
+
+    /// Paths that have not been nominated but may still be nominated additionally.
+    pub(super) standby: HashMap<u32, Box<dyn Path>>,
+
+    /// Additionally nominated paths (i.e. excluding the first nominated path).
+    pub(super) paths: HashMap<u32, Box<dyn Path>>,
+
+    next_outgoing_sn: u64,
+    scheduler: Scheduler,
+    reassembler: Reassembler,
+}
+impl Striping {
+    pub(super) fn new(policy: StripingPolicy) -> Self {
+        Self {
+            policy,
+            standby: HashMap::new(),
+            paths: HashMap::new(),
+            next_outgoing_sn: 0,
+            scheduler: Scheduler::default(),
+            reassembler: Reassembler::default(),
+        }
+    }
+
+    /// Whether another path may be nominated.
+    pub(super) fn has_capacity(&self) -> bool {
+        self.scheduler.paths.len() < self.policy.max_paths
+    }
+
+    /// Whether all nominated paths are congested.
+    pub(super) fn is_congested(&self) -> bool {
+        self.scheduler.is_congested(self.policy.max_in_flight_bytes)
+    }
+
+    /// Register a nominated path with its handshake RTT.
+    pub(super) fn add_nominated(&mut self, pid: u32, rtt: Duration) {
+        self.scheduler.add_path(pid, rtt);
+    }
+
+    /// Select the path to send `length` bytes of ULP data on.
+    pub(super) fn select(&self, length: usize) -> Option<u32> {
+        self.scheduler.select(
+            STRIPE_SN_LENGTH.saturating_add(length),
+            self.policy.max_in_flight_bytes,
+        )
+    }
+
+    /// Record an outgoing frame of `length` bytes created for the path associated to `pid`.
+    pub(super) fn enqueue(&mut self, pid: u32, length: usize) {
+        self.scheduler.enqueue(pid, length);
+    }
+
+    /// Record that the transport flushed the oldest outgoing frame of the path associated to
+    /// `pid`.
+    pub(super) fn flushed(&mut self, pid: u32) -> Result<(), RendezvousProtocolError> {
+        self.scheduler.flushed(pid)
+    }
+
+    /// Prefix ULP data with the next stripe sequence number.
+    pub(super) fn encode(&mut self, ulp_data: &[u8]) -> Result<Vec<u8>, RendezvousProtocolError> {
+        let sequence_number = self.next_outgoing_sn;
+        self.next_outgoing_sn = sequence_number
+            .checked_add(1)
+            .ok_or(RendezvousProtocolError::SequenceNumberOverflow)?;
+        let mut striped_ulp_data = Vec::with_capacity(STRIPE_SN_LENGTH.saturating_add(ulp_data.len()));
+        striped_ulp_data.extend_from_slice(&sequence_number.to_le_bytes());
+        striped_ulp_data.extend_from_slice(ulp_data);
+        Ok(striped_ulp_data)
+    }
+
+    /// Strip the stripe sequence number from incoming striped ULP data and queue it for
+    /// reordering.
+    pub(super) fn decode(&mut self, mut striped_ulp_data: Vec<u8>) -> Result<(), RendezvousProtocolError> {
+        let sequence_number = striped_ulp_data
+            .get(..STRIPE_SN_LENGTH)
+            .and_then(|bytes| <[u8; STRIPE_SN_LENGTH]>::try_from(bytes).ok())
+            .map(u64::from_le_bytes)
+            .ok_or_else(|| {
+                RendezvousProtocolError::InvalidStripedUlpData(format!(
+                    "Expected at least {STRIPE_SN_LENGTH} bytes, got {}",
+                    striped_ulp_data.len()
+                ))
+            })?;
+        let _ = striped_ulp_data.drain(..STRIPE_SN_LENGTH);
+        self.reassembler
+            .push(sequence_number, striped_ulp_data, self.policy.max_reorder_frames)
+    }
+
+    /// Next ULP data in the original order, if available.
+    pub(super) fn next_ulp_data(&mut self) -> Result<Option<Vec<u8>>, RendezvousProtocolError> {
+        self.reassembler.pop()
+    }
+}
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn reorder_striped_ulp_data() {
+        let mut sender = Striping::new(StripingPolicy::default());
+        let mut receiver = Striping::new(StripingPolicy::default());
+        let frames: Vec<Vec<u8>> = (0_u8..5).map(|index| sender.encode(&[index]).unwrap()).collect();
+
+        // Receive out of order, nothing can be released before the first frame arrives
+        for index in [3, 1, 4, 2] {
+            receiver.decode(frames.get(index).unwrap().clone()).unwrap();
+            assert!(receiver.next_ulp_data().unwrap().is_none());
+        }
+        receiver.decode(frames.first().unwrap().clone()).unwrap();
+        let received: Vec<Vec<u8>> = core::iter::from_fn(|| receiver.next_ulp_data().unwrap()).collect();
+        assert_eq!(received, (0_u8..5).map(|index| vec![index]).collect::<Vec<_>>());
+
+        // Repeated frames must be rejected
+        assert!(receiver.decode(frames.get(2).unwrap().clone()).is_err());
+    }
+
+    #[test]
+    fn bound_reorder_buffer() {
+        let mut sender = Striping::new(StripingPolicy::default());
+        let mut receiver = Striping::new(StripingPolicy {
+            max_reorder_frames: 2,
+            ..StripingPolicy::default()
+        });
+        let _ = sender.encode(&[]).unwrap();
+        for _ in 0..2 {
+            receiver.decode(sender.encode(&[]).unwrap()).unwrap();
+        }
+        assert!(receiver.decode(sender.encode(&[]).unwrap()).is_err());
+    }
+
+    #[test]
+    fn schedule_by_load_and_rtt() {
+        let mut striping = Striping::new(StripingPolicy {
+            max_in_flight_bytes: 1000,
+            ..StripingPolicy::default()
+        });
+        striping.add_nominated(1, Duration::from_millis(10));
+        striping.add_nominated(2, Duration::from_millis(40));
+
+        // The path with the lower RTT is preferred until it is loaded 4 times as much
+        assert_eq!(striping.select(92), Some(1));
+        striping.enqueue(1, 200);
+        assert_eq!(striping.select(92), Some(1));
+        striping.enqueue(1, 200);
+        assert_eq!(striping.select(92), Some(2));
+
+        // A congested path is avoided, regardless of its RTT
+        striping.enqueue(1, 600);
+        striping.enqueue(2, 900);
+        assert_eq!(striping.select(92), Some(2));
+        assert!(!striping.is_congested());
+        striping.enqueue(2, 100);
+        assert!(striping.is_congested());
+
+        // Flushing frames relieves the path
+        striping.flushed(1).unwrap();
+        assert!(!striping.is_congested());
+        assert_eq!(striping.select(92), Some(1));
+        striping.flushed(1).unwrap();
+        striping.flushed(1).unwrap();
+        assert!(striping.flushed(1).is_err());
+    }
+}
@@ -0,0 +1,152 @@
+//! Streaming of ULP payloads as a sequence of fixed-size records.
+//!
+//! An optional mode where ULP payloads of arbitrary size are split into records of at most
+//! [`RECORD_LENGTH`] bytes. Each record is sent as a separate ULP frame (and therefore encrypted
+//! and authenticated on its own), so neither side ever needs to buffer more than a single record:
+//!
+//! ```text
+//! ulp-record = ulp-data || u8(flags)
+//! ```
+//!
+//! Flag `0x01` marks the last record of a ULP payload. All other flags are reserved.
+use super::RendezvousProtocolError;
+
+/// Maximum amount of ULP data carried by a single record.
+pub(super) const RECORD_LENGTH: usize = 65_536;
+
+/// Length of the record trailer.
+const TRAILER_LENGTH: usize = 1;
+
+/// Additional capacity reserved for each record, so that encrypting it in place does not
+/// reallocate.
+const TAG_LENGTH: usize = 16;
+
+/// Flag marking the last record of a ULP payload.
+const FLAG_END_OF_PAYLOAD: u8 = 0x01;
+
+/// Splits outgoing ULP payloads into records.
+#[derive(Default)]
+pub(super) struct RecordWriter {
+    /// ULP data of the current record that has not been written, yet.
+    pending: Vec<u8>,
+}
+impl RecordWriter {
+    /// Append `ulp_data` to the current ULP payload and return all records that are complete.
+    ///
+    /// If `end_of_payload` is set, the remaining data is returned as the last record of the ULP
+    /// payload. Otherwise, up to one record is kept back until more data is written.
+    pub(super) fn write(&mut self, mut ulp_data: &[u8], end_of_payload: bool) -> Vec<Vec<u8>> {
+        let mut records = vec![];
+        while !ulp_data.is_empty() {
+            // Emit the current record once it is full and more data follows
+            if self.pending.len() >= RECORD_LENGTH {
+                records.push(self.take(0x00));
+            }
+
+            // Fill the current record
+            if self.pending.capacity() == 0 {
+                self.pending
+                    .reserve_exact(RECORD_LENGTH.saturating_add(TRAILER_LENGTH).saturating_add(TAG_LENGTH));
+            }
+            let available = RECORD_LENGTH.saturating_sub(self.pending.len());
+            let (chunk, remaining) = ulp_data.split_at(available.min(ulp_data.len()));
+            self.pending.extend_from_slice(chunk);
+            ulp_data = remaining;
+        }
+        if end_of_payload {
+            records.push(self.take(FLAG_END_OF_PAYLOAD));
+        }
+        records
+    }
+
+    fn take(&mut self, flags: u8) -> Vec<u8> {
+        let mut record = core::mem::take(&mut self.pending);
+        record.push(flags);
+        record
+    }
+}
+
+/// Decode an incoming record. Returns the contained ULP data and whether more records of the same
+/// ULP payload follow.
+pub(super) fn decode_record(mut record: Vec<u8>) -> Result<(Vec<u8>, bool), RendezvousProtocolError> {
+    let flags = record
+        .pop()
+        .ok_or_else(|| RendezvousProtocolError::InvalidUlpRecord("Missing trailer".to_owned()))?;
+    if flags & !FLAG_END_OF_PAYLOAD != 0 {
+        return Err(RendezvousProtocolError::InvalidUlpRecord(format!(
+            "Unknown flags 0x{flags:02x}"
+        )));
+    }
+    if record.len() > RECORD_LENGTH {
+        return Err(RendezvousProtocolError::InvalidUlpRecord(format!(
+            "Record of {} bytes exceeds {RECORD_LENGTH} bytes",
+            record.len()
+        )));
+    }
+    Ok((record, flags & FLAG_END_OF_PAYLOAD == 0))
+}
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Decode `records` and reassemble the ULP payloads.
+    fn reassemble(records: Vec<Vec<u8>>) -> Vec<Vec<u8>> {
+        let mut payloads = vec![];
+        let mut payload = vec![];
+        for record in records {
+            let (ulp_data, more) = decode_record(record).unwrap();
+            payload.extend_from_slice(&ulp_data);
+            if !more {
+                payloads.push(core::mem::take(&mut payload));
+            }
+        }
+        assert!(payload.is_empty(), "Incomplete payload");
+        payloads
+    }
+
+    #[test]
+    fn split_payloads_into_records() {
+        let mut writer = RecordWriter::default();
+        let large_payload: Vec<u8> = (0_u8..=u8::MAX)
+            .cycle()
+            .take(RECORD_LENGTH.saturating_mul(3).saturating_add(17))
+            .collect();
+
+        // Write the large payload in odd chunks, followed by an empty and a small payload
+        let mut records = vec![];
+        for chunk in large_payload.chunks(10_000) {
+            records.extend(writer.write(chunk, false));
+        }
+        records.extend(writer.write(&[], true));
+        records.extend(writer.write(&[], true));
+        records.extend(writer.write(b"small", true));
+
+        // Records must be of fixed size, except for the last record of each payload
+        assert_eq!(records.len(), 6);
+        for record in records.iter().take(3) {
+            assert_eq!(record.len(), RECORD_LENGTH.saturating_add(TRAILER_LENGTH));
+        }
+        assert_eq!(
+            reassemble(records),
+            vec![large_payload, vec![], b"small".to_vec()]
+        );
+    }
+
+    #[test]
+    fn keep_full_record_until_end_is_known() {
+        let mut writer = RecordWriter::default();
+        assert!(writer.write(&[0; RECORD_LENGTH], false).is_empty());
+        let records = writer.write(&[], true);
+        assert_eq!(records.len(), 1);
+        assert_eq!(reassemble(records), vec![vec![0; RECORD_LENGTH]]);
+    }
+
+    #[test]
+    fn reject_invalid_records() {
+        assert!(decode_record(vec![]).is_err());
+        assert!(decode_record(vec![0xaa, 0x02]).is_err());
+        assert!(decode_record(vec![0; RECORD_LENGTH.saturating_add(2)]).is_err());
+    }
+}
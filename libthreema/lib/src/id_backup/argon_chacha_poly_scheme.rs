@@ -17,7 +17,7 @@ use crate::{
     common::{ClientKey, ThreemaId},
     crypto::{
         aead::AeadInPlace as _,
-        argon2::{Argon2, Argon2id, Params},
+        argon2::{Argon2idArena, ParallelArgon2id, Params},
         chacha20::ChaCha20Poly1305,
         cipher::KeyInit as _,
     },
@@ -42,11 +42,13 @@ const ENCRYPTED_DATA_LENGTH: usize = DATA_LENGTH + TAG_LENGTH;
 const ENCRYPTED_LENGTH: usize = ASSOCIATED_DATA_LENGTH + ENCRYPTED_DATA_LENGTH;
 
 /// Derive the symmetric backup encryption key
+///
+/// Note: The parameters are part of the backup format, which must remain restorable by all Threema
+/// clients. With a single lane, the derivation cannot be spread across threads. Callers choosing
+/// their own parameters can use multiple lanes via the `argon2id` bindings.
 fn derive_key(password: &str, salt: Salt) -> IdentityBackupResult<BackupKey> {
     let mut key = [0; BackupKey::LENGTH];
-    Argon2::new(
-        Argon2id,
-        argon2::Version::V0x13,
+    ParallelArgon2id::with_available_parallelism(
         Params::new(
             128 * 1024,              // 128 MiB memory
             8,                       // iterations
@@ -55,7 +57,12 @@ fn derive_key(password: &str, salt: Salt) -> IdentityBackupResult<BackupKey> {
         )
         .map_err(|_| IdentityBackupError::KdfFailed)?,
     )
-    .hash_password_into(password.as_bytes(), &salt.0, &mut key)
+    .hash_password_into(
+        &mut Argon2idArena::default(),
+        password.as_bytes(),
+        &salt.0,
+        &mut key,
+    )
     .map_err(|_| IdentityBackupError::KdfFailed)?;
     Ok(BackupKey(key))
 }
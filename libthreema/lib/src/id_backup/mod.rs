@@ -10,6 +10,10 @@ use crate::common::{ClientKey, ThreemaId};
 mod argon_chacha_poly_scheme;
 mod legacy_scheme;
 
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub use crate::crypto::argon2::bench as argon2_bench;
+
 #[derive(Zeroize, ZeroizeOnDrop)]
 struct BackupKey([u8; BackupKey::LENGTH]);
 impl BackupKey {
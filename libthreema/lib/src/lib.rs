@@ -5,12 +5,12 @@
 // We have pretty strict linting rules and it would be a massive hassle having to conditionally
 // compile all `pub(crate)` exposed items, depending on the selected features.
 //
-// The goal is to get it right with features `uniffi`, `wasm` and `cli` enabled (and of course, all
-// feature variants still need to compile).
+// The goal is to get it right with features `c-ffi`, `uniffi`, `wasm` and `cli` enabled (and of
+// course, all feature variants still need to compile).
 //
 // However, it does make sense to disable this from time to time to check for actual issues.
 #![cfg_attr(
-    not(all(feature = "uniffi", feature = "wasm", feature = "cli")),
+    not(all(feature = "c-ffi", feature = "uniffi", feature = "wasm", feature = "cli")),
     allow(
         dead_code,
         unused_crate_dependencies,
@@ -24,6 +24,7 @@
 #[cfg(test)]
 mod external_crate_false_positives {
     use anyhow as _;
+    use criterion as _;
     use tokio as _;
 }
 #[cfg(feature = "cli")]
@@ -60,6 +61,10 @@ mod protobuf {
         include!(concat!(env!("OUT_DIR"), "/sync.rs"));
     }
     pub use sync as d2d_sync;
+    pub mod history {
+        include!(concat!(env!("OUT_DIR"), "/history.rs"));
+    }
+    pub use history as d2d_history;
     pub mod d2d_rendezvous {
         include!(concat!(env!("OUT_DIR"), "/rendezvous.rs"));
     }
@@ -70,6 +75,7 @@ pub mod common;
 pub(crate) mod crypto;
 pub mod csp;
 pub mod csp_e2e;
+pub mod d2d_history;
 pub mod d2d_rendezvous;
 pub mod https;
 pub mod id_backup;
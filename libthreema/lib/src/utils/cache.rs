@@ -1,57 +1,239 @@
 //! Cache-related utilities.
 use core::hash::Hash;
-use std::collections::{HashMap, hash_map::Entry};
+use std::collections::HashMap;
 
 use crate::utils::time::Instant;
 
-/// Cache store bound by time
+/// Hit, miss and eviction counters of a [`TimedCache`].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub(crate) struct CacheStats {
+    /// Amount of lookups that returned a valid value.
+    pub(crate) hits: u64,
+
+    /// Amount of lookups that did not return a value (including expired values).
+    pub(crate) misses: u64,
+
+    /// Amount of valid values that were evicted because the cache was full.
+    pub(crate) evictions: u64,
+
+    /// Amount of values that were removed because they expired.
+    pub(crate) expirations: u64,
+}
+
+#[derive(Debug)]
+struct Slot<K, V> {
+    key: K,
+    value: V,
+    inserted_at: Instant,
+
+    /// Whether the value has been retrieved since the _clock_ hand last passed it.
+    referenced: bool,
+
+    /// Index of the next older slot in insertion order.
+    older: Option<usize>,
+
+    /// Index of the next newer slot in insertion order.
+    newer: Option<usize>,
+}
+
+/// Cache store bound by time and size
 ///
-/// Values are timestamped when inserted and are evicted if expired at time of retrieval.
+/// Values are timestamped when inserted and are evicted once expired. Since all values share the
+/// same lifespan, they expire in insertion order, so the slots are linked in insertion order and
+/// expiring values only ever needs to look at the oldest ones (amortized O(1) per value).
+///
+/// When the cache holds `CAPACITY` values, inserting another one evicts a value that has not been
+/// retrieved recently by running the _clock_ (second chance) algorithm over the slots.
 ///
 /// Note: This cache is in-memory only
 #[derive(Debug)]
-pub(crate) struct TimedCache<K, V, const EXPIRES_AT_S: u64>(HashMap<K, (Instant, V)>);
-impl<K: Hash + Eq, V, const EXPIRES_AT_S: u64> TimedCache<K, V, EXPIRES_AT_S> {
-    /// Creates a new `TimedCache` with the specified lifespan.
-    #[cfg_attr(not(test), expect(dead_code, reason = "Will use later"))]
-    pub(crate) fn new(inner: HashMap<K, (Instant, V)>) -> Self {
-        Self(inner)
+pub(crate) struct TimedCache<K, V, const EXPIRES_AT_S: u64, const CAPACITY: usize> {
+    index: HashMap<K, usize>,
+    slots: Vec<Option<Slot<K, V>>>,
+    free_slots: Vec<usize>,
+    oldest: Option<usize>,
+    newest: Option<usize>,
+    clock_hand: usize,
+    stats: CacheStats,
+}
+impl<K: Hash + Eq + Clone, V, const EXPIRES_AT_S: u64, const CAPACITY: usize> Default
+    for TimedCache<K, V, EXPIRES_AT_S, CAPACITY>
+{
+    fn default() -> Self {
+        const { assert!(CAPACITY > 0, "TimedCache capacity must be non-zero") };
+        Self {
+            index: HashMap::new(),
+            slots: vec![],
+            free_slots: vec![],
+            oldest: None,
+            newest: None,
+            clock_hand: 0,
+            stats: CacheStats::default(),
+        }
+    }
+}
+impl<K: Hash + Eq + Clone, V, const EXPIRES_AT_S: u64, const CAPACITY: usize>
+    TimedCache<K, V, EXPIRES_AT_S, CAPACITY>
+{
+    /// Amount of values currently stored (including expired values that have not been removed,
+    /// yet).
+    pub(crate) fn len(&self) -> usize {
+        self.index.len()
+    }
+
+    /// Hit, miss and eviction counters since the cache has been created.
+    pub(crate) fn stats(&self) -> CacheStats {
+        self.stats
     }
 
     /// Refresh the cache by removing any expired values from the cache.
-    #[expect(clippy::allow_attributes, reason = "Test uses it...")]
-    #[allow(dead_code, reason = "Will use later")]
     pub(crate) fn refresh(&mut self) {
-        self.0.retain(|_, (inserted_at, _)| Self::valid(inserted_at));
+        while let Some(oldest) = self.oldest {
+            if Self::valid(&self.slot(oldest).inserted_at) {
+                break;
+            }
+            let _ = self.remove_slot(oldest);
+            self.stats.expirations = self.stats.expirations.saturating_add(1);
+        }
     }
 
     /// Get a mutable reference to a value in the cache.
     pub(crate) fn get_mut(&mut self, key: K) -> Option<&mut V> {
         // Lookup the value
-        let Entry::Occupied(entry) = self.0.entry(key) else {
+        let Some(&slot_index) = self.index.get(&key) else {
+            self.stats.misses = self.stats.misses.saturating_add(1);
             return None;
         };
 
         // Ensure the value is still valid or purge it
-        let (inserted_at, _) = entry.get();
-        if !Self::valid(inserted_at) {
-            let _ = entry.remove();
+        if !Self::valid(&self.slot(slot_index).inserted_at) {
+            let _ = self.remove_slot(slot_index);
+            self.stats.expirations = self.stats.expirations.saturating_add(1);
+            self.stats.misses = self.stats.misses.saturating_add(1);
             return None;
         }
 
-        // Return the value
-        let (_, value) = entry.into_mut();
-        Some(value)
+        // Mark as recently used and return the value
+        self.stats.hits = self.stats.hits.saturating_add(1);
+        let slot = self.slot_mut(slot_index);
+        slot.referenced = true;
+        Some(&mut slot.value)
     }
 
     /// Insert a value pair into the cache.
     ///
     /// Returns the previous value if present and still valid.
     pub(crate) fn insert(&mut self, key: K, value: V) -> Option<V> {
-        self.0
-            .insert(key, (Instant::now(), value))
-            .take_if(|(inserted_at, _)| Self::valid(inserted_at))
-            .map(|(_, value)| value)
+        self.insert_at(key, value, Instant::now())
+    }
+
+    /// Insert a value pair into the cache, timestamped with `inserted_at`.
+    ///
+    /// Note: `inserted_at` must not be older than the timestamp of any previously inserted value.
+    fn insert_at(&mut self, key: K, value: V, inserted_at: Instant) -> Option<V> {
+        // Purge expired values first, so that they are preferred over valid values when evicting
+        self.refresh();
+
+        // Remove the previous value (which is valid at this point)
+        let previous = self
+            .index
+            .get(&key)
+            .copied()
+            .map(|slot_index| self.remove_slot(slot_index).value);
+
+        // Make room, if necessary
+        if self.index.len() >= CAPACITY {
+            self.evict();
+        }
+
+        // Store the value as the newest one
+        let slot = Slot {
+            key: key.clone(),
+            value,
+            inserted_at,
+            referenced: false,
+            older: self.newest,
+            newer: None,
+        };
+        let slot_index = if let Some(slot_index) = self.free_slots.pop() {
+            *self
+                .slots
+                .get_mut(slot_index)
+                .expect("free slot index must be in bounds") = Some(slot);
+            slot_index
+        } else {
+            self.slots.push(Some(slot));
+            self.slots.len().saturating_sub(1)
+        };
+        match self.newest {
+            Some(newest) => self.slot_mut(newest).newer = Some(slot_index),
+            None => self.oldest = Some(slot_index),
+        }
+        self.newest = Some(slot_index);
+        let _ = self.index.insert(key, slot_index);
+        previous
+    }
+
+    /// Evict a value that has not been retrieved since the _clock_ hand last passed it.
+    fn evict(&mut self) {
+        // Note: Terminates at the latest after a full revolution since all reference markers are
+        // being cleared while passing them.
+        loop {
+            if self.clock_hand >= self.slots.len() {
+                self.clock_hand = 0;
+            }
+            let slot_index = self.clock_hand;
+            self.clock_hand = self.clock_hand.saturating_add(1);
+            let Some(slot) = self
+                .slots
+                .get_mut(slot_index)
+                .expect("clock hand must be in bounds")
+            else {
+                continue;
+            };
+            if slot.referenced {
+                slot.referenced = false;
+                continue;
+            }
+            let _ = self.remove_slot(slot_index);
+            self.stats.evictions = self.stats.evictions.saturating_add(1);
+            return;
+        }
+    }
+
+    /// Remove an occupied slot, unlinking it from the insertion order.
+    fn remove_slot(&mut self, slot_index: usize) -> Slot<K, V> {
+        let slot = self
+            .slots
+            .get_mut(slot_index)
+            .expect("slot index must be in bounds")
+            .take()
+            .expect("slot must be occupied");
+        match slot.older {
+            Some(older) => self.slot_mut(older).newer = slot.newer,
+            None => self.oldest = slot.newer,
+        }
+        match slot.newer {
+            Some(newer) => self.slot_mut(newer).older = slot.older,
+            None => self.newest = slot.older,
+        }
+        let _ = self.index.remove(&slot.key);
+        self.free_slots.push(slot_index);
+        slot
+    }
+
+    fn slot(&self, slot_index: usize) -> &Slot<K, V> {
+        self.slots
+            .get(slot_index)
+            .and_then(Option::as_ref)
+            .expect("slot must be occupied")
+    }
+
+    fn slot_mut(&mut self, slot_index: usize) -> &mut Slot<K, V> {
+        self.slots
+            .get_mut(slot_index)
+            .and_then(Option::as_mut)
+            .expect("slot must be occupied")
     }
 
     fn valid(inserted_at: &Instant) -> bool {
@@ -59,64 +241,150 @@ impl<K: Hash + Eq, V, const EXPIRES_AT_S: u64> TimedCache<K, V, EXPIRES_AT_S> {
     }
 }
 
+/// Access to the [`TimedCache`] for benchmarks (see `benches/`). Not part of the public API.
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub mod bench {
+    use super::TimedCache;
+    use crate::{common::ThreemaId, csp_e2e::contact::lookup::CONTACT_LOOKUP_CACHE_CAPACITY};
+
+    /// [`TimedCache`] with the same parameters as the contact lookup cache.
+    #[derive(Debug, Default)]
+    pub struct IdentityCache(TimedCache<ThreemaId, u64, 600, CONTACT_LOOKUP_CACHE_CAPACITY>);
+
+    impl IdentityCache {
+        /// Maximum amount of values stored in the cache.
+        pub const CAPACITY: usize = CONTACT_LOOKUP_CACHE_CAPACITY;
+
+        /// See [`TimedCache::get_mut`].
+        pub fn get(&mut self, identity: ThreemaId) -> Option<u64> {
+            self.0.get_mut(identity).copied()
+        }
+
+        /// See [`TimedCache::insert`].
+        pub fn insert(&mut self, identity: ThreemaId, value: u64) -> Option<u64> {
+            self.0.insert(identity, value)
+        }
+
+        /// See [`TimedCache::refresh`].
+        pub fn refresh(&mut self) {
+            self.0.refresh();
+        }
+
+        /// See [`TimedCache::len`].
+        #[must_use]
+        pub fn len(&self) -> usize {
+            self.0.len()
+        }
+
+        /// Whether the cache is empty.
+        #[must_use]
+        pub fn is_empty(&self) -> bool {
+            self.0.len() == 0
+        }
+
+        /// Human readable [`TimedCache::stats`].
+        #[must_use]
+        pub fn stats(&self) -> String {
+            format!("{:?}", self.0.stats())
+        }
+    }
+}
+
 #[expect(clippy::unwrap_used, reason = "Test code")]
 #[cfg(test)]
 mod tests {
     use super::*;
     use crate::utils::time::Duration;
 
+    fn expired() -> Instant {
+        Instant::now().checked_sub(Duration::from_secs(60)).unwrap()
+    }
+
     #[test]
     fn timed_cache() {
-        let mut cache = TimedCache::<u64, &'static str, 60>::new(
-            [(
-                1,
-                (
-                    Instant::now().checked_sub(Duration::from_secs(60)).unwrap(),
-                    "gone",
-                ),
-            )]
-            .into_iter()
-            .collect(),
-        );
+        let mut cache = TimedCache::<u64, &'static str, 60, 8>::default();
+        assert_eq!(cache.insert_at(1, "gone", expired()), None);
+        assert_eq!(cache.len(), 1, "Should initially contain one value");
 
-        assert_eq!(cache.0.len(), 1, "Should initially contain one value");
+        assert_eq!(
+            cache.get_mut(1),
+            None,
+            "Should remove the value that expired when getting it"
+        );
+        assert_eq!(cache.len(), 0, "Should not contain the expired value");
 
         assert_eq!(cache.insert(2, "kept"), None);
-        assert_eq!(cache.0.len(), 2, "Should contain two values after insertion");
-
         assert_eq!(
             cache.get_mut(2),
             Some(&mut "kept"),
-            "Should maintain two values when getting one that did not expire"
+            "Should maintain the value when getting one that did not expire"
         );
+        assert_eq!(cache.insert(2, "replaced"), Some("kept"));
+        assert_eq!(cache.len(), 1, "Should only have the value that didn't expire");
 
         assert_eq!(
-            cache.get_mut(1),
-            None,
-            "Should remove the value that expired when getting it"
+            cache.stats(),
+            CacheStats {
+                hits: 1,
+                misses: 1,
+                evictions: 0,
+                expirations: 1,
+            }
         );
-        assert_eq!(cache.0.len(), 1, "Should only have the value that didn't expire");
     }
 
     #[test]
     fn refresh() {
-        let mut cache = TimedCache::<u64, &'static str, 60>::new(
-            [(
-                1,
-                (
-                    Instant::now().checked_sub(Duration::from_secs(60)).unwrap(),
-                    "gone",
-                ),
-            )]
-            .into_iter()
-            .collect(),
-        );
+        let mut cache = TimedCache::<u64, &'static str, 60, 8>::default();
+        let _ = cache.insert_at(1, "gone", expired());
+        let _ = cache.insert_at(2, "gone", expired());
 
         cache.refresh();
-        assert_eq!(
-            cache.0.len(),
-            0,
-            "Should purge all expired values after a refresh"
-        );
+        assert_eq!(cache.len(), 0, "Should purge all expired values after a refresh");
+        assert_eq!(cache.stats().expirations, 2);
+    }
+
+    #[test]
+    fn insert_purges_expired_before_evicting() {
+        let mut cache = TimedCache::<u64, &'static str, 60, 2>::default();
+        let _ = cache.insert_at(1, "gone", expired());
+        let _ = cache.insert(2, "kept");
+        let _ = cache.insert(3, "kept");
+
+        assert_eq!(cache.len(), 2);
+        assert_eq!(cache.get_mut(2), Some(&mut "kept"));
+        assert_eq!(cache.get_mut(3), Some(&mut "kept"));
+        assert_eq!(cache.stats().evictions, 0);
+        assert_eq!(cache.stats().expirations, 1);
+    }
+
+    #[test]
+    fn evicts_values_not_recently_used() {
+        let mut cache = TimedCache::<u64, u64, 60, 3>::default();
+        for key in 1..=3 {
+            let _ = cache.insert(key, key);
+        }
+
+        // Retrieving 1 gives it a second chance, so 2 is evicted
+        assert_eq!(cache.get_mut(1), Some(&mut 1));
+        let _ = cache.insert(4, 4);
+        assert_eq!(cache.len(), 3, "Should not exceed the capacity");
+        assert_eq!(cache.get_mut(2), None, "Should have evicted the unused value");
+        assert_eq!(cache.get_mut(1), Some(&mut 1));
+        assert_eq!(cache.get_mut(3), Some(&mut 3));
+        assert_eq!(cache.get_mut(4), Some(&mut 4));
+        assert_eq!(cache.stats().evictions, 1);
+    }
+
+    #[test]
+    fn bounded_under_churn() {
+        let mut cache = TimedCache::<u64, u64, 60, 16>::default();
+        for key in 0..1000 {
+            let _ = cache.insert(key, key);
+            assert!(cache.len() <= 16, "Should never exceed the capacity");
+        }
+        assert_eq!(cache.stats().evictions, 1000 - 16);
+        assert!(cache.slots.len() <= 16, "Should re-use slots");
     }
 }
@@ -1,5 +1,6 @@
 //! Frame (i.e. a fixed size of bytes) utilities.
 use core::{fmt, marker::PhantomData};
+use std::collections::VecDeque;
 
 use duplicate::duplicate_item;
 use libthreema_macros::Name;
@@ -94,6 +95,16 @@ impl FrameDelimiter<int_length> for delimiter_type {
     }
 }
 
+/// A frame exceeded the maximum frame length of a [`VariableLengthFrameDecoder`].
+#[derive(Debug, thiserror::Error)]
+#[error("Oversized frame of {length} bytes (max {max_length} bytes)")]
+pub(crate) struct OversizedFrame {
+    /// Length of the frame, as announced by the delimiter
+    pub(crate) length: usize,
+    /// Maximum frame length of the decoder
+    pub(crate) max_length: usize,
+}
+
 #[derive(Debug)]
 enum VariableLengthFrameDecoderState {
     PartialDelimiter,
@@ -101,6 +112,10 @@ enum VariableLengthFrameDecoderState {
 }
 
 /// Contains a stream of data and hands out individual variable length frames one by one.
+///
+/// Data is buffered in a ring buffer, so handing out a frame never moves the remaining data. A
+/// frame is handed out without copying if it is stored contiguously, which is only not the case
+/// when the frame wraps around the end of the ring buffer.
 #[derive(Name)]
 pub(crate) struct VariableLengthFrameDecoder<
     const DELIMETER_LENGTH: usize,
@@ -108,7 +123,8 @@ pub(crate) struct VariableLengthFrameDecoder<
 > {
     delimiter: PhantomData<TDelimiter>,
     state: VariableLengthFrameDecoderState,
-    data: Vec<u8>,
+    max_length: usize,
+    data: VecDeque<u8>,
 }
 impl<const DELIMETER_LENGTH: usize, TDelimiter: FrameDelimiter<DELIMETER_LENGTH>>
     VariableLengthFrameDecoder<DELIMETER_LENGTH, TDelimiter>
@@ -116,15 +132,22 @@ impl<const DELIMETER_LENGTH: usize, TDelimiter: FrameDelimiter<DELIMETER_LENGTH>
     const LENGTH: usize = DELIMETER_LENGTH;
 
     /// Create a frame decoder using a [`FrameDelimiter`] to decode the length of frames with `data`
-    /// being the initial data.
-    pub(crate) fn new(data: Vec<u8>) -> Self {
+    /// being the initial data. Frames larger than `max_length` will be rejected.
+    pub(crate) fn new(data: Vec<u8>, max_length: usize) -> Self {
         Self {
             delimiter: PhantomData,
             state: VariableLengthFrameDecoderState::PartialDelimiter,
-            data,
+            max_length,
+            data: VecDeque::from(data),
         }
     }
 
+    /// Update the maximum frame length. Applies to all frames whose delimiter has not been decoded
+    /// yet.
+    pub(crate) fn set_max_length(&mut self, max_length: usize) {
+        self.max_length = max_length;
+    }
+
     /// The required number of bytes for the decoder to advance its internal state.
     ///
     /// Note: An efficient implementation may always provide more than the required amount of bytes,
@@ -142,7 +165,7 @@ impl<const DELIMETER_LENGTH: usize, TDelimiter: FrameDelimiter<DELIMETER_LENGTH>
     /// buffered.
     pub(crate) fn add_chunks(&mut self, chunks: &[&[u8]]) -> usize {
         for chunk in chunks {
-            self.data.extend_from_slice(chunk);
+            self.data.extend(*chunk);
         }
         self.data.len()
     }
@@ -150,44 +173,72 @@ impl<const DELIMETER_LENGTH: usize, TDelimiter: FrameDelimiter<DELIMETER_LENGTH>
     /// Dissolve the frame decoder, returning any excess data.
     #[expect(dead_code, reason = "Will use later")]
     pub(crate) fn dissolve(self) -> Vec<u8> {
-        self.data
+        Vec::from(self.data)
     }
 
     /// Get the next frame from the decoder, passing through a transformation step (e.g. to avoid
     /// copying) if available.
+    ///
+    /// # Errors
+    ///
+    /// Returns [`OversizedFrame`] if the delimiter announces a frame larger than the maximum frame
+    /// length. The decoder must not be used any further in this case.
     pub(crate) fn next_frame_and_then<TResult, F: FnOnce(&[u8]) -> TResult>(
         &mut self,
         map_fn: F,
-    ) -> Option<TResult>
+    ) -> Result<Option<TResult>, OversizedFrame>
     where
         [(); DELIMETER_LENGTH]:,
     {
         if let VariableLengthFrameDecoderState::PartialDelimiter = &self.state {
             // Check if we have sufficient bytes to decode the limiter or wait for more
-            let delimiter = self.data.get(..DELIMETER_LENGTH)?;
+            if self.data.len() < DELIMETER_LENGTH {
+                return Ok(None);
+            }
 
-            // Decode the delimiter to retrieve the length
-            let delimiter: [u8; DELIMETER_LENGTH] = delimiter
-                .try_into()
-                .expect("[0..DELIMETER_LENGTH] must be DELIMETER_LENGTH bytes");
+            // Drain and decode the delimiter to retrieve the length
+            let mut delimiter = [0_u8; DELIMETER_LENGTH];
+            for (byte, delimiter_byte) in delimiter.iter_mut().zip(self.data.drain(..DELIMETER_LENGTH)) {
+                *byte = delimiter_byte;
+            }
             let length = TDelimiter::decode(delimiter);
 
-            // Drain the delimiter and move into the next state
-            let _ = self.data.drain(..DELIMETER_LENGTH);
+            // Ensure the frame does not exceed the maximum length before waiting for its data and
+            // move into the next state
+            if length > self.max_length {
+                return Err(OversizedFrame {
+                    length,
+                    max_length: self.max_length,
+                });
+            }
             self.state = VariableLengthFrameDecoderState::PartialFrame { length };
         }
 
         if let VariableLengthFrameDecoderState::PartialFrame { length } = &self.state {
-            if self.data.len() < *length {
+            let length = *length;
+            if self.data.len() < length {
                 // We have less data than what our frame needs. Wait for more.
-                return None;
+                return Ok(None);
             }
 
-            // The chunk contains more than or exactly what our frame needs. Drain the frame data
-            // and move into the next state with the remaining data.
-            let frame = map_fn(self.data.drain(..*length).as_slice());
+            // The buffer contains more than or exactly what our frame needs. If the frame wraps
+            // around the end of the ring buffer, rotate the buffer so that the frame is contiguous
+            // (happens at most once per buffer cycle).
+            let frame = match self.data.as_slices().0.get(..length) {
+                Some(frame) => map_fn(frame),
+                None => map_fn(
+                    self.data
+                        .make_contiguous()
+                        .get(..length)
+                        .expect("self.data must contain length bytes"),
+                ),
+            };
+
+            // Release the frame data (only moves the head of the ring buffer) and move into the
+            // next state with the remaining data.
+            let _ = self.data.drain(..length);
             self.state = VariableLengthFrameDecoderState::PartialDelimiter;
-            return Some(frame);
+            return Ok(Some(frame));
         }
 
         unreachable!("All decoder states should have been handled at this point");
@@ -200,7 +251,125 @@ impl<const DELIMETER_LENGTH: usize, TDelimiter: FrameDelimiter<DELIMETER_LENGTH>
         formatter
             .debug_struct(Self::NAME)
             .field("state", &self.state)
+            .field("max_length", &self.max_length)
             .field("data", &format_args!("length={}", self.data.len()))
             .finish()
     }
 }
+
+/// Access to the frame decoders for benchmarks (see `benches/`). Not part of the public API.
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub mod bench {
+    use super::{OversizedFrame, U16LittleEndianDelimiter, VariableLengthFrameDecoder};
+
+    /// [`u16`] little endian delimited frame decoder.
+    #[derive(Debug)]
+    pub struct U16FrameDecoder(VariableLengthFrameDecoder<2, U16LittleEndianDelimiter>);
+
+    impl U16FrameDecoder {
+        /// See [`VariableLengthFrameDecoder::new`].
+        #[must_use]
+        pub fn new(max_length: usize) -> Self {
+            Self(VariableLengthFrameDecoder::new(vec![], max_length))
+        }
+
+        /// See [`VariableLengthFrameDecoder::add_chunks`].
+        pub fn add_chunks(&mut self, chunks: &[&[u8]]) -> usize {
+            self.0.add_chunks(chunks)
+        }
+
+        /// See [`VariableLengthFrameDecoder::next_frame_and_then`].
+        ///
+        /// # Errors
+        ///
+        /// Returns a message if the frame exceeds the maximum frame length.
+        pub fn next_frame_and_then<TResult, F: FnOnce(&[u8]) -> TResult>(
+            &mut self,
+            map_fn: F,
+        ) -> Result<Option<TResult>, String> {
+            self.0
+                .next_frame_and_then(map_fn)
+                .map_err(|error: OversizedFrame| error.to_string())
+        }
+    }
+}
+
+#[expect(clippy::unwrap_used, reason = "Test code")]
+#[cfg(test)]
+mod tests {
+    use rand::{Rng as _, SeedableRng as _, rngs::StdRng};
+
+    use super::*;
+
+    type U16FrameDecoder = VariableLengthFrameDecoder<2, U16LittleEndianDelimiter>;
+
+    fn encode_frames(frames: &[Vec<u8>]) -> Vec<u8> {
+        frames
+            .iter()
+            .flat_map(|frame| {
+                let length = u16::try_from(frame.len()).unwrap().to_le_bytes();
+                length.into_iter().chain(frame.iter().copied())
+            })
+            .collect()
+    }
+
+    fn decode_all(decoder: &mut U16FrameDecoder) -> Vec<Vec<u8>> {
+        let mut frames = vec![];
+        while let Some(frame) = decoder.next_frame_and_then(<[u8]>::to_vec).unwrap() {
+            frames.push(frame);
+        }
+        frames
+    }
+
+    #[test]
+    fn variable_length_frames_in_random_chunks() {
+        let mut rng = StdRng::seed_from_u64(0x5eed);
+        let frames: Vec<Vec<u8>> = (0..1000)
+            .map(|_| vec![rng.gen_range(0..=u8::MAX); rng.gen_range(0..300)])
+            .collect();
+        let data = encode_frames(&frames);
+
+        // Feed the data in random chunk sizes, decoding frames in between so that the ring buffer
+        // wraps around repeatedly
+        let mut decoder = U16FrameDecoder::new(vec![], usize::from(u16::MAX));
+        let mut decoded = vec![];
+        let mut remaining = data.as_slice();
+        while !remaining.is_empty() {
+            let (chunk, rest) = remaining.split_at(rng.gen_range(1..=remaining.len().min(512)));
+            let _ = decoder.add_chunks(&[chunk]);
+            decoded.extend(decode_all(&mut decoder));
+            remaining = rest;
+        }
+
+        assert_eq!(decoded, frames);
+        assert_eq!(decoder.required_length(), 2, "Should await the next delimiter");
+    }
+
+    #[test]
+    fn variable_length_frames_with_initial_data() {
+        let frames = vec![vec![1_u8; 3], vec![], vec![2_u8; 5]];
+        let data = encode_frames(&frames);
+        let (initial, rest) = data.split_at(4);
+
+        let mut decoder = U16FrameDecoder::new(initial.to_vec(), usize::from(u16::MAX));
+        assert_eq!(decode_all(&mut decoder), vec![], "Should wait for the first frame");
+        assert_eq!(decoder.required_length(), 1);
+        assert_eq!(decoder.add_chunks(&[rest]), rest.len().saturating_add(2));
+        assert_eq!(decode_all(&mut decoder), frames);
+    }
+
+    #[test]
+    fn variable_length_frame_exceeding_max_length() {
+        let mut decoder = U16FrameDecoder::new(vec![], 16);
+        let _ = decoder.add_chunks(&[&encode_frames(&[vec![0_u8; 16], vec![0_u8; 17]])]);
+
+        assert_eq!(
+            decoder.next_frame_and_then(<[u8]>::len).unwrap(),
+            Some(16),
+            "Should accept a frame of exactly the max length"
+        );
+        let error = decoder.next_frame_and_then(<[u8]>::len).unwrap_err();
+        assert_eq!((error.length, error.max_length), (17, 16));
+    }
+}
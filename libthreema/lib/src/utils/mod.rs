@@ -1,8 +1,14 @@
 //! Utilities.
 pub mod bytes;
 pub(crate) mod cache;
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub use cache::bench as cache_bench;
 pub(crate) mod debug;
 pub(crate) mod frame;
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub use frame::bench as frame_bench;
 pub mod logging;
 pub mod sequence_numbers;
 pub(crate) mod serde;
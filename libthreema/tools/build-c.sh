@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+function _print_usage() {
+    echo "Usage: $0 [--no-container]"
+    echo ""
+    echo "Options:"
+    echo "  --no-container       To not source the dev container environment."
+    echo "  -h,--help            Print this help and exit."
+}
+
+while [[ "$#" -gt 0 ]]; do
+    case $1 in
+        -h | --help)
+            _print_usage
+            exit 0
+            ;;
+        --no-container)
+            _no_container=1
+            ;;
+        *) echo "Unknown parameter passed: $1"; _print_usage; exit 1 ;;
+    esac
+    shift
+done
+
+# Clean and load dev container
+cd "$(dirname "$0")/.."
+[[ -d ./build/c ]] && rm -r ./build/c/
+
+if [[ -z ${_no_container+x} ]] ; then
+    source ./.devcontainer/env.sh
+fi
+
+# Build library
+cargo build -F c-ffi -p libthreema --release
+
+# Generate C header
+mkdir -p ./build/c
+cbindgen --config ./lib/cbindgen.toml --crate libthreema --output ./build/c/libthreema.h ./lib
+
+# Build the C binding tests
+cc -std=c11 -O2 -Wall -Wextra -Werror -I./build/c \
+    -o ./build/c/csp-load-test ./binding-tests/c/csp-load-test.c \
+    ./target/release/liblibthreema.a -lpthread -ldl -lm
+
+# Unload dev container if it was started
+if [[ -z ${_no_container+x} ]] ; then
+    deactivate --only-if-started
+fi
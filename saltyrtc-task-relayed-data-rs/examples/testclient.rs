@@ -273,7 +273,7 @@ fn main() {
             .downcast_mut::<RelayedDataTask>()
             .expect("Chosen task is not a RelayedDataTask");
 
-        // Get unbounded senders for outgoing messages
+        // Get senders for outgoing messages
         rd_task.get_sender().unwrap()
     };
 
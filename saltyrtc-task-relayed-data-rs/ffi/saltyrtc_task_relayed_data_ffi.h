@@ -23,6 +23,11 @@
 
 #define LEVEL_WARN 3
 
+/**
+ * Number of bytes added by encrypting data with the session keys (authentication tag).
+ */
+#define SESSION_KEYS_OVERHEAD 16
+
 /**
  * Result type with all potential connection error codes.
  *
@@ -95,6 +100,11 @@ enum salty_client_encrypt_decrypt_success_t {
    * The peer has not yet been determined.
    */
   ENCRYPT_DECRYPT_NO_PEER = 2,
+  /**
+   * The output buffer is too small. The required length has been written
+   * to `written`.
+   */
+  ENCRYPT_DECRYPT_BUFFER_TOO_SMALL = 3,
   /**
    * Other error
    */
@@ -182,6 +192,11 @@ enum salty_client_send_success_t {
    * Sending failed because the message was invalid
    */
   SEND_MESSAGE_ERROR = 2,
+  /**
+   * Sending failed because the outgoing channel is full.
+   * Nothing has been sent. Try again later.
+   */
+  SEND_WOULD_BLOCK = 3,
   /**
    * Sending failed
    */
@@ -299,24 +314,38 @@ typedef struct salty_channel_event_tx_t salty_channel_event_tx_t;
 /**
  * The channel for receiving incoming messages.
  *
- * On the Rust side, this is an `mpsc::UnboundedReceiver<MessageEvent>`.
+ * On the Rust side, this is a `QueueReceiver<MessageEvent>`.
  */
 typedef struct salty_channel_receiver_rx_t salty_channel_receiver_rx_t;
 
 /**
  * The channel for sending outgoing messages (receiving end).
  *
- * On the Rust side, this is an `mpsc::UnboundedReceiver<OutgoingMessage>`.
+ * On the Rust side, this is a `QueueReceiver<OutgoingMessage>`.
  */
 typedef struct salty_channel_sender_rx_t salty_channel_sender_rx_t;
 
 /**
  * The channel for sending outgoing messages (sending end).
  *
- * On the Rust side, this is an `mpsc::UnboundedSender<OutgoingMessage>`.
+ * On the Rust side, this is a `QueueSender<OutgoingMessage>`.
  */
 typedef struct salty_channel_sender_tx_t salty_channel_sender_tx_t;
 
+/**
+ * A reader validating the chunks of incoming messages.
+ *
+ * On the Rust side, this is a `ChunkReader`.
+ */
+typedef struct salty_chunk_reader_t salty_chunk_reader_t;
+
+/**
+ * A writer splitting a large message into chunks.
+ *
+ * On the Rust side, this is a `ChunkSender`.
+ */
+typedef struct salty_chunk_writer_t salty_chunk_writer_t;
+
 /**
  * A SaltyRTC client instance.
  *
@@ -331,13 +360,19 @@ typedef struct salty_client_t salty_client_t;
  */
 typedef struct salty_event_loop_t salty_event_loop_t;
 
+/**
+ * A pool of event loops, each running on its own worker thread.
+ *
+ * On the Rust side, this is an `EventLoopPool`.
+ */
+typedef struct salty_event_loop_pool_t salty_event_loop_pool_t;
+
 /**
  * A handshake future. This will be passed to the `salty_client_connect`
- * function.
+ * or `salty_client_connect_pooled` function.
  *
- * On the Rust side, this is a `Box<Box<Future<Item=WsClient, Error=SaltyError>>>`.
- * The double box is used because the inner box is actually a trait object fat
- * pointer, pointing to both the data and the vtable.
+ * On the Rust side, this is a `Box<Handshake>`. A handshake created for an
+ * event loop pool is only turned into a future on the worker that runs it.
  */
 typedef struct salty_handshake_future_t salty_handshake_future_t;
 
@@ -346,6 +381,16 @@ typedef struct salty_handshake_future_t salty_handshake_future_t;
  */
 typedef struct salty_keypair_t salty_keypair_t;
 
+/**
+ * A readiness notifier for a receiving channel.
+ *
+ * Its file descriptor (see `salty_readiness_fd`) becomes readable when the
+ * channel it has been armed for has data available or has ended.
+ *
+ * On the Rust side, this is an `Arc<Readiness>`.
+ */
+typedef struct salty_readiness_t salty_readiness_t;
+
 /**
  * A remote handle to an event loop instance.
  *
@@ -353,6 +398,73 @@ typedef struct salty_keypair_t salty_keypair_t;
  */
 typedef struct salty_remote_t salty_remote_t;
 
+/**
+ * Allocation counters of the library.
+ *
+ * Only available if the library was built with the `alloc-stats` feature.
+ */
+typedef struct {
+  /**
+   * The number of allocations.
+   */
+  uint64_t allocations;
+  /**
+   * The number of deallocations.
+   */
+  uint64_t deallocations;
+  /**
+   * The number of reallocations.
+   */
+  uint64_t reallocations;
+  /**
+   * The number of bytes allocated in total (including growing reallocations).
+   */
+  uint64_t allocated_bytes;
+} salty_alloc_stats_t;
+
+/**
+ * Statistics of a message channel.
+ */
+typedef struct {
+  /**
+   * The capacity of the channel, `0` if unbounded.
+   */
+  uint64_t capacity;
+  /**
+   * The number of messages currently queued.
+   */
+  uint64_t depth;
+  /**
+   * The highest number of messages queued at the same time.
+   */
+  uint64_t high_water;
+  /**
+   * The number of messages that have been enqueued in total.
+   */
+  uint64_t total;
+  /**
+   * The number of times a message could not be enqueued because the
+   * channel was full.
+   */
+  uint64_t full;
+} salty_channel_stats_t;
+
+/**
+ * A chunk of a large message.
+ *
+ * The `data` field points to the chunk data (without the chunk header).
+ * The data of all chunks with the same `message_id`, in the order of their
+ * `serial`, forms the message. The last chunk of a message has
+ * `end_of_message` set.
+ */
+typedef struct {
+  uint32_t message_id;
+  uint32_t serial;
+  bool end_of_message;
+  const uint8_t *data;
+  uintptr_t data_len;
+} salty_chunk_t;
+
 /**
  * The return value when encrypting or decrypting raw data.
  *
@@ -433,8 +545,62 @@ typedef struct {
   const salty_msg_t *msg;
 } salty_client_recv_msg_ret_t;
 
+/**
+ * The return value when trying to receive a batch of messages.
+ *
+ * Note: Before accessing `msgs`, make sure to check the `success` field
+ * for errors. If an error occurred, the `msgs` field will be `null`.
+ * Otherwise, `msgs` points to an array of `msgs_len` messages (at least one).
+ */
+typedef struct {
+  salty_client_recv_success_t success;
+  const salty_msg_t *msgs;
+  uintptr_t msgs_len;
+} salty_client_recv_msgs_ret_t;
+
+/**
+ * The return value when trying to receive a chunk.
+ *
+ * Note: Before accessing `chunk` or `msg`, make sure to check the `success`
+ * field for errors. If an error occurred, both fields will be `null`.
+ * Otherwise, exactly one of them is set: `chunk` for a chunk, `msg` for any
+ * other message (an application message, a close message or a task message
+ * that is not a chunk).
+ */
+typedef struct {
+  salty_client_recv_success_t success;
+  const salty_chunk_t *chunk;
+  const salty_msg_t *msg;
+} salty_client_recv_chunk_ret_t;
+
+/**
+ * A borrowed byte buffer, used to pass multiple messages at once.
+ */
+typedef struct {
+  const uint8_t *iov_base;
+  size_t iov_len;
+} salty_iovec_t;
+
 typedef void (*LogFunction)(uint8_t level, const char *target, const char *message);
 
+/**
+ * Capacities of the incoming and outgoing message channels.
+ *
+ * A capacity is the maximum number of messages that may be queued in
+ * the channel. Set a capacity to `0` for an unbounded channel.
+ *
+ * If the incoming channel is full, the client stops reading messages from
+ * the peer until the application has received some of the queued messages.
+ * Outgoing messages are still sent in the meantime, but other protocol
+ * handling (e.g. answering pings or a close initiated by the peer) waits
+ * until the application receives again.
+ * If the outgoing channel is full, sending returns `SEND_WOULD_BLOCK`.
+ */
+typedef struct {
+  uint32_t incoming;
+  uint32_t outgoing;
+} salty_channel_capacities_t;
+
 /**
  * The return value when creating a new client instance.
  *
@@ -452,6 +618,22 @@ typedef struct {
   const salty_channel_disconnect_rx_t *disconnect_rx;
 } salty_relayed_data_client_ret_t;
 
+/**
+ * Get the allocation counters of the library.
+ *
+ * The counters include all heap allocations done by the library (on any
+ * thread) since it was loaded. To get the allocations of an operation,
+ * subtract the counters before the operation from the counters after it.
+ *
+ * Parameters:
+ *     stats (`*salty_alloc_stats_t`, borrowed):
+ *         Receives the counters.
+ * Returns:
+ *     `false` if `stats` is `null` or if the library was built without
+ *     the `alloc-stats` feature, `true` otherwise.
+ */
+bool salty_alloc_stats(salty_alloc_stats_t *stats);
+
 /**
  * Free a `salty_channel_disconnect_rx_t` instance.
  */
@@ -477,6 +659,17 @@ void salty_channel_event_tx_free(const salty_channel_event_tx_t *ptr);
  */
 void salty_channel_receiver_rx_free(const salty_channel_receiver_rx_t *ptr);
 
+/**
+ * Get the statistics of the incoming message channel.
+ *
+ * Parameters:
+ *     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+ *         The receiving end of the channel for incoming message events.
+ * Returns:
+ *     A `salty_channel_stats_t` struct. If `receiver_rx` is `null`, all fields are `0`.
+ */
+salty_channel_stats_t salty_channel_receiver_rx_stats(const salty_channel_receiver_rx_t *receiver_rx);
+
 /**
  * Free a `salty_channel_sender_rx_t` instance.
  */
@@ -487,6 +680,104 @@ void salty_channel_sender_rx_free(const salty_channel_sender_rx_t *ptr);
  */
 void salty_channel_sender_tx_free(const salty_channel_sender_tx_t *ptr);
 
+/**
+ * Get the statistics of the outgoing message channel.
+ *
+ * Parameters:
+ *     sender_tx (`*salty_channel_sender_tx_t`, borrowed):
+ *         The sending end of the channel for outgoing messages.
+ * Returns:
+ *     A `salty_channel_stats_t` struct. If `sender_tx` is `null`, all fields are `0`.
+ */
+salty_channel_stats_t salty_channel_sender_tx_stats(const salty_channel_sender_tx_t *sender_tx);
+
+/**
+ * Free a `salty_chunk_reader_t` instance.
+ */
+void salty_chunk_reader_free(const salty_chunk_reader_t *reader);
+
+/**
+ * Create a reader for incoming chunked messages.
+ *
+ * The reader hands out the chunks of every message in order. Chunks that
+ * arrive before one of their predecessors are buffered until the missing
+ * chunks have arrived. Concatenating the data of the chunks is up to the
+ * caller.
+ *
+ * Note: The reader must be explicitly freed with `salty_chunk_reader_free`!
+ */
+const salty_chunk_reader_t *salty_chunk_reader_new(void);
+
+/**
+ * Send the last chunk of a chunked message.
+ *
+ * If the outgoing channel is full, `SEND_WOULD_BLOCK` is returned. Call
+ * this function again once the channel has room.
+ *
+ * Parameters:
+ *     writer (`*salty_chunk_writer_t`, borrowed):
+ *         The chunk writer.
+ */
+salty_client_send_success_t salty_chunk_writer_finish(const salty_chunk_writer_t *writer);
+
+/**
+ * Free a `salty_chunk_writer_t` instance.
+ *
+ * Chunks that have not been enqueued yet are discarded.
+ */
+void salty_chunk_writer_free(const salty_chunk_writer_t *writer);
+
+/**
+ * Create a writer that sends a large message in chunks.
+ *
+ * The message is split into task messages of at most `chunk_size` bytes
+ * while it is being written, so it never needs to be held in memory as a
+ * whole, neither by the sender nor by the receiver. Every chunk starts with
+ * a 9 byte header, compatible with the reliable/ordered mode of chunked-dc.
+ *
+ * Note: The writer must be explicitly freed with `salty_chunk_writer_free`!
+ *
+ * Parameters:
+ *     sender_tx (`*salty_channel_sender_tx_t`, borrowed):
+ *         The sending end of the channel for outgoing messages.
+ *     message_id (`uint32_t`, copied):
+ *         The id of the message. It must not be used by another chunked
+ *         message that is being sent at the same time.
+ *     chunk_size (`uint32_t`, copied):
+ *         The maximum size of a chunk in bytes, including the header. Must
+ *         be larger than 9.
+ * Returns:
+ *     A writer, or `null` if an argument is invalid.
+ */
+const salty_chunk_writer_t *salty_chunk_writer_new(const salty_channel_sender_tx_t *sender_tx,
+                                                   uint32_t message_id,
+                                                   uint32_t chunk_size);
+
+/**
+ * Write data to a chunked message.
+ *
+ * The data is copied into the current chunk. Complete chunks are enqueued
+ * in the outgoing channel.
+ *
+ * If the outgoing channel is full, `SEND_WOULD_BLOCK` is returned and only
+ * the first `*written` bytes have been consumed. Call this function again
+ * with the remaining data once the channel has room.
+ *
+ * Parameters:
+ *     writer (`*salty_chunk_writer_t`, borrowed):
+ *         The chunk writer.
+ *     data (`*uint8_t`, borrowed):
+ *         Pointer to the data.
+ *     data_len (`size_t`, copied):
+ *         Length of the data.
+ *     written (`*size_t`, borrowed):
+ *         Receives the number of bytes that have been consumed.
+ */
+salty_client_send_success_t salty_chunk_writer_write(const salty_chunk_writer_t *writer,
+                                                     const uint8_t *data,
+                                                     size_t data_len,
+                                                     size_t *written);
+
 /**
  * Connect to the specified SaltyRTC server, do the server and peer handshake
  * and run the task loop.
@@ -496,14 +787,16 @@ void salty_channel_sender_tx_free(const salty_channel_sender_tx_t *ptr);
  *
  * Parameters:
  *     handshake_future (`*salty_handshake_future_t`, moved):
- *         Pointer to the handshake future, created with `salty_client_init`.
+ *         Pointer to the handshake future, created with `salty_client_init`
+ *         or `salty_client_init_pooled`.
  *     client (`*salty_client_t`, borrowed):
  *         Pointer to a `salty_client_t` instance.
  *     event_loop (`*salty_event_loop_t`, borrowed):
  *         The event loop that is also associated with the task.
  *     event_tx (`*salty_channel_event_tx_t`, moved):
  *         The sending end of the channel for incoming events.
- *         This object is returned from `salty_client_init`.
+ *         This object is returned from `salty_client_init` or
+ *         `salty_client_init_pooled`.
  *     sender_rx (`*salty_channel_sender_rx_t`, moved):
  *         The receiving end of the channel for outgoing messages.
  *         This object is returned when creating a client instance.
@@ -518,6 +811,57 @@ salty_client_connect_success_t salty_client_connect(const salty_handshake_future
                                                     const salty_channel_sender_rx_t *sender_rx,
                                                     const salty_channel_disconnect_rx_t *disconnect_rx);
 
+/**
+ * Connect to the specified SaltyRTC server on a worker of an event loop pool,
+ * do the server and peer handshake and run the task loop.
+ *
+ * In contrast to `salty_client_connect`, this call does not block. The
+ * connection runs on the worker until it has been terminated. The result of
+ * the connection is logged.
+ *
+ * Parameters:
+ *     handshake_future (`*salty_handshake_future_t`, moved):
+ *         Pointer to the handshake future, created with `salty_client_init_pooled`.
+ *     client (`*salty_client_t`, borrowed):
+ *         Pointer to a `salty_client_t` instance.
+ *     pool (`*salty_event_loop_pool_t`, borrowed):
+ *         The event loop pool.
+ *     worker (`uint32_t`, copied):
+ *         The worker that is also associated with the task, i.e. the worker
+ *         whose remote handle has been used to create the client.
+ *     event_tx (`*salty_channel_event_tx_t`, moved):
+ *         The sending end of the channel for incoming events.
+ *         This object is returned from `salty_client_init_pooled`.
+ *     sender_rx (`*salty_channel_sender_rx_t`, moved):
+ *         The receiving end of the channel for outgoing messages.
+ *         This object is returned when creating a client instance.
+ *     disconnect_rx (`*salty_channel_disconnect_rx_t`, moved):
+ *         The receiving end of the channel for closing the connection.
+ *         This object is returned when creating a client instance.
+ * Returns:
+ *     `CONNECT_OK` if the connection has been started on the worker.
+ */
+salty_client_connect_success_t salty_client_connect_pooled(const salty_handshake_future_t *handshake_future,
+                                                           const salty_client_t *client,
+                                                           const salty_event_loop_pool_t *pool,
+                                                           uint32_t worker,
+                                                           const salty_channel_event_tx_t *event_tx,
+                                                           const salty_channel_sender_rx_t *sender_rx,
+                                                           const salty_channel_disconnect_rx_t *disconnect_rx);
+
+/**
+ * Return the number of bytes written by `salty_client_decrypt_with_session_keys_into`
+ * when decrypting `data_len` bytes.
+ *
+ * If `data_len` is smaller than `SESSION_KEYS_OVERHEAD`, the data cannot be
+ * decrypted and `0` is returned.
+ *
+ * Parameters:
+ *     data_len (`size_t`, copied):
+ *         Number of bytes that should be decrypted.
+ */
+size_t salty_client_decrypt_required_len(size_t data_len);
+
 /**
  * Decrypt raw bytes using the session keys after the handshake has been finished.
  *
@@ -539,6 +883,38 @@ salty_client_encrypt_decrypt_ret_t salty_client_decrypt_with_session_keys(const
                                                                           size_t data_len,
                                                                           const uint8_t *nonce);
 
+/**
+ * Decrypt raw bytes using the session keys after the handshake has been finished
+ * and write the result into a buffer provided by the caller.
+ *
+ * In contrast to `salty_client_decrypt_with_session_keys`, nothing needs to be freed
+ * afterwards. Decrypting in-place is allowed: `out` may point to `data`.
+ *
+ * Parameters:
+ *     client (`*salty_client_t`, borrowed):
+ *         Pointer to a `salty_client_t` instance.
+ *     data (`*uint8_t`, borrowed):
+ *         Pointer to the data that should be decrypted.
+ *     data_len (`size_t`, copied):
+ *         Number of bytes in the `data` array.
+ *     nonce (`*uint8_t`, borrowed):
+ *         Pointer to a 24 byte array containing the nonce used for decryption.
+ *     out (`*uint8_t`, borrowed):
+ *         Pointer to the buffer the plaintext is written to.
+ *     out_len (`size_t`, copied):
+ *         Number of bytes available in the `out` buffer.
+ *     written (`*size_t`, borrowed):
+ *         Receives the number of bytes written to `out`. If the buffer is too small,
+ *         it receives the required length instead.
+ */
+salty_client_encrypt_decrypt_success_t salty_client_decrypt_with_session_keys_into(const salty_client_t *client,
+                                                                                   const uint8_t *data,
+                                                                                   size_t data_len,
+                                                                                   const uint8_t *nonce,
+                                                                                   uint8_t *out,
+                                                                                   size_t out_len,
+                                                                                   size_t *written);
+
 /**
  * Close the connection.
  *
@@ -567,6 +943,16 @@ salty_client_disconnect_success_t salty_client_disconnect(const salty_channel_di
 void salty_client_encrypt_decrypt_free(const uint8_t *data,
                                        size_t data_len);
 
+/**
+ * Return the number of bytes written by `salty_client_encrypt_with_session_keys_into`
+ * when encrypting `data_len` bytes.
+ *
+ * Parameters:
+ *     data_len (`size_t`, copied):
+ *         Number of bytes that should be encrypted.
+ */
+size_t salty_client_encrypt_required_len(size_t data_len);
+
 /**
  * Encrypt raw bytes using the session keys after the handshake has been finished.
  *
@@ -588,6 +974,39 @@ salty_client_encrypt_decrypt_ret_t salty_client_encrypt_with_session_keys(const
                                                                           size_t data_len,
                                                                           const uint8_t *nonce);
 
+/**
+ * Encrypt raw bytes using the session keys after the handshake has been finished
+ * and write the result into a buffer provided by the caller.
+ *
+ * In contrast to `salty_client_encrypt_with_session_keys`, nothing needs to be freed
+ * afterwards. Encrypting in-place is allowed: `out` may point to `data` as long as the
+ * buffer can hold `salty_client_encrypt_required_len(data_len)` bytes.
+ *
+ * Parameters:
+ *     client (`*salty_client_t`, borrowed):
+ *         Pointer to a `salty_client_t` instance.
+ *     data (`*uint8_t`, borrowed):
+ *         Pointer to the data that should be encrypted.
+ *     data_len (`size_t`, copied):
+ *         Number of bytes in the `data` array.
+ *     nonce (`*uint8_t`, borrowed):
+ *         Pointer to a 24 byte array containing the nonce used for encryption.
+ *     out (`*uint8_t`, borrowed):
+ *         Pointer to the buffer the ciphertext is written to.
+ *     out_len (`size_t`, copied):
+ *         Number of bytes available in the `out` buffer.
+ *     written (`*size_t`, borrowed):
+ *         Receives the number of bytes written to `out`. If the buffer is too small,
+ *         it receives the required length instead.
+ */
+salty_client_encrypt_decrypt_success_t salty_client_encrypt_with_session_keys_into(const salty_client_t *client,
+                                                                                   const uint8_t *data,
+                                                                                   size_t data_len,
+                                                                                   const uint8_t *nonce,
+                                                                                   uint8_t *out,
+                                                                                   size_t out_len,
+                                                                                   size_t *written);
+
 /**
  * Prepare a connection to the specified SaltyRTC server, but do not connect yet.
  *
@@ -617,6 +1036,77 @@ salty_client_init_ret_t salty_client_init(const char *host,
                                           const uint8_t *ca_cert,
                                           uint32_t ca_cert_len);
 
+/**
+ * Prepare a connection that will be run on an event loop pool, but do not
+ * connect yet.
+ *
+ * The handshake future is created on the worker that runs the connection
+ * (see `salty_client_connect_pooled`).
+ *
+ * Parameters:
+ *     host (`*c_char`, null terminated, borrowed):
+ *         Null terminated UTF-8 encoded C string containing the SaltyRTC server hostname.
+ *     port (`*uint16_t`, copied):
+ *         SaltyRTC server port.
+ *     client (`*salty_client_t`, borrowed):
+ *         Pointer to a `salty_client_t` instance.
+ *     timeout_s (`uint16_t`, copied):
+ *         Connection and handshake timeout in seconds. Set value to `0` for no timeout.
+ *     ca_cert (`*uint8_t` or `NULL`, borrowed):
+ *         Optional pointer to bytes of a DER encoded CA certificate.
+ *         When no certificate is set, the OS trust chain is used.
+ *     ca_cert_len (`uint32_t`, copied):
+ *         When the `ca_cert` argument is not `NULL`, then this must be
+ *         set to the number of certificate bytes. Otherwise, set it to 0.
+ */
+salty_client_init_ret_t salty_client_init_pooled(const char *host,
+                                                 uint16_t port,
+                                                 const salty_client_t *client,
+                                                 uint16_t timeout_s,
+                                                 const uint8_t *ca_cert,
+                                                 uint32_t ca_cert_len);
+
+/**
+ * Receive a chunk (or another message) from the incoming channel.
+ *
+ * Task messages containing binary data are treated as chunks. The chunks of
+ * a message are handed out in order, as soon as all of their predecessors
+ * have been handed out. All other messages are returned like
+ * `salty_client_recv_msg` does. This includes binary task messages that are
+ * not a valid chunk, that repeat a chunk that has already been received,
+ * that belong to one of the last 1024 completed messages, or that arrive
+ * early while too many early chunks are buffered. Early chunks that claim to
+ * follow the last chunk of their message are dropped once the message has
+ * been completed.
+ *
+ * Note: The return value must be explicitly freed with
+ * `salty_client_recv_chunk_ret_free`!
+ *
+ * Parameters:
+ *     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+ *         The receiving end of the channel for incoming message events.
+ *     reader (`*salty_chunk_reader_t`, borrowed):
+ *         The chunk reader. Use the same reader for all calls on a channel.
+ *     timeout_ms (`*uint32_t`, borrowed):
+ *         - If this is `null`, then the function call will block.
+ *         - If this is `0`, then the function will never block. It will either return a chunk
+ *         (or message) or `RECV_NO_DATA`.
+ *         - If this is a value > 0, then the specified timeout in milliseconds will be used.
+ *         Either a chunk (or message) or `RECV_NO_DATA` (in the case of a timeout) will be
+ *         returned.
+ * Returns:
+ *     `RECV_NO_DATA` if only chunks arrived that are waiting for one of
+ *     their predecessors.
+ */
+salty_client_recv_chunk_ret_t salty_client_recv_chunk(const salty_channel_receiver_rx_t *receiver_rx,
+                                                      const salty_chunk_reader_t *reader,
+                                                      const uint32_t *timeout_ms);
+
+/**
+ * Free a `salty_client_recv_chunk_ret_t` instance.
+ */
+void salty_client_recv_chunk_ret_free(salty_client_recv_chunk_ret_t recv_ret);
+
 /**
  * Receive an event from the incoming channel.
  *
@@ -638,6 +1128,24 @@ salty_client_recv_event_ret_t salty_client_recv_event(const salty_channel_event_
  */
 void salty_client_recv_event_ret_free(salty_client_recv_event_ret_t recv_ret);
 
+/**
+ * Receive an event from the incoming channel without blocking.
+ *
+ * If no event is available, `RECV_NO_DATA` is returned and the readiness
+ * notifier is armed: Its file descriptor becomes readable as soon as an event
+ * is available or the channel has ended.
+ *
+ * Note: The returned event must be freed with `salty_client_recv_event_ret_free`.
+ *
+ * Parameters:
+ *     event_rx (`*salty_channel_event_rx_t`, borrowed):
+ *         The receiving end of the channel for incoming events.
+ *     readiness (`*salty_readiness_t`, borrowed):
+ *         The readiness notifier used for this channel.
+ */
+salty_client_recv_event_ret_t salty_client_recv_event_notify(const salty_channel_event_rx_t *event_rx,
+                                                             const salty_readiness_t *readiness);
+
 /**
  * Receive a message from the incoming channel.
  *
@@ -659,6 +1167,59 @@ salty_client_recv_msg_ret_t salty_client_recv_msg(const salty_channel_receiver_r
  */
 void salty_client_recv_msg_ret_free(salty_client_recv_msg_ret_t recv_ret);
 
+/**
+ * Receive up to `max_msgs` messages from the incoming channel.
+ *
+ * The call waits for the first message according to `timeout_ms`. Then, all
+ * messages that are already queued are returned as well (without waiting),
+ * until `max_msgs` is reached or a close message has been received.
+ *
+ * A message that cannot be converted is skipped and the remaining messages
+ * are returned. Only if no message could be converted, `RECV_ERROR` is
+ * returned.
+ *
+ * Note: The returned messages must be explicitly freed with
+ * `salty_client_recv_msgs_ret_free`!
+ *
+ * Parameters:
+ *     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+ *         The receiving end of the channel for incoming message events.
+ *     max_msgs (`size_t`, copied):
+ *         Maximum number of messages to return. Must be at least 1.
+ *     timeout_ms (`*uint32_t`, borrowed):
+ *         - If this is `null`, then the function call will block.
+ *         - If this is `0`, then the function will never block. It will either return messages
+ *         or `RECV_NO_DATA`.
+ *         - If this is a value > 0, then the specified timeout in milliseconds will be used.
+ *         Either messages or `RECV_NO_DATA` (in the case of a timeout) will be returned.
+ */
+salty_client_recv_msgs_ret_t salty_client_recv_msg_batch(const salty_channel_receiver_rx_t *receiver_rx,
+                                                         size_t max_msgs,
+                                                         const uint32_t *timeout_ms);
+
+/**
+ * Free a `salty_client_recv_msgs_ret_t` instance.
+ */
+void salty_client_recv_msgs_ret_free(salty_client_recv_msgs_ret_t recv_ret);
+
+/**
+ * Receive a message from the incoming channel without blocking.
+ *
+ * If no message is available, `RECV_NO_DATA` is returned and the readiness
+ * notifier is armed: Its file descriptor becomes readable as soon as a message
+ * is available or the channel has ended.
+ *
+ * Note: The returned message must be freed with `salty_client_recv_msg_ret_free`.
+ *
+ * Parameters:
+ *     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+ *         The receiving end of the channel for incoming message events.
+ *     readiness (`*salty_readiness_t`, borrowed):
+ *         The readiness notifier used for this channel.
+ */
+salty_client_recv_msg_ret_t salty_client_recv_msg_notify(const salty_channel_receiver_rx_t *receiver_rx,
+                                                         const salty_readiness_t *readiness);
+
 /**
  * Send an application message through the outgoing channel.
  *
@@ -674,6 +1235,29 @@ salty_client_send_success_t salty_client_send_application_bytes(const salty_chan
                                                                 const uint8_t *msg,
                                                                 uint32_t msg_len);
 
+/**
+ * Send multiple application messages through the outgoing channel.
+ *
+ * All messages are validated before the first one is sent. If any message
+ * is invalid, or if the outgoing channel does not have room for all of
+ * them, nothing is sent.
+ *
+ * A batch may contain at most as many messages as the capacity of a
+ * bounded outgoing channel. Larger batches are rejected with
+ * `SEND_MESSAGE_ERROR`, since retrying them would never succeed.
+ *
+ * Parameters:
+ *     sender_tx (`*salty_channel_sender_tx_t`, borrowed):
+ *         The sending end of the channel for outgoing messages.
+ *     msgs (`*salty_iovec_t`, borrowed):
+ *         Pointer to an array of message buffers.
+ *     msgs_count (`size_t`, copied):
+ *         Number of entries in the `msgs` array.
+ */
+salty_client_send_success_t salty_client_send_application_bytes_batch(const salty_channel_sender_tx_t *sender_tx,
+                                                                      const salty_iovec_t *msgs,
+                                                                      size_t msgs_count);
+
 /**
  * Send a task message through the outgoing channel.
  *
@@ -689,6 +1273,29 @@ salty_client_send_success_t salty_client_send_task_bytes(const salty_channel_sen
                                                          const uint8_t *msg,
                                                          uint32_t msg_len);
 
+/**
+ * Send multiple task messages through the outgoing channel.
+ *
+ * All messages are validated before the first one is sent. If any message
+ * is invalid, or if the outgoing channel does not have room for all of
+ * them, nothing is sent.
+ *
+ * A batch may contain at most as many messages as the capacity of a
+ * bounded outgoing channel. Larger batches are rejected with
+ * `SEND_MESSAGE_ERROR`, since retrying them would never succeed.
+ *
+ * Parameters:
+ *     sender_tx (`*salty_channel_sender_tx_t`, borrowed):
+ *         The sending end of the channel for outgoing messages.
+ *     msgs (`*salty_iovec_t`, borrowed):
+ *         Pointer to an array of message buffers.
+ *     msgs_count (`size_t`, copied):
+ *         Number of entries in the `msgs` array.
+ */
+salty_client_send_success_t salty_client_send_task_bytes_batch(const salty_channel_sender_tx_t *sender_tx,
+                                                               const salty_iovec_t *msgs,
+                                                               size_t msgs_count);
+
 /**
  * Free an event loop instance.
  */
@@ -725,6 +1332,73 @@ const salty_remote_t *salty_event_loop_get_remote(const salty_event_loop_t *ptr)
  */
 const salty_event_loop_t *salty_event_loop_new(void);
 
+/**
+ * Return the number of connections currently running on an event loop pool.
+ *
+ * If the pointer passed in is `null`, an error is logged and `0` is returned.
+ */
+uint32_t salty_event_loop_pool_connections(const salty_event_loop_pool_t *pool);
+
+/**
+ * Free an event loop pool.
+ *
+ * This stops all worker threads and waits for them to terminate.
+ * Connections that are still running are aborted, so disconnect all
+ * clients first.
+ */
+void salty_event_loop_pool_free(const salty_event_loop_pool_t *pool);
+
+/**
+ * Return a remote handle of a worker's event loop.
+ *
+ * Thread safety:
+ *     The `salty_remote_t` instance may be used from any thread.
+ * Ownership:
+ *     The `salty_remote_t` instance must be freed through `salty_event_loop_free_remote`,
+ *     or by moving it into a `salty_client_t` instance.
+ * Returns:
+ *     A reference to the remote handle.
+ *     If the pool pointer is `null` or the worker index is invalid, an error
+ *     is logged and `null` is returned.
+ */
+const salty_remote_t *salty_event_loop_pool_get_remote(const salty_event_loop_pool_t *pool,
+                                                        uint32_t worker);
+
+/**
+ * Create a new event loop pool.
+ *
+ * Every worker thread runs its own event loop. Connections started with
+ * `salty_client_connect_pooled` run on the worker they were assigned to
+ * until they have ended.
+ *
+ * Parameters:
+ *     workers (`uint32_t`, copied):
+ *         The number of worker threads. Set this to `0` to use one worker
+ *         per available CPU.
+ * Returns:
+ *     Either a pointer to the pool, or `null` if the worker threads could
+ *     not be started. In the case of a failure, the error will be logged.
+ */
+const salty_event_loop_pool_t *salty_event_loop_pool_new(uint32_t workers);
+
+/**
+ * Choose the worker for a new client.
+ *
+ * This is the worker with the fewest running connections. Use the same
+ * worker index for `salty_event_loop_pool_get_remote` and
+ * `salty_client_connect_pooled`.
+ *
+ * If the pointer passed in is `null`, an error is logged and `0` is returned.
+ */
+uint32_t salty_event_loop_pool_next_worker(const salty_event_loop_pool_t *pool);
+
+/**
+ * Return the number of worker threads of an event loop pool.
+ *
+ * If the pointer passed in is `null`, an error is logged and `0` is returned.
+ */
+uint32_t salty_event_loop_pool_workers(const salty_event_loop_pool_t *pool);
+
 /**
  * Free a `KeyPair` instance.
  *
@@ -789,6 +1463,23 @@ const salty_keypair_t *salty_keypair_restore(const uint8_t *ptr);
  */
 bool salty_log_change_level_console(uint8_t level);
 
+/**
+ * Change the log level of the ring buffer logger.
+ *
+ * This works for loggers initialized with `salty_log_init_ring` and
+ * `salty_log_init_callback_async`. Records that are already in the ring
+ * buffer are kept.
+ *
+ * Parameters:
+ *     level (uint8_t, copied):
+ *         The log level, must be in the range 0 (TRACE) to 5 (OFF).
+ *         See `LEVEL_*` constants for reference.
+ * Returns:
+ *     A boolean indicating whether logging was updated successfully.
+ *     If updating the logger failed, an error message will be written to stdout.
+ */
+bool salty_log_change_level_ring(uint8_t level);
+
 /**
  * Initialize logging with a custom callback function that will be called for every log.
  *
@@ -806,6 +1497,33 @@ bool salty_log_change_level_console(uint8_t level);
 bool salty_log_init_callback(LogFunction callback,
                              uint8_t level);
 
+/**
+ * Initialize logging with a callback function that is called on a separate thread.
+ *
+ * Like `salty_log_init_ring`, the log records are stored in a ring buffer
+ * without blocking. A logging thread drains the ring buffer and calls the
+ * callback function for every record, so a slow callback does not stall
+ * the event loop.
+ *
+ * Parameters:
+ *     callback:
+ *         Pointer to a function with the signature
+ *         `(uint8_t level, char* target, char* message)`.
+ *         The strings are only valid during the call.
+ *     level (uint8_t, copied):
+ *         The log level, must be in the range 0 (TRACE) to 5 (OFF).
+ *         See `LEVEL_*` constants for reference.
+ *     capacity (uint32_t, copied):
+ *         The number of log records the ring buffer can hold. This is
+ *         rounded up to the next power of two.
+ * Returns:
+ *     A boolean indicating whether logging was setup successfully.
+ *     If setting up the logger failed, an error message will be written to stdout.
+ */
+bool salty_log_init_callback_async(LogFunction callback,
+                                   uint8_t level,
+                                   uint32_t capacity);
+
 /**
  * Initialize logging to stdout with log messages up to the specified log level.
  *
@@ -819,6 +1537,97 @@ bool salty_log_init_callback(LogFunction callback,
  */
 bool salty_log_init_console(uint8_t level);
 
+/**
+ * Initialize logging into a ring buffer with log messages up to the specified log level.
+ *
+ * Logging never blocks: The log records are stored in a ring buffer and
+ * must be pulled with `salty_log_ring_drain`. If the ring buffer is full,
+ * new records are dropped and counted (see `salty_log_ring_dropped`).
+ *
+ * Messages longer than 511 bytes are truncated.
+ *
+ * Parameters:
+ *     level (uint8_t, copied):
+ *         The log level, must be in the range 0 (TRACE) to 5 (OFF).
+ *         See `LEVEL_*` constants for reference.
+ *     capacity (uint32_t, copied):
+ *         The number of log records the ring buffer can hold. This is
+ *         rounded up to the next power of two.
+ * Returns:
+ *     A boolean indicating whether logging was setup successfully.
+ *     If setting up the logger failed, an error message will be written to stdout.
+ */
+bool salty_log_init_ring(uint8_t level,
+                         uint32_t capacity);
+
+/**
+ * Pull log records out of the ring buffer.
+ *
+ * The callback function is called on the calling thread for every record,
+ * oldest first.
+ *
+ * Parameters:
+ *     callback:
+ *         Pointer to a function with the signature
+ *         `(uint8_t level, char* target, char* message)`.
+ *         The strings are only valid during the call.
+ *     max_records (uint32_t, copied):
+ *         The maximum number of records to pull.
+ * Returns:
+ *     The number of records passed to the callback function. If no ring
+ *     buffer logger is initialized, `0` is returned.
+ */
+uint32_t salty_log_ring_drain(LogFunction callback,
+                              uint32_t max_records);
+
+/**
+ * Return the number of log records that were dropped because the ring
+ * buffer was full.
+ *
+ * If no ring buffer logger is initialized, `0` is returned.
+ */
+uint64_t salty_log_ring_dropped(void);
+
+/**
+ * Return the file descriptor of a readiness notifier.
+ *
+ * The file descriptor is owned by the notifier and must not be closed.
+ *
+ * Parameters:
+ *     readiness (`*salty_readiness_t`, borrowed):
+ *         Pointer to a readiness notifier.
+ * Returns:
+ *     The file descriptor or `-1` if `readiness` is `null`.
+ */
+int salty_readiness_fd(const salty_readiness_t *readiness);
+
+/**
+ * Free a readiness notifier.
+ *
+ * The file descriptor is closed once the channel the notifier has been armed
+ * for does not reference it anymore.
+ */
+void salty_readiness_free(const salty_readiness_t *readiness);
+
+/**
+ * Create a new readiness notifier.
+ *
+ * A readiness notifier allows to wait for many receiving channels (e.g. of
+ * many clients) on a single thread with `poll`, `epoll` or `kqueue`:
+ *
+ * 1. Create one notifier per receiving channel.
+ * 2. Receive with `salty_client_recv_msg_notify` or `salty_client_recv_event_notify`
+ *    until `RECV_NO_DATA` is returned. This arms the notifier.
+ * 3. Wait until the file descriptor returned by `salty_readiness_fd` becomes
+ *    readable, then continue with step 2.
+ *
+ * Do not read from the file descriptor, it is drained by the receive functions.
+ *
+ * Returns:
+ *     A pointer to the notifier or `null` if the underlying pipe could not be created.
+ */
+const salty_readiness_t *salty_readiness_new(void);
+
 /**
  * Get a pointer to the auth token bytes from a `salty_client_t` instance.
  *
@@ -840,6 +1649,9 @@ void salty_relayed_data_client_free(const salty_client_t *ptr);
 /**
  * Initialize a new SaltyRTC client as initiator with the Relayed Data task.
  *
+ * The message channels are unbounded. Use
+ * `salty_relayed_data_initiator_new_bounded` to limit them.
+ *
  * Parameters:
  *     keypair (`*salty_keypair_t`, moved):
  *         Pointer to a key pair.
@@ -863,9 +1675,42 @@ salty_relayed_data_client_ret_t salty_relayed_data_initiator_new(const salty_key
                                                                  const uint8_t *trusted_responder_key,
                                                                  const uint8_t *server_public_permanent_key);
 
+/**
+ * Initialize a new SaltyRTC client as initiator with the Relayed Data task
+ * and bounded message channels.
+ *
+ * Parameters:
+ *     keypair (`*salty_keypair_t`, moved):
+ *         Pointer to a key pair.
+ *     remote (`*salty_remote_t`, moved):
+ *         Pointer to an event loop remote handle.
+ *     ping_interval_seconds (`uint32_t`, copied):
+ *         Request that the server sends a WebSocket ping message at the specified interval.
+ *         Set this argument to `0` to disable ping messages.
+ *     trusted_responder_key (`*uint8_t` or `null`, borrowed):
+ *         The trusted responder public key. If set, this must be a pointer to a 32 byte
+ *         `uint8_t` array. Set this to null when not restoring a trusted session.
+ *     server_public_permanent_key (`*uint8_t` or `null`, borrowed):
+ *         The server public permanent key. If set, this must be a pointer to a 32 byte
+ *         `uint8_t` array. Set this to null to not validate the server public key.
+ *     capacities (`salty_channel_capacities_t`, copied):
+ *         The capacities of the incoming and outgoing message channels.
+ * Returns:
+ *     A `salty_relayed_data_client_ret_t` struct.
+ */
+salty_relayed_data_client_ret_t salty_relayed_data_initiator_new_bounded(const salty_keypair_t *keypair,
+                                                                         const salty_remote_t *remote,
+                                                                         uint32_t ping_interval_seconds,
+                                                                         const uint8_t *trusted_responder_key,
+                                                                         const uint8_t *server_public_permanent_key,
+                                                                         salty_channel_capacities_t capacities);
+
 /**
  * Initialize a new SaltyRTC client as responder with the Relayed Data task.
  *
+ * The message channels are unbounded. Use
+ * `salty_relayed_data_responder_new_bounded` to limit them.
+ *
  * Parameters:
  *     keypair (`*salty_keypair_t`, moved):
  *         Pointer to a key pair.
@@ -892,4 +1737,37 @@ salty_relayed_data_client_ret_t salty_relayed_data_responder_new(const salty_key
                                                                  const uint8_t *auth_token,
                                                                  const uint8_t *server_public_permanent_key);
 
+/**
+ * Initialize a new SaltyRTC client as responder with the Relayed Data task
+ * and bounded message channels.
+ *
+ * Parameters:
+ *     keypair (`*salty_keypair_t`, moved):
+ *         Pointer to a key pair.
+ *     remote (`*salty_remote_t`, moved):
+ *         Pointer to an event loop remote handle.
+ *     ping_interval_seconds (`uint32_t`, copied):
+ *         Request that the server sends a WebSocket ping message at the specified interval.
+ *         Set this argument to `0` to disable ping messages.
+ *     initiator_pubkey (`*uint8_t`, borrowed):
+ *         Public key of the initiator. A 32 byte `uint8_t` array.
+ *     auth_token (`*uint8_t` or `null`, borrowed):
+ *         One-time auth token from the initiator. If set, this must be a pointer
+ *         to a 32 byte `uint8_t` array. Set this to `null` when restoring a trusted session.
+ *     server_public_permanent_key (`*uint8_t` or `null`, borrowed):
+ *         The server public permanent key. If set, this must be a pointer to a 32 byte
+ *         `uint8_t` array. Set this to null to not validate the server public key.
+ *     capacities (`salty_channel_capacities_t`, copied):
+ *         The capacities of the incoming and outgoing message channels.
+ * Returns:
+ *     A `salty_relayed_data_client_ret_t` struct.
+ */
+salty_relayed_data_client_ret_t salty_relayed_data_responder_new_bounded(const salty_keypair_t *keypair,
+                                                                         const salty_remote_t *remote,
+                                                                         uint32_t ping_interval_seconds,
+                                                                         const uint8_t *initiator_pubkey,
+                                                                         const uint8_t *auth_token,
+                                                                         const uint8_t *server_public_permanent_key,
+                                                                         salty_channel_capacities_t capacities);
+
 #endif /* saltyrtc_task_relayed_data_bindings_h */
@@ -0,0 +1,484 @@
+//! Chunked streaming of large payloads.
+//!
+//! Large payloads are split into chunks that are sent as separate task
+//! messages (msgpack binary values), so that neither side needs to hold the
+//! whole payload in memory. The chunk format is the reliable/ordered mode of
+//! [chunked-dc](https://github.com/saltyrtc/chunked-dc-js), which is also
+//! used by Threema Web:
+//!
+//! - 1 byte options (bit 0 set: last chunk of the message)
+//! - 4 bytes message id (big endian)
+//! - 4 bytes serial number of the chunk within the message (big endian)
+//! - chunk data
+
+use std::cmp;
+use std::collections::{BTreeMap, HashMap, HashSet, VecDeque};
+use std::mem;
+
+use saltyrtc_client::dep::rmpv::Value;
+use saltyrtc_task_relayed_data::OutgoingMessage;
+
+use queue::{QueueSender, TrySendError};
+
+/// Length of the chunk header.
+pub const HEADER_LEN: usize = 9;
+
+/// Options flag: This is the last chunk of the message.
+const END_OF_MESSAGE: u8 = 0x01;
+
+/// Maximum number of chunks that are buffered because they arrived before
+/// one of their predecessors.
+const MAX_EARLY_CHUNKS: usize = 256;
+
+/// Number of most recently completed message ids whose chunks are rejected
+/// when they are received again.
+const MAX_COMPLETED_IDS: usize = 1024;
+
+/// The header of a chunk.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ChunkHeader {
+    pub id: u32,
+    pub serial: u32,
+    pub end_of_message: bool,
+}
+
+impl ChunkHeader {
+    /// Parse the header at the start of a chunk.
+    pub fn parse(chunk: &[u8]) -> Option<Self> {
+        if chunk.len() < HEADER_LEN {
+            return None;
+        }
+        Some(ChunkHeader {
+            id: read_u32_be(&chunk[1..5]),
+            serial: read_u32_be(&chunk[5..9]),
+            end_of_message: chunk[0] & END_OF_MESSAGE != 0,
+        })
+    }
+
+    fn write(&self, chunk: &mut [u8]) {
+        chunk[0] = if self.end_of_message { END_OF_MESSAGE } else { 0 };
+        write_u32_be(&mut chunk[1..5], self.id);
+        write_u32_be(&mut chunk[5..9], self.serial);
+    }
+}
+
+fn read_u32_be(bytes: &[u8]) -> u32 {
+    (u32::from(bytes[0]) << 24) | (u32::from(bytes[1]) << 16) | (u32::from(bytes[2]) << 8) | u32::from(bytes[3])
+}
+
+fn write_u32_be(bytes: &mut [u8], val: u32) {
+    bytes[0] = (val >> 24) as u8;
+    bytes[1] = (val >> 16) as u8;
+    bytes[2] = (val >> 8) as u8;
+    bytes[3] = val as u8;
+}
+
+/// Splits a message into chunks while it is being written.
+///
+/// Data is copied exactly once, into the chunk buffer that is then moved
+/// into the outgoing message.
+#[derive(Debug)]
+pub struct ChunkWriter {
+    id: u32,
+    serial: u32,
+    chunk_size: usize,
+    chunk: Vec<u8>,
+    finished: bool,
+}
+
+impl ChunkWriter {
+    /// Create a writer for the message with the specified id.
+    ///
+    /// The chunk size includes the header.
+    pub fn new(id: u32, chunk_size: usize) -> Result<Self, String> {
+        if chunk_size <= HEADER_LEN {
+            return Err(format!("Chunk size must be larger than {} bytes", HEADER_LEN));
+        }
+        Ok(ChunkWriter { id, serial: 0, chunk_size, chunk: Self::new_chunk(chunk_size), finished: false })
+    }
+
+    fn new_chunk(chunk_size: usize) -> Vec<u8> {
+        let mut chunk = Vec::with_capacity(chunk_size);
+        chunk.resize(HEADER_LEN, 0);
+        chunk
+    }
+
+    /// Whether the last chunk has been taken.
+    pub fn is_finished(&self) -> bool {
+        self.finished
+    }
+
+    /// Copy as much of `data` into the current chunk as fits.
+    ///
+    /// Returns the number of bytes copied.
+    pub fn fill(&mut self, data: &[u8]) -> usize {
+        debug_assert!(!self.finished);
+        let count = cmp::min(self.chunk_size - self.chunk.len(), data.len());
+        self.chunk.extend_from_slice(&data[..count]);
+        count
+    }
+
+    /// Complete the current chunk and start the next one.
+    pub fn take_chunk(&mut self, end_of_message: bool) -> Vec<u8> {
+        debug_assert!(!self.finished);
+        let next = if end_of_message { Vec::new() } else { Self::new_chunk(self.chunk_size) };
+        let mut chunk = mem::replace(&mut self.chunk, next);
+        ChunkHeader { id: self.id, serial: self.serial, end_of_message }.write(&mut chunk);
+        self.serial = self.serial.wrapping_add(1);
+        self.finished = end_of_message;
+        chunk
+    }
+}
+
+/// Sends the chunks of a `ChunkWriter` through an outgoing channel.
+///
+/// A chunk that does not fit into the channel is kept and sent first on the
+/// next call, so writing can be resumed after `TrySendError::Full`.
+pub struct ChunkSender {
+    tx: QueueSender<OutgoingMessage>,
+    writer: ChunkWriter,
+    pending: Option<OutgoingMessage>,
+}
+
+impl ChunkSender {
+    pub fn new(tx: QueueSender<OutgoingMessage>, writer: ChunkWriter) -> Self {
+        ChunkSender { tx, writer, pending: None }
+    }
+
+    /// Try to send the pending chunk.
+    fn flush(&mut self) -> Result<(), TrySendError> {
+        if let Some(msg) = self.pending.take() {
+            if let Err((e, msg)) = self.tx.try_send_or_return(msg) {
+                self.pending = Some(msg);
+                return Err(e);
+            }
+        }
+        Ok(())
+    }
+
+    /// Write data to the message.
+    ///
+    /// A full chunk is only sent once more data follows, so that `finish`
+    /// can mark it as the last chunk. Returns the number of bytes consumed,
+    /// which is less than `data.len()` if an error occurred.
+    pub fn write(&mut self, data: &[u8]) -> (usize, Result<(), TrySendError>) {
+        let mut written = 0;
+        loop {
+            if let Err(e) = self.flush() {
+                return (written, Err(e));
+            }
+            written += self.writer.fill(&data[written..]);
+            if written == data.len() {
+                return (written, Ok(()));
+            }
+            let chunk = self.writer.take_chunk(false);
+            self.pending = Some(OutgoingMessage::Data(Value::Binary(chunk)));
+        }
+    }
+
+    /// Send the last chunk of the message.
+    ///
+    /// This may be called again after an error.
+    pub fn finish(&mut self) -> Result<(), TrySendError> {
+        self.flush()?;
+        if !self.writer.is_finished() {
+            let chunk = self.writer.take_chunk(true);
+            self.pending = Some(OutgoingMessage::Data(Value::Binary(chunk)));
+        }
+        self.flush()
+    }
+
+    /// Whether the last chunk has been taken (it may still be pending).
+    pub fn is_finished(&self) -> bool {
+        self.writer.is_finished()
+    }
+}
+
+/// Puts the chunks of incoming messages in order.
+///
+/// Chunks are handed to the application as soon as all of their predecessors
+/// have been handed out, instead of reassembling the whole message. Chunks
+/// that arrive early are buffered until the missing ones have arrived.
+#[derive(Debug, Default)]
+pub struct ChunkReader {
+    next_serials: HashMap<u32, u32>,
+    early: BTreeMap<(u32, u32), (ChunkHeader, Vec<u8>)>,
+    ready: VecDeque<(ChunkHeader, Vec<u8>)>,
+    completed: HashSet<u32>,
+    completed_order: VecDeque<u32>,
+}
+
+impl ChunkReader {
+    pub fn new() -> Self {
+        Default::default()
+    }
+
+    /// Add a received chunk.
+    ///
+    /// Chunks that are next in order become available through `pop`. If the
+    /// bytes are not a chunk, the chunk has already been received, its
+    /// message has recently been completed, or too many chunks are buffered,
+    /// the bytes are returned.
+    pub fn push(&mut self, chunk: Vec<u8>) -> Result<(), Vec<u8>> {
+        let header = match ChunkHeader::parse(&chunk) {
+            Some(header) => header,
+            None => return Err(chunk),
+        };
+        let expected = self.next_serials.get(&header.id).cloned().unwrap_or(0);
+        if self.completed.contains(&header.id)
+                || header.serial < expected
+                || self.early.contains_key(&(header.id, header.serial))
+                || (header.serial > expected && self.early.len() >= MAX_EARLY_CHUNKS) {
+            return Err(chunk);
+        }
+        if header.serial > expected {
+            self.early.insert((header.id, header.serial), (header, chunk));
+            return Ok(());
+        }
+
+        // Hand out the chunk and all of its successors that arrived early
+        let mut next = Some((header, chunk));
+        while let Some((header, chunk)) = next.take() {
+            if header.end_of_message {
+                self.next_serials.remove(&header.id);
+                self.complete(header.id);
+            } else {
+                let serial = header.serial.wrapping_add(1);
+                self.next_serials.insert(header.id, serial);
+                next = self.early.remove(&(header.id, serial));
+            }
+            self.ready.push_back((header, chunk));
+        }
+        Ok(())
+    }
+
+    /// Remember a completed message and drop its early chunks, which claim to
+    /// follow the last one.
+    fn complete(&mut self, id: u32) {
+        let stale: Vec<(u32, u32)> = self.early.range((id, 0)..=(id, u32::MAX))
+            .map(|(key, _)| *key)
+            .collect();
+        for key in stale {
+            self.early.remove(&key);
+        }
+        if self.completed_order.len() >= MAX_COMPLETED_IDS {
+            if let Some(oldest) = self.completed_order.pop_front() {
+                self.completed.remove(&oldest);
+            }
+        }
+        self.completed.insert(id);
+        self.completed_order.push_back(id);
+    }
+
+    /// Take the next chunk that is in order.
+    pub fn pop(&mut self) -> Option<(ChunkHeader, Vec<u8>)> {
+        self.ready.pop_front()
+    }
+
+    /// The number of messages that have been started but not completed yet.
+    pub fn incomplete(&self) -> usize {
+        self.next_serials.len()
+    }
+
+    /// The number of chunks waiting for one of their predecessors.
+    pub fn early(&self) -> usize {
+        self.early.len()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use saltyrtc_client::dep::futures::{Future, Stream};
+
+    use queue;
+
+    use super::*;
+
+    fn chunks_of(id: u32, chunk_size: usize, writes: &[&[u8]]) -> Vec<Vec<u8>> {
+        let (tx, rx) = queue::channel::<OutgoingMessage>(0);
+        let mut sender = ChunkSender::new(tx, ChunkWriter::new(id, chunk_size).unwrap());
+        for data in writes {
+            assert_eq!(sender.write(data), (data.len(), Ok(())));
+        }
+        assert_eq!(sender.finish(), Ok(()));
+        drop(sender);
+        rx.wait()
+            .map(|msg| match msg {
+                Ok(OutgoingMessage::Data(Value::Binary(chunk))) => chunk,
+                other => panic!("Unexpected message: {:?}", other),
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_chunk_size_too_small() {
+        assert!(ChunkWriter::new(0, HEADER_LEN).is_err());
+        assert!(ChunkWriter::new(0, HEADER_LEN + 1).is_ok());
+    }
+
+    #[test]
+    fn test_split() {
+        let chunks = chunks_of(0x01020304, 12, &[&[1, 2, 3, 4], &[5, 6, 7]]);
+        assert_eq!(chunks, vec![
+            vec![0, 1, 2, 3, 4, 0, 0, 0, 0, 1, 2, 3],
+            vec![0, 1, 2, 3, 4, 0, 0, 0, 1, 4, 5, 6],
+            vec![1, 1, 2, 3, 4, 0, 0, 0, 2, 7],
+        ]);
+    }
+
+    #[test]
+    fn test_exact_fit_has_no_empty_chunk() {
+        let chunks = chunks_of(7, 12, &[&[1, 2, 3], &[4, 5, 6]]);
+        assert_eq!(chunks.len(), 2);
+        assert_eq!(chunks[1], vec![1, 0, 0, 0, 7, 0, 0, 0, 1, 4, 5, 6]);
+    }
+
+    #[test]
+    fn test_empty_message() {
+        assert_eq!(chunks_of(7, 12, &[]), vec![vec![1, 0, 0, 0, 7, 0, 0, 0, 0]]);
+    }
+
+    #[test]
+    fn test_round_trip() {
+        let data: Vec<u8> = (0..10000u32).map(|i| i as u8).collect();
+        let chunks = chunks_of(42, 1000, &[&data[..3000], &data[3000..]]);
+        assert_eq!(chunks.len(), 11);
+        let mut reader = ChunkReader::new();
+        let mut received = Vec::new();
+        for (i, chunk) in chunks.into_iter().enumerate() {
+            reader.push(chunk).unwrap();
+            let (header, chunk) = reader.pop().unwrap();
+            assert_eq!(header, ChunkHeader { id: 42, serial: i as u32, end_of_message: i == 10 });
+            received.extend_from_slice(&chunk[HEADER_LEN..]);
+        }
+        assert_eq!(reader.pop(), None);
+        assert_eq!(received, data);
+        assert_eq!(reader.incomplete(), 0);
+    }
+
+    fn serials(reader: &mut ChunkReader) -> Vec<(u32, u32)> {
+        let mut serials = Vec::new();
+        while let Some((header, _)) = reader.pop() {
+            serials.push((header.id, header.serial));
+        }
+        serials
+    }
+
+    #[test]
+    fn test_reader_reorders() {
+        let mut reader = ChunkReader::new();
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 0]).is_ok());
+        assert!(reader.push(vec![0, 0, 0, 0, 2, 0, 0, 0, 0]).is_ok());
+        assert_eq!(reader.incomplete(), 2);
+        assert_eq!(serials(&mut reader), vec![(1, 0), (2, 0)]);
+
+        // Early chunks are held back until their predecessors have arrived
+        assert!(reader.push(vec![1, 0, 0, 0, 1, 0, 0, 0, 3]).is_ok());
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 2]).is_ok());
+        assert!(reader.push(vec![0, 0, 0, 0, 2, 0, 0, 0, 1]).is_ok());
+        assert_eq!(reader.early(), 2);
+        assert_eq!(serials(&mut reader), vec![(2, 1)]);
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 1]).is_ok());
+        assert_eq!(serials(&mut reader), vec![(1, 1), (1, 2), (1, 3)]);
+        assert_eq!(reader.early(), 0);
+        assert_eq!(reader.incomplete(), 1);
+    }
+
+    #[test]
+    fn test_reader_returns_unexpected() {
+        let mut reader = ChunkReader::new();
+
+        // Not a chunk
+        assert_eq!(reader.push(vec![0, 0, 0]), Err(vec![0, 0, 0]));
+
+        // Chunks that have already been received
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 0]).is_ok());
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 2]).is_ok());
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 0]).is_err());
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 2]).is_err());
+        assert_eq!(serials(&mut reader), vec![(1, 0)]);
+
+        // Too many early chunks
+        for serial in 3..(MAX_EARLY_CHUNKS as u32 + 2) {
+            let mut chunk = vec![0; HEADER_LEN];
+            ChunkHeader { id: 1, serial, end_of_message: false }.write(&mut chunk);
+            assert!(reader.push(chunk).is_ok());
+        }
+        assert_eq!(reader.early(), MAX_EARLY_CHUNKS);
+        assert!(reader.push(vec![0, 0, 0, 0, 2, 0, 0, 0, 1]).is_err());
+
+        // The next chunk in order is still accepted
+        assert!(reader.push(vec![0, 0, 0, 0, 2, 0, 0, 0, 0]).is_ok());
+        assert_eq!(serials(&mut reader), vec![(2, 0)]);
+    }
+
+    #[test]
+    fn test_reader_rejects_replayed_messages() {
+        let mut reader = ChunkReader::new();
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 0]).is_ok());
+        assert!(reader.push(vec![1, 0, 0, 0, 1, 0, 0, 0, 1]).is_ok());
+        assert_eq!(serials(&mut reader), vec![(1, 0), (1, 1)]);
+        assert_eq!(reader.incomplete(), 0);
+
+        // Neither the first nor any later chunk of a completed message is
+        // accepted again
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 0]).is_err());
+        assert!(reader.push(vec![1, 0, 0, 0, 1, 0, 0, 0, 1]).is_err());
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 5]).is_err());
+        assert_eq!(reader.pop(), None);
+        assert_eq!(reader.early(), 0);
+        assert_eq!(reader.incomplete(), 0);
+
+        // Only the most recently completed messages are remembered
+        let last_message = |id| {
+            let mut chunk = vec![0; HEADER_LEN];
+            ChunkHeader { id, serial: 0, end_of_message: true }.write(&mut chunk);
+            chunk
+        };
+        for id in 2..(MAX_COMPLETED_IDS as u32 + 2) {
+            assert!(reader.push(last_message(id)).is_ok());
+        }
+        assert_eq!(reader.completed.len(), MAX_COMPLETED_IDS);
+        assert!(reader.push(last_message(MAX_COMPLETED_IDS as u32 + 1)).is_err());
+        assert!(reader.push(vec![1, 0, 0, 0, 1, 0, 0, 0, 0]).is_ok());
+    }
+
+    #[test]
+    fn test_reader_drops_early_chunks_past_the_end() {
+        let mut reader = ChunkReader::new();
+
+        // Chunks that claim to follow the last chunk of their message
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 3]).is_ok());
+        assert!(reader.push(vec![1, 0, 0, 0, 1, 0, 0, 0, 1]).is_ok());
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 2]).is_ok());
+        assert!(reader.push(vec![0, 0, 0, 0, 2, 0, 0, 0, 1]).is_ok());
+        assert_eq!(reader.early(), 4);
+
+        // They are dropped once the message has been completed, early chunks
+        // of other messages are kept
+        assert!(reader.push(vec![0, 0, 0, 0, 1, 0, 0, 0, 0]).is_ok());
+        assert_eq!(serials(&mut reader), vec![(1, 0), (1, 1)]);
+        assert_eq!(reader.early(), 1);
+        assert!(reader.push(vec![0, 0, 0, 0, 2, 0, 0, 0, 0]).is_ok());
+        assert_eq!(serials(&mut reader), vec![(2, 0), (2, 1)]);
+        assert_eq!(reader.early(), 0);
+    }
+
+    #[test]
+    fn test_resume_when_full() {
+        let (tx, mut rx) = queue::channel::<OutgoingMessage>(1);
+        let mut sender = ChunkSender::new(tx, ChunkWriter::new(0, 10).unwrap());
+
+        // The first chunk is sent, the second one is kept
+        assert_eq!(sender.write(&[1, 2, 3]), (2, Err(TrySendError::Full)));
+        assert_eq!(rx.by_ref().wait().next().unwrap().unwrap(),
+                   OutgoingMessage::Data(Value::Binary(vec![0, 0, 0, 0, 0, 0, 0, 0, 0, 1])));
+        assert_eq!(sender.write(&[3]), (1, Ok(())));
+        assert_eq!(sender.finish(), Err(TrySendError::Full));
+        assert!(sender.is_finished());
+        rx.by_ref().wait().next().unwrap().unwrap();
+        assert_eq!(sender.finish(), Ok(()));
+        assert_eq!(rx.by_ref().wait().next().unwrap().unwrap(),
+                   OutgoingMessage::Data(Value::Binary(vec![1, 0, 0, 0, 0, 0, 0, 0, 2, 3])));
+    }
+}
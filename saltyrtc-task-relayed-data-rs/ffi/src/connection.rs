@@ -1,4 +1,5 @@
 use saltyrtc_client::dep::futures::{Future, Poll, Async};
+use saltyrtc_task_relayed_data::IncomingBackpressure;
 
 /// Combines three different futures yielding the same item and error
 /// types into a single type.
@@ -53,3 +54,37 @@ impl<A, B, C> Future for Connection<A, B, C> where A: Future, B: Future, C: Futu
         }
     }
 }
+
+
+/// Future that only polls the inner future (the task loop) while the task is
+/// not waiting for the application to accept an incoming message.
+///
+/// This stops reading from the socket while the incoming channel is full, so
+/// that the peer (and the server) are slowed down instead of incoming messages
+/// piling up in memory. While paused, the task loop is still polled once for
+/// every outgoing message, so that the application's messages are sent.
+/// Other protocol handling (e.g. answering pings or a close initiated by the
+/// peer) waits until the application has received some of the queued
+/// messages.
+#[must_use = "futures do nothing unless polled"]
+#[derive(Debug)]
+pub struct Backpressured<F> {
+    inner: F,
+    backpressure: IncomingBackpressure,
+}
+
+pub fn backpressured<F>(inner: F, backpressure: IncomingBackpressure) -> Backpressured<F> {
+    Backpressured { inner, backpressure }
+}
+
+impl<F> Future for Backpressured<F> where F: Future {
+    type Item = F::Item;
+    type Error = F::Error;
+
+    fn poll(&mut self) -> Poll<Self::Item, Self::Error> {
+        match self.backpressure.poll_ready() {
+            Async::Ready(()) => self.inner.poll(),
+            Async::NotReady => Ok(Async::NotReady),
+        }
+    }
+}
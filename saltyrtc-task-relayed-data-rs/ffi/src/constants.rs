@@ -4,3 +4,6 @@ pub const LEVEL_INFO: u8 = 2;
 pub const LEVEL_WARN: u8 = 3;
 pub const LEVEL_ERROR: u8 = 4;
 pub const LEVEL_OFF: u8 = 5;
+
+/// Number of bytes added by encrypting data with the session keys (authentication tag).
+pub const SESSION_KEYS_OVERHEAD: usize = 16;
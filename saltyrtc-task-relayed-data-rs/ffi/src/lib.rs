@@ -30,11 +30,18 @@ extern crate saltyrtc_task_relayed_data;
 extern crate tokio_core;
 extern crate tokio_timer;
 
+mod allocations;
+mod chunks;
 mod connection;
 mod constants;
+mod log_ring;
 mod nonblocking;
+mod pool;
+mod queue;
+mod readiness;
 pub mod saltyrtc_client_ffi;
 
+use std::cmp;
 use std::convert::TryInto;
 use std::ffi::CStr;
 use std::io::{BufReader, Read};
@@ -42,14 +49,16 @@ use std::mem;
 use std::ptr;
 use std::sync::{Arc, RwLock};
 use std::slice;
-use std::time::Duration;
+use std::thread;
+use std::time::{Duration, Instant};
 
-use libc::{uintptr_t, size_t, c_char};
+use libc::{uintptr_t, size_t, c_char, c_int};
 use rmp_serde as rmps;
 use saltyrtc_client::{SaltyClient, SaltyClientBuilder, CloseCode, WsClient, Event};
 use saltyrtc_client::crypto::{KeyPair, PublicKey, AuthToken};
-use saltyrtc_client::dep::futures::{Future, Stream, Sink};
-use saltyrtc_client::dep::futures::future::Either;
+use saltyrtc_client::dep::futures::{Async, Future, Stream, Sink};
+use saltyrtc_client::dep::futures::executor::{self, NotifyHandle};
+use saltyrtc_client::dep::futures::future::{self, Either};
 use saltyrtc_client::dep::futures::sync::{mpsc, oneshot};
 use saltyrtc_client::dep::native_tls::{TlsConnector, Protocol, Certificate};
 use saltyrtc_client::dep::rmpv::Value;
@@ -58,10 +67,14 @@ use saltyrtc_client::errors::SaltyError;
 use saltyrtc_client::tasks::{BoxedTask, Task};
 pub use saltyrtc_client_ffi::{salty_client_t, salty_keypair_t, salty_remote_t, salty_event_loop_t};
 use saltyrtc_task_relayed_data::{RelayedDataTask, MessageEvent, OutgoingMessage};
-use tokio_core::reactor::{Core, Remote};
+use tokio_core::reactor::{Core, Handle, Remote};
 use tokio_timer::Timer;
 
+use chunks::{ChunkHeader, ChunkReader, ChunkSender, ChunkWriter, HEADER_LEN as CHUNK_HEADER_LEN};
 use connection::Either3;
+use pool::EventLoopPool;
+use queue::{QueueReceiver, QueueSender, QueueStats, TrySendError};
+use readiness::Readiness;
 pub use constants::*;
 
 
@@ -113,19 +126,66 @@ pub struct salty_relayed_data_client_ret_t {
 
 /// The channel for receiving incoming messages.
 ///
-/// On the Rust side, this is an `mpsc::UnboundedReceiver<MessageEvent>`.
+/// On the Rust side, this is a `QueueReceiver<MessageEvent>`.
 pub enum salty_channel_receiver_rx_t {}
 
 /// The channel for sending outgoing messages (sending end).
 ///
-/// On the Rust side, this is an `mpsc::UnboundedSender<OutgoingMessage>`.
+/// On the Rust side, this is a `QueueSender<OutgoingMessage>`.
 pub enum salty_channel_sender_tx_t {}
 
 /// The channel for sending outgoing messages (receiving end).
 ///
-/// On the Rust side, this is an `mpsc::UnboundedReceiver<OutgoingMessage>`.
+/// On the Rust side, this is a `QueueReceiver<OutgoingMessage>`.
 pub enum salty_channel_sender_rx_t {}
 
+/// Capacities of the incoming and outgoing message channels.
+///
+/// A capacity is the maximum number of messages that may be queued in
+/// the channel. Set a capacity to `0` for an unbounded channel.
+///
+/// If the incoming channel is full, the client stops reading messages from
+/// the peer until the application has received some of the queued messages.
+/// Outgoing messages are still sent in the meantime, but other protocol
+/// handling (e.g. answering pings or a close initiated by the peer) waits
+/// until the application receives again.
+/// If the outgoing channel is full, sending returns `SEND_WOULD_BLOCK`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct salty_channel_capacities_t {
+    pub incoming: u32,
+    pub outgoing: u32,
+}
+
+/// Statistics of a message channel.
+#[repr(C)]
+#[derive(Debug, PartialEq, Eq)]
+pub struct salty_channel_stats_t {
+    /// The capacity of the channel, `0` if unbounded.
+    pub capacity: u64,
+    /// The number of messages currently queued.
+    pub depth: u64,
+    /// The highest number of messages queued at the same time.
+    pub high_water: u64,
+    /// The number of messages that have been enqueued in total.
+    pub total: u64,
+    /// The number of times a message could not be enqueued because the
+    /// channel was full.
+    pub full: u64,
+}
+
+impl From<QueueStats> for salty_channel_stats_t {
+    fn from(stats: QueueStats) -> Self {
+        salty_channel_stats_t {
+            capacity: stats.capacity as u64,
+            depth: stats.depth as u64,
+            high_water: stats.high_water as u64,
+            total: stats.total as u64,
+            full: stats.full as u64,
+        }
+    }
+}
+
 /// The oneshot channel for closing the connection (sending end).
 ///
 /// On the Rust side, this is an `oneshot::Sender<CloseCode>`.
@@ -137,6 +197,45 @@ pub enum salty_channel_disconnect_tx_t {}
 pub enum salty_channel_disconnect_rx_t {}
 
 
+/// A pool of event loops, each running on its own worker thread.
+///
+/// On the Rust side, this is an `EventLoopPool`.
+pub enum salty_event_loop_pool_t {}
+
+/// A writer splitting a large message into chunks.
+///
+/// On the Rust side, this is a `ChunkSender`.
+pub enum salty_chunk_writer_t {}
+
+/// A reader validating the chunks of incoming messages.
+///
+/// On the Rust side, this is a `ChunkReader`.
+pub enum salty_chunk_reader_t {}
+
+/// Allocation counters of the library.
+///
+/// Only available if the library was built with the `alloc-stats` feature.
+#[repr(C)]
+#[derive(Debug, Default)]
+pub struct salty_alloc_stats_t {
+    /// The number of allocations.
+    pub allocations: u64,
+    /// The number of deallocations.
+    pub deallocations: u64,
+    /// The number of reallocations.
+    pub reallocations: u64,
+    /// The number of bytes allocated in total (including growing reallocations).
+    pub allocated_bytes: u64,
+}
+
+/// A readiness notifier for a receiving channel.
+///
+/// Its file descriptor (see `salty_readiness_fd`) becomes readable when the
+/// channel it has been armed for has data available or has ended.
+///
+/// On the Rust side, this is an `Arc<Readiness>`.
+pub enum salty_readiness_t {}
+
 /// The return value when initializing a connection.
 ///
 /// Note: Before accessing `connect_future`, make sure to check the `success`
@@ -150,11 +249,10 @@ pub struct salty_client_init_ret_t {
 }
 
 /// A handshake future. This will be passed to the `salty_client_connect`
-/// function.
+/// or `salty_client_connect_pooled` function.
 ///
-/// On the Rust side, this is a `Box<Box<Future<Item=WsClient, Error=SaltyError>>>`.
-/// The double box is used because the inner box is actually a trait object fat
-/// pointer, pointing to both the data and the vtable.
+/// On the Rust side, this is a `Box<Handshake>`. A handshake created for an
+/// event loop pool is only turned into a future on the worker that runs it.
 pub enum salty_handshake_future_t {}
 
 /// An event channel (sending end).
@@ -248,6 +346,10 @@ pub enum salty_client_send_success_t {
     /// Sending failed because the message was invalid
     SEND_MESSAGE_ERROR = 2,
 
+    /// Sending failed because the outgoing channel is full.
+    /// Nothing has been sent. Try again later.
+    SEND_WOULD_BLOCK = 3,
+
     /// Sending failed
     SEND_ERROR = 9,
 }
@@ -346,6 +448,54 @@ pub struct salty_client_recv_msg_ret_t {
     pub msg: *const salty_msg_t,
 }
 
+/// The return value when trying to receive a batch of messages.
+///
+/// Note: Before accessing `msgs`, make sure to check the `success` field
+/// for errors. If an error occurred, the `msgs` field will be `null`.
+/// Otherwise, `msgs` points to an array of `msgs_len` messages (at least one).
+#[repr(C)]
+pub struct salty_client_recv_msgs_ret_t {
+    pub success: salty_client_recv_success_t,
+    pub msgs: *const salty_msg_t,
+    pub msgs_len: uintptr_t,
+}
+
+/// A chunk of a large message.
+///
+/// The `data` field points to the chunk data (without the chunk header).
+/// The data of all chunks with the same `message_id`, in the order of their
+/// `serial`, forms the message. The last chunk of a message has
+/// `end_of_message` set.
+#[repr(C)]
+pub struct salty_chunk_t {
+    pub message_id: u32,
+    pub serial: u32,
+    pub end_of_message: bool,
+    pub data: *const u8,
+    pub data_len: uintptr_t,
+}
+
+/// The return value when trying to receive a chunk.
+///
+/// Note: Before accessing `chunk` or `msg`, make sure to check the `success`
+/// field for errors. If an error occurred, both fields will be `null`.
+/// Otherwise, exactly one of them is set: `chunk` for a chunk, `msg` for any
+/// other message (an application message, a close message or a task message
+/// that is not a chunk).
+#[repr(C)]
+pub struct salty_client_recv_chunk_ret_t {
+    pub success: salty_client_recv_success_t,
+    pub chunk: *const salty_chunk_t,
+    pub msg: *const salty_msg_t,
+}
+
+/// A borrowed byte buffer, used to pass multiple messages at once.
+#[repr(C)]
+pub struct salty_iovec_t {
+    pub iov_base: *const u8,
+    pub iov_len: size_t,
+}
+
 /// The return value when trying to receive an event.
 ///
 /// Note: Before accessing `event`, make sure to check the `success` field
@@ -382,6 +532,10 @@ pub enum salty_client_encrypt_decrypt_success_t {
     /// The peer has not yet been determined.
     ENCRYPT_DECRYPT_NO_PEER = 2,
 
+    /// The output buffer is too small. The required length has been written
+    /// to `written`.
+    ENCRYPT_DECRYPT_BUFFER_TOO_SMALL = 3,
+
     /// Other error
     ENCRYPT_DECRYPT_ERROR = 9,
 }
@@ -404,9 +558,9 @@ fn make_client_create_error(reason: salty_relayed_data_success_t) -> salty_relay
 
 struct ClientBuilderRet {
     builder: SaltyClientBuilder,
-    receiver_rx: mpsc::UnboundedReceiver<MessageEvent>,
-    sender_tx: mpsc::UnboundedSender<OutgoingMessage>,
-    sender_rx: mpsc::UnboundedReceiver<OutgoingMessage>,
+    receiver_rx: QueueReceiver<MessageEvent>,
+    sender_tx: QueueSender<OutgoingMessage>,
+    sender_rx: QueueReceiver<OutgoingMessage>,
     disconnect_tx: oneshot::Sender<CloseCode>,
     disconnect_rx: oneshot::Receiver<CloseCode>,
 }
@@ -417,6 +571,7 @@ unsafe fn create_client_builder(
     server_public_permanent_key: *const u8,
     remote: *const salty_remote_t,
     ping_interval_seconds: u32,
+    capacities: salty_channel_capacities_t,
 ) -> Result<ClientBuilderRet, salty_relayed_data_success_t> {
     trace!("create_client_builder");
 
@@ -436,8 +591,8 @@ unsafe fn create_client_builder(
 
     // Create communication channels
     // TODO: The sender should not be created here, it should be extracted from the task!
-    let (receiver_tx, receiver_rx) = mpsc::unbounded();
-    let (sender_tx, sender_rx) = mpsc::unbounded();
+    let (receiver_tx, receiver_rx) = queue::channel(capacities.incoming as usize);
+    let (sender_tx, sender_rx) = queue::channel(capacities.outgoing as usize);
     let (disconnect_tx, disconnect_rx) = oneshot::channel();
 
     // Instantiate task
@@ -481,6 +636,9 @@ unsafe fn create_client_builder(
 
 /// Initialize a new SaltyRTC client as initiator with the Relayed Data task.
 ///
+/// The message channels are unbounded. Use
+/// `salty_relayed_data_initiator_new_bounded` to limit them.
+///
 /// Parameters:
 ///     keypair (`*salty_keypair_t`, moved):
 ///         Pointer to a key pair.
@@ -506,9 +664,50 @@ pub unsafe extern "C" fn salty_relayed_data_initiator_new(
     server_public_permanent_key: *const u8,
 ) -> salty_relayed_data_client_ret_t {
     trace!("salty_relayed_data_initiator_new");
+    salty_relayed_data_initiator_new_bounded(
+        keypair,
+        remote,
+        ping_interval_seconds,
+        trusted_responder_key,
+        server_public_permanent_key,
+        salty_channel_capacities_t { incoming: 0, outgoing: 0 },
+    )
+}
+
+/// Initialize a new SaltyRTC client as initiator with the Relayed Data task
+/// and bounded message channels.
+///
+/// Parameters:
+///     keypair (`*salty_keypair_t`, moved):
+///         Pointer to a key pair.
+///     remote (`*salty_remote_t`, moved):
+///         Pointer to an event loop remote handle.
+///     ping_interval_seconds (`uint32_t`, copied):
+///         Request that the server sends a WebSocket ping message at the specified interval.
+///         Set this argument to `0` to disable ping messages.
+///     trusted_responder_key (`*uint8_t` or `null`, borrowed):
+///         The trusted responder public key. If set, this must be a pointer to a 32 byte
+///         `uint8_t` array. Set this to null when not restoring a trusted session.
+///     server_public_permanent_key (`*uint8_t` or `null`, borrowed):
+///         The server public permanent key. If set, this must be a pointer to a 32 byte
+///         `uint8_t` array. Set this to null to not validate the server public key.
+///     capacities (`salty_channel_capacities_t`, copied):
+///         The capacities of the incoming and outgoing message channels.
+/// Returns:
+///     A `salty_relayed_data_client_ret_t` struct.
+#[no_mangle]
+pub unsafe extern "C" fn salty_relayed_data_initiator_new_bounded(
+    keypair: *const salty_keypair_t,
+    remote: *const salty_remote_t,
+    ping_interval_seconds: u32,
+    trusted_responder_key: *const u8,
+    server_public_permanent_key: *const u8,
+    capacities: salty_channel_capacities_t,
+) -> salty_relayed_data_client_ret_t {
+    trace!("salty_relayed_data_initiator_new_bounded");
 
     // Parse arguments and create SaltyRTC builder
-    let ret = match create_client_builder(keypair, server_public_permanent_key, remote, ping_interval_seconds) {
+    let ret = match create_client_builder(keypair, server_public_permanent_key, remote, ping_interval_seconds, capacities) {
         Ok(val) => val,
         Err(reason) => return make_client_create_error(reason),
     };
@@ -558,6 +757,9 @@ pub unsafe extern "C" fn salty_relayed_data_initiator_new(
 
 /// Initialize a new SaltyRTC client as responder with the Relayed Data task.
 ///
+/// The message channels are unbounded. Use
+/// `salty_relayed_data_responder_new_bounded` to limit them.
+///
 /// Parameters:
 ///     keypair (`*salty_keypair_t`, moved):
 ///         Pointer to a key pair.
@@ -586,9 +788,54 @@ pub unsafe extern "C" fn salty_relayed_data_responder_new(
     server_public_permanent_key: *const u8,
 ) -> salty_relayed_data_client_ret_t {
     trace!("salty_relayed_data_responder_new");
+    salty_relayed_data_responder_new_bounded(
+        keypair,
+        remote,
+        ping_interval_seconds,
+        initiator_pubkey,
+        auth_token,
+        server_public_permanent_key,
+        salty_channel_capacities_t { incoming: 0, outgoing: 0 },
+    )
+}
+
+/// Initialize a new SaltyRTC client as responder with the Relayed Data task
+/// and bounded message channels.
+///
+/// Parameters:
+///     keypair (`*salty_keypair_t`, moved):
+///         Pointer to a key pair.
+///     remote (`*salty_remote_t`, moved):
+///         Pointer to an event loop remote handle.
+///     ping_interval_seconds (`uint32_t`, copied):
+///         Request that the server sends a WebSocket ping message at the specified interval.
+///         Set this argument to `0` to disable ping messages.
+///     initiator_pubkey (`*uint8_t`, borrowed):
+///         Public key of the initiator. A 32 byte `uint8_t` array.
+///     auth_token (`*uint8_t` or `null`, borrowed):
+///         One-time auth token from the initiator. If set, this must be a pointer
+///         to a 32 byte `uint8_t` array. Set this to `null` when restoring a trusted session.
+///     server_public_permanent_key (`*uint8_t` or `null`, borrowed):
+///         The server public permanent key. If set, this must be a pointer to a 32 byte
+///         `uint8_t` array. Set this to null to not validate the server public key.
+///     capacities (`salty_channel_capacities_t`, copied):
+///         The capacities of the incoming and outgoing message channels.
+/// Returns:
+///     A `salty_relayed_data_client_ret_t` struct.
+#[no_mangle]
+pub unsafe extern "C" fn salty_relayed_data_responder_new_bounded(
+    keypair: *const salty_keypair_t,
+    remote: *const salty_remote_t,
+    ping_interval_seconds: u32,
+    initiator_pubkey: *const u8,
+    auth_token: *const u8,
+    server_public_permanent_key: *const u8,
+    capacities: salty_channel_capacities_t,
+) -> salty_relayed_data_client_ret_t {
+    trace!("salty_relayed_data_responder_new_bounded");
 
     // Parse arguments and create SaltyRTC builder
-    let ret = match create_client_builder(keypair, server_public_permanent_key, remote, ping_interval_seconds) {
+    let ret = match create_client_builder(keypair, server_public_permanent_key, remote, ping_interval_seconds, capacities) {
         Ok(val) => val,
         Err(reason) => return make_client_create_error(reason),
     };
@@ -727,7 +974,7 @@ pub unsafe extern "C" fn salty_channel_receiver_rx_free(
         warn!("salty_channel_receiver_rx_free: Tried to free a null pointer");
         return;
     }
-    Box::from_raw(ptr as *mut mpsc::UnboundedReceiver<MessageEvent>);
+    Box::from_raw(ptr as *mut QueueReceiver<MessageEvent>);
 }
 
 /// Free a `salty_channel_sender_tx_t` instance.
@@ -741,7 +988,7 @@ pub unsafe extern "C" fn salty_channel_sender_tx_free(
         warn!("salty_channel_sender_tx_free: Tried to free a null pointer");
         return;
     }
-    Box::from_raw(ptr as *mut mpsc::UnboundedSender<OutgoingMessage>);
+    Box::from_raw(ptr as *mut QueueSender<OutgoingMessage>);
 }
 
 /// Free a `salty_channel_sender_rx_t` instance.
@@ -755,7 +1002,49 @@ pub unsafe extern "C" fn salty_channel_sender_rx_free(
         warn!("salty_channel_sender_rx_free: Tried to free a null pointer");
         return;
     }
-    Box::from_raw(ptr as *mut mpsc::UnboundedReceiver<OutgoingMessage>);
+    Box::from_raw(ptr as *mut QueueReceiver<OutgoingMessage>);
+}
+
+/// Get the statistics of the incoming message channel.
+///
+/// Parameters:
+///     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+///         The receiving end of the channel for incoming message events.
+/// Returns:
+///     A `salty_channel_stats_t` struct. If `receiver_rx` is `null`, all fields are `0`.
+#[no_mangle]
+pub unsafe extern "C" fn salty_channel_receiver_rx_stats(
+    receiver_rx: *const salty_channel_receiver_rx_t,
+) -> salty_channel_stats_t {
+    trace!("salty_channel_receiver_rx_stats");
+
+    if receiver_rx.is_null() {
+        error!("Receiver channel pointer is null");
+        return salty_channel_stats_t { capacity: 0, depth: 0, high_water: 0, total: 0, full: 0 };
+    }
+    let rx = &*(receiver_rx as *const QueueReceiver<MessageEvent>) as &QueueReceiver<MessageEvent>;
+    rx.stats().into()
+}
+
+/// Get the statistics of the outgoing message channel.
+///
+/// Parameters:
+///     sender_tx (`*salty_channel_sender_tx_t`, borrowed):
+///         The sending end of the channel for outgoing messages.
+/// Returns:
+///     A `salty_channel_stats_t` struct. If `sender_tx` is `null`, all fields are `0`.
+#[no_mangle]
+pub unsafe extern "C" fn salty_channel_sender_tx_stats(
+    sender_tx: *const salty_channel_sender_tx_t,
+) -> salty_channel_stats_t {
+    trace!("salty_channel_sender_tx_stats");
+
+    if sender_tx.is_null() {
+        error!("Sender channel pointer is null");
+        return salty_channel_stats_t { capacity: 0, depth: 0, high_water: 0, total: 0, full: 0 };
+    }
+    let tx = &*(sender_tx as *const QueueSender<OutgoingMessage>) as &QueueSender<OutgoingMessage>;
+    tx.stats().into()
 }
 
 /// Free a `salty_channel_disconnect_tx_t` instance.
@@ -815,6 +1104,136 @@ pub unsafe extern "C" fn salty_channel_event_rx_free(
 }
 
 
+// *** EVENT LOOP POOL *** //
+
+/// Create a new event loop pool.
+///
+/// Every worker thread runs its own event loop. Connections started with
+/// `salty_client_connect_pooled` run on the worker they were assigned to
+/// until they have ended.
+///
+/// Parameters:
+///     workers (`uint32_t`, copied):
+///         The number of worker threads. Set this to `0` to use one worker
+///         per available CPU.
+/// Returns:
+///     Either a pointer to the pool, or `null` if the worker threads could
+///     not be started. In the case of a failure, the error will be logged.
+#[no_mangle]
+pub extern "C" fn salty_event_loop_pool_new(workers: u32) -> *const salty_event_loop_pool_t {
+    trace!("salty_event_loop_pool_new");
+
+    let workers = match workers {
+        0 => thread::available_parallelism().map(|n| n.get()).unwrap_or(1),
+        n => n as usize,
+    };
+    match EventLoopPool::new(workers) {
+        Ok(pool) => Box::into_raw(Box::new(pool)) as *const salty_event_loop_pool_t,
+        Err(e) => {
+            error!("Could not start event loop pool: {}", e);
+            ptr::null()
+        }
+    }
+}
+
+/// Return the number of worker threads of an event loop pool.
+///
+/// If the pointer passed in is `null`, an error is logged and `0` is returned.
+#[no_mangle]
+pub unsafe extern "C" fn salty_event_loop_pool_workers(pool: *const salty_event_loop_pool_t) -> u32 {
+    trace!("salty_event_loop_pool_workers");
+
+    if pool.is_null() {
+        error!("Event loop pool pointer is null");
+        return 0;
+    }
+    let pool = &*(pool as *const EventLoopPool) as &EventLoopPool;
+    pool.len() as u32
+}
+
+/// Return the number of connections currently running on an event loop pool.
+///
+/// If the pointer passed in is `null`, an error is logged and `0` is returned.
+#[no_mangle]
+pub unsafe extern "C" fn salty_event_loop_pool_connections(pool: *const salty_event_loop_pool_t) -> u32 {
+    trace!("salty_event_loop_pool_connections");
+
+    if pool.is_null() {
+        error!("Event loop pool pointer is null");
+        return 0;
+    }
+    let pool = &*(pool as *const EventLoopPool) as &EventLoopPool;
+    pool.connections() as u32
+}
+
+/// Choose the worker for a new client.
+///
+/// This is the worker with the fewest running connections. Use the same
+/// worker index for `salty_event_loop_pool_get_remote` and
+/// `salty_client_connect_pooled`.
+///
+/// If the pointer passed in is `null`, an error is logged and `0` is returned.
+#[no_mangle]
+pub unsafe extern "C" fn salty_event_loop_pool_next_worker(pool: *const salty_event_loop_pool_t) -> u32 {
+    trace!("salty_event_loop_pool_next_worker");
+
+    if pool.is_null() {
+        error!("Event loop pool pointer is null");
+        return 0;
+    }
+    let pool = &*(pool as *const EventLoopPool) as &EventLoopPool;
+    pool.next_worker() as u32
+}
+
+/// Return a remote handle of a worker's event loop.
+///
+/// Thread safety:
+///     The `salty_remote_t` instance may be used from any thread.
+/// Ownership:
+///     The `salty_remote_t` instance must be freed through `salty_event_loop_free_remote`,
+///     or by moving it into a `salty_client_t` instance.
+/// Returns:
+///     A reference to the remote handle.
+///     If the pool pointer is `null` or the worker index is invalid, an error
+///     is logged and `null` is returned.
+#[no_mangle]
+pub unsafe extern "C" fn salty_event_loop_pool_get_remote(
+    pool: *const salty_event_loop_pool_t,
+    worker: u32,
+) -> *const salty_remote_t {
+    trace!("salty_event_loop_pool_get_remote");
+
+    if pool.is_null() {
+        error!("Event loop pool pointer is null");
+        return ptr::null();
+    }
+    let pool = &*(pool as *const EventLoopPool) as &EventLoopPool;
+    match pool.remote(worker as usize) {
+        Some(remote) => Box::into_raw(Box::new(remote.clone())) as *const salty_remote_t,
+        None => {
+            error!("Invalid worker index: {}", worker);
+            ptr::null()
+        }
+    }
+}
+
+/// Free an event loop pool.
+///
+/// This stops all worker threads and waits for them to terminate.
+/// Connections that are still running are aborted, so disconnect all
+/// clients first.
+#[no_mangle]
+pub unsafe extern "C" fn salty_event_loop_pool_free(pool: *const salty_event_loop_pool_t) {
+    trace!("salty_event_loop_pool_free");
+
+    if pool.is_null() {
+        warn!("salty_event_loop_pool_free: Tried to free a null pointer");
+        return;
+    }
+    Box::from_raw(pool as *mut EventLoopPool);
+}
+
+
 // *** CONNECTION *** //
 
 /// Prepare a connection to the specified SaltyRTC server, but do not connect yet.
@@ -848,142 +1267,255 @@ pub unsafe extern "C" fn salty_client_init(
 ) -> salty_client_init_ret_t {
     trace!("salty_client_init: Initializing");
 
-    // Helper function to return errors.
-    fn make_init_ret_error(success: salty_client_init_success_t) -> salty_client_init_ret_t {
-        salty_client_init_ret_t {
-            success,
-            handshake_future: ptr::null(),
-            event_rx: ptr::null(),
-            event_tx: ptr::null(),
-        }
-    }
-
-    // Null pointer checks
-    if host.is_null() {
-        error!("Hostname pointer is null");
-        return make_init_ret_error(salty_client_init_success_t::INIT_NULL_ARGUMENT);
-    }
-    if client.is_null() {
-        error!("Client pointer is null");
-        return make_init_ret_error(salty_client_init_success_t::INIT_NULL_ARGUMENT);
-    }
     if event_loop.is_null() {
         error!("Event loop pointer is null");
         return make_init_ret_error(salty_client_init_success_t::INIT_NULL_ARGUMENT);
     }
-
-    // Get host string
-    let hostname_cstr = CStr::from_ptr(host);
-    let hostname = match hostname_cstr.to_str() {
-        Ok(host) => host,
-        Err(e) => {
-            error!("Host argument is not valid UTF-8: {}", e);
-            trace!("Host bytes (without null termination): {:?}", hostname_cstr.to_bytes());
-            return make_init_ret_error(salty_client_init_success_t::INIT_INVALID_HOST);
-        },
-    };
-
-    // Recreate client Arc
-    let client_arc: Arc<RwLock<SaltyClient>> = Arc::from_raw(client as *const RwLock<SaltyClient>);
-
-    // Clone Arc so that the client instance can be reused
-    let client_arc_connect = client_arc.clone();
-    let client_arc_handshake = client_arc.clone();
-    mem::forget(client_arc);
-
-    // Get event loop reference
-    let core = &mut *(event_loop as *mut Core) as &mut Core;
-
-    // Read CA certificate (if present)
-    let ca_cert_opt: Option<Certificate> = if ca_cert.is_null() {
-        debug!("Using system CA chain");
-        None
-    } else {
-        debug!("Reading CA certificate");
-        let bytes: &[u8] = slice::from_raw_parts(ca_cert, ca_cert_len as usize);
-        Some(match Certificate::from_der(bytes) {
-            Ok(cert) => cert,
-            Err(e) => {
-                error!("Could not parse DER encoded CA certificate: {}", e);
-                return make_init_ret_error(salty_client_init_success_t::INIT_CERTIFICATE_ERROR);
-            }
-        })
+    let handshake = match PendingHandshake::new(host, port, client, timeout_s, ca_cert, ca_cert_len) {
+        Ok(handshake) => handshake,
+        Err(success) => return make_init_ret_error(success),
     };
-
-    // Create TlsConnector
-    let mut tls_builder = TlsConnector::builder();
-    tls_builder.min_protocol_version(Some(Protocol::Tlsv10));
-    if let Some(cert) = ca_cert_opt {
-        tls_builder.add_root_certificate(cert);
+    match handshake.start() {
+        Ok((handshake_future, event_tx, event_rx)) => make_init_ret(Handshake::Started(handshake_future), event_tx, event_rx),
+        Err(()) => make_init_ret_error(salty_client_init_success_t::INIT_ERROR),
     }
-    let tls_connector = match tls_builder.build() {
-        Ok(val) => val,
-        Err(e) => {
-            error!("Could not create TlsConnector: {}", e);
-            return make_init_ret_error(salty_client_init_success_t::INIT_TLS_ERROR);
-        }
-    };
+}
 
+/// Prepare a connection that will be run on an event loop pool, but do not
+/// connect yet.
+///
+/// The handshake future is created on the worker that runs the connection
+/// (see `salty_client_connect_pooled`).
+///
+/// Parameters:
+///     host (`*c_char`, null terminated, borrowed):
+///         Null terminated UTF-8 encoded C string containing the SaltyRTC server hostname.
+///     port (`*uint16_t`, copied):
+///         SaltyRTC server port.
+///     client (`*salty_client_t`, borrowed):
+///         Pointer to a `salty_client_t` instance.
+///     timeout_s (`uint16_t`, copied):
+///         Connection and handshake timeout in seconds. Set value to `0` for no timeout.
+///     ca_cert (`*uint8_t` or `NULL`, borrowed):
+///         Optional pointer to bytes of a DER encoded CA certificate.
+///         When no certificate is set, the OS trust chain is used.
+///     ca_cert_len (`uint32_t`, copied):
+///         When the `ca_cert` argument is not `NULL`, then this must be
+///         set to the number of certificate bytes. Otherwise, set it to 0.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_init_pooled(
+    host: *const c_char,
+    port: u16,
+    client: *const salty_client_t,
+    timeout_s: u16,
+    ca_cert: *const u8,
+    ca_cert_len: u32,
+) -> salty_client_init_ret_t {
+    trace!("salty_client_init_pooled: Initializing");
 
-    // Create connect future
-    let (connect_future, event_channel) = match saltyrtc_client::connect(
-        hostname,
-        port,
-        Some(tls_connector),
-        client_arc_connect,
-    ) {
-        Ok(data) => data,
-        Err(e) => {
-            error!("Could not create connect future: {}", e);
-            return make_init_ret_error(salty_client_init_success_t::INIT_ERROR);
-        },
+    let handshake = match PendingHandshake::new(host, port, client, timeout_s, ca_cert, ca_cert_len) {
+        Ok(handshake) => handshake,
+        Err(success) => return make_init_ret_error(success),
     };
 
-    // Forget about reactor core
-    mem::forget(core);
-
-    // Split event channel
-    let (event_tx, event_rx) = event_channel.split();
+    // The events are forwarded from the connection's event channel once the
+    // handshake has been started on the worker
+    let (event_tx, event_rx) = mpsc::unbounded::<Event>();
+    make_init_ret(Handshake::Pending(handshake), event_tx, event_rx)
+}
 
-    // Create handshake future
-    let timeout = match timeout_s {
-        0 => None,
-        seconds => Some(Duration::from_secs(seconds as u64)),
-    };
-    let event_tx_clone = event_tx.clone();
-    let handshake_future = connect_future
-        .and_then(move |ws_client| saltyrtc_client::do_handshake(
-            ws_client,
-            client_arc_handshake,
-            event_tx_clone,
-            timeout,
-        ));
-    let handshake_future_box: Box<dyn Future<Item=WsClient, Error=SaltyError>> = Box::new(handshake_future);
+/// Helper function to return errors.
+fn make_init_ret_error(success: salty_client_init_success_t) -> salty_client_init_ret_t {
+    salty_client_init_ret_t {
+        success,
+        handshake_future: ptr::null(),
+        event_rx: ptr::null(),
+        event_tx: ptr::null(),
+    }
+}
 
+/// Helper function to return a successfully prepared connection.
+fn make_init_ret(
+    handshake: Handshake,
+    event_tx: mpsc::UnboundedSender<Event>,
+    event_rx: mpsc::UnboundedReceiver<Event>,
+) -> salty_client_init_ret_t {
     salty_client_init_ret_t {
         success: salty_client_init_success_t::INIT_OK,
-        handshake_future: Box::into_raw(Box::new(handshake_future_box)) as *const salty_handshake_future_t,
+        handshake_future: Box::into_raw(Box::new(handshake)) as *const salty_handshake_future_t,
         event_tx: Box::into_raw(Box::new(event_tx)) as *const salty_channel_event_tx_t,
         event_rx: Box::into_raw(Box::new(event_rx)) as *const salty_channel_event_rx_t,
     }
 }
 
-/// Connect to the specified SaltyRTC server, do the server and peer handshake
-/// and run the task loop.
+type HandshakeFuture = Box<dyn Future<Item=WsClient, Error=SaltyError>>;
+
+/// A handshake as returned by `salty_client_init` or `salty_client_init_pooled`.
+enum Handshake {
+    /// The handshake future, to be run on the event loop of the calling thread.
+    Started(HandshakeFuture),
+
+    /// The handshake future has not been created yet. This is done on the
+    /// worker thread of an event loop pool, because the future (and the
+    /// connection created by it) must not leave the thread it was created on.
+    Pending(PendingHandshake),
+}
+
+/// Everything required to create a handshake future.
+struct PendingHandshake {
+    hostname: String,
+    port: u16,
+    tls_connector: TlsConnector,
+    client_arc: Arc<RwLock<SaltyClient>>,
+    timeout: Option<Duration>,
+}
+
+impl PendingHandshake {
+    /// Validate the connection parameters.
+    unsafe fn new(
+        host: *const c_char,
+        port: u16,
+        client: *const salty_client_t,
+        timeout_s: u16,
+        ca_cert: *const u8,
+        ca_cert_len: u32,
+    ) -> Result<Self, salty_client_init_success_t> {
+        // Null pointer checks
+        if host.is_null() {
+            error!("Hostname pointer is null");
+            return Err(salty_client_init_success_t::INIT_NULL_ARGUMENT);
+        }
+        if client.is_null() {
+            error!("Client pointer is null");
+            return Err(salty_client_init_success_t::INIT_NULL_ARGUMENT);
+        }
+
+        // Get host string
+        let hostname_cstr = CStr::from_ptr(host);
+        let hostname = match hostname_cstr.to_str() {
+            Ok(host) => host.to_string(),
+            Err(e) => {
+                error!("Host argument is not valid UTF-8: {}", e);
+                trace!("Host bytes (without null termination): {:?}", hostname_cstr.to_bytes());
+                return Err(salty_client_init_success_t::INIT_INVALID_HOST);
+            },
+        };
+
+        // Recreate client Arc
+        let client_arc: Arc<RwLock<SaltyClient>> = Arc::from_raw(client as *const RwLock<SaltyClient>);
+
+        // Clone Arc so that the client instance can be reused
+        let client_arc_handshake = client_arc.clone();
+        mem::forget(client_arc);
+
+        // Read CA certificate (if present)
+        let ca_cert_opt: Option<Certificate> = if ca_cert.is_null() {
+            debug!("Using system CA chain");
+            None
+        } else {
+            debug!("Reading CA certificate");
+            let bytes: &[u8] = slice::from_raw_parts(ca_cert, ca_cert_len as usize);
+            Some(match Certificate::from_der(bytes) {
+                Ok(cert) => cert,
+                Err(e) => {
+                    error!("Could not parse DER encoded CA certificate: {}", e);
+                    return Err(salty_client_init_success_t::INIT_CERTIFICATE_ERROR);
+                }
+            })
+        };
+
+        // Create TlsConnector
+        let mut tls_builder = TlsConnector::builder();
+        tls_builder.min_protocol_version(Some(Protocol::Tlsv10));
+        if let Some(cert) = ca_cert_opt {
+            tls_builder.add_root_certificate(cert);
+        }
+        let tls_connector = match tls_builder.build() {
+            Ok(val) => val,
+            Err(e) => {
+                error!("Could not create TlsConnector: {}", e);
+                return Err(salty_client_init_success_t::INIT_TLS_ERROR);
+            }
+        };
+
+        let timeout = match timeout_s {
+            0 => None,
+            seconds => Some(Duration::from_secs(seconds as u64)),
+        };
+        Ok(PendingHandshake { hostname, port, tls_connector, client_arc: client_arc_handshake, timeout })
+    }
+
+    /// Create the handshake future and the event channel.
+    ///
+    /// The handshake future registers with the event loop of the thread that
+    /// polls it first and must not be moved to another thread afterwards.
+    fn start(self) -> Result<(HandshakeFuture, mpsc::UnboundedSender<Event>, mpsc::UnboundedReceiver<Event>), ()> {
+        // Create connect future
+        let (connect_future, event_channel) = match saltyrtc_client::connect(
+            &self.hostname,
+            self.port,
+            Some(self.tls_connector),
+            self.client_arc.clone(),
+        ) {
+            Ok(data) => data,
+            Err(e) => {
+                error!("Could not create connect future: {}", e);
+                return Err(());
+            },
+        };
+
+        // Split event channel
+        let (event_tx, event_rx) = event_channel.split();
+
+        // Create handshake future
+        let client_arc = self.client_arc;
+        let timeout = self.timeout;
+        let event_tx_clone = event_tx.clone();
+        let handshake_future = connect_future
+            .and_then(move |ws_client| saltyrtc_client::do_handshake(
+                ws_client,
+                client_arc,
+                event_tx_clone,
+                timeout,
+            ));
+        Ok((Box::new(handshake_future), event_tx, event_rx))
+    }
+
+    /// Create the handshake future on the event loop of `handle`.
+    ///
+    /// The events of the connection are forwarded to `event_tx`. Return the
+    /// handshake future and the sending end of the connection's event
+    /// channel.
+    fn start_on(self, handle: &Handle, event_tx: mpsc::UnboundedSender<Event>)
+                -> Result<(HandshakeFuture, mpsc::UnboundedSender<Event>), ()> {
+        let (handshake_future, connection_event_tx, connection_event_rx) = self.start()?;
+        handle.spawn(
+            connection_event_rx
+                .forward(event_tx.sink_map_err(|_| warn!("Could not forward event, event channel closed")))
+                .map(|_| ())
+        );
+        Ok((handshake_future, connection_event_tx))
+    }
+}
+
+/// Connect to the specified SaltyRTC server, do the server and peer handshake
+/// and run the task loop.
 ///
 /// This is a blocking call. It will end once the connection has been terminated.
 /// You should probably run this in a separate thread.
 ///
 /// Parameters:
 ///     handshake_future (`*salty_handshake_future_t`, moved):
-///         Pointer to the handshake future, created with `salty_client_init`.
+///         Pointer to the handshake future, created with `salty_client_init`
+///         or `salty_client_init_pooled`.
 ///     client (`*salty_client_t`, borrowed):
 ///         Pointer to a `salty_client_t` instance.
 ///     event_loop (`*salty_event_loop_t`, borrowed):
 ///         The event loop that is also associated with the task.
 ///     event_tx (`*salty_channel_event_tx_t`, moved):
 ///         The sending end of the channel for incoming events.
-///         This object is returned from `salty_client_init`.
+///         This object is returned from `salty_client_init` or
+///         `salty_client_init_pooled`.
 ///     sender_rx (`*salty_channel_sender_rx_t`, moved):
 ///         The receiving end of the channel for outgoing messages.
 ///         This object is returned when creating a client instance.
@@ -1024,122 +1556,284 @@ pub unsafe extern "C" fn salty_client_connect(
     // Get event channel sender reference
     let event_tx_box = Box::from_raw(event_tx as *mut mpsc::UnboundedSender<Event>);
 
-    // Get handshake future reference
-    let handshake_future_box = Box::from_raw(
-        handshake_future as *mut Box<dyn Future<Item=WsClient, Error=SaltyError>>
-    );
+    // Get handshake reference
+    let handshake_box = Box::from_raw(handshake_future as *mut Handshake);
 
     // Get channel sender instances
-    let sender_rx_box = Box::from_raw(sender_rx as *mut mpsc::UnboundedReceiver<OutgoingMessage>);
+    let sender_rx_box = Box::from_raw(sender_rx as *mut QueueReceiver<OutgoingMessage>);
     let disconnect_rx_box = Box::from_raw(disconnect_rx as *mut oneshot::Receiver<CloseCode>);
 
-    // Run handshake future to completion
-    let (ws_client, disconnect_rx_box) = match core.run((*handshake_future_box).select2(disconnect_rx_box)) {
-        // Handshake done
-        Ok(Either::A((ws_client, disconnect_rx_box))) => {
-            info!("Handshake done");
-            (ws_client, disconnect_rx_box)
+    // Create the handshake future on this thread if it has been prepared for
+    // an event loop pool
+    let (handshake_future, event_tx) = match *handshake_box {
+        Handshake::Started(handshake_future) => (handshake_future, *event_tx_box),
+        Handshake::Pending(handshake) => match handshake.start_on(&core.handle(), *event_tx_box) {
+            Ok(val) => val,
+            Err(()) => return salty_client_connect_success_t::CONNECT_ERROR,
         },
+    };
 
-        // Disconnect requested
-        Ok(Either::B(_)) => {
-            info!("Handshake ended (disconnected by us)");
-            return salty_client_connect_success_t::CONNECT_OK;
-        },
+    // Run handshake and task loop to completion
+    let connection = connection_future(
+        handshake_future,
+        client_arc_task_loop,
+        event_tx,
+        *sender_rx_box,
+        *disconnect_rx_box,
+    );
+    match core.run(connection) {
+        Ok(success) => success,
+        Err(_) => salty_client_connect_success_t::CONNECT_ERROR,
+    }
+}
 
-        // Errors
-        Err(Either::A((e, _))) => {
-            error!("Connection error: {}", e);
-            return salty_client_connect_success_t::CONNECT_ERROR;
-        },
-        Err(Either::B((e, _))) => {
-            error!("Error while listening for disconnect: {}", e);
+/// Connect to the specified SaltyRTC server on a worker of an event loop pool,
+/// do the server and peer handshake and run the task loop.
+///
+/// In contrast to `salty_client_connect`, this call does not block. The
+/// connection runs on the worker until it has been terminated. The result of
+/// the connection is logged.
+///
+/// Parameters:
+///     handshake_future (`*salty_handshake_future_t`, moved):
+///         Pointer to the handshake future, created with `salty_client_init_pooled`.
+///     client (`*salty_client_t`, borrowed):
+///         Pointer to a `salty_client_t` instance.
+///     pool (`*salty_event_loop_pool_t`, borrowed):
+///         The event loop pool.
+///     worker (`uint32_t`, copied):
+///         The worker that is also associated with the task, i.e. the worker
+///         whose remote handle has been used to create the client.
+///     event_tx (`*salty_channel_event_tx_t`, moved):
+///         The sending end of the channel for incoming events.
+///         This object is returned from `salty_client_init_pooled`.
+///     sender_rx (`*salty_channel_sender_rx_t`, moved):
+///         The receiving end of the channel for outgoing messages.
+///         This object is returned when creating a client instance.
+///     disconnect_rx (`*salty_channel_disconnect_rx_t`, moved):
+///         The receiving end of the channel for closing the connection.
+///         This object is returned when creating a client instance.
+/// Returns:
+///     `CONNECT_OK` if the connection has been started on the worker.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_connect_pooled(
+    handshake_future: *const salty_handshake_future_t,
+    client: *const salty_client_t,
+    pool: *const salty_event_loop_pool_t,
+    worker: u32,
+    event_tx: *const salty_channel_event_tx_t,
+    sender_rx: *const salty_channel_sender_rx_t,
+    disconnect_rx: *const salty_channel_disconnect_rx_t,
+) -> salty_client_connect_success_t {
+    trace!("salty_client_connect_pooled: Initializing");
+
+    // Null pointer checks
+    if handshake_future.is_null() || client.is_null() || pool.is_null() || event_tx.is_null() {
+        error!("Handshake future, client, pool or event channel pointer is null");
+        return salty_client_connect_success_t::CONNECT_NULL_ARGUMENT;
+    }
+    if sender_rx.is_null() {
+        error!("Sender RX channel pointer is null");
+        return salty_client_connect_success_t::CONNECT_NULL_ARGUMENT;
+    }
+    if disconnect_rx.is_null() {
+        error!("Disconnect RX channel pointer is null");
+        return salty_client_connect_success_t::CONNECT_NULL_ARGUMENT;
+    }
+    let pool = &*(pool as *const EventLoopPool) as &EventLoopPool;
+    if pool.remote(worker as usize).is_none() {
+        error!("Invalid worker index: {}", worker);
+        return salty_client_connect_success_t::CONNECT_ERROR;
+    }
+
+    // Recreate client Arc
+    let client_arc: Arc<RwLock<SaltyClient>> = Arc::from_raw(client as *const RwLock<SaltyClient>);
+
+    // Clone Arc so that the client instance can be reused
+    let client_arc_task_loop = client_arc.clone();
+    mem::forget(client_arc);
+
+    // Take ownership of the arguments
+    let handshake_box = Box::from_raw(handshake_future as *mut Handshake);
+    let event_tx_box = Box::from_raw(event_tx as *mut mpsc::UnboundedSender<Event>);
+    let sender_rx_box = Box::from_raw(sender_rx as *mut QueueReceiver<OutgoingMessage>);
+    let disconnect_rx_box = Box::from_raw(disconnect_rx as *mut oneshot::Receiver<CloseCode>);
+
+    // Only a pending handshake may be moved to the worker, a handshake future
+    // is bound to the thread that created it
+    let handshake = match *handshake_box {
+        Handshake::Pending(handshake) => handshake,
+        Handshake::Started(_) => {
+            error!("Handshake has not been created with salty_client_init_pooled");
             return salty_client_connect_success_t::CONNECT_ERROR;
         },
     };
 
+    // Create the handshake future and run the handshake and task loop on the
+    // worker
+    let spawn_res = pool.spawn(worker as usize, move |handle| {
+        let (handshake_future, event_tx) = match handshake.start_on(handle, *event_tx_box) {
+            Ok(val) => val,
+            Err(()) => return Either::B(future::ok(())),
+        };
+        Either::A(connection_future(
+            handshake_future,
+            client_arc_task_loop,
+            event_tx,
+            *sender_rx_box,
+            *disconnect_rx_box,
+        ).map(|success| debug!("Pooled connection ended with {:?}", success)))
+    });
+    match spawn_res {
+        Ok(_) => salty_client_connect_success_t::CONNECT_OK,
+        Err(e) => {
+            error!("Could not start connection: {}", e);
+            salty_client_connect_success_t::CONNECT_ERROR
+        }
+    }
+}
+
+/// Create a future that runs the handshake and then the task loop until
+/// the connection has ended.
+///
+/// The future resolves to the result of the connection. It never fails.
+fn connection_future(
+    handshake_future: HandshakeFuture,
+    client_arc: Arc<RwLock<SaltyClient>>,
+    event_tx: mpsc::UnboundedSender<Event>,
+    sender_rx: QueueReceiver<OutgoingMessage>,
+    disconnect_rx: oneshot::Receiver<CloseCode>,
+) -> impl Future<Item=salty_client_connect_success_t, Error=()> {
+    handshake_future.select2(disconnect_rx).then(move |res| {
+        let (ws_client, disconnect_rx) = match res {
+            // Handshake done
+            Ok(Either::A((ws_client, disconnect_rx))) => {
+                info!("Handshake done");
+                (ws_client, disconnect_rx)
+            },
+
+            // Disconnect requested
+            Ok(Either::B(_)) => {
+                info!("Handshake ended (disconnected by us)");
+                return Either::B(future::ok(salty_client_connect_success_t::CONNECT_OK));
+            },
+
+            // Errors
+            Err(Either::A((e, _))) => {
+                error!("Connection error: {}", e);
+                return Either::B(future::ok(salty_client_connect_success_t::CONNECT_ERROR));
+            },
+            Err(Either::B((e, _))) => {
+                error!("Error while listening for disconnect: {}", e);
+                return Either::B(future::ok(salty_client_connect_success_t::CONNECT_ERROR));
+            },
+        };
+
+        match task_loop_future(ws_client, client_arc, event_tx, sender_rx, disconnect_rx) {
+            Ok(task_loop) => Either::A(task_loop),
+            Err(reason) => Either::B(future::ok(reason)),
+        }
+    })
+}
+
+/// Start the task loop after a successful handshake.
+///
+/// The returned future resolves once the connection has ended.
+fn task_loop_future(
+    ws_client: WsClient,
+    client_arc: Arc<RwLock<SaltyClient>>,
+    event_tx: mpsc::UnboundedSender<Event>,
+    sender_rx: QueueReceiver<OutgoingMessage>,
+    disconnect_rx: oneshot::Receiver<CloseCode>,
+) -> Result<impl Future<Item=salty_client_connect_success_t, Error=()>, salty_client_connect_success_t> {
     // Create task loop future
     let (task, task_loop) = match saltyrtc_client::task_loop(
         ws_client,
-        client_arc_task_loop,
-        *event_tx_box,
+        client_arc,
+        event_tx,
     ) {
         Ok(val) => val,
         Err(e) => {
             error!("Could not start task loop: {}", e);
-            return salty_client_connect_success_t::CONNECT_ERROR;
+            return Err(salty_client_connect_success_t::CONNECT_ERROR);
         },
     };
 
-    // Get access to task tx channel
-    let task_sender: mpsc::UnboundedSender<OutgoingMessage> = {
+    // Get access to task tx channel and the incoming backpressure
+    let (task_sender, backpressure) = {
         // Lock task mutex
         let mut task_locked = match task.lock() {
             Ok(guard) => guard,
             Err(e) => {
                 error!("Could not lock task mutex: {}", e);
-                return salty_client_connect_success_t::CONNECT_ERROR;
+                return Err(salty_client_connect_success_t::CONNECT_ERROR);
             }
         };
 
         // Downcast generic Task to a RelayedDataTask
-        let rdt: &mut RelayedDataTask = {
+        let rdt: &mut RelayedDataTask<QueueSender<MessageEvent>> = {
             let downcast_res = (&mut **task_locked as &mut dyn Task)
-                .downcast_mut::<RelayedDataTask>();
+                .downcast_mut::<RelayedDataTask<QueueSender<MessageEvent>>>();
             match downcast_res {
                 Some(task) => task,
                 None => {
                     error!("Could not downcast task instance");
-                    return salty_client_connect_success_t::CONNECT_ERROR;
+                    return Err(salty_client_connect_success_t::CONNECT_ERROR);
                 }
             }
         };
 
         match rdt.get_sender() {
-            Ok(sender) => sender,
+            Ok(sender) => (sender, rdt.incoming_backpressure()),
             Err(e) => {
                 error!("Could not get task sender: {}", e);
-                return salty_client_connect_success_t::CONNECT_ERROR;
+                return Err(salty_client_connect_success_t::CONNECT_ERROR);
             }
         }
     };
 
     // Forward outgoing messages to task
-    let send_loop = (*sender_rx_box).forward(
+    let send_loop = sender_rx.forward(
         task_sender.sink_map_err(|e| error!("Could not sink message: {}", e))
     );
 
-    // Run task loop future to completion
-    let connection = connection::new(*disconnect_rx_box, send_loop, task_loop);
-    match core.run(connection) {
-        // Disconnect requested
-        Ok(Either3::A(_)) => {
-            info!("Connection ended (disconnected by us)");
-            salty_client_connect_success_t::CONNECT_OK
-        },
+    // Run task loop future to completion. The task loop (and thereby the
+    // socket) is not polled while the incoming channel is full.
+    let task_loop = connection::backpressured(task_loop, backpressure);
+    let connection = connection::new(disconnect_rx, send_loop, task_loop);
+    Ok(connection.then(move |res| {
+        // Keep the task alive until the connection has ended
+        let _task = task;
+        Ok::<_, ()>(match res {
+            // Disconnect requested
+            Ok(Either3::A(_)) => {
+                info!("Connection ended (disconnected by us)");
+                salty_client_connect_success_t::CONNECT_OK
+            },
 
-        // All OK
-        Ok(Either3::B(_)) |
-        Ok(Either3::C(_)) => {
-            info!("Connection ended (closed by ");
-            salty_client_connect_success_t::CONNECT_OK
-        }
+            // All OK
+            Ok(Either3::B(_)) |
+            Ok(Either3::C(_)) => {
+                info!("Connection ended (closed by ");
+                salty_client_connect_success_t::CONNECT_OK
+            }
 
-        Err(Either3::A(e)) => {
-            error!("Disconnect receiver error: {}", e);
-            salty_client_connect_success_t::CONNECT_ERROR
-        },
+            Err(Either3::A(e)) => {
+                error!("Disconnect receiver error: {}", e);
+                salty_client_connect_success_t::CONNECT_ERROR
+            },
 
-        Err(Either3::B(_)) => {
-            error!("Send loop error");
-            salty_client_connect_success_t::CONNECT_ERROR
-        },
+            Err(Either3::B(_)) => {
+                error!("Send loop error");
+                salty_client_connect_success_t::CONNECT_ERROR
+            },
 
-        Err(Either3::C(e)) => {
-            error!("Task loop error: {}", e);
-            salty_client_connect_success_t::CONNECT_ERROR
-        },
-    }
+            Err(Either3::C(e)) => {
+                error!("Task loop error: {}", e);
+                salty_client_connect_success_t::CONNECT_ERROR
+            },
+        })
+    }))
 }
 
 enum OutgoingMessageType {
@@ -1147,6 +1841,52 @@ enum OutgoingMessageType {
     Application,
 }
 
+/// Parse message bytes into a rmpv `Value`.
+unsafe fn parse_msgpack(msg: *const u8, msg_len: usize) -> Result<Value, salty_client_send_success_t> {
+    if msg.is_null() {
+        error!("Message pointer is null");
+        return Err(salty_client_send_success_t::SEND_NULL_ARGUMENT);
+    }
+
+    let msg_slice: &[u8] = slice::from_raw_parts(msg, msg_len);
+    let mut msg_reader = BufReader::with_capacity(msg_slice.len(), msg_slice);
+    let msg: Value = match read_value(&mut msg_reader) {
+        Ok(val) => val,
+        Err(e) => {
+            error!("Could not send bytes: Not valid MsgPack data: {}", e);
+            return Err(salty_client_send_success_t::SEND_MESSAGE_ERROR);
+        }
+    };
+
+    // Make sure that the buffer was fully consumed
+    if msg_reader.bytes().next().is_some() {
+        error!("Could not send bytes: Not valid msgpack data (buffer not fully consumed)");
+        return Err(salty_client_send_success_t::SEND_MESSAGE_ERROR);
+    }
+
+    Ok(msg)
+}
+
+fn make_outgoing_message(msg_type: &OutgoingMessageType, msg: Value) -> OutgoingMessage {
+    match *msg_type {
+        OutgoingMessageType::Task => OutgoingMessage::Data(msg),
+        OutgoingMessageType::Application => OutgoingMessage::Application(msg),
+    }
+}
+
+fn make_send_error(e: TrySendError) -> salty_client_send_success_t {
+    match e {
+        TrySendError::Full => {
+            debug!("Outgoing channel is full");
+            salty_client_send_success_t::SEND_WOULD_BLOCK
+        },
+        TrySendError::Disconnected => {
+            error!("Sending message failed: Channel is disconnected");
+            salty_client_send_success_t::SEND_ERROR
+        },
+    }
+}
+
 unsafe fn salty_client_send_bytes(
     msg_type: OutgoingMessageType,
     sender_tx: *const salty_channel_sender_tx_t,
@@ -1160,40 +1900,71 @@ unsafe fn salty_client_send_bytes(
         error!("Sender channel pointer is null");
         return salty_client_send_success_t::SEND_NULL_ARGUMENT;
     }
-    if msg.is_null() {
-        error!("Message pointer is null");
-        return salty_client_send_success_t::SEND_NULL_ARGUMENT;
-    }
 
-    // Get pointer to UnboundedSender
-    let sender = &*(sender_tx as *const mpsc::UnboundedSender<OutgoingMessage>) as &mpsc::UnboundedSender<OutgoingMessage>;
+    // Get pointer to QueueSender
+    let sender = &*(sender_tx as *const QueueSender<OutgoingMessage>) as &QueueSender<OutgoingMessage>;
 
-    // Parse message bytes into a rmpv `Value`
-    let msg_slice: &[u8] = slice::from_raw_parts(msg, msg_len as usize);
-    let mut msg_reader = BufReader::with_capacity(msg_slice.len(), msg_slice);
-    let msg: Value = match read_value(&mut msg_reader) {
+    // Parse message bytes
+    let msg = match parse_msgpack(msg, msg_len as usize) {
         Ok(val) => val,
-        Err(e) => {
-            error!("Could not send bytes: Not valid MsgPack data: {}", e);
-            return salty_client_send_success_t::SEND_MESSAGE_ERROR;
-        }
+        Err(reason) => return reason,
     };
 
-    // Make sure that the buffer was fully consumed
-    if msg_reader.bytes().next().is_some() {
-        error!("Could not send bytes: Not valid msgpack data (buffer not fully consumed)");
+    match sender.try_send(make_outgoing_message(&msg_type, msg)) {
+        Ok(_) => salty_client_send_success_t::SEND_OK,
+        Err(e) => make_send_error(e),
+    }
+}
+
+unsafe fn salty_client_send_bytes_batch(
+    msg_type: OutgoingMessageType,
+    sender_tx: *const salty_channel_sender_tx_t,
+    msgs: *const salty_iovec_t,
+    msgs_count: size_t,
+) -> salty_client_send_success_t {
+    trace!("salty_client_send_bytes_batch");
+
+    // Null pointer checks
+    if sender_tx.is_null() {
+        error!("Sender channel pointer is null");
+        return salty_client_send_success_t::SEND_NULL_ARGUMENT;
+    }
+    if msgs.is_null() {
+        error!("Messages pointer is null");
+        return salty_client_send_success_t::SEND_NULL_ARGUMENT;
+    }
+
+    // Get pointer to QueueSender
+    let sender = &*(sender_tx as *const QueueSender<OutgoingMessage>) as &QueueSender<OutgoingMessage>;
+
+    // A batch larger than the channel would never fit
+    let capacity = sender.capacity();
+    if capacity != 0 && msgs_count > capacity {
+        error!("Could not send batch: {} messages exceed the channel capacity of {}", msgs_count, capacity);
         return salty_client_send_success_t::SEND_MESSAGE_ERROR;
     }
 
-    match sender.unbounded_send(match msg_type {
-        OutgoingMessageType::Task => OutgoingMessage::Data(msg),
-        OutgoingMessageType::Application => OutgoingMessage::Application(msg),
-    }) {
+    // Parse all messages before sending any of them, so that an invalid
+    // message does not leave a partially sent batch behind.
+    let iovecs: &[salty_iovec_t] = slice::from_raw_parts(msgs, msgs_count);
+    let mut values = Vec::with_capacity(iovecs.len());
+    for iovec in iovecs {
+        match parse_msgpack(iovec.iov_base, iovec.iov_len) {
+            Ok(val) => values.push(val),
+            Err(reason) => return reason,
+        }
+    }
+
+    // The sending loop on the event loop is only woken up once for the
+    // whole batch, because it is still pending while the batch is enqueued.
+    // If the outgoing channel does not have room for the whole batch,
+    // nothing is sent.
+    let msgs = values.into_iter()
+        .map(|msg| make_outgoing_message(&msg_type, msg))
+        .collect();
+    match sender.try_send_all(msgs) {
         Ok(_) => salty_client_send_success_t::SEND_OK,
-        Err(e) => {
-            error!("Sending message failed: {}", e);
-            salty_client_send_success_t::SEND_ERROR
-        },
+        Err(e) => make_send_error(e),
     }
 }
 
@@ -1233,10 +2004,63 @@ pub unsafe extern "C" fn salty_client_send_application_bytes(
     salty_client_send_bytes(OutgoingMessageType::Application, sender_tx, msg, msg_len)
 }
 
+/// Send multiple task messages through the outgoing channel.
+///
+/// All messages are validated before the first one is sent. If any message
+/// is invalid, or if the outgoing channel does not have room for all of
+/// them, nothing is sent.
+///
+/// A batch may contain at most as many messages as the capacity of a
+/// bounded outgoing channel. Larger batches are rejected with
+/// `SEND_MESSAGE_ERROR`, since retrying them would never succeed.
+///
+/// Parameters:
+///     sender_tx (`*salty_channel_sender_tx_t`, borrowed):
+///         The sending end of the channel for outgoing messages.
+///     msgs (`*salty_iovec_t`, borrowed):
+///         Pointer to an array of message buffers.
+///     msgs_count (`size_t`, copied):
+///         Number of entries in the `msgs` array.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_send_task_bytes_batch(
+    sender_tx: *const salty_channel_sender_tx_t,
+    msgs: *const salty_iovec_t,
+    msgs_count: size_t,
+) -> salty_client_send_success_t {
+    salty_client_send_bytes_batch(OutgoingMessageType::Task, sender_tx, msgs, msgs_count)
+}
+
+/// Send multiple application messages through the outgoing channel.
+///
+/// All messages are validated before the first one is sent. If any message
+/// is invalid, or if the outgoing channel does not have room for all of
+/// them, nothing is sent.
+///
+/// A batch may contain at most as many messages as the capacity of a
+/// bounded outgoing channel. Larger batches are rejected with
+/// `SEND_MESSAGE_ERROR`, since retrying them would never succeed.
+///
+/// Parameters:
+///     sender_tx (`*salty_channel_sender_tx_t`, borrowed):
+///         The sending end of the channel for outgoing messages.
+///     msgs (`*salty_iovec_t`, borrowed):
+///         Pointer to an array of message buffers.
+///     msgs_count (`size_t`, copied):
+///         Number of entries in the `msgs` array.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_send_application_bytes_batch(
+    sender_tx: *const salty_channel_sender_tx_t,
+    msgs: *const salty_iovec_t,
+    msgs_count: size_t,
+) -> salty_client_send_success_t {
+    salty_client_send_bytes_batch(OutgoingMessageType::Application, sender_tx, msgs, msgs_count)
+}
+
 enum BlockingMode {
     BLOCKING,
     NONBLOCKING,
     TIMEOUT(Duration),
+    NOTIFY(Arc<Readiness>),
 }
 
 impl BlockingMode {
@@ -1250,22 +2074,38 @@ impl BlockingMode {
         }
     }
 
+    /// The blocking mode for receiving again after `elapsed`, i.e. with the
+    /// remaining timeout. Return `None` if the timeout has been reached.
+    fn remaining(&self, elapsed: Duration) -> Option<Self> {
+        match *self {
+            BlockingMode::BLOCKING => Some(BlockingMode::BLOCKING),
+            BlockingMode::NONBLOCKING => Some(BlockingMode::NONBLOCKING),
+            BlockingMode::TIMEOUT(duration) => match duration.checked_sub(elapsed) {
+                Some(remaining) if remaining > Duration::from_millis(0) => Some(BlockingMode::TIMEOUT(remaining)),
+                _ => None,
+            },
+            BlockingMode::NOTIFY(ref readiness) => Some(BlockingMode::NOTIFY(readiness.clone())),
+        }
+    }
+
     /// Receive somedata through a channel receiver.
     ///
     /// Type arguments:
     ///
+    /// - R: The channel receiver.
     /// - D: The type coming in through the channel receiver.
     /// - T: The return type of this function.
     /// - P: The function processing incoming data.
     /// - E: The function creating error results.
-    fn recv<D, T, P, E>(
+    fn recv<R, D, T, P, E>(
         &self,
         content_type: &str,
-        rx: &mut mpsc::UnboundedReceiver<D>,
+        rx: &mut R,
         process_data: P,
         make_error: E,
     ) -> T
     where
+        R: Stream<Item=D, Error=()>,
         P: FnOnce(D) -> T,
         E: FnOnce(salty_client_recv_success_t) -> T,
     {
@@ -1294,6 +2134,21 @@ impl BlockingMode {
                     },
                 }
             }
+            BlockingMode::NOTIFY(ref readiness) => {
+                // Clear before polling, so that a message arriving in between
+                // is either returned or signalled.
+                readiness.clear();
+                let notify_handle = NotifyHandle::from(readiness.clone());
+                match executor::spawn(rx).poll_stream_notify(&notify_handle, 0) {
+                    Ok(Async::Ready(Some(data))) => process_data(data),
+                    Ok(Async::Ready(None)) => make_error(salty_client_recv_success_t::RECV_STREAM_ENDED),
+                    Ok(Async::NotReady) => make_error(salty_client_recv_success_t::RECV_NO_DATA),
+                    Err(_) => {
+                        error!("Could not receive {}", content_type);
+                        make_error(salty_client_recv_success_t::RECV_ERROR)
+                    },
+                }
+            }
             BlockingMode::TIMEOUT(duration) => {
                 let timeout_future = Timer::default().sleep(duration).map_err(|_| ());
                 let rx_future = rx.into_future();
@@ -1313,23 +2168,76 @@ impl BlockingMode {
 }
 
 
-/// Receive a message from the incoming channel.
+/// Convert a message event into a `salty_msg_t`.
 ///
-/// Parameters:
-///     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
-///         The receiving end of the channel for incoming message events.
-///     timeout_ms (`*uint32_t`, borrowed):
-///         - If this is `null`, then the function call will block.
-///         - If this is `0`, then the function will never block. It will either return an event
-///         or `RECV_NO_DATA`.
-///         - If this is a value > 0, then the specified timeout in milliseconds will be used.
-///         Either an event or `RECV_NO_DATA` (in the case of a timeout) will be returned.
-#[no_mangle]
-pub unsafe extern "C" fn salty_client_recv_msg(
-    receiver_rx: *const salty_channel_receiver_rx_t,
-    timeout_ms: *const u32,
-) -> salty_client_recv_msg_ret_t {
-    trace!("salty_client_recv_msg");
+/// The message bytes are allocated on the heap and must be freed with
+/// `free_msg_bytes`.
+fn make_msg(msg: MessageEvent) -> Result<salty_msg_t, salty_client_recv_success_t> {
+
+    // Another helper function :)
+    fn _data_or_application(val: Value, msg_type: salty_msg_type_t) -> Result<salty_msg_t, salty_client_recv_success_t> {
+        // Encode msgpack bytes
+        let bytes: Vec<u8> = match rmps::to_vec_named(&val) {
+            Ok(bytes) => bytes,
+            Err(e) => {
+                error!("Could not encode value: {}", e);
+                return Err(salty_client_recv_success_t::RECV_ERROR);
+            }
+        };
+
+        // Get pointer to bytes on heap
+        let bytes_box = bytes.into_boxed_slice();
+        let bytes_len = bytes_box.len();
+        let bytes_ptr = Box::into_raw(bytes_box);
+
+        Ok(salty_msg_t {
+            msg_type,
+            msg_bytes: bytes_ptr as *const u8,
+            msg_bytes_len: bytes_len,
+            close_code: 0,
+        })
+    }
+
+    match msg {
+        MessageEvent::Data(val) => _data_or_application(val, salty_msg_type_t::MSG_TASK),
+        MessageEvent::Application(val) => _data_or_application(val, salty_msg_type_t::MSG_APPLICATION),
+        MessageEvent::Close(close_code) => Ok(salty_msg_t {
+            msg_type: salty_msg_type_t::MSG_CLOSE,
+            msg_bytes: ptr::null(),
+            msg_bytes_len: 0,
+            close_code: close_code.as_number(),
+        }),
+    }
+}
+
+/// Free the message bytes of a `salty_msg_t` created by `make_msg`.
+unsafe fn free_msg_bytes(msg: &salty_msg_t) {
+    if !msg.msg_bytes.is_null() {
+        Vec::from_raw_parts(
+            msg.msg_bytes as *mut u8,
+            msg.msg_bytes_len,
+            msg.msg_bytes_len,
+        );
+    }
+}
+
+/// Receive a message from the incoming channel.
+///
+/// Parameters:
+///     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+///         The receiving end of the channel for incoming message events.
+///     timeout_ms (`*uint32_t`, borrowed):
+///         - If this is `null`, then the function call will block.
+///         - If this is `0`, then the function will never block. It will either return an event
+///         or `RECV_NO_DATA`.
+///         - If this is a value > 0, then the specified timeout in milliseconds will be used.
+///         Either an event or `RECV_NO_DATA` (in the case of a timeout) will be returned.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_recv_msg(
+    receiver_rx: *const salty_channel_receiver_rx_t,
+    timeout_ms: *const u32,
+) -> salty_client_recv_msg_ret_t {
+    trace!("salty_client_recv_msg");
 
     // Helper function: Error
     fn make_error(reason: salty_client_recv_success_t) -> salty_client_recv_msg_ret_t {
@@ -1338,59 +2246,12 @@ pub unsafe extern "C" fn salty_client_recv_msg(
 
     // Helper function: Success
     fn make_ret(msg: MessageEvent) -> salty_client_recv_msg_ret_t {
-
-        // Another helper function :)
-        fn _data_or_application(val: Value, msg_type: salty_msg_type_t) -> salty_client_recv_msg_ret_t {
-            // Encode msgpack bytes
-            let bytes: Vec<u8> = match rmps::to_vec_named(&val) {
-                Ok(bytes) => bytes,
-                Err(e) => {
-                    error!("Could not encode value: {}", e);
-                    return make_error(salty_client_recv_success_t::RECV_ERROR);
-                }
-            };
-
-            // Get pointer to bytes on heap
-            let bytes_box = bytes.into_boxed_slice();
-            let bytes_len = bytes_box.len();
-            let bytes_ptr = Box::into_raw(bytes_box);
-
-            // Make event struct
-            let msg = salty_msg_t {
-                msg_type,
-                msg_bytes: bytes_ptr as *const u8,
-                msg_bytes_len: bytes_len,
-                close_code: 0,
-            };
-
-            // Get pointer to event on heap
-            let msg_ptr = Box::into_raw(Box::new(msg));
-
-            // TODO: Add function to free allocated memory.
-
-            salty_client_recv_msg_ret_t {
+        match make_msg(msg) {
+            Ok(msg) => salty_client_recv_msg_ret_t {
                 success: salty_client_recv_success_t::RECV_OK,
-                msg: msg_ptr,
-            }
-        }
-
-        match msg {
-            MessageEvent::Data(val) => _data_or_application(val, salty_msg_type_t::MSG_TASK),
-            MessageEvent::Application(val) => _data_or_application(val, salty_msg_type_t::MSG_APPLICATION),
-            MessageEvent::Close(close_code) => {
-                // Make msg struct
-                let msg = salty_msg_t {
-                    msg_type: salty_msg_type_t::MSG_CLOSE,
-                    msg_bytes: ptr::null(),
-                    msg_bytes_len: 0,
-                    close_code: close_code.as_number(),
-                };
-
-                salty_client_recv_msg_ret_t {
-                    success: salty_client_recv_success_t::RECV_OK,
-                    msg: Box::into_raw(Box::new(msg)),
-                }
+                msg: Box::into_raw(Box::new(msg)),
             },
+            Err(reason) => make_error(reason),
         }
     }
 
@@ -1401,8 +2262,8 @@ pub unsafe extern "C" fn salty_client_recv_msg(
     }
 
     // Get channel receiver reference
-    let rx = &mut *(receiver_rx as *mut mpsc::UnboundedReceiver<MessageEvent>)
-          as &mut mpsc::UnboundedReceiver<MessageEvent>;
+    let rx = &mut *(receiver_rx as *mut QueueReceiver<MessageEvent>)
+          as &mut QueueReceiver<MessageEvent>;
 
     // Receive message depending on blocking mode
     let blocking_mode = BlockingMode::from_timeout_ms(timeout_ms);
@@ -1428,12 +2289,170 @@ pub unsafe extern "C" fn salty_client_recv_msg_ret_free(recv_ret: salty_client_r
         return;
     }
     let msg = Box::from_raw(recv_ret.msg as *mut salty_msg_t);
-    if !msg.msg_bytes.is_null() {
-        Vec::from_raw_parts(
-            msg.msg_bytes as *mut u8,
-            msg.msg_bytes_len,
-            msg.msg_bytes_len,
-        );
+    free_msg_bytes(&msg);
+}
+
+/// Receive up to `max_msgs` messages from the incoming channel.
+///
+/// The call waits for the first message according to `timeout_ms`. Then, all
+/// messages that are already queued are returned as well (without waiting),
+/// until `max_msgs` is reached or a close message has been received.
+///
+/// A message that cannot be converted is skipped and the remaining messages
+/// are returned. Only if no message could be converted, `RECV_ERROR` is
+/// returned.
+///
+/// Note: The returned messages must be explicitly freed with
+/// `salty_client_recv_msgs_ret_free`!
+///
+/// Parameters:
+///     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+///         The receiving end of the channel for incoming message events.
+///     max_msgs (`size_t`, copied):
+///         Maximum number of messages to return. Must be at least 1.
+///     timeout_ms (`*uint32_t`, borrowed):
+///         - If this is `null`, then the function call will block.
+///         - If this is `0`, then the function will never block. It will either return messages
+///         or `RECV_NO_DATA`.
+///         - If this is a value > 0, then the specified timeout in milliseconds will be used.
+///         Either messages or `RECV_NO_DATA` (in the case of a timeout) will be returned.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_recv_msg_batch(
+    receiver_rx: *const salty_channel_receiver_rx_t,
+    max_msgs: size_t,
+    timeout_ms: *const u32,
+) -> salty_client_recv_msgs_ret_t {
+    trace!("salty_client_recv_msg_batch");
+
+    // Helper function: Error
+    fn make_error(reason: salty_client_recv_success_t) -> salty_client_recv_msgs_ret_t {
+        salty_client_recv_msgs_ret_t { success: reason, msgs: ptr::null(), msgs_len: 0 }
+    }
+
+    // Null checks
+    if receiver_rx.is_null() {
+        error!("Receiver channel pointer is null");
+        return make_error(salty_client_recv_success_t::RECV_NULL_ARGUMENT);
+    }
+    if max_msgs == 0 {
+        error!("Maximum number of messages must be at least 1");
+        return make_error(salty_client_recv_success_t::RECV_ERROR);
+    }
+
+    // Get channel receiver reference
+    let rx = &mut *(receiver_rx as *mut QueueReceiver<MessageEvent>)
+          as &mut QueueReceiver<MessageEvent>;
+
+    // Wait for the first message depending on blocking mode
+    let blocking_mode = BlockingMode::from_timeout_ms(timeout_ms);
+    let first = blocking_mode.recv(
+        // Content type
+        "message",
+        // Incoming channel
+        rx,
+        // Closure to process a new message
+        |msg| Ok(msg),
+        // Closure to create an error return value
+        |err| Err(err),
+    );
+    let first = match first {
+        Ok(msg) => msg,
+        Err(reason) => return make_error(reason),
+    };
+
+    // Collect all messages that are already queued
+    let mut events = Vec::with_capacity(cmp::min(max_msgs, 64));
+    let mut closed = match first {
+        MessageEvent::Close(_) => true,
+        _ => false,
+    };
+    events.push(first);
+    let drain = future::poll_fn(|| {
+        while !closed && events.len() < max_msgs {
+            match rx.poll()? {
+                Async::Ready(Some(msg)) => {
+                    if let MessageEvent::Close(_) = msg {
+                        closed = true;
+                    }
+                    events.push(msg);
+                },
+                Async::Ready(None) | Async::NotReady => break,
+            }
+        }
+        Ok::<_, ()>(Async::Ready(()))
+    });
+    if drain.wait().is_err() {
+        // The first message has been received already, so return what we have
+        warn!("Could not drain queued messages");
+    }
+
+    // Convert messages. A message that cannot be encoded is skipped (and
+    // logged), so that it does not take the other drained messages with it.
+    let mut msgs: Vec<salty_msg_t> = Vec::with_capacity(events.len());
+    let mut failure = None;
+    for event in events {
+        match make_msg(event) {
+            Ok(msg) => msgs.push(msg),
+            Err(reason) => {
+                warn!("Skipping message that could not be converted");
+                failure = Some(reason);
+            },
+        }
+    }
+    if msgs.is_empty() {
+        if let Some(reason) = failure {
+            return make_error(reason);
+        }
+    }
+
+    // Get pointer to messages on heap
+    let msgs_box = msgs.into_boxed_slice();
+    let msgs_len = msgs_box.len();
+    let msgs_ptr = Box::into_raw(msgs_box) as *const salty_msg_t;
+
+    salty_client_recv_msgs_ret_t {
+        success: salty_client_recv_success_t::RECV_OK,
+        msgs: msgs_ptr,
+        msgs_len,
+    }
+}
+
+/// Free a `salty_client_recv_msgs_ret_t` instance.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_recv_msgs_ret_free(recv_ret: salty_client_recv_msgs_ret_t) {
+    trace!("salty_client_recv_msgs_ret_free");
+
+    if recv_ret.msgs.is_null() {
+        debug!("salty_client_recv_msgs_ret_free: Messages are already null");
+        return;
+    }
+    let msgs: Box<[salty_msg_t]> = Box::from_raw(slice::from_raw_parts_mut(
+        recv_ret.msgs as *mut salty_msg_t,
+        recv_ret.msgs_len,
+    ));
+    for msg in msgs.iter() {
+        free_msg_bytes(msg);
+    }
+}
+
+/// Convert an event into a `salty_event_t`.
+fn make_event(event: Event) -> salty_event_t {
+    match event {
+        Event::ServerHandshakeDone(peer_connected) => salty_event_t {
+            event_type: salty_event_type_t::EVENT_SERVER_HANDSHAKE_COMPLETED,
+            peer_connected: peer_connected,
+            peer_id: 0,
+        },
+        Event::PeerHandshakeDone => salty_event_t {
+            event_type: salty_event_type_t::EVENT_PEER_HANDSHAKE_COMPLETED,
+            peer_connected: false,
+            peer_id: 0,
+        },
+        Event::Disconnected(peer_id) => salty_event_t {
+            event_type: salty_event_type_t::EVENT_PEER_DISCONNECTED,
+            peer_connected: false,
+            peer_id: peer_id,
+        },
     }
 }
 
@@ -1462,28 +2481,9 @@ pub unsafe extern "C" fn salty_client_recv_event(
 
     // Helper function: Success
     fn make_ret(event: Event) -> salty_client_recv_event_ret_t {
-        // Create salty_event_t struct
-        let event_t = match event {
-            Event::ServerHandshakeDone(peer_connected) => salty_event_t {
-                event_type: salty_event_type_t::EVENT_SERVER_HANDSHAKE_COMPLETED,
-                peer_connected: peer_connected,
-                peer_id: 0,
-            },
-            Event::PeerHandshakeDone => salty_event_t {
-                event_type: salty_event_type_t::EVENT_PEER_HANDSHAKE_COMPLETED,
-                peer_connected: false,
-                peer_id: 0,
-            },
-            Event::Disconnected(peer_id) => salty_event_t {
-                event_type: salty_event_type_t::EVENT_PEER_DISCONNECTED,
-                peer_connected: false,
-                peer_id: peer_id,
-            },
-        };
-
         salty_client_recv_event_ret_t {
             success: salty_client_recv_success_t::RECV_OK,
-            event: Box::into_raw(Box::new(event_t)),
+            event: Box::into_raw(Box::new(make_event(event))),
         }
     }
 
@@ -1521,6 +2521,178 @@ pub unsafe extern "C" fn salty_client_recv_event_ret_free(recv_ret: salty_client
 }
 
 
+// *** READINESS NOTIFICATION *** //
+
+/// Create a new readiness notifier.
+///
+/// A readiness notifier allows to wait for many receiving channels (e.g. of
+/// many clients) on a single thread with `poll`, `epoll` or `kqueue`:
+///
+/// 1. Create one notifier per receiving channel.
+/// 2. Receive with `salty_client_recv_msg_notify` or `salty_client_recv_event_notify`
+///    until `RECV_NO_DATA` is returned. This arms the notifier.
+/// 3. Wait until the file descriptor returned by `salty_readiness_fd` becomes
+///    readable, then continue with step 2.
+///
+/// Do not read from the file descriptor, it is drained by the receive functions.
+///
+/// Returns:
+///     A pointer to the notifier or `null` if the underlying pipe could not be created.
+#[no_mangle]
+pub extern "C" fn salty_readiness_new() -> *const salty_readiness_t {
+    trace!("salty_readiness_new");
+    match Readiness::new() {
+        Ok(readiness) => Arc::into_raw(Arc::new(readiness)) as *const salty_readiness_t,
+        Err(e) => {
+            error!("Could not create readiness notifier: {}", e);
+            ptr::null()
+        },
+    }
+}
+
+/// Return the file descriptor of a readiness notifier.
+///
+/// The file descriptor is owned by the notifier and must not be closed.
+///
+/// Parameters:
+///     readiness (`*salty_readiness_t`, borrowed):
+///         Pointer to a readiness notifier.
+/// Returns:
+///     The file descriptor or `-1` if `readiness` is `null`.
+#[no_mangle]
+pub unsafe extern "C" fn salty_readiness_fd(readiness: *const salty_readiness_t) -> c_int {
+    if readiness.is_null() {
+        error!("Readiness pointer is null");
+        return -1;
+    }
+    (&*(readiness as *const Readiness)).fd()
+}
+
+/// Free a readiness notifier.
+///
+/// The file descriptor is closed once the channel the notifier has been armed
+/// for does not reference it anymore.
+#[no_mangle]
+pub unsafe extern "C" fn salty_readiness_free(readiness: *const salty_readiness_t) {
+    trace!("salty_readiness_free");
+
+    if readiness.is_null() {
+        warn!("salty_readiness_free: Tried to free a null pointer");
+        return;
+    }
+    Arc::from_raw(readiness as *const Readiness);
+}
+
+/// Recreate a readiness notifier `Arc` without taking over ownership.
+unsafe fn clone_readiness(readiness: *const salty_readiness_t) -> Arc<Readiness> {
+    let readiness_arc = Arc::from_raw(readiness as *const Readiness);
+    let readiness_clone = readiness_arc.clone();
+    mem::forget(readiness_arc);
+    readiness_clone
+}
+
+/// Receive a message from the incoming channel without blocking.
+///
+/// If no message is available, `RECV_NO_DATA` is returned and the readiness
+/// notifier is armed: Its file descriptor becomes readable as soon as a message
+/// is available or the channel has ended.
+///
+/// Note: The returned message must be freed with `salty_client_recv_msg_ret_free`.
+///
+/// Parameters:
+///     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+///         The receiving end of the channel for incoming message events.
+///     readiness (`*salty_readiness_t`, borrowed):
+///         The readiness notifier used for this channel.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_recv_msg_notify(
+    receiver_rx: *const salty_channel_receiver_rx_t,
+    readiness: *const salty_readiness_t,
+) -> salty_client_recv_msg_ret_t {
+    trace!("salty_client_recv_msg_notify");
+
+    // Null checks
+    if receiver_rx.is_null() {
+        error!("Receiver channel pointer is null");
+        return salty_client_recv_msg_ret_t { success: salty_client_recv_success_t::RECV_NULL_ARGUMENT, msg: ptr::null() };
+    }
+    if readiness.is_null() {
+        error!("Readiness pointer is null");
+        return salty_client_recv_msg_ret_t { success: salty_client_recv_success_t::RECV_NULL_ARGUMENT, msg: ptr::null() };
+    }
+
+    // Get channel receiver reference
+    let rx = &mut *(receiver_rx as *mut QueueReceiver<MessageEvent>)
+          as &mut QueueReceiver<MessageEvent>;
+
+    BlockingMode::NOTIFY(clone_readiness(readiness)).recv(
+        // Content type
+        "message",
+        // Incoming channel
+        rx,
+        // Closure to process a new message
+        |msg| match make_msg(msg) {
+            Ok(msg) => salty_client_recv_msg_ret_t {
+                success: salty_client_recv_success_t::RECV_OK,
+                msg: Box::into_raw(Box::new(msg)),
+            },
+            Err(reason) => salty_client_recv_msg_ret_t { success: reason, msg: ptr::null() },
+        },
+        // Closure to create an error return value
+        |reason| salty_client_recv_msg_ret_t { success: reason, msg: ptr::null() },
+    )
+}
+
+/// Receive an event from the incoming channel without blocking.
+///
+/// If no event is available, `RECV_NO_DATA` is returned and the readiness
+/// notifier is armed: Its file descriptor becomes readable as soon as an event
+/// is available or the channel has ended.
+///
+/// Note: The returned event must be freed with `salty_client_recv_event_ret_free`.
+///
+/// Parameters:
+///     event_rx (`*salty_channel_event_rx_t`, borrowed):
+///         The receiving end of the channel for incoming events.
+///     readiness (`*salty_readiness_t`, borrowed):
+///         The readiness notifier used for this channel.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_recv_event_notify(
+    event_rx: *const salty_channel_event_rx_t,
+    readiness: *const salty_readiness_t,
+) -> salty_client_recv_event_ret_t {
+    trace!("salty_client_recv_event_notify");
+
+    // Null checks
+    if event_rx.is_null() {
+        error!("Event channel pointer is null");
+        return salty_client_recv_event_ret_t { success: salty_client_recv_success_t::RECV_NULL_ARGUMENT, event: ptr::null() };
+    }
+    if readiness.is_null() {
+        error!("Readiness pointer is null");
+        return salty_client_recv_event_ret_t { success: salty_client_recv_success_t::RECV_NULL_ARGUMENT, event: ptr::null() };
+    }
+
+    // Get channel receiver reference
+    let rx = &mut *(event_rx as *mut mpsc::UnboundedReceiver<Event>)
+          as &mut mpsc::UnboundedReceiver<Event>;
+
+    BlockingMode::NOTIFY(clone_readiness(readiness)).recv(
+        // Content type
+        "event",
+        // Incoming channel
+        rx,
+        // Closure to process a new event
+        |event| salty_client_recv_event_ret_t {
+            success: salty_client_recv_success_t::RECV_OK,
+            event: Box::into_raw(Box::new(make_event(event))),
+        },
+        // Closure to create an error return value
+        |reason| salty_client_recv_event_ret_t { success: reason, event: ptr::null() },
+    )
+}
+
+
 /// Close the connection.
 ///
 /// The `disconnect_tx` instance is freed (as long as the pointer is not null).
@@ -1561,6 +2733,15 @@ enum EncryptDecryptMode {
     Decrypt,
 }
 
+impl EncryptDecryptMode {
+    fn func_name(&self) -> &'static str {
+        match *self {
+            EncryptDecryptMode::Encrypt => "salty_client_encrypt_with_session_keys",
+            EncryptDecryptMode::Decrypt => "salty_client_decrypt_with_session_keys",
+        }
+    }
+}
+
 /// Encrypt or decrypt raw bytes using the session keys after the handshake has been finished.
 ///
 /// (Internal helper function.)
@@ -1574,171 +2755,726 @@ enum EncryptDecryptMode {
 ///         Number of bytes in the `data` array.
 ///     nonce (`*uint8_t`, borrowed):
 ///         Pointer to a 24 byte array containing the nonce used for en-/decryption.
-unsafe fn salty_client_encrypt_decrypt_with_session_keys(
-    mode: EncryptDecryptMode,
+unsafe fn encrypt_decrypt_with_session_keys(
+    mode: &EncryptDecryptMode,
     client: *const salty_client_t,
     data: *const u8,
     data_len: size_t,
     nonce: *const u8,
-) -> salty_client_encrypt_decrypt_ret_t {
-    trace!("salty_client_encrypt_decrypt_with_session_keys");
-
-    let func_name = match mode {
-        EncryptDecryptMode::Encrypt => "salty_client_encrypt_with_session_keys",
-        EncryptDecryptMode::Decrypt => "salty_client_decrypt_with_session_keys",
-    };
-
-    // Helper function: Error
-    fn make_error(reason: salty_client_encrypt_decrypt_success_t) -> salty_client_encrypt_decrypt_ret_t {
-        salty_client_encrypt_decrypt_ret_t { success: reason, bytes: ptr::null(), bytes_len: 0 }
-    }
+) -> Result<Vec<u8>, salty_client_encrypt_decrypt_success_t> {
+    let func_name = mode.func_name();
 
     // Null pointer checks
     if client.is_null() {
         error!("Client pointer is null");
-        return make_error(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT);
+        return Err(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT);
     }
     if data.is_null() {
         error!("Data pointer is null");
-        return make_error(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT);
+        return Err(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT);
     }
     if nonce.is_null() {
         error!("Nonce pointer is null");
-        return make_error(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT);
+        return Err(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT);
+    }
+
+    // Recreate client Arc
+    let client_arc: Arc<RwLock<SaltyClient>> = Arc::from_raw(client as *const RwLock<SaltyClient>);
+
+    // Clone Arc so that the client instance can be reused
+    let client_arc_clone = client_arc.clone();
+    mem::forget(client_arc);
+
+    // Get reference to data and nonce
+    let data_slice: &[u8] = slice::from_raw_parts(data, data_len as usize);
+    let nonce_slice: &[u8] = slice::from_raw_parts(nonce, 24);
+
+    // Encrypt or decrypt. Get back result with vector.
+    let result = match *mode {
+        EncryptDecryptMode::Encrypt => client_arc_clone
+            .read()
+            .map_err(|e| SaltyError::Crash(format!("Could not read-lock SaltyClient: {}", e)))
+            .and_then(|client| client.encrypt_raw_with_session_keys(data_slice, nonce_slice)),
+        EncryptDecryptMode::Decrypt => client_arc_clone
+            .read()
+            .map_err(|e| SaltyError::Crash(format!("Could not read-lock SaltyClient: {}", e)))
+            .and_then(|client| client.decrypt_raw_with_session_keys(data_slice, nonce_slice)),
+    };
+    match result {
+        Ok(vec) => Ok(vec),
+        Err(SaltyError::NoPeer) => {
+            error!("{}: Peer has not yet been established", func_name);
+            Err(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NO_PEER)
+        },
+        Err(e) => {
+            error!("{}: {}", func_name, e);
+            Err(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_ERROR)
+        }
+    }
+}
+
+/// Encrypt or decrypt raw bytes and hand the result over to the caller.
+///
+/// (Internal helper function.)
+unsafe fn salty_client_encrypt_decrypt_with_session_keys(
+    mode: EncryptDecryptMode,
+    client: *const salty_client_t,
+    data: *const u8,
+    data_len: size_t,
+    nonce: *const u8,
+) -> salty_client_encrypt_decrypt_ret_t {
+    trace!("salty_client_encrypt_decrypt_with_session_keys");
+
+    let bytes = match encrypt_decrypt_with_session_keys(&mode, client, data, data_len, nonce) {
+        Ok(vec) => vec,
+        Err(reason) => return salty_client_encrypt_decrypt_ret_t {
+            success: reason,
+            bytes: ptr::null(),
+            bytes_len: 0,
+        },
+    };
+
+    // Get pointer to bytes on heap
+    let bytes_box = bytes.into_boxed_slice();
+    let bytes_len = bytes_box.len();
+    let bytes_ptr = Box::into_raw(bytes_box) as *const u8;
+
+    salty_client_encrypt_decrypt_ret_t {
+        success: salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_OK,
+        bytes: bytes_ptr,
+        bytes_len,
+    }
+}
+
+/// Encrypt or decrypt raw bytes into a buffer provided by the caller.
+///
+/// (Internal helper function.)
+unsafe fn salty_client_encrypt_decrypt_with_session_keys_into(
+    mode: EncryptDecryptMode,
+    client: *const salty_client_t,
+    data: *const u8,
+    data_len: size_t,
+    nonce: *const u8,
+    out: *mut u8,
+    out_len: size_t,
+    written: *mut size_t,
+) -> salty_client_encrypt_decrypt_success_t {
+    trace!("salty_client_encrypt_decrypt_with_session_keys_into");
+
+    let func_name = mode.func_name();
+
+    // Null pointer checks
+    if out.is_null() {
+        error!("Output buffer pointer is null");
+        return salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT;
+    }
+    if written.is_null() {
+        error!("Written length pointer is null");
+        return salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT;
+    }
+    *written = 0;
+
+    // Check the buffer size up front, so that no work is wasted on a buffer that is too small
+    let required_len = match mode {
+        EncryptDecryptMode::Encrypt => salty_client_encrypt_required_len(data_len),
+        EncryptDecryptMode::Decrypt => {
+            if data_len < SESSION_KEYS_OVERHEAD {
+                error!("{}: Data is shorter than the authentication tag", func_name);
+                return salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_ERROR;
+            }
+            salty_client_decrypt_required_len(data_len)
+        },
+    };
+    if out_len < required_len {
+        error!("{}: Output buffer too small ({} < {} bytes)", func_name, out_len, required_len);
+        *written = required_len;
+        return salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_BUFFER_TOO_SMALL;
+    }
+
+    // Note: The input is fully consumed before the output buffer is written,
+    // so `out` may point to the same memory as `data`.
+    let bytes = match encrypt_decrypt_with_session_keys(&mode, client, data, data_len, nonce) {
+        Ok(vec) => vec,
+        Err(reason) => return reason,
+    };
+    if bytes.len() != required_len {
+        error!("{}: Unexpected output length ({} != {} bytes)", func_name, bytes.len(), required_len);
+        return salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_ERROR;
+    }
+    ptr::copy_nonoverlapping(bytes.as_ptr(), out, bytes.len());
+    *written = bytes.len();
+
+    salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_OK
+}
+
+/// Encrypt raw bytes using the session keys after the handshake has been finished.
+///
+/// Note: The returned data must be explicitly freed with
+/// `salty_client_encrypt_decrypt_free`!
+///
+/// Parameters:
+///     client (`*salty_client_t`, borrowed):
+///         Pointer to a `salty_client_t` instance.
+///     data (`*uint8_t`, borrowed):
+///         Pointer to the data that should be encrypted.
+///     data_len (`size_t`, copied):
+///         Number of bytes in the `data` array.
+///     nonce (`*uint8_t`, borrowed):
+///         Pointer to a 24 byte array containing the nonce used for encryption.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_encrypt_with_session_keys(
+    client: *const salty_client_t,
+    data: *const u8,
+    data_len: size_t,
+    nonce: *const u8,
+) -> salty_client_encrypt_decrypt_ret_t {
+    trace!("salty_client_encrypt_with_session_keys");
+    salty_client_encrypt_decrypt_with_session_keys(
+        EncryptDecryptMode::Encrypt,
+        client,
+        data,
+        data_len,
+        nonce,
+    )
+}
+
+/// Decrypt raw bytes using the session keys after the handshake has been finished.
+///
+/// Note: The returned data must be explicitly freed with
+/// `salty_client_encrypt_decrypt_free`!
+///
+/// Parameters:
+///     client (`*salty_client_t`, borrowed):
+///         Pointer to a `salty_client_t` instance.
+///     data (`*uint8_t`, borrowed):
+///         Pointer to the data that should be decrypted.
+///     data_len (`size_t`, copied):
+///         Number of bytes in the `data` array.
+///     nonce (`*uint8_t`, borrowed):
+///         Pointer to a 24 byte array containing the nonce used for decryption.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_decrypt_with_session_keys(
+    client: *const salty_client_t,
+    data: *const u8,
+    data_len: size_t,
+    nonce: *const u8,
+) -> salty_client_encrypt_decrypt_ret_t {
+    trace!("salty_client_decrypt_with_session_keys");
+    salty_client_encrypt_decrypt_with_session_keys(
+        EncryptDecryptMode::Decrypt,
+        client,
+        data,
+        data_len,
+        nonce,
+    )
+}
+
+/// Free memory allocated and returned by `salty_client_encrypt_with_session_keys`
+/// or `salty_client_decrypt_with_session_keys`.
+///
+/// Params:
+///     data (`*uint8_t`, borrowed):
+///         Pointer to the data that should be freed.
+///     data_len (`size_t`, copied):
+///         Number of bytes in the `data` array.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_encrypt_decrypt_free(
+    data: *const u8,
+    data_len: size_t,
+) {
+    trace!("salty_client_encrypt_decrypt_free");
+
+    // Reclaim and forget vector
+    if data.is_null() {
+        warn!("salty_client_encrypt_decrypt_free: Tried to free a null pointer");
+        return;
+    }
+    Vec::from_raw_parts(data as *mut u8, data_len as usize, data_len as usize);
+}
+
+/// Return the number of bytes written by `salty_client_encrypt_with_session_keys_into`
+/// when encrypting `data_len` bytes.
+///
+/// Parameters:
+///     data_len (`size_t`, copied):
+///         Number of bytes that should be encrypted.
+#[no_mangle]
+pub extern "C" fn salty_client_encrypt_required_len(data_len: size_t) -> size_t {
+    data_len.saturating_add(SESSION_KEYS_OVERHEAD)
+}
+
+/// Return the number of bytes written by `salty_client_decrypt_with_session_keys_into`
+/// when decrypting `data_len` bytes.
+///
+/// If `data_len` is smaller than `SESSION_KEYS_OVERHEAD`, the data cannot be
+/// decrypted and `0` is returned.
+///
+/// Parameters:
+///     data_len (`size_t`, copied):
+///         Number of bytes that should be decrypted.
+#[no_mangle]
+pub extern "C" fn salty_client_decrypt_required_len(data_len: size_t) -> size_t {
+    data_len.saturating_sub(SESSION_KEYS_OVERHEAD)
+}
+
+/// Encrypt raw bytes using the session keys after the handshake has been finished
+/// and write the result into a buffer provided by the caller.
+///
+/// In contrast to `salty_client_encrypt_with_session_keys`, nothing needs to be freed
+/// afterwards. Encrypting in-place is allowed: `out` may point to `data` as long as the
+/// buffer can hold `salty_client_encrypt_required_len(data_len)` bytes.
+///
+/// Parameters:
+///     client (`*salty_client_t`, borrowed):
+///         Pointer to a `salty_client_t` instance.
+///     data (`*uint8_t`, borrowed):
+///         Pointer to the data that should be encrypted.
+///     data_len (`size_t`, copied):
+///         Number of bytes in the `data` array.
+///     nonce (`*uint8_t`, borrowed):
+///         Pointer to a 24 byte array containing the nonce used for encryption.
+///     out (`*uint8_t`, borrowed):
+///         Pointer to the buffer the ciphertext is written to.
+///     out_len (`size_t`, copied):
+///         Number of bytes available in the `out` buffer.
+///     written (`*size_t`, borrowed):
+///         Receives the number of bytes written to `out`. If the buffer is too small,
+///         it receives the required length instead.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_encrypt_with_session_keys_into(
+    client: *const salty_client_t,
+    data: *const u8,
+    data_len: size_t,
+    nonce: *const u8,
+    out: *mut u8,
+    out_len: size_t,
+    written: *mut size_t,
+) -> salty_client_encrypt_decrypt_success_t {
+    trace!("salty_client_encrypt_with_session_keys_into");
+    salty_client_encrypt_decrypt_with_session_keys_into(
+        EncryptDecryptMode::Encrypt,
+        client,
+        data,
+        data_len,
+        nonce,
+        out,
+        out_len,
+        written,
+    )
+}
+
+/// Decrypt raw bytes using the session keys after the handshake has been finished
+/// and write the result into a buffer provided by the caller.
+///
+/// In contrast to `salty_client_decrypt_with_session_keys`, nothing needs to be freed
+/// afterwards. Decrypting in-place is allowed: `out` may point to `data`.
+///
+/// Parameters:
+///     client (`*salty_client_t`, borrowed):
+///         Pointer to a `salty_client_t` instance.
+///     data (`*uint8_t`, borrowed):
+///         Pointer to the data that should be decrypted.
+///     data_len (`size_t`, copied):
+///         Number of bytes in the `data` array.
+///     nonce (`*uint8_t`, borrowed):
+///         Pointer to a 24 byte array containing the nonce used for decryption.
+///     out (`*uint8_t`, borrowed):
+///         Pointer to the buffer the plaintext is written to.
+///     out_len (`size_t`, copied):
+///         Number of bytes available in the `out` buffer.
+///     written (`*size_t`, borrowed):
+///         Receives the number of bytes written to `out`. If the buffer is too small,
+///         it receives the required length instead.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_decrypt_with_session_keys_into(
+    client: *const salty_client_t,
+    data: *const u8,
+    data_len: size_t,
+    nonce: *const u8,
+    out: *mut u8,
+    out_len: size_t,
+    written: *mut size_t,
+) -> salty_client_encrypt_decrypt_success_t {
+    trace!("salty_client_decrypt_with_session_keys_into");
+    salty_client_encrypt_decrypt_with_session_keys_into(
+        EncryptDecryptMode::Decrypt,
+        client,
+        data,
+        data_len,
+        nonce,
+        out,
+        out_len,
+        written,
+    )
+}
+
+
+
+// *** CHUNKED STREAMING *** //
+
+/// Create a writer that sends a large message in chunks.
+///
+/// The message is split into task messages of at most `chunk_size` bytes
+/// while it is being written, so it never needs to be held in memory as a
+/// whole, neither by the sender nor by the receiver. Every chunk starts with
+/// a 9 byte header, compatible with the reliable/ordered mode of chunked-dc.
+///
+/// Note: The writer must be explicitly freed with `salty_chunk_writer_free`!
+///
+/// Parameters:
+///     sender_tx (`*salty_channel_sender_tx_t`, borrowed):
+///         The sending end of the channel for outgoing messages.
+///     message_id (`uint32_t`, copied):
+///         The id of the message. It must not be used by another chunked
+///         message that is being sent at the same time.
+///     chunk_size (`uint32_t`, copied):
+///         The maximum size of a chunk in bytes, including the header. Must
+///         be larger than 9.
+/// Returns:
+///     A writer, or `null` if an argument is invalid.
+#[no_mangle]
+pub unsafe extern "C" fn salty_chunk_writer_new(
+    sender_tx: *const salty_channel_sender_tx_t,
+    message_id: u32,
+    chunk_size: u32,
+) -> *const salty_chunk_writer_t {
+    trace!("salty_chunk_writer_new");
+
+    // Null pointer checks
+    if sender_tx.is_null() {
+        error!("Sender channel pointer is null");
+        return ptr::null();
+    }
+
+    // Get pointer to QueueSender
+    let sender = &*(sender_tx as *const QueueSender<OutgoingMessage>) as &QueueSender<OutgoingMessage>;
+
+    let writer = match ChunkWriter::new(message_id, chunk_size as usize) {
+        Ok(writer) => writer,
+        Err(e) => {
+            error!("Could not create chunk writer: {}", e);
+            return ptr::null();
+        }
+    };
+    Box::into_raw(Box::new(ChunkSender::new(sender.clone(), writer))) as *const salty_chunk_writer_t
+}
+
+/// Write data to a chunked message.
+///
+/// The data is copied into the current chunk. Complete chunks are enqueued
+/// in the outgoing channel.
+///
+/// If the outgoing channel is full, `SEND_WOULD_BLOCK` is returned and only
+/// the first `*written` bytes have been consumed. Call this function again
+/// with the remaining data once the channel has room.
+///
+/// Parameters:
+///     writer (`*salty_chunk_writer_t`, borrowed):
+///         The chunk writer.
+///     data (`*uint8_t`, borrowed):
+///         Pointer to the data.
+///     data_len (`size_t`, copied):
+///         Length of the data.
+///     written (`*size_t`, borrowed):
+///         Receives the number of bytes that have been consumed.
+#[no_mangle]
+pub unsafe extern "C" fn salty_chunk_writer_write(
+    writer: *const salty_chunk_writer_t,
+    data: *const u8,
+    data_len: size_t,
+    written: *mut size_t,
+) -> salty_client_send_success_t {
+    trace!("salty_chunk_writer_write");
+
+    // Null pointer checks
+    if writer.is_null() {
+        error!("Chunk writer pointer is null");
+        return salty_client_send_success_t::SEND_NULL_ARGUMENT;
+    }
+    if written.is_null() {
+        error!("Written pointer is null");
+        return salty_client_send_success_t::SEND_NULL_ARGUMENT;
+    }
+    if data.is_null() && data_len > 0 {
+        error!("Data pointer is null");
+        return salty_client_send_success_t::SEND_NULL_ARGUMENT;
+    }
+
+    let sender = &mut *(writer as *mut ChunkSender) as &mut ChunkSender;
+    *written = 0;
+    if sender.is_finished() {
+        error!("Chunked message has already been finished");
+        return salty_client_send_success_t::SEND_MESSAGE_ERROR;
+    }
+    if data_len == 0 {
+        return salty_client_send_success_t::SEND_OK;
+    }
+
+    let (count, result) = sender.write(slice::from_raw_parts(data, data_len));
+    *written = count;
+    match result {
+        Ok(()) => salty_client_send_success_t::SEND_OK,
+        Err(e) => make_send_error(e),
+    }
+}
+
+/// Send the last chunk of a chunked message.
+///
+/// If the outgoing channel is full, `SEND_WOULD_BLOCK` is returned. Call
+/// this function again once the channel has room.
+///
+/// Parameters:
+///     writer (`*salty_chunk_writer_t`, borrowed):
+///         The chunk writer.
+#[no_mangle]
+pub unsafe extern "C" fn salty_chunk_writer_finish(
+    writer: *const salty_chunk_writer_t,
+) -> salty_client_send_success_t {
+    trace!("salty_chunk_writer_finish");
+
+    // Null pointer checks
+    if writer.is_null() {
+        error!("Chunk writer pointer is null");
+        return salty_client_send_success_t::SEND_NULL_ARGUMENT;
+    }
+
+    let sender = &mut *(writer as *mut ChunkSender) as &mut ChunkSender;
+    match sender.finish() {
+        Ok(()) => salty_client_send_success_t::SEND_OK,
+        Err(e) => make_send_error(e),
+    }
+}
+
+/// Free a `salty_chunk_writer_t` instance.
+///
+/// Chunks that have not been enqueued yet are discarded.
+#[no_mangle]
+pub unsafe extern "C" fn salty_chunk_writer_free(writer: *const salty_chunk_writer_t) {
+    trace!("salty_chunk_writer_free");
+
+    if writer.is_null() {
+        warn!("salty_chunk_writer_free: Tried to free a null pointer");
+        return;
+    }
+    Box::from_raw(writer as *mut ChunkSender);
+}
+
+/// Create a reader for incoming chunked messages.
+///
+/// The reader hands out the chunks of every message in order. Chunks that
+/// arrive before one of their predecessors are buffered until the missing
+/// chunks have arrived. Concatenating the data of the chunks is up to the
+/// caller.
+///
+/// Note: The reader must be explicitly freed with `salty_chunk_reader_free`!
+#[no_mangle]
+pub extern "C" fn salty_chunk_reader_new() -> *const salty_chunk_reader_t {
+    trace!("salty_chunk_reader_new");
+    Box::into_raw(Box::new(ChunkReader::new())) as *const salty_chunk_reader_t
+}
+
+/// Free a `salty_chunk_reader_t` instance.
+#[no_mangle]
+pub unsafe extern "C" fn salty_chunk_reader_free(reader: *const salty_chunk_reader_t) {
+    trace!("salty_chunk_reader_free");
+
+    if reader.is_null() {
+        warn!("salty_chunk_reader_free: Tried to free a null pointer");
+        return;
+    }
+    Box::from_raw(reader as *mut ChunkReader);
+}
+
+/// Helper function to turn the bytes of a task message into a chunk.
+///
+/// The chunk data points into the received bytes, it is not copied.
+fn make_chunk(header: ChunkHeader, bytes: Vec<u8>) -> salty_chunk_t {
+    let bytes_box = bytes.into_boxed_slice();
+    let data = bytes_box[CHUNK_HEADER_LEN..].as_ptr();
+    let data_len = bytes_box.len() - CHUNK_HEADER_LEN;
+    Box::into_raw(bytes_box);
+    salty_chunk_t {
+        message_id: header.id,
+        serial: header.serial,
+        end_of_message: header.end_of_message,
+        data,
+        data_len,
+    }
+}
+
+/// Receive a chunk (or another message) from the incoming channel.
+///
+/// Task messages containing binary data are treated as chunks. The chunks of
+/// a message are handed out in order, as soon as all of their predecessors
+/// have been handed out. All other messages are returned like
+/// `salty_client_recv_msg` does. This includes binary task messages that are
+/// not a valid chunk, that repeat a chunk that has already been received,
+/// that belong to one of the last 1024 completed messages, or that arrive
+/// early while too many early chunks are buffered. Early chunks that claim to
+/// follow the last chunk of their message are dropped once the message has
+/// been completed.
+///
+/// Note: The return value must be explicitly freed with
+/// `salty_client_recv_chunk_ret_free`!
+///
+/// Parameters:
+///     receiver_rx (`*salty_channel_receiver_rx_t`, borrowed):
+///         The receiving end of the channel for incoming message events.
+///     reader (`*salty_chunk_reader_t`, borrowed):
+///         The chunk reader. Use the same reader for all calls on a channel.
+///     timeout_ms (`*uint32_t`, borrowed):
+///         - If this is `null`, then the function call will block.
+///         - If this is `0`, then the function will never block. It will either return a chunk
+///         (or message) or `RECV_NO_DATA`.
+///         - If this is a value > 0, then the specified timeout in milliseconds will be used.
+///         Either a chunk (or message) or `RECV_NO_DATA` (in the case of a timeout) will be
+///         returned.
+/// Returns:
+///     `RECV_NO_DATA` if only chunks arrived that are waiting for one of
+///     their predecessors.
+#[no_mangle]
+pub unsafe extern "C" fn salty_client_recv_chunk(
+    receiver_rx: *const salty_channel_receiver_rx_t,
+    reader: *const salty_chunk_reader_t,
+    timeout_ms: *const u32,
+) -> salty_client_recv_chunk_ret_t {
+    trace!("salty_client_recv_chunk");
+
+    // Helper function: Error
+    fn make_error(reason: salty_client_recv_success_t) -> salty_client_recv_chunk_ret_t {
+        salty_client_recv_chunk_ret_t { success: reason, chunk: ptr::null(), msg: ptr::null() }
+    }
+
+    // Helper function: Chunk
+    fn make_chunk_ret(header: ChunkHeader, bytes: Vec<u8>) -> salty_client_recv_chunk_ret_t {
+        salty_client_recv_chunk_ret_t {
+            success: salty_client_recv_success_t::RECV_OK,
+            chunk: Box::into_raw(Box::new(make_chunk(header, bytes))),
+            msg: ptr::null(),
+        }
+    }
+
+    // Helper function: Success, or `None` if the message is an early chunk
+    fn make_ret(reader: &mut ChunkReader, msg: MessageEvent) -> Option<salty_client_recv_chunk_ret_t> {
+        let msg = match msg {
+            MessageEvent::Data(Value::Binary(bytes)) => match reader.push(bytes) {
+                Ok(()) => return reader.pop().map(|(header, bytes)| make_chunk_ret(header, bytes)),
+                Err(bytes) => {
+                    warn!("Binary task message is not an expected chunk, returning it as message");
+                    MessageEvent::Data(Value::Binary(bytes))
+                },
+            },
+            other => other,
+        };
+        Some(match make_msg(msg) {
+            Ok(msg) => salty_client_recv_chunk_ret_t {
+                success: salty_client_recv_success_t::RECV_OK,
+                chunk: ptr::null(),
+                msg: Box::into_raw(Box::new(msg)),
+            },
+            Err(reason) => make_error(reason),
+        })
+    }
+
+    // Null checks
+    if receiver_rx.is_null() {
+        error!("Receiver channel pointer is null");
+        return make_error(salty_client_recv_success_t::RECV_NULL_ARGUMENT);
+    }
+    if reader.is_null() {
+        error!("Chunk reader pointer is null");
+        return make_error(salty_client_recv_success_t::RECV_NULL_ARGUMENT);
     }
 
-    // Recreate client Arc
-    let client_arc: Arc<RwLock<SaltyClient>> = Arc::from_raw(client as *const RwLock<SaltyClient>);
-
-    // Clone Arc so that the client instance can be reused
-    let client_arc_clone = client_arc.clone();
-    mem::forget(client_arc);
+    // Get channel receiver and chunk reader references
+    let rx = &mut *(receiver_rx as *mut QueueReceiver<MessageEvent>)
+          as &mut QueueReceiver<MessageEvent>;
+    let reader = &mut *(reader as *mut ChunkReader) as &mut ChunkReader;
 
-    // Get reference to data and nonce
-    let data_slice: &[u8] = slice::from_raw_parts(data, data_len as usize);
-    let nonce_slice: &[u8] = slice::from_raw_parts(nonce, 24);
+    // Chunks that are in order are handed out first
+    if let Some((header, bytes)) = reader.pop() {
+        return make_chunk_ret(header, bytes);
+    }
 
-    // Encrypt or decrypt. Get back result with vector.
-    let result = match mode {
-        EncryptDecryptMode::Encrypt => client_arc_clone
-            .read()
-            .map_err(|e| SaltyError::Crash(format!("Could not read-lock SaltyClient: {}", e)))
-            .and_then(|client| client.encrypt_raw_with_session_keys(data_slice, nonce_slice)),
-        EncryptDecryptMode::Decrypt => client_arc_clone
-            .read()
-            .map_err(|e| SaltyError::Crash(format!("Could not read-lock SaltyClient: {}", e)))
-            .and_then(|client| client.decrypt_raw_with_session_keys(data_slice, nonce_slice)),
-    };
-    let ciphertext = match result {
-        Ok(vec) => vec,
-        Err(SaltyError::NoPeer) => {
-            error!("{}: Peer has not yet been established", func_name);
-            return make_error(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NO_PEER);
-        },
-        Err(e) => {
-            error!("{}: {}", func_name, e);
-            return make_error(salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_ERROR);
+    // Receive messages depending on blocking mode, until a chunk is in order
+    // or another message arrives
+    let blocking_mode = BlockingMode::from_timeout_ms(timeout_ms);
+    let started = Instant::now();
+    loop {
+        let blocking_mode = match blocking_mode.remaining(started.elapsed()) {
+            Some(blocking_mode) => blocking_mode,
+            None => return make_error(salty_client_recv_success_t::RECV_NO_DATA),
+        };
+        let ret = blocking_mode.recv(
+            // Content type
+            "chunk",
+            // Incoming channel
+            &mut *rx,
+            // Closure to process a new message
+            |msg| make_ret(reader, msg),
+            // Closure to create an error return value
+            |err| Some(make_error(err)),
+        );
+        if let Some(ret) = ret {
+            return ret;
         }
-    };
-
-    // Get pointer to bytes on heap
-    let ciphertext_box = ciphertext.into_boxed_slice();
-    let ciphertext_len = ciphertext_box.len();
-    let ciphertext_ptr = Box::into_raw(ciphertext_box) as *const u8;
-
-    salty_client_encrypt_decrypt_ret_t {
-        success: salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_OK,
-        bytes: ciphertext_ptr,
-        bytes_len: ciphertext_len,
     }
 }
 
-/// Encrypt raw bytes using the session keys after the handshake has been finished.
-///
-/// Note: The returned data must be explicitly freed with
-/// `salty_client_encrypt_decrypt_free`!
-///
-/// Parameters:
-///     client (`*salty_client_t`, borrowed):
-///         Pointer to a `salty_client_t` instance.
-///     data (`*uint8_t`, borrowed):
-///         Pointer to the data that should be encrypted.
-///     data_len (`size_t`, copied):
-///         Number of bytes in the `data` array.
-///     nonce (`*uint8_t`, borrowed):
-///         Pointer to a 24 byte array containing the nonce used for encryption.
+/// Free a `salty_client_recv_chunk_ret_t` instance.
 #[no_mangle]
-pub unsafe extern "C" fn salty_client_encrypt_with_session_keys(
-    client: *const salty_client_t,
-    data: *const u8,
-    data_len: size_t,
-    nonce: *const u8,
-) -> salty_client_encrypt_decrypt_ret_t {
-    trace!("salty_client_encrypt_with_session_keys");
-    salty_client_encrypt_decrypt_with_session_keys(
-        EncryptDecryptMode::Encrypt,
-        client,
-        data,
-        data_len,
-        nonce,
-    )
+pub unsafe extern "C" fn salty_client_recv_chunk_ret_free(recv_ret: salty_client_recv_chunk_ret_t) {
+    trace!("salty_client_recv_chunk_ret_free");
+
+    if !recv_ret.chunk.is_null() {
+        let chunk = Box::from_raw(recv_ret.chunk as *mut salty_chunk_t);
+        let bytes = slice::from_raw_parts_mut(
+            (chunk.data as *mut u8).offset(-(CHUNK_HEADER_LEN as isize)),
+            chunk.data_len + CHUNK_HEADER_LEN,
+        );
+        Box::from_raw(bytes as *mut [u8]);
+    }
+    if !recv_ret.msg.is_null() {
+        let msg = Box::from_raw(recv_ret.msg as *mut salty_msg_t);
+        free_msg_bytes(&msg);
+    }
 }
 
-/// Decrypt raw bytes using the session keys after the handshake has been finished.
+
+// *** ALLOCATION STATISTICS *** //
+
+/// Get the allocation counters of the library.
 ///
-/// Note: The returned data must be explicitly freed with
-/// `salty_client_encrypt_decrypt_free`!
+/// The counters include all heap allocations done by the library (on any
+/// thread) since it was loaded. To get the allocations of an operation,
+/// subtract the counters before the operation from the counters after it.
 ///
 /// Parameters:
-///     client (`*salty_client_t`, borrowed):
-///         Pointer to a `salty_client_t` instance.
-///     data (`*uint8_t`, borrowed):
-///         Pointer to the data that should be decrypted.
-///     data_len (`size_t`, copied):
-///         Number of bytes in the `data` array.
-///     nonce (`*uint8_t`, borrowed):
-///         Pointer to a 24 byte array containing the nonce used for decryption.
-#[no_mangle]
-pub unsafe extern "C" fn salty_client_decrypt_with_session_keys(
-    client: *const salty_client_t,
-    data: *const u8,
-    data_len: size_t,
-    nonce: *const u8,
-) -> salty_client_encrypt_decrypt_ret_t {
-    trace!("salty_client_decrypt_with_session_keys");
-    salty_client_encrypt_decrypt_with_session_keys(
-        EncryptDecryptMode::Decrypt,
-        client,
-        data,
-        data_len,
-        nonce,
-    )
-}
-
-/// Free memory allocated and returned by `salty_client_encrypt_with_session_keys`
-/// or `salty_client_decrypt_with_session_keys`.
-///
-/// Params:
-///     data (`*uint8_t`, borrowed):
-///         Pointer to the data that should be freed.
-///     data_len (`size_t`, copied):
-///         Number of bytes in the `data` array.
+///     stats (`*salty_alloc_stats_t`, borrowed):
+///         Receives the counters.
+/// Returns:
+///     `false` if `stats` is `null` or if the library was built without
+///     the `alloc-stats` feature, `true` otherwise.
 #[no_mangle]
-pub unsafe extern "C" fn salty_client_encrypt_decrypt_free(
-    data: *const u8,
-    data_len: size_t,
-) {
-    trace!("salty_client_encrypt_decrypt_free");
-
-    // Reclaim and forget vector
-    if data.is_null() {
-        warn!("salty_client_encrypt_decrypt_free: Tried to free a null pointer");
-        return;
+pub unsafe extern "C" fn salty_alloc_stats(stats: *mut salty_alloc_stats_t) -> bool {
+    if stats.is_null() {
+        error!("Stats pointer is null");
+        return false;
+    }
+    match allocations::stats() {
+        Some(alloc_stats) => {
+            *stats = salty_alloc_stats_t {
+                allocations: alloc_stats.allocations as u64,
+                deallocations: alloc_stats.deallocations as u64,
+                reallocations: alloc_stats.reallocations as u64,
+                allocated_bytes: alloc_stats.allocated_bytes as u64,
+            };
+            true
+        },
+        None => false,
     }
-    Vec::from_raw_parts(data as *mut u8, data_len as usize, data_len as usize);
 }
 
-
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -1759,7 +3495,7 @@ mod tests {
 
     #[test]
     fn test_send_bytes_msg_null_ptr() {
-        let (tx, _rx) = mpsc::unbounded::<OutgoingMessage>();
+        let (tx, _rx) = queue::channel::<OutgoingMessage>(0);
         let tx_ptr = Box::into_raw(Box::new(tx)) as *const salty_channel_sender_tx_t;
         let result = unsafe {
             salty_client_send_task_bytes(
@@ -1774,7 +3510,7 @@ mod tests {
     #[test]
     fn test_msgpack_decode_invalid() {
         // Create channel
-        let (tx, _rx) = mpsc::unbounded::<OutgoingMessage>();
+        let (tx, _rx) = queue::channel::<OutgoingMessage>(0);
         let tx_ptr = Box::into_raw(Box::new(tx)) as *const salty_channel_sender_tx_t;
 
         // Create message
@@ -1800,7 +3536,7 @@ mod tests {
 
     #[test]
     fn test_recv_nonblocking() {
-        let (tx, rx) = mpsc::unbounded::<MessageEvent>();
+        let (tx, rx) = queue::channel::<MessageEvent>(0);
         let rx_ptr = Box::into_raw(Box::new(rx)) as *const salty_channel_receiver_rx_t;
 
         let timeout_ptr = Box::into_raw(Box::new(0u32)) as *const u32;
@@ -1810,9 +3546,9 @@ mod tests {
         assert_eq!(result.success, salty_client_recv_success_t::RECV_NO_DATA);
 
         // Send two messages
-        tx.unbounded_send(MessageEvent::Data(Value::Integer(42.into()))).unwrap();
-        tx.unbounded_send(MessageEvent::Application(Value::Integer(23.into()))).unwrap();
-        tx.unbounded_send(MessageEvent::Close(CloseCode::from_number(3002))).unwrap();
+        tx.try_send(MessageEvent::Data(Value::Integer(42.into()))).unwrap();
+        tx.try_send(MessageEvent::Application(Value::Integer(23.into()))).unwrap();
+        tx.try_send(MessageEvent::Close(CloseCode::from_number(3002))).unwrap();
 
         // Receive task data
         let result = unsafe { salty_client_recv_msg(rx_ptr, timeout_ptr) };
@@ -1878,9 +3614,304 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_send_bytes_batch() {
+        let (tx, rx) = queue::channel::<OutgoingMessage>(0);
+        let tx_ptr = Box::into_raw(Box::new(tx)) as *const salty_channel_sender_tx_t;
+
+        let msg1 = [0x93, 0x01, 0x02, 0x03];
+        let msg2 = [0x2a];
+        let invalid = [1, 2, 3];
+
+        // An invalid message rejects the whole batch
+        let iovecs = [
+            salty_iovec_t { iov_base: msg1.as_ptr(), iov_len: msg1.len() },
+            salty_iovec_t { iov_base: invalid.as_ptr(), iov_len: invalid.len() },
+        ];
+        let result = unsafe { salty_client_send_application_bytes_batch(tx_ptr, iovecs.as_ptr(), iovecs.len()) };
+        assert_eq!(result, salty_client_send_success_t::SEND_MESSAGE_ERROR);
+
+        let iovecs = [
+            salty_iovec_t { iov_base: msg1.as_ptr(), iov_len: msg1.len() },
+            salty_iovec_t { iov_base: msg2.as_ptr(), iov_len: msg2.len() },
+        ];
+        let result = unsafe { salty_client_send_application_bytes_batch(tx_ptr, iovecs.as_ptr(), iovecs.len()) };
+        assert_eq!(result, salty_client_send_success_t::SEND_OK);
+
+        // Drop sender
+        unsafe { salty_channel_sender_tx_free(tx_ptr) };
+
+        let received: Vec<OutgoingMessage> = rx.wait().map(|msg| msg.unwrap()).collect();
+        assert_eq!(received, vec![
+            OutgoingMessage::Application(Value::Array(vec![
+                Value::Integer(1.into()),
+                Value::Integer(2.into()),
+                Value::Integer(3.into()),
+            ])),
+            OutgoingMessage::Application(Value::Integer(42.into())),
+        ]);
+    }
+
+    #[test]
+    fn test_send_would_block() {
+        let (tx, mut rx) = queue::channel::<OutgoingMessage>(2);
+        let tx_ptr = Box::into_raw(Box::new(tx)) as *const salty_channel_sender_tx_t;
+
+        let msg = [0x2a];
+        let iovecs = [
+            salty_iovec_t { iov_base: msg.as_ptr(), iov_len: msg.len() },
+            salty_iovec_t { iov_base: msg.as_ptr(), iov_len: msg.len() },
+        ];
+
+        // Fill the channel
+        let result = unsafe { salty_client_send_task_bytes(tx_ptr, msg.as_ptr(), 1) };
+        assert_eq!(result, salty_client_send_success_t::SEND_OK);
+
+        // A batch that does not fit is not sent at all
+        let result = unsafe { salty_client_send_task_bytes_batch(tx_ptr, iovecs.as_ptr(), iovecs.len()) };
+        assert_eq!(result, salty_client_send_success_t::SEND_WOULD_BLOCK);
+        let result = unsafe { salty_client_send_task_bytes(tx_ptr, msg.as_ptr(), 1) };
+        assert_eq!(result, salty_client_send_success_t::SEND_OK);
+        let result = unsafe { salty_client_send_task_bytes(tx_ptr, msg.as_ptr(), 1) };
+        assert_eq!(result, salty_client_send_success_t::SEND_WOULD_BLOCK);
+
+        let stats = unsafe { salty_channel_sender_tx_stats(tx_ptr) };
+        assert_eq!(stats, salty_channel_stats_t { capacity: 2, depth: 2, high_water: 2, total: 2, full: 2 });
+
+        // A batch larger than the capacity is rejected instead of blocking forever
+        let iovecs = [
+            salty_iovec_t { iov_base: msg.as_ptr(), iov_len: msg.len() },
+            salty_iovec_t { iov_base: msg.as_ptr(), iov_len: msg.len() },
+            salty_iovec_t { iov_base: msg.as_ptr(), iov_len: msg.len() },
+        ];
+        let result = unsafe { salty_client_send_task_bytes_batch(tx_ptr, iovecs.as_ptr(), iovecs.len()) };
+        assert_eq!(result, salty_client_send_success_t::SEND_MESSAGE_ERROR);
+        assert_eq!(unsafe { salty_channel_sender_tx_stats(tx_ptr) }.full, 2);
+
+        // Receiving makes room again
+        assert_eq!(rx.by_ref().wait().next(), Some(Ok(OutgoingMessage::Data(Value::Integer(42.into())))));
+        let result = unsafe { salty_client_send_task_bytes(tx_ptr, msg.as_ptr(), 1) };
+        assert_eq!(result, salty_client_send_success_t::SEND_OK);
+        assert_eq!(unsafe { salty_channel_sender_tx_stats(tx_ptr) }.high_water, 2);
+
+        unsafe { salty_channel_sender_tx_free(tx_ptr) };
+    }
+
+    #[test]
+    fn test_chunked_round_trip() {
+        let (out_tx, out_rx) = queue::channel::<OutgoingMessage>(0);
+        let (in_tx, in_rx) = queue::channel::<MessageEvent>(0);
+        let tx_ptr = Box::into_raw(Box::new(out_tx)) as *const salty_channel_sender_tx_t;
+        let rx_ptr = Box::into_raw(Box::new(in_rx)) as *const salty_channel_receiver_rx_t;
+        let timeout_ptr = Box::into_raw(Box::new(0u32)) as *const u32;
+
+        // Write a message in chunks of 100 bytes
+        let data: Vec<u8> = (0..1000u32).map(|i| i as u8).collect();
+        let writer = unsafe { salty_chunk_writer_new(tx_ptr, 7, 100) };
+        assert!(!writer.is_null());
+        let mut written: size_t = 0;
+        for part in data.chunks(300) {
+            let result = unsafe { salty_chunk_writer_write(writer, part.as_ptr(), part.len(), &mut written) };
+            assert_eq!(result, salty_client_send_success_t::SEND_OK);
+            assert_eq!(written, part.len());
+        }
+        assert_eq!(unsafe { salty_chunk_writer_finish(writer) }, salty_client_send_success_t::SEND_OK);
+        let result = unsafe { salty_chunk_writer_write(writer, data.as_ptr(), 1, &mut written) };
+        assert_eq!(result, salty_client_send_success_t::SEND_MESSAGE_ERROR);
+        unsafe { salty_chunk_writer_free(writer) };
+        unsafe { salty_channel_sender_tx_free(tx_ptr) };
+
+        // Pass the chunks on as incoming task messages, followed by a close message
+        for msg in out_rx.wait() {
+            match msg.unwrap() {
+                OutgoingMessage::Data(val) => in_tx.try_send(MessageEvent::Data(val)).unwrap(),
+                other => panic!("Unexpected message: {:?}", other),
+            }
+        }
+        in_tx.try_send(MessageEvent::Close(CloseCode::from_number(3000))).unwrap();
+
+        // Receive the chunks
+        let reader = unsafe { salty_chunk_reader_new() };
+        let mut received = Vec::new();
+        loop {
+            let result = unsafe { salty_client_recv_chunk(rx_ptr, reader, timeout_ptr) };
+            assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+            assert!(result.msg.is_null());
+            let end_of_message = {
+                let chunk = unsafe { &*result.chunk };
+                assert_eq!(chunk.message_id, 7);
+                assert_eq!(chunk.serial as usize, received.len() / 91);
+                received.extend_from_slice(unsafe { slice::from_raw_parts(chunk.data, chunk.data_len) });
+                chunk.end_of_message
+            };
+            unsafe { salty_client_recv_chunk_ret_free(result) };
+            if end_of_message {
+                break;
+            }
+        }
+        assert_eq!(received, data);
+
+        // Other messages are returned as messages
+        let result = unsafe { salty_client_recv_chunk(rx_ptr, reader, timeout_ptr) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+        assert!(result.chunk.is_null());
+        assert_eq!(unsafe { &*result.msg }.msg_type, salty_msg_type_t::MSG_CLOSE);
+        unsafe { salty_client_recv_chunk_ret_free(result) };
+
+        // Chunks out of order are held back
+        in_tx.try_send(MessageEvent::Data(Value::Binary(vec![1, 0, 0, 0, 8, 0, 0, 0, 1, 2]))).unwrap();
+        let result = unsafe { salty_client_recv_chunk(rx_ptr, reader, timeout_ptr) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_NO_DATA);
+
+        // Binary task messages that are not a chunk are returned as messages
+        in_tx.try_send(MessageEvent::Data(Value::Binary(vec![1, 2, 3]))).unwrap();
+        let result = unsafe { salty_client_recv_chunk(rx_ptr, reader, timeout_ptr) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+        assert!(result.chunk.is_null());
+        assert_eq!(unsafe { &*result.msg }.msg_type, salty_msg_type_t::MSG_TASK);
+        unsafe { salty_client_recv_chunk_ret_free(result) };
+
+        // The missing chunk releases the held back one
+        in_tx.try_send(MessageEvent::Data(Value::Binary(vec![0, 0, 0, 0, 8, 0, 0, 0, 0, 1]))).unwrap();
+        for serial in 0..2 {
+            let result = unsafe { salty_client_recv_chunk(rx_ptr, reader, timeout_ptr) };
+            assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+            {
+                let chunk = unsafe { &*result.chunk };
+                assert_eq!((chunk.message_id, chunk.serial, chunk.end_of_message), (8, serial, serial == 1));
+                assert_eq!(unsafe { slice::from_raw_parts(chunk.data, chunk.data_len) }, &[serial as u8 + 1]);
+            }
+            unsafe { salty_client_recv_chunk_ret_free(result) };
+        }
+
+        unsafe { salty_chunk_reader_free(reader) };
+        unsafe { salty_channel_receiver_rx_free(rx_ptr) };
+    }
+
+    #[test]
+    fn test_channel_stats() {
+        let (tx, rx) = queue::channel::<MessageEvent>(0);
+        let rx_ptr = Box::into_raw(Box::new(rx)) as *const salty_channel_receiver_rx_t;
+        let timeout_ptr = Box::into_raw(Box::new(0u32)) as *const u32;
+
+        for i in 0..3 {
+            tx.try_send(MessageEvent::Data(Value::Integer(i.into()))).unwrap();
+        }
+        let result = unsafe { salty_client_recv_msg(rx_ptr, timeout_ptr) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+        unsafe { salty_client_recv_msg_ret_free(result) };
+
+        let stats = unsafe { salty_channel_receiver_rx_stats(rx_ptr) };
+        assert_eq!(stats, salty_channel_stats_t { capacity: 0, depth: 2, high_water: 3, total: 3, full: 0 });
+
+        let stats = unsafe { salty_channel_receiver_rx_stats(ptr::null()) };
+        assert_eq!(stats.total, 0);
+
+        unsafe {
+            Box::from_raw(timeout_ptr as *mut u32);
+            salty_channel_receiver_rx_free(rx_ptr);
+        }
+    }
+
+    #[test]
+    fn test_recv_msg_batch() {
+        let (tx, rx) = queue::channel::<MessageEvent>(0);
+        let rx_ptr = Box::into_raw(Box::new(rx)) as *const salty_channel_receiver_rx_t;
+        let timeout_ms = 0u32;
+
+        // Receive no data
+        let result = unsafe { salty_client_recv_msg_batch(rx_ptr, 2, &timeout_ms) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_NO_DATA);
+        assert!(result.msgs.is_null());
+
+        // Send four messages
+        tx.try_send(MessageEvent::Data(Value::Integer(1.into()))).unwrap();
+        tx.try_send(MessageEvent::Application(Value::Integer(2.into()))).unwrap();
+        tx.try_send(MessageEvent::Application(Value::Integer(3.into()))).unwrap();
+        tx.try_send(MessageEvent::Close(CloseCode::from_number(3002))).unwrap();
+
+        // Receive at most two messages
+        let result = unsafe { salty_client_recv_msg_batch(rx_ptr, 2, &timeout_ms) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+        assert_eq!(result.msgs_len, 2);
+        unsafe {
+            let msgs = slice::from_raw_parts(result.msgs, result.msgs_len);
+            assert_eq!(msgs[0].msg_type, salty_msg_type_t::MSG_TASK);
+            assert_eq!(slice::from_raw_parts(msgs[0].msg_bytes, msgs[0].msg_bytes_len), &[1]);
+            assert_eq!(msgs[1].msg_type, salty_msg_type_t::MSG_APPLICATION);
+            assert_eq!(slice::from_raw_parts(msgs[1].msg_bytes, msgs[1].msg_bytes_len), &[2]);
+            salty_client_recv_msgs_ret_free(result);
+        }
+
+        // The batch ends with the close message
+        tx.try_send(MessageEvent::Application(Value::Integer(4.into()))).unwrap();
+        let result = unsafe { salty_client_recv_msg_batch(rx_ptr, 10, &timeout_ms) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+        assert_eq!(result.msgs_len, 2);
+        unsafe {
+            let msgs = slice::from_raw_parts(result.msgs, result.msgs_len);
+            assert_eq!(msgs[0].msg_type, salty_msg_type_t::MSG_APPLICATION);
+            assert_eq!(msgs[1].msg_type, salty_msg_type_t::MSG_CLOSE);
+            assert_eq!(msgs[1].close_code, 3002);
+            salty_client_recv_msgs_ret_free(result);
+        }
+
+        // Drop sender, the remaining message is still returned
+        ::std::mem::drop(tx);
+        let result = unsafe { salty_client_recv_msg_batch(rx_ptr, 10, &timeout_ms) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+        assert_eq!(result.msgs_len, 1);
+        unsafe { salty_client_recv_msgs_ret_free(result) };
+
+        // Receive stream ended
+        let result = unsafe { salty_client_recv_msg_batch(rx_ptr, 10, &timeout_ms) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_STREAM_ENDED);
+
+        unsafe { salty_channel_receiver_rx_free(rx_ptr) };
+    }
+
+    #[test]
+    fn test_recv_msg_notify() {
+        let (tx, rx) = queue::channel::<MessageEvent>(0);
+        let rx_ptr = Box::into_raw(Box::new(rx)) as *const salty_channel_receiver_rx_t;
+        let readiness = salty_readiness_new();
+        assert!(!readiness.is_null());
+        let fd = unsafe { salty_readiness_fd(readiness) };
+        let is_readable = || {
+            let mut pfd = libc::pollfd { fd, events: libc::POLLIN, revents: 0 };
+            unsafe { libc::poll(&mut pfd, 1, 0) == 1 }
+        };
+
+        // Arm
+        let result = unsafe { salty_client_recv_msg_notify(rx_ptr, readiness) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_NO_DATA);
+        assert!(!is_readable());
+
+        // Message arrives
+        tx.try_send(MessageEvent::Application(Value::Integer(23.into()))).unwrap();
+        assert!(is_readable());
+        let result = unsafe { salty_client_recv_msg_notify(rx_ptr, readiness) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_OK);
+        unsafe { salty_client_recv_msg_ret_free(result) };
+        assert!(!is_readable());
+
+        // Stream ends
+        let result = unsafe { salty_client_recv_msg_notify(rx_ptr, readiness) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_NO_DATA);
+        ::std::mem::drop(tx);
+        assert!(is_readable());
+        let result = unsafe { salty_client_recv_msg_notify(rx_ptr, readiness) };
+        assert_eq!(result.success, salty_client_recv_success_t::RECV_STREAM_ENDED);
+
+        unsafe {
+            salty_readiness_free(readiness);
+            salty_channel_receiver_rx_free(rx_ptr);
+        }
+    }
+
     #[test]
     fn test_recv_timeout_thread() {
-        let (tx, rx) = mpsc::unbounded::<MessageEvent>();
+        let (tx, rx) = queue::channel::<MessageEvent>(0);
         let rx_ptr = Box::into_raw(Box::new(rx)) as *const salty_channel_receiver_rx_t;
 
         let timeout_1s_ptr = Box::into_raw(Box::new(1_000u32)) as *const u32;
@@ -1889,7 +3920,7 @@ mod tests {
         // Set up thread to post a message after 1.5 seconds
         let child = ::std::thread::spawn(move || {
             ::std::thread::sleep(Duration::from_millis(1500));
-            tx.unbounded_send(MessageEvent::Close(CloseCode::from_number(3000))).unwrap();
+            tx.try_send(MessageEvent::Close(CloseCode::from_number(3000))).unwrap();
         });
 
         // Wait for max 1s, but receive no data (timeout)
@@ -1925,7 +3956,7 @@ mod tests {
 
     #[test]
     fn test_recv_timeout_simple() {
-        let (_tx, rx) = mpsc::unbounded::<MessageEvent>();
+        let (_tx, rx) = queue::channel::<MessageEvent>(0);
         let rx_ptr = Box::into_raw(Box::new(rx)) as *const salty_channel_receiver_rx_t;
 
         // Wait for max 500ms, but receive no data (timeout)
@@ -1953,6 +3984,102 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_bounded_capacities() {
+        let keypair = salty_keypair_new();
+        let event_loop = salty_event_loop_new();
+        let remote = unsafe { salty_event_loop_get_remote(event_loop) };
+        let capacities = salty_channel_capacities_t { incoming: 64, outgoing: 16 };
+        let client_ret = unsafe {
+            salty_relayed_data_initiator_new_bounded(keypair, remote, 0, ptr::null(), ptr::null(), capacities)
+        };
+        assert_eq!(client_ret.success, salty_relayed_data_success_t::OK);
+        unsafe {
+            assert_eq!(salty_channel_receiver_rx_stats(client_ret.receiver_rx).capacity, 64);
+            assert_eq!(salty_channel_sender_tx_stats(client_ret.sender_tx).capacity, 16);
+            salty_channel_receiver_rx_free(client_ret.receiver_rx);
+            salty_channel_sender_tx_free(client_ret.sender_tx);
+            salty_channel_sender_rx_free(client_ret.sender_rx);
+        }
+    }
+
+    #[test]
+    fn test_encrypt_decrypt_required_len() {
+        assert_eq!(salty_client_encrypt_required_len(0), 16);
+        assert_eq!(salty_client_encrypt_required_len(1024), 1040);
+        assert_eq!(salty_client_decrypt_required_len(1040), 1024);
+        assert_eq!(salty_client_decrypt_required_len(16), 0);
+        assert_eq!(salty_client_decrypt_required_len(15), 0);
+    }
+
+    #[test]
+    fn test_encrypt_into_buffer_too_small() {
+        let keypair = salty_keypair_new();
+        let event_loop = salty_event_loop_new();
+        let remote = unsafe { salty_event_loop_get_remote(event_loop) };
+        let client_ret = unsafe { salty_relayed_data_initiator_new(keypair, remote, 0, ptr::null(), ptr::null()) };
+        let data = [0u8; 32];
+        let nonce = [0u8; 24];
+        let mut out = [0u8; 40];
+        let mut written: size_t = 0;
+        let result = unsafe {
+            salty_client_encrypt_with_session_keys_into(
+                client_ret.client,
+                data.as_ptr(),
+                data.len(),
+                nonce.as_ptr(),
+                out.as_mut_ptr(),
+                out.len(),
+                &mut written,
+            )
+        };
+        assert_eq!(result, salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_BUFFER_TOO_SMALL);
+        assert_eq!(written, 48);
+    }
+
+    #[test]
+    fn test_encrypt_into_no_peer() {
+        let keypair = salty_keypair_new();
+        let event_loop = salty_event_loop_new();
+        let remote = unsafe { salty_event_loop_get_remote(event_loop) };
+        let client_ret = unsafe { salty_relayed_data_initiator_new(keypair, remote, 0, ptr::null(), ptr::null()) };
+        let mut buf = [0u8; 48];
+        let nonce = [0u8; 24];
+        let mut written: size_t = 0;
+        let result = unsafe {
+            salty_client_encrypt_with_session_keys_into(
+                client_ret.client,
+                buf.as_ptr(),
+                32,
+                nonce.as_ptr(),
+                buf.as_mut_ptr(),
+                buf.len(),
+                &mut written,
+            )
+        };
+        assert_eq!(result, salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NO_PEER);
+        assert_eq!(written, 0);
+    }
+
+    #[test]
+    fn test_decrypt_into_null_ptr() {
+        let data = [0u8; 32];
+        let nonce = [0u8; 24];
+        let mut written: size_t = 0;
+        let result = unsafe {
+            salty_client_decrypt_with_session_keys_into(
+                ptr::null(),
+                data.as_ptr(),
+                data.len(),
+                nonce.as_ptr(),
+                ptr::null_mut(),
+                0,
+                &mut written,
+            )
+        };
+        assert_eq!(result, salty_client_encrypt_decrypt_success_t::ENCRYPT_DECRYPT_NULL_ARGUMENT);
+    }
+
     /// Using zero bytes as trusted key should fail.
     #[test]
     fn test_initiator_trusted_key_validation() {
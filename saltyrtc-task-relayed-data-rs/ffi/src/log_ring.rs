@@ -0,0 +1,429 @@
+//! A bounded, lock-free ring buffer for log records.
+//!
+//! Logging threads (e.g. the event loop) never block on the ring: a record
+//! is formatted directly into a preallocated slot, and if all slots are in
+//! use, the record is dropped and counted instead. The records are drained
+//! on another thread and passed on, e.g. to a C callback.
+//!
+//! The slots follow Dmitry Vyukov's bounded MPMC queue: every slot has a
+//! sequence number telling whether it is free or filled in the current lap
+//! around the ring.
+//!
+//! A consumer thread can wait for records with `wait`, it is unparked by the
+//! next push.
+
+use std::cell::UnsafeCell;
+use std::cmp;
+use std::fmt::{self, Write};
+use std::sync::Mutex;
+use std::sync::atomic::{self, AtomicBool, AtomicUsize, Ordering};
+use std::thread::{self, Thread};
+use std::time::Duration;
+
+use libc::c_char;
+
+/// Size of the target buffer of a slot, including the terminating NUL byte.
+pub const TARGET_CAPACITY: usize = 64;
+
+/// Size of the message buffer of a slot, including the terminating NUL byte.
+/// Longer messages are truncated.
+pub const MESSAGE_CAPACITY: usize = 512;
+
+/// A NUL terminated string buffer that truncates what does not fit.
+struct StrBuf<A> {
+    buf: A,
+    len: usize,
+}
+
+impl<A: AsRef<[u8]> + AsMut<[u8]>> StrBuf<A> {
+    fn clear(&mut self) {
+        self.len = 0;
+        self.buf.as_mut()[0] = 0;
+    }
+
+    fn as_bytes(&self) -> &[u8] {
+        &self.buf.as_ref()[..self.len]
+    }
+}
+
+impl<A: AsRef<[u8]> + AsMut<[u8]>> Write for StrBuf<A> {
+    fn write_str(&mut self, s: &str) -> fmt::Result {
+        let buf = self.buf.as_mut();
+        let available = buf.len() - 1 - self.len;
+        let mut count = cmp::min(available, s.len());
+        // Do not cut a multi-byte character in half
+        while !s.is_char_boundary(count) {
+            count -= 1;
+        }
+        buf[self.len..self.len + count].copy_from_slice(&s.as_bytes()[..count]);
+        self.len += count;
+        buf[self.len] = 0;
+        Ok(())
+    }
+}
+
+/// A log record in the ring.
+pub struct LogRecord {
+    level: u8,
+    target: StrBuf<[u8; TARGET_CAPACITY]>,
+    message: StrBuf<[u8; MESSAGE_CAPACITY]>,
+}
+
+impl LogRecord {
+    pub fn level(&self) -> u8 {
+        self.level
+    }
+
+    pub fn target(&self) -> &[u8] {
+        self.target.as_bytes()
+    }
+
+    pub fn message(&self) -> &[u8] {
+        self.message.as_bytes()
+    }
+
+    /// The target as a NUL terminated C string.
+    pub fn target_ptr(&self) -> *const c_char {
+        self.target.buf.as_ptr() as *const c_char
+    }
+
+    /// The message as a NUL terminated C string.
+    pub fn message_ptr(&self) -> *const c_char {
+        self.message.buf.as_ptr() as *const c_char
+    }
+}
+
+struct Slot {
+    sequence: AtomicUsize,
+    record: UnsafeCell<LogRecord>,
+}
+
+/// Hands a claimed slot over to the consumer when dropped, even if
+/// formatting the record panicked. Otherwise the ring would get stuck at
+/// that slot.
+struct Publish<'a> {
+    slot: &'a Slot,
+    sequence: usize,
+}
+
+impl<'a> Drop for Publish<'a> {
+    fn drop(&mut self) {
+        self.slot.sequence.store(self.sequence, Ordering::Release);
+    }
+}
+
+pub struct LogRing {
+    slots: Box<[Slot]>,
+    mask: usize,
+    enqueue_pos: AtomicUsize,
+    dequeue_pos: AtomicUsize,
+    dropped: AtomicUsize,
+    consumer: Mutex<Option<Thread>>,
+    consumer_waiting: AtomicBool,
+}
+
+// A slot is only accessed by the thread that claimed it through its sequence.
+unsafe impl Send for LogRing {}
+unsafe impl Sync for LogRing {}
+
+impl fmt::Debug for LogRing {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_struct("LogRing")
+            .field("capacity", &self.slots.len())
+            .field("dropped", &self.dropped.load(Ordering::Relaxed))
+            .finish()
+    }
+}
+
+impl LogRing {
+    /// Create a ring with room for at least `capacity` records.
+    ///
+    /// The capacity is rounded up to the next power of two.
+    pub fn new(capacity: usize) -> Self {
+        let capacity = cmp::max(capacity, 2).next_power_of_two();
+        let slots: Vec<Slot> = (0..capacity)
+            .map(|i| Slot {
+                sequence: AtomicUsize::new(i),
+                record: UnsafeCell::new(LogRecord {
+                    level: 0,
+                    target: StrBuf { buf: [0; TARGET_CAPACITY], len: 0 },
+                    message: StrBuf { buf: [0; MESSAGE_CAPACITY], len: 0 },
+                }),
+            })
+            .collect();
+        LogRing {
+            slots: slots.into_boxed_slice(),
+            mask: capacity - 1,
+            enqueue_pos: AtomicUsize::new(0),
+            dequeue_pos: AtomicUsize::new(0),
+            dropped: AtomicUsize::new(0),
+            consumer: Mutex::new(None),
+            consumer_waiting: AtomicBool::new(false),
+        }
+    }
+
+    /// The number of records that fit into the ring.
+    pub fn capacity(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// The number of records dropped because the ring was full.
+    pub fn dropped(&self) -> usize {
+        self.dropped.load(Ordering::Relaxed)
+    }
+
+    /// Add a record without blocking.
+    ///
+    /// The message is only formatted once a slot has been claimed. If the
+    /// consumer is waiting, it is unparked. Returns `false` if the ring is
+    /// full and the record has been dropped.
+    pub fn push(&self, level: u8, target: &str, args: &fmt::Arguments) -> bool {
+        let mut pos = self.enqueue_pos.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos & self.mask];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let diff = sequence.wrapping_sub(pos) as isize;
+            if diff == 0 {
+                match self.enqueue_pos.compare_exchange_weak(pos, pos.wrapping_add(1), Ordering::Relaxed, Ordering::Relaxed) {
+                    Ok(_) => {
+                        {
+                            let _publish = Publish { slot, sequence: pos.wrapping_add(1) };
+                            let record = unsafe { &mut *slot.record.get() };
+                            record.level = level;
+                            record.target.clear();
+                            let _ = record.target.write_str(target);
+                            record.message.clear();
+                            let _ = record.message.write_fmt(*args);
+                        }
+                        self.wake_consumer();
+                        return true;
+                    },
+                    Err(current) => pos = current,
+                }
+            } else if diff < 0 {
+                // The slot still holds a record of the previous lap
+                self.dropped.fetch_add(1, Ordering::Relaxed);
+                return false;
+            } else {
+                pos = self.enqueue_pos.load(Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Unpark the consumer if it is waiting in `wait`.
+    fn wake_consumer(&self) {
+        // Pairs with the fence in `wait`: Either the consumer sees the new
+        // record, or this sees the consumer waiting.
+        atomic::fence(Ordering::SeqCst);
+        if self.consumer_waiting.load(Ordering::Relaxed) && self.consumer_waiting.swap(false, Ordering::Relaxed) {
+            // Only contended while the consumer is being registered
+            if let Ok(consumer) = self.consumer.try_lock() {
+                if let Some(ref thread) = *consumer {
+                    thread.unpark();
+                }
+            }
+        }
+    }
+
+    /// Register the current thread as the consumer that is unparked when a
+    /// record is added while it waits.
+    pub fn set_consumer(&self) {
+        if let Ok(mut consumer) = self.consumer.lock() {
+            *consumer = Some(thread::current());
+        }
+    }
+
+    /// Whether the ring holds no records.
+    fn is_empty(&self) -> bool {
+        let pos = self.dequeue_pos.load(Ordering::Relaxed);
+        let sequence = self.slots[pos & self.mask].sequence.load(Ordering::Acquire);
+        sequence != pos.wrapping_add(1)
+    }
+
+    /// Wait until a record is added or the timeout has been reached.
+    ///
+    /// Must only be called by the thread registered with `set_consumer`.
+    /// Returns immediately if the ring is not empty.
+    pub fn wait(&self, timeout: Duration) {
+        self.consumer_waiting.store(true, Ordering::Relaxed);
+        atomic::fence(Ordering::SeqCst);
+        if self.is_empty() {
+            thread::park_timeout(timeout);
+        }
+        self.consumer_waiting.store(false, Ordering::Relaxed);
+    }
+
+    /// Take the oldest record out of the ring and pass it to `f`.
+    ///
+    /// Returns `false` if the ring is empty.
+    pub fn pop<F: FnOnce(&LogRecord)>(&self, f: F) -> bool {
+        let mut pos = self.dequeue_pos.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos & self.mask];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let diff = sequence.wrapping_sub(pos.wrapping_add(1)) as isize;
+            if diff == 0 {
+                match self.dequeue_pos.compare_exchange_weak(pos, pos.wrapping_add(1), Ordering::Relaxed, Ordering::Relaxed) {
+                    Ok(_) => {
+                        f(unsafe { &*slot.record.get() });
+                        slot.sequence.store(pos.wrapping_add(self.mask + 1), Ordering::Release);
+                        return true;
+                    },
+                    Err(current) => pos = current,
+                }
+            } else if diff < 0 {
+                return false;
+            } else {
+                pos = self.dequeue_pos.load(Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Pass up to `max_records` records to `f`. Returns the number of records.
+    pub fn drain<F: FnMut(&LogRecord)>(&self, max_records: usize, mut f: F) -> usize {
+        let mut count = 0;
+        while count < max_records && self.pop(|record| f(record)) {
+            count += 1;
+        }
+        count
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::fmt;
+    use std::panic::{self, AssertUnwindSafe};
+    use std::str;
+    use std::sync::Arc;
+    use std::sync::mpsc;
+    use std::thread;
+    use std::time::{Duration, Instant};
+
+    use super::*;
+
+    fn messages(ring: &LogRing) -> Vec<String> {
+        let mut messages = Vec::new();
+        ring.drain(usize::max_value(), |record| {
+            messages.push(str::from_utf8(record.message()).unwrap().to_string());
+        });
+        messages
+    }
+
+    #[test]
+    fn test_capacity() {
+        assert_eq!(LogRing::new(0).capacity(), 2);
+        assert_eq!(LogRing::new(100).capacity(), 128);
+    }
+
+    #[test]
+    fn test_push_pop() {
+        let ring = LogRing::new(4);
+        assert!(ring.push(2, "target", &format_args!("Hello {}", 42)));
+        let mut popped = false;
+        assert!(ring.pop(|record| {
+            assert_eq!(record.level(), 2);
+            assert_eq!(record.target(), b"target");
+            assert_eq!(record.message(), b"Hello 42");
+            popped = true;
+        }));
+        assert!(popped);
+        assert!(!ring.pop(|_| panic!("Ring should be empty")));
+    }
+
+    #[test]
+    fn test_drop_when_full() {
+        let ring = LogRing::new(2);
+        for i in 0..5 {
+            ring.push(1, "t", &format_args!("{}", i));
+        }
+        assert_eq!(ring.dropped(), 3);
+        assert_eq!(messages(&ring), vec!["0", "1"]);
+
+        // Room again after draining
+        assert!(ring.push(1, "t", &format_args!("5")));
+        assert_eq!(messages(&ring), vec!["5"]);
+    }
+
+    #[test]
+    fn test_truncate() {
+        let ring = LogRing::new(2);
+        let long = "ä".repeat(MESSAGE_CAPACITY);
+        ring.push(1, &"x".repeat(100), &format_args!("{}", long));
+        ring.pop(|record| {
+            assert_eq!(record.target().len(), TARGET_CAPACITY - 1);
+            assert_eq!(record.message().len(), MESSAGE_CAPACITY - 2);
+            assert!(str::from_utf8(record.message()).is_ok());
+        });
+    }
+
+    #[test]
+    fn test_panicking_display() {
+        struct Panicking;
+        impl fmt::Display for Panicking {
+            fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+                f.write_str("before")?;
+                panic!("Display panicked");
+            }
+        }
+
+        // The slot is handed over anyway and the ring keeps working
+        let ring = LogRing::new(2);
+        let res = panic::catch_unwind(AssertUnwindSafe(|| {
+            ring.push(1, "t", &format_args!("{}", Panicking));
+        }));
+        assert!(res.is_err());
+        for i in 0..2 {
+            assert!(ring.push(1, "t", &format_args!("{}", i)));
+            assert!(ring.pop(|_| {}));
+        }
+        assert!(ring.pop(|record| assert_eq!(record.message(), b"1")));
+        assert!(!ring.pop(|_| {}));
+    }
+
+    #[test]
+    fn test_push_wakes_consumer() {
+        let ring = Arc::new(LogRing::new(4));
+        let (ready_tx, ready_rx) = mpsc::channel();
+        let consumer = {
+            let ring = ring.clone();
+            thread::spawn(move || {
+                ring.set_consumer();
+                ready_tx.send(()).unwrap();
+                let start = Instant::now();
+                while ring.is_empty() {
+                    ring.wait(Duration::from_secs(30));
+                }
+                start.elapsed()
+            })
+        };
+        ready_rx.recv().unwrap();
+        thread::sleep(Duration::from_millis(50));
+        ring.push(1, "t", &format_args!("wake up"));
+        assert!(consumer.join().unwrap() < Duration::from_secs(10));
+    }
+
+    #[test]
+    fn test_concurrent_producers() {
+        let ring = Arc::new(LogRing::new(64));
+        let producers: Vec<_> = (0..4)
+            .map(|p| {
+                let ring = ring.clone();
+                thread::spawn(move || {
+                    for i in 0..1000 {
+                        ring.push(1, "t", &format_args!("{} {}", p, i));
+                    }
+                })
+            })
+            .collect();
+        // Every record is either received or dropped
+        let mut received = 0;
+        while received + ring.dropped() < 4000 {
+            received += ring.drain(16, |record| assert!(!record.message().is_empty()));
+        }
+        for producer in producers {
+            producer.join().unwrap();
+        }
+        assert_eq!(received + ring.dropped(), 4000);
+        assert!(!ring.pop(|_| {}));
+    }
+}
@@ -0,0 +1,197 @@
+//! A pool of event loops, each running on its own worker thread.
+//!
+//! A Tokio reactor core (and every connection registered with it) is bound
+//! to a single thread, so connections cannot migrate between workers once
+//! they have been started. Instead, new connections are assigned to the
+//! worker with the fewest running connections. Everything that is bound to
+//! a worker's event loop (e.g. the handshake future) has to be created on
+//! that worker.
+
+use std::io;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::mpsc as std_mpsc;
+use std::thread::{self, JoinHandle};
+
+use saltyrtc_client::dep::futures::{Future, IntoFuture};
+use saltyrtc_client::dep::futures::sync::oneshot;
+use tokio_core::reactor::{Core, Handle, Remote};
+
+struct Worker {
+    remote: Remote,
+    connections: Arc<AtomicUsize>,
+    shutdown_tx: Option<oneshot::Sender<()>>,
+    thread: Option<JoinHandle<()>>,
+}
+
+pub struct EventLoopPool {
+    workers: Vec<Worker>,
+    next: AtomicUsize,
+}
+
+impl EventLoopPool {
+    /// Start a pool with the specified number of worker threads.
+    pub fn new(worker_count: usize) -> io::Result<Self> {
+        let mut workers = Vec::with_capacity(worker_count);
+        for i in 0..worker_count {
+            let (remote_tx, remote_rx) = std_mpsc::channel();
+            let (shutdown_tx, shutdown_rx) = oneshot::channel::<()>();
+            let thread = thread::Builder::new()
+                .name(format!("salty-worker-{}", i))
+                .spawn(move || {
+                    let mut core = match Core::new() {
+                        Ok(core) => core,
+                        Err(e) => {
+                            let _ = remote_tx.send(Err(e));
+                            return;
+                        },
+                    };
+                    let _ = remote_tx.send(Ok(core.remote()));
+                    // Either a shutdown request or a dropped pool ends the loop
+                    let _ = core.run(shutdown_rx);
+                    trace!("Event loop worker {} stopped", i);
+                })?;
+            let remote = match remote_rx.recv() {
+                Ok(Ok(remote)) => remote,
+                Ok(Err(e)) => return Err(e),
+                Err(_) => return Err(io::Error::new(io::ErrorKind::Other, "Event loop worker died")),
+            };
+            workers.push(Worker {
+                remote,
+                connections: Arc::new(AtomicUsize::new(0)),
+                shutdown_tx: Some(shutdown_tx),
+                thread: Some(thread),
+            });
+        }
+        Ok(EventLoopPool { workers, next: AtomicUsize::new(0) })
+    }
+
+    /// The number of worker threads.
+    pub fn len(&self) -> usize {
+        self.workers.len()
+    }
+
+    /// The remote handle of a worker.
+    pub fn remote(&self, worker: usize) -> Option<&Remote> {
+        self.workers.get(worker).map(|w| &w.remote)
+    }
+
+    /// The number of connections currently running on all workers.
+    pub fn connections(&self) -> usize {
+        self.workers.iter()
+            .map(|w| w.connections.load(Ordering::SeqCst))
+            .sum()
+    }
+
+    /// Choose the worker with the fewest running connections.
+    ///
+    /// Ties are broken round robin, so that clients created in a row before
+    /// connecting are spread over all workers.
+    pub fn next_worker(&self) -> usize {
+        let count = self.workers.len();
+        let start = self.next.fetch_add(1, Ordering::Relaxed) % count;
+        (0..count)
+            .map(|offset| (start + offset) % count)
+            .min_by_key(|&i| self.workers[i].connections.load(Ordering::SeqCst))
+            .unwrap_or(0)
+    }
+
+    /// Run a connection on a worker.
+    ///
+    /// The future is created on the worker thread and counted as a running
+    /// connection until it has completed.
+    pub fn spawn<F, R>(&self, worker: usize, f: F) -> Result<(), String>
+    where
+        F: FnOnce(&Handle) -> R + Send + 'static,
+        R: IntoFuture<Item=(), Error=()>,
+        R::Future: 'static,
+    {
+        let worker = self.workers.get(worker)
+            .ok_or_else(|| format!("Invalid worker index: {}", worker))?;
+        let connections = worker.connections.clone();
+        connections.fetch_add(1, Ordering::SeqCst);
+        worker.remote.spawn(move |handle| {
+            f(handle).into_future().then(move |res| {
+                connections.fetch_sub(1, Ordering::SeqCst);
+                res
+            })
+        });
+        Ok(())
+    }
+}
+
+impl Drop for EventLoopPool {
+    fn drop(&mut self) {
+        for worker in &mut self.workers {
+            if let Some(shutdown_tx) = worker.shutdown_tx.take() {
+                let _ = shutdown_tx.send(());
+            }
+        }
+        for worker in &mut self.workers {
+            if let Some(thread) = worker.thread.take() {
+                if thread.join().is_err() {
+                    error!("Event loop worker panicked");
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::collections::HashSet;
+    use std::sync::mpsc as std_mpsc;
+    use std::time::Duration;
+
+    use saltyrtc_client::dep::futures::future;
+
+    use super::*;
+
+    #[test]
+    fn test_spread_over_workers() {
+        let pool = EventLoopPool::new(4).unwrap();
+        assert_eq!(pool.len(), 4);
+
+        // Keep the connections running until the senders are dropped
+        let (thread_tx, thread_rx) = std_mpsc::channel();
+        let mut stop_txs = Vec::new();
+        for _ in 0..8 {
+            let (stop_tx, stop_rx) = oneshot::channel::<()>();
+            stop_txs.push(stop_tx);
+            let thread_tx = thread_tx.clone();
+            let worker = pool.next_worker();
+            pool.spawn(worker, move |_handle| {
+                thread_tx.send(thread::current().name().unwrap().to_string()).unwrap();
+                stop_rx.then(|_| future::ok(()))
+            }).unwrap();
+        }
+
+        let names: Vec<String> = (0..8)
+            .map(|_| thread_rx.recv_timeout(Duration::from_secs(5)).unwrap())
+            .collect();
+        let unique: HashSet<&String> = names.iter().collect();
+        assert_eq!(unique.len(), 4);
+        assert_eq!(pool.connections(), 8);
+
+        // Finished connections are not counted anymore
+        stop_txs.clear();
+        for _ in 0..100 {
+            if pool.connections() == 0 {
+                break;
+            }
+            thread::sleep(Duration::from_millis(10));
+        }
+        assert_eq!(pool.connections(), 0);
+    }
+
+    #[test]
+    fn test_prefer_idle_worker() {
+        let pool = EventLoopPool::new(2).unwrap();
+        let (_stop_tx, stop_rx) = oneshot::channel::<()>();
+        pool.spawn(0, move |_handle| stop_rx.then(|_| future::ok(()))).unwrap();
+        for _ in 0..4 {
+            assert_eq!(pool.next_worker(), 1);
+        }
+        assert!(pool.spawn(2, |_handle| future::ok(())).is_err());
+    }
+}
@@ -0,0 +1,457 @@
+//! Bounded channels with queue statistics.
+//!
+//! The channels are built on top of `mpsc::unbounded` with an atomic counter
+//! of the queued messages. This allows sending through a shared reference
+//! (the FFI hands out `const` pointers that may be used from any thread)
+//! while still enforcing an exact capacity:
+//!
+//! - `QueueSender::try_send` fails with `TrySendError::Full` if the queue is full.
+//! - As a `Sink`, the sender returns `NotReady` if the queue is full and is
+//!   woken up as soon as the receiver has taken a message out of the queue.
+//!   All senders waiting at that point are woken up (they may be clones used
+//!   by different tasks), and those that still find the queue full wait again.
+//! - Once the receiver has been dropped, sending fails with
+//!   `TrySendError::Disconnected` (even if the queue is full) and all waiting
+//!   senders are woken up to find out.
+//!
+//! A capacity of `0` means that the queue is unbounded. The statistics are
+//! collected in both cases.
+
+use std::fmt;
+use std::mem;
+use std::sync::{Arc, Mutex};
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+
+use saltyrtc_client::dep::futures::{Async, AsyncSink, Poll, Sink, StartSend, Stream};
+use saltyrtc_client::dep::futures::sync::mpsc;
+use saltyrtc_client::dep::futures::task::{self, Task};
+
+/// Shared state of a queue.
+struct QueueState {
+    /// Maximum number of queued messages, `0` if unbounded.
+    capacity: usize,
+    /// Number of queued messages.
+    depth: AtomicUsize,
+    /// Highest number of queued messages so far.
+    high_water: AtomicUsize,
+    /// Number of messages that have been enqueued.
+    total: AtomicUsize,
+    /// Number of times a message could not be enqueued because the queue was full.
+    full: AtomicUsize,
+    /// Whether the receiver has been dropped.
+    closed: AtomicBool,
+    /// Whether `waiters` is non-empty (avoids locking when nobody waits).
+    has_waiters: AtomicBool,
+    /// The tasks waiting for the queue to have room again.
+    waiters: Mutex<Vec<Task>>,
+}
+
+impl fmt::Debug for QueueState {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_struct("QueueState")
+            .field("capacity", &self.capacity)
+            .field("depth", &self.depth.load(Ordering::Relaxed))
+            .finish()
+    }
+}
+
+impl QueueState {
+    /// Reserve room for `count` messages.
+    ///
+    /// The depth is only increased if there is room, so that a failed attempt
+    /// never makes the queue appear full to a concurrent sender.
+    fn try_reserve(&self, count: usize) -> Result<(), TrySendError> {
+        if self.closed.load(Ordering::SeqCst) {
+            return Err(TrySendError::Disconnected);
+        }
+        let mut previous = self.depth.load(Ordering::SeqCst);
+        let depth = loop {
+            let depth = previous + count;
+            if self.capacity != 0 && depth > self.capacity {
+                return Err(TrySendError::Full);
+            }
+            match self.depth.compare_exchange_weak(previous, depth, Ordering::SeqCst, Ordering::SeqCst) {
+                Ok(_) => break depth,
+                Err(current) => previous = current,
+            }
+        };
+        self.total.fetch_add(count, Ordering::Relaxed);
+        let mut high_water = self.high_water.load(Ordering::Relaxed);
+        while depth > high_water {
+            match self.high_water.compare_exchange_weak(high_water, depth, Ordering::Relaxed, Ordering::Relaxed) {
+                Ok(_) => break,
+                Err(current) => high_water = current,
+            }
+        }
+        Ok(())
+    }
+
+    /// Release the room of a message that has been taken out of the queue
+    /// (or could not be enqueued after all) and wake up all waiting tasks.
+    fn release(&self, count: usize) {
+        self.depth.fetch_sub(count, Ordering::SeqCst);
+        self.notify_waiters();
+    }
+
+    /// Mark the queue as closed and wake up all waiting tasks, so that they
+    /// fail instead of waiting for room forever.
+    fn close(&self) {
+        self.closed.store(true, Ordering::SeqCst);
+        self.notify_waiters();
+    }
+
+    fn notify_waiters(&self) {
+        if !self.has_waiters.load(Ordering::SeqCst) {
+            return;
+        }
+        let waiters = {
+            let mut waiters = self.waiters.lock().unwrap_or_else(|e| e.into_inner());
+            self.has_waiters.store(false, Ordering::SeqCst);
+            mem::replace(&mut *waiters, Vec::new())
+        };
+        for waiter in waiters {
+            waiter.notify();
+        }
+    }
+
+    /// Register the current task to be woken up once a message has been
+    /// taken out of the queue (or the queue has been closed).
+    ///
+    /// Must be called from within a task, before checking the depth again.
+    fn register(&self) {
+        let mut waiters = self.waiters.lock().unwrap_or_else(|e| e.into_inner());
+        if !waiters.iter().any(|waiter| waiter.will_notify_current()) {
+            waiters.push(task::current());
+        }
+        self.has_waiters.store(true, Ordering::SeqCst);
+    }
+}
+
+/// Snapshot of the statistics of a queue.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct QueueStats {
+    pub capacity: usize,
+    pub depth: usize,
+    pub high_water: usize,
+    pub total: usize,
+    pub full: usize,
+}
+
+/// Error returned by `QueueSender::try_send`.
+#[derive(Debug, PartialEq, Eq)]
+pub enum TrySendError {
+    /// The queue is full. Nothing has been sent.
+    Full,
+    /// The receiver has been dropped.
+    Disconnected,
+}
+
+/// The sending end of a queue.
+pub struct QueueSender<T> {
+    tx: mpsc::UnboundedSender<T>,
+    state: Arc<QueueState>,
+}
+
+/// The receiving end of a queue.
+pub struct QueueReceiver<T> {
+    rx: mpsc::UnboundedReceiver<T>,
+    state: Arc<QueueState>,
+}
+
+/// Create a queue with the specified capacity (`0` for unbounded).
+pub fn channel<T>(capacity: usize) -> (QueueSender<T>, QueueReceiver<T>) {
+    let (tx, rx) = mpsc::unbounded();
+    let state = Arc::new(QueueState {
+        capacity,
+        depth: AtomicUsize::new(0),
+        high_water: AtomicUsize::new(0),
+        total: AtomicUsize::new(0),
+        full: AtomicUsize::new(0),
+        closed: AtomicBool::new(false),
+        has_waiters: AtomicBool::new(false),
+        waiters: Mutex::new(Vec::new()),
+    });
+    (
+        QueueSender { tx, state: state.clone() },
+        QueueReceiver { rx, state },
+    )
+}
+
+fn stats(state: &QueueState) -> QueueStats {
+    QueueStats {
+        capacity: state.capacity,
+        depth: state.depth.load(Ordering::SeqCst),
+        high_water: state.high_water.load(Ordering::Relaxed),
+        total: state.total.load(Ordering::Relaxed),
+        full: state.full.load(Ordering::Relaxed),
+    }
+}
+
+impl<T> QueueSender<T> {
+    /// Enqueue a message without waiting.
+    pub fn try_send(&self, msg: T) -> Result<(), TrySendError> {
+        self.try_send_or_return(msg).map_err(|(e, _)| e)
+    }
+
+    /// Enqueue a message without waiting, handing it back if that fails.
+    pub fn try_send_or_return(&self, msg: T) -> Result<(), (TrySendError, T)> {
+        if let Err(e) = self.state.try_reserve(1) {
+            if e == TrySendError::Full {
+                self.state.full.fetch_add(1, Ordering::Relaxed);
+            }
+            return Err((e, msg));
+        }
+        self.tx.unbounded_send(msg).map_err(|e| {
+            self.state.release(1);
+            (TrySendError::Disconnected, e.into_inner())
+        })
+    }
+
+    /// Enqueue all messages or none of them, without waiting.
+    ///
+    /// Note: More messages than the capacity never fit, check against
+    /// `capacity` first.
+    pub fn try_send_all(&self, msgs: Vec<T>) -> Result<(), TrySendError> {
+        if let Err(e) = self.state.try_reserve(msgs.len()) {
+            if e == TrySendError::Full {
+                self.state.full.fetch_add(1, Ordering::Relaxed);
+            }
+            return Err(e);
+        }
+        let count = msgs.len();
+        for (i, msg) in msgs.into_iter().enumerate() {
+            if self.tx.unbounded_send(msg).is_err() {
+                self.state.release(count - i);
+                return Err(TrySendError::Disconnected);
+            }
+        }
+        Ok(())
+    }
+
+    /// The maximum number of queued messages, `0` if unbounded.
+    pub fn capacity(&self) -> usize {
+        self.state.capacity
+    }
+
+    pub fn stats(&self) -> QueueStats {
+        stats(&self.state)
+    }
+}
+
+impl<T> Clone for QueueSender<T> {
+    fn clone(&self) -> Self {
+        QueueSender { tx: self.tx.clone(), state: self.state.clone() }
+    }
+}
+
+impl<T> fmt::Debug for QueueSender<T> {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_struct("QueueSender").field("state", &self.state).finish()
+    }
+}
+
+impl<T> Sink for QueueSender<T> {
+    type SinkItem = T;
+    type SinkError = TrySendError;
+
+    fn start_send(&mut self, msg: T) -> StartSend<T, TrySendError> {
+        let reserved = match self.state.try_reserve(1) {
+            Err(TrySendError::Full) => {
+                // Register first and check again, so that a message taken out
+                // of the queue (or the receiver being dropped) in between
+                // cannot be missed.
+                self.state.register();
+                self.state.try_reserve(1)
+            },
+            reserved => reserved,
+        };
+        match reserved {
+            Ok(()) => {},
+            Err(TrySendError::Full) => {
+                self.state.full.fetch_add(1, Ordering::Relaxed);
+                return Ok(AsyncSink::NotReady(msg));
+            },
+            Err(e) => return Err(e),
+        }
+        match self.tx.unbounded_send(msg) {
+            Ok(_) => Ok(AsyncSink::Ready),
+            Err(_) => {
+                self.state.release(1);
+                Err(TrySendError::Disconnected)
+            },
+        }
+    }
+
+    fn poll_complete(&mut self) -> Poll<(), TrySendError> {
+        Ok(Async::Ready(()))
+    }
+}
+
+impl<T> QueueReceiver<T> {
+    pub fn stats(&self) -> QueueStats {
+        stats(&self.state)
+    }
+}
+
+impl<T> Drop for QueueReceiver<T> {
+    fn drop(&mut self) {
+        self.state.close();
+    }
+}
+
+impl<T> fmt::Debug for QueueReceiver<T> {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_struct("QueueReceiver").field("state", &self.state).finish()
+    }
+}
+
+impl<T> Stream for QueueReceiver<T> {
+    type Item = T;
+    type Error = ();
+
+    fn poll(&mut self) -> Poll<Option<T>, ()> {
+        let res = self.rx.poll();
+        if let Ok(Async::Ready(Some(_))) = res {
+            self.state.release(1);
+        }
+        res
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::thread;
+    use std::time::Duration;
+
+    use saltyrtc_client::dep::futures::{Future, stream};
+
+    use super::*;
+
+    #[test]
+    fn test_try_send_full() {
+        let (tx, mut rx) = channel::<u32>(2);
+        assert_eq!(tx.try_send(1), Ok(()));
+        assert_eq!(tx.try_send_all(vec![2, 3]), Err(TrySendError::Full));
+        assert_eq!(tx.try_send(2), Ok(()));
+        assert_eq!(tx.try_send(3), Err(TrySendError::Full));
+        assert_eq!(tx.stats(), QueueStats { capacity: 2, depth: 2, high_water: 2, total: 2, full: 2 });
+
+        // Receiving makes room again
+        assert_eq!(rx.by_ref().wait().next(), Some(Ok(1)));
+        assert_eq!(tx.try_send(3), Ok(()));
+        assert_eq!(rx.stats().depth, 2);
+
+        drop(rx);
+        assert_eq!(tx.try_send(4), Err(TrySendError::Disconnected));
+        assert_eq!(tx.try_send_all(vec![4]), Err(TrySendError::Disconnected));
+        assert_eq!(tx.stats().full, 2);
+    }
+
+    #[test]
+    fn test_try_send_or_return() {
+        let (tx, rx) = channel::<u32>(1);
+        assert_eq!(tx.try_send_or_return(1), Ok(()));
+        assert_eq!(tx.try_send_or_return(2), Err((TrySendError::Full, 2)));
+        drop(rx);
+        let (tx, rx) = channel::<u32>(1);
+        drop(rx);
+        assert_eq!(tx.try_send_or_return(3), Err((TrySendError::Disconnected, 3)));
+        assert_eq!(tx.stats().depth, 0);
+    }
+
+    #[test]
+    fn test_unbounded() {
+        let (tx, rx) = channel::<u32>(0);
+        for i in 0..1000 {
+            tx.try_send(i).unwrap();
+        }
+        assert_eq!(rx.stats().high_water, 1000);
+        drop(rx);
+        assert_eq!(tx.try_send(0), Err(TrySendError::Disconnected));
+        assert_eq!(tx.stats().depth, 1000);
+    }
+
+    /// A sender waiting on a full queue must be woken up with an error once
+    /// the receiver has been dropped.
+    #[test]
+    fn test_waiting_sender_disconnected() {
+        let (tx, rx) = channel::<u32>(1);
+        tx.try_send(1).unwrap();
+
+        let (result_tx, result_rx) = std::sync::mpsc::channel();
+        let sender = thread::spawn(move || {
+            result_tx.send(tx.send(2).wait().err()).unwrap();
+        });
+
+        // Let the sender block on the full queue before dropping the receiver
+        thread::sleep(Duration::from_millis(50));
+        assert!(result_rx.try_recv().is_err());
+        drop(rx);
+        assert_eq!(
+            result_rx.recv_timeout(Duration::from_secs(5)),
+            Ok(Some(TrySendError::Disconnected)),
+        );
+        sender.join().unwrap();
+    }
+
+    /// Several clones of a sender wait on a full queue at the same time. Each
+    /// of them must be woken up eventually.
+    #[test]
+    fn test_multiple_waiting_senders() {
+        let senders = 8;
+        let count = 200u32;
+        let (tx, mut rx) = channel::<u32>(1);
+
+        let handles: Vec<_> = (0..senders)
+            .map(|_| {
+                let tx = tx.clone();
+                thread::spawn(move || {
+                    tx.send_all(stream::iter_ok::<_, TrySendError>(0..count)).wait().unwrap();
+                })
+            })
+            .collect();
+        drop(tx);
+
+        // Let all senders block on the full queue before receiving
+        thread::sleep(Duration::from_millis(50));
+        let received = rx.by_ref().wait().count();
+        for handle in handles {
+            handle.join().unwrap();
+        }
+
+        assert_eq!(received, senders * count as usize);
+        let stats = rx.stats();
+        assert!(stats.high_water <= 1);
+        assert!(stats.full > 0);
+    }
+
+    /// A fast sender floods a slow reader. The sender must be paused
+    /// instead of the queue growing beyond its capacity.
+    #[test]
+    fn test_flood_slow_reader() {
+        let capacity = 16;
+        let count = 2000u32;
+        let (tx, mut rx) = channel::<u32>(capacity);
+
+        let sender = thread::spawn(move || {
+            tx.send_all(stream::iter_ok::<_, TrySendError>(0..count)).wait().unwrap();
+        });
+
+        let mut expected = 0;
+        for msg in rx.by_ref().wait() {
+            assert_eq!(msg, Ok(expected));
+            expected += 1;
+            if expected % 100 == 0 {
+                thread::sleep(Duration::from_millis(5));
+            }
+        }
+        sender.join().unwrap();
+
+        let stats = rx.stats();
+        assert_eq!(expected, count);
+        assert_eq!(stats.total, count as usize);
+        assert_eq!(stats.depth, 0);
+        assert!(stats.high_water <= capacity);
+        assert!(stats.full > 0);
+    }
+}
@@ -0,0 +1,133 @@
+use std::sync::atomic::{AtomicBool, Ordering};
+
+use libc::{self, c_int, c_void};
+use saltyrtc_client::dep::futures::executor::Notify;
+
+/// A readiness notifier backed by a non-blocking pipe.
+///
+/// The notifier is used as the notification target when polling a channel
+/// receiver. If the receiver is not ready, it registers the notifier and the
+/// next message (or the end of the stream) makes the read end of the pipe
+/// readable. This allows C callers to wait for many channels in a single
+/// `poll`/`epoll`/`kqueue` loop.
+///
+/// At most one byte is pending in the pipe at any time.
+#[derive(Debug)]
+pub struct Readiness {
+    read_fd: c_int,
+    write_fd: c_int,
+    pending: AtomicBool,
+}
+
+impl Readiness {
+    pub fn new() -> Result<Self, String> {
+        let mut fds: [c_int; 2] = [-1, -1];
+        if unsafe { libc::pipe(fds.as_mut_ptr()) } != 0 {
+            return Err(format!("Could not create pipe: {}", ::std::io::Error::last_os_error()));
+        }
+        let readiness = Readiness {
+            read_fd: fds[0],
+            write_fd: fds[1],
+            pending: AtomicBool::new(false),
+        };
+        for fd in &fds {
+            let ok = unsafe {
+                let flags = libc::fcntl(*fd, libc::F_GETFL);
+                flags != -1
+                    && libc::fcntl(*fd, libc::F_SETFL, flags | libc::O_NONBLOCK) != -1
+                    && libc::fcntl(*fd, libc::F_SETFD, libc::FD_CLOEXEC) != -1
+            };
+            if !ok {
+                return Err(format!("Could not configure pipe: {}", ::std::io::Error::last_os_error()));
+            }
+        }
+        Ok(readiness)
+    }
+
+    /// The file descriptor that becomes readable when the channel is ready.
+    pub fn fd(&self) -> c_int {
+        self.read_fd
+    }
+
+    /// Reset the notifier. This must be done *before* polling the channel,
+    /// so that no notification can get lost.
+    pub fn clear(&self) {
+        if self.pending.swap(false, Ordering::SeqCst) {
+            let mut buf = [0u8; 16];
+            loop {
+                let n = unsafe { libc::read(self.read_fd, buf.as_mut_ptr() as *mut c_void, buf.len()) };
+                if n <= 0 {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+impl Notify for Readiness {
+    fn notify(&self, _id: usize) {
+        if !self.pending.swap(true, Ordering::SeqCst) {
+            let byte = 1u8;
+            let n = unsafe { libc::write(self.write_fd, &byte as *const u8 as *const c_void, 1) };
+            if n != 1 {
+                warn!("Could not signal readiness: {}", ::std::io::Error::last_os_error());
+            }
+        }
+    }
+}
+
+impl Drop for Readiness {
+    fn drop(&mut self) {
+        unsafe {
+            libc::close(self.read_fd);
+            libc::close(self.write_fd);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::sync::Arc;
+
+    use saltyrtc_client::dep::futures::Async;
+    use saltyrtc_client::dep::futures::executor::{self, NotifyHandle};
+    use saltyrtc_client::dep::futures::sync::mpsc;
+
+    use super::*;
+
+    fn is_readable(readiness: &Readiness) -> bool {
+        let mut pfd = libc::pollfd { fd: readiness.fd(), events: libc::POLLIN, revents: 0 };
+        unsafe { libc::poll(&mut pfd, 1, 0) == 1 }
+    }
+
+    #[test]
+    fn test_notify_on_send_and_close() {
+        let readiness = Arc::new(Readiness::new().unwrap());
+        let handle = NotifyHandle::from(readiness.clone());
+        let (tx, mut rx) = mpsc::unbounded::<u8>();
+
+        // Not ready: The notifier is registered
+        readiness.clear();
+        let res = executor::spawn(&mut rx).poll_stream_notify(&handle, 0);
+        assert_eq!(res, Ok(Async::NotReady));
+        assert!(!is_readable(&readiness));
+
+        // Sending makes the fd readable
+        tx.unbounded_send(1).unwrap();
+        tx.unbounded_send(2).unwrap();
+        assert!(is_readable(&readiness));
+
+        // Clearing resets it
+        readiness.clear();
+        assert!(!is_readable(&readiness));
+        assert_eq!(executor::spawn(&mut rx).poll_stream_notify(&handle, 0), Ok(Async::Ready(Some(1))));
+        assert_eq!(executor::spawn(&mut rx).poll_stream_notify(&handle, 0), Ok(Async::Ready(Some(2))));
+        assert_eq!(executor::spawn(&mut rx).poll_stream_notify(&handle, 0), Ok(Async::NotReady));
+
+        // Dropping the sender makes the fd readable as well
+        ::std::mem::drop(tx);
+        assert!(is_readable(&readiness));
+        readiness.clear();
+        assert_eq!(executor::spawn(&mut rx).poll_stream_notify(&handle, 0), Ok(Async::Ready(None)));
+    }
+}
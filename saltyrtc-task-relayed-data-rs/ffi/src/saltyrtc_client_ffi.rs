@@ -17,7 +17,9 @@ use std::convert::TryInto;
 use std::ffi::CString;
 use std::ptr;
 use std::slice;
-use std::sync::Mutex;
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::Duration;
 
 use anyhow::Context;
 use libc::c_char;
@@ -30,6 +32,7 @@ use saltyrtc_client::crypto::{KeyPair, PrivateKey};
 use tokio_core::reactor::{Core, Remote};
 
 use constants::*;
+use log_ring::LogRing;
 
 
 // *** TYPES *** //
@@ -57,8 +60,14 @@ pub enum salty_client_t {}
 
 lazy_static! {
     static ref LOG_HANDLE: Mutex<Option<LogHandle>> = Mutex::new(None);
+    static ref LOG_RING: Mutex<Option<Arc<LogRing>>> = Mutex::new(None);
 }
 
+/// Maximum time the thread of an asynchronous callback logger waits for new
+/// log records. It is woken as soon as a record is added, so this is only a
+/// fallback.
+const LOG_DRAIN_INTERVAL_MS: u64 = 1000;
+
 fn u8_to_levelfilter(level: u8) -> Option<LevelFilter> {
     Some(match level {
         LEVEL_TRACE => LevelFilter::Trace,
@@ -86,6 +95,7 @@ pub type LogFunction = unsafe extern "C" fn(level: u8, target: *const c_char, me
 enum LogConfig {
     Console(LevelFilter),
     Callback(LogFunction, LevelFilter),
+    Ring(Arc<LogRing>, LevelFilter),
 }
 
 #[derive(Debug)]
@@ -116,6 +126,25 @@ impl Append for CallbackAppender {
     fn flush(&self) {}
 }
 
+/// Appender handing off log records to a ring buffer without blocking.
+///
+/// The appender is only called for enabled records, so a record is only
+/// formatted if its level is enabled and there is room in the ring buffer.
+#[derive(Debug)]
+struct RingAppender {
+    ring: Arc<LogRing>,
+}
+
+impl Append for RingAppender {
+    fn append(&self, record: &log::Record<'_>) -> anyhow::Result<()> {
+        // A full ring buffer is not an error, the record is counted as dropped
+        self.ring.push(level_to_u8(record.level()), record.target(), record.args());
+        Ok(())
+    }
+
+    fn flush(&self) {}
+}
+
 fn make_log_config(config: LogConfig) -> Result<Config, String> {
     // Log format
     let format = "{d(%Y-%m-%dT%H:%M:%S%.3f)} [{l:<5}] {m} (({f}:{L})){n}";
@@ -131,6 +160,9 @@ fn make_log_config(config: LogConfig) -> Result<Config, String> {
         LogConfig::Callback(func, level) => {
             (Box::new(CallbackAppender::new(func)) as Box<dyn Append>, level)
         }
+        LogConfig::Ring(ring, level) => {
+            (Box::new(RingAppender { ring }) as Box<dyn Append>, level)
+        }
     };
 
     // Create logging config object
@@ -313,6 +345,238 @@ pub extern "C" fn salty_log_init_callback(callback: LogFunction, level: u8) -> b
     true
 }
 
+/// Initialize logging into a ring buffer and return the ring buffer.
+fn init_ring_logger(fn_name: &str, level: u8, capacity: u32) -> Option<Arc<LogRing>> {
+    // Get access to static log handle
+    let mut handle_opt = match LOG_HANDLE.lock() {
+        Ok(handle_opt) => handle_opt,
+        Err(e) => {
+            eprintln!("{}: Could not get access to static logger mutex: {}", fn_name, e);
+            return None;
+        }
+    };
+    if handle_opt.is_some() {
+        eprintln!("{}: A logger is already initialized", fn_name);
+        return None;
+    }
+
+    // Log level
+    let level_filter = match u8_to_levelfilter(level) {
+        Some(lf) => lf,
+        None => {
+            eprintln!("{}: Invalid log level: {}", fn_name, level);
+            return None;
+        }
+    };
+    if capacity == 0 {
+        eprintln!("{}: Capacity must be at least 1", fn_name);
+        return None;
+    }
+
+    // Config
+    let ring = Arc::new(LogRing::new(capacity as usize));
+    let config = match make_log_config(LogConfig::Ring(ring.clone(), level_filter)) {
+        Ok(config) => config,
+        Err(e) => {
+            eprintln!("{}: {}", fn_name, e);
+            return None;
+        }
+    };
+
+    // Initialize logger
+    let handle = match init_config(config) {
+        Ok(handle) => handle,
+        Err(e) => {
+            eprintln!("{}: Could not initialize logger: {}", fn_name, e);
+            return None;
+        }
+    };
+
+    // Update static logger and ring buffer instances
+    *handle_opt = Some(handle);
+    match LOG_RING.lock() {
+        Ok(mut ring_opt) => *ring_opt = Some(ring.clone()),
+        Err(e) => {
+            eprintln!("{}: Could not get access to static ring buffer mutex: {}", fn_name, e);
+            return None;
+        }
+    }
+
+    Some(ring)
+}
+
+/// Initialize logging into a ring buffer with log messages up to the specified log level.
+///
+/// Logging never blocks: The log records are stored in a ring buffer and
+/// must be pulled with `salty_log_ring_drain`. If the ring buffer is full,
+/// new records are dropped and counted (see `salty_log_ring_dropped`).
+///
+/// Messages longer than 511 bytes are truncated.
+///
+/// Parameters:
+///     level (uint8_t, copied):
+///         The log level, must be in the range 0 (TRACE) to 5 (OFF).
+///         See `LEVEL_*` constants for reference.
+///     capacity (uint32_t, copied):
+///         The number of log records the ring buffer can hold. This is
+///         rounded up to the next power of two.
+/// Returns:
+///     A boolean indicating whether logging was setup successfully.
+///     If setting up the logger failed, an error message will be written to stdout.
+#[no_mangle]
+pub extern "C" fn salty_log_init_ring(level: u8, capacity: u32) -> bool {
+    init_ring_logger("salty_log_init_ring", level, capacity).is_some()
+}
+
+/// Initialize logging with a callback function that is called on a separate thread.
+///
+/// Like `salty_log_init_ring`, the log records are stored in a ring buffer
+/// without blocking. A logging thread drains the ring buffer and calls the
+/// callback function for every record, so a slow callback does not stall
+/// the event loop.
+///
+/// Parameters:
+///     callback:
+///         Pointer to a function with the signature
+///         `(uint8_t level, char* target, char* message)`.
+///         The strings are only valid during the call.
+///     level (uint8_t, copied):
+///         The log level, must be in the range 0 (TRACE) to 5 (OFF).
+///         See `LEVEL_*` constants for reference.
+///     capacity (uint32_t, copied):
+///         The number of log records the ring buffer can hold. This is
+///         rounded up to the next power of two.
+/// Returns:
+///     A boolean indicating whether logging was setup successfully.
+///     If setting up the logger failed, an error message will be written to stdout.
+#[no_mangle]
+pub extern "C" fn salty_log_init_callback_async(callback: LogFunction, level: u8, capacity: u32) -> bool {
+    let ring = match init_ring_logger("salty_log_init_callback_async", level, capacity) {
+        Some(ring) => ring,
+        None => return false,
+    };
+
+    // The logger cannot be removed again, so the thread runs until the end
+    // of the process.
+    let thread = thread::Builder::new()
+        .name("salty-log".into())
+        .spawn(move || {
+            ring.set_consumer();
+            loop {
+                let count = ring.drain(usize::max_value(), |record| unsafe {
+                    callback(record.level(), record.target_ptr(), record.message_ptr());
+                });
+                if count == 0 {
+                    ring.wait(Duration::from_millis(LOG_DRAIN_INTERVAL_MS));
+                }
+            }
+        });
+    if let Err(e) = thread {
+        eprintln!("salty_log_init_callback_async: Could not start logging thread: {}", e);
+        return false;
+    }
+
+    // Success!
+    true
+}
+
+/// Change the log level of the ring buffer logger.
+///
+/// This works for loggers initialized with `salty_log_init_ring` and
+/// `salty_log_init_callback_async`. Records that are already in the ring
+/// buffer are kept.
+///
+/// Parameters:
+///     level (uint8_t, copied):
+///         The log level, must be in the range 0 (TRACE) to 5 (OFF).
+///         See `LEVEL_*` constants for reference.
+/// Returns:
+///     A boolean indicating whether logging was updated successfully.
+///     If updating the logger failed, an error message will be written to stdout.
+#[no_mangle]
+pub extern "C" fn salty_log_change_level_ring(level: u8) -> bool {
+    // Log level
+    let level_filter = match u8_to_levelfilter(level) {
+        Some(lf) => lf,
+        None => {
+            eprintln!("salty_log_change_level_ring: Invalid log level: {}", level);
+            return false;
+        }
+    };
+
+    // Get access to static log handle and ring buffer
+    let mut handle_opt = match LOG_HANDLE.lock() {
+        Ok(opt_handle) => opt_handle,
+        Err(e) => {
+            eprintln!("salty_log_change_level_ring: Could not get access to static logger mutex: {}", e);
+            return false;
+        }
+    };
+    let ring = match LOG_RING.lock().ok().and_then(|ring_opt| ring_opt.clone()) {
+        Some(ring) => ring,
+        None => {
+            eprintln!("salty_log_change_level_ring: Ring buffer logger is not initialized");
+            return false;
+        }
+    };
+    if handle_opt.is_none() {
+        eprintln!("salty_log_change_level_ring: Logger is not initialized");
+        return false;
+    }
+
+    // Config
+    let config = match make_log_config(LogConfig::Ring(ring, level_filter)) {
+        Ok(config) => config,
+        Err(e) => {
+            eprintln!("salty_log_change_level_ring: {}", e);
+            return false;
+        }
+    };
+
+    // Update handle
+    handle_opt.as_mut().unwrap().set_config(config);
+
+    // Success!
+    true
+}
+
+/// Pull log records out of the ring buffer.
+///
+/// The callback function is called on the calling thread for every record,
+/// oldest first.
+///
+/// Parameters:
+///     callback:
+///         Pointer to a function with the signature
+///         `(uint8_t level, char* target, char* message)`.
+///         The strings are only valid during the call.
+///     max_records (uint32_t, copied):
+///         The maximum number of records to pull.
+/// Returns:
+///     The number of records passed to the callback function. If no ring
+///     buffer logger is initialized, `0` is returned.
+#[no_mangle]
+pub extern "C" fn salty_log_ring_drain(callback: LogFunction, max_records: u32) -> u32 {
+    let ring = match LOG_RING.lock().ok().and_then(|ring_opt| ring_opt.clone()) {
+        Some(ring) => ring,
+        None => return 0,
+    };
+    ring.drain(max_records as usize, |record| unsafe {
+        callback(record.level(), record.target_ptr(), record.message_ptr());
+    }) as u32
+}
+
+/// Return the number of log records that were dropped because the ring
+/// buffer was full.
+///
+/// If no ring buffer logger is initialized, `0` is returned.
+#[no_mangle]
+pub extern "C" fn salty_log_ring_dropped() -> u64 {
+    LOG_RING.lock().ok()
+        .and_then(|ring_opt| ring_opt.as_ref().map(|ring| ring.dropped() as u64))
+        .unwrap_or(0)
+}
+
 
 // *** KEY PAIRS *** //
 
@@ -0,0 +1,440 @@
+/**
+ * C test: Backpressure of a bounded incoming channel.
+ *
+ * An initiator (in a child process) floods a responder (in this process)
+ * with large messages through a SaltyRTC server while the responder does
+ * not receive any of them. The responder must stop reading from its socket
+ * instead of buffering the messages, so its memory usage has to stay bounded.
+ * Messages sent by the responder while it is stalled must still reach the
+ * initiator. Afterwards, all messages must be received in order.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../saltyrtc_task_relayed_data_ffi.h"
+
+
+/**
+ * Number and payload length of the messages sent by the initiator (128 MiB
+ * in total).
+ */
+#define MSG_COUNT 2048
+#define MSG_PAYLOAD_LEN (64 * 1024)
+
+/**
+ * Number of messages sent by the responder while it is stalled.
+ */
+#define REPLY_COUNT 4
+
+/**
+ * Capacity of the responder's incoming channel.
+ */
+#define INCOMING_CAPACITY 16
+
+/**
+ * How long the responder does not receive any messages.
+ */
+#define STALL_MS 3000
+
+/**
+ * Maximum growth of the responder's peak memory usage while stalled.
+ */
+#define MAX_GROWTH_BYTES (32 * 1024 * 1024)
+
+/**
+ * Receive timeout.
+ */
+#define TIMEOUT_MS 30000
+
+/**
+ * Connection parameters.
+ */
+static const char *host = "localhost";
+static uint16_t port = 8765;
+static uint8_t *ca_cert = NULL;
+static uint32_t ca_cert_len = 0;
+
+static void sleep_ms(long ms) {
+    const struct timespec delay = { ms / 1000, (ms % 1000) * 1000000 };
+    nanosleep(&delay, NULL);
+}
+
+/**
+ * Return the peak resident set size of this process in bytes.
+ */
+static uint64_t peak_rss_bytes(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+/**
+ * Read a DER formatted CA certificate.
+ */
+static bool read_ca_cert(const char *path) {
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL) {
+        return false;
+    }
+    long len = -1;
+    if (fseek(fd, 0, SEEK_END) == 0) {
+        len = ftell(fd);
+    }
+    if (len > 0 && fseek(fd, 0, SEEK_SET) == 0) {
+        ca_cert = malloc((size_t)len);
+        if (ca_cert != NULL && fread(ca_cert, (size_t)len, 1, fd) != 1) {
+            free(ca_cert);
+            ca_cert = NULL;
+        }
+    }
+    fclose(fd);
+    ca_cert_len = (uint32_t)len;
+    return ca_cert != NULL;
+}
+
+/**
+ * Read or write exactly `len` bytes from or to a pipe.
+ */
+static bool read_all(int fd, void *buf, size_t len) {
+    uint8_t *bytes = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, bytes, len);
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * Wait until a pipe is readable, at most `timeout_ms` milliseconds.
+ */
+static bool wait_readable(int fd, int timeout_ms) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, timeout_ms) == 1;
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *bytes = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, bytes, len);
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * Initialize a client, start its connection on the pool and wait for the
+ * peer handshake.
+ */
+static bool connect_client(const salty_event_loop_pool_t *pool, uint32_t worker,
+                           const salty_relayed_data_client_ret_t *client,
+                           const salty_channel_event_rx_t **event_rx) {
+    salty_client_init_ret_t init_ret = salty_client_init_pooled(
+        host, port, client->client, 10, ca_cert, ca_cert_len);
+    if (init_ret.success != INIT_OK) {
+        printf("    ERROR: Could not initialize connection: %d\n", init_ret.success);
+        return false;
+    }
+    *event_rx = init_ret.event_rx;
+    salty_client_connect_success_t connect_success = salty_client_connect_pooled(
+        init_ret.handshake_future,
+        client->client,
+        pool,
+        worker,
+        init_ret.event_tx,
+        client->sender_rx,
+        client->disconnect_rx
+    );
+    if (connect_success != CONNECT_OK) {
+        printf("    ERROR: Could not start connection: %d\n", connect_success);
+        return false;
+    }
+
+    uint32_t timeout_ms = TIMEOUT_MS;
+    while (true) {
+        salty_client_recv_event_ret_t event_ret = salty_client_recv_event(*event_rx, &timeout_ms);
+        if (event_ret.success != RECV_OK) {
+            printf("    ERROR: Waiting for peer handshake failed: %d\n", event_ret.success);
+            return false;
+        }
+        bool done = event_ret.event->event_type == EVENT_PEER_HANDSHAKE_COMPLETED;
+        salty_client_recv_event_ret_free(event_ret);
+        if (done) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Initiator (child process): Hand the public key and the auth token to the
+ * responder, then send all messages as fast as possible, receive the replies
+ * the responder sends while stalled and wait until the responder is done.
+ */
+static int run_initiator(int to_responder, int from_responder) {
+    const salty_event_loop_pool_t *pool = salty_event_loop_pool_new(1);
+    const salty_keypair_t *keypair = salty_keypair_new();
+    uint8_t credentials[64];
+    memcpy(credentials, salty_keypair_public_key(keypair), 32);
+    uint32_t worker = salty_event_loop_pool_next_worker(pool);
+    salty_relayed_data_client_ret_t initiator = salty_relayed_data_initiator_new(
+        keypair, salty_event_loop_pool_get_remote(pool, worker), 0, NULL, NULL);
+    if (initiator.success != OK) {
+        printf("    ERROR: Could not create initiator: %d\n", initiator.success);
+        return EXIT_FAILURE;
+    }
+    memcpy(credentials + 32, salty_relayed_data_client_auth_token(initiator.client), 32);
+    if (!write_all(to_responder, credentials, sizeof(credentials))) {
+        return EXIT_FAILURE;
+    }
+    const salty_channel_event_rx_t *event_rx = NULL;
+    if (!connect_client(pool, worker, &initiator, &event_rx)) {
+        return EXIT_FAILURE;
+    }
+
+    // Every message is a msgpack bin 32 value with its index in front
+    uint8_t *msg = malloc(MSG_PAYLOAD_LEN + 5);
+    if (msg == NULL) {
+        return EXIT_FAILURE;
+    }
+    msg[0] = 0xc6;
+    msg[1] = (uint8_t)(MSG_PAYLOAD_LEN >> 24);
+    msg[2] = (uint8_t)(MSG_PAYLOAD_LEN >> 16);
+    msg[3] = (uint8_t)(MSG_PAYLOAD_LEN >> 8);
+    msg[4] = (uint8_t)MSG_PAYLOAD_LEN;
+    memset(msg + 5, 0x42, MSG_PAYLOAD_LEN);
+    for (uint32_t i = 0; i < MSG_COUNT; i++) {
+        memcpy(msg + 5, &i, sizeof(i));
+        salty_client_send_success_t result;
+        while ((result = salty_client_send_application_bytes(
+                initiator.sender_tx, msg, MSG_PAYLOAD_LEN + 5)) == SEND_WOULD_BLOCK) {
+            sleep_ms(1);
+        }
+        if (result != SEND_OK) {
+            printf("    ERROR: Sending message %u failed: %d\n", i, result);
+            return EXIT_FAILURE;
+        }
+    }
+    free(msg);
+
+    // Receive the replies and acknowledge them
+    for (uint32_t i = 0; i < REPLY_COUNT; i++) {
+        uint32_t timeout_ms = TIMEOUT_MS;
+        salty_client_recv_msg_ret_t msg_ret = salty_client_recv_msg(initiator.receiver_rx, &timeout_ms);
+        if (msg_ret.success != RECV_OK) {
+            printf("    ERROR: Receiving reply %u failed: %d\n", i, msg_ret.success);
+            return EXIT_FAILURE;
+        }
+        bool valid = msg_ret.msg->msg_type == MSG_APPLICATION && msg_ret.msg->msg_bytes_len == 3
+            && msg_ret.msg->msg_bytes[2] == i;
+        salty_client_recv_msg_ret_free(msg_ret);
+        if (!valid) {
+            printf("    ERROR: Expected reply %u\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    uint8_t ack = 1;
+    if (!write_all(to_responder, &ack, 1)) {
+        return EXIT_FAILURE;
+    }
+
+    // Stay connected until the responder has received everything
+    uint8_t done;
+    if (!read_all(from_responder, &done, 1)) {
+        return EXIT_FAILURE;
+    }
+    salty_client_disconnect(initiator.disconnect_tx, 1001);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Responder (this process): Connect with a bounded incoming channel, stall
+ * while the initiator floods it and then receive all messages.
+ */
+static bool run_responder(int from_initiator) {
+    uint8_t credentials[64];
+    if (!read_all(from_initiator, credentials, sizeof(credentials))) {
+        printf("    ERROR: Could not read the initiator's credentials\n");
+        return false;
+    }
+    const salty_event_loop_pool_t *pool = salty_event_loop_pool_new(1);
+    uint32_t worker = salty_event_loop_pool_next_worker(pool);
+    salty_channel_capacities_t capacities = { INCOMING_CAPACITY, INCOMING_CAPACITY };
+    salty_relayed_data_client_ret_t responder = salty_relayed_data_responder_new_bounded(
+        salty_keypair_new(), salty_event_loop_pool_get_remote(pool, worker), 0,
+        credentials, credentials + 32, NULL, capacities);
+    if (responder.success != OK) {
+        printf("    ERROR: Could not create responder: %d\n", responder.success);
+        return false;
+    }
+    const salty_channel_event_rx_t *event_rx = NULL;
+    if (!connect_client(pool, worker, &responder, &event_rx)) {
+        return false;
+    }
+
+    // Stall while the initiator floods the responder
+    uint64_t rss_before = peak_rss_bytes();
+    sleep_ms(STALL_MS);
+    uint64_t growth = peak_rss_bytes() - rss_before;
+    salty_channel_stats_t stats = salty_channel_receiver_rx_stats(responder.receiver_rx);
+    printf("  Stalled: %llu B peak memory growth, %llu queued messages\n",
+           (unsigned long long)growth, (unsigned long long)stats.depth);
+    if (growth > MAX_GROWTH_BYTES) {
+        printf("    ERROR: Memory grew by more than %d bytes\n", MAX_GROWTH_BYTES);
+        return false;
+    }
+    if (stats.high_water > INCOMING_CAPACITY) {
+        printf("    ERROR: Incoming channel exceeded its capacity\n");
+        return false;
+    }
+
+    // Sending must not wait for the incoming channel to have room again
+    for (uint8_t i = 0; i < REPLY_COUNT; i++) {
+        // A msgpack bin 8 value with a single byte
+        const uint8_t reply[3] = { 0xc4, 1, i };
+        salty_client_send_success_t result;
+        while ((result = salty_client_send_application_bytes(
+                responder.sender_tx, reply, sizeof(reply))) == SEND_WOULD_BLOCK) {
+            sleep_ms(1);
+        }
+        if (result != SEND_OK) {
+            printf("    ERROR: Sending reply %u failed: %d\n", i, result);
+            return false;
+        }
+    }
+    uint8_t ack;
+    if (!wait_readable(from_initiator, TIMEOUT_MS) || !read_all(from_initiator, &ack, 1)) {
+        printf("    ERROR: Replies were not received while stalled\n");
+        return false;
+    }
+    printf("  Sent %d replies while stalled\n", REPLY_COUNT);
+
+    // Receive all messages in order
+    for (uint32_t i = 0; i < MSG_COUNT; i++) {
+        uint32_t timeout_ms = TIMEOUT_MS;
+        salty_client_recv_msg_ret_t msg_ret = salty_client_recv_msg(responder.receiver_rx, &timeout_ms);
+        if (msg_ret.success != RECV_OK) {
+            printf("    ERROR: Receiving message %u failed: %d\n", i, msg_ret.success);
+            return false;
+        }
+        uint32_t index = UINT32_MAX;
+        bool valid = msg_ret.msg->msg_type == MSG_APPLICATION && msg_ret.msg->msg_bytes_len == MSG_PAYLOAD_LEN + 5;
+        if (valid) {
+            memcpy(&index, msg_ret.msg->msg_bytes + 5, sizeof(index));
+        }
+        salty_client_recv_msg_ret_free(msg_ret);
+        if (index != i) {
+            printf("    ERROR: Expected message %u\n", i);
+            return false;
+        }
+    }
+    printf("  Received %d messages\n", MSG_COUNT);
+
+    salty_client_disconnect(responder.disconnect_tx, 1001);
+    for (size_t i = 0; salty_event_loop_pool_connections(pool) > 0; i++) {
+        if (i >= 1000) {
+            printf("    ERROR: Connection did not end\n");
+            return false;
+        }
+        sleep_ms(10);
+    }
+    salty_relayed_data_client_free(responder.client);
+    salty_channel_receiver_rx_free(responder.receiver_rx);
+    salty_channel_sender_tx_free(responder.sender_tx);
+    salty_channel_event_rx_free(event_rx);
+    salty_event_loop_pool_free(pool);
+    return true;
+}
+
+/**
+ * Main program.
+ */
+int main(int argc, char *argv[]) {
+    // Parse arguments
+    int opt;
+    const char *ca_cert_path = "saltyrtc.der";
+    while ((opt = getopt(argc, argv, "h:p:c:")) != -1) {
+        switch (opt) {
+            case 'h':
+                host = optarg;
+                break;
+            case 'p':
+                port = (uint16_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                ca_cert_path = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-h HOST] [-p PORT] [-c CA_CERT]\n\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("START C BACKPRESSURE TEST\n");
+
+    if (!read_ca_cert(ca_cert_path)) {
+        printf("  ERROR: Could not read CA certificate `%s`\n", ca_cert_path);
+        return EXIT_FAILURE;
+    }
+
+    // Fork before the library is used, so that no threads are running
+    int to_responder[2];
+    int to_initiator[2];
+    if (pipe(to_responder) != 0 || pipe(to_initiator) != 0) {
+        printf("  ERROR: Could not create pipes\n");
+        return EXIT_FAILURE;
+    }
+    fflush(stdout);
+    pid_t initiator = fork();
+    if (initiator < 0) {
+        printf("  ERROR: Could not fork\n");
+        return EXIT_FAILURE;
+    }
+    if (initiator == 0) {
+        close(to_responder[0]);
+        close(to_initiator[1]);
+        _exit(run_initiator(to_responder[1], to_initiator[0]));
+    }
+    close(to_responder[1]);
+    close(to_initiator[0]);
+
+    bool ok = run_responder(to_responder[0]);
+    uint8_t done = 1;
+    if (!ok || !write_all(to_initiator[1], &done, 1)) {
+        kill(initiator, SIGTERM);
+    }
+    int status = 0;
+    waitpid(initiator, &status, 0);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+    free(ca_cert);
+
+    if (!ok) {
+        printf("  ERROR: Backpressure test failed\n");
+        return EXIT_FAILURE;
+    }
+    printf("END C BACKPRESSURE TEST\n");
+    return EXIT_SUCCESS;
+}
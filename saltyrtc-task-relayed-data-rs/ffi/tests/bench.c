@@ -0,0 +1,634 @@
+/**
+ * C benchmark: Relayed data end to end.
+ *
+ * Connects an initiator and a responder through a SaltyRTC server and
+ * measures the handshake latency as well as the one-way latency, the
+ * throughput and the allocations per message for different message sizes.
+ * Finally, a large message is streamed in chunks and the message throughput
+ * is measured at every log level of the asynchronous callback logger.
+ *
+ * The allocation counts are only available if the library was built with
+ * the `alloc-stats` feature.
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../saltyrtc_task_relayed_data_ffi.h"
+
+
+/**
+ * Number of handshakes used for the handshake latency.
+ */
+#define HANDSHAKE_ROUNDS 20
+
+/**
+ * Number of messages used for the one-way latency (per message size).
+ */
+#define LATENCY_ROUNDS 200
+
+/**
+ * Number of bytes sent for the throughput (per message size).
+ */
+#define THROUGHPUT_BYTES (64 * 1024 * 1024)
+
+/**
+ * Limits of the number of messages sent for the throughput.
+ */
+#define THROUGHPUT_MIN_MSGS 16
+#define THROUGHPUT_MAX_MSGS 10000
+
+/**
+ * Size of the streamed message and of its chunks (including the header).
+ */
+#define STREAM_BYTES (16 * 1024 * 1024)
+#define STREAM_CHUNK_SIZE (64 * 1024)
+
+/**
+ * Number of messages sent per log level.
+ */
+#define LOG_LEVEL_MSGS 10000
+
+/**
+ * Capacity of the log ring buffer.
+ */
+#define LOG_RING_CAPACITY 65536
+
+/**
+ * Receive timeout.
+ */
+#define TIMEOUT_MS 30000
+
+/**
+ * Connection parameters.
+ */
+static const char *host = "localhost";
+static uint16_t port = 8765;
+static uint8_t *ca_cert = NULL;
+static uint32_t ca_cert_len = 0;
+
+/**
+ * Number of log records passed to the log callback.
+ */
+static pthread_mutex_t log_records_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t log_records = 0;
+
+/**
+ * A connected initiator/responder pair.
+ */
+struct pair {
+    salty_relayed_data_client_ret_t initiator;
+    salty_relayed_data_client_ret_t responder;
+    const salty_channel_event_rx_t *initiator_events;
+    const salty_channel_event_rx_t *responder_events;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sort the samples and return the given percentile (0-100) in microseconds.
+ */
+static double percentile_us(uint64_t *samples, size_t count, size_t percentile) {
+    qsort(samples, count, sizeof(uint64_t), compare_u64);
+    size_t index = (count * percentile) / 100;
+    if (index >= count) {
+        index = count - 1;
+    }
+    return (double)samples[index] / 1000.0;
+}
+
+/**
+ * Read a DER formatted CA certificate.
+ */
+static bool read_ca_cert(const char *path) {
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL) {
+        return false;
+    }
+    long len = -1;
+    if (fseek(fd, 0, SEEK_END) == 0) {
+        len = ftell(fd);
+    }
+    if (len > 0 && fseek(fd, 0, SEEK_SET) == 0) {
+        ca_cert = malloc((size_t)len);
+        if (ca_cert != NULL && fread(ca_cert, (size_t)len, 1, fd) != 1) {
+            free(ca_cert);
+            ca_cert = NULL;
+        }
+    }
+    fclose(fd);
+    ca_cert_len = (uint32_t)len;
+    return ca_cert != NULL;
+}
+
+/**
+ * Initialize a client and start its connection on the pool.
+ */
+static bool start_client(const salty_event_loop_pool_t *pool, uint32_t worker,
+                         const salty_relayed_data_client_ret_t *client,
+                         const salty_channel_event_rx_t **event_rx) {
+    salty_client_init_ret_t init_ret = salty_client_init_pooled(
+        host, port, client->client, 10, ca_cert, ca_cert_len);
+    if (init_ret.success != INIT_OK) {
+        printf("    ERROR: Could not initialize connection: %d\n", init_ret.success);
+        return false;
+    }
+    *event_rx = init_ret.event_rx;
+    salty_client_connect_success_t connect_success = salty_client_connect_pooled(
+        init_ret.handshake_future,
+        client->client,
+        pool,
+        worker,
+        init_ret.event_tx,
+        client->sender_rx,
+        client->disconnect_rx
+    );
+    if (connect_success != CONNECT_OK) {
+        printf("    ERROR: Could not start connection: %d\n", connect_success);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Wait until the peer handshake of a client has been completed.
+ */
+static bool wait_peer_handshake(const salty_channel_event_rx_t *event_rx) {
+    uint32_t timeout_ms = TIMEOUT_MS;
+    while (true) {
+        salty_client_recv_event_ret_t event_ret = salty_client_recv_event(event_rx, &timeout_ms);
+        if (event_ret.success != RECV_OK) {
+            printf("    ERROR: Waiting for peer handshake failed: %d\n", event_ret.success);
+            return false;
+        }
+        bool done = event_ret.event->event_type == EVENT_PEER_HANDSHAKE_COMPLETED;
+        salty_client_recv_event_ret_free(event_ret);
+        if (done) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Connect an initiator and a responder and wait for the peer handshake.
+ */
+static bool connect_pair(const salty_event_loop_pool_t *pool, struct pair *pair) {
+    const salty_keypair_t *i_keypair = salty_keypair_new();
+    uint8_t i_pubkey[32];
+    memcpy(i_pubkey, salty_keypair_public_key(i_keypair), 32);
+    uint32_t worker = salty_event_loop_pool_next_worker(pool);
+    pair->initiator = salty_relayed_data_initiator_new(
+        i_keypair, salty_event_loop_pool_get_remote(pool, worker), 0, NULL, NULL);
+    if (pair->initiator.success != OK) {
+        printf("    ERROR: Could not create initiator: %d\n", pair->initiator.success);
+        return false;
+    }
+    uint8_t auth_token[32];
+    memcpy(auth_token, salty_relayed_data_client_auth_token(pair->initiator.client), 32);
+    if (!start_client(pool, worker, &pair->initiator, &pair->initiator_events)) {
+        return false;
+    }
+
+    worker = salty_event_loop_pool_next_worker(pool);
+    pair->responder = salty_relayed_data_responder_new(
+        salty_keypair_new(), salty_event_loop_pool_get_remote(pool, worker), 0, i_pubkey, auth_token, NULL);
+    if (pair->responder.success != OK) {
+        printf("    ERROR: Could not create responder: %d\n", pair->responder.success);
+        return false;
+    }
+    if (!start_client(pool, worker, &pair->responder, &pair->responder_events)) {
+        return false;
+    }
+
+    return wait_peer_handshake(pair->initiator_events) && wait_peer_handshake(pair->responder_events);
+}
+
+/**
+ * Disconnect both clients of a pair and free them.
+ */
+static bool disconnect_pair(const salty_event_loop_pool_t *pool, struct pair *pair) {
+    salty_client_disconnect(pair->initiator.disconnect_tx, 1001);
+    salty_client_disconnect(pair->responder.disconnect_tx, 1001);
+    for (size_t i = 0; salty_event_loop_pool_connections(pool) > 0; i++) {
+        if (i >= 1000) {
+            printf("    ERROR: Connections did not end\n");
+            return false;
+        }
+        const struct timespec delay = { 0, 10000000 };
+        nanosleep(&delay, NULL);
+    }
+    const salty_relayed_data_client_ret_t *clients[] = { &pair->initiator, &pair->responder };
+    for (size_t i = 0; i < 2; i++) {
+        salty_relayed_data_client_free(clients[i]->client);
+        salty_channel_receiver_rx_free(clients[i]->receiver_rx);
+        salty_channel_sender_tx_free(clients[i]->sender_tx);
+    }
+    salty_channel_event_rx_free(pair->initiator_events);
+    salty_channel_event_rx_free(pair->responder_events);
+    return true;
+}
+
+/**
+ * Handshake latency: Connect and disconnect pairs one after another.
+ */
+static bool bench_handshake(const salty_event_loop_pool_t *pool) {
+    uint64_t samples[HANDSHAKE_ROUNDS];
+    for (size_t i = 0; i < HANDSHAKE_ROUNDS; i++) {
+        struct pair pair;
+        uint64_t start = now_ns();
+        if (!connect_pair(pool, &pair)) {
+            return false;
+        }
+        samples[i] = now_ns() - start;
+        if (!disconnect_pair(pool, &pair)) {
+            return false;
+        }
+    }
+    printf("  Handshake (server + peer): p50 %.0f us, p99 %.0f us\n",
+           percentile_us(samples, HANDSHAKE_ROUNDS, 50),
+           percentile_us(samples, HANDSHAKE_ROUNDS, 99));
+    return true;
+}
+
+/**
+ * Encode `payload_len` bytes as a msgpack bin value into `buf`.
+ *
+ * Returns the offset of the payload.
+ */
+static size_t encode_bin(uint8_t *buf, size_t payload_len) {
+    size_t offset;
+    if (payload_len <= UINT8_MAX) {
+        buf[0] = 0xc4;
+        buf[1] = (uint8_t)payload_len;
+        offset = 2;
+    } else if (payload_len <= UINT16_MAX) {
+        buf[0] = 0xc5;
+        buf[1] = (uint8_t)(payload_len >> 8);
+        buf[2] = (uint8_t)payload_len;
+        offset = 3;
+    } else {
+        buf[0] = 0xc6;
+        buf[1] = (uint8_t)(payload_len >> 24);
+        buf[2] = (uint8_t)(payload_len >> 16);
+        buf[3] = (uint8_t)(payload_len >> 8);
+        buf[4] = (uint8_t)payload_len;
+        offset = 5;
+    }
+    memset(buf + offset, 0x42, payload_len);
+    return offset;
+}
+
+/**
+ * Receive one application message and check its length.
+ *
+ * If `sent_ns` is not `null`, it receives the timestamp at `offset`.
+ */
+static bool recv_msg(const struct pair *pair, size_t msg_len, size_t offset, uint64_t *sent_ns) {
+    uint32_t timeout_ms = TIMEOUT_MS;
+    salty_client_recv_msg_ret_t msg_ret = salty_client_recv_msg(pair->responder.receiver_rx, &timeout_ms);
+    if (msg_ret.success != RECV_OK) {
+        printf("    ERROR: Receiving message failed: %d\n", msg_ret.success);
+        return false;
+    }
+    bool valid = msg_ret.msg->msg_type == MSG_APPLICATION && msg_ret.msg->msg_bytes_len == msg_len;
+    if (valid && sent_ns != NULL) {
+        memcpy(sent_ns, msg_ret.msg->msg_bytes + offset, sizeof(uint64_t));
+    }
+    salty_client_recv_msg_ret_free(msg_ret);
+    if (!valid) {
+        printf("    ERROR: Invalid message received\n");
+    }
+    return valid;
+}
+
+/**
+ * One-way latency and throughput for one message size.
+ */
+static bool bench_size(const struct pair *pair, size_t payload_len) {
+    uint8_t *msg = malloc(payload_len + 5);
+    if (msg == NULL) {
+        printf("    ERROR: Could not allocate message\n");
+        return false;
+    }
+    size_t offset = encode_bin(msg, payload_len);
+    size_t msg_len = offset + payload_len;
+    const salty_channel_sender_tx_t *sender_tx = pair->initiator.sender_tx;
+
+    // One-way latency: One message at a time, timestamped by the sender
+    uint64_t samples[LATENCY_ROUNDS];
+    for (size_t i = 0; i < LATENCY_ROUNDS; i++) {
+        uint64_t sent_ns = now_ns();
+        memcpy(msg + offset, &sent_ns, sizeof(uint64_t));
+        if (salty_client_send_application_bytes(sender_tx, msg, (uint32_t)msg_len) != SEND_OK) {
+            printf("    ERROR: Sending message failed\n");
+            free(msg);
+            return false;
+        }
+        if (!recv_msg(pair, msg_len, offset, &sent_ns)) {
+            free(msg);
+            return false;
+        }
+        samples[i] = now_ns() - sent_ns;
+    }
+
+    // Throughput: Send all messages, then receive them
+    size_t count = THROUGHPUT_BYTES / payload_len;
+    if (count < THROUGHPUT_MIN_MSGS) {
+        count = THROUGHPUT_MIN_MSGS;
+    } else if (count > THROUGHPUT_MAX_MSGS) {
+        count = THROUGHPUT_MAX_MSGS;
+    }
+    salty_alloc_stats_t allocs_before, allocs_after;
+    bool alloc_stats = salty_alloc_stats(&allocs_before);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < count; i++) {
+        if (salty_client_send_application_bytes(sender_tx, msg, (uint32_t)msg_len) != SEND_OK) {
+            printf("    ERROR: Sending message failed\n");
+            free(msg);
+            return false;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!recv_msg(pair, msg_len, offset, NULL)) {
+            free(msg);
+            return false;
+        }
+    }
+    double seconds = (double)(now_ns() - start) / 1e9;
+    alloc_stats = alloc_stats && salty_alloc_stats(&allocs_after);
+    free(msg);
+
+    printf("  %7zu B: latency p50 %8.0f us, p99 %8.0f us | %8.0f msgs/s, %7.1f MiB/s",
+           payload_len,
+           percentile_us(samples, LATENCY_ROUNDS, 50),
+           percentile_us(samples, LATENCY_ROUNDS, 99),
+           (double)count / seconds,
+           (double)(count * payload_len) / seconds / (1024 * 1024));
+    if (alloc_stats) {
+        printf(" | %.1f allocs/msg, %.0f B/msg",
+               (double)(allocs_after.allocations - allocs_before.allocations) / (double)count,
+               (double)(allocs_after.allocated_bytes - allocs_before.allocated_bytes) / (double)count);
+    }
+    printf("\n");
+    return true;
+}
+
+/**
+ * Receive the chunks of a streamed message.
+ *
+ * If `block` is not set, only the chunks that are already available are
+ * received. The data length is added to `*received`, `*done` is set with
+ * the last chunk.
+ */
+static bool recv_chunks(const struct pair *pair, const salty_chunk_reader_t *reader, bool block,
+                        size_t *received, bool *done) {
+    while (!*done) {
+        uint32_t timeout_ms = block ? TIMEOUT_MS : 0;
+        salty_client_recv_chunk_ret_t chunk_ret = salty_client_recv_chunk(
+            pair->responder.receiver_rx, reader, &timeout_ms);
+        if (chunk_ret.success == RECV_NO_DATA && !block) {
+            return true;
+        }
+        if (chunk_ret.success != RECV_OK || chunk_ret.chunk == NULL) {
+            printf("    ERROR: Receiving chunk failed: %d\n", chunk_ret.success);
+            salty_client_recv_chunk_ret_free(chunk_ret);
+            return false;
+        }
+        *received += chunk_ret.chunk->data_len;
+        *done = chunk_ret.chunk->end_of_message;
+        salty_client_recv_chunk_ret_free(chunk_ret);
+    }
+    return true;
+}
+
+/**
+ * Throughput of a large message streamed in chunks.
+ *
+ * Chunks are received while the message is still being written, so neither
+ * side holds the whole message in memory.
+ */
+static bool bench_stream(const struct pair *pair) {
+    uint8_t *data = malloc(STREAM_CHUNK_SIZE);
+    const salty_chunk_reader_t *reader = salty_chunk_reader_new();
+    const salty_chunk_writer_t *writer = salty_chunk_writer_new(pair->initiator.sender_tx, 1, STREAM_CHUNK_SIZE);
+    if (data == NULL || writer == NULL) {
+        printf("    ERROR: Could not create chunk writer\n");
+        return false;
+    }
+    memset(data, 0x42, STREAM_CHUNK_SIZE);
+
+    salty_alloc_stats_t allocs_before, allocs_after;
+    bool alloc_stats = salty_alloc_stats(&allocs_before);
+    uint64_t start = now_ns();
+    size_t sent = 0;
+    size_t received = 0;
+    bool done = false;
+    bool ok = true;
+    while (ok && sent < STREAM_BYTES) {
+        size_t len = STREAM_BYTES - sent < STREAM_CHUNK_SIZE ? STREAM_BYTES - sent : STREAM_CHUNK_SIZE;
+        size_t written = 0;
+        salty_client_send_success_t result = salty_chunk_writer_write(writer, data, len, &written);
+        sent += written;
+        if (result != SEND_OK && result != SEND_WOULD_BLOCK) {
+            printf("    ERROR: Writing chunk failed: %d\n", result);
+            ok = false;
+        }
+        ok = ok && recv_chunks(pair, reader, false, &received, &done);
+    }
+    while (ok) {
+        salty_client_send_success_t result = salty_chunk_writer_finish(writer);
+        if (result == SEND_OK) {
+            break;
+        }
+        if (result != SEND_WOULD_BLOCK) {
+            printf("    ERROR: Finishing message failed: %d\n", result);
+            ok = false;
+        }
+        ok = ok && recv_chunks(pair, reader, false, &received, &done);
+    }
+    ok = ok && recv_chunks(pair, reader, true, &received, &done);
+    double seconds = (double)(now_ns() - start) / 1e9;
+    alloc_stats = alloc_stats && salty_alloc_stats(&allocs_after);
+    salty_chunk_writer_free(writer);
+    salty_chunk_reader_free(reader);
+    free(data);
+    if (!ok) {
+        return false;
+    }
+    if (received != STREAM_BYTES) {
+        printf("    ERROR: Received %zu of %d bytes\n", received, STREAM_BYTES);
+        return false;
+    }
+
+    printf("  stream %d B in %d B chunks: %7.1f MiB/s", STREAM_BYTES, STREAM_CHUNK_SIZE,
+           (double)STREAM_BYTES / seconds / (1024 * 1024));
+    if (alloc_stats) {
+        printf(" | %.0f B allocated in total",
+               (double)(allocs_after.allocated_bytes - allocs_before.allocated_bytes));
+    }
+    printf("\n");
+    return true;
+}
+
+/**
+ * Logger callback function, called on the logging thread.
+ *
+ * Counts the records and prints warnings and errors.
+ */
+static void log_callback(uint8_t level, const char *target, const char *message) {
+    pthread_mutex_lock(&log_records_lock);
+    log_records++;
+    pthread_mutex_unlock(&log_records_lock);
+    if (level >= LEVEL_WARN) {
+        printf("****** [%d] %s: %s\n", level, target, message);
+    }
+}
+
+/**
+ * Message throughput at every log level.
+ */
+static bool bench_log_levels(const struct pair *pair) {
+    const struct { uint8_t level; const char *name; } levels[] = {
+        { LEVEL_TRACE, "TRACE" },
+        { LEVEL_DEBUG, "DEBUG" },
+        { LEVEL_INFO, "INFO" },
+        { LEVEL_WARN, "WARN" },
+        { LEVEL_ERROR, "ERROR" },
+        { LEVEL_OFF, "OFF" },
+    };
+    uint8_t msg[128 + 2];
+    size_t offset = encode_bin(msg, 128);
+    size_t msg_len = offset + 128;
+
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        if (!salty_log_change_level_ring(levels[i].level)) {
+            printf("    ERROR: Could not change log level\n");
+            return false;
+        }
+        uint64_t dropped_before = salty_log_ring_dropped();
+        pthread_mutex_lock(&log_records_lock);
+        uint64_t records_before = log_records;
+        pthread_mutex_unlock(&log_records_lock);
+
+        uint64_t start = now_ns();
+        for (size_t j = 0; j < LOG_LEVEL_MSGS; j++) {
+            if (salty_client_send_application_bytes(pair->initiator.sender_tx, msg, (uint32_t)msg_len) != SEND_OK) {
+                printf("    ERROR: Sending message failed\n");
+                return false;
+            }
+        }
+        for (size_t j = 0; j < LOG_LEVEL_MSGS; j++) {
+            if (!recv_msg(pair, msg_len, offset, NULL)) {
+                return false;
+            }
+        }
+        double seconds = (double)(now_ns() - start) / 1e9;
+
+        // Give the logging thread time to catch up
+        const struct timespec delay = { 0, 100000000 };
+        nanosleep(&delay, NULL);
+        pthread_mutex_lock(&log_records_lock);
+        uint64_t records = log_records - records_before;
+        pthread_mutex_unlock(&log_records_lock);
+
+        printf("  log level %-5s: %8.0f msgs/s | %8llu log records, %8llu dropped\n",
+               levels[i].name,
+               (double)LOG_LEVEL_MSGS / seconds,
+               (unsigned long long)records,
+               (unsigned long long)(salty_log_ring_dropped() - dropped_before));
+    }
+    return salty_log_change_level_ring(LEVEL_WARN);
+}
+
+/**
+ * Main program.
+ */
+int main(int argc, char *argv[]) {
+    // Parse arguments
+    int opt;
+    uint32_t workers = 0;
+    const char *ca_cert_path = "saltyrtc.der";
+    while ((opt = getopt(argc, argv, "h:p:c:w:")) != -1) {
+        switch (opt) {
+            case 'h':
+                host = optarg;
+                break;
+            case 'p':
+                port = (uint16_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                ca_cert_path = optarg;
+                break;
+            case 'w':
+                workers = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-h HOST] [-p PORT] [-c CA_CERT] [-w WORKERS]\n\n", argv[0]);
+                fprintf(stderr, "Note: By default, the server at localhost:8765 with the CA certificate\n");
+                fprintf(stderr, "      saltyrtc.der is used.\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("START C RELAYED DATA BENCHMARK\n");
+
+    if (!read_ca_cert(ca_cert_path)) {
+        printf("  ERROR: Could not read CA certificate `%s`\n", ca_cert_path);
+        return EXIT_FAILURE;
+    }
+
+    if (!salty_log_init_callback_async(log_callback, LEVEL_WARN, LOG_RING_CAPACITY)) {
+        return EXIT_FAILURE;
+    }
+
+    const salty_event_loop_pool_t *pool = salty_event_loop_pool_new(workers);
+    if (pool == NULL) {
+        printf("  ERROR: Could not create event loop pool\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!bench_handshake(pool)) {
+        return EXIT_FAILURE;
+    }
+
+    struct pair pair;
+    if (!connect_pair(pool, &pair)) {
+        return EXIT_FAILURE;
+    }
+    const size_t payload_lens[] = { 64, 256, 1024, 4096, 16384, 65536, 262144, 1048576 };
+    for (size_t i = 0; i < sizeof(payload_lens) / sizeof(payload_lens[0]); i++) {
+        if (!bench_size(&pair, payload_lens[i])) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (!bench_stream(&pair)) {
+        return EXIT_FAILURE;
+    }
+    if (!bench_log_levels(&pair)) {
+        return EXIT_FAILURE;
+    }
+    if (!disconnect_pair(pool, &pair)) {
+        return EXIT_FAILURE;
+    }
+
+    salty_event_loop_pool_free(pool);
+    free(ca_cert);
+
+    printf("END C RELAYED DATA BENCHMARK\n");
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,7 @@
 /**
  * C integration test.
  */
+#include <poll.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdbool.h>
@@ -8,6 +9,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "../saltyrtc_task_relayed_data_ffi.h"
@@ -17,12 +20,17 @@
 void drain_events(const salty_channel_event_rx_t *event_rx, char *role);
 void *connect_initiator(void *threadarg);
 void *connect_responder(void *threadarg);
+bool bench_session_keys(void);
+bool bench_batch(void);
+bool idle_clients(void);
 
 // Statics
 static sem_t auth_token_set;
 static sem_t initiator_channels_ready;
 static sem_t responder_channels_ready;
 static uint8_t *auth_token = NULL;
+static const salty_client_t *initiator_client = NULL;
+static const salty_client_t *responder_client = NULL;
 static const salty_channel_sender_tx_t *initiator_sender = NULL;
 static const salty_channel_sender_tx_t *responder_sender = NULL;
 static const salty_channel_receiver_rx_t *initiator_receiver = NULL;
@@ -127,6 +135,7 @@ void *connect_initiator(void *threadarg) {
         pthread_exit(NULL);
     }
 
+    initiator_client = client_ret.client;
     initiator_sender = client_ret.sender_tx;
     initiator_receiver = client_ret.receiver_rx;
     initiator_disconnect = client_ret.disconnect_tx;
@@ -239,6 +248,7 @@ void *connect_responder(void *threadarg) {
         pthread_exit(NULL);
     }
 
+    responder_client = client_ret.client;
     responder_sender = client_ret.sender_tx;
     responder_receiver = client_ret.receiver_rx;
     responder_disconnect = client_ret.disconnect_tx;
@@ -306,6 +316,340 @@ void *connect_responder(void *threadarg) {
     pthread_exit((void *)connect_success_copy);
 }
 
+/**
+ * Number of messages and message size used by the session key benchmark.
+ */
+#define BENCH_MSG_COUNT 2000
+#define BENCH_MSG_LEN 1024
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Encrypt with the initiator and decrypt with the responder session keys,
+ * once with the allocating functions and once with the `_into` functions
+ * writing into a reused buffer (in-place).
+ *
+ * Requires that the peer handshake has been completed.
+ */
+bool bench_session_keys(void) {
+    uint8_t nonce[24] = { 0 };
+    uint8_t msg[BENCH_MSG_LEN];
+    for (size_t i = 0; i < BENCH_MSG_LEN; i++) {
+        msg[i] = (uint8_t)i;
+    }
+    struct timespec start, end;
+
+    // Allocating functions
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_MSG_COUNT; i++) {
+        memcpy(nonce, &i, sizeof(i));
+        salty_client_encrypt_decrypt_ret_t encrypted = salty_client_encrypt_with_session_keys(
+            initiator_client, msg, BENCH_MSG_LEN, nonce);
+        if (encrypted.success != ENCRYPT_DECRYPT_OK) {
+            printf("    ERROR: Encrypting failed: %d\n", encrypted.success);
+            return false;
+        }
+        salty_client_encrypt_decrypt_ret_t decrypted = salty_client_decrypt_with_session_keys(
+            responder_client, encrypted.bytes, encrypted.bytes_len, nonce);
+        if (decrypted.success != ENCRYPT_DECRYPT_OK ||
+                decrypted.bytes_len != BENCH_MSG_LEN ||
+                memcmp(decrypted.bytes, msg, BENCH_MSG_LEN) != 0) {
+            printf("    ERROR: Decrypting failed: %d\n", decrypted.success);
+            return false;
+        }
+        salty_client_encrypt_decrypt_free(encrypted.bytes, encrypted.bytes_len);
+        salty_client_encrypt_decrypt_free(decrypted.bytes, decrypted.bytes_len);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double allocating_seconds = elapsed_seconds(&start, &end);
+
+    // Caller-provided buffer, in-place
+    const size_t buf_len = salty_client_encrypt_required_len(BENCH_MSG_LEN);
+    if (buf_len != BENCH_MSG_LEN + SESSION_KEYS_OVERHEAD ||
+            salty_client_decrypt_required_len(buf_len) != BENCH_MSG_LEN) {
+        printf("    ERROR: Unexpected required length\n");
+        return false;
+    }
+    uint8_t *buf = malloc(buf_len);
+    if (buf == NULL) {
+        printf("    ERROR: Could not malloc %zu bytes\n", buf_len);
+        return false;
+    }
+    size_t written = 0;
+    if (salty_client_encrypt_with_session_keys_into(initiator_client, msg, BENCH_MSG_LEN, nonce,
+                                                    buf, BENCH_MSG_LEN, &written) != ENCRYPT_DECRYPT_BUFFER_TOO_SMALL ||
+            written != buf_len) {
+        printf("    ERROR: Too small buffer was not rejected\n");
+        free(buf);
+        return false;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_MSG_COUNT; i++) {
+        memcpy(nonce, &i, sizeof(i));
+        memcpy(buf, msg, BENCH_MSG_LEN);
+        if (salty_client_encrypt_with_session_keys_into(initiator_client, buf, BENCH_MSG_LEN, nonce,
+                                                        buf, buf_len, &written) != ENCRYPT_DECRYPT_OK ||
+                written != buf_len) {
+            printf("    ERROR: Encrypting into buffer failed\n");
+            free(buf);
+            return false;
+        }
+        if (salty_client_decrypt_with_session_keys_into(responder_client, buf, buf_len, nonce,
+                                                        buf, buf_len, &written) != ENCRYPT_DECRYPT_OK ||
+                written != BENCH_MSG_LEN ||
+                memcmp(buf, msg, BENCH_MSG_LEN) != 0) {
+            printf("    ERROR: Decrypting into buffer failed\n");
+            free(buf);
+            return false;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double into_seconds = elapsed_seconds(&start, &end);
+    free(buf);
+
+    printf("    BENCH: %d messages of %d bytes (encrypt + decrypt)\n", BENCH_MSG_COUNT, BENCH_MSG_LEN);
+    printf("    BENCH: allocating: %.0f msgs/s\n", BENCH_MSG_COUNT / allocating_seconds);
+    printf("    BENCH: into buffer (in-place): %.0f msgs/s\n", BENCH_MSG_COUNT / into_seconds);
+    return true;
+}
+
+/**
+ * Number of messages, message size and batch size used by the batch benchmark.
+ */
+#define BENCH_BATCH_MSG_COUNT 1000
+#define BENCH_BATCH_PAYLOAD_LEN 128
+#define BENCH_BATCH_SIZE 100
+
+/**
+ * Receive `count` application messages from the responder receiver,
+ * either one by one or in batches.
+ */
+static bool recv_application_msgs(size_t count, bool batch) {
+    uint32_t timeout_ms = 10000;
+    size_t received = 0;
+    while (received < count) {
+        const salty_msg_t *msgs;
+        size_t msgs_len;
+        salty_client_recv_msg_ret_t msg_ret = { 0 };
+        salty_client_recv_msgs_ret_t msgs_ret = { 0 };
+        if (batch) {
+            msgs_ret = salty_client_recv_msg_batch(responder_receiver, BENCH_BATCH_SIZE, &timeout_ms);
+            if (msgs_ret.success != RECV_OK) {
+                printf("    ERROR: Receiving batch failed: %d\n", msgs_ret.success);
+                return false;
+            }
+            msgs = msgs_ret.msgs;
+            msgs_len = msgs_ret.msgs_len;
+        } else {
+            msg_ret = salty_client_recv_msg(responder_receiver, &timeout_ms);
+            if (msg_ret.success != RECV_OK) {
+                printf("    ERROR: Receiving message failed: %d\n", msg_ret.success);
+                return false;
+            }
+            msgs = msg_ret.msg;
+            msgs_len = 1;
+        }
+        for (size_t i = 0; i < msgs_len; i++) {
+            if (msgs[i].msg_type != MSG_APPLICATION || msgs[i].msg_bytes_len != BENCH_BATCH_PAYLOAD_LEN + 2) {
+                printf("    ERROR: Invalid message received\n");
+                return false;
+            }
+        }
+        received += msgs_len;
+        if (batch) {
+            salty_client_recv_msgs_ret_free(msgs_ret);
+        } else {
+            salty_client_recv_msg_ret_free(msg_ret);
+        }
+    }
+    return true;
+}
+
+/**
+ * Send application messages from the initiator to the responder, once one
+ * by one and once in batches of `BENCH_BATCH_SIZE` messages.
+ *
+ * Requires that the peer handshake has been completed.
+ */
+bool bench_batch(void) {
+    // Msgpack bin 8 value
+    uint8_t msg[BENCH_BATCH_PAYLOAD_LEN + 2];
+    msg[0] = 0xc4;
+    msg[1] = BENCH_BATCH_PAYLOAD_LEN;
+    memset(msg + 2, 0x42, BENCH_BATCH_PAYLOAD_LEN);
+    salty_iovec_t iovecs[BENCH_BATCH_SIZE];
+    for (size_t i = 0; i < BENCH_BATCH_SIZE; i++) {
+        iovecs[i].iov_base = msg;
+        iovecs[i].iov_len = sizeof(msg);
+    }
+    struct timespec start, end;
+
+    // One by one
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < BENCH_BATCH_MSG_COUNT; i++) {
+        if (salty_client_send_application_bytes(initiator_sender, msg, sizeof(msg)) != SEND_OK) {
+            printf("    ERROR: Sending message failed\n");
+            return false;
+        }
+    }
+    if (!recv_application_msgs(BENCH_BATCH_MSG_COUNT, false)) {
+        return false;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double single_seconds = elapsed_seconds(&start, &end);
+
+    // Batches
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < BENCH_BATCH_MSG_COUNT / BENCH_BATCH_SIZE; i++) {
+        if (salty_client_send_application_bytes_batch(initiator_sender, iovecs, BENCH_BATCH_SIZE) != SEND_OK) {
+            printf("    ERROR: Sending batch failed\n");
+            return false;
+        }
+    }
+    if (!recv_application_msgs(BENCH_BATCH_MSG_COUNT, true)) {
+        return false;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double batch_seconds = elapsed_seconds(&start, &end);
+
+    printf("    BENCH: %d application messages of %zu bytes\n", BENCH_BATCH_MSG_COUNT, sizeof(msg));
+    printf("    BENCH: one by one: %.0f msgs/s\n", BENCH_BATCH_MSG_COUNT / single_seconds);
+    printf("    BENCH: batches of %d: %.0f msgs/s\n", BENCH_BATCH_SIZE, BENCH_BATCH_MSG_COUNT / batch_seconds);
+    return true;
+}
+
+/**
+ * Number of idle clients handled by a single thread.
+ */
+#define IDLE_CLIENT_COUNT 1000
+
+/**
+ * Make sure that enough file descriptors are available for `count`
+ * readiness notifiers (two per notifier).
+ */
+static bool raise_fd_limit(rlim_t count) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return false;
+    }
+    rlim_t required = count * 2 + 64;
+    if (limit.rlim_cur >= required) {
+        return true;
+    }
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < required) {
+        return false;
+    }
+    limit.rlim_cur = required;
+    return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+/**
+ * Create many clients on one event loop and wait for all of their message
+ * channels on a single thread with `poll`.
+ *
+ * The clients never connect. Freeing a client ends its message channel,
+ * which must wake up exactly that client's readiness notifier.
+ */
+bool idle_clients(void) {
+    if (!raise_fd_limit(IDLE_CLIENT_COUNT)) {
+        printf("    ERROR: Could not raise the file descriptor limit\n");
+        return false;
+    }
+
+    // Avoid a warning per client about the missing server key
+    uint8_t server_key[32];
+    memset(server_key, 0x01, sizeof(server_key));
+
+    const salty_event_loop_t *loop = salty_event_loop_new();
+    salty_relayed_data_client_ret_t *clients = calloc(IDLE_CLIENT_COUNT, sizeof(salty_relayed_data_client_ret_t));
+    const salty_readiness_t **notifiers = calloc(IDLE_CLIENT_COUNT, sizeof(salty_readiness_t *));
+    struct pollfd *fds = calloc(IDLE_CLIENT_COUNT, sizeof(struct pollfd));
+    if (clients == NULL || notifiers == NULL || fds == NULL) {
+        printf("    ERROR: Could not allocate memory for idle clients\n");
+        return false;
+    }
+    struct timespec start, end;
+
+    // Create clients and arm their notifiers
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < IDLE_CLIENT_COUNT; i++) {
+        clients[i] = salty_relayed_data_initiator_new(
+            salty_keypair_new(), salty_event_loop_get_remote(loop), 0, NULL, server_key);
+        if (clients[i].success != OK) {
+            printf("    ERROR: Could not create client %zu: %d\n", i, clients[i].success);
+            return false;
+        }
+        notifiers[i] = salty_readiness_new();
+        if (notifiers[i] == NULL) {
+            printf("    ERROR: Could not create readiness notifier %zu\n", i);
+            return false;
+        }
+        salty_client_recv_msg_ret_t ret = salty_client_recv_msg_notify(clients[i].receiver_rx, notifiers[i]);
+        if (ret.success != RECV_NO_DATA) {
+            printf("    ERROR: Unexpected receive result for client %zu: %d\n", i, ret.success);
+            return false;
+        }
+        fds[i].fd = salty_readiness_fd(notifiers[i]);
+        fds[i].events = POLLIN;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("    IDLE: Created and armed %d clients in %.1f ms\n", IDLE_CLIENT_COUNT, elapsed_seconds(&start, &end) * 1e3);
+
+    // Nothing must be ready while the clients are idle
+    if (poll(fds, IDLE_CLIENT_COUNT, 100) != 0) {
+        printf("    ERROR: Idle client reported readiness\n");
+        return false;
+    }
+
+    // Free all clients. This ends their message channels.
+    for (size_t i = 0; i < IDLE_CLIENT_COUNT; i++) {
+        salty_relayed_data_client_free(clients[i].client);
+        salty_channel_sender_tx_free(clients[i].sender_tx);
+        salty_channel_sender_rx_free(clients[i].sender_rx);
+        salty_channel_disconnect_tx_free(clients[i].disconnect_tx);
+        salty_channel_disconnect_rx_free(clients[i].disconnect_rx);
+    }
+
+    // Wait for all channels on this thread
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t ended = 0;
+    while (ended < IDLE_CLIENT_COUNT) {
+        int ready = poll(fds, IDLE_CLIENT_COUNT, 1000);
+        if (ready <= 0) {
+            printf("    ERROR: Waiting for readiness failed (%zu of %d channels ended)\n", ended, IDLE_CLIENT_COUNT);
+            return false;
+        }
+        for (size_t i = 0; i < IDLE_CLIENT_COUNT; i++) {
+            if (fds[i].fd < 0 || (fds[i].revents & POLLIN) == 0) {
+                continue;
+            }
+            salty_client_recv_msg_ret_t ret = salty_client_recv_msg_notify(clients[i].receiver_rx, notifiers[i]);
+            if (ret.success == RECV_STREAM_ENDED) {
+                // Negative file descriptors are ignored by poll
+                fds[i].fd = -1;
+                ended++;
+            } else if (ret.success != RECV_NO_DATA) {
+                printf("    ERROR: Unexpected receive result for client %zu: %d\n", i, ret.success);
+                return false;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("    IDLE: Woke up %d channels on one thread in %.1f ms\n", IDLE_CLIENT_COUNT, elapsed_seconds(&start, &end) * 1e3);
+
+    for (size_t i = 0; i < IDLE_CLIENT_COUNT; i++) {
+        salty_channel_receiver_rx_free(clients[i].receiver_rx);
+        salty_readiness_free(notifiers[i]);
+    }
+    free(fds);
+    free(notifiers);
+    free(clients);
+    salty_event_loop_free(loop);
+    return true;
+}
+
 /**
  * Logger callback function.
  */
@@ -319,7 +663,7 @@ static void log_callback(uint8_t level, const char *target, const char *message)
 int main(int argc, char *argv[]) {
     // Parse arguments
     int opt;
-    enum { LOGGER_CONSOLE, LOGGER_CALLBACK } logger = LOGGER_CONSOLE;
+    enum { LOGGER_CONSOLE, LOGGER_CALLBACK, LOGGER_RING } logger = LOGGER_CONSOLE;
     while ((opt = getopt(argc, argv, "l:")) != -1) {
         switch (opt) {
             case 'l':
@@ -331,11 +675,15 @@ int main(int argc, char *argv[]) {
                     logger = LOGGER_CALLBACK;
                     break;
                 }
+                if (strcmp(optarg, "ring") == 0) {
+                    logger = LOGGER_RING;
+                    break;
+                }
                 fprintf(stderr, "Invalid logger mode: %s\n", optarg);
                 return EXIT_FAILURE;
             default:
                 fprintf(stderr, "Usage: %s [-l LOGGER_MODE]\n\n", argv[0]);
-                fprintf(stderr, "Note: The logger mode may be either 'console' or 'callback'.\n");
+                fprintf(stderr, "Note: The logger mode may be either 'console', 'callback' or 'ring'.\n");
                 fprintf(stderr, "      The default value is 'console'.\n");
                 return EXIT_FAILURE;
         }
@@ -399,6 +747,16 @@ int main(int argc, char *argv[]) {
         if (!salty_log_init_callback(log_callback, LEVEL_DEBUG)) {
             return EXIT_FAILURE;
         }
+    } else if (logger == LOGGER_RING) {
+        printf("  Initializing ring buffer logger (level DEBUG)\n");
+        if (!salty_log_init_ring(LEVEL_DEBUG, 4096)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("  Waiting for %d idle clients on one thread\n", IDLE_CLIENT_COUNT);
+    if (!idle_clients()) {
+        return EXIT_FAILURE;
     }
 
     printf("  Creating key pairs\n");
@@ -508,6 +866,18 @@ int main(int argc, char *argv[]) {
     printf("  Freeing received event\n");
     salty_client_recv_msg_ret_free(recv_msg_ret);
 
+    // Benchmark encryption with the session keys
+    printf("  Benchmarking encryption with session keys\n");
+    if (!bench_session_keys()) {
+        return EXIT_FAILURE;
+    }
+
+    // Benchmark batch sending and receiving
+    printf("  Benchmarking batch sending and receiving\n");
+    if (!bench_batch()) {
+        return EXIT_FAILURE;
+    }
+
     // Disconnect
     printf("  Disconnecting initiator\n");
     salty_client_disconnect(initiator_disconnect, 1001);
@@ -540,6 +910,17 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    if (logger == LOGGER_RING) {
+        printf("  Draining ring buffer logger\n");
+        uint32_t records = salty_log_ring_drain(log_callback, UINT32_MAX);
+        uint64_t dropped = salty_log_ring_dropped();
+        printf("    %u log records, %llu dropped\n", records, (unsigned long long)dropped);
+        if (records == 0) {
+            printf("ERROR: No log records in the ring buffer\n");
+            return EXIT_FAILURE;
+        }
+    }
+
     printf("CLEANUP\n");
 
     printf("  Freeing CA cert bytes\n");
@@ -1,9 +1,18 @@
+extern crate bytes;
+extern crate crypto_box;
+extern crate data_encoding;
 #[macro_use]
 extern crate lazy_static;
+extern crate rand;
 extern crate saltyrtc_client;
+extern crate sha1;
+extern crate tokio_codec;
 extern crate tokio_core;
 extern crate tokio_process;
 extern crate tokio_timer;
+extern crate tokio_tls;
+
+mod standin;
 
 use std::fs::copy;
 use std::path::{Path, PathBuf};
@@ -17,6 +26,8 @@ use tokio_core::reactor::Core;
 use tokio_process::CommandExt;
 use tokio_timer::Timer;
 
+use standin::StandInServer;
+
 lazy_static! {
     static ref C_TEST_MUTEX: Mutex<()> = Mutex::new(());
 }
@@ -53,14 +64,25 @@ fn build_tests() -> (MutexGuard<'static, ()>, PathBuf) {
         .expect("Could not run ninja to build C tests");
     assert_output_success(output);
 
-    println!("Copying test certificate...");
-    copy("../saltyrtc.der", build_dir.join("saltyrtc.der"))
-        .expect("Could not copy test certificate (saltyrtc.der)");
+    // Not required for the benchmarks against the stand-in server
+    if Path::new("../saltyrtc.der").exists() {
+        println!("Copying test certificate...");
+        copy("../saltyrtc.der", build_dir.join("saltyrtc.der"))
+            .expect("Could not copy test certificate (saltyrtc.der)");
+    }
 
     (guard, build_dir)
 }
 
 fn c_tests_run(bin: &str, logger: Option<&str>) {
+    let args = match logger {
+        Some(l) => vec!["-l", l],
+        None => vec![],
+    };
+    c_tests_run_with_timeout(bin, &args, 3);
+}
+
+fn c_tests_run_with_timeout(bin: &str, args: &[&str], timeout_seconds: u64) -> Output {
     let (_guard, build_dir) = build_tests();
 
     // Event loop
@@ -70,16 +92,12 @@ fn c_tests_run(bin: &str, logger: Option<&str>) {
     let timer = Timer::default();
 
     // Create a command future
-    let mut cmd = Command::new(bin);
-    if let Some(l) = logger {
-        cmd.arg("-l").arg(l);
-    }
-    let c_tests = cmd
+    let c_tests = Command::new(bin)
+        .args(args)
         .current_dir(&build_dir)
         .output_async(&core.handle());
 
     // Run command with timeout
-    let timeout_seconds = 3;
     let either = core.run(c_tests.select2(timer.sleep(Duration::from_secs(timeout_seconds))))
         .expect("Failed to run C tests and collect output");
     let output = match either {
@@ -93,6 +111,7 @@ fn c_tests_run(bin: &str, logger: Option<&str>) {
         println!("Stdout:\n{}\nStderr:\n{}\n", stdout, stderr);
         panic!("Running C tests failed with non-zero return code");
     }
+    output
 }
 
 #[test]
@@ -105,11 +124,48 @@ fn c_tests_integration_run_callback_logger() {
     c_tests_run("./integration", Some("callback"));
 }
 
+#[test]
+fn c_tests_integration_run_ring_logger() {
+    c_tests_run("./integration", Some("ring"));
+}
+
 #[test]
 fn c_tests_disconnect_run() {
     c_tests_run("./disconnect", None);
 }
 
+/// Run a C test or benchmark against the local stand-in server.
+fn c_standin_run(bin: &str, timeout_seconds: u64) {
+    let server = StandInServer::start().expect("Could not start stand-in server");
+    let port = server.port().to_string();
+    let output = c_tests_run_with_timeout(
+        bin,
+        &["-h", "127.0.0.1", "-p", &port, "-c", standin::CA_CERT_PATH],
+        timeout_seconds,
+    );
+    println!("{}", String::from_utf8_lossy(&output.stdout));
+}
+
+#[test]
+fn c_tests_backpressure_run() {
+    c_standin_run("./backpressure", 60);
+}
+
+/// Benchmark, run with `cargo test -- --ignored --nocapture`.
+#[test]
+#[ignore]
+fn c_bench_pool_run() {
+    c_standin_run("./pool", 120);
+}
+
+/// Benchmark, run with `cargo test --features alloc-stats -- --ignored --nocapture`
+/// to include the allocation counts.
+#[test]
+#[ignore]
+fn c_bench_relayed_data_run() {
+    c_standin_run("./bench", 300);
+}
+
 // #[test] Disabled for now due to false errors, see
 // https://bugs.kde.org/show_bug.cgi?id=381289 and
 // https://bugzilla.redhat.com/show_bug.cgi?id=1462258
@@ -0,0 +1,325 @@
+/**
+ * C benchmark: Many clients on an event loop pool.
+ *
+ * Connects clients on an event loop pool through a SaltyRTC server and
+ * measures the handshake rate and the message throughput for different
+ * numbers of concurrent clients. The peers of the clients run on a separate
+ * pool, so that only the benchmarked clients share the pool's workers.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../saltyrtc_task_relayed_data_ffi.h"
+
+
+/**
+ * Number of messages sent from every client to its peer.
+ */
+#define MSG_COUNT 100
+
+/**
+ * Payload length of the messages (msgpack bin 8).
+ */
+#define MSG_PAYLOAD_LEN 128
+
+/**
+ * Connection parameters.
+ */
+static const char *host = "localhost";
+static uint16_t port = 8765;
+
+/**
+ * A connected client.
+ */
+struct pool_client {
+    salty_relayed_data_client_ret_t client;
+    const salty_channel_event_rx_t *event_rx;
+};
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Make sure that enough file descriptors are available for `count` connections.
+ */
+static bool raise_fd_limit(rlim_t count) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return false;
+    }
+    rlim_t required = count + 64;
+    if (limit.rlim_cur >= required) {
+        return true;
+    }
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < required) {
+        return false;
+    }
+    limit.rlim_cur = required;
+    return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+/**
+ * Read a DER formatted CA certificate.
+ */
+static uint8_t *read_ca_cert(const char *path, uint32_t *len) {
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL) {
+        return NULL;
+    }
+    uint8_t *ca_cert = NULL;
+    long ca_cert_len = -1;
+    if (fseek(fd, 0, SEEK_END) == 0) {
+        ca_cert_len = ftell(fd);
+    }
+    if (ca_cert_len > 0 && fseek(fd, 0, SEEK_SET) == 0) {
+        ca_cert = malloc((size_t)ca_cert_len);
+        if (ca_cert != NULL && fread(ca_cert, (size_t)ca_cert_len, 1, fd) != 1) {
+            free(ca_cert);
+            ca_cert = NULL;
+        }
+    }
+    fclose(fd);
+    *len = (uint32_t)ca_cert_len;
+    return ca_cert;
+}
+
+/**
+ * Initialize a client and start its connection on the pool.
+ */
+static bool connect_pooled(struct pool_client *c, const salty_event_loop_pool_t *pool, uint32_t worker,
+                           const uint8_t *ca_cert, uint32_t ca_cert_len) {
+    salty_client_init_ret_t init_ret = salty_client_init_pooled(
+        host, port, c->client.client, 10, ca_cert, ca_cert_len);
+    if (init_ret.success != INIT_OK) {
+        printf("    ERROR: Could not initialize connection: %d\n", init_ret.success);
+        return false;
+    }
+    c->event_rx = init_ret.event_rx;
+    salty_client_connect_success_t connect_success = salty_client_connect_pooled(
+        init_ret.handshake_future,
+        c->client.client,
+        pool,
+        worker,
+        init_ret.event_tx,
+        c->client.sender_rx,
+        c->client.disconnect_rx
+    );
+    if (connect_success != CONNECT_OK) {
+        printf("    ERROR: Could not start connection: %d\n", connect_success);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Wait until the peer handshake of a client has been completed.
+ */
+static bool wait_peer_handshake(const struct pool_client *c) {
+    uint32_t timeout_ms = 10000;
+    while (true) {
+        salty_client_recv_event_ret_t event_ret = salty_client_recv_event(c->event_rx, &timeout_ms);
+        if (event_ret.success != RECV_OK) {
+            printf("    ERROR: Waiting for peer handshake failed: %d\n", event_ret.success);
+            return false;
+        }
+        bool done = event_ret.event->event_type == EVENT_PEER_HANDSHAKE_COMPLETED;
+        salty_client_recv_event_ret_free(event_ret);
+        if (done) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Connect `pairs` initiators on the pool and their responders on the peer
+ * pool, send `MSG_COUNT` messages per pair and disconnect all clients again.
+ */
+static bool bench_pairs(const salty_event_loop_pool_t *pool, const salty_event_loop_pool_t *peer_pool,
+                        size_t pairs, const uint8_t *ca_cert, uint32_t ca_cert_len) {
+    struct pool_client *initiators = calloc(pairs, sizeof(struct pool_client));
+    struct pool_client *responders = calloc(pairs, sizeof(struct pool_client));
+    if (initiators == NULL || responders == NULL) {
+        printf("    ERROR: Could not allocate memory for %zu pairs\n", pairs);
+        return false;
+    }
+    struct timespec start, end;
+
+    // Handshakes
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < pairs; i++) {
+        // Initiator
+        const salty_keypair_t *i_keypair = salty_keypair_new();
+        uint8_t i_pubkey[32];
+        memcpy(i_pubkey, salty_keypair_public_key(i_keypair), 32);
+        uint32_t worker = salty_event_loop_pool_next_worker(pool);
+        initiators[i].client = salty_relayed_data_initiator_new(
+            i_keypair, salty_event_loop_pool_get_remote(pool, worker), 0, NULL, NULL);
+        if (initiators[i].client.success != OK) {
+            printf("    ERROR: Could not create initiator: %d\n", initiators[i].client.success);
+            return false;
+        }
+        uint8_t auth_token[32];
+        memcpy(auth_token, salty_relayed_data_client_auth_token(initiators[i].client.client), 32);
+        if (!connect_pooled(&initiators[i], pool, worker, ca_cert, ca_cert_len)) {
+            return false;
+        }
+
+        // Responder
+        worker = salty_event_loop_pool_next_worker(peer_pool);
+        responders[i].client = salty_relayed_data_responder_new(
+            salty_keypair_new(), salty_event_loop_pool_get_remote(peer_pool, worker), 0, i_pubkey, auth_token, NULL);
+        if (responders[i].client.success != OK) {
+            printf("    ERROR: Could not create responder: %d\n", responders[i].client.success);
+            return false;
+        }
+        if (!connect_pooled(&responders[i], peer_pool, worker, ca_cert, ca_cert_len)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < pairs; i++) {
+        if (!wait_peer_handshake(&initiators[i]) || !wait_peer_handshake(&responders[i])) {
+            return false;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double handshake_seconds = elapsed_seconds(&start, &end);
+
+    // Throughput
+    uint8_t msg[MSG_PAYLOAD_LEN + 2];
+    msg[0] = 0xc4;
+    msg[1] = MSG_PAYLOAD_LEN;
+    memset(msg + 2, 0x42, MSG_PAYLOAD_LEN);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < pairs; i++) {
+        for (size_t j = 0; j < MSG_COUNT; j++) {
+            if (salty_client_send_application_bytes(initiators[i].client.sender_tx, msg, sizeof(msg)) != SEND_OK) {
+                printf("    ERROR: Sending message failed\n");
+                return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < pairs; i++) {
+        uint32_t timeout_ms = 10000;
+        size_t received = 0;
+        while (received < MSG_COUNT) {
+            salty_client_recv_msgs_ret_t msgs_ret = salty_client_recv_msg_batch(
+                responders[i].client.receiver_rx, MSG_COUNT, &timeout_ms);
+            if (msgs_ret.success != RECV_OK) {
+                printf("    ERROR: Receiving messages failed: %d\n", msgs_ret.success);
+                return false;
+            }
+            received += msgs_ret.msgs_len;
+            salty_client_recv_msgs_ret_free(msgs_ret);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double throughput_seconds = elapsed_seconds(&start, &end);
+
+    printf("    BENCH: %zu clients: %.0f handshakes/s, %.0f msgs/s\n",
+           pairs,
+           (double)pairs / handshake_seconds,
+           (double)(pairs * MSG_COUNT) / throughput_seconds);
+
+    // Disconnect and wait for all connections to end
+    for (size_t i = 0; i < pairs; i++) {
+        salty_client_disconnect(initiators[i].client.disconnect_tx, 1001);
+        salty_client_disconnect(responders[i].client.disconnect_tx, 1001);
+    }
+    for (size_t i = 0; salty_event_loop_pool_connections(pool) + salty_event_loop_pool_connections(peer_pool) > 0; i++) {
+        if (i >= 1000) {
+            printf("    ERROR: Connections did not end\n");
+            return false;
+        }
+        const struct timespec delay = { 0, 10000000 };
+        nanosleep(&delay, NULL);
+    }
+
+    for (size_t i = 0; i < pairs * 2; i++) {
+        struct pool_client *c = i < pairs ? &initiators[i] : &responders[i - pairs];
+        salty_relayed_data_client_free(c->client.client);
+        salty_channel_receiver_rx_free(c->client.receiver_rx);
+        salty_channel_sender_tx_free(c->client.sender_tx);
+        salty_channel_event_rx_free(c->event_rx);
+    }
+    free(initiators);
+    free(responders);
+    return true;
+}
+
+/**
+ * Main program.
+ */
+int main(int argc, char *argv[]) {
+    // Parse arguments
+    int opt;
+    uint32_t workers = 0;
+    const char *ca_cert_path = "saltyrtc.der";
+    while ((opt = getopt(argc, argv, "h:p:c:w:")) != -1) {
+        switch (opt) {
+            case 'h':
+                host = optarg;
+                break;
+            case 'p':
+                port = (uint16_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                ca_cert_path = optarg;
+                break;
+            case 'w':
+                workers = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-h HOST] [-p PORT] [-c CA_CERT] [-w WORKERS]\n\n", argv[0]);
+                fprintf(stderr, "Note: By default, the server at localhost:8765 with the CA certificate\n");
+                fprintf(stderr, "      saltyrtc.der and one worker per CPU (per pool) are used.\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("START C POOL BENCHMARK\n");
+
+    uint32_t ca_cert_len = 0;
+    uint8_t *ca_cert = read_ca_cert(ca_cert_path, &ca_cert_len);
+    if (ca_cert == NULL) {
+        printf("  ERROR: Could not read CA certificate `%s`\n", ca_cert_path);
+        return EXIT_FAILURE;
+    }
+
+    if (!salty_log_init_console(LEVEL_WARN)) {
+        return EXIT_FAILURE;
+    }
+
+    const salty_event_loop_pool_t *pool = salty_event_loop_pool_new(workers);
+    const salty_event_loop_pool_t *peer_pool = salty_event_loop_pool_new(workers);
+    if (pool == NULL || peer_pool == NULL) {
+        printf("  ERROR: Could not create event loop pool\n");
+        return EXIT_FAILURE;
+    }
+    printf("  Started event loop pool with %u workers\n", salty_event_loop_pool_workers(pool));
+
+    const size_t client_counts[] = { 1, 100, 1000 };
+    for (size_t i = 0; i < sizeof(client_counts) / sizeof(client_counts[0]); i++) {
+        printf("  Benchmarking %zu concurrent clients\n", client_counts[i]);
+        if (!raise_fd_limit(client_counts[i] * 2)) {
+            printf("    ERROR: Could not raise the file descriptor limit\n");
+            return EXIT_FAILURE;
+        }
+        if (!bench_pairs(pool, peer_pool, client_counts[i], ca_cert, ca_cert_len)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    salty_event_loop_pool_free(peer_pool);
+    salty_event_loop_pool_free(pool);
+    free(ca_cert);
+
+    printf("END C POOL BENCHMARK\n");
+    return EXIT_SUCCESS;
+}
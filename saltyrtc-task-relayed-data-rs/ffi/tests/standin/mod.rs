@@ -0,0 +1,702 @@
+//! A local stand-in for the SaltyRTC server.
+//!
+//! Implements the server side of the SaltyRTC signalling protocol as far as
+//! the relayed data task needs it: the client handshake, relaying messages
+//! between initiator and responders, and the `new-initiator`,
+//! `new-responder`, `drop-responder`, `disconnected` and `send-error`
+//! messages.
+//!
+//! Not implemented: Signing the session key (`signed_keys`, only required
+//! if the client knows the server's permanent key) and WebSocket pings.
+//!
+//! The server listens on `127.0.0.1` and uses the TLS identity
+//! `server.p12` (password `saltyrtc`) for `localhost`, `127.0.0.1` and
+//! `::1`, issued by the test CA `ca.der`.
+
+use std::cell::{Cell, RefCell};
+use std::collections::HashMap;
+use std::io;
+use std::net::SocketAddr;
+use std::rc::Rc;
+use std::sync::mpsc as std_mpsc;
+use std::thread::{self, JoinHandle};
+
+use bytes::{BufMut, BytesMut};
+use crypto_box::{PublicKey, SalsaBox, SecretKey};
+use crypto_box::aead::Aead;
+use crypto_box::aead::generic_array::GenericArray;
+use data_encoding::{BASE64, HEXLOWER_PERMISSIVE};
+use saltyrtc_client::dep::futures::{Future, Sink, Stream};
+use saltyrtc_client::dep::futures::future::{self, Either};
+use saltyrtc_client::dep::futures::sync::{mpsc, oneshot};
+use saltyrtc_client::dep::native_tls::{self, Identity};
+use saltyrtc_client::dep::rmpv::Value;
+use saltyrtc_client::dep::rmpv::decode::read_value;
+use saltyrtc_client::dep::rmpv::encode::write_value;
+use sha1::Sha1;
+use tokio_codec::{Decoder, Encoder, Framed};
+use tokio_core::net::{TcpListener, TcpStream};
+use tokio_core::reactor::{Core, Handle};
+use tokio_tls::{TlsAcceptor, TlsStream};
+
+/// Path of the CA certificate that issued the server certificate.
+pub const CA_CERT_PATH: &str = concat!(env!("CARGO_MANIFEST_DIR"), "/tests/standin/ca.der");
+
+const SUBPROTOCOL: &str = "v1.saltyrtc.org";
+const WEBSOCKET_GUID: &str = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+const MAX_HANDSHAKE_LEN: usize = 8 * 1024;
+const MAX_FRAME_LEN: usize = 16 * 1024 * 1024;
+
+const NONCE_LEN: usize = 24;
+const COOKIE_LEN: usize = 16;
+const SERVER_ADDRESS: u8 = 0x00;
+const INITIATOR_ADDRESS: u8 = 0x01;
+const RESPONDER_ADDRESS_MIN: u8 = 0x02;
+const RESPONDER_ADDRESS_MAX: u8 = 0xff;
+
+const CLOSE_PATH_FULL: u16 = 3000;
+const CLOSE_PROTOCOL_ERROR: u16 = 3001;
+const CLOSE_DROPPED_BY_INITIATOR: u16 = 3004;
+
+fn other_error<E: ToString>(e: E) -> io::Error {
+    io::Error::new(io::ErrorKind::Other, e.to_string())
+}
+
+fn invalid_data(reason: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, reason)
+}
+
+
+// *** WEBSOCKET *** //
+
+/// The opening handshake: Decodes the HTTP request head and encodes the response.
+struct HandshakeCodec;
+
+impl Decoder for HandshakeCodec {
+    type Item = String;
+    type Error = io::Error;
+
+    fn decode(&mut self, src: &mut BytesMut) -> io::Result<Option<String>> {
+        match src.windows(4).position(|window| window == b"\r\n\r\n") {
+            Some(pos) => {
+                let head = src.split_to(pos + 4);
+                String::from_utf8(head.to_vec())
+                    .map(Some)
+                    .map_err(|_| invalid_data("Handshake request is not valid UTF-8"))
+            },
+            None if src.len() > MAX_HANDSHAKE_LEN => Err(invalid_data("Handshake request too long")),
+            None => Ok(None),
+        }
+    }
+}
+
+impl Encoder for HandshakeCodec {
+    type Item = String;
+    type Error = io::Error;
+
+    fn encode(&mut self, response: String, dst: &mut BytesMut) -> io::Result<()> {
+        dst.extend_from_slice(response.as_bytes());
+        Ok(())
+    }
+}
+
+/// Parse the handshake request.
+///
+/// Returns the path (the public permanent key of the initiator) and the
+/// handshake response.
+fn parse_handshake(request: &str) -> io::Result<([u8; 32], String)> {
+    let mut lines = request.split("\r\n");
+    let path = match lines.next().map(|line| line.split(' ').collect::<Vec<_>>()) {
+        Some(ref parts) if parts.len() == 3 && parts[0] == "GET" => parts[1].trim_start_matches('/').to_string(),
+        _ => return Err(invalid_data("Invalid request line")),
+    };
+    let key_bytes = HEXLOWER_PERMISSIVE.decode(path.as_bytes())
+        .map_err(|_| invalid_data("Path is not a hex encoded key"))?;
+    if key_bytes.len() != 32 {
+        return Err(invalid_data("Path is not a hex encoded key"));
+    }
+    let mut path_key = [0; 32];
+    path_key.copy_from_slice(&key_bytes);
+
+    let mut websocket_key = None;
+    let mut subprotocol = false;
+    for line in lines {
+        if let Some(pos) = line.find(':') {
+            let value = line[pos + 1..].trim();
+            match line[..pos].trim().to_ascii_lowercase().as_str() {
+                "sec-websocket-key" => websocket_key = Some(value.to_string()),
+                "sec-websocket-protocol" => subprotocol = value.split(',').any(|p| p.trim() == SUBPROTOCOL),
+                _ => {},
+            }
+        }
+    }
+    let websocket_key = websocket_key.ok_or_else(|| invalid_data("Missing Sec-WebSocket-Key header"))?;
+    if !subprotocol {
+        return Err(invalid_data("Subprotocol not supported"));
+    }
+
+    let mut sha1 = Sha1::new();
+    sha1.update(websocket_key.as_bytes());
+    sha1.update(WEBSOCKET_GUID.as_bytes());
+    let response = format!(
+        "HTTP/1.1 101 Switching Protocols\r\n\
+         Upgrade: websocket\r\n\
+         Connection: Upgrade\r\n\
+         Sec-WebSocket-Accept: {}\r\n\
+         Sec-WebSocket-Protocol: {}\r\n\r\n",
+        BASE64.encode(&sha1.digest().bytes()),
+        SUBPROTOCOL,
+    );
+    Ok((path_key, response))
+}
+
+#[derive(Debug)]
+enum Frame {
+    Binary(Vec<u8>),
+    Ping(Vec<u8>),
+    Pong(Vec<u8>),
+    Close(Option<u16>),
+}
+
+/// WebSocket frames (server side: incoming frames are masked, outgoing
+/// frames are not).
+#[derive(Default)]
+struct WebSocketCodec {
+    /// Opcode and payload of a fragmented message.
+    fragments: Option<(u8, Vec<u8>)>,
+}
+
+fn data_frame(opcode: u8, payload: Vec<u8>) -> io::Result<Option<Frame>> {
+    match opcode {
+        0x2 => Ok(Some(Frame::Binary(payload))),
+        _ => Err(invalid_data("Text frames are not supported")),
+    }
+}
+
+impl Decoder for WebSocketCodec {
+    type Item = Frame;
+    type Error = io::Error;
+
+    fn decode(&mut self, src: &mut BytesMut) -> io::Result<Option<Frame>> {
+        loop {
+            if src.len() < 2 {
+                return Ok(None);
+            }
+            let fin = src[0] & 0x80 != 0;
+            let opcode = src[0] & 0x0f;
+            if src[1] & 0x80 == 0 {
+                return Err(invalid_data("Client frames must be masked"));
+            }
+            let (len, header_len) = match src[1] & 0x7f {
+                126 if src.len() >= 4 => (u64::from(src[2]) << 8 | u64::from(src[3]), 4),
+                127 if src.len() >= 10 => (src[2..10].iter().fold(0, |len, b| len << 8 | u64::from(*b)), 10),
+                126 | 127 => return Ok(None),
+                len => (u64::from(len), 2),
+            };
+            if len > MAX_FRAME_LEN as u64 {
+                return Err(invalid_data("Frame too long"));
+            }
+            let frame_len = header_len + 4 + len as usize;
+            if src.len() < frame_len {
+                src.reserve(frame_len - src.len());
+                return Ok(None);
+            }
+
+            let frame = src.split_to(frame_len);
+            let mask = &frame[header_len..header_len + 4];
+            let payload: Vec<u8> = frame[header_len + 4..].iter()
+                .enumerate()
+                .map(|(i, byte)| byte ^ mask[i % 4])
+                .collect();
+            match opcode {
+                0x0 => {
+                    let (opcode, mut data) = self.fragments.take()
+                        .ok_or_else(|| invalid_data("Unexpected continuation frame"))?;
+                    data.extend_from_slice(&payload);
+                    if data.len() > MAX_FRAME_LEN {
+                        return Err(invalid_data("Message too long"));
+                    }
+                    if fin {
+                        return data_frame(opcode, data);
+                    }
+                    self.fragments = Some((opcode, data));
+                },
+                0x1 | 0x2 if self.fragments.is_some() => return Err(invalid_data("Expected continuation frame")),
+                0x1 | 0x2 if fin => return data_frame(opcode, payload),
+                0x1 | 0x2 => self.fragments = Some((opcode, payload)),
+                0x8 if payload.len() >= 2 => return Ok(Some(Frame::Close(Some(u16::from(payload[0]) << 8 | u16::from(payload[1]))))),
+                0x8 => return Ok(Some(Frame::Close(None))),
+                0x9 => return Ok(Some(Frame::Ping(payload))),
+                0xa => return Ok(Some(Frame::Pong(payload))),
+                _ => return Err(invalid_data("Unknown opcode")),
+            }
+        }
+    }
+}
+
+impl Encoder for WebSocketCodec {
+    type Item = Frame;
+    type Error = io::Error;
+
+    fn encode(&mut self, frame: Frame, dst: &mut BytesMut) -> io::Result<()> {
+        let (opcode, payload) = match frame {
+            Frame::Binary(payload) => (0x2, payload),
+            Frame::Ping(payload) => (0x9, payload),
+            Frame::Pong(payload) => (0xa, payload),
+            Frame::Close(Some(code)) => (0x8, vec![(code >> 8) as u8, code as u8]),
+            Frame::Close(None) => (0x8, vec![]),
+        };
+        dst.reserve(10 + payload.len());
+        dst.put_u8(0x80 | opcode);
+        if payload.len() < 126 {
+            dst.put_u8(payload.len() as u8);
+        } else if payload.len() <= 0xffff {
+            dst.put_u8(126);
+            dst.put_u16_be(payload.len() as u16);
+        } else {
+            dst.put_u8(127);
+            dst.put_u64_be(payload.len() as u64);
+        }
+        dst.put_slice(&payload);
+        Ok(())
+    }
+}
+
+
+// *** SIGNALLING *** //
+
+fn new_message(message_type: &str, fields: Vec<(&str, Value)>) -> Value {
+    let mut map = vec![(Value::from("type"), Value::from(message_type))];
+    map.extend(fields.into_iter().map(|(key, value)| (Value::from(key), value)));
+    Value::Map(map)
+}
+
+fn field<'a>(message: &'a Value, name: &str) -> Option<&'a Value> {
+    message.as_map()?.iter()
+        .find(|&&(ref key, _)| key.as_str() == Some(name))
+        .map(|&(_, ref value)| value)
+}
+
+fn message_type(message: &Value) -> Option<&str> {
+    field(message, "type").and_then(Value::as_str)
+}
+
+/// A connected client, as seen from the server.
+struct Client {
+    tx: mpsc::UnboundedSender<Frame>,
+    /// The server's session key towards this client.
+    session_key: SecretKey,
+    /// The server's cookie towards this client.
+    cookie: [u8; COOKIE_LEN],
+    /// The server's combined sequence number towards this client.
+    csn: Cell<u64>,
+    /// The address of the client, assigned in `server-auth`.
+    address: Cell<u8>,
+    /// Box of the server's session key and the client's permanent key.
+    crypto: RefCell<Option<SalsaBox>>,
+}
+
+impl Client {
+    fn new(tx: mpsc::UnboundedSender<Frame>) -> Self {
+        Client {
+            tx,
+            session_key: SecretKey::from(::rand::random::<[u8; 32]>()),
+            cookie: ::rand::random(),
+            csn: Cell::new(u64::from(::rand::random::<u32>())),
+            address: Cell::new(SERVER_ADDRESS),
+            crypto: RefCell::new(None),
+        }
+    }
+
+    fn next_nonce(&self) -> [u8; NONCE_LEN] {
+        let csn = self.csn.get();
+        self.csn.set(csn + 1);
+        let mut nonce = [0; NONCE_LEN];
+        nonce[..COOKIE_LEN].copy_from_slice(&self.cookie);
+        nonce[16] = SERVER_ADDRESS;
+        nonce[17] = self.address.get();
+        nonce[18..20].copy_from_slice(&((csn >> 32) as u16).to_be_bytes());
+        nonce[20..24].copy_from_slice(&(csn as u32).to_be_bytes());
+        nonce
+    }
+
+    fn send_frame(&self, frame: Frame) {
+        // The connection may already be gone, nothing to do in that case
+        let _ = self.tx.unbounded_send(frame);
+    }
+
+    fn send_plain(&self, message: &Value) {
+        let mut data = self.next_nonce().to_vec();
+        write_value(&mut data, message).expect("Could not encode message");
+        self.send_frame(Frame::Binary(data));
+    }
+
+    fn send_encrypted(&self, message: &Value) {
+        let nonce = self.next_nonce();
+        let mut plaintext = Vec::new();
+        write_value(&mut plaintext, message).expect("Could not encode message");
+        let crypto = self.crypto.borrow();
+        let ciphertext = crypto.as_ref()
+            .expect("Client key unknown")
+            .encrypt(GenericArray::from_slice(&nonce[..]), &plaintext[..])
+            .expect("Could not encrypt message");
+        let mut data = nonce.to_vec();
+        data.extend_from_slice(&ciphertext);
+        self.send_frame(Frame::Binary(data));
+    }
+
+    fn decrypt(&self, data: &[u8]) -> Option<Value> {
+        let crypto = self.crypto.borrow();
+        let plaintext = crypto.as_ref()?
+            .decrypt(GenericArray::from_slice(&data[..NONCE_LEN]), &data[NONCE_LEN..])
+            .ok()?;
+        read_value(&mut &plaintext[..]).ok()
+    }
+
+    fn close(&self, code: u16) {
+        self.send_frame(Frame::Close(Some(code)));
+    }
+}
+
+/// The clients connected to a path.
+#[derive(Default)]
+struct Path {
+    initiator: Option<Rc<Client>>,
+    responders: HashMap<u8, Rc<Client>>,
+}
+
+type Paths = Rc<RefCell<HashMap<[u8; 32], Path>>>;
+
+enum State {
+    /// Waiting for `client-hello` (responder) or `client-auth` (initiator).
+    Hello,
+    /// Waiting for `client-auth` of a responder.
+    ResponderAuth,
+    /// Authenticated, relaying messages.
+    Relay,
+}
+
+struct Connection {
+    paths: Paths,
+    path_key: [u8; 32],
+    client: Rc<Client>,
+    state: State,
+}
+
+impl Connection {
+    /// Handle an incoming frame. Returns `false` if the connection should be closed.
+    fn handle(&mut self, frame: Frame) -> bool {
+        match frame {
+            Frame::Binary(data) => self.handle_message(&data),
+            Frame::Ping(payload) => {
+                self.client.send_frame(Frame::Pong(payload));
+                true
+            },
+            Frame::Pong(_) => true,
+            Frame::Close(code) => {
+                self.client.send_frame(Frame::Close(code));
+                false
+            },
+        }
+    }
+
+    fn protocol_error(&self) -> bool {
+        self.client.close(CLOSE_PROTOCOL_ERROR);
+        false
+    }
+
+    fn handle_message(&mut self, data: &[u8]) -> bool {
+        if data.len() < NONCE_LEN || data[16] != self.client.address.get() {
+            return self.protocol_error();
+        }
+        let destination = data[17];
+        match self.state {
+            State::Hello => {
+                // Responders introduce themselves with their permanent key,
+                // the initiator's permanent key is the path.
+                if let Ok(message) = read_value(&mut &data[NONCE_LEN..]) {
+                    if message_type(&message) == Some("client-hello") {
+                        return match field(&message, "key").and_then(Value::as_slice) {
+                            Some(key) if key.len() == 32 => {
+                                let mut client_key = [0; 32];
+                                client_key.copy_from_slice(key);
+                                self.set_client_key(client_key);
+                                self.state = State::ResponderAuth;
+                                true
+                            },
+                            _ => self.protocol_error(),
+                        };
+                    }
+                }
+                let path_key = self.path_key;
+                self.set_client_key(path_key);
+                self.authenticate(data, true)
+            },
+            State::ResponderAuth => self.authenticate(data, false),
+            State::Relay if destination == SERVER_ADDRESS => self.handle_server_message(data),
+            State::Relay => {
+                self.relay(destination, data);
+                true
+            },
+        }
+    }
+
+    fn set_client_key(&self, key: [u8; 32]) {
+        let crypto = SalsaBox::new(&PublicKey::from(key), &self.client.session_key);
+        *self.client.crypto.borrow_mut() = Some(crypto);
+    }
+
+    fn authenticate(&mut self, data: &[u8], initiator: bool) -> bool {
+        let message = match self.client.decrypt(data) {
+            Some(message) => message,
+            None => return self.protocol_error(),
+        };
+        let cookie_valid = field(&message, "your_cookie")
+            .and_then(Value::as_slice)
+            .map_or(false, |cookie| cookie == &self.client.cookie[..]);
+        let subprotocol_valid = field(&message, "subprotocols")
+            .and_then(Value::as_array)
+            .map_or(false, |subprotocols| subprotocols.iter().any(|p| p.as_str() == Some(SUBPROTOCOL)));
+        if message_type(&message) != Some("client-auth") || !cookie_valid || !subprotocol_valid {
+            return self.protocol_error();
+        }
+        let your_cookie = Value::Binary(data[..COOKIE_LEN].to_vec());
+
+        let mut paths = self.paths.borrow_mut();
+        let path = paths.entry(self.path_key).or_insert_with(Path::default);
+        if initiator {
+            self.client.address.set(INITIATOR_ADDRESS);
+            if let Some(previous) = path.initiator.replace(self.client.clone()) {
+                previous.close(CLOSE_DROPPED_BY_INITIATOR);
+            }
+            let responders = path.responders.keys().map(|&address| Value::from(address)).collect();
+            self.client.send_encrypted(&new_message("server-auth", vec![
+                ("your_cookie", your_cookie),
+                ("responders", Value::Array(responders)),
+            ]));
+            for responder in path.responders.values() {
+                responder.send_encrypted(&new_message("new-initiator", vec![]));
+            }
+        } else {
+            let address = match (RESPONDER_ADDRESS_MIN..=RESPONDER_ADDRESS_MAX).find(|a| !path.responders.contains_key(a)) {
+                Some(address) => address,
+                None => {
+                    self.client.close(CLOSE_PATH_FULL);
+                    return false;
+                },
+            };
+            self.client.address.set(address);
+            path.responders.insert(address, self.client.clone());
+            self.client.send_encrypted(&new_message("server-auth", vec![
+                ("your_cookie", your_cookie),
+                ("initiator_connected", Value::Boolean(path.initiator.is_some())),
+            ]));
+            if let Some(ref initiator) = path.initiator {
+                initiator.send_encrypted(&new_message("new-responder", vec![("id", Value::from(address))]));
+            }
+        }
+        drop(paths);
+        self.state = State::Relay;
+        true
+    }
+
+    fn handle_server_message(&self, data: &[u8]) -> bool {
+        let message = match self.client.decrypt(data) {
+            Some(message) => message,
+            None => return self.protocol_error(),
+        };
+        if message_type(&message) == Some("drop-responder") && self.client.address.get() == INITIATOR_ADDRESS {
+            let address = field(&message, "id").and_then(Value::as_u64);
+            let reason = field(&message, "reason").and_then(Value::as_u64)
+                .map_or(CLOSE_DROPPED_BY_INITIATOR, |reason| reason as u16);
+            let mut paths = self.paths.borrow_mut();
+            let responder = match (paths.get_mut(&self.path_key), address) {
+                (Some(path), Some(address)) => path.responders.remove(&(address as u8)),
+                _ => None,
+            };
+            if let Some(responder) = responder {
+                responder.close(reason);
+            }
+        }
+        true
+    }
+
+    /// Relay a message to another client of the path.
+    ///
+    /// The message is passed on as is, it is end-to-end encrypted.
+    fn relay(&self, destination: u8, data: &[u8]) {
+        let paths = self.paths.borrow();
+        let target = paths.get(&self.path_key).and_then(|path| match self.client.address.get() {
+            INITIATOR_ADDRESS => path.responders.get(&destination),
+            _ if destination == INITIATOR_ADDRESS => path.initiator.as_ref(),
+            _ => None,
+        });
+        match target {
+            Some(target) => target.send_frame(Frame::Binary(data.to_vec())),
+            None => self.client.send_encrypted(&new_message("send-error", vec![
+                ("id", Value::Binary(data[16..24].to_vec())),
+            ])),
+        }
+    }
+
+    /// Remove the client from its path and notify the other clients.
+    fn unregister(&self) {
+        let mut paths = self.paths.borrow_mut();
+        let empty = match paths.get_mut(&self.path_key) {
+            Some(path) => {
+                let address = self.client.address.get();
+                let registered = match address {
+                    INITIATOR_ADDRESS => path.initiator.as_ref(),
+                    _ => path.responders.get(&address),
+                }.map_or(false, |client| Rc::ptr_eq(client, &self.client));
+                if registered {
+                    let disconnected = new_message("disconnected", vec![("id", Value::from(address))]);
+                    if address == INITIATOR_ADDRESS {
+                        path.initiator = None;
+                        for responder in path.responders.values() {
+                            responder.send_encrypted(&disconnected);
+                        }
+                    } else {
+                        path.responders.remove(&address);
+                        if let Some(ref initiator) = path.initiator {
+                            initiator.send_encrypted(&disconnected);
+                        }
+                    }
+                }
+                path.initiator.is_none() && path.responders.is_empty()
+            },
+            None => false,
+        };
+        if empty {
+            paths.remove(&self.path_key);
+        }
+    }
+}
+
+/// Serve a client after the WebSocket handshake.
+fn serve(
+    handle: &Handle,
+    stream: TlsStream<TcpStream>,
+    path_key: [u8; 32],
+    paths: Paths,
+) -> impl Future<Item=(), Error=io::Error> {
+    let (sink, frames) = Framed::new(stream, WebSocketCodec::default()).split();
+
+    // Outgoing frames, ends when all references to the client are gone
+    let (tx, rx) = mpsc::unbounded();
+    handle.spawn(
+        rx.map_err(|_| other_error("Channel error"))
+            .forward(sink)
+            .map(|_| ())
+            .map_err(|_| ())
+    );
+
+    let client = Rc::new(Client::new(tx));
+    client.send_plain(&new_message("server-hello", vec![
+        ("key", Value::Binary(client.session_key.public_key().as_bytes().to_vec())),
+    ]));
+
+    let connection = Rc::new(RefCell::new(Connection {
+        paths,
+        path_key,
+        client,
+        state: State::Hello,
+    }));
+    let connection_cleanup = connection.clone();
+    frames
+        .map(move |frame| connection.borrow_mut().handle(frame))
+        .take_while(|&proceed| Ok(proceed))
+        .for_each(|_| Ok(()))
+        .then(move |res| {
+            connection_cleanup.borrow().unregister();
+            res
+        })
+}
+
+fn accept(handle: &Handle, acceptor: &TlsAcceptor, paths: &Paths, tcp: TcpStream) {
+    let handle_serve = handle.clone();
+    let paths = paths.clone();
+    let connection = acceptor.accept(tcp)
+        .map_err(other_error)
+        .and_then(|stream| Framed::new(stream, HandshakeCodec).into_future().map_err(|(e, _)| e))
+        .and_then(|(request, framed)| {
+            let handshake = request
+                .ok_or_else(|| invalid_data("Connection closed during handshake"))
+                .and_then(|request| parse_handshake(&request));
+            match handshake {
+                Ok((path_key, response)) => Either::A(
+                    framed.send(response).map(move |framed| (path_key, framed.into_inner()))
+                ),
+                Err(e) => Either::B(future::err(e)),
+            }
+        })
+        .and_then(move |(path_key, stream)| serve(&handle_serve, stream, path_key, paths));
+    handle.spawn(connection.map_err(|_| ()));
+}
+
+
+// *** SERVER *** //
+
+/// The stand-in server, running on its own thread until dropped.
+pub struct StandInServer {
+    addr: SocketAddr,
+    shutdown_tx: Option<oneshot::Sender<()>>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl StandInServer {
+    /// Start the server on a free port.
+    pub fn start() -> io::Result<Self> {
+        let identity = Identity::from_pkcs12(include_bytes!("server.p12"), "saltyrtc")
+            .map_err(other_error)?;
+        let acceptor = TlsAcceptor::from(native_tls::TlsAcceptor::new(identity).map_err(other_error)?);
+
+        let (addr_tx, addr_rx) = std_mpsc::channel();
+        let (shutdown_tx, shutdown_rx) = oneshot::channel::<()>();
+        let thread = thread::Builder::new()
+            .name("standin-server".to_string())
+            .spawn(move || {
+                let mut core = Core::new().expect("Could not create event loop");
+                let handle = core.handle();
+                let listener = match TcpListener::bind(&"127.0.0.1:0".parse::<SocketAddr>().unwrap(), &handle)
+                    .and_then(|listener| listener.local_addr().map(|addr| (listener, addr))) {
+                    Ok((listener, addr)) => {
+                        let _ = addr_tx.send(Ok(addr));
+                        listener
+                    },
+                    Err(e) => {
+                        let _ = addr_tx.send(Err(e));
+                        return;
+                    },
+                };
+                let paths = Paths::default();
+                let server = listener.incoming().for_each(|(tcp, _addr)| {
+                    let _ = tcp.set_nodelay(true);
+                    accept(&handle, &acceptor, &paths, tcp);
+                    Ok(())
+                });
+                let _ = core.run(server.select2(shutdown_rx));
+            })?;
+        let addr = addr_rx.recv().map_err(|_| other_error("Stand-in server died"))??;
+        Ok(StandInServer {
+            addr,
+            shutdown_tx: Some(shutdown_tx),
+            thread: Some(thread),
+        })
+    }
+
+    pub fn port(&self) -> u16 {
+        self.addr.port()
+    }
+}
+
+impl Drop for StandInServer {
+    fn drop(&mut self) {
+        if let Some(shutdown_tx) = self.shutdown_tx.take() {
+            let _ = shutdown_tx.send(());
+        }
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
@@ -5,12 +5,16 @@ extern crate tokio_core;
 
 use std::borrow::Cow;
 use std::collections::HashMap;
+use std::fmt::Debug;
 use std::mem;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, Ordering};
 
 use saltyrtc_client::{CloseCode, BoxedFuture};
 use saltyrtc_client::dep::futures::future;
-use saltyrtc_client::dep::futures::{Stream, Sink, Future};
-use saltyrtc_client::dep::futures::sync::mpsc::{self, UnboundedSender, UnboundedReceiver};
+use saltyrtc_client::dep::futures::{Async, AsyncSink, Poll, Stream, Sink, Future};
+use saltyrtc_client::dep::futures::sync::mpsc::{self, Sender, UnboundedSender, UnboundedReceiver};
+use saltyrtc_client::dep::futures::task::AtomicTask;
 use saltyrtc_client::dep::futures::sync::oneshot::Sender as OneshotSender;
 use saltyrtc_client::dep::rmpv::Value;
 use saltyrtc_client::errors::Error;
@@ -27,6 +31,10 @@ const TYPE_DATA: &'static str = "data";
 const KEY_TYPE: &'static str = "type";
 const KEY_PAYLOAD: &'static str = "p";
 
+/// Number of outgoing messages buffered by the task before the task user's
+/// sender has to wait.
+const OUTGOING_CAPACITY: usize = 16;
+
 
 /// Wrap future in a box with type erasure.
 macro_rules! boxed {
@@ -41,8 +49,17 @@ macro_rules! boxed {
 ///
 /// This task uses the end-to-end encrypted WebSocket connection set up by
 /// the SaltyRTC protocol to send user defined messages.
+///
+/// Incoming messages and events are passed to the task user through the sink
+/// `S`. By default, this is an unbounded channel. If a bounded sink is used
+/// instead (e.g. `mpsc::Sender`), the task stops reading incoming messages
+/// while the sink is full, until the task user has caught up. To stop reading
+/// from the socket as well, the task loop should only be polled while the
+/// `incoming_backpressure` handle is ready. The handle also becomes ready
+/// whenever an outgoing message has been queued, so that it is sent even
+/// while incoming messages are held back.
 #[derive(Debug)]
-pub struct RelayedDataTask {
+pub struct RelayedDataTask<S = UnboundedSender<MessageEvent>> {
     /// A remote handle so that tasks can be enqueued in the reactor core.
     remote: Remote,
 
@@ -52,7 +69,10 @@ pub struct RelayedDataTask {
 
     /// The sending end of a channel to send incoming messages and events to
     /// the task user.
-    incoming_tx: UnboundedSender<MessageEvent>,
+    incoming_tx: S,
+
+    /// Whether an incoming message is waiting for the task user.
+    incoming_backpressure: IncomingBackpressure,
 }
 
 #[derive(Debug)]
@@ -64,7 +84,7 @@ pub enum State {
 #[derive(Debug)]
 pub struct ConnectionContext {
     outgoing_tx: UnboundedSender<TaskMessage>,
-    user_outgoing_tx: UnboundedSender<OutgoingMessage>,
+    user_outgoing_tx: Sender<OutgoingMessage>,
     disconnect_tx: OneshotSender<Option<CloseCode>>,
 }
 
@@ -83,17 +103,144 @@ pub enum OutgoingMessage {
     Application(Value),
 }
 
-impl RelayedDataTask {
-    pub fn new(remote: Remote, incoming_tx: UnboundedSender<MessageEvent>) -> Self {
+/// Shared state of an `IncomingBackpressure` handle.
+#[derive(Debug, Default)]
+struct BackpressureState {
+    /// Whether an incoming message could not be passed to the task user yet.
+    blocked: AtomicBool,
+    /// Whether an outgoing message has been queued since the task loop has
+    /// last been polled while blocked.
+    outgoing: AtomicBool,
+    /// The task waiting for the incoming message to be passed on (or an
+    /// outgoing message to be queued).
+    waiter: AtomicTask,
+}
+
+/// Signals whether the task is waiting for the task user to accept an
+/// incoming message.
+///
+/// While it is blocked, the task loop should not be polled, so that no further
+/// messages are read from the socket. The messages already read are bounded
+/// by what the task loop reads from the socket in a single poll.
+///
+/// Outgoing messages are still sent while it is blocked: Queueing an outgoing
+/// message makes the handle ready once, so that the task loop is polled to
+/// pass it on to the socket. That poll may read from the socket as well.
+#[derive(Debug, Clone, Default)]
+pub struct IncomingBackpressure {
+    state: Arc<BackpressureState>,
+}
+
+impl IncomingBackpressure {
+    /// Return `Async::Ready` if the task is not waiting for the task user or
+    /// if an outgoing message has been queued since the last call.
+    ///
+    /// Otherwise, the current task is notified once the pending message has
+    /// been passed on or an outgoing message has been queued. Only one task
+    /// can wait at a time (the one polling the task loop).
+    pub fn poll_ready(&self) -> Async<()> {
+        if self.is_ready() {
+            return Async::Ready(());
+        }
+        self.state.waiter.register();
+        if self.is_ready() {
+            Async::Ready(())
+        } else {
+            Async::NotReady
+        }
+    }
+
+    fn is_ready(&self) -> bool {
+        !self.state.blocked.load(Ordering::SeqCst) || self.state.outgoing.swap(false, Ordering::SeqCst)
+    }
+
+    /// Signal that an outgoing message has been queued for the task loop.
+    fn set_outgoing(&self) {
+        self.state.outgoing.store(true, Ordering::SeqCst);
+        if self.state.blocked.load(Ordering::SeqCst) {
+            self.state.waiter.notify();
+        }
+    }
+
+    fn set_blocked(&self, blocked: bool) {
+        let was_blocked = self.state.blocked.swap(blocked, Ordering::SeqCst);
+        if was_blocked && !blocked {
+            self.state.waiter.notify();
+        }
+    }
+}
+
+/// Future that passes an incoming message event to the task user's sink.
+///
+/// Flags the `IncomingBackpressure` while the sink is not ready. Errors of the
+/// sink are logged.
+struct Deliver<S: Sink<SinkItem=MessageEvent>> {
+    sink: S,
+    event: Option<MessageEvent>,
+    backpressure: IncomingBackpressure,
+}
+
+impl<S> Future for Deliver<S>
+    where S: Sink<SinkItem=MessageEvent>, S::SinkError: Debug
+{
+    type Item = ();
+    type Error = ();
+
+    fn poll(&mut self) -> Poll<(), ()> {
+        if let Some(event) = self.event.take() {
+            match self.sink.start_send(event) {
+                Ok(AsyncSink::Ready) => {},
+                Ok(AsyncSink::NotReady(event)) => {
+                    self.event = Some(event);
+                    self.backpressure.set_blocked(true);
+                    return Ok(Async::NotReady);
+                },
+                Err(e) => {
+                    error!("Could not pass incoming message to the task user, stopping to receive: {:?}", e);
+                    self.backpressure.set_blocked(false);
+                    return Err(());
+                },
+            }
+        }
+        match self.sink.poll_complete() {
+            Ok(Async::Ready(())) => {
+                self.backpressure.set_blocked(false);
+                Ok(Async::Ready(()))
+            },
+            Ok(Async::NotReady) => {
+                self.backpressure.set_blocked(true);
+                Ok(Async::NotReady)
+            },
+            Err(e) => {
+                error!("Could not pass incoming message to the task user, stopping to receive: {:?}", e);
+                self.backpressure.set_blocked(false);
+                Err(())
+            },
+        }
+    }
+}
+
+impl<S> RelayedDataTask<S> {
+    pub fn new(remote: Remote, incoming_tx: S) -> Self {
         RelayedDataTask {
             remote,
             state: State::Stopped,
             incoming_tx,
+            incoming_backpressure: IncomingBackpressure::default(),
         }
     }
 
+    /// Return a handle that signals whether the task is waiting for the task
+    /// user to accept an incoming message.
+    pub fn incoming_backpressure(&self) -> IncomingBackpressure {
+        self.incoming_backpressure.clone()
+    }
+
     /// Return the sending end of a channel, to be able to send outgoing values.
-    pub fn get_sender(&self) -> Result<UnboundedSender<OutgoingMessage>, String> {
+    ///
+    /// The channel is bounded, so sending waits while the task is not able to
+    /// pass outgoing messages on to the SaltyRTC client.
+    pub fn get_sender(&self) -> Result<Sender<OutgoingMessage>, String> {
         match self.state {
             State::Stopped => return Err("Cannot return Sender in `Stopped` state".into()),
             State::Started(ref cctx) => Ok(cctx.user_outgoing_tx.clone()),
@@ -101,7 +248,9 @@ impl RelayedDataTask {
     }
 }
 
-impl Task for RelayedDataTask {
+impl<S> Task for RelayedDataTask<S>
+    where S: Sink<SinkItem=MessageEvent> + Clone + Debug + Send + 'static, S::SinkError: Debug
+{
 
     /// Initialize the task with the task data from the peer, sent in the `Auth` message.
     ///
@@ -131,7 +280,7 @@ impl Task for RelayedDataTask {
         };
 
         // Update state
-        let (user_outgoing_tx, user_outgoing_rx) = mpsc::unbounded::<OutgoingMessage>();
+        let (user_outgoing_tx, user_outgoing_rx) = mpsc::channel::<OutgoingMessage>(OUTGOING_CAPACITY);
         let cctx = ConnectionContext {
             outgoing_tx: outgoing_tx.clone(),
             disconnect_tx,
@@ -140,36 +289,32 @@ impl Task for RelayedDataTask {
         self.state = State::Started(cctx);
 
 
-        // TODO: Better error handling
         let user_incoming_tx = self.incoming_tx.clone();
-        self.remote.spawn(move |handle| {
-            let handle = handle.clone();
-
-            // Handle incoming messages
+        let backpressure = self.incoming_backpressure.clone();
+        self.remote.spawn(move |_handle| {
+            // Handle incoming messages.
+            //
+            // Every message is handed over to the task user before the next
+            // one is read. This keeps the order and, with a bounded sink,
+            // pauses reading while the task user is not keeping up.
+            let outgoing_backpressure = backpressure.clone();
+            let deliver = move |event: MessageEvent| Deliver {
+                sink: user_incoming_tx.clone(),
+                event: Some(event),
+                backpressure: backpressure.clone(),
+            };
             let incoming = incoming_rx.for_each(move |msg: TaskMessage| {
-                let map: HashMap<String, Value> = match msg {
+                let mut map: HashMap<String, Value> = match msg {
                     TaskMessage::Value(map) => map,
                     TaskMessage::Application(data) => {
                         // Send application message through channel
                         debug!("Sending application message payload through channel");
-                        return boxed!(
-                            user_incoming_tx
-                                .clone()
-                                .send(MessageEvent::Application(data))
-                                .map(|_| ()) // TODO
-                                .map_err(|_| ()) // TODO
-                        );
+                        return boxed!(deliver(MessageEvent::Application(data)));
                     },
                     TaskMessage::Close(reason) => {
                         // Peer is closing the connection.
                         // Notify user about this.
-                        return boxed!(
-                            user_incoming_tx
-                                .clone()
-                                .send(MessageEvent::Close(reason))
-                                .map(|_| ())
-                                .map_err(|_| ())
-                        );
+                        return boxed!(deliver(MessageEvent::Close(reason)));
                     },
                 };
 
@@ -181,23 +326,18 @@ impl Task for RelayedDataTask {
                     panic!("Unknown message type: {}", msg_type);
                 }
 
-                // Extract payload
-                match map.get(KEY_PAYLOAD) {
+                // Extract payload (moved out of the map, large payloads are not copied)
+                match map.remove(KEY_PAYLOAD) {
                     Some(payload) => {
                         // Send payload through channel
-                        let user_incoming_tx = user_incoming_tx.clone();
                         debug!("Sending {} message payload through channel", TYPE_DATA);
-                        handle.spawn(
-                            user_incoming_tx
-                                .send(MessageEvent::Data(payload.clone()))
-                                .map(|_| ()) // TODO
-                                .map_err(|_| ()) // TODO
-                        )
+                        boxed!(deliver(MessageEvent::Data(payload)))
+                    },
+                    None => {
+                        warn!("Received {} message without payload field", TYPE_DATA);
+                        boxed!(future::ok(()))
                     },
-                    None => warn!("Received {} message without payload field", TYPE_DATA),
                 }
-
-                boxed!(future::ok(()))
             });
 
             let outgoing = user_outgoing_rx.for_each(move |msg: OutgoingMessage| {
@@ -211,11 +351,13 @@ impl Task for RelayedDataTask {
                     OutgoingMessage::Application(val) => TaskMessage::Application(val),
                 };
 
-                // Send message through channel
+                // Send message through channel (and have the task loop polled
+                // to pass it on, even while incoming messages are held back)
+                let backpressure = outgoing_backpressure.clone();
                 let future = outgoing_tx
                     .clone()
                     .send(task_message)
-                    .map(|_sink| ())
+                    .map(move |_sink| backpressure.set_outgoing())
                     .map_err(|_| ());
 
                 debug!("Enqueuing outgoing message");
@@ -278,7 +420,7 @@ impl Task for RelayedDataTask {
     }
 }
 
-impl Drop for RelayedDataTask {
+impl<S> Drop for RelayedDataTask<S> {
     fn drop(&mut self) {
         trace!("Dropping RelayedDataTask");
     }
@@ -174,7 +174,7 @@ fn integration_test() {
             .downcast_mut::<RelayedDataTask>()
             .expect("Chosen task is not a RelayedDataTask");
 
-        // Get unbounded senders for outgoing messages
+        // Get senders for outgoing messages
         let tx_initiator = rd_task_initiator.get_sender().unwrap();
         let tx_responder = rd_task_responder.get_sender().unwrap();
         (tx_initiator, tx_responder)